@@ -3009,7 +3009,6 @@ THREAD_RET_TYPE assoc_adapt_thread(void* arg) {
   uintptr_t pheno_nm_ct = g_pheno_nm_ct;
   uintptr_t pheno_nm_ctl2 = 2 * ((pheno_nm_ct + (BITCT - 1)) / BITCT);
   uintptr_t perm_vec_ct = g_perm_vec_ct;
-  uint32_t assoc_thread_ct = g_assoc_thread_ct;
   uint32_t pidx_offset = g_perms_done - perm_vec_ct;
   uint32_t model_fisher = g_model_fisher;
   uint32_t fisher_midp = g_fisher_midp;
@@ -3060,16 +3059,8 @@ THREAD_RET_TYPE assoc_adapt_thread(void* arg) {
   double dyy;
   double dzz;
   while (1) {
-    if (g_block_diff <= assoc_thread_ct) {
-      if (g_block_diff <= tidx) {
-        goto assoc_adapt_thread_skip_all;
-      }
-      marker_bidx = g_block_start + tidx;
-      marker_bceil = marker_bidx + 1;
-    } else {
-      marker_bidx = g_block_start + (((uint64_t)tidx) * g_block_diff) / assoc_thread_ct;
-      marker_bceil = g_block_start + (((uint64_t)tidx + 1) * g_block_diff) / assoc_thread_ct;
-    }
+    marker_bidx = 0;
+    marker_bceil = 0;
     min_ploidy_1 = g_min_ploidy_1;
     loadbuf = g_loadbuf;
     orig_pvals = g_orig_pvals;
@@ -3085,7 +3076,7 @@ THREAD_RET_TYPE assoc_adapt_thread(void* arg) {
     } else {
       min_ploidy = 2;
     }
-    for (; marker_bidx < marker_bceil; marker_bidx++) {
+    for (; (marker_bidx < marker_bceil) || ws_claim(tidx, 1, &marker_bidx, &marker_bceil); marker_bidx++) {
       // guaranteed during loading that g_perm_adapt_stop[] is not set yet
       marker_idx = g_adapt_m_table[marker_bidx];
       next_adapt_check = first_adapt_check;
@@ -3180,7 +3171,6 @@ THREAD_RET_TYPE assoc_adapt_thread(void* arg) {
       }
       perm_2success_ct[marker_idx] += success_2incr;
     }
-  assoc_adapt_thread_skip_all:
     if ((!tidx) || g_is_last_thread_block) {
       THREAD_RETURN;
     }
@@ -3670,14 +3660,14 @@ THREAD_RET_TYPE qassoc_adapt_thread(void* arg) {
     if (cur_thread_ct <= tidx) {
       goto qassoc_adapt_thread_skip_all;
     }
-    marker_bidx = g_qblock_start + (((uint64_t)tidx) * g_block_diff) / cur_thread_ct;
-    marker_bceil = g_qblock_start + (((uint64_t)tidx + 1) * g_block_diff) / cur_thread_ct;
+    marker_bidx = 0;
+    marker_bceil = 0;
     loadbuf = g_loadbuf;
     missing_cts = g_missing_cts;
     het_cts = g_het_cts;
     homcom_cts = g_homcom_cts;
     orig_chiabs = g_orig_chisq;
-    for (; marker_bidx < marker_bceil; marker_bidx++) {
+    for (; (marker_bidx < marker_bceil) || ws_claim(tidx, 1, &marker_bidx, &marker_bceil); marker_bidx++) {
       marker_idx = g_adapt_m_table[marker_bidx];
       next_adapt_check = first_adapt_check;
       missing_ct = missing_cts[marker_idx];
@@ -3854,14 +3844,14 @@ THREAD_RET_TYPE qassoc_adapt_lin_thread(void* arg) {
     if (cur_thread_ct <= tidx) {
       goto qassoc_adapt_lin_thread_skip_all;
     }
-    marker_bidx = g_qblock_start + (((uint64_t)tidx) * g_block_diff) / cur_thread_ct;
-    marker_bceil = g_qblock_start + (((uint64_t)tidx + 1) * g_block_diff) / cur_thread_ct;
+    marker_bidx = 0;
+    marker_bceil = 0;
     loadbuf = g_loadbuf;
     missing_cts = g_missing_cts;
     het_cts = g_het_cts;
     homcom_cts = g_homcom_cts;
     orig_linsq = g_orig_linsq;
-    for (; marker_bidx < marker_bceil; marker_bidx++) {
+    for (; (marker_bidx < marker_bceil) || ws_claim(tidx, 1, &marker_bidx, &marker_bceil); marker_bidx++) {
       marker_idx = g_adapt_m_table[marker_bidx];
       next_adapt_check = first_adapt_check;
       missing_ct = missing_cts[marker_idx];
@@ -4447,7 +4437,6 @@ THREAD_RET_TYPE model_adapt_domrec_thread(void* arg) {
   uintptr_t pheno_nm_ct = g_pheno_nm_ct;
   uintptr_t pheno_nm_ctv2 = 2 * ((pheno_nm_ct + (BITCT - 1)) / BITCT);
   uintptr_t perm_vec_ct = g_perm_vec_ct;
-  uint32_t assoc_thread_ct = g_assoc_thread_ct;
   uint32_t pidx_offset = g_perms_done - perm_vec_ct;
   uint32_t model_fisher = g_model_fisher;
   uint32_t fisher_midp = g_fisher_midp;
@@ -4493,16 +4482,8 @@ THREAD_RET_TYPE model_adapt_domrec_thread(void* arg) {
   double dyy;
   double dzz;
   while (1) {
-    if (g_block_diff <= assoc_thread_ct) {
-      if (g_block_diff <= tidx) {
-        goto model_adapt_domrec_thread_skip_all;
-      }
-      marker_bidx = g_block_start + tidx;
-      marker_bceil = marker_bidx + 1;
-    } else {
-      marker_bidx = g_block_start + (((uint64_t)tidx) * g_block_diff) / assoc_thread_ct;
-      marker_bceil = g_block_start + (((uint64_t)tidx + 1) * g_block_diff) / assoc_thread_ct;
-    }
+    marker_bidx = 0;
+    marker_bceil = 0;
     loadbuf = g_loadbuf;
     orig_pvals = g_orig_pvals;
     orig_chisq = g_orig_chisq;
@@ -4511,7 +4492,7 @@ THREAD_RET_TYPE model_adapt_domrec_thread(void* arg) {
     homcom_cts = g_homcom_cts;
     precomp_start = g_precomp_start;
     precomp_ui = g_precomp_ui;
-    for (; marker_bidx < marker_bceil; marker_bidx++) {
+    for (; (marker_bidx < marker_bceil) || ws_claim(tidx, 1, &marker_bidx, &marker_bceil); marker_bidx++) {
       marker_idx = g_adapt_m_table[marker_bidx];
       if (model_fisher) {
 	if (orig_pvals[marker_idx] == -9) {
@@ -4602,7 +4583,6 @@ THREAD_RET_TYPE model_adapt_domrec_thread(void* arg) {
       }
       perm_2success_ct[marker_idx] += success_2incr;
     }
-  model_adapt_domrec_thread_skip_all:
     if ((!tidx) || g_is_last_thread_block) {
       THREAD_RETURN;
     }
@@ -4963,7 +4943,6 @@ THREAD_RET_TYPE model_adapt_trend_thread(void* arg) {
   uintptr_t pheno_nm_ct = g_pheno_nm_ct;
   uintptr_t pheno_nm_ctv2 = 2 * ((pheno_nm_ct + (BITCT - 1)) / BITCT);
   uintptr_t perm_vec_ct = g_perm_vec_ct;
-  uint32_t assoc_thread_ct = g_assoc_thread_ct;
   uint32_t pidx_offset = g_perms_done - perm_vec_ct;
   uint32_t precomp_width = g_precomp_width;
   uint32_t first_adapt_check = g_first_adapt_check;
@@ -5006,16 +4985,8 @@ THREAD_RET_TYPE model_adapt_trend_thread(void* arg) {
   double dyy;
   double dzz;
   while (1) {
-    if (g_block_diff <= assoc_thread_ct) {
-      if (g_block_diff <= tidx) {
-        goto model_adapt_trend_thread_skip_all;
-      }
-      marker_bidx = g_block_start + tidx;
-      marker_bceil = marker_bidx + 1;
-    } else {
-      marker_bidx = g_block_start + (((uint64_t)tidx) * g_block_diff) / assoc_thread_ct;
-      marker_bceil = g_block_start + (((uint64_t)tidx + 1) * g_block_diff) / assoc_thread_ct;
-    }
+    marker_bidx = 0;
+    marker_bceil = 0;
     loadbuf = g_loadbuf;
     orig_pvals = g_orig_pvals;
     orig_chisq = g_orig_chisq;
@@ -5024,7 +4995,7 @@ THREAD_RET_TYPE model_adapt_trend_thread(void* arg) {
     homcom_cts = g_homcom_cts;
     precomp_start = g_precomp_start;
     precomp_ui = g_precomp_ui;
-    for (; marker_bidx < marker_bceil; marker_bidx++) {
+    for (; (marker_bidx < marker_bceil) || ws_claim(tidx, 1, &marker_bidx, &marker_bceil); marker_bidx++) {
       marker_idx = g_adapt_m_table[marker_bidx];
       next_adapt_check = first_adapt_check;
       if (orig_pvals[marker_idx] == -9) {
@@ -5089,7 +5060,6 @@ THREAD_RET_TYPE model_adapt_trend_thread(void* arg) {
       }
       perm_2success_ct[marker_idx] += success_2incr;
     }
-  model_adapt_trend_thread_skip_all:
     if ((!tidx) || g_is_last_thread_block) {
       THREAD_RETURN;
     }
@@ -5389,7 +5359,6 @@ THREAD_RET_TYPE model_adapt_gen_thread(void* arg) {
   uintptr_t pheno_nm_ct = g_pheno_nm_ct;
   uintptr_t pheno_nm_ctv2 = 2 * ((pheno_nm_ct + (BITCT - 1)) / BITCT);
   uintptr_t perm_vec_ct = g_perm_vec_ct;
-  uint32_t assoc_thread_ct = g_assoc_thread_ct;
   uint32_t pidx_offset = g_perms_done - perm_vec_ct;
   uint32_t model_fisher = g_model_fisher;
   uint32_t fisher_midp = g_fisher_midp;
@@ -5432,23 +5401,15 @@ THREAD_RET_TYPE model_adapt_gen_thread(void* arg) {
   double dyy;
   double dzz;
   while (1) {
-    if (g_block_diff <= assoc_thread_ct) {
-      if (g_block_diff <= tidx) {
-        goto model_adapt_gen_thread_skip_all;
-      }
-      marker_bidx = g_block_start + tidx;
-      marker_bceil = marker_bidx + 1;
-    } else {
-      marker_bidx = g_block_start + (((uint64_t)tidx) * g_block_diff) / assoc_thread_ct;
-      marker_bceil = g_block_start + (((uint64_t)tidx + 1) * g_block_diff) / assoc_thread_ct;
-    }
+    marker_bidx = 0;
+    marker_bceil = 0;
     loadbuf = g_loadbuf;
     orig_pvals = g_orig_pvals;
     orig_chisq = g_orig_chisq;
     missing_cts = g_missing_cts;
     het_cts = g_het_cts;
     homcom_cts = g_homcom_cts;
-    for (; marker_bidx < marker_bceil; marker_bidx++) {
+    for (; (marker_bidx < marker_bceil) || ws_claim(tidx, 1, &marker_bidx, &marker_bceil); marker_bidx++) {
       marker_idx = g_adapt_m_table[marker_bidx];
       if (model_fisher) {
 	if (orig_pvals[marker_idx] == -9) {
@@ -5525,7 +5486,6 @@ THREAD_RET_TYPE model_adapt_gen_thread(void* arg) {
       }
       perm_2success_ct[marker_idx] += success_2incr;
     }
-  model_adapt_gen_thread_skip_all:
     if ((!tidx) || g_is_last_thread_block) {
       THREAD_RETURN;
     }
@@ -5731,7 +5691,6 @@ THREAD_RET_TYPE model_adapt_best_thread(void* arg) {
   uintptr_t pheno_nm_ct = g_pheno_nm_ct;
   uintptr_t pheno_nm_ctv2 = 2 * ((pheno_nm_ct + (BITCT - 1)) / BITCT);
   uintptr_t perm_vec_ct = g_perm_vec_ct;
-  uint32_t assoc_thread_ct = g_assoc_thread_ct;
   uint32_t pidx_offset = g_perms_done - perm_vec_ct;
   uint32_t model_fisher = g_model_fisher;
   uint32_t fisher_midp = g_fisher_midp;
@@ -5785,16 +5744,8 @@ THREAD_RET_TYPE model_adapt_best_thread(void* arg) {
   double dyy;
   double dzz;
   while (1) {
-    if (g_block_diff <= assoc_thread_ct) {
-      if (g_block_diff <= tidx) {
-        goto model_adapt_best_thread_skip_all;
-      }
-      marker_bidx = g_block_start + tidx;
-      marker_bceil = marker_bidx + 1;
-    } else {
-      marker_bidx = g_block_start + (((uint64_t)tidx) * g_block_diff) / assoc_thread_ct;
-      marker_bceil = g_block_start + (((uint64_t)tidx + 1) * g_block_diff) / assoc_thread_ct;
-    }
+    marker_bidx = 0;
+    marker_bceil = 0;
     loadbuf = g_loadbuf;
     is_invalid = g_is_invalid_bitfield;
     orig_pvals = g_orig_pvals;
@@ -5805,7 +5756,7 @@ THREAD_RET_TYPE model_adapt_best_thread(void* arg) {
     precomp_start = g_precomp_start;
     precomp_ui = g_precomp_ui;
 
-    for (; marker_bidx < marker_bceil; marker_bidx++) {
+    for (; (marker_bidx < marker_bceil) || ws_claim(tidx, 1, &marker_bidx, &marker_bceil); marker_bidx++) {
       marker_idx = g_adapt_m_table[marker_bidx];
       if (model_fisher) {
 	stat_high = orig_pvals[marker_idx] * (1.0 + EPSILON);
@@ -5954,7 +5905,6 @@ THREAD_RET_TYPE model_adapt_best_thread(void* arg) {
       }
       perm_2success_ct[marker_idx] += success_2incr;
     }
-  model_adapt_best_thread_skip_all:
     if ((!tidx) || g_is_last_thread_block) {
       THREAD_RETURN;
     }
@@ -6884,6 +6834,8 @@ int32_t model_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, cha
   double* orig_odds = NULL;
   double* precomp_d = NULL;
   unsigned char* perm_adapt_stop = NULL;
+  unsigned char* bed_prefetch_buf0 = NULL;
+  unsigned char* bed_prefetch_buf1 = NULL;
   double dxx = 0.0;
   double dww = 0.0;
   double dvv = 0.0;
@@ -6969,7 +6921,12 @@ int32_t model_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, cha
   double ca_p;
   char* a1ptr;
   char* a2ptr;
+  unsigned char* bed_row;
+  uintptr_t marker_ct_bed;
+  uint32_t use_prefetch;
   uint32_t loop_end;
+  Bed_prefetch bed_prefetch;
+  bed_prefetch.thread_active = 0;
   if (pheno_nm_ct < 2) {
     logprint("Warning: Skipping --assoc/--model since less than two phenotypes are present.\n");
     goto model_assoc_ret_1;
@@ -7035,6 +6992,9 @@ int32_t model_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, cha
     goto model_assoc_ret_NOMEM;
   }
   loadbuf_raw[unfiltered_sample_ctl2 - 1] = 0;
+  // --model skips MT/haploid variants without removing them from
+  // marker_exclude
+  marker_ct_bed = marker_ct;
   if (model_assoc) {
     if (model_fisher) {
       outname_end2 = memcpyb(outname_end, ".assoc.fisher", 14);
@@ -7440,10 +7400,22 @@ int32_t model_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, cha
   if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_sample_ct4, SEEK_SET)) {
     goto model_assoc_ret_READ_FAIL;
   }
+  // Only adaptive permutation passes after the first pick variants based on
+  // earlier results; everything else reads the .bed in order, so the next
+  // rows can be prefetched while this block is processed.
+  use_prefetch = 0;
+  if ((!model_adapt_nst) || (!perm_pass_idx)) {
+    uii = bed_prefetch_row_alloc(unfiltered_sample_ct4, &bed_prefetch_buf0, &bed_prefetch_buf1);
+    if (uii) {
+      bed_prefetch_init(&bed_prefetch, bedfile, bed_offset, marker_exclude, marker_uidx, 0, marker_ct_bed, uii, unfiltered_sample_ct4, bed_prefetch_buf0, bed_prefetch_buf1);
+      use_prefetch = 1;
+    }
+  }
   marker_idx = 0;
   marker_idx2 = 0;
   chrom_end = 0;
   loop_end = marker_ct / 100;
+  time_trace_push("model_assoc_blocks", marker_unstopped_ct);
   do {
     if (marker_uidx >= chrom_end) {
       g_block_start = 0;
@@ -7481,7 +7453,7 @@ int32_t model_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, cha
 	  }
 	  marker_uidx = next_unset_unsafe(marker_exclude, chrom_end);
 	}
-	if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_sample_ct4, SEEK_SET)) {
+	if ((!use_prefetch) && fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_sample_ct4, SEEK_SET)) {
 	  goto model_assoc_ret_READ_FAIL;
 	}
       }
@@ -7516,7 +7488,7 @@ int32_t model_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, cha
 	  next_unset_ul_unsafe_ck(marker_exclude, &marker_uidx);
 	  marker_idx2++;
 	} while ((marker_uidx < chrom_end) && perm_adapt_stop[marker_idx2]);
-	if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_sample_ct4, SEEK_SET)) {
+	if ((!use_prefetch) && fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_sample_ct4, SEEK_SET)) {
 	  goto model_assoc_ret_READ_FAIL;
 	}
 	if (marker_uidx >= chrom_end) {
@@ -7524,7 +7496,12 @@ int32_t model_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, cha
 	}
       }
       loadbuf_ptr = &(loadbuf[block_size * pheno_nm_ctv2]);
-      if (load_and_collapse_incl(bedfile, loadbuf_raw, unfiltered_sample_ct, loadbuf_ptr, pheno_nm_ct, pheno_nm, final_mask, IS_SET(marker_reverse, marker_uidx))) {
+      if (use_prefetch) {
+	if (bed_prefetch_row(&bed_prefetch, marker_uidx, &bed_row)) {
+	  goto model_assoc_ret_READ_FAIL;
+	}
+	copy_and_collapse_incl(bed_row, loadbuf_raw, unfiltered_sample_ct, loadbuf_ptr, pheno_nm_ct, pheno_nm, final_mask, IS_SET(marker_reverse, marker_uidx));
+      } else if (load_and_collapse_incl(bedfile, loadbuf_raw, unfiltered_sample_ct, loadbuf_ptr, pheno_nm_ct, pheno_nm, final_mask, IS_SET(marker_reverse, marker_uidx))) {
 	goto model_assoc_ret_READ_FAIL;
       }
       if (model_adapt_nst) {
@@ -7542,7 +7519,7 @@ int32_t model_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, cha
       marker_uidx++;
       if (IS_SET(marker_exclude, marker_uidx)) {
 	marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-	if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_sample_ct4, SEEK_SET)) {
+	if ((!use_prefetch) && fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_sample_ct4, SEEK_SET)) {
 	  goto model_assoc_ret_READ_FAIL;
 	}
       }
@@ -8187,6 +8164,7 @@ int32_t model_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, cha
       is_last_block = (marker_idx + block_size == marker_unstopped_ct);
       ulii = 0;
       if (model_adapt_nst) {
+	ws_ranges_init(max_thread_ct, g_block_start, g_block_diff);
 	if (model_assoc) {
 	  if (spawn_threads2(threads, &assoc_adapt_thread, max_thread_ct, is_last_block)) {
 	    goto model_assoc_ret_THREAD_CREATE_FAIL;
@@ -8280,6 +8258,11 @@ int32_t model_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, cha
       }
     }
   } while (marker_idx < marker_unstopped_ct);
+  time_trace_pop();
+  if (use_prefetch) {
+    bed_prefetch_cleanup(&bed_prefetch);
+    wkspace_reset(bed_prefetch_buf0);
+  }
   if (!perm_pass_idx) {
     if (pct >= 10) {
       putchar('\b');
@@ -8581,6 +8564,7 @@ int32_t model_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, cha
     break;
   }
  model_assoc_ret_1:
+  bed_prefetch_cleanup(&bed_prefetch);
   wkspace_reset(wkspace_mark);
   fclose_cond(outfile);
   fclose_cond(outfile_msa);
@@ -9282,6 +9266,7 @@ int32_t qassoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, char* ou
   marker_idx2 = 0;
   chrom_end = 0;
   loop_end = marker_ct / 100;
+  time_trace_push("qassoc_blocks", marker_unstopped_ct);
   do {
     if (marker_uidx >= chrom_end) {
       g_qblock_start = 0;
@@ -9649,6 +9634,13 @@ int32_t qassoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, char* ou
 	  }
 	}
       } else {
+	ukk = g_block_diff / CACHELINE_DBL;
+	if (ukk > max_thread_ct) {
+	  ukk = max_thread_ct;
+	} else if (!ukk) {
+	  ukk = 1;
+	}
+	ws_ranges_init(ukk, g_qblock_start, g_block_diff);
 	if (!do_lin) {
 	  if (spawn_threads2(threads, &qassoc_adapt_thread, max_thread_ct, is_last_block)) {
 	    goto qassoc_ret_THREAD_CREATE_FAIL;
@@ -9676,6 +9668,7 @@ int32_t qassoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, char* ou
       }
     }
   } while (marker_idx < marker_unstopped_ct);
+  time_trace_pop();
   if (!perm_pass_idx) {
     if (pct >= 10) {
       putchar('\b');
@@ -10624,7 +10617,6 @@ THREAD_RET_TYPE testmiss_adapt_thread(void* arg) {
   uintptr_t pheno_nm_ctl = (pheno_nm_ct + (BITCT - 1)) / BITCT;
   uintptr_t pheno_nm_ctv = (pheno_nm_ctl + 1) & (~1);
   uintptr_t perm_vec_ct = g_perm_vec_ct;
-  uint32_t max_thread_ct = g_assoc_thread_ct;
   uint32_t pidx_offset = g_perms_done;
   uint32_t is_midp = g_fisher_midp;
   uint32_t first_adapt_check = g_first_adapt_check;
@@ -10666,16 +10658,8 @@ THREAD_RET_TYPE testmiss_adapt_thread(void* arg) {
   double dyy;
   double dzz;
   while (1) {
-    if (g_block_diff <= max_thread_ct) {
-      if (g_block_diff <= tidx) {
-	goto testmiss_adapt_thread_skip_all;
-      }
-      marker_bidx = tidx;
-      marker_bceil = tidx + 1;
-    } else {
-      marker_bidx = (((uint64_t)tidx) * g_block_diff) / max_thread_ct;
-      marker_bceil = (((uint64_t)tidx + 1) * g_block_diff) / max_thread_ct;
-    }
+    marker_bidx = 0;
+    marker_bceil = 0;
     is_y = 0;
     if (g_is_y) {
       valid_obs_ct = g_male_ct;
@@ -10689,7 +10673,7 @@ THREAD_RET_TYPE testmiss_adapt_thread(void* arg) {
     loadbuf = g_loadbuf;
     precomp_ui = g_precomp_ui;
     missing_cts = g_missing_cts;
-    for (; marker_bidx < marker_bceil; marker_bidx++) {
+    for (; (marker_bidx < marker_bceil) || ws_claim(tidx, 1, &marker_bidx, &marker_bceil); marker_bidx++) {
       marker_idx = g_adapt_m_table[marker_bidx];
       next_adapt_check = first_adapt_check;
       gpui = &(precomp_ui[4 * marker_bidx]);
@@ -10747,7 +10731,6 @@ THREAD_RET_TYPE testmiss_adapt_thread(void* arg) {
       }
       perm_2success_ct[marker_idx] += success_2incr;
     }
-  testmiss_adapt_thread_skip_all:
     if ((!tidx) || g_is_last_thread_block) {
       THREAD_RETURN;
     }
@@ -11071,6 +11054,7 @@ int32_t testmiss(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, char*
     goto testmiss_ret_NOMEM;
   }
   dptr = g_orig_pvals;
+  time_trace_push("testmiss_variants", marker_ct_orig);
   for (marker_idx = 0; marker_idx < marker_ct_orig; marker_uidx++, marker_idx++) {
     if (IS_SET(marker_exclude_orig, marker_uidx)) {
       marker_uidx = next_unset_ul_unsafe(marker_exclude_orig, marker_uidx);
@@ -11138,6 +11122,7 @@ int32_t testmiss(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, char*
       goto testmiss_ret_WRITE_FAIL;
     }
   }
+  time_trace_pop();
   if (fclose_null(&outfile)) {
     goto testmiss_ret_WRITE_FAIL;
   }
@@ -11367,6 +11352,7 @@ int32_t testmiss(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, char*
     } else {
       marker_uidx_end = unfiltered_marker_ct;
     }
+    time_trace_push("testmiss_perm_blocks", marker_unstopped_ct);
     do {
       block_size = 0;
       block_end = marker_unstopped_ct - marker_idx;
@@ -11476,6 +11462,7 @@ int32_t testmiss(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, char*
       ulii = 0;
       is_last_block = (marker_idx + block_size >= marker_unstopped_ct);
       if (perm_adapt) {
+	ws_ranges_init(max_thread_ct, 0, g_block_diff);
 	if (spawn_threads2(threads, &testmiss_adapt_thread, max_thread_ct, is_last_block)) {
 	  goto testmiss_ret_THREAD_CREATE_FAIL;
 	}
@@ -11507,6 +11494,7 @@ int32_t testmiss(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, char*
       }
       marker_idx += block_size;
     } while (marker_idx < marker_unstopped_ct);
+    time_trace_pop();
     if (mperm_dump_all) {
       if (g_perms_done) {
 	putchar(' ');
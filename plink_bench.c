@@ -0,0 +1,558 @@
+// Standalone microbenchmark for PLINK's bit-level inner loops.  Each kernel
+// is run on synthetic data until at least --min-time seconds have elapsed,
+// and ns/op and GB/s (bytes touched per op, divided by time) are reported.
+// What counts as one "op" is kernel-specific and printed alongside; the
+// numbers are meant to be compared across builds and machines, not against
+// each other.
+//
+// Build with "make plink_bench" (links against every PLINK module except
+// plink.c).
+
+#include "plink_common.h"
+#include "plink_calc.h"
+#include "plink_ld.h"
+
+#define BENCH_DEFAULT_SAMPLE_CT 10000
+#define BENCH_DEFAULT_VARIANT_CT 2000
+#define BENCH_DEFAULT_MIN_TIME 0.5
+
+// sink for kernel return values, so nothing gets optimized away
+static volatile uintptr_t g_bench_sink;
+
+typedef struct {
+  uintptr_t sample_ct;
+  uintptr_t variant_ct;
+  uintptr_t sample_ctl2;
+  uintptr_t sample_ct4;
+  // variant_ct rows of sample_ctl2 words each, PLINK 2-bit encoding
+  uintptr_t* geno;
+  // 01 at every included position, zero past the end
+  uintptr_t* include2;
+  // ~10% of samples excluded, for collapse_copy_2bitarr()
+  uintptr_t* sample_exclude;
+  uintptr_t sample_exclude_ct;
+  uintptr_t* pheno_nm;
+  uintptr_t* pheno_c;
+  char* ids;
+  uintptr_t max_id_len;
+  FILE* bedfile;
+} Bench_data;
+
+typedef struct {
+  const char* name;
+  const char* op_desc;
+  // Performs at least *op_ct_ptr ops (kernels which only operate on whole
+  // batches round it up), returns bytes touched per op (0 on failure).
+  uintptr_t (*run)(Bench_data* bdp, uintptr_t* op_ct_ptr);
+} Bench_kernel;
+
+static uintptr_t bench_popcount_longs(Bench_data* bdp, uintptr_t* op_ct_ptr) {
+  uintptr_t op_ct = *op_ct_ptr;
+  uintptr_t variant_ct = bdp->variant_ct;
+  uintptr_t sample_ctl2 = bdp->sample_ctl2;
+  uintptr_t acc = 0;
+  uintptr_t op_idx;
+  for (op_idx = 0; op_idx < op_ct; op_idx++) {
+    acc += popcount_longs(&(bdp->geno[(op_idx % variant_ct) * sample_ctl2]), sample_ctl2);
+  }
+  g_bench_sink = acc;
+  return sample_ctl2 * sizeof(intptr_t);
+}
+
+static uintptr_t bench_vec_set_freq(Bench_data* bdp, uintptr_t* op_ct_ptr) {
+  uintptr_t op_ct = *op_ct_ptr;
+  uintptr_t variant_ct = bdp->variant_ct;
+  uintptr_t sample_ctl2 = bdp->sample_ctl2;
+  uintptr_t acc = 0;
+  uintptr_t op_idx;
+  uint32_t set_ct;
+  uint32_t missing_ct;
+  for (op_idx = 0; op_idx < op_ct; op_idx++) {
+    vec_set_freq(sample_ctl2, &(bdp->geno[(op_idx % variant_ct) * sample_ctl2]), bdp->include2, &set_ct, &missing_ct);
+    acc += set_ct + missing_ct;
+  }
+  g_bench_sink = acc;
+  return 2 * sample_ctl2 * sizeof(intptr_t);
+}
+
+static uintptr_t bench_vec_3freq(Bench_data* bdp, uintptr_t* op_ct_ptr) {
+  uintptr_t op_ct = *op_ct_ptr;
+  uintptr_t variant_ct = bdp->variant_ct;
+  uintptr_t sample_ctl2 = bdp->sample_ctl2;
+  uintptr_t acc = 0;
+  uintptr_t op_idx;
+  uint32_t missing_ct;
+  uint32_t het_ct;
+  uint32_t homa2_ct;
+  for (op_idx = 0; op_idx < op_ct; op_idx++) {
+    vec_3freq(sample_ctl2, &(bdp->geno[(op_idx % variant_ct) * sample_ctl2]), bdp->include2, &missing_ct, &het_ct, &homa2_ct);
+    acc += missing_ct + het_ct + homa2_ct;
+  }
+  g_bench_sink = acc;
+  return 2 * sample_ctl2 * sizeof(intptr_t);
+}
+
+static uintptr_t bench_load_and_split(Bench_data* bdp, uintptr_t* op_ct_ptr) {
+  // reads from a temporary file, so this is mostly a page cache + split
+  // benchmark
+  uintptr_t op_ct = *op_ct_ptr;
+  unsigned char* wkspace_mark = wkspace_base;
+  uintptr_t variant_ct = bdp->variant_ct;
+  uintptr_t sample_ctl2 = bdp->sample_ctl2;
+  uintptr_t acc = 0;
+  uintptr_t* rawbuf;
+  uintptr_t* casebuf;
+  uintptr_t* ctrlbuf;
+  uintptr_t op_idx;
+  if (wkspace_alloc_ul_checked(&rawbuf, sample_ctl2 * sizeof(intptr_t)) ||
+      wkspace_alloc_ul_checked(&casebuf, sample_ctl2 * sizeof(intptr_t)) ||
+      wkspace_alloc_ul_checked(&ctrlbuf, sample_ctl2 * sizeof(intptr_t))) {
+    return 0;
+  }
+  for (op_idx = 0; op_idx < op_ct; op_idx++) {
+    if (!(op_idx % variant_ct)) {
+      rewind(bdp->bedfile);
+    }
+    if (load_and_split(bdp->bedfile, rawbuf, bdp->sample_ct, casebuf, ctrlbuf, bdp->pheno_nm, bdp->pheno_c)) {
+      wkspace_reset(wkspace_mark);
+      return 0;
+    }
+    acc += casebuf[0] ^ ctrlbuf[0];
+  }
+  g_bench_sink = acc;
+  wkspace_reset(wkspace_mark);
+  return 2 * bdp->sample_ct4;
+}
+
+static uintptr_t bench_collapse_copy_2bitarr(Bench_data* bdp, uintptr_t* op_ct_ptr) {
+  uintptr_t op_ct = *op_ct_ptr;
+  unsigned char* wkspace_mark = wkspace_base;
+  uintptr_t variant_ct = bdp->variant_ct;
+  uintptr_t sample_ctl2 = bdp->sample_ctl2;
+  uintptr_t acc = 0;
+  uintptr_t* mainbuf;
+  uintptr_t op_idx;
+  if (wkspace_alloc_ul_checked(&mainbuf, sample_ctl2 * sizeof(intptr_t))) {
+    return 0;
+  }
+  for (op_idx = 0; op_idx < op_ct; op_idx++) {
+    collapse_copy_2bitarr(&(bdp->geno[(op_idx % variant_ct) * sample_ctl2]), mainbuf, bdp->sample_ct, bdp->sample_ct - bdp->sample_exclude_ct, bdp->sample_exclude);
+    acc += mainbuf[0];
+  }
+  g_bench_sink = acc;
+  wkspace_reset(wkspace_mark);
+  return bdp->sample_ct4 + (bdp->sample_ct - bdp->sample_exclude_ct + 3) / 4;
+}
+
+static uintptr_t bench_murmurhash3_32(Bench_data* bdp, uintptr_t* op_ct_ptr) {
+  uintptr_t op_ct = *op_ct_ptr;
+  uintptr_t variant_ct = bdp->variant_ct;
+  uintptr_t max_id_len = bdp->max_id_len;
+  uintptr_t total_len = 0;
+  uintptr_t acc = 0;
+  uintptr_t op_idx;
+  uintptr_t variant_idx;
+  for (variant_idx = 0; variant_idx < variant_ct; variant_idx++) {
+    total_len += strlen(&(bdp->ids[variant_idx * max_id_len]));
+  }
+  for (op_idx = 0; op_idx < op_ct; op_idx++) {
+    variant_idx = op_idx % variant_ct;
+    acc += murmurhash3_32(&(bdp->ids[variant_idx * max_id_len]), strlen(&(bdp->ids[variant_idx * max_id_len])));
+  }
+  g_bench_sink = acc;
+  return (total_len + variant_ct - 1) / variant_ct;
+}
+
+static uintptr_t bench_populate_id_htable(Bench_data* bdp, uintptr_t* op_ct_ptr) {
+  // one op = one inserted ID; the table is rebuilt from scratch every
+  // variant_ct ops
+  unsigned char* wkspace_mark = wkspace_base;
+  uintptr_t variant_ct = bdp->variant_ct;
+  uintptr_t variant_ctl = (variant_ct + (BITCT - 1)) / BITCT;
+  uint32_t id_htable_size = get_id_htable_size(variant_ct);
+  uintptr_t op_idx;
+  uintptr_t* variant_exclude;
+  uint32_t* id_htable;
+  if (wkspace_alloc_ul_checked(&variant_exclude, variant_ctl * sizeof(intptr_t)) ||
+      wkspace_alloc_ui_checked(&id_htable, id_htable_size * sizeof(int32_t))) {
+    return 0;
+  }
+  fill_ulong_zero(variant_exclude, variant_ctl);
+  for (op_idx = 0; op_idx < *op_ct_ptr; op_idx += variant_ct) {
+    if (populate_id_htable(variant_ct, variant_exclude, variant_ct, bdp->ids, bdp->max_id_len, 0, id_htable, id_htable_size)) {
+      wkspace_reset(wkspace_mark);
+      return 0;
+    }
+  }
+  *op_ct_ptr = op_idx;
+  g_bench_sink = id_htable[0];
+  wkspace_reset(wkspace_mark);
+  return bdp->max_id_len + sizeof(int32_t);
+}
+
+static void bench_ld_params(uintptr_t founder_ct, uint32_t* founder_ct_mld_m1_ptr, uint32_t* founder_ct_mld_rem_ptr, uintptr_t* founder_ct_192_long_ptr) {
+  // same as ld_prune()
+  uintptr_t founder_ct_mld = (founder_ct + MULTIPLEX_LD - 1) / MULTIPLEX_LD;
+  uint32_t founder_ct_mld_m1 = ((uint32_t)founder_ct_mld) - 1;
+#ifdef __LP64__
+  uint32_t founder_ct_mld_rem = (MULTIPLEX_LD / 192) - (founder_ct_mld * MULTIPLEX_LD - founder_ct) / 192;
+#else
+  uint32_t founder_ct_mld_rem = (MULTIPLEX_LD / 48) - (founder_ct_mld * MULTIPLEX_LD - founder_ct) / 48;
+#endif
+  *founder_ct_mld_m1_ptr = founder_ct_mld_m1;
+  *founder_ct_mld_rem_ptr = founder_ct_mld_rem;
+  *founder_ct_192_long_ptr = founder_ct_mld_m1 * (MULTIPLEX_LD / BITCT2) + founder_ct_mld_rem * (192 / BITCT2);
+}
+
+static int32_t bench_ld_load(Bench_data* bdp, uintptr_t founder_ct_192_long, uintptr_t** ld_geno_ptr, uintptr_t** ld_masks_ptr) {
+  // converts the first (up to) 64 variants to ld_process_load() encoding
+  uintptr_t row_ct = MINV(bdp->variant_ct, 64);
+  uintptr_t sample_ctl2 = bdp->sample_ctl2;
+  uintptr_t row_idx;
+  uintptr_t widx;
+  uintptr_t cur_geno;
+  uintptr_t shifted_masked_geno;
+  uintptr_t* ld_geno;
+  uintptr_t* ld_masks;
+  if (wkspace_alloc_ul_checked(ld_geno_ptr, row_ct * founder_ct_192_long * sizeof(intptr_t)) ||
+      wkspace_alloc_ul_checked(ld_masks_ptr, row_ct * founder_ct_192_long * sizeof(intptr_t))) {
+    return RET_NOMEM;
+  }
+  ld_geno = *ld_geno_ptr;
+  ld_masks = *ld_masks_ptr;
+  fill_ulong_zero(ld_geno, row_ct * founder_ct_192_long);
+  fill_ulong_zero(ld_masks, row_ct * founder_ct_192_long);
+  for (row_idx = 0; row_idx < row_ct; row_idx++) {
+    for (widx = 0; widx < sample_ctl2; widx++) {
+      cur_geno = bdp->geno[row_idx * sample_ctl2 + widx];
+      shifted_masked_geno = (cur_geno >> 1) & FIVEMASK;
+      ld_geno[row_idx * founder_ct_192_long + widx] = cur_geno - shifted_masked_geno;
+      ld_masks[row_idx * founder_ct_192_long + widx] = ((((~cur_geno) & FIVEMASK) | shifted_masked_geno) * 3) & (bdp->include2[widx] * 3);
+    }
+  }
+  return 0;
+}
+
+static uintptr_t bench_ld_dot_prod(Bench_data* bdp, uintptr_t* op_ct_ptr) {
+  // one op = one variant pair
+  uintptr_t op_ct = *op_ct_ptr;
+  unsigned char* wkspace_mark = wkspace_base;
+  uintptr_t row_ct = MINV(bdp->variant_ct, 64);
+  uintptr_t acc = 0;
+  uintptr_t founder_ct_192_long;
+  uintptr_t* ld_geno;
+  uintptr_t* ld_masks;
+  uintptr_t op_idx;
+  uintptr_t row1;
+  uintptr_t row2;
+  uint32_t founder_ct_mld_m1;
+  uint32_t founder_ct_mld_rem;
+  int32_t dp_result[5];
+  bench_ld_params(bdp->sample_ct, &founder_ct_mld_m1, &founder_ct_mld_rem, &founder_ct_192_long);
+  if (bench_ld_load(bdp, founder_ct_192_long, &ld_geno, &ld_masks)) {
+    return 0;
+  }
+  for (op_idx = 0; op_idx < op_ct; op_idx++) {
+    row1 = op_idx % row_ct;
+    row2 = (op_idx / row_ct) % row_ct;
+    memset(dp_result, 0, 5 * sizeof(int32_t));
+    ld_dot_prod(&(ld_geno[row1 * founder_ct_192_long]), &(ld_geno[row2 * founder_ct_192_long]), &(ld_masks[row1 * founder_ct_192_long]), &(ld_masks[row2 * founder_ct_192_long]), dp_result, founder_ct_mld_m1, founder_ct_mld_rem);
+    acc += dp_result[0];
+  }
+  g_bench_sink = acc;
+  wkspace_reset(wkspace_mark);
+  return 4 * founder_ct_192_long * sizeof(intptr_t);
+}
+
+static uintptr_t bench_ld_dot_prod_nm(Bench_data* bdp, uintptr_t* op_ct_ptr) {
+  uintptr_t op_ct = *op_ct_ptr;
+  unsigned char* wkspace_mark = wkspace_base;
+  uintptr_t row_ct = MINV(bdp->variant_ct, 64);
+  uintptr_t acc = 0;
+  uintptr_t founder_ct_192_long;
+  uintptr_t* ld_geno;
+  uintptr_t* ld_masks;
+  uintptr_t op_idx;
+  uintptr_t row1;
+  uintptr_t row2;
+  uint32_t founder_ct_mld_m1;
+  uint32_t founder_ct_mld_rem;
+  bench_ld_params(bdp->sample_ct, &founder_ct_mld_m1, &founder_ct_mld_rem, &founder_ct_192_long);
+  if (bench_ld_load(bdp, founder_ct_192_long, &ld_geno, &ld_masks)) {
+    return 0;
+  }
+  for (op_idx = 0; op_idx < op_ct; op_idx++) {
+    row1 = op_idx % row_ct;
+    row2 = (op_idx / row_ct) % row_ct;
+    acc += ld_dot_prod_nm(&(ld_geno[row1 * founder_ct_192_long]), &(ld_geno[row2 * founder_ct_192_long]), bdp->sample_ct, founder_ct_mld_m1, founder_ct_mld_rem);
+  }
+  g_bench_sink = acc;
+  wkspace_reset(wkspace_mark);
+  return 2 * founder_ct_192_long * sizeof(intptr_t);
+}
+
+static uintptr_t bench_incr_dists_i(Bench_data* bdp, uintptr_t* op_ct_ptr) {
+  // one op = one sample pair across a MULTIPLEX_DIST-variant block, i.e. one
+  // popcount_xor_..._multiword() call.  The sample count is capped at 4096 to
+  // keep the triangular distance buffer reasonable.
+  unsigned char* wkspace_mark = wkspace_base;
+  uintptr_t sample_ct = MINV(bdp->sample_ct, 4096);
+  uintptr_t block_wordct = MULTIPLEX_2DIST / BITCT;
+  uintptr_t pair_ct = (((uint64_t)sample_ct) * (sample_ct - 1)) / 2;
+  uintptr_t op_idx;
+  uintptr_t* dist_geno;
+  uintptr_t* dist_masks;
+  uint32_t* idists;
+  uintptr_t ulii;
+  if (wkspace_alloc_ul_checked(&dist_geno, sample_ct * block_wordct * sizeof(intptr_t)) ||
+      wkspace_alloc_ul_checked(&dist_masks, sample_ct * block_wordct * sizeof(intptr_t)) ||
+      wkspace_alloc_ui_checked(&idists, pair_ct * sizeof(int32_t))) {
+    return 0;
+  }
+  for (ulii = 0; ulii < sample_ct * block_wordct; ulii++) {
+    dist_geno[ulii] = bdp->geno[ulii % (bdp->variant_ct * bdp->sample_ctl2)];
+    // ~1/32 missing
+    dist_masks[ulii] = (sfmt_genrand_uint32(&sfmt) & 31)? ~ZEROLU : (~ZEROLU) << 2;
+  }
+  fill_uint_zero(idists, pair_ct);
+  for (op_idx = 0; op_idx < *op_ct_ptr; op_idx += pair_ct) {
+    incr_dists_i(idists, dist_geno, dist_masks, 0, sample_ct);
+  }
+  *op_ct_ptr = op_idx;
+  g_bench_sink = idists[pair_ct / 2];
+  wkspace_reset(wkspace_mark);
+  return 4 * block_wordct * sizeof(intptr_t);
+}
+
+static const Bench_kernel g_bench_kernels[] = {
+  {"popcount_longs", "variant", bench_popcount_longs},
+  {"vec_set_freq", "variant", bench_vec_set_freq},
+  {"vec_3freq", "variant", bench_vec_3freq},
+  {"load_and_split", "variant", bench_load_and_split},
+  {"collapse_copy_2bitarr", "variant", bench_collapse_copy_2bitarr},
+  {"murmurhash3_32", "ID", bench_murmurhash3_32},
+  {"populate_id_htable", "ID", bench_populate_id_htable},
+  {"ld_dot_prod", "variant pair", bench_ld_dot_prod},
+  {"ld_dot_prod_nm", "variant pair", bench_ld_dot_prod_nm},
+  {"incr_dists_i", "sample pair", bench_incr_dists_i}
+};
+
+#define BENCH_KERNEL_CT (sizeof(g_bench_kernels) / sizeof(Bench_kernel))
+
+static int32_t bench_kernel(const Bench_kernel* bkp, Bench_data* bdp, double min_time) {
+  // doubles the op count until a single timed run takes at least min_time
+  uintptr_t op_ct = 1;
+  uintptr_t cur_op_ct = 1;
+  uintptr_t bytes_per_op;
+  double start_time;
+  double elapsed;
+  double ns_per_op;
+  // warmup
+  if (!bkp->run(bdp, &cur_op_ct)) {
+    printf("%-22s  failed\n", bkp->name);
+    return RET_NOMEM;
+  }
+  while (1) {
+    cur_op_ct = op_ct;
+    start_time = time_trace_wall_now();
+    bytes_per_op = bkp->run(bdp, &cur_op_ct);
+    elapsed = time_trace_wall_now() - start_time;
+    if (!bytes_per_op) {
+      printf("%-22s  failed\n", bkp->name);
+      return RET_NOMEM;
+    }
+    if ((elapsed >= min_time) || (cur_op_ct >= (~ZEROLU) / 2)) {
+      break;
+    }
+    op_ct = cur_op_ct * 2;
+  }
+  ns_per_op = (elapsed * 1000000000.0) / ((double)cur_op_ct);
+  printf("%-22s  %12.2f  %8.3f  %" PRIuPTR " bytes/%s\n", bkp->name, ns_per_op, ((double)bytes_per_op) / ns_per_op, bytes_per_op, bkp->op_desc);
+  return 0;
+}
+
+static int32_t bench_data_init(Bench_data* bdp, uintptr_t sample_ct, uintptr_t variant_ct) {
+  uintptr_t sample_ctl2 = 2 * ((sample_ct + (BITCT - 1)) / BITCT);
+  uintptr_t sample_ctl = sample_ctl2 / 2;
+  uintptr_t sample_ct4 = (sample_ct + 3) / 4;
+  uintptr_t sample_exclude_ct = 0;
+  uintptr_t final_mask = get_final_mask(sample_ct);
+  uintptr_t row_idx;
+  uintptr_t widx;
+  uintptr_t sample_idx;
+  uintptr_t cur_word;
+  uint32_t uii;
+  bdp->sample_ct = sample_ct;
+  bdp->variant_ct = variant_ct;
+  bdp->sample_ctl2 = sample_ctl2;
+  bdp->sample_ct4 = sample_ct4;
+  bdp->max_id_len = 16;
+  bdp->bedfile = NULL;
+  if (wkspace_alloc_ul_checked(&(bdp->geno), variant_ct * sample_ctl2 * sizeof(intptr_t)) ||
+      wkspace_alloc_ul_checked(&(bdp->include2), sample_ctl2 * sizeof(intptr_t)) ||
+      wkspace_alloc_ul_checked(&(bdp->sample_exclude), sample_ctl * sizeof(intptr_t)) ||
+      wkspace_alloc_ul_checked(&(bdp->pheno_nm), sample_ctl * sizeof(intptr_t)) ||
+      wkspace_alloc_ul_checked(&(bdp->pheno_c), sample_ctl * sizeof(intptr_t)) ||
+      wkspace_alloc_c_checked(&(bdp->ids), variant_ct * bdp->max_id_len)) {
+    return RET_NOMEM;
+  }
+  // genotypes: ~5% missing, remainder split evenly between the other codes
+  for (row_idx = 0; row_idx < variant_ct; row_idx++) {
+    for (widx = 0; widx < sample_ctl2; widx++) {
+      cur_word = 0;
+      for (uii = 0; uii < BITCT2; uii++) {
+        sample_idx = widx * BITCT2 + uii;
+	if (sample_idx == sample_ct) {
+	  break;
+	}
+	if ((sfmt_genrand_uint32(&sfmt) % 20) == 0) {
+	  cur_word |= ONELU << (2 * uii);
+	} else {
+          cur_word |= ((uintptr_t)((sfmt_genrand_uint32(&sfmt) % 3) * 3 + 1) / 2) << (2 * uii);
+	}
+      }
+      bdp->geno[row_idx * sample_ctl2 + widx] = cur_word;
+    }
+    if (final_mask) {
+      bdp->geno[row_idx * sample_ctl2 + (sample_ct - 1) / BITCT2] &= final_mask;
+    }
+  }
+  fill_vec_55(bdp->include2, sample_ct);
+  fill_ulong_zero(bdp->sample_exclude, sample_ctl);
+  fill_ulong_zero(bdp->pheno_c, sample_ctl);
+  fill_all_bits(bdp->pheno_nm, sample_ct);
+  for (sample_idx = 0; sample_idx < sample_ct; sample_idx++) {
+    uii = sfmt_genrand_uint32(&sfmt);
+    if (!(uii % 10)) {
+      SET_BIT(bdp->sample_exclude, sample_idx);
+      sample_exclude_ct++;
+    }
+    if (uii & 0x80000000U) {
+      SET_BIT(bdp->pheno_c, sample_idx);
+    }
+  }
+  if (sample_exclude_ct == sample_ct) {
+    CLEAR_BIT(bdp->sample_exclude, 0);
+    sample_exclude_ct--;
+  }
+  bdp->sample_exclude_ct = sample_exclude_ct;
+  for (row_idx = 0; row_idx < variant_ct; row_idx++) {
+    sprintf(&(bdp->ids[row_idx * bdp->max_id_len]), "rs%" PRIuPTR, row_idx * 7 + 1000);
+  }
+  bdp->bedfile = tmpfile();
+  if (!bdp->bedfile) {
+    return RET_OPEN_FAIL;
+  }
+  for (row_idx = 0; row_idx < variant_ct; row_idx++) {
+    if (!fwrite(&(bdp->geno[row_idx * sample_ctl2]), sample_ct4, 1, bdp->bedfile)) {
+      return RET_WRITE_FAIL;
+    }
+  }
+  if (fflush(bdp->bedfile)) {
+    return RET_WRITE_FAIL;
+  }
+  return 0;
+}
+
+int32_t main(int32_t argc, char** argv) {
+  unsigned char* wkspace_ua = NULL;
+  uintptr_t sample_ct = BENCH_DEFAULT_SAMPLE_CT;
+  uintptr_t variant_ct = BENCH_DEFAULT_VARIANT_CT;
+  uintptr_t malloc_size_mb = 256;
+  double min_time = BENCH_DEFAULT_MIN_TIME;
+  uint32_t kernel_ct = 0;
+  int32_t retval = 0;
+  uint32_t kernel_idxs[BENCH_KERNEL_CT];
+  Bench_data bench_data;
+  double dxx;
+  uint32_t arg_idx;
+  uint32_t kernel_idx;
+  uint32_t uii;
+  bench_data.bedfile = NULL;
+  for (arg_idx = 1; arg_idx < (uint32_t)argc; arg_idx++) {
+    if ((!strcmp(argv[arg_idx], "--samples")) || (!strcmp(argv[arg_idx], "--variants"))) {
+      if ((arg_idx + 1 == (uint32_t)argc) || scan_posint_defcap(argv[arg_idx + 1], &uii)) {
+	goto main_ret_INVALID_CMDLINE;
+      }
+      if (argv[arg_idx][2] == 's') {
+	sample_ct = uii;
+      } else {
+	variant_ct = uii;
+      }
+      arg_idx++;
+    } else if (!strcmp(argv[arg_idx], "--min-time")) {
+      if ((arg_idx + 1 == (uint32_t)argc) || scan_double(argv[arg_idx + 1], &dxx) || (dxx < 0)) {
+	goto main_ret_INVALID_CMDLINE;
+      }
+      min_time = dxx;
+      arg_idx++;
+    } else if (!strcmp(argv[arg_idx], "--memory")) {
+      if ((arg_idx + 1 == (uint32_t)argc) || scan_posint_defcap(argv[arg_idx + 1], &uii)) {
+	goto main_ret_INVALID_CMDLINE;
+      }
+      malloc_size_mb = uii;
+      arg_idx++;
+    } else {
+      for (kernel_idx = 0; kernel_idx < BENCH_KERNEL_CT; kernel_idx++) {
+	if (!strcmp(argv[arg_idx], g_bench_kernels[kernel_idx].name)) {
+	  break;
+	}
+      }
+      if (kernel_idx == BENCH_KERNEL_CT) {
+	goto main_ret_INVALID_CMDLINE;
+      }
+      if (kernel_ct < BENCH_KERNEL_CT) {
+        kernel_idxs[kernel_ct++] = kernel_idx;
+      }
+    }
+  }
+  if (!kernel_ct) {
+    for (kernel_idx = 0; kernel_idx < BENCH_KERNEL_CT; kernel_idx++) {
+      kernel_idxs[kernel_idx] = kernel_idx;
+    }
+    kernel_ct = BENCH_KERNEL_CT;
+  }
+  wkspace_ua = (unsigned char*)malloc(malloc_size_mb * 1048576 * sizeof(char));
+  if (!wkspace_ua) {
+    goto main_ret_NOMEM;
+  }
+  wkspace_base = (unsigned char*)CACHEALIGN((uintptr_t)wkspace_ua);
+  wkspace_left = (malloc_size_mb * 1048576 - (uintptr_t)(wkspace_base - wkspace_ua)) & (~(CACHELINE - ONELU));
+#ifdef SIMD_DISPATCH
+  simd_dispatch_init();
+  printf("SIMD level: %s\n", (g_simd_level == SIMD_LEVEL_AVX512)? "AVX-512" : ((g_simd_level == SIMD_LEVEL_AVX2)? "AVX2" : "SSE2"));
+#endif
+  sfmt_init_gen_rand(&sfmt, 1);
+  retval = bench_data_init(&bench_data, sample_ct, variant_ct);
+  if (retval) {
+    goto main_ret_1;
+  }
+  printf("%" PRIuPTR " samples, %" PRIuPTR " variants, min time %g s\n", sample_ct, variant_ct, min_time);
+  printf("%-22s  %12s  %8s\n", "kernel", "ns/op", "GB/s");
+  for (kernel_idx = 0; kernel_idx < kernel_ct; kernel_idx++) {
+    retval = bench_kernel(&(g_bench_kernels[kernel_idxs[kernel_idx]]), &bench_data, min_time);
+    if (retval) {
+      goto main_ret_1;
+    }
+  }
+  while (0) {
+  main_ret_NOMEM:
+    fputs("Error: Out of memory.  Try a larger --memory value.\n", stderr);
+    retval = RET_NOMEM;
+    break;
+  main_ret_INVALID_CMDLINE:
+    fputs("Usage: plink_bench [--samples N] [--variants N] [--min-time sec] [--memory MB]\n                   [kernel name(s)...]\nKernels:", stderr);
+    for (kernel_idx = 0; kernel_idx < BENCH_KERNEL_CT; kernel_idx++) {
+      fprintf(stderr, " %s", g_bench_kernels[kernel_idx].name);
+    }
+    fputs("\n", stderr);
+    retval = RET_INVALID_CMDLINE;
+    break;
+  }
+ main_ret_1:
+  if (bench_data.bedfile) {
+    fclose(bench_data.bedfile);
+  }
+  free_cond(wkspace_ua);
+  return retval;
+}
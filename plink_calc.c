@@ -82,16 +82,6 @@
 // number of different types of jackknife values to precompute (x^2, x, y, xy)
 #define JACKKNIFE_VALS_REL 5
 
-// Number of snp-major .bed lines to read at once for distance calc if exponent
-// is zero.  Currently assumed to be a multiple of 192, and no larger than
-// 1920, by the popcount_..._multiword functions.  (The optimal value depends
-// on both system-specific properties such as cache sizes, as well as the
-// number of samples in the current calculation, so in principle it's best to
-// select this value at runtime.  But 960 usually works well in practice in my
-// experience.)
-#define MULTIPLEX_DIST 960
-#define MULTIPLEX_2DIST (MULTIPLEX_DIST * 2)
-
 // Must be multiple of 384, no larger than 3840.
 #define GENOME_MULTIPLEX 1152
 #define GENOME_MULTIPLEX2 (GENOME_MULTIPLEX * 2)
@@ -6628,34 +6618,6 @@ uint32_t calc_rel_grm_emitn(uint32_t overflow_ct, unsigned char* readbuf) {
   return (uintptr_t)(((unsigned char*)sptr_cur) - readbuf);
 }
 
-uint32_t block_load(FILE* bedfile, int32_t bed_offset, uintptr_t* marker_exclude, uint32_t marker_ct, uint32_t block_max_size, uintptr_t unfiltered_sample_ct4, unsigned char* readbuf, uintptr_t* marker_uidx_ptr, uintptr_t* marker_idx_ptr, uint32_t* block_size_ptr) {
-  uintptr_t marker_uidx = *marker_uidx_ptr;
-  uintptr_t marker_idx = *marker_idx_ptr;
-  uint32_t markers_read = 0;
-  if (block_max_size > marker_ct - marker_idx) {
-    block_max_size = marker_ct - marker_idx;
-  }
-  while (markers_read < block_max_size) {
-    if (IS_SET(marker_exclude, marker_uidx)) {
-      marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-      if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_sample_ct4, SEEK_SET)) {
-	return RET_READ_FAIL;
-      }
-    }
-    if (fread(&(readbuf[markers_read * unfiltered_sample_ct4]), 1, unfiltered_sample_ct4, bedfile) < unfiltered_sample_ct4) {
-      return RET_READ_FAIL;
-    }
-    markers_read++;
-    marker_idx++;
-    marker_uidx++;
-  }
-
-  *marker_uidx_ptr = marker_uidx;
-  *marker_idx_ptr = marker_idx;
-  *block_size_ptr = markers_read;
-  return 0;
-}
-
 void copy_set_allele_freqs(uintptr_t marker_uidx, uintptr_t* marker_exclude, uint32_t block_max_size, uintptr_t marker_idx, uint32_t marker_ct, uintptr_t* marker_reverse, double* set_allele_freqs, double* set_allele_freq_buf) {
   uint32_t markers_read = 0;
   if (block_max_size > marker_ct - marker_idx) {
@@ -6879,6 +6841,9 @@ int32_t calc_rel(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_to
   uint32_t* giptr;
   uint32_t* giptr2;
   uintptr_t* glptr2;
+  unsigned char* gptr_next;
+  Bed_prefetch bed_prefetch;
+  bed_prefetch.thread_active = 0;
   if (distance_wts_fname) {
     logprint("Error: --make-{rel,grm-gz,grm-bin} + --distance-wts is currently under\ndevelopment.\n");
     goto calc_rel_ret_1;
@@ -6946,6 +6911,7 @@ int32_t calc_rel(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_to
   if (wkspace_alloc_ul_checked(&geno, sample_ct * sizeof(intptr_t)) ||
       wkspace_alloc_ul_checked(&mmasks, sample_ct * sizeof(intptr_t)) ||
       wkspace_alloc_uc_checked(&gptr, MULTIPLEX_REL * unfiltered_sample_ct4) ||
+      wkspace_alloc_uc_checked(&gptr_next, MULTIPLEX_REL * unfiltered_sample_ct4) ||
       wkspace_alloc_ul_checked(&masks, sample_ct * sizeof(intptr_t)) ||
       wkspace_alloc_d_checked(&subset_weights, 2048 * BITCT * sizeof(double)) ||
       wkspace_alloc_uc_checked(&overflow_buf, 262144)) {
@@ -6975,12 +6941,14 @@ int32_t calc_rel(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_to
   // the (nonzero exponent) distance calculation is that we have to pad
   // each marker to 3 bits and use + instead of XOR to distinguish the
   // cases.
+  time_trace_push("rel_blocks", marker_ct);
+  bed_prefetch_init(&bed_prefetch, bedfile, bed_offset, marker_exclude, marker_uidx, marker_idx, marker_ct, MULTIPLEX_REL, unfiltered_sample_ct4, gptr, gptr_next);
   do {
     copy_set_allele_freqs(marker_uidx, marker_exclude, MULTIPLEX_REL, marker_idx, marker_ct, marker_reverse, set_allele_freqs, set_allele_freq_buf);
     if (main_weights) {
       main_weights_ptr = &(main_weights[marker_idx]);
     }
-    retval = block_load(bedfile, bed_offset, marker_exclude, marker_ct, MULTIPLEX_REL, unfiltered_sample_ct4, gptr, &marker_uidx, &marker_idx, &cur_markers_loaded);
+    retval = bed_prefetch_next(&bed_prefetch, &gptr, &marker_uidx, &marker_idx, &cur_markers_loaded);
     if (retval) {
       goto calc_rel_ret_1;
     }
@@ -7051,6 +7019,8 @@ int32_t calc_rel(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_to
     printf("\r%" PRIuPTR " markers complete.", marker_idx);
     fflush(stdout);
   } while (!is_last_block);
+  bed_prefetch_cleanup(&bed_prefetch);
+  time_trace_pop();
   if (rel_req) {
     putchar('\r');
     logprint("Relationship matrix calculation complete.\n");
@@ -7434,6 +7404,7 @@ int32_t calc_rel(pthread_t* threads, uint32_t parallel_idx, uint32_t parallel_to
     break;
   }
  calc_rel_ret_1:
+  bed_prefetch_cleanup(&bed_prefetch);
   wkspace_reset(wkspace_mark);
   fclose_cond(outfile);
   fclose_cond(out_bin_nfile);
@@ -7915,7 +7886,10 @@ int32_t calc_ibm(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, uintpt
   uint32_t umm;
   uint32_t unn;
   uintptr_t* glptr;
+  unsigned char* bedbuf_next;
   int64_t llxx;
+  Bed_prefetch bed_prefetch;
+  bed_prefetch.thread_active = 0;
   g_sample_ct = sample_ct;
   if (dist_thread_ct > sample_ct / 32) {
     dist_thread_ct = sample_ct / 32;
@@ -7936,7 +7910,8 @@ int32_t calc_ibm(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, uintpt
   wkspace_mark = wkspace_base;
 
   if (wkspace_alloc_ul_checked(&mmasks, sample_ct * sizeof(intptr_t)) ||
-      wkspace_alloc_uc_checked(&bedbuf, MULTIPLEX_DIST * unfiltered_sample_ct4)) {
+      wkspace_alloc_uc_checked(&bedbuf, MULTIPLEX_DIST * unfiltered_sample_ct4) ||
+      wkspace_alloc_uc_checked(&bedbuf_next, MULTIPLEX_DIST * unfiltered_sample_ct4)) {
     goto calc_ibm_ret_NOMEM;
   }
   g_mmasks = mmasks;
@@ -7946,8 +7921,10 @@ int32_t calc_ibm(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, uintpt
     goto calc_ibm_ret_1;
   }
   marker_ct -= uii;
+  time_trace_push("ibm_blocks", marker_ct);
+  bed_prefetch_init(&bed_prefetch, bedfile, bed_offset, marker_exclude, marker_uidx, marker_idx, marker_ct, MULTIPLEX_DIST, unfiltered_sample_ct4, bedbuf, bedbuf_next);
   do {
-    retval = block_load(bedfile, bed_offset, marker_exclude, marker_ct, MULTIPLEX_DIST, unfiltered_sample_ct4, bedbuf, &marker_uidx, &marker_idx, &ujj);
+    retval = bed_prefetch_next(&bed_prefetch, &bedbuf, &marker_uidx, &marker_idx, &ujj);
     if (retval) {
       goto calc_ibm_ret_1;
     }
@@ -7996,6 +7973,8 @@ int32_t calc_ibm(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, uintpt
     fflush(stdout);
   } while (!is_last_block);
   putchar('\r');
+  bed_prefetch_cleanup(&bed_prefetch);
+  time_trace_pop();
   wkspace_reset(wkspace_mark);
   while (0) {
   calc_ibm_ret_NOMEM:
@@ -8006,6 +7985,7 @@ int32_t calc_ibm(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, uintpt
     break;
   }
  calc_ibm_ret_1:
+  bed_prefetch_cleanup(&bed_prefetch);
   // caller will free memory if there was an error
   return retval;
 }
@@ -8067,7 +8047,10 @@ int32_t calc_distance(pthread_t* threads, uint32_t parallel_idx, uint32_t parall
   double dxx;
   double dyy;
   uint32_t multiplex;
+  unsigned char* bedbuf_next;
   int64_t llxx;
+  Bed_prefetch bed_prefetch;
+  bed_prefetch.thread_active = 0;
   g_sample_ct = sample_ct;
   if (dist_thread_ct > sample_ct / 32) {
     dist_thread_ct = sample_ct / 32;
@@ -8234,7 +8217,8 @@ int32_t calc_distance(pthread_t* threads, uint32_t parallel_idx, uint32_t parall
   g_masks = masks;
   g_mmasks = mmasks;
 
-  if (wkspace_alloc_uc_checked(&bedbuf, multiplex * unfiltered_sample_ct4)) {
+  if (wkspace_alloc_uc_checked(&bedbuf, multiplex * unfiltered_sample_ct4) ||
+      wkspace_alloc_uc_checked(&bedbuf_next, multiplex * unfiltered_sample_ct4)) {
     goto calc_distance_ret_NOMEM;
   }
   if (main_weights) {
@@ -8253,6 +8237,8 @@ int32_t calc_distance(pthread_t* threads, uint32_t parallel_idx, uint32_t parall
   fseeko(bedfile, bed_offset, SEEK_SET);
   marker_uidx = 0;
   marker_idx = 0;
+  time_trace_push("distance_blocks", marker_ct);
+  bed_prefetch_init(&bed_prefetch, bedfile, bed_offset, marker_exclude, marker_uidx, marker_idx, marker_ct, multiplex, unfiltered_sample_ct4, bedbuf, bedbuf_next);
   do {
     for (ujj = 0; ujj < multiplex; ujj++) {
       set_allele_freq_buf[ujj] = 0.5;
@@ -8310,7 +8296,7 @@ int32_t calc_distance(pthread_t* threads, uint32_t parallel_idx, uint32_t parall
       }
       memcpy(wtbuf, &(dist_missing_wts_i[marker_idx]), uii * sizeof(int32_t));
     }
-    retval = block_load(bedfile, bed_offset, marker_exclude, marker_ct, multiplex, unfiltered_sample_ct4, bedbuf, &marker_uidx, &marker_idx, &ujj);
+    retval = bed_prefetch_next(&bed_prefetch, &bedbuf, &marker_uidx, &marker_idx, &ujj);
     if (retval) {
       goto calc_distance_ret_1;
     }
@@ -8455,6 +8441,8 @@ int32_t calc_distance(pthread_t* threads, uint32_t parallel_idx, uint32_t parall
     printf("\r%" PRIuPTR " markers complete.", marker_idx);
     fflush(stdout);
   } while (!is_last_block);
+  bed_prefetch_cleanup(&bed_prefetch);
+  time_trace_pop();
   putchar('\r');
   logprint("Distance matrix calculation complete.\n");
   wkspace_reset(masks);
@@ -8663,6 +8651,7 @@ int32_t calc_distance(pthread_t* threads, uint32_t parallel_idx, uint32_t parall
     break;
   }
  calc_distance_ret_1:
+  bed_prefetch_cleanup(&bed_prefetch);
   fclose_cond(outfile);
   fclose_cond(outfile2);
   fclose_cond(outfile3);
@@ -20,6 +20,16 @@
 #define REL_PCA_TABS 0x400
 #define REL_PCA_VAR_WTS 0x800
 
+// Number of snp-major .bed lines to read at once for distance calc if exponent
+// is zero.  Currently assumed to be a multiple of 192, and no larger than
+// 1920, by the popcount_..._multiword functions.  (The optimal value depends
+// on both system-specific properties such as cache sizes, as well as the
+// number of samples in the current calculation, so in principle it's best to
+// select this value at runtime.  But 960 usually works well in practice in my
+// experience.)
+#define MULTIPLEX_DIST 960
+#define MULTIPLEX_2DIST (MULTIPLEX_DIST * 2)
+
 typedef struct {
   uint32_t modifier;
   uint32_t regress_rel_d;
@@ -39,6 +49,9 @@ extern uint32_t* g_sample_missing_unwt;
 extern uint32_t* g_missing_dbl_excluded;
 extern double* g_dists;
 
+// IBS distance inner loop; also exercised by plink_bench.
+void incr_dists_i(uint32_t* idists, uintptr_t* geno, uintptr_t* masks, uint32_t start_idx, uint32_t end_idx);
+
 void rel_init(Rel_info* relip);
 
 void rel_cleanup(Rel_info* relip);
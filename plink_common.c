@@ -1,5 +1,13 @@
 #include "plink_common.h"
 
+#ifndef _WIN32
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/resource.h>
+  #include <sys/time.h>
+  #include <unistd.h>
+#endif
+
 #include "pigz.h"
 
 // no leading \n since this is used in LOGPRINTFWW expressions
@@ -3666,6 +3674,7 @@ int32_t populate_id_htable(uintptr_t unfiltered_ct, uintptr_t* exclude_arr, uint
   uint32_t* extra_alloc_base = (uint32_t*)wkspace_base;
   uint32_t item_idx = 0;
   const char* sptr;
+  char* tptr;
   uintptr_t prev_uidx;
   uint32_t max_extra_alloc;
   uint32_t slen;
@@ -3688,7 +3697,14 @@ int32_t populate_id_htable(uintptr_t unfiltered_ct, uintptr_t* exclude_arr, uint
 	  id_htable[hashval] = item_uidx;
 	  break;
 	} else if (!memcmp(sptr, &(item_ids[hash_result * max_id_len]), slen + 1)) {
-	  LOGPRINTFWW("Error: Duplicate ID '%s'.\n", sptr);
+	  // sample IDs are stored as FID<tab>IID; report them space-separated
+	  sprintf(logbuf, "Error: Duplicate ID '%s'.\n", sptr);
+	  tptr = strchr(&(logbuf[21]), '\t');
+	  if (tptr) {
+	    *tptr = ' ';
+	  }
+	  wordwrap(logbuf, 0);
+	  logprintb();
 	  return RET_INVALID_FORMAT;
 	}
 	// defend against overflow
@@ -3794,6 +3810,204 @@ uint32_t id_htable_find(const char* id_buf, uintptr_t cur_id_len, const uint32_t
   }
 }
 
+void file_stamp_init(const struct stat* stat_ptr, File_stamp* stamp_ptr) {
+  // memset so the struct can be compared/written with no stray padding bytes
+  memset(stamp_ptr, 0, sizeof(File_stamp));
+  stamp_ptr->size = (uint64_t)stat_ptr->st_size;
+  stamp_ptr->mtime = (int64_t)stat_ptr->st_mtime;
+  stamp_ptr->ctime = (int64_t)stat_ptr->st_ctime;
+#if defined(__APPLE__)
+  stamp_ptr->mtime_nsec = (int64_t)stat_ptr->st_mtimespec.tv_nsec;
+  stamp_ptr->ctime_nsec = (int64_t)stat_ptr->st_ctimespec.tv_nsec;
+#elif !defined(_WIN32)
+  stamp_ptr->mtime_nsec = (int64_t)stat_ptr->st_mtim.tv_nsec;
+  stamp_ptr->ctime_nsec = (int64_t)stat_ptr->st_ctim.tv_nsec;
+#endif
+}
+
+uint32_t file_stamp_matches(const File_stamp* stamp_ptr, const struct stat* stat_ptr) {
+  File_stamp cur_stamp;
+  file_stamp_init(stat_ptr, &cur_stamp);
+  return !memcmp(stamp_ptr, &cur_stamp, sizeof(File_stamp));
+}
+
+uint32_t g_id_index = 0;
+
+#ifndef _WIN32
+static unsigned char* g_id_index_base = NULL;
+static uintptr_t g_id_index_size = 0;
+
+#define ID_INDEX_MAGIC "PLKIDX02"
+
+// File layout: this header and then the hash table, each padded to a cache
+// line boundary, then the duplicate-ID linked lists.  The table and lists are
+// exactly the wkspace layout populate_id_htable() produces with allow_dups
+// set, so extract_exclude_flag_norange() can locate the lists the usual way.
+typedef struct {
+  char magic[8];
+  File_stamp src_stamp;
+  uint64_t file_size;
+  uint32_t item_ct;
+  uint32_t id_htable_size;
+  uint32_t extra_alloc;
+  uint32_t word_size;
+} Id_index_header;
+
+#define ID_INDEX_HDR_SIZE CACHEALIGN(sizeof(Id_index_header))
+
+static uint32_t id_index_write(char* idxname, struct stat* src_stat_ptr, uintptr_t item_ct, uint32_t* id_htable, uint32_t id_htable_size, uint32_t extra_alloc) {
+  FILE* outfile = NULL;
+  uint32_t slen = strlen(idxname);
+  uint32_t retval = 1;
+  Id_index_header hdr;
+  char* tmpname;
+  memset(&hdr, 0, sizeof(Id_index_header));
+  memcpy(hdr.magic, ID_INDEX_MAGIC, 8);
+  file_stamp_init(src_stat_ptr, &hdr.src_stamp);
+  hdr.item_ct = item_ct;
+  hdr.id_htable_size = id_htable_size;
+  hdr.extra_alloc = extra_alloc;
+  hdr.word_size = sizeof(intptr_t);
+  hdr.file_size = ID_INDEX_HDR_SIZE + (CACHEALIGN32_INT32(id_htable_size) + (uint64_t)extra_alloc) * sizeof(int32_t);
+  tmpname = (char*)malloc(slen + 5);
+  if (!tmpname) {
+    return 1;
+  }
+  memcpy(memcpya(tmpname, idxname, slen), ".tmp", 5);
+  outfile = fopen(tmpname, "wb");
+  if (!outfile) {
+    goto id_index_write_ret_1;
+  }
+  // pad entries between the table and the lists are written as-is; nothing
+  // ever reads them
+  memset(tbuf, 0, ID_INDEX_HDR_SIZE);
+  memcpy(tbuf, &hdr, sizeof(Id_index_header));
+  if ((!fwrite(tbuf, ID_INDEX_HDR_SIZE, 1, outfile)) ||
+      (!fwrite(id_htable, (CACHEALIGN32_INT32(id_htable_size) + (uintptr_t)extra_alloc) * sizeof(int32_t), 1, outfile))) {
+    goto id_index_write_ret_1;
+  }
+  if (fclose_null(&outfile)) {
+    goto id_index_write_ret_1;
+  }
+  if (!rename(tmpname, idxname)) {
+    retval = 0;
+  }
+ id_index_write_ret_1:
+  if (outfile) {
+    fclose(outfile);
+  }
+  if (retval) {
+    unlink(tmpname);
+  }
+  free(tmpname);
+  return retval;
+}
+
+static uint32_t* id_index_map(char* idxname, struct stat* src_stat_ptr, uintptr_t item_ct, uint32_t* id_htable_size_ptr, uint32_t* extra_alloc_ptr) {
+  int32_t fd = open(idxname, O_RDONLY);
+  unsigned char* map_base;
+  Id_index_header* hdrp;
+  struct stat idx_stat;
+  uintptr_t map_size;
+  if (fd == -1) {
+    return NULL;
+  }
+  if (fstat(fd, &idx_stat) || ((uint64_t)idx_stat.st_size < ID_INDEX_HDR_SIZE)) {
+    close(fd);
+    return NULL;
+  }
+  map_size = (uintptr_t)idx_stat.st_size;
+  if ((uint64_t)map_size != (uint64_t)idx_stat.st_size) {
+    close(fd);
+    return NULL;
+  }
+  map_base = (unsigned char*)mmap(NULL, map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map_base == (unsigned char*)MAP_FAILED) {
+    return NULL;
+  }
+  hdrp = (Id_index_header*)map_base;
+  if (memcmp(hdrp->magic, ID_INDEX_MAGIC, 8) || (hdrp->word_size != sizeof(intptr_t)) || (!file_stamp_matches(&(hdrp->src_stamp), src_stat_ptr)) || (hdrp->file_size != (uint64_t)map_size) || (hdrp->item_ct != item_ct) || (hdrp->id_htable_size != get_id_htable_size(item_ct))) {
+    munmap(map_base, map_size);
+    return NULL;
+  }
+  madvise(map_base, map_size, MADV_RANDOM);
+  *id_htable_size_ptr = hdrp->id_htable_size;
+  *extra_alloc_ptr = hdrp->extra_alloc;
+  g_id_index_base = map_base;
+  g_id_index_size = map_size;
+  return (uint32_t*)(&(map_base[ID_INDEX_HDR_SIZE]));
+}
+#endif
+
+uint32_t id_index_init(char* srcname, uintptr_t item_ct, uintptr_t* exclude_arr, const char* item_ids, uintptr_t max_id_len, uint32_t allow_dups, uint32_t** id_htable_ptr, uint32_t* id_htable_size_ptr) {
+#ifdef _WIN32
+  return 1;
+#else
+  unsigned char* wkspace_mark = wkspace_base;
+  uint32_t slen = strlen(srcname);
+  uint32_t retval = 1;
+  char* idxname;
+  uint32_t* id_htable;
+  struct stat src_stat;
+  uint32_t id_htable_size;
+  uint32_t extra_alloc;
+  uint32_t uii;
+  if (stat(srcname, &src_stat)) {
+    return 1;
+  }
+  idxname = (char*)malloc(slen + 5);
+  if (!idxname) {
+    return 1;
+  }
+  memcpy(memcpya(idxname, srcname, slen), ".idx", 5);
+  id_htable = id_index_map(idxname, &src_stat, item_ct, &id_htable_size, &extra_alloc);
+  if (!id_htable) {
+    LOGPRINTFWW5("--id-index: Writing %s ... ", idxname);
+    // always built with duplicate-ID lists, so the same file serves both
+    // --extract/--exclude and the update commands
+    if (alloc_and_populate_id_htable(item_ct, exclude_arr, item_ct, item_ids, max_id_len, 1, &id_htable, &id_htable_size)) {
+      wkspace_reset(wkspace_mark);
+      logprint("failed.\n");
+      goto id_index_init_ret_1;
+    }
+    extra_alloc = ((uintptr_t)(wkspace_base - ((unsigned char*)id_htable))) / sizeof(int32_t) - CACHEALIGN32_INT32(id_htable_size);
+    uii = id_index_write(idxname, &src_stat, item_ct, id_htable, id_htable_size, extra_alloc);
+    wkspace_reset(wkspace_mark);
+    if (uii) {
+      logprint("failed.\n");
+      goto id_index_init_ret_1;
+    }
+    logprint("done.\n");
+    id_htable = id_index_map(idxname, &src_stat, item_ct, &id_htable_size, &extra_alloc);
+    if (!id_htable) {
+      goto id_index_init_ret_1;
+    }
+  }
+  if (extra_alloc && (!allow_dups)) {
+    // let populate_id_htable() report the duplicate
+    id_index_cleanup();
+    goto id_index_init_ret_1;
+  }
+  *id_htable_ptr = id_htable;
+  *id_htable_size_ptr = id_htable_size;
+  retval = 0;
+ id_index_init_ret_1:
+  free(idxname);
+  return retval;
+#endif
+}
+
+void id_index_cleanup() {
+#ifndef _WIN32
+  if (g_id_index_base) {
+    munmap(g_id_index_base, g_id_index_size);
+    g_id_index_base = NULL;
+    g_id_index_size = 0;
+  }
+#endif
+}
+
 void fill_idx_to_uidx(uintptr_t* exclude_arr, uintptr_t unfiltered_item_ct, uintptr_t item_ct, uint32_t* idx_to_uidx) {
   uint32_t* idx_to_uidx_end = &(idx_to_uidx[item_ct]);
   uint32_t item_uidx = 0;
@@ -5673,6 +5887,296 @@ static inline uintptr_t popcount_vecs_intersect(__m128i* vptr1, __m128i* vptr2,
 }
 #endif
 
+#ifdef SIMD_DISPATCH
+uint32_t g_simd_level = SIMD_LEVEL_SSE2;
+
+void simd_dispatch_init() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+    g_simd_level = SIMD_LEVEL_AVX2;
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vpopcntdq")) {
+      g_simd_level = SIMD_LEVEL_AVX512;
+    }
+  }
+}
+
+// Unlike the SSE2 kernels, these have no alignment or length-multiple
+// requirements, and their accumulators cannot overflow, so callers' block
+// sizes are irrelevant to them.
+TARGET_AVX2 static uintptr_t popcount_longs_avx2(uintptr_t* lptr, uintptr_t word_ct) {
+  uintptr_t* lptr_end = &(lptr[word_ct]);
+  uintptr_t* lptr_4x_end = &(lptr[word_ct & (~(3 * ONELU))]);
+  __m256i acc = _mm256_setzero_si256();
+  uintptr_t tot;
+  while (lptr < lptr_4x_end) {
+    acc = _mm256_add_epi64(acc, popcount_epi64_avx2(_mm256_loadu_si256((__m256i*)lptr)));
+    lptr = &(lptr[4]);
+  }
+  tot = hsum_epi64_avx2(acc);
+  while (lptr < lptr_end) {
+    tot += popcount_long_hw(*lptr++);
+  }
+  return tot;
+}
+
+TARGET_AVX512 static uintptr_t popcount_longs_avx512(uintptr_t* lptr, uintptr_t word_ct) {
+  __m512i acc = _mm512_setzero_si512();
+  while (word_ct >= 8) {
+    acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_loadu_si512(lptr)));
+    lptr = &(lptr[8]);
+    word_ct -= 8;
+  }
+  if (word_ct) {
+    acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_maskz_loadu_epi64((__mmask8)((1U << word_ct) - 1), lptr)));
+  }
+  return hsum_epi64_avx512(acc);
+}
+
+TARGET_AVX2 static uintptr_t popcount2_longs_avx2(uintptr_t* lptr, uintptr_t word_ct) {
+  uintptr_t* lptr_end = &(lptr[word_ct]);
+  uintptr_t* lptr_4x_end = &(lptr[word_ct & (~(3 * ONELU))]);
+  __m256i acc = _mm256_setzero_si256();
+  uintptr_t tot;
+  while (lptr < lptr_4x_end) {
+    acc = _mm256_add_epi64(acc, popcount2_epi64_avx2(_mm256_loadu_si256((__m256i*)lptr)));
+    lptr = &(lptr[4]);
+  }
+  tot = hsum_epi64_avx2(acc);
+  while (lptr < lptr_end) {
+    tot += popcount2_long_hw(*lptr++);
+  }
+  return tot;
+}
+
+TARGET_AVX512 static uintptr_t popcount2_longs_avx512(uintptr_t* lptr, uintptr_t word_ct) {
+  __m512i acc = _mm512_setzero_si512();
+  while (word_ct >= 8) {
+    acc = _mm512_add_epi64(acc, popcount2_epi64_avx512(_mm512_loadu_si512(lptr)));
+    lptr = &(lptr[8]);
+    word_ct -= 8;
+  }
+  if (word_ct) {
+    acc = _mm512_add_epi64(acc, popcount2_epi64_avx512(_mm512_maskz_loadu_epi64((__mmask8)((1U << word_ct) - 1), lptr)));
+  }
+  return hsum_epi64_avx512(acc);
+}
+
+// The genotype-count kernels below compute exactly what the SSE2 versions
+// do, under the same assumption that the masks only have even bits set.
+TARGET_AVX2 static void count_2freq_dbl_avx2(uintptr_t* lptr, uintptr_t word_ct, uintptr_t* mask1p, uintptr_t* mask2p, uint32_t* ct1abp, uint32_t* ct1cp, uint32_t* ct2abp, uint32_t* ct2cp) {
+  uintptr_t* lptr_end = &(lptr[word_ct]);
+  uintptr_t* lptr_4x_end = &(lptr[word_ct & (~(3 * ONELU))]);
+  __m256i acc1_ab = _mm256_setzero_si256();
+  __m256i acc1_c = _mm256_setzero_si256();
+  __m256i acc2_ab = _mm256_setzero_si256();
+  __m256i acc2_c = _mm256_setzero_si256();
+  __m256i loader;
+  __m256i loader_hi;
+  __m256i loader2;
+  __m256i loader3;
+  uintptr_t ulii;
+  uintptr_t uljj;
+  uintptr_t ulkk;
+  while (lptr < lptr_4x_end) {
+    loader = _mm256_loadu_si256((__m256i*)lptr);
+    loader_hi = _mm256_srli_epi64(loader, 1);
+    loader2 = _mm256_loadu_si256((__m256i*)mask1p);
+    loader3 = _mm256_and_si256(loader2, loader_hi);
+    loader2 = _mm256_and_si256(loader2, loader);
+    acc1_ab = _mm256_add_epi64(acc1_ab, popcount2_epi64_avx2(_mm256_add_epi64(loader3, loader2)));
+    acc1_c = _mm256_add_epi64(acc1_c, popcount_epi64_avx2(_mm256_andnot_si256(loader3, loader2)));
+    loader2 = _mm256_loadu_si256((__m256i*)mask2p);
+    loader3 = _mm256_and_si256(loader2, loader_hi);
+    loader2 = _mm256_and_si256(loader2, loader);
+    acc2_ab = _mm256_add_epi64(acc2_ab, popcount2_epi64_avx2(_mm256_add_epi64(loader3, loader2)));
+    acc2_c = _mm256_add_epi64(acc2_c, popcount_epi64_avx2(_mm256_andnot_si256(loader3, loader2)));
+    lptr = &(lptr[4]);
+    mask1p = &(mask1p[4]);
+    mask2p = &(mask2p[4]);
+  }
+  *ct1abp += hsum_epi64_avx2(acc1_ab);
+  *ct1cp += hsum_epi64_avx2(acc1_c);
+  *ct2abp += hsum_epi64_avx2(acc2_ab);
+  *ct2cp += hsum_epi64_avx2(acc2_c);
+  while (lptr < lptr_end) {
+    ulii = *lptr++;
+    uljj = *mask1p++;
+    ulkk = uljj & (ulii >> 1);
+    uljj &= ulii;
+    *ct1abp += popcount2_long_hw(ulkk + uljj);
+    *ct1cp += popcount_long_hw(uljj & (~ulkk));
+    uljj = *mask2p++;
+    ulkk = uljj & (ulii >> 1);
+    uljj &= ulii;
+    *ct2abp += popcount2_long_hw(ulkk + uljj);
+    *ct2cp += popcount_long_hw(uljj & (~ulkk));
+  }
+}
+
+TARGET_AVX512 static void count_2freq_dbl_avx512(uintptr_t* lptr, uintptr_t word_ct, uintptr_t* mask1p, uintptr_t* mask2p, uint32_t* ct1abp, uint32_t* ct1cp, uint32_t* ct2abp, uint32_t* ct2cp) {
+  __m512i acc1_ab = _mm512_setzero_si512();
+  __m512i acc1_c = _mm512_setzero_si512();
+  __m512i acc2_ab = _mm512_setzero_si512();
+  __m512i acc2_c = _mm512_setzero_si512();
+  __m512i loader;
+  __m512i loader_hi;
+  __m512i loader2;
+  __m512i loader3;
+  __mmask8 load_mask = 0xff;
+  while (word_ct) {
+    if (word_ct < 8) {
+      load_mask = (__mmask8)((1U << word_ct) - 1);
+      word_ct = 8;
+    }
+    loader = _mm512_maskz_loadu_epi64(load_mask, lptr);
+    loader_hi = srli1_epi64_avx512(loader);
+    loader2 = _mm512_maskz_loadu_epi64(load_mask, mask1p);
+    loader3 = _mm512_and_si512(loader2, loader_hi);
+    loader2 = _mm512_and_si512(loader2, loader);
+    acc1_ab = _mm512_add_epi64(acc1_ab, popcount2_epi64_avx512(_mm512_add_epi64(loader3, loader2)));
+    acc1_c = _mm512_add_epi64(acc1_c, _mm512_popcnt_epi64(andnot_avx512(loader3, loader2)));
+    loader2 = _mm512_maskz_loadu_epi64(load_mask, mask2p);
+    loader3 = _mm512_and_si512(loader2, loader_hi);
+    loader2 = _mm512_and_si512(loader2, loader);
+    acc2_ab = _mm512_add_epi64(acc2_ab, popcount2_epi64_avx512(_mm512_add_epi64(loader3, loader2)));
+    acc2_c = _mm512_add_epi64(acc2_c, _mm512_popcnt_epi64(andnot_avx512(loader3, loader2)));
+    lptr = &(lptr[8]);
+    mask1p = &(mask1p[8]);
+    mask2p = &(mask2p[8]);
+    word_ct -= 8;
+  }
+  *ct1abp += hsum_epi64_avx512(acc1_ab);
+  *ct1cp += hsum_epi64_avx512(acc1_c);
+  *ct2abp += hsum_epi64_avx512(acc2_ab);
+  *ct2cp += hsum_epi64_avx512(acc2_c);
+}
+
+TARGET_AVX2 static void count_3freq_avx2(uintptr_t* lptr, uintptr_t word_ct, uintptr_t* maskp, uint32_t* even_ctp, uint32_t* odd_ctp, uint32_t* homset_ctp) {
+  uintptr_t* lptr_end = &(lptr[word_ct]);
+  uintptr_t* lptr_4x_end = &(lptr[word_ct & (~(3 * ONELU))]);
+  __m256i acc_even = _mm256_setzero_si256();
+  __m256i acc_odd = _mm256_setzero_si256();
+  __m256i acc_homset = _mm256_setzero_si256();
+  __m256i loader;
+  __m256i loader2;
+  __m256i odds;
+  uintptr_t ulii;
+  uintptr_t uljj;
+  uintptr_t ulkk;
+  while (lptr < lptr_4x_end) {
+    loader = _mm256_loadu_si256((__m256i*)lptr);
+    loader2 = _mm256_loadu_si256((__m256i*)maskp);
+    odds = _mm256_and_si256(loader2, _mm256_srli_epi64(loader, 1));
+    acc_even = _mm256_add_epi64(acc_even, popcount_epi64_avx2(_mm256_and_si256(loader2, loader)));
+    acc_odd = _mm256_add_epi64(acc_odd, popcount_epi64_avx2(odds));
+    acc_homset = _mm256_add_epi64(acc_homset, popcount_epi64_avx2(_mm256_and_si256(odds, loader)));
+    lptr = &(lptr[4]);
+    maskp = &(maskp[4]);
+  }
+  *even_ctp += hsum_epi64_avx2(acc_even);
+  *odd_ctp += hsum_epi64_avx2(acc_odd);
+  *homset_ctp += hsum_epi64_avx2(acc_homset);
+  while (lptr < lptr_end) {
+    ulii = *lptr++;
+    uljj = *maskp++;
+    ulkk = uljj & (ulii >> 1);
+    *even_ctp += popcount_long_hw(uljj & ulii);
+    *odd_ctp += popcount_long_hw(ulkk);
+    *homset_ctp += popcount_long_hw(ulkk & ulii);
+  }
+}
+
+TARGET_AVX512 static void count_3freq_avx512(uintptr_t* lptr, uintptr_t word_ct, uintptr_t* maskp, uint32_t* even_ctp, uint32_t* odd_ctp, uint32_t* homset_ctp) {
+  __m512i acc_even = _mm512_setzero_si512();
+  __m512i acc_odd = _mm512_setzero_si512();
+  __m512i acc_homset = _mm512_setzero_si512();
+  __m512i loader;
+  __m512i loader2;
+  __m512i odds;
+  __mmask8 load_mask = 0xff;
+  while (word_ct) {
+    if (word_ct < 8) {
+      load_mask = (__mmask8)((1U << word_ct) - 1);
+      word_ct = 8;
+    }
+    loader = _mm512_maskz_loadu_epi64(load_mask, lptr);
+    loader2 = _mm512_maskz_loadu_epi64(load_mask, maskp);
+    odds = _mm512_and_si512(loader2, srli1_epi64_avx512(loader));
+    acc_even = _mm512_add_epi64(acc_even, _mm512_popcnt_epi64(_mm512_and_si512(loader2, loader)));
+    acc_odd = _mm512_add_epi64(acc_odd, _mm512_popcnt_epi64(odds));
+    acc_homset = _mm512_add_epi64(acc_homset, _mm512_popcnt_epi64(_mm512_and_si512(odds, loader)));
+    lptr = &(lptr[8]);
+    maskp = &(maskp[8]);
+    word_ct -= 8;
+  }
+  *even_ctp += hsum_epi64_avx512(acc_even);
+  *odd_ctp += hsum_epi64_avx512(acc_odd);
+  *homset_ctp += hsum_epi64_avx512(acc_homset);
+}
+
+TARGET_AVX2 static void count_set_freq_avx2(uintptr_t* lptr, uintptr_t word_ct, uintptr_t* include_vec, uint32_t* set_ctp, uint32_t* missing_ctp) {
+  uintptr_t* lptr_end = &(lptr[word_ct]);
+  uintptr_t* lptr_4x_end = &(lptr[word_ct & (~(3 * ONELU))]);
+  __m256i acc = _mm256_setzero_si256();
+  __m256i accm = _mm256_setzero_si256();
+  __m256i loader;
+  __m256i loader2;
+  __m256i loader3;
+  __m256i odds;
+  uintptr_t ulii;
+  uintptr_t uljj;
+  uintptr_t ulkk;
+  while (lptr < lptr_4x_end) {
+    loader = _mm256_loadu_si256((__m256i*)lptr);
+    loader2 = _mm256_srli_epi64(loader, 1);
+    loader3 = _mm256_loadu_si256((__m256i*)include_vec);
+    odds = _mm256_and_si256(loader2, loader3);
+    acc = _mm256_add_epi64(acc, popcount_epi64_avx2(odds));
+    acc = _mm256_add_epi64(acc, popcount_epi64_avx2(_mm256_and_si256(odds, loader)));
+    accm = _mm256_add_epi64(accm, popcount_epi64_avx2(_mm256_and_si256(loader, _mm256_andnot_si256(loader2, loader3))));
+    lptr = &(lptr[4]);
+    include_vec = &(include_vec[4]);
+  }
+  *set_ctp += hsum_epi64_avx2(acc);
+  *missing_ctp += hsum_epi64_avx2(accm);
+  while (lptr < lptr_end) {
+    ulii = *lptr++;
+    uljj = ulii >> 1;
+    ulkk = *include_vec++;
+    *set_ctp += popcount_long_hw(uljj & ulkk) + popcount_long_hw(uljj & ulkk & ulii);
+    *missing_ctp += popcount_long_hw(ulii & (~uljj) & ulkk);
+  }
+}
+
+TARGET_AVX512 static void count_set_freq_avx512(uintptr_t* lptr, uintptr_t word_ct, uintptr_t* include_vec, uint32_t* set_ctp, uint32_t* missing_ctp) {
+  __m512i acc = _mm512_setzero_si512();
+  __m512i accm = _mm512_setzero_si512();
+  __m512i loader;
+  __m512i loader2;
+  __m512i loader3;
+  __m512i odds;
+  __mmask8 load_mask = 0xff;
+  while (word_ct) {
+    if (word_ct < 8) {
+      load_mask = (__mmask8)((1U << word_ct) - 1);
+      word_ct = 8;
+    }
+    loader = _mm512_maskz_loadu_epi64(load_mask, lptr);
+    loader2 = srli1_epi64_avx512(loader);
+    loader3 = _mm512_maskz_loadu_epi64(load_mask, include_vec);
+    odds = _mm512_and_si512(loader2, loader3);
+    acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(odds));
+    acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_and_si512(odds, loader)));
+    accm = _mm512_add_epi64(accm, _mm512_popcnt_epi64(_mm512_and_si512(loader, andnot_avx512(loader2, loader3))));
+    lptr = &(lptr[8]);
+    include_vec = &(include_vec[8]);
+    word_ct -= 8;
+  }
+  *set_ctp += hsum_epi64_avx512(acc);
+  *missing_ctp += hsum_epi64_avx512(accm);
+}
+#endif
+
 uintptr_t popcount_longs(uintptr_t* lptr, uintptr_t word_ct) {
   // Efficiently popcounts lptr[0..(word_ct - 1)].  In the 64-bit case, lptr[]
   // must be 16-byte aligned.
@@ -5683,6 +6187,13 @@ uintptr_t popcount_longs(uintptr_t* lptr, uintptr_t word_ct) {
 #ifdef __LP64__
   uintptr_t six_ct;
   __m128i* vptr;
+#ifdef SIMD_DISPATCH
+  if (g_simd_level == SIMD_LEVEL_AVX512) {
+    return popcount_longs_avx512(lptr, word_ct);
+  } else if (g_simd_level) {
+    return popcount_longs_avx2(lptr, word_ct);
+  }
+#endif
   vptr = (__m128i*)lptr;
   six_ct = word_ct / 6;
   tot += popcount_vecs(vptr, six_ct * 3);
@@ -5741,6 +6252,13 @@ uintptr_t popcount2_longs(uintptr_t* lptr, uintptr_t word_ct) {
 #ifdef __LP64__
   uintptr_t twelve_ct;
   __m128i* vptr;
+#ifdef SIMD_DISPATCH
+  if (g_simd_level == SIMD_LEVEL_AVX512) {
+    return popcount2_longs_avx512(lptr, word_ct);
+  } else if (g_simd_level) {
+    return popcount2_longs_avx2(lptr, word_ct);
+  }
+#endif
   vptr = (__m128i*)lptr;
   twelve_ct = word_ct / 12;
   tot += popcount2_vecs(vptr, twelve_ct * 6);
@@ -6180,6 +6698,15 @@ void count_2freq_dbl_60v(__m128i* vptr, __m128i* vend, __m128i* mask1vp, __m128i
   __uni16 acc2_ab;
   __uni16 acc2_c;
 
+#ifdef SIMD_DISPATCH
+  if (g_simd_level == SIMD_LEVEL_AVX512) {
+    count_2freq_dbl_avx512((uintptr_t*)vptr, 2 * ((uintptr_t)(vend - vptr)), (uintptr_t*)mask1vp, (uintptr_t*)mask2vp, ct1abp, ct1cp, ct2abp, ct2cp);
+    return;
+  } else if (g_simd_level) {
+    count_2freq_dbl_avx2((uintptr_t*)vptr, 2 * ((uintptr_t)(vend - vptr)), (uintptr_t*)mask1vp, (uintptr_t*)mask2vp, ct1abp, ct1cp, ct2abp, ct2cp);
+    return;
+  }
+#endif
   acc1_ab.vi = _mm_setzero_si128();
   acc1_c.vi = _mm_setzero_si128();
   acc2_ab.vi = _mm_setzero_si128();
@@ -6262,6 +6789,15 @@ void count_3freq_120v(__m128i* vptr, __m128i* vend, __m128i* maskvp, uint32_t* e
   __uni16 acc_odd;
   __uni16 acc_homset;
 
+#ifdef SIMD_DISPATCH
+  if (g_simd_level == SIMD_LEVEL_AVX512) {
+    count_3freq_avx512((uintptr_t*)vptr, 2 * ((uintptr_t)(vend - vptr)), (uintptr_t*)maskvp, even_ctp, odd_ctp, homset_ctp);
+    return;
+  } else if (g_simd_level) {
+    count_3freq_avx2((uintptr_t*)vptr, 2 * ((uintptr_t)(vend - vptr)), (uintptr_t*)maskvp, even_ctp, odd_ctp, homset_ctp);
+    return;
+  }
+#endif
   acc_even.vi = _mm_setzero_si128();
   acc_odd.vi = _mm_setzero_si128();
   acc_homset.vi = _mm_setzero_si128();
@@ -6557,6 +7093,15 @@ void count_set_freq_60v(__m128i* vptr, __m128i* vend, __m128i* include_vec, uint
   __m128i missings;
   __uni16 acc;
   __uni16 accm;
+#ifdef SIMD_DISPATCH
+  if (g_simd_level == SIMD_LEVEL_AVX512) {
+    count_set_freq_avx512((uintptr_t*)vptr, 2 * ((uintptr_t)(vend - vptr)), (uintptr_t*)include_vec, set_ctp, missing_ctp);
+    return;
+  } else if (g_simd_level) {
+    count_set_freq_avx2((uintptr_t*)vptr, 2 * ((uintptr_t)(vend - vptr)), (uintptr_t*)include_vec, set_ctp, missing_ctp);
+    return;
+  }
+#endif
   acc.vi = _mm_setzero_si128();
   accm.vi = _mm_setzero_si128();
   do {
@@ -7854,12 +8399,120 @@ void collapse_copy_2bitarr(uintptr_t* rawbuf, uintptr_t* mainbuf, uint32_t unfil
   }
 }
 
+uint32_t g_bed_mmap = 0;
+static FILE* g_bed_mmap_stream = NULL;
+static unsigned char* g_bed_mmap_base = NULL;
+static uint64_t g_bed_mmap_size = 0;
+static uint64_t g_bed_mmap_willneed_end = 0;
+
+// MADV_WILLNEED is issued one window at a time, so that a multi-hundred-GB
+// .bed doesn't trigger readahead of the entire file up front.
+#define BED_MMAP_WILLNEED_WINDOW 0x4000000
+
+uint32_t bed_mmap_init(FILE** bedfile_ptr) {
+#ifdef _WIN32
+  return 1;
+#else
+  FILE* bedfile = *bedfile_ptr;
+  int64_t cur_pos = ftello(bedfile);
+  FILE* mem_stream;
+  unsigned char* map_base;
+  struct stat statbuf;
+  uintptr_t map_size;
+  if ((cur_pos < 0) || fstat(fileno(bedfile), &statbuf) || (!statbuf.st_size)) {
+    return 1;
+  }
+  map_size = (uintptr_t)statbuf.st_size;
+  if ((uint64_t)map_size != (uint64_t)statbuf.st_size) {
+    // 32-bit build, file too large to map
+    return 1;
+  }
+  map_base = (unsigned char*)mmap(NULL, map_size, PROT_READ, MAP_SHARED, fileno(bedfile), 0);
+  if (map_base == (unsigned char*)MAP_FAILED) {
+    return 1;
+  }
+  mem_stream = fmemopen(map_base, map_size, "rb");
+  if (!mem_stream) {
+    munmap(map_base, map_size);
+    return 1;
+  }
+  // unbuffered, so that fread() on the stream is a single memcpy
+  setvbuf(mem_stream, NULL, _IONBF, 0);
+  if (fseeko(mem_stream, cur_pos, SEEK_SET)) {
+    fclose(mem_stream);
+    munmap(map_base, map_size);
+    return 1;
+  }
+  madvise(map_base, map_size, MADV_SEQUENTIAL);
+  g_bed_mmap_willneed_end = MINV(map_size, BED_MMAP_WILLNEED_WINDOW);
+  madvise(map_base, g_bed_mmap_willneed_end, MADV_WILLNEED);
+  fclose(bedfile);
+  g_bed_mmap_stream = mem_stream;
+  g_bed_mmap_base = map_base;
+  g_bed_mmap_size = map_size;
+  *bedfile_ptr = mem_stream;
+  return 0;
+#endif
+}
+
+void bed_mmap_cleanup() {
+#ifndef _WIN32
+  if (g_bed_mmap_base) {
+    munmap(g_bed_mmap_base, g_bed_mmap_size);
+    g_bed_mmap_base = NULL;
+    g_bed_mmap_stream = NULL;
+    g_bed_mmap_size = 0;
+  }
+#endif
+}
+
+uintptr_t* bed_mmap_next(FILE* bedfile, uintptr_t unfiltered_sample_ct4) {
+  // Returns a pointer to the current variant's record inside the mapping and
+  // advances the stream past it, or NULL if bedfile isn't the mapped stream.
+  // The record must be readable as whole words (the collapse loops don't
+  // stop at the last byte), so the final record of a file is also punted
+  // back to the fread() path when it would run off the end of the mapping.
+  // Unaligned word loads are fine on every platform we build for.
+  // The returned memory is read-only.
+#ifdef _WIN32
+  return NULL;
+#else
+  uint64_t cur_pos;
+  uint64_t next_pos;
+  uint64_t willneed_start;
+  if (bedfile != g_bed_mmap_stream) {
+    return NULL;
+  }
+  cur_pos = (uint64_t)ftello(bedfile);
+  next_pos = cur_pos + unfiltered_sample_ct4;
+  if (cur_pos + ((unfiltered_sample_ct4 + (BYTECT - 1)) & (~(BYTECT - ONELU))) > g_bed_mmap_size) {
+    return NULL;
+  }
+  if (fseeko(bedfile, next_pos, SEEK_SET)) {
+    return NULL;
+  }
+  if ((next_pos > g_bed_mmap_willneed_end) && (g_bed_mmap_willneed_end < g_bed_mmap_size)) {
+    willneed_start = next_pos & (~((uint64_t)(BED_MMAP_WILLNEED_WINDOW - 1)));
+    g_bed_mmap_willneed_end = MINV(willneed_start + 2 * BED_MMAP_WILLNEED_WINDOW, g_bed_mmap_size);
+    madvise(&(g_bed_mmap_base[willneed_start]), g_bed_mmap_willneed_end - willneed_start, MADV_WILLNEED);
+  }
+  return (uintptr_t*)(&(g_bed_mmap_base[cur_pos]));
+#endif
+}
+
 uint32_t load_and_collapse(FILE* bedfile, uintptr_t* rawbuf, uint32_t unfiltered_sample_ct, uintptr_t* mainbuf, uint32_t sample_ct, uintptr_t* sample_exclude, uintptr_t final_mask, uint32_t do_reverse) {
   uint32_t unfiltered_sample_ct4 = (unfiltered_sample_ct + 3) / 4;
+  uintptr_t* mapped_rawbuf = bed_mmap_next(bedfile, unfiltered_sample_ct4);
   if (unfiltered_sample_ct == sample_ct) {
     rawbuf = mainbuf;
   }
-  if (load_raw(bedfile, rawbuf, unfiltered_sample_ct4)) {
+  if (mapped_rawbuf) {
+    if (unfiltered_sample_ct == sample_ct) {
+      memcpy(mainbuf, mapped_rawbuf, unfiltered_sample_ct4);
+    } else {
+      rawbuf = mapped_rawbuf;
+    }
+  } else if (load_raw(bedfile, rawbuf, unfiltered_sample_ct4)) {
     return RET_READ_FAIL;
   }
   if (unfiltered_sample_ct != sample_ct) {
@@ -7906,10 +8559,17 @@ void collapse_copy_2bitarr_incl(uintptr_t* rawbuf, uintptr_t* mainbuf, uint32_t
 
 uint32_t load_and_collapse_incl(FILE* bedfile, uintptr_t* rawbuf, uint32_t unfiltered_sample_ct, uintptr_t* mainbuf, uint32_t sample_ct, uintptr_t* sample_include, uintptr_t final_mask, uint32_t do_reverse) {
   uint32_t unfiltered_sample_ct4 = (unfiltered_sample_ct + 3) / 4;
+  uintptr_t* mapped_rawbuf = bed_mmap_next(bedfile, unfiltered_sample_ct4);
   if (unfiltered_sample_ct == sample_ct) {
     rawbuf = mainbuf;
   }
-  if (load_raw(bedfile, rawbuf, unfiltered_sample_ct4)) {
+  if (mapped_rawbuf) {
+    if (unfiltered_sample_ct == sample_ct) {
+      memcpy(mainbuf, mapped_rawbuf, unfiltered_sample_ct4);
+    } else {
+      rawbuf = mapped_rawbuf;
+    }
+  } else if (load_raw(bedfile, rawbuf, unfiltered_sample_ct4)) {
     return RET_READ_FAIL;
   }
   if (unfiltered_sample_ct != sample_ct) {
@@ -7925,10 +8585,11 @@ uint32_t load_and_collapse_incl(FILE* bedfile, uintptr_t* rawbuf, uint32_t unfil
 
 uint32_t load_and_split(FILE* bedfile, uintptr_t* rawbuf, uint32_t unfiltered_sample_ct, uintptr_t* casebuf, uintptr_t* ctrlbuf, uintptr_t* pheno_nm, uintptr_t* pheno_c) {
   // add do_reverse later if needed
-  uintptr_t* rawbuf_end = &(rawbuf[unfiltered_sample_ct / BITCT2]);
+  uint32_t unfiltered_sample_ct4 = (unfiltered_sample_ct + 3) / 4;
+  uintptr_t* mapped_rawbuf = bed_mmap_next(bedfile, unfiltered_sample_ct4);
+  uintptr_t* rawbuf_end;
   uintptr_t case_word = 0;
   uintptr_t ctrl_word = 0;
-  uint32_t unfiltered_sample_ct4 = (unfiltered_sample_ct + 3) / 4;
   uint32_t case_shift2 = 0;
   uint32_t ctrl_shift2 = 0;
   uint32_t read_shift_max = BITCT2;
@@ -7936,9 +8597,12 @@ uint32_t load_and_split(FILE* bedfile, uintptr_t* rawbuf, uint32_t unfiltered_sa
   uint32_t read_shift;
   uintptr_t read_word;
   uintptr_t ulii;
-  if (load_raw(bedfile, rawbuf, unfiltered_sample_ct4)) {
+  if (mapped_rawbuf) {
+    rawbuf = mapped_rawbuf;
+  } else if (load_raw(bedfile, rawbuf, unfiltered_sample_ct4)) {
     return RET_READ_FAIL;
   }
+  rawbuf_end = &(rawbuf[unfiltered_sample_ct / BITCT2]);
   while (1) {
     while (rawbuf < rawbuf_end) {
       read_word = *rawbuf++;
@@ -7980,6 +8644,483 @@ uint32_t load_and_split(FILE* bedfile, uintptr_t* rawbuf, uint32_t unfiltered_sa
   }
 }
 
+uint32_t block_load(FILE* bedfile, int32_t bed_offset, uintptr_t* marker_exclude, uint32_t marker_ct, uint32_t block_max_size, uintptr_t unfiltered_sample_ct4, unsigned char* readbuf, uintptr_t* marker_uidx_ptr, uintptr_t* marker_idx_ptr, uint32_t* block_size_ptr) {
+  uintptr_t marker_uidx = *marker_uidx_ptr;
+  uintptr_t marker_idx = *marker_idx_ptr;
+  uint32_t markers_read = 0;
+  if (block_max_size > marker_ct - marker_idx) {
+    block_max_size = marker_ct - marker_idx;
+  }
+  while (markers_read < block_max_size) {
+    if (IS_SET(marker_exclude, marker_uidx)) {
+      marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
+      if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_sample_ct4, SEEK_SET)) {
+	return RET_READ_FAIL;
+      }
+    }
+    if (fread(&(readbuf[markers_read * unfiltered_sample_ct4]), 1, unfiltered_sample_ct4, bedfile) < unfiltered_sample_ct4) {
+      return RET_READ_FAIL;
+    }
+    markers_read++;
+    marker_idx++;
+    marker_uidx++;
+  }
+
+  *marker_uidx_ptr = marker_uidx;
+  *marker_idx_ptr = marker_idx;
+  *block_size_ptr = markers_read;
+  return 0;
+}
+
+uint32_t g_time_trace = 0;
+
+// main-thread time spent inside bed_prefetch_next(), i.e. stalled on .bed
+// reads; never touched by the reader thread
+static double g_time_trace_load_wait_sec = 0.0;
+
+typedef struct {
+  const char* name;
+  uint32_t depth;
+  uint32_t is_open;
+  uintptr_t variant_ct;
+  double wall_start;
+  double wall_sec;
+  double cpu_start;
+  double cpu_sec;
+  double load_wait_start;
+  double load_wait_sec;
+  uint64_t bytes_start;
+  uint64_t bytes_read;
+} Time_trace_rec;
+
+// one "total" record plus phases and their nested scopes; later records are
+// dropped (and counted) if a command somehow has more
+#define TIME_TRACE_MAX_RECS 1024
+#define TIME_TRACE_MAX_DEPTH 8
+
+static Time_trace_rec g_time_trace_recs[TIME_TRACE_MAX_RECS];
+static uint32_t g_time_trace_rec_ct = 0;
+static uint32_t g_time_trace_dropped_ct = 0;
+static double g_time_trace_wall_base = 0.0;
+
+// g_time_trace_stack[d] is the record index of the open scope at depth d, or
+// 0xffffffffU if that scope was dropped
+static uint32_t g_time_trace_stack[TIME_TRACE_MAX_DEPTH];
+static uint32_t g_time_trace_depth = 0;
+// pushes beyond TIME_TRACE_MAX_DEPTH, which only need matching pops
+static uint32_t g_time_trace_excess_depth = 0;
+
+double time_trace_wall_now() {
+#ifdef _WIN32
+  LARGE_INTEGER freq;
+  LARGE_INTEGER cur_ct;
+  QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&cur_ct);
+  return ((double)cur_ct.QuadPart) / ((double)freq.QuadPart);
+#else
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return ((double)tv.tv_sec) + ((double)tv.tv_usec) * 0.000001;
+#endif
+}
+
+static double time_trace_cpu_now() {
+  // user + system time of all threads
+#ifdef _WIN32
+  FILETIME creation_time;
+  FILETIME exit_time;
+  FILETIME kernel_time;
+  FILETIME user_time;
+  if (!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time)) {
+    return 0.0;
+  }
+  return ((double)((((uint64_t)kernel_time.dwHighDateTime) << 32) | kernel_time.dwLowDateTime) + (double)((((uint64_t)user_time.dwHighDateTime) << 32) | user_time.dwLowDateTime)) * 0.0000001;
+#else
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru)) {
+    return 0.0;
+  }
+  return ((double)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec)) + ((double)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec)) * 0.000001;
+#endif
+}
+
+static uint64_t time_trace_bytes_now() {
+  // Total bytes passed through read() and friends (including cache hits, but
+  // not memory-mapped accesses).  Only available on Linux; 0 elsewhere.
+#ifdef __linux__
+  char buf[256];
+  FILE* infile = fopen("/proc/self/io", "r");
+  uint64_t rchar = 0;
+  if (!infile) {
+    return 0;
+  }
+  while (fgets(buf, 256, infile)) {
+    if (!memcmp(buf, "rchar: ", 7)) {
+      rchar = strtoull(&(buf[7]), NULL, 10);
+      break;
+    }
+  }
+  fclose(infile);
+  return rchar;
+#else
+  return 0;
+#endif
+}
+
+static void time_trace_close(Time_trace_rec* ttrp) {
+  ttrp->wall_sec = time_trace_wall_now() - ttrp->wall_start;
+  ttrp->cpu_sec = time_trace_cpu_now() - ttrp->cpu_start;
+  ttrp->load_wait_sec = g_time_trace_load_wait_sec - ttrp->load_wait_start;
+  ttrp->bytes_read = time_trace_bytes_now() - ttrp->bytes_start;
+  ttrp->is_open = 0;
+}
+
+static void time_trace_open(const char* name, uint32_t depth, uintptr_t variant_ct) {
+  Time_trace_rec* ttrp;
+  if (g_time_trace_rec_ct == TIME_TRACE_MAX_RECS) {
+    g_time_trace_dropped_ct++;
+    g_time_trace_stack[depth] = 0xffffffffU;
+    return;
+  }
+  g_time_trace_stack[depth] = g_time_trace_rec_ct;
+  ttrp = &(g_time_trace_recs[g_time_trace_rec_ct++]);
+  ttrp->name = name;
+  ttrp->depth = depth;
+  ttrp->is_open = 1;
+  ttrp->variant_ct = variant_ct;
+  ttrp->wall_start = time_trace_wall_now();
+  ttrp->cpu_start = time_trace_cpu_now();
+  ttrp->load_wait_start = g_time_trace_load_wait_sec;
+  ttrp->bytes_start = time_trace_bytes_now();
+}
+
+void time_trace_init() {
+  g_time_trace_rec_ct = 0;
+  g_time_trace_dropped_ct = 0;
+  g_time_trace_load_wait_sec = 0.0;
+  g_time_trace_depth = 0;
+  g_time_trace_excess_depth = 0;
+  time_trace_open("total", 0, 0);
+  g_time_trace_wall_base = g_time_trace_recs[0].wall_start;
+}
+
+static void time_trace_close_to_depth(uint32_t depth) {
+  // closes every open scope deeper than depth
+  uint32_t rec_idx;
+  g_time_trace_excess_depth = 0;
+  while (g_time_trace_depth > depth) {
+    rec_idx = g_time_trace_stack[g_time_trace_depth--];
+    if (rec_idx != 0xffffffffU) {
+      time_trace_close(&(g_time_trace_recs[rec_idx]));
+    }
+  }
+}
+
+void time_trace_phase(const char* name, uintptr_t variant_ct) {
+  if ((!g_time_trace) || (!g_time_trace_rec_ct)) {
+    return;
+  }
+  // also closes any nested scope an error path left open
+  time_trace_close_to_depth(0);
+  g_time_trace_depth = 1;
+  time_trace_open(name, 1, variant_ct);
+}
+
+void time_trace_push(const char* name, uintptr_t variant_ct) {
+  if ((!g_time_trace) || (!g_time_trace_rec_ct)) {
+    return;
+  }
+  if (g_time_trace_excess_depth || (g_time_trace_depth + 1 == TIME_TRACE_MAX_DEPTH)) {
+    g_time_trace_dropped_ct++;
+    g_time_trace_excess_depth++;
+    return;
+  }
+  g_time_trace_depth++;
+  time_trace_open(name, g_time_trace_depth, variant_ct);
+}
+
+void time_trace_pop() {
+  if ((!g_time_trace) || (!g_time_trace_rec_ct) || (g_time_trace_depth < 2)) {
+    // top-level phases are only closed by time_trace_phase()
+    return;
+  }
+  if (g_time_trace_excess_depth) {
+    g_time_trace_excess_depth--;
+    return;
+  }
+  time_trace_close_to_depth(g_time_trace_depth - 1);
+}
+
+int32_t time_trace_write(char* outname, char* outname_end) {
+  FILE* outfile = NULL;
+  uint32_t is_tsv = (g_time_trace == TIME_TRACE_TSV);
+  int32_t retval = 0;
+  Time_trace_rec* ttrp;
+  double variants_per_sec;
+  uint32_t rec_idx;
+  if (!g_time_trace_rec_ct) {
+    return 0;
+  }
+  time_trace_close_to_depth(0);
+  time_trace_close(&(g_time_trace_recs[0]));
+  memcpy(outname_end, is_tsv? ".trace.tsv" : ".trace.json", is_tsv? 11 : 12);
+  if (fopen_checked(&outfile, outname, "w")) {
+    goto time_trace_write_ret_OPEN_FAIL;
+  }
+  if (is_tsv) {
+    fputs("PHASE\tDEPTH\tSTART_SEC\tWALL_SEC\tCPU_SEC\tBYTES_READ\tLOAD_WAIT_SEC\tVARIANTS\tVARIANTS_PER_SEC\n", outfile);
+  } else {
+    fputs("{\n  \"phases\": [\n", outfile);
+  }
+  for (rec_idx = 0; rec_idx < g_time_trace_rec_ct; rec_idx++) {
+    ttrp = &(g_time_trace_recs[rec_idx]);
+    variants_per_sec = 0.0;
+    if (ttrp->variant_ct && (ttrp->wall_sec > 0.0)) {
+      variants_per_sec = ((double)ttrp->variant_ct) / ttrp->wall_sec;
+    }
+    if (is_tsv) {
+      fprintf(outfile, "%s\t%u\t%.6f\t%.6f\t%.6f\t%llu\t%.6f\t%" PRIuPTR "\t%.1f\n", ttrp->name, ttrp->depth, ttrp->wall_start - g_time_trace_wall_base, ttrp->wall_sec, ttrp->cpu_sec, (unsigned long long)ttrp->bytes_read, ttrp->load_wait_sec, ttrp->variant_ct, variants_per_sec);
+    } else {
+      fprintf(outfile, "    {\"phase\": \"%s\", \"depth\": %u, \"start_sec\": %.6f, \"wall_sec\": %.6f, \"cpu_sec\": %.6f, \"bytes_read\": %llu, \"load_wait_sec\": %.6f, \"variants\": %" PRIuPTR ", \"variants_per_sec\": %.1f}%s\n", ttrp->name, ttrp->depth, ttrp->wall_start - g_time_trace_wall_base, ttrp->wall_sec, ttrp->cpu_sec, (unsigned long long)ttrp->bytes_read, ttrp->load_wait_sec, ttrp->variant_ct, variants_per_sec, (rec_idx + 1 == g_time_trace_rec_ct)? "" : ",");
+    }
+  }
+  if (!is_tsv) {
+    fprintf(outfile, "  ],\n  \"dropped_phases\": %u\n}\n", g_time_trace_dropped_ct);
+  }
+  if (fclose_null(&outfile)) {
+    goto time_trace_write_ret_WRITE_FAIL;
+  }
+  LOGPRINTFWW("--time-trace: Phase timings written to %s .\n", outname);
+  while (0) {
+  time_trace_write_ret_OPEN_FAIL:
+    retval = RET_OPEN_FAIL;
+    break;
+  time_trace_write_ret_WRITE_FAIL:
+    retval = RET_WRITE_FAIL;
+    break;
+  }
+  fclose_cond(outfile);
+  // only report once, even if called again on an error path
+  g_time_trace_rec_ct = 0;
+  return retval;
+}
+
+#ifndef _WIN32
+THREAD_RET_TYPE bed_prefetch_thread(void* arg) {
+  Bed_prefetch* bpp = (Bed_prefetch*)arg;
+  uint32_t slot = 0;
+  uint32_t block_size;
+  int32_t retval;
+  if (fseeko(bpp->bedfile, bpp->bed_offset + ((uint64_t)bpp->marker_uidx) * bpp->unfiltered_sample_ct4, SEEK_SET)) {
+    retval = RET_READ_FAIL;
+  } else {
+    retval = 0;
+  }
+  pthread_mutex_lock(&bpp->sync_mutex);
+  while (1) {
+    while (bpp->filled[slot] && (!bpp->shutdown)) {
+      pthread_cond_wait(&bpp->sync_condvar, &bpp->sync_mutex);
+    }
+    if (bpp->shutdown || (bpp->marker_idx == bpp->marker_ct)) {
+      break;
+    }
+    pthread_mutex_unlock(&bpp->sync_mutex);
+    if (!retval) {
+      retval = block_load(bpp->bedfile, bpp->bed_offset, bpp->marker_exclude, bpp->marker_ct, bpp->block_max_size, bpp->unfiltered_sample_ct4, bpp->bufs[slot], &bpp->marker_uidx, &bpp->marker_idx, &block_size);
+    }
+    pthread_mutex_lock(&bpp->sync_mutex);
+    if (retval) {
+      // report the failure on the next handoff, and stop reading
+      bpp->retval = retval;
+      bpp->marker_idx = bpp->marker_ct;
+      bpp->filled[slot] = 1;
+      break;
+    }
+    bpp->block_sizes[slot] = block_size;
+    bpp->block_end_uidxs[slot] = bpp->marker_uidx;
+    bpp->block_end_idxs[slot] = bpp->marker_idx;
+    bpp->filled[slot] = 1;
+    pthread_cond_signal(&bpp->sync_condvar);
+    slot ^= 1;
+  }
+  bpp->reader_done = 1;
+  pthread_cond_signal(&bpp->sync_condvar);
+  pthread_mutex_unlock(&bpp->sync_mutex);
+  THREAD_RETURN;
+}
+#endif
+
+void bed_prefetch_init(Bed_prefetch* bpp, FILE* bedfile, uintptr_t bed_offset, uintptr_t* marker_exclude, uintptr_t marker_uidx, uintptr_t marker_idx, uint32_t marker_ct, uint32_t block_max_size, uintptr_t unfiltered_sample_ct4, unsigned char* buf0, unsigned char* buf1) {
+  bpp->bedfile = bedfile;
+  bpp->bed_offset = bed_offset;
+  bpp->marker_exclude = marker_exclude;
+  bpp->marker_uidx = marker_uidx;
+  bpp->marker_idx = marker_idx;
+  bpp->marker_ct = marker_ct;
+  bpp->block_max_size = block_max_size;
+  bpp->unfiltered_sample_ct4 = unfiltered_sample_ct4;
+  bpp->bufs[0] = buf0;
+  bpp->bufs[1] = buf1;
+  bpp->filled[0] = 0;
+  bpp->filled[1] = 0;
+  bpp->consumer_slot = 1;
+  bpp->consumer_holding = 0;
+  bpp->shutdown = 0;
+  bpp->reader_done = 0;
+  bpp->retval = 0;
+  bpp->thread_active = 0;
+  bpp->row_ptr = NULL;
+  bpp->row_uidx = marker_uidx;
+  bpp->row_block_uidx = marker_uidx;
+  bpp->row_block_idx = marker_idx;
+  bpp->rows_left = 0;
+#ifndef _WIN32
+  // Only worth a thread if there's more than one block.  If thread creation
+  // fails, bed_prefetch_next() just falls back on synchronous block_load()
+  // calls.
+  if (marker_ct - marker_idx <= block_max_size) {
+    return;
+  }
+  if (pthread_mutex_init(&bpp->sync_mutex, NULL)) {
+    return;
+  }
+  if (pthread_cond_init(&bpp->sync_condvar, NULL)) {
+    pthread_mutex_destroy(&bpp->sync_mutex);
+    return;
+  }
+  if (pthread_create(&bpp->reader_thread, NULL, &bed_prefetch_thread, (void*)bpp)) {
+    pthread_cond_destroy(&bpp->sync_condvar);
+    pthread_mutex_destroy(&bpp->sync_mutex);
+    return;
+  }
+  bpp->thread_active = 1;
+#endif
+}
+
+static int32_t bed_prefetch_next_main(Bed_prefetch* bpp, unsigned char** readbuf_ptr, uintptr_t* marker_uidx_ptr, uintptr_t* marker_idx_ptr, uint32_t* block_size_ptr) {
+  uint32_t slot = 1 - bpp->consumer_slot;
+  int32_t retval;
+  if (!bpp->thread_active) {
+    *readbuf_ptr = bpp->bufs[0];
+    return block_load(bpp->bedfile, bpp->bed_offset, bpp->marker_exclude, bpp->marker_ct, bpp->block_max_size, bpp->unfiltered_sample_ct4, bpp->bufs[0], marker_uidx_ptr, marker_idx_ptr, block_size_ptr);
+  }
+#ifndef _WIN32
+  pthread_mutex_lock(&bpp->sync_mutex);
+  // hand the previous block's buffer back to the reader
+  if (bpp->consumer_holding) {
+    bpp->filled[bpp->consumer_slot] = 0;
+    pthread_cond_signal(&bpp->sync_condvar);
+  }
+  while ((!bpp->filled[slot]) && (!bpp->reader_done)) {
+    pthread_cond_wait(&bpp->sync_condvar, &bpp->sync_mutex);
+  }
+  retval = bpp->retval;
+  if ((!retval) && (!bpp->filled[slot])) {
+    // caller asked for a block past the end
+    retval = RET_READ_FAIL;
+  }
+  if (!retval) {
+    *readbuf_ptr = bpp->bufs[slot];
+    *marker_uidx_ptr = bpp->block_end_uidxs[slot];
+    *marker_idx_ptr = bpp->block_end_idxs[slot];
+    *block_size_ptr = bpp->block_sizes[slot];
+    bpp->consumer_slot = slot;
+    bpp->consumer_holding = 1;
+  }
+  pthread_mutex_unlock(&bpp->sync_mutex);
+  return retval;
+#else
+  return RET_READ_FAIL;
+#endif
+}
+
+int32_t bed_prefetch_next(Bed_prefetch* bpp, unsigned char** readbuf_ptr, uintptr_t* marker_uidx_ptr, uintptr_t* marker_idx_ptr, uint32_t* block_size_ptr) {
+  // timed here rather than in the reader thread, so --time-trace reports how
+  // long the caller was actually stalled on .bed reads
+  double trace_start;
+  int32_t retval;
+  if (!g_time_trace) {
+    return bed_prefetch_next_main(bpp, readbuf_ptr, marker_uidx_ptr, marker_idx_ptr, block_size_ptr);
+  }
+  trace_start = time_trace_wall_now();
+  retval = bed_prefetch_next_main(bpp, readbuf_ptr, marker_uidx_ptr, marker_idx_ptr, block_size_ptr);
+  g_time_trace_load_wait_sec += time_trace_wall_now() - trace_start;
+  return retval;
+}
+
+void bed_prefetch_cleanup(Bed_prefetch* bpp) {
+#ifndef _WIN32
+  if (!bpp->thread_active) {
+    return;
+  }
+  pthread_mutex_lock(&bpp->sync_mutex);
+  bpp->shutdown = 1;
+  pthread_cond_signal(&bpp->sync_condvar);
+  pthread_mutex_unlock(&bpp->sync_mutex);
+  pthread_join(bpp->reader_thread, NULL);
+  pthread_cond_destroy(&bpp->sync_condvar);
+  pthread_mutex_destroy(&bpp->sync_mutex);
+  bpp->thread_active = 0;
+#endif
+}
+
+uint32_t bed_prefetch_row_alloc(uintptr_t unfiltered_sample_ct4, unsigned char** buf0_ptr, unsigned char** buf1_ptr) {
+  uintptr_t block_max_size;
+  if (wkspace_left < 2 * CACHELINE) {
+    return 0;
+  }
+  block_max_size = (wkspace_left - 2 * CACHELINE) / (8 * unfiltered_sample_ct4);
+  if (block_max_size > BED_PREFETCH_ROW_BLOCKSIZE) {
+    block_max_size = BED_PREFETCH_ROW_BLOCKSIZE;
+  } else if (!block_max_size) {
+    return 0;
+  }
+  *buf0_ptr = wkspace_alloc(block_max_size * unfiltered_sample_ct4);
+  *buf1_ptr = wkspace_alloc(block_max_size * unfiltered_sample_ct4);
+  return block_max_size;
+}
+
+int32_t bed_prefetch_row(Bed_prefetch* bpp, uintptr_t marker_uidx, unsigned char** row_ptr) {
+  uint32_t block_size;
+  int32_t retval;
+  while (1) {
+    if (!bpp->rows_left) {
+      retval = bed_prefetch_next(bpp, &bpp->row_ptr, &bpp->row_block_uidx, &bpp->row_block_idx, &block_size);
+      if (retval) {
+	return retval;
+      }
+      if (!block_size) {
+	// asked for a variant past the end
+	return RET_READ_FAIL;
+      }
+      bpp->rows_left = block_size;
+    }
+    next_unset_ul_unsafe_ck(bpp->marker_exclude, &bpp->row_uidx);
+    bpp->rows_left--;
+    if (bpp->row_uidx++ == marker_uidx) {
+      break;
+    }
+    bpp->row_ptr = &(bpp->row_ptr[bpp->unfiltered_sample_ct4]);
+  }
+  *row_ptr = bpp->row_ptr;
+  bpp->row_ptr = &(bpp->row_ptr[bpp->unfiltered_sample_ct4]);
+  return 0;
+}
+
+void copy_and_collapse_incl(unsigned char* bed_row, uintptr_t* rawbuf, uint32_t unfiltered_sample_ct, uintptr_t* mainbuf, uint32_t sample_ct, uintptr_t* sample_include, uintptr_t final_mask, uint32_t do_reverse) {
+  uint32_t unfiltered_sample_ct4 = (unfiltered_sample_ct + 3) / 4;
+  if (unfiltered_sample_ct == sample_ct) {
+    memcpy(mainbuf, bed_row, unfiltered_sample_ct4);
+    mainbuf[(unfiltered_sample_ct - 1) / BITCT2] &= final_mask;
+  } else {
+    memcpy(rawbuf, bed_row, unfiltered_sample_ct4);
+    collapse_copy_2bitarr_incl(rawbuf, mainbuf, unfiltered_sample_ct, sample_ct, sample_include);
+  }
+  if (do_reverse) {
+    reverse_loadbuf((unsigned char*)mainbuf, sample_ct);
+  }
+}
+
 void vec_include_init(uintptr_t unfiltered_sample_ct, uintptr_t* new_include2, uintptr_t* old_include) {
   uint32_t unfiltered_sample_ctl = (unfiltered_sample_ct + (BITCT - 1)) / BITCT;
   uintptr_t ulii;
@@ -9822,6 +10963,89 @@ int32_t spawn_threads2(pthread_t* threads, void* (*start_routine)(void*), uintpt
   return 0;
 }
 
+// Work-stealing item ranges.  Each slot packs [start, end) into a single 64-bit
+// word (start in the low half) so that both the owner and thieves can update
+// it with one compare-and-swap.
+Ws_range g_ws_ranges[MAX_THREADS];
+static uint32_t g_ws_thread_ct;
+
+void ws_ranges_init(uint32_t thread_ct, uint32_t item_start, uint32_t item_ct) {
+  uint32_t tidx;
+  uint64_t range_start;
+  uint64_t range_end;
+  // same initial partition as the old static split, so the common case
+  // (balanced work) has no more cross-thread traffic than before
+  for (tidx = 0; tidx < thread_ct; tidx++) {
+    range_start = item_start + (((uint64_t)tidx) * item_ct) / thread_ct;
+    range_end = item_start + (((uint64_t)tidx + 1) * item_ct) / thread_ct;
+    g_ws_ranges[tidx].range = (range_end << 32) | range_start;
+  }
+  g_ws_thread_ct = thread_ct;
+}
+
+uint32_t ws_claim(uint32_t tidx, uint32_t chunk_size, uint32_t* start_ptr, uint32_t* end_ptr) {
+  // Returns 1 and a nonempty [*start_ptr, *end_ptr) if work remains, 0 once
+  // every range is exhausted.
+  volatile uint64_t* own_ptr = &(g_ws_ranges[tidx].range);
+  uint32_t thread_ct = g_ws_thread_ct;
+  uint64_t cur_range;
+  uint64_t new_range;
+  uint64_t best_range;
+  uint32_t range_start;
+  uint32_t range_end;
+  uint32_t best_size;
+  uint32_t victim_idx;
+  uint32_t best_idx;
+  uint32_t uii;
+  while (1) {
+    // pop from the front of our own range
+    cur_range = *own_ptr;
+    range_start = (uint32_t)cur_range;
+    range_end = (uint32_t)(cur_range >> 32);
+    if (range_start < range_end) {
+      uii = range_end - range_start;
+      if (uii > chunk_size) {
+	uii = chunk_size;
+      }
+      new_range = (cur_range & 0xffffffff00000000LLU) | (range_start + uii);
+      if (__sync_bool_compare_and_swap(own_ptr, cur_range, new_range)) {
+	*start_ptr = range_start;
+	*end_ptr = range_start + uii;
+	return 1;
+      }
+      continue;
+    }
+    // own range is empty; steal the back half of the largest remaining range
+    best_size = 0;
+    best_idx = 0;
+    best_range = 0;
+    for (victim_idx = 0; victim_idx < thread_ct; victim_idx++) {
+      cur_range = g_ws_ranges[victim_idx].range;
+      range_start = (uint32_t)cur_range;
+      range_end = (uint32_t)(cur_range >> 32);
+      if ((range_start < range_end) && (range_end - range_start > best_size)) {
+	best_size = range_end - range_start;
+	best_idx = victim_idx;
+	best_range = cur_range;
+      }
+    }
+    if (!best_size) {
+      return 0;
+    }
+    range_start = (uint32_t)best_range;
+    range_end = (uint32_t)(best_range >> 32);
+    uii = range_end - ((best_size + 1) / 2);
+    // victim keeps [range_start, uii), we take [uii, range_end)
+    new_range = (((uint64_t)uii) << 32) | range_start;
+    if (!__sync_bool_compare_and_swap(&(g_ws_ranges[best_idx].range), best_range, new_range)) {
+      continue;
+    }
+    // nobody else writes to an empty slot, but publish atomically so thieves
+    // never observe a torn value
+    __sync_lock_test_and_set(own_ptr, (((uint64_t)range_end) << 32) | uii);
+  }
+}
+
 sfmt_t** g_sfmtp_arr;
 
 uint32_t wkspace_init_sfmtp(uint32_t thread_ct) {
@@ -85,6 +85,16 @@
 
 #ifdef __LP64__
   #include <emmintrin.h>
+  #if defined(__GNUC__) && !defined(__clang__) && (__GNUC__ >= 7)
+    // AVX2 and AVX-512 VPOPCNTDQ versions of the hottest counting kernels are
+    // compiled alongside the SSE2 ones via function target attributes, and
+    // selected at runtime by simd_dispatch_init().  (gcc 7 is the first
+    // release which knows about avx512vpopcntdq.)
+    #define SIMD_DISPATCH
+    #include <immintrin.h>
+    #define TARGET_AVX2 __attribute__((target("avx2,popcnt")))
+    #define TARGET_AVX512 __attribute__((target("avx2,avx512f,avx512vpopcntdq,popcnt")))
+  #endif
   #define FIVEMASK 0x5555555555555555LLU
   typedef union {
     __m128 vf;
@@ -402,6 +412,7 @@
 #define RECODE_IID 0x4000000
 #define RECODE_INCLUDE_ALT 0x8000000
 #define RECODE_BGZ 0x10000000
+#define RECODE_BIN4 0x20000000
 
 #define GENOME_OUTPUT_GZ 1
 #define GENOME_REL_CHECK 2
@@ -1728,6 +1739,35 @@ static inline int32_t alloc_and_populate_id_htable(uintptr_t unfiltered_ct, uint
 
 uint32_t id_htable_find(const char* id_buf, uintptr_t cur_id_len, const uint32_t* id_htable, uint32_t id_htable_size, const char* item_ids, uintptr_t max_id_len);
 
+// Identifies the input file an on-disk cache (--bim-cache, --id-index,
+// --sample-major-cache) was generated from.  A cache is only reused if every
+// field matches exactly; the inode change time can't be set by cp -p,
+// rsync -a, or touch -r, and the nanosecond fields catch same-second rewrites
+// where the filesystem records them.  Stored verbatim in cache files, so the
+// layout must not change.
+typedef struct {
+  uint64_t size;
+  int64_t mtime;
+  int64_t mtime_nsec;
+  int64_t ctime;
+  int64_t ctime_nsec;
+} File_stamp;
+
+void file_stamp_init(const struct stat* stat_ptr, File_stamp* stamp_ptr);
+
+uint32_t file_stamp_matches(const File_stamp* stamp_ptr, const struct stat* stat_ptr);
+
+// Optional persistent variant ID index (--id-index).  id_index_init() maps
+// {srcname}.idx read-only, building it first if it's missing or stale, and
+// returns the same table alloc_and_populate_id_htable() would have built for
+// an unfiltered item set; it returns 1 (leaving the outputs untouched) when
+// the caller should build the table the ordinary way instead.
+extern uint32_t g_id_index;
+
+uint32_t id_index_init(char* srcname, uintptr_t item_ct, uintptr_t* exclude_arr, const char* item_ids, uintptr_t max_id_len, uint32_t allow_dups, uint32_t** id_htable_ptr, uint32_t* id_htable_size_ptr);
+
+void id_index_cleanup();
+
 void fill_idx_to_uidx(uintptr_t* exclude_arr, uintptr_t unfiltered_item_ct, uintptr_t item_ct, uint32_t* idx_to_uidx);
 
 void fill_idx_to_uidx_incl(uintptr_t* include_arr, uintptr_t unfiltered_item_ct, uintptr_t item_ct, uint32_t* idx_to_uidx);
@@ -2055,6 +2095,73 @@ uint32_t less_than_two_genotypes(uintptr_t* lptr, uint32_t sample_ct);
 
 // uint32_t has_three_genotypes(uintptr_t* lptr, uint32_t sample_ct);
 
+#ifdef SIMD_DISPATCH
+#define SIMD_LEVEL_SSE2 0
+#define SIMD_LEVEL_AVX2 1
+#define SIMD_LEVEL_AVX512 2
+
+// Highest instruction set extension the kernels below may use.  Set once at
+// startup, before any worker threads exist.
+extern uint32_t g_simd_level;
+
+void simd_dispatch_init();
+
+// Per-64-bit-lane popcounts.  The AVX2 versions use the nibble lookup table
+// approach (Mula et al.); popcount2 treats the input as two-bit numbers, like
+// popcount2_long().
+TARGET_AVX2 static inline __m256i popcount_epi64_avx2(__m256i vv) {
+  const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i m4 = _mm256_set1_epi8(15);
+  __m256i cts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(vv, m4)), _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(vv, 4), m4)));
+  return _mm256_sad_epu8(cts, _mm256_setzero_si256());
+}
+
+TARGET_AVX2 static inline __m256i popcount2_epi64_avx2(__m256i vv) {
+  const __m256i lookup = _mm256_setr_epi8(0, 1, 2, 3, 1, 2, 3, 4, 2, 3, 4, 5, 3, 4, 5, 6, 0, 1, 2, 3, 1, 2, 3, 4, 2, 3, 4, 5, 3, 4, 5, 6);
+  const __m256i m4 = _mm256_set1_epi8(15);
+  __m256i cts = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, _mm256_and_si256(vv, m4)), _mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(vv, 4), m4)));
+  return _mm256_sad_epu8(cts, _mm256_setzero_si256());
+}
+
+TARGET_AVX2 static inline uintptr_t hsum_epi64_avx2(__m256i vv) {
+  __m128i vv_lo = _mm_add_epi64(_mm256_castsi256_si128(vv), _mm256_extracti128_si256(vv, 1));
+  return (uintptr_t)(_mm_cvtsi128_si64(vv_lo) + _mm_extract_epi64(vv_lo, 1));
+}
+
+TARGET_AVX512 static inline uintptr_t hsum_epi64_avx512(__m512i vv) {
+  // _mm512_reduce_add_epi64() trips a spurious -Wuninitialized in some gcc
+  // versions, and this is only evaluated once per kernel call anyway
+  uintptr_t lanes[8];
+  _mm512_storeu_si512(lanes, vv);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] + lanes[4] + lanes[5] + lanes[6] + lanes[7];
+}
+
+// gcc's _mm512_srli_epi64() and _mm512_andnot_si512() use an undefined vector
+// as the merge source, which trips -Wmaybe-uninitialized once inlined; the
+// zero-masked forms with all lanes selected are equivalent.
+TARGET_AVX512 static inline __m512i srli1_epi64_avx512(__m512i vv) {
+  return _mm512_maskz_srli_epi64(0xff, vv, 1);
+}
+
+TARGET_AVX512 static inline __m512i andnot_avx512(__m512i v1, __m512i v2) {
+  return _mm512_maskz_andnot_epi64(0xff, v1, v2);
+}
+
+TARGET_AVX512 static inline __m512i popcount2_epi64_avx512(__m512i vv) {
+  return _mm512_add_epi64(_mm512_popcnt_epi64(vv), _mm512_popcnt_epi64(_mm512_and_si512(vv, _mm512_set1_epi64(0xaaaaaaaaaaaaaaaaLLU))));
+}
+
+// Scalar tail handlers; only call these from TARGET_AVX2/TARGET_AVX512
+// functions, since they assume hardware popcount.
+TARGET_AVX2 static inline uint32_t popcount_long_hw(uintptr_t val) {
+  return __builtin_popcountll(val);
+}
+
+TARGET_AVX2 static inline uint32_t popcount2_long_hw(uintptr_t val) {
+  return __builtin_popcountll(val) + __builtin_popcountll(val & 0xaaaaaaaaaaaaaaaaLLU);
+}
+#endif
+
 uintptr_t popcount_longs(uintptr_t* lptr, uintptr_t word_ct);
 
 #ifdef __LP64__
@@ -2184,6 +2291,22 @@ static inline uint32_t load_raw2(FILE* bedfile, uintptr_t* rawbuf, uintptr_t unf
   return 0;
 }
 
+// Optional memory-mapped .bed backend (--mmap-bed).  bed_mmap_init() maps the
+// whole .bed read-only and replaces *bedfile_ptr with an unbuffered fmemopen()
+// stream over the mapping, so the many fseeko()/fread() call sites keep
+// working without issuing syscalls.  load_and_collapse(),
+// load_and_collapse_incl() and load_and_split() then use bed_mmap_next() to
+// collapse straight out of the page cache instead of copying into rawbuf.  If
+// the mapping can't be established, the original stdio stream is left alone.
+extern uint32_t g_bed_mmap;
+
+uint32_t bed_mmap_init(FILE** bedfile_ptr);
+
+// must be called after the mapped stream is closed
+void bed_mmap_cleanup();
+
+uintptr_t* bed_mmap_next(FILE* bedfile, uintptr_t unfiltered_sample_ct4);
+
 uint32_t load_and_collapse(FILE* bedfile, uintptr_t* rawbuf, uint32_t unfiltered_sample_ct, uintptr_t* mainbuf, uint32_t sample_ct, uintptr_t* sample_exclude, uintptr_t final_mask, uint32_t do_reverse);
 
 void collapse_copy_2bitarr_incl(uintptr_t* rawbuf, uintptr_t* mainbuf, uint32_t unfiltered_sample_ct, uint32_t sample_ct, uintptr_t* sample_include);
@@ -2192,6 +2315,110 @@ uint32_t load_and_collapse_incl(FILE* bedfile, uintptr_t* rawbuf, uint32_t unfil
 
 uint32_t load_and_split(FILE* bedfile, uintptr_t* rawbuf, uint32_t unfiltered_sample_ct, uintptr_t* casebuf, uintptr_t* ctrlbuf, uintptr_t* pheno_nm, uintptr_t* pheno_c);
 
+uint32_t block_load(FILE* bedfile, int32_t bed_offset, uintptr_t* marker_exclude, uint32_t marker_ct, uint32_t block_max_size, uintptr_t unfiltered_sample_ct4, unsigned char* readbuf, uintptr_t* marker_uidx_ptr, uintptr_t* marker_idx_ptr, uint32_t* block_size_ptr);
+
+// --time-trace support.  time_trace_phase() closes the previous top-level
+// phase (and anything nested in it) and opens a new one.
+// time_trace_push()/time_trace_pop() bracket a nested scope, e.g. a block
+// loop inside a phase; name must be a string literal.  variant_ct is only
+// used to report a variants/sec rate.  Main-thread time spent waiting in
+// bed_prefetch_next() is reported separately, so I/O-bound scopes can be
+// distinguished from compute-bound ones.
+#define TIME_TRACE_JSON 1
+#define TIME_TRACE_TSV 2
+
+extern uint32_t g_time_trace;
+
+double time_trace_wall_now();
+
+void time_trace_init();
+
+void time_trace_phase(const char* name, uintptr_t variant_ct);
+
+void time_trace_push(const char* name, uintptr_t variant_ct);
+
+void time_trace_pop();
+
+int32_t time_trace_write(char* outname, char* outname_end);
+
+// Double-buffered block_load() replacement.  A dedicated reader thread fills
+// one buffer with the next block of variants while the caller (and its
+// worker threads) process the other, so disk latency overlaps with compute.
+// Usage:
+//   bed_prefetch_init(&bed_prefetch, ..., buf0, buf1);
+//   do {
+//     retval = bed_prefetch_next(&bed_prefetch, &readbuf, &marker_uidx,
+//                                &marker_idx, &block_size);
+//     ... // process readbuf; it stays valid until the next call
+//   } while (marker_idx < marker_ct);
+//   bed_prefetch_cleanup(&bed_prefetch);
+// bed_prefetch_next() updates marker_uidx/marker_idx exactly like
+// block_load(), and the caller may modify the returned buffer in place.
+// bedfile must not be touched by anything else until bed_prefetch_cleanup()
+// is called.  bed_prefetch_cleanup() is safe to call on an initialized but
+// already-cleaned-up object; set thread_active to zero before the first
+// possible cleanup call if an error path can reach it before
+// bed_prefetch_init().
+// Without pthreads (Windows) or with only one block to load, this degrades
+// to plain synchronous block_load() calls on buf0.
+typedef struct {
+  FILE* bedfile;
+  uintptr_t bed_offset;
+  uintptr_t* marker_exclude;
+  uintptr_t marker_uidx;
+  uintptr_t marker_idx;
+  uintptr_t marker_ct;
+  uintptr_t unfiltered_sample_ct4;
+  uint32_t block_max_size;
+  unsigned char* bufs[2];
+  uintptr_t block_end_uidxs[2];
+  uintptr_t block_end_idxs[2];
+  uint32_t block_sizes[2];
+  uint32_t filled[2];
+  uint32_t consumer_slot;
+  uint32_t consumer_holding;
+  uint32_t shutdown;
+  uint32_t reader_done;
+  uint32_t thread_active;
+  int32_t retval;
+  // bed_prefetch_row() cursor
+  unsigned char* row_ptr;
+  uintptr_t row_uidx;
+  uintptr_t row_block_uidx;
+  uintptr_t row_block_idx;
+  uint32_t rows_left;
+#ifndef _WIN32
+  pthread_t reader_thread;
+  pthread_mutex_t sync_mutex;
+  pthread_cond_t sync_condvar;
+#endif
+} Bed_prefetch;
+
+void bed_prefetch_init(Bed_prefetch* bpp, FILE* bedfile, uintptr_t bed_offset, uintptr_t* marker_exclude, uintptr_t marker_uidx, uintptr_t marker_idx, uint32_t marker_ct, uint32_t block_max_size, uintptr_t unfiltered_sample_ct4, unsigned char* buf0, unsigned char* buf1);
+
+int32_t bed_prefetch_next(Bed_prefetch* bpp, unsigned char** readbuf_ptr, uintptr_t* marker_uidx_ptr, uintptr_t* marker_idx_ptr, uint32_t* block_size_ptr);
+
+void bed_prefetch_cleanup(Bed_prefetch* bpp);
+
+// Row-at-a-time interface, for loops whose own blocks end at chromosome
+// boundaries or otherwise don't line up with fixed-size prefetch blocks.
+// bed_prefetch_row() returns the raw .bed row for marker_uidx; successive
+// calls must request strictly increasing marker_uidx values, and any rows
+// passed over are just discarded.  Don't mix this with bed_prefetch_next()
+// on the same object.  The row is only valid until the next call.
+#define BED_PREFETCH_ROW_BLOCKSIZE 1024
+
+// Claims up to a quarter of the remaining workspace for a pair of row
+// prefetch buffers.  Returns the number of variants each buffer holds, or
+// zero (with nothing allocated) if there isn't room.
+uint32_t bed_prefetch_row_alloc(uintptr_t unfiltered_sample_ct4, unsigned char** buf0_ptr, unsigned char** buf1_ptr);
+
+int32_t bed_prefetch_row(Bed_prefetch* bpp, uintptr_t marker_uidx, unsigned char** row_ptr);
+
+// load_and_collapse_incl() for a .bed row that's already in memory.  rawbuf
+// must still be provided as an aligned staging area.
+void copy_and_collapse_incl(unsigned char* bed_row, uintptr_t* rawbuf, uint32_t unfiltered_sample_ct, uintptr_t* mainbuf, uint32_t sample_ct, uintptr_t* sample_include, uintptr_t final_mask, uint32_t do_reverse);
+
 void vec_include_init(uintptr_t unfiltered_sample_ct, uintptr_t* new_include2, uintptr_t* old_include);
 
 void exclude_to_vec_include(uintptr_t unfiltered_sample_ct, uintptr_t* include_vec, uintptr_t* exclude_arr);
@@ -2339,6 +2566,23 @@ void join_threads2(pthread_t* threads, uint32_t ctp1, uint32_t is_last_block);
 int32_t spawn_threads2(pthread_t* threads, void* (*start_routine)(void*), uintptr_t ct, uint32_t is_last_block);
 #endif
 
+// Dynamic load balancing for spawn_threads2() workers.  The main thread calls
+// ws_ranges_init() before each spawn_threads2() call; every participating
+// thread (including tidx 0) then loops on ws_claim() instead of computing a
+// fixed slice.  A thread whose own range runs dry steals half of the largest
+// remaining range, so one slow item no longer holds up the whole block.
+// Results must not depend on which thread processes an item.
+typedef struct {
+  volatile uint64_t range;
+  unsigned char padding[CACHELINE - sizeof(uint64_t)];
+} Ws_range;
+
+extern Ws_range g_ws_ranges[];
+
+void ws_ranges_init(uint32_t thread_ct, uint32_t item_start, uint32_t item_ct);
+
+uint32_t ws_claim(uint32_t tidx, uint32_t chunk_size, uint32_t* start_ptr, uint32_t* end_ptr);
+
 extern sfmt_t** g_sfmtp_arr;
 
 uint32_t wkspace_init_sfmtp(uint32_t thread_ct);
@@ -2,11 +2,10 @@
 
 #include <ctype.h>
 #include <time.h>
-// no more mmap() dependency
-// #include <fcntl.h>
 
 #ifndef _WIN32
-// #include <sys/mman.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #endif
 
@@ -18,165 +17,241 @@
 
 #define PHENO_EPSILON 0.000030517578125
 
-int32_t sort_item_ids_nx(char** sorted_ids_ptr, uint32_t** id_map_ptr, uintptr_t item_ct, char* item_ids, uintptr_t max_id_len) {
-  // Version of sort_item_ids() with no exclusion.
-  // (Currently does NOT put id_map on the bottom.)
-  uintptr_t ulii;
-  char* sorted_ids;
-  char* dup_id;
-  char* tptr;
-  if (wkspace_alloc_c_checked(sorted_ids_ptr, item_ct * max_id_len) ||
-      wkspace_alloc_ui_checked(id_map_ptr, item_ct * sizeof(int32_t))) {
-    return RET_NOMEM;
-  }
-  sorted_ids = *sorted_ids_ptr;
-  if (!item_ct) {
-    return 0;
-  }
-  for (ulii = 0; ulii < item_ct; ulii++) {
-    memcpy(&(sorted_ids[ulii * max_id_len]), &(item_ids[ulii * max_id_len]), max_id_len);
-    (*id_map_ptr)[ulii] = ulii;
-  }
-  if (qsort_ext(sorted_ids, item_ct, max_id_len, strcmp_deref, (char*)(*id_map_ptr), sizeof(int32_t))) {
-    return RET_NOMEM;
-  }
-  dup_id = scan_for_duplicate_ids(sorted_ids, item_ct, max_id_len);
-  if (dup_id) {
-    tptr = strchr(dup_id, '\t');
-    if (tptr) {
-      *tptr = ' ';
-    }
-    LOGPRINTFWW("Error: Duplicate ID '%s'.\n", dup_id);
-    return RET_INVALID_FORMAT;
-  }
-  return 0;
-}
-
-int32_t sample_major_to_snp_major(char* sample_major_fname, char* outname, uintptr_t unfiltered_marker_ct, uintptr_t sample_ct, uint64_t fsize) {
-  // See below for old mmap() code.  Turns out this is more portable without
-  // being noticeably slower.
+int32_t transpose_2bit_file(FILE* infile, uint64_t in_offset, uintptr_t in_row_ct, uintptr_t in_col_ct, FILE* outfile) {
+  // Writes the transpose of an in_row_ct x in_col_ct matrix of 2-bit entries
+  // (each input row padded to a byte boundary, .bed-style) to outfile.  The
+  // output is assembled one block of rows at a time in wkspace; each block
+  // requires a full pass over the input.
   unsigned char* wkspace_mark = wkspace_base;
-  FILE* infile = NULL;
-  FILE* outfile = NULL;
-  uintptr_t unfiltered_marker_ct4 = (unfiltered_marker_ct + 3) / 4;
-  uintptr_t unfiltered_marker_ctl2 = (unfiltered_marker_ct + (BITCT2 - 1)) / BITCT2;
-  uintptr_t unfiltered_sample_ct4 = (sample_ct + 3) / 4;
-  uintptr_t marker_idx_end = 0;
-  uint32_t bed_offset = fsize - sample_ct * ((uint64_t)unfiltered_marker_ct4);
+  uintptr_t in_col_ct4 = (in_col_ct + 3) / 4;
+  uintptr_t in_col_ctl2 = (in_col_ct + (BITCT2 - 1)) / BITCT2;
+  uintptr_t in_row_ct4 = (in_row_ct + 3) / 4;
+  uintptr_t col_idx_end = 0;
   int32_t retval = 0;
   uintptr_t* loadbuf;
   uintptr_t* lptr;
   unsigned char* writebuf;
   unsigned char* ucptr;
-  uintptr_t write_marker_ct;
-  uintptr_t marker_idx_base;
-  uintptr_t marker_idx_block_end;
-  uintptr_t marker_idx;
-  uintptr_t sample_idx_base;
-  uintptr_t sample_idx_end;
-  uintptr_t sample_idx;
+  uintptr_t write_col_ct;
+  uintptr_t col_idx_base;
+  uintptr_t col_idx_block_end;
+  uintptr_t col_idx;
+  uintptr_t row_idx_base;
+  uintptr_t row_idx_end;
+  uintptr_t row_idx;
   uintptr_t cur_word0;
   uintptr_t cur_word1;
   uintptr_t cur_word2;
   uintptr_t cur_word3;
   // could make this allocation a bit smaller in multipass case, but whatever
-  if (wkspace_alloc_ul_checked(&loadbuf, unfiltered_marker_ctl2 * 4 * sizeof(intptr_t))) {
-    goto sample_major_to_snp_major_ret_NOMEM;
+  if (wkspace_alloc_ul_checked(&loadbuf, in_col_ctl2 * 4 * sizeof(intptr_t))) {
+    goto transpose_2bit_file_ret_NOMEM;
   }
-  if (wkspace_left < unfiltered_sample_ct4) {
-    goto sample_major_to_snp_major_ret_NOMEM;
+  if (wkspace_left < in_row_ct4) {
+    goto transpose_2bit_file_ret_NOMEM;
   }
   writebuf = (unsigned char*)wkspace_base;
-  write_marker_ct = BITCT2 * (wkspace_left / (unfiltered_sample_ct4 * BITCT2));
-  loadbuf[unfiltered_marker_ctl2 - 1] = 0;
-  loadbuf[2 * unfiltered_marker_ctl2 - 1] = 0;
-  loadbuf[3 * unfiltered_marker_ctl2 - 1] = 0;
-  loadbuf[4 * unfiltered_marker_ctl2 - 1] = 0;
-  if (fopen_checked(&infile, sample_major_fname, "rb")) {
-    goto sample_major_to_snp_major_ret_OPEN_FAIL;
-  }
-  if (fopen_checked(&outfile, outname, "wb")) {
-    goto sample_major_to_snp_major_ret_OPEN_FAIL;
-  }
-  if (fwrite_checked("l\x1b\x01", 3, outfile)) {
-    goto sample_major_to_snp_major_ret_WRITE_FAIL;
-  }
+  write_col_ct = BITCT2 * (wkspace_left / (in_row_ct4 * BITCT2));
+  loadbuf[in_col_ctl2 - 1] = 0;
+  loadbuf[2 * in_col_ctl2 - 1] = 0;
+  loadbuf[3 * in_col_ctl2 - 1] = 0;
+  loadbuf[4 * in_col_ctl2 - 1] = 0;
   do {
-    marker_idx_base = marker_idx_end;
-    marker_idx_end += write_marker_ct;
-    if (marker_idx_end > unfiltered_marker_ct) {
-      marker_idx_end = unfiltered_marker_ct;
+    col_idx_base = col_idx_end;
+    col_idx_end += write_col_ct;
+    if (col_idx_end > in_col_ct) {
+      col_idx_end = in_col_ct;
     }
-    if (fseeko(infile, bed_offset, SEEK_SET)) {
-      goto sample_major_to_snp_major_ret_READ_FAIL;
+    if (fseeko(infile, in_offset, SEEK_SET)) {
+      goto transpose_2bit_file_ret_READ_FAIL;
     }
-    for (sample_idx_end = 0; sample_idx_end < sample_ct;) {
-      sample_idx_base = sample_idx_end;
-      sample_idx_end = sample_idx_base + 4;
-      if (sample_idx_end > sample_ct) {
-	fill_ulong_zero(&(loadbuf[(sample_ct % 4) * unfiltered_marker_ctl2]), (4 - (sample_ct % 4)) * unfiltered_marker_ctl2);
-	sample_idx_end = sample_ct;
+    for (row_idx_end = 0; row_idx_end < in_row_ct;) {
+      row_idx_base = row_idx_end;
+      row_idx_end = row_idx_base + 4;
+      if (row_idx_end > in_row_ct) {
+	fill_ulong_zero(&(loadbuf[(in_row_ct % 4) * in_col_ctl2]), (4 - (in_row_ct % 4)) * in_col_ctl2);
+	row_idx_end = in_row_ct;
       }
       lptr = loadbuf;
-      for (sample_idx = sample_idx_base; sample_idx < sample_idx_end; sample_idx++) {
-        if (load_raw(infile, lptr, unfiltered_marker_ct4)) {
-	  goto sample_major_to_snp_major_ret_READ_FAIL;
+      for (row_idx = row_idx_base; row_idx < row_idx_end; row_idx++) {
+        if (load_raw(infile, lptr, in_col_ct4)) {
+	  goto transpose_2bit_file_ret_READ_FAIL;
         }
-	lptr = &(lptr[unfiltered_marker_ctl2]);
+	lptr = &(lptr[in_col_ctl2]);
       }
-      lptr = &(loadbuf[marker_idx_base / BITCT2]);
-      for (marker_idx_block_end = marker_idx_base; marker_idx_block_end < marker_idx_end; lptr++) {
-	marker_idx = marker_idx_block_end;
+      lptr = &(loadbuf[col_idx_base / BITCT2]);
+      for (col_idx_block_end = col_idx_base; col_idx_block_end < col_idx_end; lptr++) {
+	col_idx = col_idx_block_end;
         cur_word0 = *lptr;
-	cur_word1 = lptr[unfiltered_marker_ctl2];
-	cur_word2 = lptr[2 * unfiltered_marker_ctl2];
-	cur_word3 = lptr[3 * unfiltered_marker_ctl2];
-	marker_idx_block_end = marker_idx + BITCT2;
-	if (marker_idx_block_end > marker_idx_end) {
-          marker_idx_block_end = marker_idx_end;
-	}
-	ucptr = &(writebuf[(marker_idx - marker_idx_base) * unfiltered_sample_ct4 + (sample_idx_base / 4)]);
+	cur_word1 = lptr[in_col_ctl2];
+	cur_word2 = lptr[2 * in_col_ctl2];
+	cur_word3 = lptr[3 * in_col_ctl2];
+	col_idx_block_end = col_idx + BITCT2;
+	if (col_idx_block_end > col_idx_end) {
+          col_idx_block_end = col_idx_end;
+	}
+	ucptr = &(writebuf[(col_idx - col_idx_base) * in_row_ct4 + (row_idx_base / 4)]);
 	while (1) {
 	  *ucptr = (unsigned char)((cur_word0 & 3) | ((cur_word1 & 3) << 2) | ((cur_word2 & 3) << 4) | ((cur_word3 & 3) << 6));
-	  if (++marker_idx == marker_idx_block_end) {
+	  if (++col_idx == col_idx_block_end) {
 	    break;
 	  }
 	  cur_word0 >>= 2;
 	  cur_word1 >>= 2;
 	  cur_word2 >>= 2;
 	  cur_word3 >>= 2;
-	  ucptr = &(ucptr[unfiltered_sample_ct4]);
+	  ucptr = &(ucptr[in_row_ct4]);
 	}
       }
     }
-    if (fwrite_checked(writebuf, (marker_idx_end - marker_idx_base) * unfiltered_sample_ct4, outfile)) {
-      goto sample_major_to_snp_major_ret_WRITE_FAIL;
+    if (fwrite_checked(writebuf, (col_idx_end - col_idx_base) * in_row_ct4, outfile)) {
+      goto transpose_2bit_file_ret_WRITE_FAIL;
     }
-  } while (marker_idx_end < unfiltered_marker_ct);
+  } while (col_idx_end < in_col_ct);
+  while (0) {
+  transpose_2bit_file_ret_NOMEM:
+    retval = RET_NOMEM;
+    break;
+  transpose_2bit_file_ret_READ_FAIL:
+    retval = RET_READ_FAIL;
+    break;
+  transpose_2bit_file_ret_WRITE_FAIL:
+    retval = RET_WRITE_FAIL;
+    break;
+  }
+  wkspace_reset(wkspace_mark);
+  return retval;
+}
+
+int32_t sample_major_to_snp_major(char* sample_major_fname, char* outname, uintptr_t unfiltered_marker_ct, uintptr_t sample_ct, uint64_t fsize) {
+  // See below for old mmap() code.  Turns out this is more portable without
+  // being noticeably slower.
+  FILE* infile = NULL;
+  FILE* outfile = NULL;
+  uintptr_t unfiltered_marker_ct4 = (unfiltered_marker_ct + 3) / 4;
+  uint32_t bed_offset = fsize - sample_ct * ((uint64_t)unfiltered_marker_ct4);
+  int32_t retval = 0;
+  if (fopen_checked(&infile, sample_major_fname, "rb")) {
+    goto sample_major_to_snp_major_ret_OPEN_FAIL;
+  }
+  if (fopen_checked(&outfile, outname, "wb")) {
+    goto sample_major_to_snp_major_ret_OPEN_FAIL;
+  }
+  if (fwrite_checked("l\x1b\x01", 3, outfile)) {
+    goto sample_major_to_snp_major_ret_WRITE_FAIL;
+  }
+  retval = transpose_2bit_file(infile, bed_offset, sample_ct, unfiltered_marker_ct, outfile);
+  if (retval) {
+    goto sample_major_to_snp_major_ret_1;
+  }
   if (fclose_null(&outfile)) {
     goto sample_major_to_snp_major_ret_WRITE_FAIL;
   }
 
   while (0) {
-  sample_major_to_snp_major_ret_NOMEM:
-    retval = RET_NOMEM;
-    break;
   sample_major_to_snp_major_ret_OPEN_FAIL:
     retval = RET_OPEN_FAIL;
     break;
-  sample_major_to_snp_major_ret_READ_FAIL:
-    retval = RET_READ_FAIL;
-    break;
   sample_major_to_snp_major_ret_WRITE_FAIL:
     retval = RET_WRITE_FAIL;
     break;
   }
-  wkspace_reset(wkspace_mark);
+ sample_major_to_snp_major_ret_1:
   fclose_cond(infile);
   fclose_cond(outfile);
   return retval;
 }
 
+uint32_t g_sample_major_cache = 0;
+
+#define SMAJ_TRAILER_MAGIC "PLKSMAJ1"
+
+// Appended after the sample-major genotype rows.
+typedef struct {
+  char magic[8];
+  File_stamp bed_stamp;
+} Smaj_trailer;
+
+static void smaj_trailer_init(struct stat* bed_stat_ptr, Smaj_trailer* trailer_ptr) {
+  memcpy(trailer_ptr->magic, SMAJ_TRAILER_MAGIC, 8);
+  file_stamp_init(bed_stat_ptr, &(trailer_ptr->bed_stamp));
+}
+
+FILE* sample_major_cache_open(char* bedname, uintptr_t bed_offset, uintptr_t unfiltered_marker_ct, uintptr_t unfiltered_sample_ct) {
+  // The cache is a sample-major PLINK 1 .bed (magic bytes 0x6c 0x1b 0x00)
+  // followed by a Smaj_trailer identifying the .bed it was generated from.
+  // It's regenerated whenever the .bed doesn't match the trailer's stamp
+  // exactly.
+  FILE* outfile = NULL;
+  FILE* infile = NULL;
+  FILE* smajfile = NULL;
+  uint64_t geno_size = 3 + ((uint64_t)unfiltered_sample_ct) * ((unfiltered_marker_ct + 3) / 4);
+  uint32_t slen = strlen(bedname);
+  int32_t retval;
+  char smajname[FNAMESIZE + 5];
+  char tmpname[FNAMESIZE + 9];
+  char magic[3];
+  struct stat bed_stat;
+  struct stat smaj_stat;
+  Smaj_trailer trailer;
+  Smaj_trailer file_trailer;
+  if (slen + 5 > FNAMESIZE) {
+    return NULL;
+  }
+  memcpy(memcpya(smajname, bedname, slen), ".smaj", 6);
+  if (stat(bedname, &bed_stat)) {
+    return NULL;
+  }
+  smaj_trailer_init(&bed_stat, &trailer);
+  if ((!stat(smajname, &smaj_stat)) && ((uint64_t)smaj_stat.st_size == geno_size + sizeof(Smaj_trailer))) {
+    smajfile = fopen(smajname, "rb");
+    if (smajfile) {
+      if ((fread(magic, 1, 3, smajfile) == 3) && (!memcmp(magic, "l\x1b\x00", 3)) && (!fseeko(smajfile, geno_size, SEEK_SET)) && (fread(&file_trailer, sizeof(Smaj_trailer), 1, smajfile) == 1) && (!memcmp(file_trailer.magic, SMAJ_TRAILER_MAGIC, 8)) && file_stamp_matches(&(file_trailer.bed_stamp), &bed_stat) && (!fseeko(smajfile, 3, SEEK_SET))) {
+	return smajfile;
+      }
+      fclose(smajfile);
+      smajfile = NULL;
+    }
+  }
+  LOGPRINTFWW5("--sample-major-cache: Writing %s ... ", smajname);
+  fflush(stdout);
+  memcpy(memcpya(tmpname, smajname, slen + 5), ".tmp", 5);
+  infile = fopen(bedname, "rb");
+  if (!infile) {
+    goto sample_major_cache_open_ret_FAIL;
+  }
+  outfile = fopen(tmpname, "wb");
+  if (!outfile) {
+    goto sample_major_cache_open_ret_FAIL;
+  }
+  if (fwrite_checked("l\x1b\x00", 3, outfile)) {
+    goto sample_major_cache_open_ret_FAIL;
+  }
+  retval = transpose_2bit_file(infile, bed_offset, unfiltered_marker_ct, unfiltered_sample_ct, outfile);
+  // trailer describes the .bed as stat()ed before it was read, so a
+  // concurrent rewrite just makes the next run regenerate the cache
+  if (retval || fwrite_checked(&trailer, sizeof(Smaj_trailer), outfile) || fclose_null(&outfile) || rename(tmpname, smajname)) {
+    goto sample_major_cache_open_ret_FAIL;
+  }
+  fclose(infile);
+  smajfile = fopen(smajname, "rb");
+  if ((!smajfile) || fseeko(smajfile, 3, SEEK_SET)) {
+    fclose_cond(smajfile);
+    logprint("failed.\n");
+    return NULL;
+  }
+  logprint("done.\n");
+  return smajfile;
+ sample_major_cache_open_ret_FAIL:
+  fclose_cond(infile);
+  if (outfile) {
+    fclose(outfile);
+    unlink(tmpname);
+  }
+  logprint("failed.\n");
+  return NULL;
+}
+
 uint32_t chrom_error(const char* extension, Chrom_info* chrom_info_ptr, char* chrom_str, uintptr_t line_idx, int32_t error_code, uint32_t allow_extra_chroms) {
   if (allow_extra_chroms && (error_code == -2)) {
     return 0;
@@ -490,6 +565,308 @@ static inline uint32_t sf_out_of_range(uint32_t cur_pos, uint32_t chrom_idx, uin
   return 1;
 }
 
+#ifndef _WIN32
+// --bim-cache: binary sidecar for .bim files, written on first use and keyed
+// by the .bim's File_stamp.  After the header, each variant is stored as
+// a fixed 12-byte prefix (chromosome name index, raw bp coordinate, flags),
+// an optional centimorgan double, and null-terminated ID/A1/A2 strings; the
+// distinct chromosome names follow the last record, and then the .bim line
+// number where each name first appears, so errors can still cite it.
+// Everything filter- or species-dependent is still evaluated at load time, so
+// the same cache serves every command line.
+uint32_t g_bim_cache = 0;
+
+#define BIM_CACHE_MAGIC "PLKBIMC3"
+#define BIM_CACHE_REC_NONZERO_CM 1
+
+typedef struct {
+  char magic[8];
+  File_stamp bim_stamp;
+  uint64_t cache_size;
+  uint64_t marker_ct;
+  uint64_t chrom_names_offset;
+  uint64_t chrom_lines_offset;
+  uint32_t chrom_name_ct;
+  uint32_t map_cols;
+  uint32_t max_bim_linelen;
+  uint32_t max_marker_id_len;
+  uint32_t max_marker_allele_len;
+  uint32_t word_size;
+} Bim_cache_header;
+
+int32_t bim_cache_write(char* bimname, char* cachename, struct stat* bim_stat_ptr) {
+  // Any anomaly (pathologically long line, 5-column .bim, unparseable
+  // coordinate, etc.) just causes a nonzero return; the caller then falls
+  // back on the text loader, which reports the problem properly.
+  FILE* bimfile = NULL;
+  FILE* cachefile = NULL;
+  char* tmpname = NULL;
+  char* chrom_names = NULL;
+  uint64_t* chrom_lines = NULL;
+  uintptr_t chrom_names_alloc = 0;
+  uintptr_t chrom_lines_alloc = 0;
+  uintptr_t line_idx = 0;
+  uintptr_t chrom_names_len = 0;
+  uintptr_t prev_chrom_offset = 0;
+  uint32_t prev_chrom_slen = 0;
+  uint32_t prev_chrom_idx = 0xffffffffU;
+  uint32_t slen = strlen(cachename);
+  int32_t retval = 0;
+  Bim_cache_header hdr;
+  uint32_t rec_prefix[3];
+  char* loadbuf;
+  uintptr_t loadbuf_size;
+  char* bufptr;
+  char* id_ptr;
+  char* cm_ptr;
+  char* pos_ptr;
+  char* a1_ptr;
+  char* a2_ptr;
+  char* new_chrom_names;
+  uint64_t* new_chrom_lines;
+  uintptr_t chrom_offset;
+  double cur_cm;
+  uint32_t chrom_slen;
+  uint32_t id_slen;
+  uint32_t a1_slen;
+  uint32_t a2_slen;
+  uint32_t chrom_idx;
+  uint32_t uii;
+  int32_t cur_pos;
+  memset(&hdr, 0, sizeof(Bim_cache_header));
+  file_stamp_init(bim_stat_ptr, &hdr.bim_stamp);
+  hdr.map_cols = 4;
+  hdr.word_size = sizeof(intptr_t);
+  tmpname = (char*)malloc(slen + 5);
+  if (!tmpname) {
+    goto bim_cache_write_ret_NOMEM;
+  }
+  memcpy(memcpya(tmpname, cachename, slen), ".tmp", 5);
+  bimfile = fopen(bimname, "r");
+  if (!bimfile) {
+    goto bim_cache_write_ret_OPEN_FAIL;
+  }
+  cachefile = fopen(tmpname, "wb");
+  if (!cachefile) {
+    goto bim_cache_write_ret_OPEN_FAIL;
+  }
+  // header is rewritten once the counts are known
+  if (!fwrite(&hdr, sizeof(Bim_cache_header), 1, cachefile)) {
+    goto bim_cache_write_ret_WRITE_FAIL;
+  }
+  loadbuf_size = wkspace_left;
+  if (loadbuf_size > MAXLINEBUFLEN) {
+    loadbuf_size = MAXLINEBUFLEN;
+  } else if (loadbuf_size <= MAXLINELEN) {
+    goto bim_cache_write_ret_NOMEM;
+  }
+  loadbuf = (char*)wkspace_base;
+  loadbuf[loadbuf_size - 1] = ' ';
+  while (fgets(loadbuf, loadbuf_size, bimfile)) {
+    line_idx++;
+    if (!loadbuf[loadbuf_size - 1]) {
+      goto bim_cache_write_ret_INVALID_FORMAT;
+    }
+    uii = strlen(loadbuf);
+    if (uii >= hdr.max_bim_linelen) {
+      hdr.max_bim_linelen = uii + 1;
+    }
+    bufptr = skip_initial_spaces(loadbuf);
+    if (is_eoln_or_comment(*bufptr)) {
+      continue;
+    }
+    chrom_slen = strlen_se(bufptr);
+    id_ptr = next_token(bufptr);
+    cm_ptr = next_token(id_ptr);
+    pos_ptr = next_token(cm_ptr);
+    a1_ptr = next_token(pos_ptr);
+    a2_ptr = next_token(a1_ptr);
+    // 5-column .bim files end up here too; not worth supporting
+    if (no_more_tokens_kns(a2_ptr)) {
+      goto bim_cache_write_ret_INVALID_FORMAT;
+    }
+    if ((chrom_slen != prev_chrom_slen) || memcmp(bufptr, &(chrom_names[prev_chrom_offset]), chrom_slen)) {
+      // chromosome names are nearly always contiguous, so a linear scan on
+      // change is fine
+      chrom_offset = 0;
+      for (chrom_idx = 0; chrom_idx < hdr.chrom_name_ct; chrom_idx++) {
+	uii = strlen(&(chrom_names[chrom_offset]));
+	if ((uii == chrom_slen) && (!memcmp(bufptr, &(chrom_names[chrom_offset]), chrom_slen))) {
+	  break;
+	}
+	chrom_offset += uii + 1;
+      }
+      if (chrom_idx == hdr.chrom_name_ct) {
+	if (chrom_names_len + chrom_slen + 1 > chrom_names_alloc) {
+	  chrom_names_alloc = 2 * (chrom_names_len + chrom_slen + 1);
+	  new_chrom_names = (char*)realloc(chrom_names, chrom_names_alloc);
+	  if (!new_chrom_names) {
+	    goto bim_cache_write_ret_NOMEM;
+	  }
+	  chrom_names = new_chrom_names;
+	}
+	if (hdr.chrom_name_ct == chrom_lines_alloc) {
+	  chrom_lines_alloc = 2 * chrom_lines_alloc + 16;
+	  new_chrom_lines = (uint64_t*)realloc(chrom_lines, chrom_lines_alloc * sizeof(int64_t));
+	  if (!new_chrom_lines) {
+	    goto bim_cache_write_ret_NOMEM;
+	  }
+	  chrom_lines = new_chrom_lines;
+	}
+	chrom_lines[hdr.chrom_name_ct] = line_idx;
+	chrom_offset = chrom_names_len;
+	memcpyx(&(chrom_names[chrom_offset]), bufptr, chrom_slen, '\0');
+	chrom_names_len += chrom_slen + 1;
+	hdr.chrom_name_ct++;
+      }
+      prev_chrom_idx = chrom_idx;
+      prev_chrom_offset = chrom_offset;
+      prev_chrom_slen = chrom_slen;
+    }
+    rec_prefix[0] = prev_chrom_idx;
+    if (scan_int_abs_defcap(pos_ptr, &cur_pos)) {
+      goto bim_cache_write_ret_INVALID_FORMAT;
+    }
+    rec_prefix[1] = (uint32_t)cur_pos;
+    rec_prefix[2] = 0;
+    if ((*cm_ptr != '0') || (cm_ptr[1] > ' ')) {
+      if (scan_double(cm_ptr, &cur_cm)) {
+	goto bim_cache_write_ret_INVALID_FORMAT;
+      }
+      rec_prefix[2] = BIM_CACHE_REC_NONZERO_CM;
+    }
+    id_slen = strlen_se(id_ptr);
+    a1_slen = strlen_se(a1_ptr);
+    a2_slen = strlen_se(a2_ptr);
+    if (id_slen >= hdr.max_marker_id_len) {
+      hdr.max_marker_id_len = id_slen + 1;
+    }
+    if (a1_slen >= hdr.max_marker_allele_len) {
+      hdr.max_marker_allele_len = a1_slen + 1;
+    }
+    if (a2_slen >= hdr.max_marker_allele_len) {
+      hdr.max_marker_allele_len = a2_slen + 1;
+    }
+    id_ptr[id_slen] = '\0';
+    a1_ptr[a1_slen] = '\0';
+    a2_ptr[a2_slen] = '\0';
+    if ((!fwrite(rec_prefix, 3 * sizeof(int32_t), 1, cachefile)) ||
+        (rec_prefix[2] && (!fwrite(&cur_cm, sizeof(double), 1, cachefile))) ||
+        (!fwrite(id_ptr, id_slen + 1, 1, cachefile)) ||
+        (!fwrite(a1_ptr, a1_slen + 1, 1, cachefile)) ||
+        (!fwrite(a2_ptr, a2_slen + 1, 1, cachefile))) {
+      goto bim_cache_write_ret_WRITE_FAIL;
+    }
+    hdr.marker_ct++;
+  }
+  if ((!feof(bimfile)) || (!hdr.marker_ct)) {
+    goto bim_cache_write_ret_INVALID_FORMAT;
+  }
+  hdr.chrom_names_offset = (uint64_t)ftello(cachefile);
+  if (!fwrite(chrom_names, chrom_names_len, 1, cachefile)) {
+    goto bim_cache_write_ret_WRITE_FAIL;
+  }
+  hdr.chrom_lines_offset = (uint64_t)ftello(cachefile);
+  if (!fwrite(chrom_lines, hdr.chrom_name_ct * sizeof(int64_t), 1, cachefile)) {
+    goto bim_cache_write_ret_WRITE_FAIL;
+  }
+  hdr.cache_size = (uint64_t)ftello(cachefile);
+  memcpy(hdr.magic, BIM_CACHE_MAGIC, 8);
+  rewind(cachefile);
+  if (!fwrite(&hdr, sizeof(Bim_cache_header), 1, cachefile)) {
+    goto bim_cache_write_ret_WRITE_FAIL;
+  }
+  if (fclose_null(&cachefile)) {
+    goto bim_cache_write_ret_WRITE_FAIL;
+  }
+  if (rename(tmpname, cachename)) {
+    goto bim_cache_write_ret_WRITE_FAIL;
+  }
+  while (0) {
+  bim_cache_write_ret_NOMEM:
+    retval = RET_NOMEM;
+    break;
+  bim_cache_write_ret_OPEN_FAIL:
+    retval = RET_OPEN_FAIL;
+    break;
+  bim_cache_write_ret_WRITE_FAIL:
+    retval = RET_WRITE_FAIL;
+    break;
+  bim_cache_write_ret_INVALID_FORMAT:
+    retval = RET_INVALID_FORMAT;
+    break;
+  }
+  fclose_cond(bimfile);
+  if (cachefile) {
+    fclose(cachefile);
+  }
+  if (retval && tmpname) {
+    unlink(tmpname);
+  }
+  free_cond(tmpname);
+  free_cond(chrom_names);
+  free_cond(chrom_lines);
+  return retval;
+}
+
+unsigned char* bim_cache_map(char* bimname, uintptr_t* map_size_ptr) {
+  // Returns a private writable mapping of a valid cache for bimname,
+  // (re)building the cache first if necessary, or NULL if no cache can be
+  // used.  chrom_error() null-terminates in place, hence the copy-on-write
+  // mapping.
+  char* cachename = NULL;
+  unsigned char* map_base = NULL;
+  uint32_t slen = strlen(bimname);
+  uint32_t attempt_idx = 0;
+  Bim_cache_header* hdrp;
+  struct stat bim_stat;
+  struct stat cache_stat;
+  int32_t fd;
+  if (stat(bimname, &bim_stat)) {
+    return NULL;
+  }
+  cachename = (char*)malloc(slen + 7);
+  if (!cachename) {
+    return NULL;
+  }
+  memcpy(memcpya(cachename, bimname, slen), ".cache", 7);
+  while (1) {
+    fd = open(cachename, O_RDONLY);
+    if (fd != -1) {
+      if ((!fstat(fd, &cache_stat)) && ((uint64_t)cache_stat.st_size >= sizeof(Bim_cache_header)) && ((uint64_t)((uintptr_t)cache_stat.st_size) == (uint64_t)cache_stat.st_size)) {
+	map_base = (unsigned char*)mmap(NULL, cache_stat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (map_base == MAP_FAILED) {
+	  map_base = NULL;
+	} else {
+	  hdrp = (Bim_cache_header*)map_base;
+	  if ((!memcmp(hdrp->magic, BIM_CACHE_MAGIC, 8)) && (hdrp->word_size == sizeof(intptr_t)) && file_stamp_matches(&(hdrp->bim_stamp), &bim_stat) && (hdrp->cache_size == (uint64_t)cache_stat.st_size)) {
+	    *map_size_ptr = cache_stat.st_size;
+	    madvise(map_base, cache_stat.st_size, MADV_SEQUENTIAL);
+	  } else {
+	    munmap(map_base, cache_stat.st_size);
+	    map_base = NULL;
+	  }
+	}
+      }
+      close(fd);
+    }
+    if (map_base || attempt_idx) {
+      break;
+    }
+    attempt_idx = 1;
+    LOGPRINTFWW5("--bim-cache: Writing %s ... ", cachename);
+    fflush(stdout);
+    if (bim_cache_write(bimname, cachename, &bim_stat)) {
+      logprint("failed; falling back on text loader.\n");
+      break;
+    }
+    logprint("done.\n");
+  }
+  free(cachename);
+  return map_base;
+}
+#endif
+
 int32_t load_bim(char* bimname, uint32_t* map_cols_ptr, uintptr_t* unfiltered_marker_ct_ptr, uintptr_t* marker_exclude_ct_ptr, uintptr_t* max_marker_id_len_ptr, uintptr_t** marker_exclude_ptr, double** set_allele_freqs_ptr, uint32_t** nchrobs_ptr, char*** marker_allele_pp, uintptr_t* max_marker_allele_len_ptr, char** marker_ids_ptr, char* missing_mid_template, uint32_t new_id_max_allele_len, const char* missing_marker_id_match, Chrom_info* chrom_info_ptr, double** marker_cms_ptr, uint32_t** marker_pos_ptr, uint64_t misc_flags, uint64_t filter_flags, int32_t marker_pos_start, int32_t marker_pos_end, int32_t snp_window_size, char* markername_from, char* markername_to, char* markername_snp, Range_list* sf_range_list_ptr, uint32_t* map_is_unsorted_ptr, uint32_t marker_pos_needed, uint32_t marker_cms_needed, uint32_t marker_alleles_needed, const char* split_chrom_cmd, const char* ftype_str, uint32_t* max_bim_linelen_ptr) {
   // supports .map now too, to make e.g. --snps + --dosage work
   unsigned char* wkspace_mark = wkspace_base;
@@ -541,6 +918,9 @@ int32_t load_bim(char* bimname, uint32_t* map_cols_ptr, uintptr_t* unfiltered_ma
   char* bufptr4 = NULL;
   char* bufptr5 = NULL;
   char** marker_allele_ptrs = NULL;
+  unsigned char* bim_cache = NULL;
+  int32_t* bim_cache_chrom_codes = NULL;
+  uintptr_t bim_cache_size = 0;
   uintptr_t loaded_chrom_mask[CHROM_MASK_WORDS];
   uintptr_t sf_mask[CHROM_MASK_WORDS];
   uint32_t missing_template_seg_len[5];
@@ -566,6 +946,11 @@ int32_t load_bim(char* bimname, uint32_t* map_cols_ptr, uintptr_t* unfiltered_ma
   int32_t jj;
   uint32_t cur_pos;
   char cc;
+#ifndef _WIN32
+  Bim_cache_header* bim_cache_hdrp;
+  uint64_t bim_cache_line_idx;
+  unsigned char* bim_cache_rec;
+#endif
   fill_ulong_zero(loaded_chrom_mask, CHROM_MASK_WORDS);
   insert_buf[0] = NULL;
   insert_buf[1] = NULL;
@@ -634,6 +1019,50 @@ int32_t load_bim(char* bimname, uint32_t* map_cols_ptr, uintptr_t* unfiltered_ma
       }
     }
   }
+#ifndef _WIN32
+  if (g_bim_cache && (ftype_str[1] == 'b') && (!missing_mid_template) && (!slen_check)) {
+    // first pass replacement: only need to resolve chromosome names, in order
+    // of first appearance so nonstandard codes are assigned exactly as the
+    // text loader would
+    bim_cache = bim_cache_map(bimname, &bim_cache_size);
+    if (bim_cache) {
+      bim_cache_hdrp = (Bim_cache_header*)bim_cache;
+      bim_cache_chrom_codes = (int32_t*)malloc(bim_cache_hdrp->chrom_name_ct * sizeof(int32_t));
+      if (!bim_cache_chrom_codes) {
+	goto load_bim_ret_NOMEM;
+      }
+      bufptr = (char*)(&(bim_cache[bim_cache_hdrp->chrom_names_offset]));
+      for (uii = 0; uii < bim_cache_hdrp->chrom_name_ct; uii++) {
+	jj = get_chrom_code(chrom_info_ptr, bufptr);
+	if (jj < 0) {
+	  // same line number the text loader would report
+	  memcpy(&bim_cache_line_idx, &(bim_cache[bim_cache_hdrp->chrom_lines_offset + uii * sizeof(int64_t)]), sizeof(int64_t));
+	  if (chrom_error(ftype_str, chrom_info_ptr, bufptr, (uintptr_t)bim_cache_line_idx, jj, allow_extra_chroms)) {
+	    goto load_bim_ret_INVALID_FORMAT;
+	  }
+	  retval = resolve_or_add_chrom_name(chrom_info_ptr, bufptr, &jj, (uintptr_t)bim_cache_line_idx, ftype_str);
+	  if (retval) {
+	    goto load_bim_ret_1;
+	  }
+	}
+	bim_cache_chrom_codes[uii] = jj;
+	bufptr = &(bufptr[strlen(bufptr) + 1]);
+      }
+      unfiltered_marker_ct = bim_cache_hdrp->marker_ct;
+      max_bim_linelen = bim_cache_hdrp->max_bim_linelen;
+      if (bim_cache_hdrp->max_marker_id_len > max_marker_id_len) {
+	max_marker_id_len = bim_cache_hdrp->max_marker_id_len;
+      }
+      if (marker_alleles_needed && (bim_cache_hdrp->max_marker_allele_len > max_marker_allele_len)) {
+	max_marker_allele_len = bim_cache_hdrp->max_marker_allele_len;
+      }
+      // only 6-column .bim files are cached
+      *map_cols_ptr = 4;
+      mcm2 = 2;
+      goto load_bim_first_pass_done;
+    }
+  }
+#endif
   if (fopen_checked(&bimfile, bimname, "r")) {
     goto load_bim_ret_OPEN_FAIL;
   }
@@ -941,6 +1370,9 @@ int32_t load_bim(char* bimname, uint32_t* map_cols_ptr, uintptr_t* unfiltered_ma
   if (!feof(bimfile)) {
     goto load_bim_ret_READ_FAIL;
   }
+#ifndef _WIN32
+ load_bim_first_pass_done:
+#endif
   if (!unfiltered_marker_ct) {
     sprintf(logbuf, "Error: No variants in %s.\n", ftype_str);
     goto load_bim_ret_INVALID_FORMAT_2;
@@ -1013,7 +1445,9 @@ int32_t load_bim(char* bimname, uint32_t* map_cols_ptr, uintptr_t* unfiltered_ma
   }
   *unfiltered_marker_ct_ptr = unfiltered_marker_ct;
   *max_marker_id_len_ptr = max_marker_id_len;
-  rewind(bimfile);
+  if (bimfile) {
+    rewind(bimfile);
+  }
   unfiltered_marker_ctl = (unfiltered_marker_ct + (BITCT - 1)) / BITCT;
 
   // unfiltered_marker_ct can be very large, so use wkspace for all allocations
@@ -1096,6 +1530,100 @@ int32_t load_bim(char* bimname, uint32_t* map_cols_ptr, uintptr_t* unfiltered_ma
     }
     *prev_new_id = '\0';
   }
+#ifndef _WIN32
+  if (bim_cache) {
+    bim_cache_rec = &(bim_cache[sizeof(Bim_cache_header)]);
+    for (marker_uidx = 0; marker_uidx < unfiltered_marker_ct; marker_uidx++) {
+      // unn = chromosome name index, uoo = record flags
+      memcpy(&unn, bim_cache_rec, sizeof(int32_t));
+      memcpy(&cur_pos, &(bim_cache_rec[4]), sizeof(int32_t));
+      memcpy(&uoo, &(bim_cache_rec[8]), sizeof(int32_t));
+      bim_cache_rec = &(bim_cache_rec[12]);
+      bufptr = (char*)bim_cache_rec;
+      if (uoo & BIM_CACHE_REC_NONZERO_CM) {
+	bim_cache_rec = &(bim_cache_rec[sizeof(double)]);
+      }
+      bufptr2 = (char*)bim_cache_rec;
+      uii = strlen(bufptr2);
+      bufptr4 = &(bufptr2[uii + 1]);
+      ukk = strlen(bufptr4);
+      bufptr5 = &(bufptr4[ukk + 1]);
+      umm = strlen(bufptr5);
+      bim_cache_rec = (unsigned char*)(&(bufptr5[umm + 1]));
+      jj = bim_cache_chrom_codes[unn];
+      if (jj != prev_chrom) {
+	if (!split_chrom) {
+	  if (prev_chrom != -1) {
+	    chrom_info_ptr->chrom_end[(uint32_t)prev_chrom] = marker_uidx;
+	  }
+	  if (jj < prev_chrom) {
+	    *map_is_unsorted_ptr |= UNSORTED_CHROM;
+	  }
+	  prev_chrom = jj;
+	  if (is_set(loaded_chrom_mask, jj)) {
+	    if (split_chrom_cmd) {
+	      sprintf(logbuf, "Error: %s has a split chromosome.  Use --%s by itself to\nremedy this.\n", ftype_str, split_chrom_cmd);
+	      goto load_bim_ret_INVALID_FORMAT_2;
+	    }
+	    split_chrom = 1;
+	    *map_is_unsorted_ptr = UNSORTED_CHROM | UNSORTED_BP | UNSORTED_SPLIT_CHROM;
+	  } else {
+	    chrom_info_ptr->chrom_start[(uint32_t)jj] = marker_uidx;
+	    chrom_info_ptr->chrom_file_order[++chroms_encountered_m1] = jj;
+	    chrom_info_ptr->chrom_file_order_marker_idx[chroms_encountered_m1] = marker_uidx;
+	  }
+	  last_pos = 0;
+	}
+	set_bit(loaded_chrom_mask, jj);
+      }
+      if (is_set(chrom_info_ptr->chrom_mask, jj)) {
+	memcpy(&((*marker_ids_ptr)[marker_uidx * max_marker_id_len]), bufptr2, uii + 1);
+	if (marker_cms_needed && (uoo & BIM_CACHE_REC_NONZERO_CM)) {
+	  if (!(*marker_cms_ptr)) {
+	    if (wkspace_alloc_d_checked(marker_cms_ptr, unfiltered_marker_ct * sizeof(double))) {
+	      goto load_bim_ret_NOMEM;
+	    }
+	    fill_double_zero(*marker_cms_ptr, unfiltered_marker_ct);
+	  }
+	  memcpy(&((*marker_cms_ptr)[marker_uidx]), bufptr, sizeof(double));
+	}
+	if ((int32_t)cur_pos < 0) {
+	  goto load_bim_cache_skip_marker;
+	}
+	if (cur_pos < last_pos) {
+	  *map_is_unsorted_ptr |= UNSORTED_BP;
+	} else {
+	  last_pos = cur_pos;
+	}
+	if ((marker_pos_start != -1) && ((((int32_t)cur_pos) < marker_pos_start) || (((int32_t)cur_pos) > marker_pos_end))) {
+	  goto load_bim_cache_skip_marker;
+	}
+	if (marker_pos_needed) {
+	  (*marker_pos_ptr)[marker_uidx] = cur_pos;
+	}
+	if (marker_alleles_needed) {
+	  if (snps_only) {
+	    if ((ukk != 1) || (umm != 1) || (snps_only_no_di && ((*bufptr4 == 'D') || (*bufptr4 == 'I') || (*bufptr5 == 'D') || (*bufptr5 == 'I')))) {
+	      goto load_bim_cache_skip_marker;
+	    }
+	  }
+	  if (allele_set(&(marker_allele_ptrs[marker_uidx * 2]), bufptr4, ukk) ||
+	      allele_set(&(marker_allele_ptrs[marker_uidx * 2 + 1]), bufptr5, umm)) {
+	    goto load_bim_ret_NOMEM;
+	  }
+	}
+      } else {
+      load_bim_cache_skip_marker:
+	SET_BIT(marker_exclude, marker_uidx);
+	marker_exclude_ct++;
+	if (marker_pos_needed) {
+	  (*marker_pos_ptr)[marker_uidx] = last_pos;
+	}
+      }
+    }
+    goto load_bim_second_pass_done;
+  }
+#endif
   line_idx = 0;
   for (marker_uidx = 0; marker_uidx < unfiltered_marker_ct; marker_uidx++) {
     do {
@@ -1274,6 +1802,9 @@ int32_t load_bim(char* bimname, uint32_t* map_cols_ptr, uintptr_t* unfiltered_ma
       }
     }
   }
+#ifndef _WIN32
+ load_bim_second_pass_done:
+#endif
   if (unfiltered_marker_ct == marker_exclude_ct) {
     logprint("Error: All variants excluded.\n");
     goto load_bim_ret_ALL_MARKERS_EXCLUDED;
@@ -1337,6 +1868,12 @@ int32_t load_bim(char* bimname, uint32_t* map_cols_ptr, uintptr_t* unfiltered_ma
   }
  load_bim_ret_1:
   fclose_cond(bimfile);
+#ifndef _WIN32
+  if (bim_cache) {
+    munmap(bim_cache, bim_cache_size);
+  }
+#endif
+  free_cond(bim_cache_chrom_codes);
   free_cond(sf_start_idxs);
   free_cond(sf_pos);
   free_cond(loadbuf2);
@@ -3977,22 +4514,98 @@ int32_t load_fam(char* famname, uint32_t fam_cols, uint32_t tmp_fam_col_6, int32
 
 #define D_EPSILON 0.000244140625
 
-int32_t oxford_to_bed(char* genname, char* samplename, char* outname, char* outname_end, char* single_chr, char* pheno_name, double hard_call_threshold, char* missing_code, int32_t missing_pheno, uint64_t misc_flags, uint32_t is_bgen, Chrom_info* chrom_info_ptr) {
-  unsigned char* wkspace_mark = wkspace_base;
-  FILE* infile = NULL;
-  gzFile gz_infile = NULL;
-  FILE* outfile = NULL;
-  FILE* outfile_bim = NULL;
-  uintptr_t mc_ct = 0;
-  uintptr_t max_mc_len = 0;
-  uintptr_t line_idx = 0;
-  double hard_call_floor = 1.0 - hard_call_threshold;
-  char* loadbuf = NULL;
-  char* sorted_mc = NULL;
-  char* tbuf2 = &(tbuf[MAXLINELEN]); // .fam write
+// --bgen import: the main thread parses variant headers and writes the .bim
+// file, while worker threads decompress batches of probability blocks and
+// hard-call them.
+#define BGEN_BATCH_MAX 4096
 
-  // 0 = not present, otherwise zero-based index (this is fine since first
-  //     column has to be FID)
+static unsigned char* g_bgen_raw;
+static uintptr_t* g_bgen_block_offsets;
+static uint32_t* g_bgen_block_lens;
+static unsigned char* g_bgen_block_bad;
+static uint16_t* g_bgen_probs;
+static uintptr_t* g_bgen_writebufs;
+static uintptr_t g_bgen_probs_stride;
+static uint32_t g_bgen_sample_ct;
+static uint32_t g_bgen_compressed;
+static uint32_t g_bgen_hardthresh;
+static uint32_t g_bgen_is_randomized;
+
+void bgen_hard_call(const uint16_t* probs, uint32_t sample_ct, uint32_t bgen_hardthresh, uintptr_t* writebuf) {
+  uintptr_t cur_word = 0;
+  uint32_t shiftval = 0;
+  uint32_t sample_idx;
+  uintptr_t ulii;
+  for (sample_idx = 0; sample_idx < sample_ct; sample_idx++, probs = &(probs[3])) {
+    if (probs[2] >= bgen_hardthresh) {
+      ulii = 3;
+    } else if (probs[1] >= bgen_hardthresh) {
+      ulii = 2;
+    } else if (probs[0] >= bgen_hardthresh) {
+      ulii = 0;
+    } else {
+      ulii = 1;
+    }
+    cur_word |= ulii << shiftval;
+    shiftval += 2;
+    if (shiftval == BITCT) {
+      *writebuf++ = cur_word;
+      cur_word = 0;
+      shiftval = 0;
+    }
+  }
+  if (shiftval) {
+    *writebuf = cur_word;
+  }
+}
+
+THREAD_RET_TYPE bgen_block_thread(void* arg) {
+  uintptr_t tidx = (uintptr_t)arg;
+  uint32_t sample_ct = g_bgen_sample_ct;
+  uintptr_t sample_ctl2 = (sample_ct + BITCT2 - 1) / BITCT2;
+  uint32_t is_randomized = g_bgen_is_randomized;
+  uint16_t* probs;
+  uLongf zlib_ulongf;
+  uint32_t block_idx;
+  uint32_t block_idx_end;
+  while (ws_claim(tidx, 1, &block_idx, &block_idx_end)) {
+    for (; block_idx < block_idx_end; block_idx++) {
+      // randomized hard calls must be made in file order, so in that case
+      // the probabilities are only decompressed here
+      probs = &(g_bgen_probs[(is_randomized? block_idx : tidx) * g_bgen_probs_stride]);
+      if (g_bgen_compressed) {
+	zlib_ulongf = 6 * sample_ct;
+	if (uncompress((Bytef*)probs, &zlib_ulongf, (Bytef*)(&(g_bgen_raw[g_bgen_block_offsets[block_idx]])), g_bgen_block_lens[block_idx]) != Z_OK) {
+	  g_bgen_block_bad[block_idx] = 1;
+	  continue;
+	}
+      } else {
+	probs = (uint16_t*)(&(g_bgen_raw[g_bgen_block_offsets[block_idx]]));
+      }
+      if (!is_randomized) {
+	bgen_hard_call(probs, sample_ct, g_bgen_hardthresh, &(g_bgen_writebufs[block_idx * sample_ctl2]));
+      }
+    }
+  }
+  THREAD_RETURN;
+}
+
+int32_t oxford_to_bed(char* genname, char* samplename, char* outname, char* outname_end, char* single_chr, char* pheno_name, double hard_call_threshold, char* missing_code, int32_t missing_pheno, uint64_t misc_flags, uint32_t is_bgen, Chrom_info* chrom_info_ptr) {
+  unsigned char* wkspace_mark = wkspace_base;
+  FILE* infile = NULL;
+  gzFile gz_infile = NULL;
+  FILE* outfile = NULL;
+  FILE* outfile_bim = NULL;
+  uintptr_t mc_ct = 0;
+  uintptr_t max_mc_len = 0;
+  uintptr_t line_idx = 0;
+  double hard_call_floor = 1.0 - hard_call_threshold;
+  char* loadbuf = NULL;
+  char* sorted_mc = NULL;
+  char* tbuf2 = &(tbuf[MAXLINELEN]); // .fam write
+
+  // 0 = not present, otherwise zero-based index (this is fine since first
+  //     column has to be FID)
   uint32_t sex_col = 0;
 
   uint32_t pheno_name_len = 0;
@@ -4007,7 +4620,9 @@ int32_t oxford_to_bed(char* genname, char* samplename, char* outname, char* outn
   uint32_t is_randomized = (hard_call_threshold == -1);
   uint32_t bgen_hardthresh = 0;
   uint32_t marker_ct = 0;
+  uint32_t thread_ct = g_thread_ct;
   int32_t retval = 0;
+  pthread_t threads[MAX_THREADS];
   uint32_t uint_arr[4];
   char missing_pheno_str[12];
   char* bufptr;
@@ -4019,6 +4634,15 @@ int32_t oxford_to_bed(char* genname, char* samplename, char* outname, char* outn
   uintptr_t* ulptr;
   uint16_t* bgen_probs;
   uint16_t* usptr;
+  uint32_t* batch_marker_uidxs;
+  unsigned char* batch_identical_alleles;
+  uintptr_t raw_size;
+  uintptr_t raw_used;
+  uintptr_t batch_max;
+  uintptr_t batch_ct;
+  uintptr_t batch_idx;
+  uintptr_t pending_block_len;
+  uint32_t pending_identical_alleles;
   uintptr_t loadbuf_size;
   uintptr_t slen;
   uintptr_t cur_word;
@@ -4028,7 +4652,6 @@ int32_t oxford_to_bed(char* genname, char* samplename, char* outname, char* outn
   double dyy;
   double dzz;
   double drand;
-  uLongf zlib_ulongf;
   uint32_t missing_pheno_len;
   uint32_t raw_marker_ct;
   uint32_t marker_uidx;
@@ -4612,18 +5235,6 @@ int32_t oxford_to_bed(char* genname, char* samplename, char* outname, char* outn
     }
     // supports BGEN v1.0 and v1.1.  (online documentation seems to have
     // several errors as of this writing, ugh)
-    bgen_probs = (uint16_t*)wkspace_alloc(6 * sample_ct);
-    if (!bgen_probs) {
-      goto oxford_to_bed_ret_NOMEM;
-    }
-    loadbuf = (char*)wkspace_base;
-    loadbuf_size = wkspace_left;
-    if (loadbuf_size > MAXLINEBUFLEN) {
-      // halve the limit since there are two alleles
-      loadbuf_size = MAXLINEBUFLEN;
-    } else if (loadbuf_size < 3 * 65536) {
-      goto oxford_to_bed_ret_NOMEM;
-    }
     if (fread(uint_arr, 1, 16, infile) < 16) {
       goto oxford_to_bed_ret_READ_FAIL;
     }
@@ -4662,355 +5273,438 @@ int32_t oxford_to_bed(char* genname, char* samplename, char* outname, char* outn
     if (!is_randomized) {
       bgen_hardthresh = 32768 - (int32_t)(hard_call_threshold * 32768);
     }
+    if (thread_ct > BGEN_BATCH_MAX) {
+      thread_ct = BGEN_BATCH_MAX;
+    }
+    // per-thread (or, with randomized hard calls, per-variant) decompression
+    // buffers, .bed records and block metadata for each batch; then a
+    // quarter of what's left for variant headers, and the rest for
+    // compressed blocks
+    g_bgen_probs_stride = CACHEALIGN(6 * ((uintptr_t)sample_ct)) / sizeof(int16_t);
+    ulii = sample_ctl2 * sizeof(intptr_t) + 2 * sizeof(intptr_t) + 2 * sizeof(int32_t) + 2;
+    if (is_randomized) {
+      ulii += g_bgen_probs_stride * sizeof(int16_t);
+      uljj = 0;
+    } else {
+      uljj = thread_ct * g_bgen_probs_stride * sizeof(int16_t);
+    }
+    if (wkspace_left < uljj + 4 * CACHELINE) {
+      goto oxford_to_bed_ret_NOMEM;
+    }
+    batch_max = (wkspace_left - uljj) / (4 * ulii);
+    if (!batch_max) {
+      goto oxford_to_bed_ret_NOMEM;
+    } else if (batch_max > BGEN_BATCH_MAX) {
+      batch_max = BGEN_BATCH_MAX;
+    }
+    bgen_probs = (uint16_t*)wkspace_alloc((is_randomized? batch_max : thread_ct) * g_bgen_probs_stride * sizeof(int16_t));
+    if ((!bgen_probs) ||
+        wkspace_alloc_ul_checked(&writebuf, batch_max * sample_ctl2 * sizeof(intptr_t)) ||
+        wkspace_alloc_ul_checked(&g_bgen_block_offsets, batch_max * sizeof(intptr_t)) ||
+        wkspace_alloc_ui_checked(&g_bgen_block_lens, batch_max * sizeof(int32_t)) ||
+        wkspace_alloc_ui_checked(&batch_marker_uidxs, batch_max * sizeof(int32_t)) ||
+        wkspace_alloc_uc_checked(&g_bgen_block_bad, batch_max) ||
+        wkspace_alloc_uc_checked(&batch_identical_alleles, batch_max)) {
+      goto oxford_to_bed_ret_NOMEM;
+    }
+    loadbuf_size = wkspace_left / 4;
+    if (loadbuf_size > MAXLINEBUFLEN) {
+      loadbuf_size = MAXLINEBUFLEN;
+    } else if (loadbuf_size < 3 * 65536) {
+      goto oxford_to_bed_ret_NOMEM;
+    }
+    loadbuf = (char*)wkspace_alloc(loadbuf_size);
+    g_bgen_raw = wkspace_base;
+    raw_size = wkspace_left & (~(CACHELINE - ONELU));
+    if (raw_size < 6 * ((uintptr_t)sample_ct)) {
+      goto oxford_to_bed_ret_NOMEM;
+    }
+    g_bgen_probs = bgen_probs;
+    g_bgen_writebufs = writebuf;
+    g_bgen_sample_ct = sample_ct;
+    g_bgen_compressed = bgen_compressed;
+    g_bgen_hardthresh = bgen_hardthresh;
+    g_bgen_is_randomized = is_randomized;
+    pending_block_len = 0;
+    pending_identical_alleles = 0;
+    marker_uidx = 0;
     memcpyl3(tbuf, " 0 ");
-    for (marker_uidx = 0; marker_uidx < raw_marker_ct; marker_uidx++) {
-      if (fread(&uii, 1, 4, infile) < 4) {
-	goto oxford_to_bed_ret_READ_FAIL;
-      }
-      if (uii != sample_ct) {
-	logprint("Error: Unexpected number of samples specified in SNP block header.\n");
-	goto oxford_to_bed_ret_INVALID_FORMAT;
-      }
-      if (bgen_multichar_alleles) {
-        if (fread(&usii, 1, 2, infile) < 2) {
+    while (1) {
+      batch_ct = 0;
+      raw_used = 0;
+      if (pending_block_len) {
+	// header of this variant was processed at the end of the last batch
+	if (fread(g_bgen_raw, 1, pending_block_len, infile) < pending_block_len) {
 	  goto oxford_to_bed_ret_READ_FAIL;
 	}
-	if (!snpid_chr) {
-	  if (fseeko(infile, usii, SEEK_CUR)) {
-	    goto oxford_to_bed_ret_READ_FAIL;
-	  }
-	  bufptr = loadbuf;
-	} else {
-	  if (!usii) {
-	    logprint("Error: Length-0 SNP ID in .bgen file.\n");
-	    goto oxford_to_bed_ret_INVALID_FORMAT;
-	  }
-	  if (fread(loadbuf, 1, usii, infile) < usii) {
-	    goto oxford_to_bed_ret_READ_FAIL;
-	  }
-	  loadbuf[usii] = '\0';
-	  bufptr = &(loadbuf[usii + 1]);
-	}
-	if (fread(&usjj, 1, 2, infile) < 2) {
+	g_bgen_block_offsets[0] = 0;
+	g_bgen_block_lens[0] = pending_block_len;
+	batch_marker_uidxs[0] = marker_uidx - 1;
+	batch_identical_alleles[0] = pending_identical_alleles;
+	raw_used = CACHEALIGN(pending_block_len);
+	pending_block_len = 0;
+	batch_ct = 1;
+      }
+      for (; (marker_uidx < raw_marker_ct) && (batch_ct < batch_max); marker_uidx++) {
+	if (fread(&uii, 1, 4, infile) < 4) {
 	  goto oxford_to_bed_ret_READ_FAIL;
 	}
-	if (!usjj) {
-	  logprint("Error: Length-0 rsID in .bgen file.\n");
+	if (uii != sample_ct) {
+	  logprint("Error: Unexpected number of samples specified in SNP block header.\n");
 	  goto oxford_to_bed_ret_INVALID_FORMAT;
 	}
-	if (fread(bufptr, 1, usjj, infile) < usjj) {
-	  goto oxford_to_bed_ret_READ_FAIL;
-	}
-        bufptr2 = &(bufptr[usjj]);
-	if (fread(&uskk, 1, 2, infile) < 2) {
-	  goto oxford_to_bed_ret_READ_FAIL;
-	}
-	if (!snpid_chr) {
-	  if (!uskk) {
-	    logprint("Error: Length-0 chromosome ID in .bgen file.\n");
-	    goto oxford_to_bed_ret_INVALID_FORMAT;
-	  }
-	  usii = uskk;
-	  if (fread(bufptr2, 1, usii, infile) < usii) {
+	if (bgen_multichar_alleles) {
+	  if (fread(&usii, 1, 2, infile) < 2) {
 	    goto oxford_to_bed_ret_READ_FAIL;
 	  }
-	  if ((usii == 2) && (!memcmp(bufptr2, "NA", 2))) {
-	    // convert 'NA' to 0
-	    usii = 1;
-	    memcpy(bufptr2, "0", 2);
+	  if (!snpid_chr) {
+	    if (fseeko(infile, usii, SEEK_CUR)) {
+	      goto oxford_to_bed_ret_READ_FAIL;
+	    }
+	    bufptr = loadbuf;
 	  } else {
-	    bufptr2[usii] = '\0';
+	    if (!usii) {
+	      logprint("Error: Length-0 SNP ID in .bgen file.\n");
+	      goto oxford_to_bed_ret_INVALID_FORMAT;
+	    }
+	    if (fread(loadbuf, 1, usii, infile) < usii) {
+	      goto oxford_to_bed_ret_READ_FAIL;
+	    }
+	    loadbuf[usii] = '\0';
+	    bufptr = &(loadbuf[usii + 1]);
 	  }
-	} else {
-	  if (fseeko(infile, uskk, SEEK_CUR)) {
+	  if (fread(&usjj, 1, 2, infile) < 2) {
 	    goto oxford_to_bed_ret_READ_FAIL;
 	  }
-	  bufptr2 = loadbuf;
-	}
-	if (fread(uint_arr, 1, 8, infile) < 8) {
-	  goto oxford_to_bed_ret_READ_FAIL;
-	}
-	if (!uint_arr[1]) {
-	  logprint("Error: Length-0 allele ID in .bgen file.\n");
-	  goto oxford_to_bed_ret_INVALID_FORMAT;
-	}
-        ii = get_chrom_code(chrom_info_ptr, bufptr2);
-	if (ii < 0) {
-	  if (chrom_error(".bgen file", chrom_info_ptr, bufptr2, 0, ii, allow_extra_chroms)) {
-            goto oxford_to_bed_ret_INVALID_FORMAT;
-	  }
-	  retval = resolve_or_add_chrom_name(chrom_info_ptr, bufptr2, &ii, 0, ".bgen file");
-          if (retval) {
-	    goto oxford_to_bed_ret_1;
+	  if (!usjj) {
+	    logprint("Error: Length-0 rsID in .bgen file.\n");
+	    goto oxford_to_bed_ret_INVALID_FORMAT;
 	  }
-	}
-        if (!is_set(chrom_info_ptr->chrom_mask, ii)) {
-	  // skip rest of current SNP
-	  if (fseeko(infile, uint_arr[1], SEEK_CUR)) {
+	  if (fread(bufptr, 1, usjj, infile) < usjj) {
 	    goto oxford_to_bed_ret_READ_FAIL;
 	  }
-	  if (fread(&uii, 1, 4, infile) < 4) {
+	  bufptr2 = &(bufptr[usjj]);
+	  if (fread(&uskk, 1, 2, infile) < 2) {
 	    goto oxford_to_bed_ret_READ_FAIL;
 	  }
-	  if (bgen_compressed) {
-	    if (fseeko(infile, uii, SEEK_CUR)) {
-	      goto oxford_to_bed_ret_READ_FAIL;
+	  if (!snpid_chr) {
+	    if (!uskk) {
+	      logprint("Error: Length-0 chromosome ID in .bgen file.\n");
+	      goto oxford_to_bed_ret_INVALID_FORMAT;
 	    }
-	    if (fread(&uii, 1, 4, infile) < 4) {
+	    usii = uskk;
+	    if (fread(bufptr2, 1, usii, infile) < usii) {
 	      goto oxford_to_bed_ret_READ_FAIL;
 	    }
-	    if (fseeko(infile, uii, SEEK_CUR)) {
-	      goto oxford_to_bed_ret_READ_FAIL;
+	    if ((usii == 2) && (!memcmp(bufptr2, "NA", 2))) {
+	      // convert 'NA' to 0
+	      usii = 1;
+	      memcpy(bufptr2, "0", 2);
+	    } else {
+	      bufptr2[usii] = '\0';
 	    }
 	  } else {
-	    if (fseeko(infile, uii + ((uint64_t)sample_ct) * 6, SEEK_CUR)) {
+	    if (fseeko(infile, uskk, SEEK_CUR)) {
 	      goto oxford_to_bed_ret_READ_FAIL;
 	    }
+	    bufptr2 = loadbuf;
 	  }
-	  continue;
-	}
-	fputs(bufptr2, outfile_bim);
-	if (putc_checked(' ', outfile_bim)) {
-	  goto oxford_to_bed_ret_WRITE_FAIL;
-	}
-        fwrite(bufptr, 1, usjj, outfile_bim);
-	bufptr = uint32_writex(&(tbuf[3]), uint_arr[0], ' ');
-	fwrite(tbuf, 1, bufptr - tbuf, outfile_bim);
-        if (uint_arr[1] >= loadbuf_size / 2) {
-	  if (loadbuf_size < MAXLINEBUFLEN) {
-	    goto oxford_to_bed_ret_NOMEM;
-	  }
-	  logprint("Error: Excessively long allele in .bgen file.\n");
-	  goto oxford_to_bed_ret_INVALID_FORMAT;
-	}
-        if (fread(loadbuf, 1, uint_arr[1], infile) < uint_arr[1]) {
-	  goto oxford_to_bed_ret_READ_FAIL;
-	}
-	loadbuf[uint_arr[1]] = ' ';
-	if (fread(&uii, 1, 4, infile) < 4) {
-	  goto oxford_to_bed_ret_READ_FAIL;
-	}
-        if (uii >= loadbuf_size / 2) {
-	  if (loadbuf_size < MAXLINEBUFLEN) {
-	    goto oxford_to_bed_ret_NOMEM;
-	  }
-	  logprint("Error: Excessively long allele in .bgen file.\n");
-	  goto oxford_to_bed_ret_INVALID_FORMAT;
-	}
-	bufptr = &(loadbuf[uint_arr[1] + 1]);
-        if (fread(bufptr, 1, uii, infile) < uii) {
-	  goto oxford_to_bed_ret_READ_FAIL;
-	}
-	bufptr[uii] = '\n';
-	identical_alleles = (uii == uint_arr[1]) && (!memcmp(loadbuf, bufptr, uii));
-	if (!identical_alleles) {
-	  if (fwrite_checked(loadbuf, uint_arr[1] + uii + 2, outfile_bim)) {
-	    goto oxford_to_bed_ret_WRITE_FAIL;
-	  }
-	} else {
-	  fputs("0 ", outfile_bim);
-	  if (fwrite_checked(bufptr, uii + 1, outfile_bim)) {
-	    goto oxford_to_bed_ret_WRITE_FAIL;
+	  if (fread(uint_arr, 1, 8, infile) < 8) {
+	    goto oxford_to_bed_ret_READ_FAIL;
 	  }
-	}
-      } else {
-	uii = 0;
-	if (fread(&uii, 1, 1, infile) < 1) {
-	  goto oxford_to_bed_ret_READ_FAIL;
-	}
-        if (fread(loadbuf, 1, 2 * uii + 9, infile) < (2 * uii + 9)) {
-	  goto oxford_to_bed_ret_READ_FAIL;
-	}
-	// save marker ID length since we might clobber it
-	ukk = (unsigned char)(loadbuf[uii + 1]);
-        if (!snpid_chr) {
-	  ii = ((unsigned char)(loadbuf[2 * uii + 2]));
-	  if (ii > 24) {
-	    if (ii == 255) {
-	      ii = 0;
-	    } else if (ii > 252) {
-	      ii = ii - 228;
-	    } else {
-	      logprint("Error: Invalid chromosome code in BGEN v1.0 file.\n");
-	      goto oxford_to_bed_ret_INVALID_FORMAT;
-	    }
+	  if (!uint_arr[1]) {
+	    logprint("Error: Length-0 allele ID in .bgen file.\n");
+	    goto oxford_to_bed_ret_INVALID_FORMAT;
 	  }
-	  uint32_writex(loadbuf, (uint32_t)ii, '\0');
-	  bufptr = loadbuf;
-	} else {
-	  ujj = (unsigned char)loadbuf[0];
-	  bufptr = &(loadbuf[1]);
-	  if ((ujj == 2) && (!memcmp(bufptr, "NA", 2))) {
-	    *bufptr = '0';
-	    ujj = 1;
-	  }
-	  bufptr[ujj] = '\0';
-	  ii = get_chrom_code(chrom_info_ptr, bufptr);
+	  ii = get_chrom_code(chrom_info_ptr, bufptr2);
 	  if (ii < 0) {
-	    if (chrom_error(".bgen file", chrom_info_ptr, bufptr, 0, ii, allow_extra_chroms)) {
+	    if (chrom_error(".bgen file", chrom_info_ptr, bufptr2, 0, ii, allow_extra_chroms)) {
 	      goto oxford_to_bed_ret_INVALID_FORMAT;
 	    }
-	    retval = resolve_or_add_chrom_name(chrom_info_ptr, bufptr, &ii, 0, ".bgen file");
+	    retval = resolve_or_add_chrom_name(chrom_info_ptr, bufptr2, &ii, 0, ".bgen file");
 	    if (retval) {
 	      goto oxford_to_bed_ret_1;
 	    }
 	  }
-	}
-	if (!is_set(chrom_info_ptr->chrom_mask, ii)) {
-	  if (bgen_compressed) {
-	    if (fread(&uii, 1, 4, infile) < 4) {
+	  if (!is_set(chrom_info_ptr->chrom_mask, ii)) {
+	    // skip rest of current SNP
+	    if (fseeko(infile, uint_arr[1], SEEK_CUR)) {
 	      goto oxford_to_bed_ret_READ_FAIL;
 	    }
-	    if (fseeko(infile, uii, SEEK_CUR)) {
+	    if (fread(&uii, 1, 4, infile) < 4) {
 	      goto oxford_to_bed_ret_READ_FAIL;
 	    }
+	    if (bgen_compressed) {
+	      if (fseeko(infile, uii, SEEK_CUR)) {
+		goto oxford_to_bed_ret_READ_FAIL;
+	      }
+	      if (fread(&uii, 1, 4, infile) < 4) {
+		goto oxford_to_bed_ret_READ_FAIL;
+	      }
+	      if (fseeko(infile, uii, SEEK_CUR)) {
+		goto oxford_to_bed_ret_READ_FAIL;
+	      }
+	    } else {
+	      if (fseeko(infile, uii + ((uint64_t)sample_ct) * 6, SEEK_CUR)) {
+		goto oxford_to_bed_ret_READ_FAIL;
+	      }
+	    }
+	    continue;
+	  }
+	  fputs(bufptr2, outfile_bim);
+	  if (putc_checked(' ', outfile_bim)) {
+	    goto oxford_to_bed_ret_WRITE_FAIL;
+	  }
+	  fwrite(bufptr, 1, usjj, outfile_bim);
+	  bufptr = uint32_writex(&(tbuf[3]), uint_arr[0], ' ');
+	  fwrite(tbuf, 1, bufptr - tbuf, outfile_bim);
+	  if (uint_arr[1] >= loadbuf_size / 2) {
+	    if (loadbuf_size < MAXLINEBUFLEN) {
+	      goto oxford_to_bed_ret_NOMEM;
+	    }
+	    logprint("Error: Excessively long allele in .bgen file.\n");
+	    goto oxford_to_bed_ret_INVALID_FORMAT;
+	  }
+	  if (fread(loadbuf, 1, uint_arr[1], infile) < uint_arr[1]) {
+	    goto oxford_to_bed_ret_READ_FAIL;
+	  }
+	  loadbuf[uint_arr[1]] = ' ';
+	  if (fread(&uii, 1, 4, infile) < 4) {
+	    goto oxford_to_bed_ret_READ_FAIL;
+	  }
+	  if (uii >= loadbuf_size / 2) {
+	    if (loadbuf_size < MAXLINEBUFLEN) {
+	      goto oxford_to_bed_ret_NOMEM;
+	    }
+	    logprint("Error: Excessively long allele in .bgen file.\n");
+	    goto oxford_to_bed_ret_INVALID_FORMAT;
+	  }
+	  bufptr = &(loadbuf[uint_arr[1] + 1]);
+	  if (fread(bufptr, 1, uii, infile) < uii) {
+	    goto oxford_to_bed_ret_READ_FAIL;
+	  }
+	  bufptr[uii] = '\n';
+	  identical_alleles = (uii == uint_arr[1]) && (!memcmp(loadbuf, bufptr, uii));
+	  if (!identical_alleles) {
+	    if (fwrite_checked(loadbuf, uint_arr[1] + uii + 2, outfile_bim)) {
+	      goto oxford_to_bed_ret_WRITE_FAIL;
+	    }
 	  } else {
-	    if (fseeko(infile, ((uint64_t)sample_ct) * 6, SEEK_CUR)) {
-	      goto oxford_to_bed_ret_READ_FAIL;
+	    fputs("0 ", outfile_bim);
+	    if (fwrite_checked(bufptr, uii + 1, outfile_bim)) {
+	      goto oxford_to_bed_ret_WRITE_FAIL;
 	    }
 	  }
-	  continue;
-	}
-	fputs(bufptr, outfile_bim);
-	if (putc_checked(' ', outfile_bim)) {
-	  goto oxford_to_bed_ret_WRITE_FAIL;
+	} else {
+	  uii = 0;
+	  if (fread(&uii, 1, 1, infile) < 1) {
+	    goto oxford_to_bed_ret_READ_FAIL;
+	  }
+	  if (fread(loadbuf, 1, 2 * uii + 9, infile) < (2 * uii + 9)) {
+	    goto oxford_to_bed_ret_READ_FAIL;
+	  }
+	  // save marker ID length since we might clobber it
+	  ukk = (unsigned char)(loadbuf[uii + 1]);
+	  if (!snpid_chr) {
+	    ii = ((unsigned char)(loadbuf[2 * uii + 2]));
+	    if (ii > 24) {
+	      if (ii == 255) {
+		ii = 0;
+	      } else if (ii > 252) {
+		ii = ii - 228;
+	      } else {
+		logprint("Error: Invalid chromosome code in BGEN v1.0 file.\n");
+		goto oxford_to_bed_ret_INVALID_FORMAT;
+	      }
+	    }
+	    uint32_writex(loadbuf, (uint32_t)ii, '\0');
+	    bufptr = loadbuf;
+	  } else {
+	    ujj = (unsigned char)loadbuf[0];
+	    bufptr = &(loadbuf[1]);
+	    if ((ujj == 2) && (!memcmp(bufptr, "NA", 2))) {
+	      *bufptr = '0';
+	      ujj = 1;
+	    }
+	    bufptr[ujj] = '\0';
+	    ii = get_chrom_code(chrom_info_ptr, bufptr);
+	    if (ii < 0) {
+	      if (chrom_error(".bgen file", chrom_info_ptr, bufptr, 0, ii, allow_extra_chroms)) {
+		goto oxford_to_bed_ret_INVALID_FORMAT;
+	      }
+	      retval = resolve_or_add_chrom_name(chrom_info_ptr, bufptr, &ii, 0, ".bgen file");
+	      if (retval) {
+		goto oxford_to_bed_ret_1;
+	      }
+	    }
+	  }
+	  if (!is_set(chrom_info_ptr->chrom_mask, ii)) {
+	    if (bgen_compressed) {
+	      if (fread(&uii, 1, 4, infile) < 4) {
+		goto oxford_to_bed_ret_READ_FAIL;
+	      }
+	      if (fseeko(infile, uii, SEEK_CUR)) {
+		goto oxford_to_bed_ret_READ_FAIL;
+	      }
+	    } else {
+	      if (fseeko(infile, ((uint64_t)sample_ct) * 6, SEEK_CUR)) {
+		goto oxford_to_bed_ret_READ_FAIL;
+	      }
+	    }
+	    continue;
+	  }
+	  fputs(bufptr, outfile_bim);
+	  if (putc_checked(' ', outfile_bim)) {
+	    goto oxford_to_bed_ret_WRITE_FAIL;
+	  }
+	  fwrite(&(loadbuf[uii + 2]), 1, ukk, outfile_bim);
+	  memcpy(&ujj, &(loadbuf[2 * uii + 3]), 4);
+	  bufptr = uint32_writex(&(tbuf[3]), ujj, ' ');
+	  identical_alleles = (loadbuf[2 * uii + 7] == loadbuf[2 * uii + 8]);
+	  if (!identical_alleles) {
+	    *bufptr++ = loadbuf[2 * uii + 7];
+	  } else {
+	    *bufptr++ = '0';
+	  }
+	  *bufptr++ = ' ';
+	  *bufptr++ = loadbuf[2 * uii + 8];
+	  *bufptr++ = '\n';
+	  if (fwrite_checked(tbuf, bufptr - tbuf, outfile_bim)) {
+	    goto oxford_to_bed_ret_WRITE_FAIL;
+	  }
 	}
-	fwrite(&(loadbuf[uii + 2]), 1, ukk, outfile_bim);
-	memcpy(&ujj, &(loadbuf[2 * uii + 3]), 4);
-	bufptr = uint32_writex(&(tbuf[3]), ujj, ' ');
-	identical_alleles = (loadbuf[2 * uii + 7] == loadbuf[2 * uii + 8]);
-	if (!identical_alleles) {
-	  *bufptr++ = loadbuf[2 * uii + 7];
+	if (bgen_compressed) {
+	  if (fread(&uii, 1, 4, infile) < 4) {
+	    goto oxford_to_bed_ret_READ_FAIL;
+	  }
+	  if (uii > raw_size) {
+	    if (raw_size < MAXLINEBUFLEN / 2) {
+	      goto oxford_to_bed_ret_NOMEM;
+	    }
+	    logprint("Error: Excessively long compressed SNP block in .bgen file.\n");
+	    goto oxford_to_bed_ret_INVALID_FORMAT;
+	  }
 	} else {
-	  *bufptr++ = '0';
+	  uii = 6 * sample_ct;
 	}
-	*bufptr++ = ' ';
-	*bufptr++ = loadbuf[2 * uii + 8];
-	*bufptr++ = '\n';
-	if (fwrite_checked(tbuf, bufptr - tbuf, outfile_bim)) {
-	  goto oxford_to_bed_ret_WRITE_FAIL;
+	if (uii > raw_size - raw_used) {
+	  // start of next batch
+	  pending_block_len = uii;
+	  pending_identical_alleles = identical_alleles;
+	  marker_uidx++;
+	  break;
 	}
-      }
-      if (bgen_compressed) {
-	if (fread(&uii, 1, 4, infile) < 4) {
+	if (fread(&(g_bgen_raw[raw_used]), 1, uii, infile) < uii) {
 	  goto oxford_to_bed_ret_READ_FAIL;
 	}
-	if (uii > loadbuf_size) {
-	  if (loadbuf_size < MAXLINEBUFLEN / 2) {
-	    goto oxford_to_bed_ret_NOMEM;
-	  }
-	  logprint("Error: Excessively long compressed SNP block in .bgen file.\n");
-	  goto oxford_to_bed_ret_INVALID_FORMAT;
-	}
-	if (fread(loadbuf, 1, uii, infile) < uii) {
-	  goto oxford_to_bed_ret_READ_FAIL;
+	g_bgen_block_offsets[batch_ct] = raw_used;
+	g_bgen_block_lens[batch_ct] = uii;
+	batch_marker_uidxs[batch_ct] = marker_uidx;
+	batch_identical_alleles[batch_ct] = identical_alleles;
+	raw_used += CACHEALIGN(uii);
+	batch_ct++;
+      }
+      if (!batch_ct) {
+	break;
+      }
+      if (bgen_compressed || (!is_randomized)) {
+	memset(g_bgen_block_bad, 0, batch_ct);
+	ujj = (batch_ct < thread_ct)? batch_ct : thread_ct;
+	ws_ranges_init(ujj, 0, batch_ct);
+	if (spawn_threads(threads, &bgen_block_thread, ujj)) {
+	  goto oxford_to_bed_ret_THREAD_CREATE_FAIL;
 	}
-        zlib_ulongf = 6 * sample_ct;
-	if (uncompress((Bytef*)bgen_probs, &zlib_ulongf, (Bytef*)loadbuf, uii) != Z_OK) {
+	bgen_block_thread((void*)0);
+	join_threads(threads, ujj);
+      }
+      for (batch_idx = 0; batch_idx < batch_ct; batch_idx++) {
+	if (bgen_compressed && g_bgen_block_bad[batch_idx]) {
 	  logprint("Error: Invalid compressed SNP block in .bgen file.\n");
 	  goto oxford_to_bed_ret_INVALID_FORMAT;
 	}
-      } else {
-	if (fread(bgen_probs, 1, 6 * sample_ct, infile) < 6 * sample_ct) {
-	  goto oxford_to_bed_ret_READ_FAIL;
-	}
-      }
-      cur_word = 0;
-      shiftval = 0;
-      ulptr = writebuf;
-      usptr = bgen_probs;
-      if (!is_randomized) {
-	for (sample_idx = 0; sample_idx < sample_ct; sample_idx++, usptr = &(usptr[3])) {
-	  if (usptr[2] >= bgen_hardthresh) {
-	    ulii = 3;
-	  } else if (usptr[1] >= bgen_hardthresh) {
-	    ulii = 2;
-	  } else if (usptr[0] >= bgen_hardthresh) {
-	    ulii = 0;
+	ulptr = &(writebuf[batch_idx * sample_ctl2]);
+	if (is_randomized) {
+	  if (bgen_compressed) {
+	    usptr = &(bgen_probs[batch_idx * g_bgen_probs_stride]);
 	  } else {
-	    ulii = 1;
-	  }
-	  cur_word |= ulii << shiftval;
-	  shiftval += 2;
-	  if (shiftval == BITCT) {
-	    *ulptr++ = cur_word;
-	    cur_word = 0;
-	    shiftval = 0;
+	    usptr = (uint16_t*)(&(g_bgen_raw[g_bgen_block_offsets[batch_idx]]));
 	  }
-	}
-      } else {
-	uii = 0;
-	for (sample_idx = 0; sample_idx < sample_ct; sample_idx++, usptr = &(usptr[3])) {
-	  // fast handling of common cases
-	  ukk = usptr[2];
-	  if (ukk >= 32768) {
-	    ulii = 3;
-	  } else if (usptr[1] >= 32768) {
-	    ulii = 2;
-	  } else if (usptr[0] >= 32768) {
-	    ulii = 0;
-	  } else {
-	    while (1) {
-	      uii >>= 16;
-	      if (!uii) {
-		uii = sfmt_genrand_uint32(&sfmt) | 0x80000000U;
-	      }
-	      ujj = uii & 32767;
-	      if (ujj < ukk) {
-		ulii = 3;
-		break;
-	      } else {
-		ukk += usptr[1];
+	  cur_word = 0;
+	  shiftval = 0;
+	  uii = 0;
+	  for (sample_idx = 0; sample_idx < sample_ct; sample_idx++, usptr = &(usptr[3])) {
+	    // fast handling of common cases
+	    ukk = usptr[2];
+	    if (ukk >= 32768) {
+	      ulii = 3;
+	    } else if (usptr[1] >= 32768) {
+	      ulii = 2;
+	    } else if (usptr[0] >= 32768) {
+	      ulii = 0;
+	    } else {
+	      while (1) {
+		uii >>= 16;
+		if (!uii) {
+		  uii = sfmt_genrand_uint32(&sfmt) | 0x80000000U;
+		}
+		ujj = uii & 32767;
 		if (ujj < ukk) {
-		  ulii = 2;
+		  ulii = 3;
 		  break;
 		} else {
-		  ukk += usptr[0];
+		  ukk += usptr[1];
 		  if (ujj < ukk) {
-		    ulii = 0;
-		    break;
-		  } else if (ukk < 32766) {
-		    ulii = 1;
+		    ulii = 2;
 		    break;
 		  } else {
-		    ukk = usptr[2];
+		    ukk += usptr[0];
+		    if (ujj < ukk) {
+		      ulii = 0;
+		      break;
+		    } else if (ukk < 32766) {
+		      ulii = 1;
+		      break;
+		    } else {
+		      ukk = usptr[2];
+		    }
 		  }
 		}
 	      }
 	    }
+	    cur_word |= ulii << shiftval;
+	    shiftval += 2;
+	    if (shiftval == BITCT) {
+	      *ulptr++ = cur_word;
+	      cur_word = 0;
+	      shiftval = 0;
+	    }
 	  }
-	  cur_word |= ulii << shiftval;
-	  shiftval += 2;
-	  if (shiftval == BITCT) {
-	    *ulptr++ = cur_word;
-	    cur_word = 0;
-	    shiftval = 0;
+	  if (shiftval) {
+	    *ulptr = cur_word;
 	  }
+	  ulptr = &(writebuf[batch_idx * sample_ctl2]);
 	}
-      }
-      if (shiftval) {
-	*ulptr++ = cur_word;
-      }
-      if (identical_alleles) {
-	for (ulptr = writebuf; ulptr < (&(writebuf[sample_ctl2])); ulptr++) {
-	  ulii = *ulptr;
-	  *ulptr = ((~ulii) << 1) | ulii | FIVEMASK;
+	if (batch_identical_alleles[batch_idx]) {
+	  for (uljj = 0; uljj < sample_ctl2; uljj++) {
+	    ulii = ulptr[uljj];
+	    ulptr[uljj] = ((~ulii) << 1) | ulii | FIVEMASK;
+	  }
+	  if (sample_ct % 4) {
+	    ulptr[sample_ctl2 - 1] &= (ONELU << (2 * (sample_ct % BITCT2))) - ONELU;
+	  }
 	}
-	if (sample_ct % 4) {
-	  writebuf[sample_ctl2 - 1] &= (ONELU << (2 * (sample_ct % BITCT2))) - ONELU;
+	if (fwrite_checked(ulptr, sample_ct4, outfile)) {
+	  goto oxford_to_bed_ret_WRITE_FAIL;
 	}
-      }
-      if (fwrite_checked(writebuf, sample_ct4, outfile)) {
-	goto oxford_to_bed_ret_WRITE_FAIL;
-      }
-      marker_ct++;
-      if (!(marker_ct % 1000)) {
-	if (marker_ct == marker_uidx + 1) {
-	  printf("\r--bgen: %uk variants converted.", marker_ct / 1000);
-	} else {
-	  printf("\r--bgen: %uk variants converted (out of %u).", marker_ct / 1000, marker_uidx + 1);
+	marker_ct++;
+	if (!(marker_ct % 1000)) {
+	  if (marker_ct == batch_marker_uidxs[batch_idx] + 1) {
+	    printf("\r--bgen: %uk variants converted.", marker_ct / 1000);
+	  } else {
+	    printf("\r--bgen: %uk variants converted (out of %u).", marker_ct / 1000, batch_marker_uidxs[batch_idx] + 1);
+	  }
+	  fflush(stdout);
 	}
-	fflush(stdout);
       }
     }
     if (fclose_null(&infile)) {
@@ -5039,6 +5733,9 @@ int32_t oxford_to_bed(char* genname, char* samplename, char* outname, char* outn
   oxford_to_bed_ret_WRITE_FAIL:
     retval = RET_WRITE_FAIL;
     break;
+  oxford_to_bed_ret_THREAD_CREATE_FAIL:
+    retval = RET_THREAD_CREATE_FAIL;
+    break;
   oxford_to_bed_ret_INVALID_DOSAGE:
     LOGPRINTF("Error: Line %" PRIuPTR " of .gen file has an invalid dosage value.\n", line_idx);
     retval = RET_INVALID_FORMAT;
@@ -5239,6 +5936,423 @@ static inline char* write_token(char* read_ptr, FILE* outfile) {
   return skip_initial_spaces(&(read_ptr[slen + 1]));
 }
 
+// --file/--ped .bed write: the main thread reads batches of .ped lines, and
+// worker threads each convert aligned groups of four samples (so no two
+// threads ever touch the same output byte).  With a sorted .map, genotype
+// codes are first collected in a small per-thread tile (PED_TILE_MARKERS
+// variants x PED_TILE_QUADS bytes) and then copied out row by row, instead
+// of or-ing single bytes sample_ct4 apart.
+#define PED_TILE_MARKERS 1024
+#define PED_TILE_QUADS 16
+#define PED_BATCH_MAX 65536
+#define PED_BATCH_TEXT_MAX 67108864
+
+static uintptr_t g_ped_unfiltered_marker_ct;
+static uintptr_t* g_ped_marker_exclude;
+static uint32_t* g_ped_map_reverse;
+static char* g_ped_alleles_f;
+static char** g_ped_allele_ptrs;
+static unsigned char* g_ped_writebuf;
+static unsigned char* g_ped_tiles;
+static uintptr_t g_ped_tile_stride;
+static char** g_ped_line_ptrs;
+static int64_t* g_ped_line_offsets;
+static int64_t* g_ped_line_starts;
+static uintptr_t g_ped_sample_ct4;
+static uintptr_t g_ped_batch_sample_start;
+static uintptr_t g_ped_batch_line_ct;
+static uintptr_t g_ped_marker_uidx_start;
+static uint32_t g_ped_marker_start;
+static uint32_t g_ped_marker_end;
+static uint32_t g_ped_col_skip;
+static uint32_t g_ped_full_lines;
+static char g_ped_missing_geno;
+
+static inline uint32_t ped_geno_code_1char(char** bufptr_ptr, const char* alleles_f) {
+  // Parses the single-character genotype at *bufptr_ptr, advances past it,
+  // and returns its .bed code with respect to alleles_f[0..1].
+  char* bufptr = *bufptr_ptr;
+  char cc = *bufptr++;
+  char cc2;
+  bufptr = skip_initial_spaces(bufptr);
+  cc2 = *bufptr++;
+  *bufptr_ptr = skip_initial_spaces(bufptr);
+  if (cc == alleles_f[1]) {
+    if (cc2 == cc) {
+      return 3;
+    } else if (cc2 == alleles_f[0]) {
+      return 2;
+    }
+  } else if (cc == alleles_f[0]) {
+    if (cc2 == cc) {
+      return 0;
+    } else if (cc2 == alleles_f[1]) {
+      return 2;
+    }
+  }
+  return 1;
+}
+
+uint32_t ped_geno_code_multichar(char** bufptr_ptr, char** allele_ptrs, char missing_geno) {
+  char* bufptr = *bufptr_ptr;
+  char* aptr1 = bufptr;
+  char* aptr2;
+  uint32_t alen1;
+  uint32_t alen2;
+  bufptr = token_endnn(bufptr);
+  alen1 = (uintptr_t)(bufptr - aptr1);
+  bufptr = skip_initial_spaces(bufptr);
+  aptr1[alen1] = '\0';
+  aptr2 = bufptr;
+  bufptr = token_endnn(bufptr);
+  alen2 = (uintptr_t)(bufptr - aptr2);
+  *bufptr_ptr = skip_initial_spaces(bufptr);
+  aptr2[alen2] = '\0';
+  if ((*aptr1 == missing_geno) && (alen1 == 1)) {
+    return 1;
+  }
+  if (!strcmp(aptr1, allele_ptrs[1])) {
+    if ((alen1 == alen2) && (!memcmp(aptr1, aptr2, alen1))) {
+      return 3;
+    } else if (!strcmp(aptr2, allele_ptrs[0])) {
+      return 2;
+    }
+  } else if (!strcmp(aptr1, allele_ptrs[0])) {
+    if ((alen1 == alen2) && (!memcmp(aptr1, aptr2, alen1))) {
+      return 0;
+    } else if (!strcmp(aptr2, allele_ptrs[1])) {
+      return 2;
+    }
+  }
+  return 1;
+}
+
+static inline char* ped_skip_geno(char* bufptr, uint32_t is_multichar) {
+  if (!is_multichar) {
+    bufptr = skip_initial_spaces(&(bufptr[1]));
+    return skip_initial_spaces(&(bufptr[1]));
+  }
+  bufptr = skip_initial_spaces(token_endnn(bufptr));
+  return skip_initial_spaces(token_endnn(bufptr));
+}
+
+static inline uint32_t ped_geno_code(char** bufptr_ptr, const char* alleles_f, char** allele_ptrs, char missing_geno, uintptr_t marker_idx) {
+  if (!allele_ptrs) {
+    return ped_geno_code_1char(bufptr_ptr, &(alleles_f[2 * marker_idx]));
+  }
+  return ped_geno_code_multichar(bufptr_ptr, &(allele_ptrs[2 * marker_idx]), missing_geno);
+}
+
+THREAD_RET_TYPE ped_to_bed_thread(void* arg) {
+  uintptr_t tidx = (uintptr_t)arg;
+  uintptr_t unfiltered_marker_ct = g_ped_unfiltered_marker_ct;
+  uintptr_t* marker_exclude = g_ped_marker_exclude;
+  uint32_t* map_reverse = g_ped_map_reverse;
+  char* alleles_f = g_ped_alleles_f;
+  char** allele_ptrs = g_ped_allele_ptrs;
+  char missing_geno = g_ped_missing_geno;
+  uint32_t is_multichar = (allele_ptrs != NULL);
+  unsigned char* tile = &(g_ped_tiles[tidx * g_ped_tile_stride]);
+  char** cursors = (char**)(&(tile[PED_TILE_MARKERS * PED_TILE_QUADS]));
+  uintptr_t sample_ct4 = g_ped_sample_ct4;
+  uintptr_t line_ct = g_ped_batch_line_ct;
+  uint32_t marker_start = g_ped_marker_start;
+  uint32_t marker_end = g_ped_marker_end;
+  unsigned char* writebuf = g_ped_writebuf;
+  unsigned char* wbufptr;
+  unsigned char* tptr;
+  char* bufptr;
+  uintptr_t line_idx;
+  uintptr_t line_end;
+  uintptr_t line_ct_cur;
+  uintptr_t quad_ct_cur;
+  uintptr_t marker_uidx;
+  uintptr_t marker_uidx_block;
+  uintptr_t marker_idx;
+  uintptr_t block_start;
+  uintptr_t block_end;
+  uintptr_t ulii;
+  uint32_t quad_idx;
+  uint32_t quad_end;
+  uint32_t ii_shift;
+  uint32_t is_excluded;
+  uint32_t ukk;
+  while (ws_claim(tidx, PED_TILE_QUADS, &quad_idx, &quad_end)) {
+    line_idx = quad_idx * 4;
+    line_end = quad_end * 4;
+    if (line_end > line_ct) {
+      line_end = line_ct;
+    }
+    line_ct_cur = line_end - line_idx;
+    quad_ct_cur = quad_end - quad_idx;
+    for (ulii = 0; ulii < line_ct_cur; ulii++) {
+      bufptr = g_ped_line_ptrs[line_idx + ulii];
+      if (g_ped_full_lines) {
+	bufptr = next_token_mult(bufptr, g_ped_col_skip);
+      }
+      cursors[ulii] = bufptr;
+    }
+    if (map_reverse) {
+      // multipass optimizations are possible, but we won't bother,
+      // especially since the .map should rarely be unsorted in the first
+      // place...
+      wbufptr = &(writebuf[g_ped_batch_sample_start / 4 + quad_idx]);
+      for (ulii = 0; ulii < line_ct_cur; ulii++) {
+	bufptr = cursors[ulii];
+	ii_shift = (ulii % 4) * 2;
+	marker_idx = 0;
+	for (marker_uidx = 0; marker_uidx < unfiltered_marker_ct; marker_uidx++) {
+	  is_excluded = IS_SET(marker_exclude, marker_uidx);
+	  ukk = is_excluded? 0 : map_reverse[marker_idx++];
+	  if ((!is_excluded) && (ukk >= marker_start) && (ukk < marker_end)) {
+	    wbufptr[(ukk - marker_start) * sample_ct4 + ulii / 4] |= ped_geno_code(&bufptr, alleles_f, allele_ptrs, missing_geno, ukk) << ii_shift;
+	  } else {
+	    bufptr = ped_skip_geno(bufptr, is_multichar);
+	  }
+	}
+      }
+      continue;
+    }
+    marker_uidx_block = g_ped_marker_uidx_start;
+    for (block_start = marker_start; block_start < marker_end; block_start = block_end) {
+      block_end = block_start + PED_TILE_MARKERS;
+      if (block_end > marker_end) {
+	block_end = marker_end;
+      }
+      memset(tile, 0, (block_end - block_start) * quad_ct_cur);
+      marker_uidx = marker_uidx_block;
+      for (ulii = 0; ulii < line_ct_cur; ulii++) {
+	bufptr = cursors[ulii];
+	ii_shift = (ulii % 4) * 2;
+	tptr = &(tile[ulii / 4]);
+	for (marker_uidx = marker_uidx_block, marker_idx = block_start; marker_idx < block_end; marker_uidx++) {
+	  if (IS_SET(marker_exclude, marker_uidx)) {
+	    bufptr = ped_skip_geno(bufptr, is_multichar);
+	    continue;
+	  }
+	  *tptr |= ped_geno_code(&bufptr, alleles_f, allele_ptrs, missing_geno, marker_idx) << ii_shift;
+	  tptr = &(tptr[quad_ct_cur]);
+	  marker_idx++;
+	}
+	cursors[ulii] = bufptr;
+      }
+      marker_uidx_block = marker_uidx;
+      wbufptr = &(writebuf[(block_start - marker_start) * sample_ct4 + g_ped_batch_sample_start / 4 + quad_idx]);
+      tptr = tile;
+      for (marker_idx = block_start; marker_idx < block_end; marker_idx++) {
+	memcpy(wbufptr, tptr, quad_ct_cur);
+	wbufptr = &(wbufptr[sample_ct4]);
+	tptr = &(tptr[quad_ct_cur]);
+      }
+    }
+    if (g_ped_line_starts) {
+      for (ulii = 0; ulii < line_ct_cur; ulii++) {
+	g_ped_line_starts[g_ped_batch_sample_start + line_idx + ulii] = g_ped_line_offsets[line_idx + ulii] + (uintptr_t)(cursors[ulii] - g_ped_line_ptrs[line_idx + ulii]);
+      }
+    }
+  }
+  THREAD_RETURN;
+}
+
+int32_t ped_to_bed_write_genotypes(FILE* pedfile, FILE* outfile, uintptr_t unfiltered_marker_ct, uintptr_t* marker_exclude, uintptr_t marker_ct, uintptr_t sample_ct, uint32_t ped_buflen, uint32_t ped_col_skip, uint32_t map_is_unsorted, uint32_t* map_reverse, char* marker_alleles_f, char** marker_allele_ptrs, uintptr_t topsize) {
+  // Writes the body of the .bed file.  marker_allele_ptrs must be NULL in the
+  // single-character allele case; topsize is the number of bytes in use at
+  // the far end of the workspace.
+  unsigned char* wkspace_mark = wkspace_base;
+  uintptr_t sample_ct4 = (sample_ct + 3) / 4;
+  uintptr_t batch_max = (sample_ct + 3) & (~(3 * ONELU));
+  uintptr_t text_min = CACHEALIGN(4 * ((uintptr_t)ped_buflen));
+  uint32_t thread_ct = g_thread_ct;
+  uint32_t last_pass = 0;
+  int64_t* line_starts = NULL;
+  int32_t retval = 0;
+  pthread_t threads[MAX_THREADS];
+  unsigned char* writebuf;
+  char* text;
+  char* textptr;
+  char* text_end;
+  char* col1_ptr;
+  uintptr_t text_size;
+  uintptr_t sample_idx;
+  uintptr_t line_ct;
+  uintptr_t line_ct_max;
+  uintptr_t marker_uidx;
+  uintptr_t ulii;
+  uint32_t pass_ct;
+  uint32_t markers_per_pass;
+  uint32_t pass_idx;
+  uint32_t marker_idx;
+  uint32_t pct;
+  uint32_t uii;
+  uint32_t ujj;
+  if (thread_ct > sample_ct4) {
+    thread_ct = sample_ct4;
+  }
+  if (batch_max > PED_BATCH_MAX) {
+    batch_max = PED_BATCH_MAX;
+  }
+  g_ped_tile_stride = CACHEALIGN(PED_TILE_MARKERS * PED_TILE_QUADS + 4 * PED_TILE_QUADS * sizeof(intptr_t));
+  g_ped_tiles = wkspace_alloc(thread_ct * g_ped_tile_stride);
+  if ((!g_ped_tiles) ||
+      (!(g_ped_line_ptrs = (char**)wkspace_alloc(batch_max * sizeof(intptr_t)))) ||
+      wkspace_alloc_ll_checked(&g_ped_line_offsets, batch_max * sizeof(int64_t))) {
+    goto ped_to_bed_write_genotypes_ret_NOMEM;
+  }
+  if (wkspace_left < topsize + text_min + CACHELINE) {
+    goto ped_to_bed_write_genotypes_ret_NOMEM;
+  }
+  if (wkspace_left - topsize - text_min - CACHELINE >= marker_ct * sample_ct4) {
+    markers_per_pass = marker_ct;
+    sprintf(logbuf, "Performing single-pass .bed write (%" PRIuPTR " variant%s, %" PRIuPTR " %s).\n", marker_ct, (marker_ct == 1)? "" : "s", sample_ct, species_str(sample_ct));
+    pass_ct = 1;
+  } else {
+    if (!map_is_unsorted) {
+      if (wkspace_alloc_ll_checked(&line_starts, sample_ct * sizeof(int64_t))) {
+	goto ped_to_bed_write_genotypes_ret_NOMEM;
+      }
+      if (wkspace_left < topsize + text_min + CACHELINE) {
+	goto ped_to_bed_write_genotypes_ret_NOMEM;
+      }
+    }
+    markers_per_pass = (wkspace_left - topsize - text_min - CACHELINE) / sample_ct4;
+    if (!markers_per_pass) {
+      goto ped_to_bed_write_genotypes_ret_NOMEM;
+    }
+    pass_ct = (marker_ct + markers_per_pass - 1) / markers_per_pass;
+    sprintf(logbuf, "Performing %u-pass .bed write (%u/%" PRIuPTR " variant%s/pass, %" PRIuPTR " %s).\n", pass_ct, markers_per_pass, marker_ct, (markers_per_pass == 1)? "" : "s", sample_ct, species_str(sample_ct));
+  }
+  logprintb();
+  writebuf = wkspace_alloc(markers_per_pass * sample_ct4);
+  text_size = (wkspace_left - topsize) & (~(CACHELINE - ONELU));
+  if (text_size > PED_BATCH_TEXT_MAX) {
+    text_size = (text_min > PED_BATCH_TEXT_MAX)? text_min : PED_BATCH_TEXT_MAX;
+  }
+  text = (char*)wkspace_alloc(text_size);
+  text_end = &(text[text_size]);
+  g_ped_unfiltered_marker_ct = unfiltered_marker_ct;
+  g_ped_marker_exclude = marker_exclude;
+  g_ped_map_reverse = map_is_unsorted? map_reverse : NULL;
+  g_ped_alleles_f = marker_alleles_f;
+  g_ped_allele_ptrs = marker_allele_ptrs;
+  g_ped_writebuf = writebuf;
+  g_ped_sample_ct4 = sample_ct4;
+  g_ped_col_skip = ped_col_skip;
+  g_ped_missing_geno = *g_missing_geno_ptr;
+  marker_uidx = 0;
+  for (pass_idx = 0; pass_idx < pass_ct; pass_idx++) {
+    g_ped_marker_start = pass_idx * markers_per_pass;
+    if (pass_idx + 1 == pass_ct) {
+      ujj = marker_ct - g_ped_marker_start;
+      last_pass = 1;
+    } else {
+      ujj = markers_per_pass;
+    }
+    memset(writebuf, 0, ujj * sample_ct4);
+    g_ped_marker_end = g_ped_marker_start + ujj;
+    g_ped_marker_uidx_start = marker_uidx;
+    g_ped_full_lines = (!pass_idx) || map_is_unsorted;
+    g_ped_line_starts = last_pass? NULL : line_starts;
+    if (g_ped_full_lines) {
+      rewind(pedfile);
+    }
+    fputs("0%", stdout);
+    fflush(stdout);
+    pct = 0;
+    sample_idx = 0;
+    while (sample_idx < sample_ct) {
+      line_ct_max = sample_ct - sample_idx;
+      if (line_ct_max > batch_max) {
+	line_ct_max = batch_max;
+      }
+      // only start a new group of four lines if all of them are guaranteed to
+      // fit
+      textptr = text;
+      for (line_ct = 0; (line_ct < line_ct_max) && ((line_ct % 4) || (((uintptr_t)(text_end - textptr)) >= text_min)); line_ct++) {
+	if (g_ped_full_lines) {
+	  do {
+	    if (g_ped_line_starts) {
+	      g_ped_line_offsets[line_ct] = ftello(pedfile);
+	    }
+	    if (!fgets(textptr, ped_buflen, pedfile)) {
+	      goto ped_to_bed_write_genotypes_ret_READ_FAIL;
+	    }
+	    col1_ptr = skip_initial_spaces(textptr);
+	  } while (is_eoln_or_comment(*col1_ptr));
+	  if (g_ped_line_starts) {
+	    g_ped_line_offsets[line_ct] += (uintptr_t)(col1_ptr - textptr);
+	  }
+	  g_ped_line_ptrs[line_ct] = col1_ptr;
+	} else {
+	  g_ped_line_offsets[line_ct] = line_starts[sample_idx + line_ct];
+	  if (fseeko(pedfile, line_starts[sample_idx + line_ct], SEEK_SET)) {
+	    goto ped_to_bed_write_genotypes_ret_READ_FAIL;
+	  }
+	  if (!fgets(textptr, ped_buflen, pedfile)) {
+	    goto ped_to_bed_write_genotypes_ret_READ_FAIL;
+	  }
+	  g_ped_line_ptrs[line_ct] = textptr;
+	}
+	textptr = &(textptr[strlen(textptr) + 1]);
+      }
+      g_ped_batch_sample_start = sample_idx;
+      g_ped_batch_line_ct = line_ct;
+      ulii = (line_ct + 3) / 4;
+      uii = (ulii < thread_ct)? ulii : thread_ct;
+      ws_ranges_init(uii, 0, ulii);
+      if (spawn_threads(threads, &ped_to_bed_thread, uii)) {
+	goto ped_to_bed_write_genotypes_ret_THREAD_CREATE_FAIL;
+      }
+      ped_to_bed_thread((void*)0);
+      join_threads(threads, uii);
+      sample_idx += line_ct;
+      // 94 instead of 100 due to big fwrite at the end
+      ujj = (((uint64_t)sample_idx) * 94) / sample_ct;
+      if (ujj > pct) {
+	if (pct >= 10) {
+	  putchar('\b');
+	}
+	printf("\b\b%u%%", ujj);
+	fflush(stdout);
+	pct = ujj;
+      }
+    }
+    if (fwrite_checked(writebuf, ((uintptr_t)(g_ped_marker_end - g_ped_marker_start)) * sample_ct4, outfile)) {
+      goto ped_to_bed_write_genotypes_ret_WRITE_FAIL;
+    }
+    if (!last_pass) {
+      printf("\rPass %u:    \b\b\b", pass_idx + 2);
+      fflush(stdout);
+      if (!map_is_unsorted) {
+	// first unfiltered index of the next pass
+	for (marker_idx = g_ped_marker_start; marker_idx < g_ped_marker_end; marker_uidx++) {
+	  if (!IS_SET(marker_exclude, marker_uidx)) {
+	    marker_idx++;
+	  }
+	}
+      }
+    }
+  }
+  while (0) {
+  ped_to_bed_write_genotypes_ret_NOMEM:
+    retval = RET_NOMEM;
+    break;
+  ped_to_bed_write_genotypes_ret_READ_FAIL:
+    putchar('\n');
+    retval = RET_READ_FAIL;
+    break;
+  ped_to_bed_write_genotypes_ret_WRITE_FAIL:
+    putchar('\n');
+    retval = RET_WRITE_FAIL;
+    break;
+  ped_to_bed_write_genotypes_ret_THREAD_CREATE_FAIL:
+    putchar('\n');
+    retval = RET_THREAD_CREATE_FAIL;
+    break;
+  }
+  wkspace_reset(wkspace_mark);
+  return retval;
+}
+
 int32_t ped_to_bed_multichar_allele(FILE** pedfile_ptr, FILE** outfile_ptr, char* outname, char* outname_end, FILE** mapfile_ptr, uintptr_t unfiltered_marker_ct, uintptr_t* marker_exclude, uintptr_t marker_ct, char* marker_alleles_f, uint32_t map_is_unsorted, uint32_t fam_cols, uint32_t ped_col_skip_iid, uint32_t ped_col_skip, uint32_t gd_col, uint32_t* map_reverse, int64_t ped_size, char* missing_pheno_str) {
   // maintain allele counts and linked lists of observed alleles at FAR end of
   // wkspace.
@@ -5249,16 +6363,12 @@ int32_t ped_to_bed_multichar_allele(FILE** pedfile_ptr, FILE** outfile_ptr, char
   uintptr_t line_idx = 0;
   uint32_t pct = 1;
   int64_t ped_next_thresh = ped_size / 100;
-  uint32_t last_pass = 0;
-  int64_t* line_starts = NULL;
   char* missing_geno_ptr = (char*)g_missing_geno_ptr;
   char missing_geno = *missing_geno_ptr;
   // do NOT convert missing -> output_missing when autoconverting, since the
   // .bim/.fam files are usually read right back in.
   char** marker_allele_ptrs = NULL;
   FILE* outfile;
-  uint32_t pass_ct;
-  uintptr_t sample_ct4;
   char* loadbuf;
   char* col1_ptr;
   char* col2_ptr;
@@ -5269,27 +6379,16 @@ int32_t ped_to_bed_multichar_allele(FILE** pedfile_ptr, FILE** outfile_ptr, char
   uintptr_t cur_slen_rdup;
   Ll_str_fixed* marker_alleles_tmp;
   uint32_t* marker_allele_cts;
-  uint32_t markers_per_pass;
-  uint32_t marker_start;
-  uint32_t marker_end;
   uintptr_t marker_uidx;
   uintptr_t marker_idx;
-  uint32_t loop_end;
-  uintptr_t sample_idx;
   uintptr_t ulii;
   uintptr_t uljj;
   uint32_t uii;
-  uint32_t ujj;
-  uint32_t ukk;
-  uint32_t umm;
   uint32_t alen1;
   uint32_t alen2;
   char* aptr1;
   char* aptr2;
   unsigned char ucc;
-  uint32_t ii_shift;
-  unsigned char* writebuf;
-  unsigned char* wbufptr;
   wkspace_reset(marker_alleles_f);
   if ((wkspace_left / (4LU * sizeof(int32_t) + 16)) <= marker_ct) {
     goto ped_to_bed_multichar_allele_ret_NOMEM;
@@ -5545,34 +6644,11 @@ int32_t ped_to_bed_multichar_allele(FILE** pedfile_ptr, FILE** outfile_ptr, char
     }
     marker_uidx++;
   }
-  sample_ct4 = (sample_ct + 3) / 4;
   fclose_null(mapfile_ptr);
   if (map_is_unsorted) {
     unlink(outname);
   }
   fclose_null(outfile_ptr);
-  if (wkspace_alloc_c_checked(&loadbuf, ped_buflen)) {
-    goto ped_to_bed_multichar_allele_ret_NOMEM;
-  }
-  if (wkspace_left >= marker_ct * sample_ct4) {
-    markers_per_pass = marker_ct;
-    sprintf(logbuf, "Performing single-pass .bed write (%" PRIuPTR " variant%s, %" PRIuPTR " %s).\n", marker_ct, (marker_ct == 1)? "" : "s", sample_ct, species_str(sample_ct));
-    pass_ct = 1;
-  } else {
-    if (!map_is_unsorted) {
-      if (wkspace_alloc_ll_checked(&line_starts, sample_ct * sizeof(int64_t))) {
-	goto ped_to_bed_multichar_allele_ret_NOMEM;
-      }
-    }
-    markers_per_pass = wkspace_left / sample_ct4;
-    if (!markers_per_pass) {
-      goto ped_to_bed_multichar_allele_ret_NOMEM;
-    }
-    pass_ct = (marker_ct + markers_per_pass - 1) / markers_per_pass;
-    sprintf(logbuf, "Performing %u-pass .bed write (%u/%" PRIuPTR " variant%s/pass, %" PRIuPTR " %s).\n", pass_ct, markers_per_pass, marker_ct, (markers_per_pass == 1)? "" : "s", sample_ct, species_str(sample_ct));
-  }
-  logprintb();
-  writebuf = wkspace_base;
   memcpy(outname_end, ".bed", 5);
   if (fopen_checked(outfile_ptr, outname, "wb")) {
     goto ped_to_bed_multichar_allele_ret_OPEN_FAIL;
@@ -5580,145 +6656,8 @@ int32_t ped_to_bed_multichar_allele(FILE** pedfile_ptr, FILE** outfile_ptr, char
   if (fwrite_checked("l\x1b\x01", 3, *outfile_ptr)) {
     goto ped_to_bed_multichar_allele_ret_WRITE_FAIL;
   }
-  rewind(*pedfile_ptr);
-  umm = 0;
-  for (uii = 0; uii < pass_ct; uii++) {
-    marker_start = uii * markers_per_pass;
-    if (uii + 1 == pass_ct) {
-      ujj = marker_ct - marker_start;
-      last_pass = 1;
-    } else {
-      ujj = markers_per_pass;
-    }
-    memset(writebuf, 0, ujj * sample_ct4);
-    marker_end = marker_start + ujj;
-    fputs("0%", stdout);
-    sample_idx = 0;
-    // 94 instead of 100 due to big fwrite at the end
-    for (pct = 1; pct <= 94; pct++) {
-      loop_end = (((uint64_t)pct) * sample_ct) / 94LLU;
-      for (; sample_idx < loop_end; sample_idx++) {
-	if ((!uii) || map_is_unsorted) {
-	  do {
-	    if (!last_pass) {
-	      ped_next_thresh = ftello(*pedfile_ptr);
-	    }
-	    if (!fgets(loadbuf, ped_buflen, *pedfile_ptr)) {
-	      goto ped_to_bed_multichar_allele_ret_READ_FAIL_2;
-	    }
-	    col1_ptr = skip_initial_spaces(loadbuf);
-	  } while (is_eoln_or_comment(*col1_ptr));
-	  bufptr = next_token_mult(col1_ptr, ped_col_skip);
-	} else {
-	  ped_next_thresh = line_starts[sample_idx];
-	  if (fseeko(*pedfile_ptr, line_starts[sample_idx], SEEK_SET)) {
-	    goto ped_to_bed_multichar_allele_ret_READ_FAIL_2;
-	  }
-	  if (!fgets(loadbuf, ped_buflen, *pedfile_ptr)) {
-	    goto ped_to_bed_multichar_allele_ret_READ_FAIL_2;
-	  }
-	  bufptr = loadbuf;
-	}
-	marker_idx = uii * markers_per_pass;
-	ii_shift = (sample_idx % 4) * 2;
-	wbufptr = &(writebuf[sample_idx / 4]);
-	if (map_is_unsorted) {
-	  umm = 0;
-	  for (marker_uidx = 0; marker_uidx < unfiltered_marker_ct; marker_uidx++) {
-	    aptr1 = bufptr;
-	    bufptr = token_endnn(bufptr);
-	    alen1 = (uintptr_t)(bufptr - aptr1);
-	    bufptr = skip_initial_spaces(bufptr);
-	    aptr1[alen1] = '\0';
-	    aptr2 = bufptr;
-	    bufptr = token_endnn(bufptr);
-	    alen2 = (uintptr_t)(bufptr - aptr2);
-	    bufptr = skip_initial_spaces(bufptr);
-	    aptr2[alen2] = '\0';
-	    if (IS_SET(marker_exclude, marker_uidx)) {
-	      continue;
-	    }
-	    ukk = map_reverse[umm++];
-	    if ((ukk >= marker_start) && (ukk < marker_end)) {
-	      ucc = 1;
-	      if ((*aptr1 != missing_geno) || (alen1 != 1)) {
-		if (!strcmp(aptr1, marker_allele_ptrs[2 * ukk + 1])) {
-		  if ((alen1 == alen2) && (!memcmp(aptr1, aptr2, alen1))) {
-		    ucc = 3;
-		  } else if (!strcmp(aptr2, marker_allele_ptrs[2 * ukk])) {
-		    ucc = 2;
-		  }
-		} else if (!strcmp(aptr1, marker_allele_ptrs[2 * ukk])) {
-		  if ((alen1 == alen2) && (!memcmp(aptr1, aptr2, alen1))) {
-		    ucc = 0;
-		  } else if (!strcmp(aptr2, marker_allele_ptrs[2 * ukk + 1])) {
-		    ucc = 2;
-		  }
-		}
-	      }
-	      wbufptr[(ukk - marker_start) * sample_ct4] |= ucc << ii_shift;
-	      marker_idx++;
-	    }
-	  }
-	} else {
-	  for (marker_uidx = umm; marker_idx < marker_end; marker_uidx++) {
-	    aptr1 = bufptr;
-	    bufptr = token_endnn(bufptr);
-	    alen1 = (uintptr_t)(bufptr - aptr1);
-	    bufptr = skip_initial_spaces(bufptr);
-	    aptr1[alen1] = '\0';
-	    aptr2 = bufptr;
-	    bufptr = token_endnn(bufptr);
-	    alen2 = (uintptr_t)(bufptr - aptr2);
-	    bufptr = skip_initial_spaces(bufptr);
-	    aptr2[alen2] = '\0';
-	    if (is_set(marker_exclude, marker_uidx)) {
-	      continue;
-	    }
-	    ucc = 1;
-	    if ((*aptr1 != missing_geno) || (alen1 != 1)) {
-	      if (!strcmp(aptr1, marker_allele_ptrs[2 * marker_idx + 1])) {
-		if ((alen1 == alen2) && (!memcmp(aptr1, aptr2, alen1))) {
-		  ucc = 3;
-		} else if (!strcmp(aptr2, marker_allele_ptrs[2 * marker_idx])) {
-		  ucc = 2;
-		}
-	      } else if (!strcmp(aptr1, marker_allele_ptrs[2 * marker_idx])) {
-		if ((alen1 == alen2) && (!memcmp(aptr1, aptr2, alen1))) {
-		  ucc = 0;
-		} else if (!strcmp(aptr2, marker_allele_ptrs[2 * marker_idx + 1])) {
-		  ucc = 2;
-		}
-	      }
-	    }
-	    *wbufptr |= ucc << ii_shift;
-	    wbufptr = &(wbufptr[sample_ct4]);
-	    marker_idx++;
-	  }
-	  if (!last_pass) {
-	    line_starts[sample_idx] = ped_next_thresh + (uintptr_t)(bufptr - loadbuf);
-	  }
-	}
-      }
-      if (pct > 10) {
-	putchar('\b');
-      }
-      printf("\b\b%u%%", pct);
-      fflush(stdout);
-    }
-    if (fwrite_checked(writebuf, ujj * sample_ct4, *outfile_ptr)) {
-      goto ped_to_bed_multichar_allele_ret_WRITE_FAIL_2;
-    }
-    if (!last_pass) {
-      printf("\rPass %u:    \b\b\b", uii + 2);
-      fflush(stdout);
-      if (map_is_unsorted) {
-	rewind(*pedfile_ptr);
-      } else {
-	umm = marker_uidx;
-      }
-    }
-  }
+  // allele names are still at the far end of the workspace
+  retval = ped_to_bed_write_genotypes(*pedfile_ptr, *outfile_ptr, unfiltered_marker_ct, marker_exclude, marker_ct, sample_ct, ped_buflen, ped_col_skip, map_is_unsorted, map_reverse, NULL, marker_allele_ptrs, topsize);
 
   while (0) {
   ped_to_bed_multichar_allele_ret_NOMEM:
@@ -5727,13 +6666,9 @@ int32_t ped_to_bed_multichar_allele(FILE** pedfile_ptr, FILE** outfile_ptr, char
   ped_to_bed_multichar_allele_ret_OPEN_FAIL:
     retval = RET_OPEN_FAIL;
     break;
-  ped_to_bed_multichar_allele_ret_READ_FAIL_2:
-    putchar('\n');
   ped_to_bed_multichar_allele_ret_READ_FAIL:
     retval = RET_READ_FAIL;
     break;
-  ped_to_bed_multichar_allele_ret_WRITE_FAIL_2:
-    putchar('\n');
   ped_to_bed_multichar_allele_ret_WRITE_FAIL:
     retval = RET_WRITE_FAIL;
     break;
@@ -5784,15 +6719,11 @@ int32_t ped_to_bed(char* pedname, char* mapname, char* outname, char* outname_en
   int32_t retval = 0;
   uint32_t ped_col_skip_iid = 1 + 2 * ((fam_cols & FAM_COL_34) / FAM_COL_34) + ((fam_cols & FAM_COL_5) / FAM_COL_5) + ((fam_cols & FAM_COL_6) / FAM_COL_6);
   uint32_t ped_col_skip = ped_col_skip_iid + ((fam_cols & FAM_COL_1) / FAM_COL_1);
-  uint32_t last_pass = 0;
-  int64_t* line_starts = NULL;
 
   uint32_t is_single_char_alleles = 1;
   char missing_geno = *g_missing_geno_ptr;
   char missing_pheno_str[12];
 
-  uint32_t pass_ct;
-  uintptr_t sample_ct4;
   uint32_t pct;
   char* marker_alleles_f;
   char* marker_alleles;
@@ -5801,13 +6732,8 @@ int32_t ped_to_bed(char* pedname, char* mapname, char* outname, char* outname_en
   uintptr_t marker_uidx;
   uintptr_t marker_idx;
   uintptr_t line_idx;
-  uintptr_t sample_idx;
   uintptr_t ulii;
   uint32_t cm_col;
-  uint32_t markers_per_pass;
-  uint32_t marker_start;
-  uint32_t marker_end;
-  uint32_t loop_end;
   uint32_t uii;
   uint32_t ujj;
   uint32_t ukk;
@@ -5823,9 +6749,6 @@ int32_t ped_to_bed(char* pedname, char* mapname, char* outname, char* outname_en
   char cc;
   char cc2;
   unsigned char ucc;
-  uint32_t ii_shift;
-  unsigned char* writebuf;
-  unsigned char* wbufptr;
   int64_t ped_size;
   int64_t ped_next_thresh;
   int32_writex(missing_pheno_str, missing_pheno, '\0');
@@ -6194,35 +7117,12 @@ int32_t ped_to_bed(char* pedname, char* mapname, char* outname, char* outname_en
       }
       marker_uidx++;
     }
-    sample_ct4 = (sample_ct + 3) / 4;
     wkspace_reset(marker_alleles);
     fclose_null(&mapfile);
     if (map_is_unsorted) {
       unlink(outname);
     }
     fclose_null(&outfile);
-    if (wkspace_alloc_c_checked(&loadbuf, ped_buflen)) {
-      goto ped_to_bed_ret_NOMEM;
-    }
-    if (wkspace_left >= marker_ct * sample_ct4) {
-      markers_per_pass = marker_ct;
-      sprintf(logbuf, "Performing single-pass .bed write (%" PRIuPTR " variant%s, %" PRIuPTR " %s).\n", marker_ct, (marker_ct == 1)? "" : "s", sample_ct, species_str(sample_ct));
-      pass_ct = 1;
-    } else {
-      if (!map_is_unsorted) {
-	if (wkspace_alloc_ll_checked(&line_starts, sample_ct * sizeof(int64_t))) {
-	  goto ped_to_bed_ret_NOMEM;
-	}
-      }
-      markers_per_pass = wkspace_left / sample_ct4;
-      if (!markers_per_pass) {
-	goto ped_to_bed_ret_NOMEM;
-      }
-      pass_ct = (marker_ct + markers_per_pass - 1) / markers_per_pass;
-      sprintf(logbuf, "Performing %u-pass .bed write (%u/%" PRIuPTR " variant%s/pass, %" PRIuPTR " %s).\n", pass_ct, markers_per_pass, marker_ct, (markers_per_pass == 1)? "" : "s", sample_ct, species_str(sample_ct));
-    }
-    logprintb();
-    writebuf = wkspace_base;
     memcpy(outname_end, ".bed", 5);
     if (fopen_checked(&outfile, outname, "wb")) {
       goto ped_to_bed_ret_OPEN_FAIL;
@@ -6230,131 +7130,9 @@ int32_t ped_to_bed(char* pedname, char* mapname, char* outname, char* outname_en
     if (fwrite_checked("l\x1b\x01", 3, outfile)) {
       goto ped_to_bed_ret_WRITE_FAIL;
     }
-    rewind(pedfile);
-    umm = 0;
-    for (uii = 0; uii < pass_ct; uii++) {
-      marker_start = uii * markers_per_pass;
-      if (uii + 1 == pass_ct) {
-	ujj = marker_ct - marker_start;
-	last_pass = 1;
-      } else {
-	ujj = markers_per_pass;
-      }
-      memset(writebuf, 0, ujj * sample_ct4);
-      marker_end = marker_start + ujj;
-      fputs("0%", stdout);
-      sample_idx = 0;
-      // 94 instead of 100 due to big fwrite at the end
-      for (pct = 1; pct <= 94; pct++) {
-	loop_end = (((uint64_t)pct) * sample_ct) / 94LLU;
-	for (; sample_idx < loop_end; sample_idx++) {
-	  if ((!uii) || map_is_unsorted) {
-	    do {
-	      if (!last_pass) {
-		ped_next_thresh = ftello(pedfile);
-	      }
-	      if (!fgets(loadbuf, ped_buflen, pedfile)) {
-		goto ped_to_bed_ret_READ_FAIL_2;
-	      }
-	      col1_ptr = skip_initial_spaces(loadbuf);
-	    } while (is_eoln_or_comment(*col1_ptr));
-	    bufptr = next_token_mult(col1_ptr, ped_col_skip);
-	  } else {
-	    ped_next_thresh = line_starts[sample_idx];
-	    if (fseeko(pedfile, line_starts[sample_idx], SEEK_SET)) {
-	      goto ped_to_bed_ret_READ_FAIL_2;
-	    }
-	    if (!fgets(loadbuf, ped_buflen, pedfile)) {
-	      goto ped_to_bed_ret_READ_FAIL_2;
-	    }
-	    bufptr = loadbuf;
-	  }
-	  marker_idx = uii * markers_per_pass;
-	  ii_shift = (sample_idx % 4) * 2;
-	  wbufptr = &(writebuf[sample_idx / 4]);
-	  if (map_is_unsorted) {
-	    // multipass optimizations are possible, but we won't bother,
-	    // especially since the .map should rarely be unsorted in the first
-	    // place...
-	    umm = 0;
-	    for (marker_uidx = 0; marker_uidx < unfiltered_marker_ct; marker_uidx++) {
-	      cc = *bufptr++;
-	      bufptr = skip_initial_spaces(bufptr);
-	      cc2 = *bufptr++;
-	      bufptr = skip_initial_spaces(bufptr);
-	      if (IS_SET(marker_exclude, marker_uidx)) {
-		continue;
-	      }
-	      ukk = map_reverse[umm++];
-	      if ((ukk >= marker_start) && (ukk < marker_end)) {
-		ucc = 1;
-		if (cc == marker_alleles_f[2 * ukk + 1]) {
-		  if (cc2 == cc) {
-		    ucc = 3;
-		  } else if (cc2 == marker_alleles_f[2 * ukk]) {
-		    ucc = 2;
-		  }
-		} else if (cc == marker_alleles_f[2 * ukk]) {
-		  if (cc2 == cc) {
-		    ucc = 0;
-		  } else if (cc2 == marker_alleles_f[2 * ukk + 1]) {
-		    ucc = 2;
-		  }
-		}
-		wbufptr[(ukk - marker_start) * sample_ct4] |= ucc << ii_shift;
-		marker_idx++;
-	      }
-	    }
-	  } else {
-	    for (marker_uidx = umm; marker_idx < marker_end; marker_uidx++) {
-	      cc = *bufptr++;
-	      bufptr = skip_initial_spaces(bufptr);
-	      cc2 = *bufptr++;
-	      bufptr = skip_initial_spaces(bufptr);
-	      if (IS_SET(marker_exclude, marker_uidx)) {
-		continue;
-	      }
-	      ucc = 1;
-	      if (cc == marker_alleles_f[2 * marker_idx + 1]) {
-		if (cc2 == cc) {
-		  ucc = 3;
-		} else if (cc2 == marker_alleles_f[2 * marker_idx]) {
-		  ucc = 2;
-		}
-	      } else if (cc == marker_alleles_f[2 * marker_idx]) {
-		if (cc2 == cc) {
-		  ucc = 0;
-		} else if (cc2 == marker_alleles_f[2 * marker_idx + 1]) {
-		  ucc = 2;
-		}
-	      }
-	      *wbufptr |= ucc << ii_shift;
-	      wbufptr = &(wbufptr[sample_ct4]);
-	      marker_idx++;
-	    }
-	    if (!last_pass) {
-	      line_starts[sample_idx] = ped_next_thresh + (uintptr_t)(bufptr - loadbuf);
-	    }
-	  }
-	}
-	if (pct > 10) {
-	  putchar('\b');
-	}
-	printf("\b\b%u%%", pct);
-	fflush(stdout);
-      }
-      if (fwrite_checked(writebuf, ujj * sample_ct4, outfile)) {
-	goto ped_to_bed_ret_WRITE_FAIL_2;
-      }
-      if (!last_pass) {
-	printf("\rPass %u:    \b\b\b", uii + 2);
-	fflush(stdout);
-	if (map_is_unsorted) {
-	  rewind(pedfile);
-	} else {
-	  umm = marker_uidx;
-	}
-      }
+    retval = ped_to_bed_write_genotypes(pedfile, outfile, unfiltered_marker_ct, marker_exclude, marker_ct, sample_ct, ped_buflen, ped_col_skip, map_is_unsorted, map_reverse, marker_alleles_f, NULL, 0);
+    if (retval) {
+      goto ped_to_bed_ret_1;
     }
   } else {
     retval = ped_to_bed_multichar_allele(&pedfile, &outfile, outname, outname_end, &mapfile, unfiltered_marker_ct, marker_exclude, marker_ct, marker_alleles_f, map_is_unsorted, fam_cols, ped_col_skip_iid, ped_col_skip, cm_col, map_reverse, ped_size, missing_pheno_str);
@@ -6377,8 +7155,6 @@ int32_t ped_to_bed(char* pedname, char* mapname, char* outname, char* outname_en
   ped_to_bed_ret_OPEN_FAIL:
     retval = RET_OPEN_FAIL;
     break;
-  ped_to_bed_ret_READ_FAIL_2:
-    putchar('\n');
   ped_to_bed_ret_READ_FAIL:
     retval = RET_READ_FAIL;
     break;
@@ -6410,6 +7186,121 @@ int32_t ped_to_bed(char* pedname, char* mapname, char* outname, char* outname_en
   return retval;
 }
 
+#define LGEN_BATCH_LINES 65536
+#define LGEN_CLAIM_LINES 512
+
+#define LGEN_LINE_OK 0
+#define LGEN_LINE_BLANK 1
+#define LGEN_LINE_MISSING_TOKENS 2
+#define LGEN_LINE_MISSING_IID 3
+
+typedef struct lgen_line_struct {
+  char* a1ptr;
+  char* sptr;
+  char* a2ptr;
+  uint32_t sample_idx;
+  uint32_t marker_uidx; // 0xffffffffU if not in (filtered) .map
+  uint32_t marker_idx;
+  uint32_t status;
+} Lgen_line;
+
+static char** g_lgen_line_starts;
+static Lgen_line* g_lgen_lines;
+static char* g_lgen_id_bufs;
+static uintptr_t g_lgen_id_buf_stride;
+static char* g_lgen_sample_ids;
+static uintptr_t g_lgen_max_sample_id_len;
+static uint32_t* g_lgen_sample_id_htable;
+static uint32_t g_lgen_sample_id_htable_size;
+static char* g_lgen_marker_ids;
+static uintptr_t g_lgen_max_marker_id_len;
+static uint32_t* g_lgen_marker_id_htable;
+static uint32_t g_lgen_marker_id_htable_size;
+static uint32_t* g_lgen_marker_uidx_to_idx;
+static uint32_t g_lgen_allele_count;
+
+THREAD_RET_TYPE lgen_to_bed_thread(void* arg) {
+  // Tokenizes a batch of .lgen lines and resolves their sample and variant
+  // IDs.  Everything order-dependent (allele discovery, compound genotype
+  // detection, error precedence) is left to the main thread.
+  uintptr_t tidx = (uintptr_t)arg;
+  char* id_buf = &(g_lgen_id_bufs[tidx * g_lgen_id_buf_stride]);
+  char* sample_ids = g_lgen_sample_ids;
+  uintptr_t max_sample_id_len = g_lgen_max_sample_id_len;
+  uint32_t* sample_id_htable = g_lgen_sample_id_htable;
+  uint32_t sample_id_htable_size = g_lgen_sample_id_htable_size;
+  char* marker_ids = g_lgen_marker_ids;
+  uintptr_t max_marker_id_len = g_lgen_max_marker_id_len;
+  uint32_t* marker_id_htable = g_lgen_marker_id_htable;
+  uint32_t marker_id_htable_size = g_lgen_marker_id_htable_size;
+  uint32_t allele_count = g_lgen_allele_count;
+  Lgen_line* cur_line;
+  char* cptr;
+  char* cptr3;
+  char* cptr4;
+  char* iid_ptr;
+  uintptr_t slen_fid;
+  uintptr_t slen_iid;
+  uintptr_t slen_final;
+  uint32_t line_idx;
+  uint32_t line_end;
+  uint32_t uii;
+  while (ws_claim(tidx, LGEN_CLAIM_LINES, &line_idx, &line_end)) {
+    for (; line_idx < line_end; line_idx++) {
+      cur_line = &(g_lgen_lines[line_idx]);
+      cptr = skip_initial_spaces(g_lgen_line_starts[line_idx]);
+      if (is_eoln_kns(*cptr)) {
+	cur_line->status = LGEN_LINE_BLANK;
+	continue;
+      }
+      // same parse as bsearch_read_fam_indiv()
+      slen_fid = strlen_se(cptr);
+      iid_ptr = skip_initial_spaces(&(cptr[slen_fid]));
+      if (is_eoln_kns(*iid_ptr)) {
+	cur_line->status = LGEN_LINE_MISSING_TOKENS;
+	continue;
+      }
+      slen_iid = strlen_se(iid_ptr);
+      cptr3 = skip_initial_spaces(&(iid_ptr[slen_iid]));
+      slen_final = slen_fid + slen_iid + 1;
+      uii = 0xffffffffU;
+      if (slen_final < max_sample_id_len) {
+	memcpy(memcpyax(id_buf, cptr, slen_fid, '\t'), iid_ptr, slen_iid);
+	uii = id_htable_find(id_buf, slen_final, sample_id_htable, sample_id_htable_size, sample_ids, max_sample_id_len);
+      }
+      if (uii == 0xffffffffU) {
+	cur_line->status = LGEN_LINE_MISSING_IID;
+	continue;
+      }
+      cur_line->sample_idx = uii;
+      cptr4 = token_end(cptr3);
+      if (!cptr4) {
+	cur_line->status = LGEN_LINE_MISSING_TOKENS;
+	continue;
+      }
+      cptr = skip_initial_spaces(cptr4);
+      cur_line->a1ptr = cptr;
+      if (allele_count) {
+	if (no_more_tokens_kns(cptr)) {
+	  cur_line->status = LGEN_LINE_MISSING_TOKENS;
+	  continue;
+	}
+      } else {
+	cptr = token_end(cptr);
+	cur_line->sptr = cptr;
+	cur_line->a2ptr = next_token(cptr);
+      }
+      uii = id_htable_find(cptr3, (uintptr_t)(cptr4 - cptr3), marker_id_htable, marker_id_htable_size, marker_ids, max_marker_id_len);
+      cur_line->marker_uidx = uii;
+      if (uii != 0xffffffffU) {
+	cur_line->marker_idx = g_lgen_marker_uidx_to_idx[uii];
+      }
+      cur_line->status = LGEN_LINE_OK;
+    }
+  }
+  THREAD_RETURN;
+}
+
 int32_t lgen_to_bed(char* lgen_namebuf, char* outname, char* outname_end, int32_t missing_pheno, uint64_t misc_flags, uint32_t lgen_modifier, char* lgen_reference_fname, Chrom_info* chrom_info_ptr) {
   unsigned char* wkspace_mark = wkspace_base;
   FILE* infile = NULL;
@@ -6446,21 +7337,24 @@ int32_t lgen_to_bed(char* lgen_namebuf, char* outname, char* outname_end, int32_
   uintptr_t* pheno_nm = NULL;
   uintptr_t* pheno_c = NULL;
   double* pheno_d = NULL;
-  char* sorted_marker_ids;
-  uint32_t* marker_id_map;
-  uint32_t* map_reverse;
-  char* sorted_sample_ids;
-  uint32_t* sample_id_map;
+  uint32_t thread_ct = g_thread_ct;
+  pthread_t threads[MAX_THREADS];
+  uint32_t* marker_id_htable;
+  uint32_t* sample_id_htable;
+  uint32_t* marker_uidx_to_idx;
+  char** line_starts;
+  Lgen_line* lines;
+  Lgen_line* cur_line;
   unsigned char* writebuf;
   uintptr_t sample_ct4;
   uintptr_t marker_idx;
   unsigned char ucc;
   char* loadbuf;
-  char* id_buf;
+  char* loadbuf_end;
+  char* textptr;
+  char* carry_ptr;
   char* cptr;
   char* cptr2;
-  char* cptr3;
-  char* cptr4;
   char* a1ptr;
   char* a2ptr;
   char* sptr;
@@ -6470,15 +7364,19 @@ int32_t lgen_to_bed(char* lgen_namebuf, char* outname, char* outname_end, int32_
   int64_t lgen_next_thresh;
   uintptr_t loadbuf_size;
   uintptr_t line_idx;
+  uintptr_t line_ct;
+  uintptr_t batch_line_max;
   uintptr_t sample_idx;
   uintptr_t ulii;
+  uint32_t marker_id_htable_size;
+  uint32_t sample_id_htable_size;
+  uint32_t marker_uidx;
   uint32_t a1len;
   uint32_t a2len;
   uint32_t uii;
   uint32_t ujj;
   uint32_t pct;
   int32_t retval;
-  int32_t ii;
   if (lgen_modifier == LGEN_ALLELE_COUNT) {
     logprint("Error: --allele-count must be used with --reference.\n");
     goto lgen_to_bed_ret_INVALID_CMDLINE;
@@ -6490,42 +7388,38 @@ int32_t lgen_to_bed(char* lgen_namebuf, char* outname, char* outname_end, int32_
     goto lgen_to_bed_ret_1;
   }
   marker_ct = unfiltered_marker_ct - marker_exclude_ct;
-  retval = sort_item_ids(&sorted_marker_ids, &marker_id_map, unfiltered_marker_ct, marker_exclude, marker_exclude_ct, marker_ids, max_marker_id_len, 0, 0, strcmp_deref);
+  retval = alloc_and_populate_id_htable(unfiltered_marker_ct, marker_exclude, marker_ct, marker_ids, max_marker_id_len, 0, &marker_id_htable, &marker_id_htable_size);
   if (retval) {
     goto lgen_to_bed_ret_1;
   }
   if (map_is_unsorted) {
     // Writes a temporary .map which is read later, and then deleted.
-    retval = load_sort_and_write_map(&map_reverse, infile, map_cols, outname, outname_end, unfiltered_marker_ct, marker_exclude, marker_ct, max_marker_id_len, 0, chrom_info_ptr);
+    // map_reverse[] is indexed by unfiltered position, and already contains
+    // final (sorted, filtered) positions.
+    retval = load_sort_and_write_map(&marker_uidx_to_idx, infile, map_cols, outname, outname_end, unfiltered_marker_ct, marker_exclude, marker_ct, max_marker_id_len, 0, chrom_info_ptr);
     if (retval) {
       goto lgen_to_bed_ret_1;
     }
-    for (uii = 0; uii < marker_ct; uii++) {
-      marker_id_map[uii] = map_reverse[marker_id_map[uii]];
+  } else {
+    if (wkspace_alloc_ui_checked(&marker_uidx_to_idx, unfiltered_marker_ct * sizeof(int32_t))) {
+      goto lgen_to_bed_ret_NOMEM;
     }
-  }
-  // collapse
-  if (wkspace_alloc_ui_checked(&sample_id_map, unfiltered_marker_ct * sizeof(int32_t))) {
-    goto lgen_to_bed_ret_NOMEM;
-  }
-  fill_uidx_to_idx(marker_exclude, unfiltered_marker_ct, marker_ct, sample_id_map);
-  for (uii = 0; uii < marker_ct; uii++) {
-    marker_id_map[uii] = sample_id_map[marker_id_map[uii]];
+    fill_uidx_to_idx(marker_exclude, unfiltered_marker_ct, marker_ct, marker_uidx_to_idx);
   }
   fclose_null(&infile);
-  memcpy(marker_ids, sorted_marker_ids, marker_ct * max_marker_id_len);
-  wkspace_reset(sorted_marker_ids);
 
   memcpy(name_end, ".fam", 5);
   retval = load_fam(lgen_namebuf, FAM_COL_13456, 1, missing_pheno, affection_01, &sample_ct, &sample_ids, &max_sample_id_len, &paternal_ids, &max_paternal_id_len, &maternal_ids, &max_maternal_id_len, &sex_nm, &sex_male, &affection, &pheno_nm, &pheno_c, &pheno_d, &founder_info, &sample_exclude);
   if (retval) {
     goto lgen_to_bed_ret_1;
   }
-  retval = sort_item_ids_nx(&sorted_sample_ids, &sample_id_map, sample_ct, sample_ids, max_sample_id_len);
+  retval = alloc_and_populate_id_htable(sample_ct, sample_exclude, sample_ct, sample_ids, max_sample_id_len, 0, &sample_id_htable, &sample_id_htable_size);
   if (retval) {
     goto lgen_to_bed_ret_1;
   }
-  if (wkspace_alloc_c_checked(&id_buf, MAXV(max_marker_id_len, max_sample_id_len))) {
+  g_lgen_id_buf_stride = CACHEALIGN(max_sample_id_len);
+  g_lgen_id_bufs = (char*)wkspace_alloc(thread_ct * g_lgen_id_buf_stride);
+  if (!g_lgen_id_bufs) {
     goto lgen_to_bed_ret_NOMEM;
   }
   marker_allele_ptrs = (char**)wkspace_alloc(2 * marker_ct * sizeof(char*));
@@ -6547,6 +7441,16 @@ int32_t lgen_to_bed(char* lgen_namebuf, char* outname, char* outname_end, int32_
   } else {
     memset(writebuf, 0x55, marker_ct * sample_ct4);
   }
+  // line bookkeeping gets at most 1/4 of the remaining space
+  batch_line_max = wkspace_left / (4 * (sizeof(intptr_t) + sizeof(Lgen_line)));
+  if (batch_line_max > LGEN_BATCH_LINES) {
+    batch_line_max = LGEN_BATCH_LINES;
+  }
+  line_starts = (char**)wkspace_alloc(batch_line_max * sizeof(intptr_t));
+  lines = (Lgen_line*)wkspace_alloc(batch_line_max * sizeof(Lgen_line));
+  if ((!line_starts) || (!lines)) {
+    goto lgen_to_bed_ret_NOMEM;
+  }
   loadbuf_size = wkspace_left;
   if (loadbuf_size > MAXLINEBUFLEN) {
     loadbuf_size = MAXLINEBUFLEN;
@@ -6554,6 +7458,7 @@ int32_t lgen_to_bed(char* lgen_namebuf, char* outname, char* outname_end, int32_
     goto lgen_to_bed_ret_NOMEM;
   }
   loadbuf = (char*)wkspace_base;
+  loadbuf_end = &(loadbuf[loadbuf_size]);
   loadbuf[loadbuf_size - 1] = ' ';
   if (lgen_modifier & LGEN_REFERENCE) {
     if (fopen_checked(&infile, lgen_reference_fname, "r")) {
@@ -6580,9 +7485,9 @@ int32_t lgen_to_bed(char* lgen_namebuf, char* outname, char* outname_end, int32_
 	goto lgen_to_bed_ret_INVALID_FORMAT_2;
       }
       a1len = strlen_se(cptr);
-      ii = bsearch_str(cptr, a1len, marker_ids, max_marker_id_len, marker_ct);
-      if (ii != -1) {
-	marker_idx = marker_id_map[(uint32_t)ii];
+      marker_uidx = id_htable_find(cptr, a1len, marker_id_htable, marker_id_htable_size, marker_ids, max_marker_id_len);
+      if (marker_uidx != 0xffffffffU) {
+	marker_idx = marker_uidx_to_idx[marker_uidx];
 	if (marker_allele_ptrs[2 * marker_idx + 1]) {
 	  cptr[a1len] = '\0';
 	  LOGPREPRINTFWW("Error: Duplicate variant ID '%s' in .ref file.\n", cptr);
@@ -6646,34 +7551,110 @@ int32_t lgen_to_bed(char* lgen_namebuf, char* outname, char* outname_end, int32_
   fflush(stdout);
   lgen_next_thresh = lgen_size / 100;
   pct = 0;
-  if (!lgen_allele_count) {
-    line_idx = 0;
-    while (fgets(loadbuf, loadbuf_size, infile)) {
-      line_idx++;
+  g_lgen_line_starts = line_starts;
+  g_lgen_lines = lines;
+  g_lgen_sample_ids = sample_ids;
+  g_lgen_max_sample_id_len = max_sample_id_len;
+  g_lgen_sample_id_htable = sample_id_htable;
+  g_lgen_sample_id_htable_size = sample_id_htable_size;
+  g_lgen_marker_ids = marker_ids;
+  g_lgen_max_marker_id_len = max_marker_id_len;
+  g_lgen_marker_id_htable = marker_id_htable;
+  g_lgen_marker_id_htable_size = marker_id_htable_size;
+  g_lgen_marker_uidx_to_idx = marker_uidx_to_idx;
+  g_lgen_allele_count = lgen_allele_count;
+  // Lines are loaded in batches; tokenizing and ID lookup are farmed out to
+  // worker threads, and the results are then applied in file order.
+  line_idx = 0;
+  carry_ptr = NULL;
+  do {
+    line_ct = 0;
+    textptr = loadbuf;
+    if (carry_ptr) {
+      // last line of the previous batch didn't fit in the remaining space
+      ulii = strlen(carry_ptr);
+      memmove(loadbuf, carry_ptr, ulii + 1);
+      carry_ptr = NULL;
+      loadbuf[loadbuf_size - 1] = ' ';
+      if (loadbuf[ulii - 1] != '\n') {
+	if (!fgets(&(loadbuf[ulii]), loadbuf_size - ulii, infile)) {
+	  if (ferror(infile)) {
+	    goto lgen_to_bed_ret_READ_FAIL;
+	  }
+	}
+	if (!loadbuf[loadbuf_size - 1]) {
+	  line_idx++;
+	  if (loadbuf_size == MAXLINEBUFLEN) {
+	    goto lgen_to_bed_ret_LONG_LINE;
+	  }
+	  goto lgen_to_bed_ret_NOMEM;
+	}
+      }
+      line_starts[line_ct++] = loadbuf;
+      textptr = &(loadbuf[strlen(loadbuf) + 1]);
+    }
+    while ((line_ct < batch_line_max) && (((uintptr_t)(loadbuf_end - textptr)) >= MAXLINELEN)) {
+      if (!fgets(textptr, (uintptr_t)(loadbuf_end - textptr), infile)) {
+	break;
+      }
       if (!loadbuf[loadbuf_size - 1]) {
+	if (line_ct) {
+	  carry_ptr = textptr;
+	  break;
+	}
+	line_idx++;
 	if (loadbuf_size == MAXLINEBUFLEN) {
 	  goto lgen_to_bed_ret_LONG_LINE;
 	}
 	goto lgen_to_bed_ret_NOMEM;
       }
-      cptr = skip_initial_spaces(loadbuf);
-      if (is_eoln_kns(*cptr)) {
-	continue;
+      line_starts[line_ct++] = textptr;
+      textptr = &(textptr[strlen(textptr) + 1]);
+    }
+    if (line_ct) {
+      ulii = (line_ct + LGEN_CLAIM_LINES - 1) / LGEN_CLAIM_LINES;
+      uii = (ulii < thread_ct)? ulii : thread_ct;
+      ws_ranges_init(uii, 0, line_ct);
+      if (spawn_threads(threads, &lgen_to_bed_thread, uii)) {
+	goto lgen_to_bed_ret_THREAD_CREATE_FAIL;
       }
-      if (bsearch_read_fam_indiv(id_buf, sorted_sample_ids, max_sample_id_len, sample_ct, cptr, &cptr3, &ii)) {
+      lgen_to_bed_thread((void*)0);
+      join_threads(threads, uii);
+    }
+    for (cur_line = lines; cur_line < &(lines[line_ct]); cur_line++) {
+      line_idx++;
+      if (cur_line->status != LGEN_LINE_OK) {
+	if (cur_line->status == LGEN_LINE_BLANK) {
+	  continue;
+	} else if (cur_line->status == LGEN_LINE_MISSING_IID) {
+	  goto lgen_to_bed_ret_MISSING_IID;
+	}
 	goto lgen_to_bed_ret_MISSING_TOKENS;
       }
-      if (ii == -1) {
-	goto lgen_to_bed_ret_MISSING_IID;
-      }
-      sample_idx = sample_id_map[(uint32_t)ii];
-      cptr4 = token_end(cptr3);
-      if (!cptr4) {
-	goto lgen_to_bed_ret_MISSING_TOKENS;
+      sample_idx = cur_line->sample_idx;
+      marker_uidx = cur_line->marker_uidx;
+      a1ptr = cur_line->a1ptr;
+      if (lgen_allele_count) {
+	if (marker_uidx != 0xffffffffU) {
+	  marker_idx = cur_line->marker_idx;
+	  a1len = strlen_se(a1ptr);
+	  ucc = (unsigned char)(*a1ptr);
+	  if ((a1len != 1) || (ucc < 48) || (ucc > 50)) {
+	    uii = 1;
+	  } else {
+	    uii = ucc - 48;
+	    if (uii) {
+	      uii++;
+	    }
+	  }
+	  ulii = marker_idx * sample_ct4 + (sample_idx / 4);
+	  ujj = (sample_idx % 4) * 2;
+	  writebuf[ulii] = (writebuf[ulii] & (~(3 << ujj))) | (uii << ujj);
+	}
+	continue;
       }
-      a1ptr = skip_initial_spaces(cptr4);
-      sptr = token_end(a1ptr);
-      a2ptr = next_token(sptr);
+      sptr = cur_line->sptr;
+      a2ptr = cur_line->a2ptr;
       if (compound_genotypes == 1) {
 	if (no_more_tokens_kns(a2ptr)) {
 	  compound_genotypes = 2;
@@ -6700,9 +7681,8 @@ int32_t lgen_to_bed(char* lgen_namebuf, char* outname, char* outname_end, int32_
 	*a2ptr = a1ptr[1];
 	a2len = 1;
       }
-      ii = bsearch_str(cptr3, (uintptr_t)(cptr4 - cptr3), marker_ids, max_marker_id_len, marker_ct);
-      if (ii != -1) {
-	marker_idx = marker_id_map[(uint32_t)ii];
+      if (marker_uidx != 0xffffffffU) {
+	marker_idx = cur_line->marker_idx;
 	sptr = marker_allele_ptrs[2 * marker_idx + 1]; // existing A2
 	a1ptr[a1len] = '\0';
 	a2ptr[a2len] = '\0';
@@ -6774,75 +7754,18 @@ int32_t lgen_to_bed(char* lgen_namebuf, char* outname, char* outname_end, int32_
 	ujj = (sample_idx % 4) * 2;
 	writebuf[ulii] = (writebuf[ulii] & (~(3 << ujj))) | (uii << ujj);
       }
-      if (ftello(infile) >= lgen_next_thresh) {
-	uii = (ftello(infile) * 100) / lgen_size;
-	if (pct >= 10) {
-	  putchar('\b');
-	}
-	printf("\b\b%u%%", uii);
-	fflush(stdout);
-	pct = uii;
-	lgen_next_thresh = ((pct + 1) * lgen_size) / 100;
-      }
     }
-  } else {
-    line_idx = 0;
-    while (fgets(loadbuf, loadbuf_size, infile)) {
-      line_idx++;
-      if (!loadbuf[loadbuf_size - 1]) {
-	if (loadbuf_size == MAXLINEBUFLEN) {
-	  goto lgen_to_bed_ret_LONG_LINE;
-	}
-	goto lgen_to_bed_ret_NOMEM;
-      }
-      cptr = skip_initial_spaces(loadbuf);
-      if (is_eoln_kns(*cptr)) {
-	continue;
-      }
-      if (bsearch_read_fam_indiv(id_buf, sorted_sample_ids, max_sample_id_len, sample_ct, cptr, &cptr3, &ii)) {
-	goto lgen_to_bed_ret_MISSING_TOKENS;
-      }
-      if (ii == -1) {
-	goto lgen_to_bed_ret_MISSING_IID;
-      }
-      sample_idx = sample_id_map[(uint32_t)ii];
-      cptr4 = token_end(cptr3);
-      if (!cptr4) {
-	goto lgen_to_bed_ret_MISSING_TOKENS;
-      }
-      a1ptr = skip_initial_spaces(cptr4);
-      if (no_more_tokens_kns(a1ptr)) {
-	goto lgen_to_bed_ret_MISSING_TOKENS;
-      }
-      ii = bsearch_str(cptr3, (uintptr_t)(cptr4 - cptr3), marker_ids, max_marker_id_len, marker_ct);
-      if (ii != -1) {
-	marker_idx = marker_id_map[(uint32_t)ii];
-	a1len = strlen_se(a1ptr);
-	ucc = (unsigned char)(*a1ptr);
-	if ((a1len != 1) || (ucc < 48) || (ucc > 50)) {
-	  uii = 1;
-	} else {
-	  uii = ucc - 48;
-	  if (uii) {
-	    uii++;
-	  }
-	}
-	ulii = marker_idx * sample_ct4 + (sample_idx / 4);
-	ujj = (sample_idx % 4) * 2;
-	writebuf[ulii] = (writebuf[ulii] & (~(3 << ujj))) | (uii << ujj);
-      }
-      if (ftello(infile) >= lgen_next_thresh) {
-	uii = (ftello(infile) * 100) / lgen_size;
-	if (pct >= 10) {
-	  putchar('\b');
-	}
-	printf("\b\b%u%%", uii);
-	fflush(stdout);
-	pct = uii;
-	lgen_next_thresh = ((pct + 1) * lgen_size) / 100;
+    if (ftello(infile) >= lgen_next_thresh) {
+      uii = (ftello(infile) * 100) / lgen_size;
+      if (pct >= 10) {
+	putchar('\b');
       }
+      printf("\b\b%u%%", uii);
+      fflush(stdout);
+      pct = uii;
+      lgen_next_thresh = ((pct + 1) * lgen_size) / 100;
     }
-  }
+  } while (line_ct);
   if (!feof(infile)) {
     goto lgen_to_bed_ret_READ_FAIL;
   }
@@ -6896,7 +7819,8 @@ int32_t lgen_to_bed(char* lgen_namebuf, char* outname, char* outname_end, int32_
     if (is_eoln_or_comment(*(skip_initial_spaces(tbuf)))) {
       continue;
     }
-    if (IS_SET(marker_exclude, uii)) {
+    // .map.tmp only contains the variants that passed filters
+    if ((!map_is_unsorted) && IS_SET(marker_exclude, uii)) {
       uii++;
       continue;
     }
@@ -7010,9 +7934,13 @@ int32_t lgen_to_bed(char* lgen_namebuf, char* outname, char* outname_end, int32_
     retval = RET_INVALID_FORMAT;
     break;
   lgen_to_bed_ret_NOT_BIALLELIC:
-    LOGPRINTFWW("Error: Variant '%s' in .lgen file has 3+ different alleles.\n", id_buf);
+    LOGPRINTFWW("Error: Variant '%s' in .lgen file has 3+ different alleles.\n", &(marker_ids[marker_uidx * max_marker_id_len]));
     retval = RET_INVALID_FORMAT;
     break;
+  lgen_to_bed_ret_THREAD_CREATE_FAIL:
+    putchar('\n');
+    retval = RET_THREAD_CREATE_FAIL;
+    break;
   lgen_to_bed_ret_INVALID_CMDLINE:
     retval = RET_INVALID_CMDLINE;
     break;
@@ -7072,42 +8000,281 @@ void transposed_to_bed_print_pct(uint32_t pct) {
   fflush(stdout);
 }
 
-int32_t transposed_to_bed(char* tpedname, char* tfamname, char* outname, char* outname_end, uint64_t misc_flags, Chrom_info* chrom_info_ptr) {
-  unsigned char* wkspace_mark = wkspace_base;
-  FILE* infile = NULL;
-  FILE* bimfile = NULL;
-  FILE* outfile = NULL;
-  char** marker_allele_ptrs = NULL;
-  uintptr_t topsize = 0;
-  uintptr_t sample_ct = 0;
-  uintptr_t line_idx = 0;
-  uint32_t no_extra_cols = 1;
-  int32_t retval = 0;
-  uint32_t pct = 0;
-  uint32_t map_is_unsorted = 0;
-  int64_t last_mapval = 0;
-  uint32_t allele_tot = 0;
-  uintptr_t marker_ct = 0;
-  uintptr_t max_marker_id_len = 0;
-  uintptr_t max_marker_allele_len = 2; // for .bim.tmp reloading
-  const char* missing_geno_ptr = g_missing_geno_ptr;
-  char missing_geno = *missing_geno_ptr;
+#define TPED_BATCH_LINES 4096
+#define TPED_BATCH_TEXT_MAX 67108864
 
-  // We include handling of nonstandard chromosome names here since our own
-  // pipeline requires this.  (To set them to zero, --make-bed must be used
-  // in addition to this autoconverter.)
-  uint32_t allow_extra_chroms = (misc_flags / MISC_ALLOW_EXTRA_CHROMS) & 1;
-  uint32_t orig_zec = chrom_info_ptr->zero_extra_chroms;
+#define TPED_LINE_OK 0
+#define TPED_LINE_MISSING_TOKENS 1
+#define TPED_LINE_HALF_MISSING 2
+#define TPED_LINE_TOO_MANY_ALLELES 3
 
-  // It's unnecessary for now, but we choose to include nice handling of
-  // triallelic and quadallelic sites in this routine.
+typedef struct tped_line_struct {
+  char* text; // NULL = too long for the batch buffer, must be streamed
+  char* major_allele;
+  char* minor_allele;
+  uint32_t status;
+  uint32_t allele_ct;
+  uint32_t extra_cols;
+} Tped_line;
+
+static Tped_line* g_tped_lines;
+static unsigned char* g_tped_rows;
+static unsigned char* g_tped_prewritebufs;
+static uintptr_t g_tped_prewritebuf_stride;
+static uintptr_t g_tped_sample_ct;
+static char g_tped_missing_geno;
+
+static inline uint32_t tped_allele_idx(uint32_t* allele_tot_ptr, char** alleles, uint32_t* alens, uint32_t* allele_cts, char* ss, uint32_t slen) {
+  // update_tped_alleles_and_cts() for a line held entirely in memory: long
+  // alleles point into the line instead of being copied.  Returns 4 on
+  // overflow.
+  uint32_t allele_idx;
+  for (allele_idx = 0; allele_idx < (*allele_tot_ptr); allele_idx++) {
+    if ((slen == alens[allele_idx]) && (!memcmp(alleles[allele_idx], ss, slen))) {
+      allele_cts[allele_idx] += 1;
+      return allele_idx;
+    }
+  }
+  if (allele_idx < 4) {
+    alens[allele_idx] = slen;
+    allele_cts[allele_idx] = 1;
+    *allele_tot_ptr = allele_idx + 1;
+    if (slen < 2) {
+      alleles[allele_idx] = (char*)(&(g_one_char_strs[((unsigned char)(*ss)) * 2]));
+    } else {
+      alleles[allele_idx] = ss;
+    }
+  }
+  return allele_idx;
+}
+
+THREAD_RET_TYPE transposed_to_bed_thread(void* arg) {
+  // Converts the genotype columns of complete .tped lines to .bed rows.  The
+  // main thread still handles the first four columns, and reports errors in
+  // line order.
+  uintptr_t tidx = (uintptr_t)arg;
+  uintptr_t sample_ct = g_tped_sample_ct;
+  uintptr_t sample_ct4 = (sample_ct + 3) / 4;
+  unsigned char* prewritebuf = &(g_tped_prewritebufs[tidx * g_tped_prewritebuf_stride]);
+  char missing_geno = g_tped_missing_geno;
   char* alleles[4];
   char* salleles[4];
   uint32_t alens[4];
   uint32_t allele_cts[4];
   unsigned char writemap[17];
-  uintptr_t max_markers;
-  uintptr_t sample_ct4;
+  Tped_line* cur_line;
+  unsigned char* ucptr;
+  unsigned char* ucptr2;
+  char* bufptr;
+  char* axptr;
+  uintptr_t sample_idx;
+  uint32_t line_idx;
+  uint32_t line_end;
+  uint32_t allele_tot;
+  uint32_t axlen;
+  uint32_t uii;
+  uint32_t ujj;
+  int32_t ii;
+  unsigned char ucc;
+  writemap[16] = 1;
+  while (ws_claim(tidx, 1, &line_idx, &line_end)) {
+    cur_line = &(g_tped_lines[line_idx]);
+    bufptr = cur_line->text;
+    if (!bufptr) {
+      continue;
+    }
+    // header problems are caught by the main thread first
+    cur_line->status = TPED_LINE_MISSING_TOKENS;
+    bufptr = skip_initial_spaces(bufptr);
+    if (is_eoln_kns(*bufptr)) {
+      continue;
+    }
+    bufptr = next_token_mult(bufptr, 4);
+    if (no_more_tokens_kns(bufptr)) {
+      continue;
+    }
+    allele_tot = 0;
+    alleles[0] = NULL;
+    alleles[1] = NULL;
+    alleles[2] = NULL;
+    alleles[3] = NULL;
+    fill_uint_zero(allele_cts, 4);
+    for (sample_idx = 0; sample_idx < sample_ct; sample_idx++) {
+      bufptr = skip_initial_spaces(bufptr);
+      axptr = bufptr;
+      axlen = strlen_se(bufptr);
+      bufptr = &(axptr[axlen]);
+      // null terminator can only mean EOF here
+      if (!(*bufptr)) {
+	goto transposed_to_bed_thread_next;
+      }
+      if ((*axptr != missing_geno) || (axlen != 1)) {
+	uii = tped_allele_idx(&allele_tot, alleles, alens, allele_cts, axptr, axlen);
+	if (uii == 4) {
+	  cur_line->status = TPED_LINE_TOO_MANY_ALLELES;
+	  goto transposed_to_bed_thread_next;
+	}
+      } else {
+	uii = 4;
+      }
+      bufptr = skip_initial_spaces(bufptr);
+      axptr = bufptr;
+      axlen = strlen_se(bufptr);
+      bufptr = &(axptr[axlen]);
+      if ((!(*bufptr)) && ((!axlen) || (sample_idx != sample_ct - 1))) {
+	goto transposed_to_bed_thread_next;
+      }
+      if ((*axptr != missing_geno) || (axlen != 1)) {
+	if (uii == 4) {
+	  cur_line->status = TPED_LINE_HALF_MISSING;
+	  goto transposed_to_bed_thread_next;
+	}
+	ujj = tped_allele_idx(&allele_tot, alleles, alens, allele_cts, axptr, axlen);
+	if (ujj == 4) {
+	  cur_line->status = TPED_LINE_TOO_MANY_ALLELES;
+	  goto transposed_to_bed_thread_next;
+	}
+        prewritebuf[sample_idx] = uii * 4 + ujj;
+      } else {
+	if (uii != 4) {
+	  cur_line->status = TPED_LINE_HALF_MISSING;
+	  goto transposed_to_bed_thread_next;
+	}
+	prewritebuf[sample_idx] = 16;
+      }
+    }
+    bufptr = skip_initial_spaces(bufptr);
+    cur_line->extra_cols = !is_space_or_eoln(*bufptr);
+    cur_line->allele_ct = allele_tot;
+    memcpy(salleles, alleles, 4 * sizeof(intptr_t));
+    for (uii = 1; uii < 4; uii++) {
+      ujj = allele_cts[uii];
+      if (allele_cts[uii - 1] < ujj) {
+	axptr = salleles[uii];
+	ii = uii;
+	do {
+	  ii--;
+	  salleles[((uint32_t)ii) + 1] = salleles[(uint32_t)ii];
+	  allele_cts[((uint32_t)ii) + 1] = allele_cts[(uint32_t)ii];
+	} while (ii && (allele_cts[((uint32_t)ii) - 1] < ujj));
+	salleles[(uint32_t)ii] = axptr;
+	allele_cts[(uint32_t)ii] = ujj;
+      }
+    }
+    for (uii = 0; uii < 4; uii++) {
+      axptr = alleles[uii];
+      ucptr = &(writemap[4 * uii]);
+      if (!axptr) {
+	memset(ucptr, 1, 4);
+      } else if (axptr == salleles[0]) {
+        for (ujj = 0; ujj < 4; ujj++) {
+	  axptr = alleles[ujj];
+	  if (!axptr) {
+	    *ucptr++ = 1;
+	  } else if (axptr == salleles[0]) {
+	    *ucptr++ = 3;
+	  } else if (axptr == salleles[1]) {
+	    *ucptr++ = 2;
+	  } else {
+	    *ucptr++ = 1;
+	  }
+	}
+      } else if (axptr == salleles[1]) {
+	for (ujj = 0; ujj < 4; ujj++) {
+	  axptr = alleles[ujj];
+	  if (!axptr) {
+	    *ucptr++ = 1;
+	  } else if (axptr == salleles[0]) {
+	    *ucptr++ = 2;
+	  } else if (axptr == salleles[1]) {
+	    *ucptr++ = 0;
+	  } else {
+	    *ucptr++ = 1;
+	  }
+	}
+      } else {
+        memset(ucptr, 1, 4);
+      }
+    }
+    uii = sample_ct & (~3U);
+    ucptr = &(g_tped_rows[line_idx * sample_ct4]);
+    for (ujj = 0; ujj < uii; ujj += 4) {
+      *ucptr++ = writemap[prewritebuf[ujj]] | (writemap[prewritebuf[ujj + 1]] << 2) | (writemap[prewritebuf[ujj + 2]] << 4) | (writemap[prewritebuf[ujj + 3]] << 6);
+    }
+    ucc = 0;
+    ucptr2 = &(prewritebuf[uii]);
+    uii = sample_ct % 4;
+    if (uii) {
+      for (ujj = 0; ujj < uii; ujj++) {
+        ucc |= (writemap[*ucptr2++]) << (ujj * 2);
+      }
+      *ucptr = ucc;
+    }
+    // safe to terminate long alleles in place now; they're always followed
+    // by whitespace
+    for (uii = 0; uii < allele_tot; uii++) {
+      if (alens[uii] > 1) {
+	alleles[uii][alens[uii]] = '\0';
+      }
+    }
+    cur_line->major_allele = salleles[0];
+    cur_line->minor_allele = salleles[1];
+    cur_line->status = TPED_LINE_OK;
+  transposed_to_bed_thread_next:
+    ;
+  }
+  THREAD_RETURN;
+}
+
+int32_t transposed_to_bed(char* tpedname, char* tfamname, char* outname, char* outname_end, uint64_t misc_flags, Chrom_info* chrom_info_ptr) {
+  unsigned char* wkspace_mark = wkspace_base;
+  FILE* infile = NULL;
+  FILE* bimfile = NULL;
+  FILE* outfile = NULL;
+  char** marker_allele_ptrs = NULL;
+  uintptr_t topsize = 0;
+  uintptr_t sample_ct = 0;
+  uintptr_t line_idx = 0;
+  uint32_t no_extra_cols = 1;
+  int32_t retval = 0;
+  uint32_t pct = 0;
+  uint32_t map_is_unsorted = 0;
+  int64_t last_mapval = 0;
+  uint32_t allele_tot = 0;
+  uintptr_t marker_ct = 0;
+  uintptr_t max_marker_id_len = 0;
+  uintptr_t max_marker_allele_len = 2; // for .bim.tmp reloading
+  uint32_t thread_ct = g_thread_ct;
+  uintptr_t batch_line_ct = 0;
+  uintptr_t batch_line_idx = 0;
+  const char* missing_geno_ptr = g_missing_geno_ptr;
+  char missing_geno = *missing_geno_ptr;
+
+  // We include handling of nonstandard chromosome names here since our own
+  // pipeline requires this.  (To set them to zero, --make-bed must be used
+  // in addition to this autoconverter.)
+  uint32_t allow_extra_chroms = (misc_flags / MISC_ALLOW_EXTRA_CHROMS) & 1;
+  uint32_t orig_zec = chrom_info_ptr->zero_extra_chroms;
+
+  // It's unnecessary for now, but we choose to include nice handling of
+  // triallelic and quadallelic sites in this routine.
+  char* alleles[4];
+  char* salleles[4];
+  uint32_t alens[4];
+  uint32_t allele_cts[4];
+  unsigned char writemap[17];
+  pthread_t threads[MAX_THREADS];
+  Tped_line* tlines;
+  Tped_line* cur_tline;
+  unsigned char* rows;
+  char* text;
+  char* text_end;
+  char* textptr;
+  int64_t line_start;
+  uintptr_t text_size;
+  uintptr_t batch_line_max;
+  uintptr_t max_markers;
+  uintptr_t sample_ct4;
   uintptr_t sample_idx;
   uintptr_t ulii;
   uint32_t uii;
@@ -7125,6 +8292,7 @@ int32_t transposed_to_bed(char* tpedname, char* tfamname, char* outname, char* o
   char* cptr3;
   char* cptr4;
   char* axptr;
+  char cc;
   uint32_t* chrom_start;
   uint32_t* chrom_id;
   uint32_t axlen;
@@ -7203,6 +8371,36 @@ int32_t transposed_to_bed(char* tpedname, char* tfamname, char* outname, char* o
   if (!allele_buf) {
     goto transposed_to_bed_ret_NOMEM;
   }
+  // Complete lines are loaded in batches, and their genotype columns are
+  // converted by worker threads.  A line too long for the batch buffer falls
+  // back to the streaming loader below.
+  text_size = ((wkspace_left - topsize) / 4) & (~(CACHELINE - ONELU));
+  if (text_size > TPED_BATCH_TEXT_MAX) {
+    text_size = TPED_BATCH_TEXT_MAX;
+  } else if (text_size < MAXLINELEN) {
+    goto transposed_to_bed_ret_NOMEM;
+  }
+  // each genotype column pair occupies at least 4 bytes
+  batch_line_max = text_size / (4 * sample_ct) + 1;
+  if (batch_line_max > TPED_BATCH_LINES) {
+    batch_line_max = TPED_BATCH_LINES;
+  }
+  if (thread_ct > batch_line_max) {
+    thread_ct = batch_line_max;
+  }
+  g_tped_prewritebuf_stride = CACHEALIGN(sample_ct);
+  text = (char*)top_alloc(&topsize, text_size);
+  rows = top_alloc(&topsize, batch_line_max * sample_ct4);
+  tlines = (Tped_line*)top_alloc(&topsize, batch_line_max * sizeof(Tped_line));
+  g_tped_prewritebufs = top_alloc(&topsize, thread_ct * g_tped_prewritebuf_stride);
+  if ((!text) || (!rows) || (!tlines) || (!g_tped_prewritebufs)) {
+    goto transposed_to_bed_ret_NOMEM;
+  }
+  text_end = &(text[text_size]);
+  g_tped_lines = tlines;
+  g_tped_rows = rows;
+  g_tped_sample_ct = sample_ct;
+  g_tped_missing_geno = missing_geno;
   max_markers = (wkspace_left - topsize) / sizeof(int64_t);
   mapvals = (int64_t*)wkspace_base;
   writemap[16] = 1;
@@ -7230,12 +8428,67 @@ int32_t transposed_to_bed(char* tpedname, char* tfamname, char* outname, char* o
   while (1) {
     line_idx++;
     tbuf[MAXLINELEN - 1] = ' ';
-    if (!fgets(tbuf, MAXLINELEN, infile)) {
-      break;
+    if (batch_line_idx == batch_line_ct) {
+      batch_line_ct = 0;
+      batch_line_idx = 0;
+      textptr = text;
+      line_start = ftello(infile);
+      while (batch_line_ct < batch_line_max) {
+	text_end[-1] = ' ';
+	if (!fgets(textptr, (uintptr_t)(text_end - textptr), infile)) {
+	  break;
+	}
+	ulii = strlen(textptr);
+	uii = !text_end[-1];
+	if ((!uii) && (ulii >= MAXLINELEN - 1)) {
+	  // defer to the streaming loader's error reporting if the first four
+	  // fields aren't within MAXLINELEN characters
+	  cc = textptr[MAXLINELEN - 1];
+	  textptr[MAXLINELEN - 1] = '\0';
+	  cptr = skip_initial_spaces(textptr);
+	  uii = is_eoln_kns(*cptr) || no_more_tokens_kns(next_token_mult(cptr, 4));
+	  textptr[MAXLINELEN - 1] = cc;
+	}
+	if (uii) {
+	  if (fseeko(infile, line_start, SEEK_SET)) {
+	    goto transposed_to_bed_ret_READ_FAIL;
+	  }
+	  if (!batch_line_ct) {
+	    tlines[batch_line_ct++].text = NULL;
+	  }
+	  break;
+	}
+	tlines[batch_line_ct++].text = textptr;
+	textptr = &(textptr[ulii + 1]);
+	line_start += ulii;
+	if (((uintptr_t)(text_end - textptr)) < 2) {
+	  break;
+	}
+      }
+      if (!batch_line_ct) {
+	break;
+      }
+      if (tlines[0].text) {
+	uii = (batch_line_ct < thread_ct)? batch_line_ct : thread_ct;
+	ws_ranges_init(uii, 0, batch_line_ct);
+	if (spawn_threads(threads, &transposed_to_bed_thread, uii)) {
+	  goto transposed_to_bed_ret_THREAD_CREATE_FAIL;
+	}
+	transposed_to_bed_thread((void*)0);
+	join_threads(threads, uii);
+      }
+    }
+    cur_tline = &(tlines[batch_line_idx++]);
+    loadbuf = cur_tline->text;
+    if (!loadbuf) {
+      if (!fgets(tbuf, MAXLINELEN, infile)) {
+	break;
+      }
+      loadbuf = tbuf;
     }
     // assume first four fields are within MAXLINELEN characters, but after
     // that, anything goes
-    cptr = skip_initial_spaces(tbuf);
+    cptr = skip_initial_spaces(loadbuf);
     if (is_eoln_kns(*cptr)) {
       if (!tbuf[MAXLINELEN - 1]) {
 	sprintf(logbuf, "Error: Line %" PRIuPTR " of .tped file has excessive whitespace.\n", line_idx);
@@ -7293,6 +8546,9 @@ int32_t transposed_to_bed(char* tpedname, char* tfamname, char* outname, char* o
       goto transposed_to_bed_ret_INVALID_FORMAT_2R;
     }
     if ((!is_set(chrom_info_ptr->chrom_mask, ii)) || (jj < 0)) {
+      if (loadbuf != tbuf) {
+	continue;
+      }
       cptr2 = cptr4;
       goto transposed_to_bed_nextline;
     }
@@ -7321,6 +8577,26 @@ int32_t transposed_to_bed(char* tpedname, char* tfamname, char* outname, char* o
     if (fwrite_checked(cptr, cptr2 - cptr, bimfile)) {
       goto transposed_to_bed_ret_WRITE_FAIL;
     }
+    if (loadbuf != tbuf) {
+      if (cur_tline->status != TPED_LINE_OK) {
+	if (cur_tline->status == TPED_LINE_HALF_MISSING) {
+	  goto transposed_to_bed_ret_HALF_MISSING;
+	} else if (cur_tline->status == TPED_LINE_TOO_MANY_ALLELES) {
+	  retval = RET_INVALID_FORMAT;
+	  goto transposed_to_bed_ret_TOO_MANY_ALLELES;
+	}
+	goto transposed_to_bed_ret_MISSING_TOKENS;
+      }
+      if (cur_tline->allele_ct > 2) {
+	putchar('\r');
+	LOGPRINTF("Note: Variant %" PRIuPTR " is %sallelic.  Setting rarest alleles to missing.\n", marker_ct - 1, (cur_tline->allele_ct == 4)? "quad" : "tri");
+	transposed_to_bed_print_pct(pct);
+      }
+      fwrite(&(rows[(batch_line_idx - 1) * sample_ct4]), 1, sample_ct4, outfile);
+      salleles[0] = cur_tline->major_allele;
+      salleles[1] = cur_tline->minor_allele;
+      goto transposed_to_bed_write_alleles;
+    }
     cptr2 = cptr4;
     alleles[0] = NULL;
     alleles[1] = NULL;
@@ -7515,6 +8791,7 @@ int32_t transposed_to_bed(char* tpedname, char* tfamname, char* outname, char* o
       *ucptr = ucc;
     }
     fwrite(writebuf, 1, sample_ct4, outfile);
+  transposed_to_bed_write_alleles:
     if (!salleles[1]) {
       putc(missing_geno, bimfile);
     } else {
@@ -7543,6 +8820,15 @@ int32_t transposed_to_bed(char* tpedname, char* tfamname, char* outname, char* o
     if (putc_checked('\n', bimfile)) {
       goto transposed_to_bed_ret_WRITE_FAIL;
     }
+    if (loadbuf != tbuf) {
+      if (no_extra_cols && cur_tline->extra_cols) {
+	no_extra_cols = 0;
+	putchar('\r');
+	logprint("Warning: Extra columns in .tped file.  Ignoring.\n");
+	transposed_to_bed_print_pct(pct);
+      }
+      continue;
+    }
     if (no_extra_cols) {
       cptr2 = skip_initial_spaces(cptr2);
       while (cptr2 == &(tbuf[MAXLINELEN - 1])) {
@@ -7772,6 +9058,10 @@ int32_t transposed_to_bed(char* tpedname, char* tfamname, char* outname, char* o
     LOGPRINTF("Error: More than four alleles at variant %" PRIuPTR ".\n", marker_ct - 1);
     // retval already set
     break;
+  transposed_to_bed_ret_THREAD_CREATE_FAIL:
+    putchar('\n');
+    retval = RET_THREAD_CREATE_FAIL;
+    break;
   }
  transposed_to_bed_ret_1:
   chrom_info_ptr->zero_extra_chroms = orig_zec;
@@ -7974,58 +9264,1040 @@ uint32_t vcf_gp_diploid_invalid(char* bufptr, char* bufptr2, double vcf_min_gp,
 // than this)
 #define MAX_VCF_ALT 65534
 
-int32_t vcf_to_bed(char* vcfname, char* outname, char* outname_end, int32_t missing_pheno, uint64_t misc_flags, char* const_fid, char id_delim, char vcf_idspace_to, double vcf_min_qual, char* vcf_filter_exceptions_flattened, double vcf_min_gq, double vcf_min_gp, uint32_t vcf_half_call, Chrom_info* chrom_info_ptr) {
-  unsigned char* wkspace_mark = wkspace_base;
-  gzFile gz_infile = NULL;
-  FILE* outfile = NULL;
-  FILE* bimfile = NULL;
-  FILE* skip3file = NULL;
-  char* sorted_fexcepts = NULL;
-  uintptr_t line_idx = 0;
-  uintptr_t fexcept_ct = 0;
-  uintptr_t max_fexcept_len = 5;
-  uintptr_t sample_ct = 0;
-  uint32_t double_id = (misc_flags / MISC_DOUBLE_ID) & 1;
-  uint32_t check_qual = (vcf_min_qual != -1);
-  uint32_t allow_extra_chroms = (misc_flags / MISC_ALLOW_EXTRA_CHROMS) & 1;
-  uint32_t biallelic_only = (misc_flags / MISC_BIALLELIC_ONLY) & 1;
-  uint32_t biallelic_strict = (misc_flags / MISC_BIALLELIC_ONLY_STRICT) & 1;
-  uint32_t skip3_list = (misc_flags / MISC_BIALLELIC_ONLY_LIST) & 1;
-  uint32_t marker_ct = 0;
-  uint32_t marker_skip_ct = 0;
-  uint32_t gq_field_pos = 0;
-  uint32_t gp_field_pos = 0;
-  uint32_t vcf_half_call_explicit_error = (vcf_half_call == VCF_HALF_CALL_ERROR);
-  int32_t retval = 0;
-  char missing_geno = *g_missing_geno_ptr;
-  uint32_t* vcf_alt_cts;
-  char* loadbuf;
-  char* bufptr;
-  char* bufptr2;
-  char* ref_allele_ptr;
-  char* delimiter_ptr;
-  char* gq_scan_ptr;
+// vcf_gt_to_bed() return values other than the selected alt allele index
+#define VCF_GT_SKIP3 0
+#define VCF_GT_MISSING_TOKENS (MAX_VCF_ALT + 1)
+#define VCF_GT_INVALID_GT (MAX_VCF_ALT + 2)
+#define VCF_GT_HALF_CALL_ERROR (MAX_VCF_ALT + 3)
+#define VCF_GT_INVALID_GP (MAX_VCF_ALT + 4)
+
+// BGZF blocks read per thread in each decompression round
+#define VCF_BGZF_BLOCKS_PER_THREAD 64
+
+// minimum uncompressed bytes requested per read; scaled up so each thread
+// normally gets a few dozen lines, and extended when a single line is longer
+#define VCF_FILL_SIZE 0x1000000
+
+#define VCF_LINE_BATCH_MAX 65536
+
+typedef struct {
   char* chrom_ptr;
-  char* marker_id;
   char* pos_str;
+  char* marker_id;
+  char* ref_allele_ptr;
   char* alt_alleles;
+  // NULL if the variant was skipped before the genotype columns
+  char* geno_start;
+  uintptr_t geno_len;
+  uintptr_t line_idx;
+  uint32_t chrom_len;
+  uint32_t marker_id_len;
+  uint32_t alt_ct;
+  uint32_t gq_field_pos;
+  uint32_t gp_field_pos;
+  uint32_t result;
+} Vcf_line;
+
+uint32_t vcf_gt_to_bed(char* bufptr, uintptr_t sample_ct, uint32_t alt_ct, uint32_t gq_field_pos, uint32_t gp_field_pos, double vcf_min_gq, double vcf_min_gp, uint32_t vcf_half_call, uint32_t biallelic_only, uintptr_t* base_bitfields, uint32_t* vcf_alt_cts, unsigned char* bed_record) {
+  // Converts the genotype columns of one .vcf line to a .bed record.  Returns
+  // the index of the alt allele that was kept, or one of the VCF_GT_ codes.
+  // base_bitfields must have space for 10 * sample_ctv2 words, and vcf_alt_cts
+  // for MAX_VCF_ALT entries.
+  uintptr_t sample_ctl2 = (sample_ct + BITCT2 - 1) / BITCT2;
+  uintptr_t sample_ctv2 = 2 * ((sample_ct + BITCT - 1) / BITCT);
+  uintptr_t final_mask = (~ZEROLU) >> (2 * ((0x7fffffe0 - sample_ct) % BITCT2));
+  char* bufptr2;
+  char* gq_scan_ptr;
   char* geno_start;
-  uintptr_t* base_bitfields;
   uintptr_t* alt_bitfield;
   uintptr_t* ref_ptr;
   uintptr_t* alt_ptr;
-  uintptr_t final_mask;
-  uintptr_t sample_ctl2;
-  uintptr_t sample_ctv2;
-  uintptr_t sample_ct4;
   uintptr_t sample_idx;
-  uintptr_t loadbuf_size;
-  uintptr_t slen;
   uintptr_t ulii;
   uintptr_t uljj;
   uintptr_t ulkk;
   uintptr_t alt_allele_idx;
   double dxx;
+  uint32_t alt_idx;
+  uint32_t uii;
+  uint32_t ujj;
+  uint32_t ukk;
+  char cc;
+  if (alt_ct < 10) {
+    // slightly faster parsing for the usual case
+    fill_ulong_zero(base_bitfields, (alt_ct + 1) * sample_ctv2);
+    if ((!biallelic_only) || (alt_ct == 1)) {
+      for (sample_idx = 0; sample_idx < sample_ct; sample_idx++, bufptr = &(bufptr2[1])) {
+	bufptr2 = strchr(bufptr, '\t');
+	if (!bufptr2) {
+	  if (sample_idx != sample_ct - 1) {
+	    return VCF_GT_MISSING_TOKENS;
+	  }
+	  bufptr2 = &(bufptr[strlen_se(bufptr)]);
+	}
+	uii = (unsigned char)(*bufptr) - '0';
+	// time to provide proper support for VCF import; that means, among
+	// other things, providing a useful error message instead of
+	// segfaulting on an invalid GT field, to help other tool
+	// developers.
+	if (uii <= 9) {
+	  // no GQ field with ./. calls, so this check cannot occur earlier
+	  if (gq_field_pos) {
+	    // to test: does splitting this off in an entirely separate loop
+	    // noticeably speed up common case parsing?  I hope not--this is
+	    // a predictable branch--but one can never be too paranoid about
+	    // this sort of performance leak when hundreds of GB are
+	    // involved...
+	    gq_scan_ptr = bufptr;
+	    for (ujj = 0; ujj < gq_field_pos; ujj++) {
+	      gq_scan_ptr = (char*)memchr(gq_scan_ptr, ':', (uintptr_t)(bufptr2 - gq_scan_ptr));
+	      if (!gq_scan_ptr) {
+		// non-GT fields are allowed to be missing
+		goto vcf_gt_to_bed_missing_gq_1;
+	      }
+	      gq_scan_ptr++;
+	    }
+	    if ((!scan_double(gq_scan_ptr, &dxx)) && (dxx < vcf_min_gq)) {
+	      continue;
+	    }
+	  }
+	vcf_gt_to_bed_missing_gq_1:
+	  cc = bufptr[1];
+	  if ((cc != '/') && (cc != '|')) {
+	    // haploid
+	  vcf_gt_to_bed_haploid_1:
+	    if (gp_field_pos) {
+	      if (vcf_gp_invalid(bufptr, bufptr2, vcf_min_gp, gp_field_pos, uii, &ukk)) {
+		if (ukk) {
+		  return VCF_GT_INVALID_GP;
+		}
+		continue;
+	      }
+	    }
+	    set_bit_ul(&(base_bitfields[uii * sample_ctv2]), sample_idx * 2 + 1);
+	  } else {
+	    cc = bufptr[3];
+	    if (((cc != '/') && (cc != '|')) || (bufptr[4] == '.')) {
+	      // code triploids, etc. as missing
+	      // might want to subject handling of 0/0/. to --vcf-half-call
+	      // control
+	      ujj = ((unsigned char)bufptr[2]) - '0';
+	      if (ujj > 9) {
+		if (ujj != (uint32_t)(((unsigned char)'.') - '0')) {
+		  return VCF_GT_INVALID_GT;
+		}
+		if (!vcf_half_call) {
+		  return VCF_GT_HALF_CALL_ERROR;
+		} else if (vcf_half_call == VCF_HALF_CALL_HAPLOID) {
+		  goto vcf_gt_to_bed_haploid_1;
+		}
+	      } else {
+		if (gp_field_pos) {
+		  if (vcf_gp_diploid_invalid(bufptr, bufptr2, vcf_min_gp, gp_field_pos, uii, ujj, &ukk)) {
+		    if (ukk) {
+		      return VCF_GT_INVALID_GP;
+		    }
+		    continue;
+		  }
+		}
+		set_bit_ul(&(base_bitfields[uii * sample_ctv2]), sample_idx * 2);
+		base_bitfields[ujj * sample_ctv2 + sample_idx / BITCT2] += ONELU << (2 * (sample_idx % BITCT2));
+	      }
+	    }
+	  }
+	} else if (uii != (uint32_t)(((unsigned char)'.') - '0')) {
+	  return VCF_GT_INVALID_GT;
+	}
+      }
+      alt_allele_idx = 1;
+      if (alt_ct > 1) {
+	ulii = popcount2_longs(&(base_bitfields[sample_ctv2]), sample_ctl2);
+	for (alt_idx = 2; alt_idx <= alt_ct; alt_idx++) {
+	  uljj = popcount2_longs(&(base_bitfields[sample_ctv2 * alt_idx]), sample_ctl2);
+	  if (uljj > ulii) {
+	    ulii = uljj;
+	    alt_allele_idx = alt_idx;
+	  }
+	}
+      }
+    } else {
+      // expect early termination in this case
+      alt_allele_idx = 0;
+      for (sample_idx = 0; sample_idx < sample_ct; sample_idx++, bufptr = &(bufptr2[1])) {
+	bufptr2 = strchr(bufptr, '\t');
+	if (!bufptr2) {
+	  if (sample_idx != sample_ct - 1) {
+	    return VCF_GT_MISSING_TOKENS;
+	  }
+	  bufptr2 = &(bufptr[strlen_se(bufptr)]);
+	}
+	uii = (unsigned char)(*bufptr) - '0';
+	if (uii && (uii != alt_allele_idx)) {
+	  if (uii == (uint32_t)(((unsigned char)'.') - '0')) {
+	    continue;
+	  } else if (uii > 9) {
+	    return VCF_GT_INVALID_GT;
+	  } else if (alt_allele_idx) {
+	    return VCF_GT_SKIP3;
+	  }
+	  alt_allele_idx = uii;
+	}
+	if (gq_field_pos) {
+	  gq_scan_ptr = bufptr;
+	  for (ujj = 0; ujj < gq_field_pos; ujj++) {
+	    gq_scan_ptr = (char*)memchr(gq_scan_ptr, ':', (uintptr_t)(bufptr2 - gq_scan_ptr));
+	    if (!gq_scan_ptr) {
+	      goto vcf_gt_to_bed_missing_gq_2;
+	    }
+	    gq_scan_ptr++;
+	  }
+	  if ((!scan_double(gq_scan_ptr, &dxx)) && (dxx < vcf_min_gq)) {
+	    continue;
+	  }
+	}
+      vcf_gt_to_bed_missing_gq_2:
+	cc = bufptr[1];
+	if ((cc != '/') && (cc != '|')) {
+	vcf_gt_to_bed_haploid_2:
+	  if (gp_field_pos) {
+	    if (vcf_gp_invalid(bufptr, bufptr2, vcf_min_gp, gp_field_pos, uii, &ukk)) {
+	      if (ukk) {
+		return VCF_GT_INVALID_GP;
+	      }
+	      continue;
+	    }
+	  }
+	  set_bit_ul(&(base_bitfields[uii * sample_ctv2]), sample_idx * 2 + 1);
+	} else {
+	  cc = bufptr[3];
+	  if (((cc != '/') && (cc != '|')) || (bufptr[4] == '.')) {
+	    ujj = ((unsigned char)bufptr[2]) - '0';
+	    if (ujj && (ujj != alt_allele_idx)) {
+	      if (ujj == (uint32_t)(((unsigned char)'.') - '0')) {
+		if (!vcf_half_call) {
+		  return VCF_GT_HALF_CALL_ERROR;
+		} else if (vcf_half_call == VCF_HALF_CALL_HAPLOID) {
+		  goto vcf_gt_to_bed_haploid_2;
+		}
+		continue;
+	      } else if (ujj > 9) {
+		return VCF_GT_INVALID_GT;
+	      } else if (alt_allele_idx) {
+		return VCF_GT_SKIP3;
+	      }
+	      alt_allele_idx = ujj;
+	    }
+	    if (gp_field_pos) {
+	      if (vcf_gp_diploid_invalid(bufptr, bufptr2, vcf_min_gp, gp_field_pos, uii, ujj, &ukk)) {
+		if (ukk) {
+		  return VCF_GT_INVALID_GP;
+		}
+		continue;
+	      }
+	    }
+	    set_bit_ul(&(base_bitfields[uii * sample_ctv2]), sample_idx * 2);
+	    base_bitfields[ujj * sample_ctv2 + sample_idx / BITCT2] += ONELU << (2 * (sample_idx % BITCT2));
+	  }
+	}
+      }
+      if (!alt_allele_idx) {
+	alt_allele_idx = 1;
+      }
+    }
+    alt_bitfield = &(base_bitfields[alt_allele_idx * sample_ctv2]);
+  } else {
+    // bleah, multi-digit genotype codes
+    // two-pass read: determine most common alt allele, then actually load it
+    fill_ulong_zero(base_bitfields, 2 * sample_ctv2);
+    alt_bitfield = &(base_bitfields[sample_ctv2]);
+    fill_uint_zero(vcf_alt_cts, alt_ct);
+    geno_start = bufptr;
+    for (sample_idx = 0; sample_idx < sample_ct; sample_idx++, bufptr = &(bufptr2[1])) {
+      bufptr2 = strchr(bufptr, '\t');
+      if (!bufptr2) {
+	if (sample_idx != sample_ct - 1) {
+	  return VCF_GT_MISSING_TOKENS;
+	}
+	bufptr2 = &(bufptr[strlen_se(bufptr)]);
+      }
+      uii = (unsigned char)(*bufptr) - '0';
+      if (uii <= 9) {
+	if (gq_field_pos) {
+	  gq_scan_ptr = bufptr;
+	  for (ujj = 0; ujj < gq_field_pos; ujj++) {
+	    gq_scan_ptr = (char*)memchr(gq_scan_ptr, ':', (uintptr_t)(bufptr2 - gq_scan_ptr));
+	    if (!gq_scan_ptr) {
+	      goto vcf_gt_to_bed_missing_gq_3;
+	    }
+	    gq_scan_ptr++;
+	  }
+	  if ((!scan_double(gq_scan_ptr, &dxx)) && (dxx < vcf_min_gq)) {
+	    continue;
+	  }
+	}
+      vcf_gt_to_bed_missing_gq_3:
+	while (1) {
+	  ujj = ((unsigned char)(*(++bufptr))) - 48;
+	  if (ujj > 9) {
+	    break;
+	  }
+	  uii = uii * 10 + ujj;
+	}
+	// '/' = ascii 47, '|' = ascii 124
+	if ((ujj != 0xffffffffU) && (ujj != 76)) {
+	  // haploid, count 2x
+	vcf_gt_to_bed_haploid_3:
+	  if (gp_field_pos) {
+	    if (vcf_gp_invalid(bufptr, bufptr2, vcf_min_gp, gp_field_pos, uii, &ukk)) {
+	      if (ukk) {
+		return VCF_GT_INVALID_GP;
+	      }
+	      continue;
+	    }
+	  }
+	  if (!uii) {
+	    set_bit_ul(base_bitfields, sample_idx * 2 + 1);
+	  } else {
+	    vcf_alt_cts[uii - 1] += 2;
+	  }
+	} else {
+	  ujj = (unsigned char)(*(++bufptr)) - '0';
+	  if (ujj > 9) {
+	    if (ujj == (uint32_t)(((unsigned char)'.') - '0')) {
+	      if (!vcf_half_call) {
+		return VCF_GT_HALF_CALL_ERROR;
+	      } else if (vcf_half_call == VCF_HALF_CALL_HAPLOID) {
+		goto vcf_gt_to_bed_haploid_3;
+	      } else {
+		continue;
+	      }
+	    }
+	    return VCF_GT_INVALID_GT;
+	  }
+	  while (1) {
+	    ukk = ((unsigned char)(*(++bufptr))) - 48;
+	    if (ukk > 9) {
+	      break;
+	    }
+	    ujj = ujj * 10 + ukk;
+	  }
+	  if (((ukk != 0xffffffffU) && (ukk != 76)) || (bufptr[1] == '.')) {
+	    // diploid; triploid+ skipped
+	    if (gp_field_pos) {
+	      if (vcf_gp_diploid_invalid(bufptr, bufptr2, vcf_min_gp, gp_field_pos, uii, ujj, &ukk)) {
+		if (ukk) {
+		  return VCF_GT_INVALID_GP;
+		}
+		continue;
+	      }
+	    }
+	    if (!uii) {
+	      set_bit_ul(base_bitfields, sample_idx * 2);
+	    } else {
+	      vcf_alt_cts[uii - 1] += 1;
+	    }
+	    if (!ujj) {
+	      base_bitfields[sample_idx / BITCT2] += ONELU << (2 * (sample_idx % BITCT2));
+	    } else {
+	      vcf_alt_cts[ujj - 1] += 1;
+	    }
+	  }
+	}
+      } else if (uii != (uint32_t)(((unsigned char)'.') - '0')) {
+	return VCF_GT_INVALID_GT;
+      }
+    }
+    alt_allele_idx = 0;
+    uii = vcf_alt_cts[0];
+    for (alt_idx = 1; alt_idx < alt_ct; alt_idx++) {
+      ujj = vcf_alt_cts[alt_idx];
+      if (biallelic_only && ujj && uii) {
+	return VCF_GT_SKIP3;
+      }
+      if (ujj > uii) {
+	alt_allele_idx = alt_idx;
+	uii = vcf_alt_cts[alt_idx];
+      }
+    }
+    alt_allele_idx++;
+    bufptr = geno_start;
+    for (sample_idx = 0; sample_idx < sample_ct; sample_idx++, bufptr = &(bufptr2[1])) {
+      bufptr2 = strchr(bufptr, '\t');
+      if (!bufptr2) {
+	bufptr2 = &(bufptr[strlen_se(bufptr)]);
+      }
+      if (*bufptr == '.') {
+	// validated on first pass
+	continue;
+      }
+      if (gq_field_pos) {
+	gq_scan_ptr = bufptr;
+	for (ujj = 0; ujj < gq_field_pos; ujj++) {
+	  gq_scan_ptr = (char*)memchr(gq_scan_ptr, ':', (uintptr_t)(bufptr2 - gq_scan_ptr));
+	  gq_scan_ptr++;
+	}
+	if ((!scan_double(gq_scan_ptr, &dxx)) && (dxx < vcf_min_gq)) {
+	  continue;
+	}
+      }
+      uii = (unsigned char)(*bufptr) - '0';
+      while (1) {
+	ujj = ((unsigned char)(*(++bufptr))) - 48;
+	if (ujj > 9) {
+	  break;
+	}
+	uii = uii * 10 + ujj;
+      }
+      if ((ujj != 0xffffffffU) && (ujj != 76)) {
+	if (uii == alt_allele_idx) {
+	vcf_gt_to_bed_haploid_4:
+	  if (vcf_gp_invalid(bufptr, bufptr2, vcf_min_gp, gp_field_pos, uii, &ukk)) {
+	    // no need for ukk check since already validated
+	    continue;
+	  }
+	  set_bit_ul(alt_bitfield, sample_idx * 2 + 1);
+	}
+      } else if (*(++bufptr) == '.') {
+	if ((vcf_half_call == VCF_HALF_CALL_HAPLOID) && (uii == alt_allele_idx)) {
+	  goto vcf_gt_to_bed_haploid_4;
+	}
+      } else {
+	ujj = (unsigned char)(*bufptr) - '0';
+	while (1) {
+	  ukk = ((unsigned char)(*(++bufptr))) - 48;
+	  if (ukk > 9) {
+	    break;
+	  }
+	  ujj = ujj * 10 + ukk;
+	}
+	if (((ukk != 0xffffffffU) && (ukk != 76)) || (bufptr[1] == '.')) {
+	  if (vcf_gp_diploid_invalid(bufptr, bufptr2, vcf_min_gp, gp_field_pos, uii, ujj, &ukk)) {
+	    continue;
+	  }
+	  if (uii == alt_allele_idx) {
+	    set_bit_ul(alt_bitfield, sample_idx * 2);
+	  }
+	  if (ujj == alt_allele_idx) {
+	    alt_bitfield[sample_idx / BITCT2] += ONELU << (2 * (sample_idx % BITCT2));
+	  }
+	}
+      }
+    }
+  }
+  ref_ptr = base_bitfields;
+  alt_ptr = alt_bitfield;
+  for (sample_idx = 0; sample_idx < sample_ctl2; sample_idx++) {
+    // take ref, then:
+    // * if ref + alt is not two, force to 01
+    // * otherwise, if ref is nonzero, add 1 to match PLINK binary encoding
+    ulii = *ref_ptr;
+    uljj = *alt_ptr++;
+    ulkk = (ulii + uljj) & AAAAMASK;
+    uljj = ulii + ((ulii | (ulii >> 1)) & FIVEMASK);
+    ulii = ulkk | (ulkk >> 1); // 11 in nonmissing positions
+    *ref_ptr++ = (uljj & ulii) | (((~ulkk) >> 1) & FIVEMASK);
+  }
+  ref_ptr[-1] &= final_mask;
+  memcpy(bed_record, base_bitfields, (sample_ct + 3) / 4);
+  return alt_allele_idx;
+}
+
+static inline uint32_t vcf_gt_fixed_code(const char* gtptr, char terminator) {
+  // .bed code for one "a/b" or "a|b" call with a, b in {0, 1}, or "./.";
+  // 4 for anything else
+  uint32_t uii = ((unsigned char)gtptr[0]) - '.';
+  uint32_t ujj = ((unsigned char)gtptr[2]) - '.';
+  if ((uii > 3) || (uii == 1) || (ujj > 3) || (ujj == 1) || ((gtptr[1] != '/') && (gtptr[1] != '|')) || (gtptr[3] != terminator)) {
+    return 4;
+  }
+  if (!uii) {
+    return ujj? 4 : 1;
+  }
+  if (!ujj) {
+    return 4;
+  }
+  // '0' - '.' = 2, '1' - '.' = 3; map (2, 2) -> 3, (2, 3) and (3, 2) -> 2,
+  // (3, 3) -> 0
+  return (0x023 >> (4 * (uii + ujj - 4))) & 3;
+}
+
+uint32_t vcf_gt_fixed_to_bed(const char* geno_start, uintptr_t sample_ct, unsigned char* bed_record) {
+  // Fast path for a line whose genotype columns are known to occupy exactly
+  // 4 * sample_ct - 1 bytes, i.e. are plausibly all of the form "a/b\t".
+  // Writes the .bed record and returns 0 if every call is "0/0", "0/1",
+  // "1/0", "1/1" (with either separator) or "./."; returns 1 otherwise, in
+  // which case the caller must fall back on vcf_gt_to_bed().
+  uintptr_t sample_idx = 0;
+  uint32_t cur_byte = 0;
+  uint32_t code;
+#ifdef __LP64__
+  // 16 bytes = 4 samples per step; the last sample is always handled by the
+  // scalar loop, so these loads never touch the line terminator
+  const __m128i dots = _mm_set1_epi8('.');
+  const __m128i zeroes = _mm_set1_epi8('0');
+  const __m128i ones = _mm_set1_epi8('1');
+  const __m128i slashes = _mm_set1_epi8('/');
+  const __m128i pipes = _mm_set1_epi8('|');
+  const __m128i tabs = _mm_set1_epi8('\t');
+  // byte 0 and 2 of each call: allele; byte 1: separator; byte 3: tab
+  const __m128i allele_lanes = _mm_set1_epi32(0x00ff00ff);
+  const __m128i sep_lanes = _mm_set1_epi32(0x0000ff00);
+  const __m128i tab_lanes = _mm_set1_epi32((int32_t)0xff000000U);
+  uintptr_t vec_ct = (sample_ct - 1) / 4;
+  uintptr_t vec_idx;
+  __m128i vv;
+  __m128i is_dot;
+  __m128i is_one;
+  __m128i is_valid;
+  uint32_t dot_bits;
+  uint32_t one_bits;
+  uint32_t alt_ct;
+  uint32_t missing;
+  uint32_t uii;
+  for (vec_idx = 0; vec_idx < vec_ct; vec_idx++) {
+    vv = _mm_loadu_si128((const __m128i*)(&(geno_start[vec_idx * 16])));
+    is_dot = _mm_cmpeq_epi8(vv, dots);
+    is_one = _mm_cmpeq_epi8(vv, ones);
+    is_valid = _mm_and_si128(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(vv, zeroes), is_one), is_dot), allele_lanes);
+    is_valid = _mm_or_si128(is_valid, _mm_and_si128(_mm_or_si128(_mm_cmpeq_epi8(vv, slashes), _mm_cmpeq_epi8(vv, pipes)), sep_lanes));
+    is_valid = _mm_or_si128(is_valid, _mm_and_si128(_mm_cmpeq_epi8(vv, tabs), tab_lanes));
+    dot_bits = _mm_movemask_epi8(is_dot);
+    // half-calls ("./0", "1/.") are subject to --vcf-half-call
+    if ((_mm_movemask_epi8(is_valid) != 0xffff) || ((dot_bits ^ (dot_bits >> 2)) & 0x1111)) {
+      return 1;
+    }
+    one_bits = _mm_movemask_epi8(is_one);
+    cur_byte = 0;
+    for (uii = 0; uii < 4; uii++) {
+      alt_ct = ((one_bits >> (4 * uii)) & 1) + ((one_bits >> (4 * uii + 2)) & 1);
+      missing = (dot_bits >> (4 * uii)) & 1;
+      // 0 alt alleles -> 11, 1 -> 10, 2 -> 00, missing -> 01
+      cur_byte |= ((0x1023 >> (4 * (alt_ct + 3 * missing))) & 3) << (2 * uii);
+    }
+    bed_record[vec_idx] = cur_byte;
+  }
+  sample_idx = vec_ct * 4;
+  cur_byte = 0;
+#endif
+  for (; sample_idx < sample_ct; sample_idx++) {
+    code = vcf_gt_fixed_code(&(geno_start[sample_idx * 4]), (sample_idx == sample_ct - 1)? '\0' : '\t');
+    if (code == 4) {
+      return 1;
+    }
+    cur_byte |= code << (2 * (sample_idx % 4));
+    if ((sample_idx % 4) == 3) {
+      bed_record[sample_idx / 4] = cur_byte;
+      cur_byte = 0;
+    }
+  }
+  if (sample_ct % 4) {
+    bed_record[sample_ct / 4] = cur_byte;
+  }
+  return 0;
+}
+
+// --vcf import: the main thread reads the file, tokenizes the fixed columns
+// of each line in order, and writes the output files; worker threads inflate
+// BGZF blocks and convert batches of genotype columns to .bed records.
+static Vcf_line* g_vcf_lines;
+static unsigned char* g_vcf_bed_records;
+static uintptr_t* g_vcf_base_bitfields;
+static uint32_t* g_vcf_alt_cts;
+static uintptr_t g_vcf_sample_ct;
+static double g_vcf_min_gq;
+static double g_vcf_min_gp;
+static uint32_t g_vcf_half_call;
+static uint32_t g_vcf_biallelic_only;
+
+static unsigned char* g_vcf_bgzf_raw;
+static uintptr_t* g_vcf_bgzf_offsets;
+static char** g_vcf_bgzf_dests;
+static uint32_t g_vcf_bgzf_block_ct;
+static uint32_t g_vcf_bgzf_thread_ct;
+static uint32_t g_vcf_bgzf_error;
+
+THREAD_RET_TYPE vcf_gt_thread(void* arg) {
+  uintptr_t tidx = (uintptr_t)arg;
+  uintptr_t sample_ct = g_vcf_sample_ct;
+  uintptr_t sample_ct4 = (sample_ct + 3) / 4;
+  uintptr_t* base_bitfields = &(g_vcf_base_bitfields[tidx * 20 * ((sample_ct + BITCT - 1) / BITCT)]);
+  uint32_t* vcf_alt_cts = &(g_vcf_alt_cts[tidx * MAX_VCF_ALT]);
+  Vcf_line* lptr;
+  uint32_t line_uidx;
+  uint32_t line_uidx_end;
+  while (ws_claim(tidx, 1, &line_uidx, &line_uidx_end)) {
+    for (; line_uidx < line_uidx_end; line_uidx++) {
+      lptr = &(g_vcf_lines[line_uidx]);
+      if (lptr->geno_start) {
+	// GT-only biallelic lines are usually all 3-character diploid calls
+	if ((lptr->alt_ct == 1) && (!lptr->gq_field_pos) && (!lptr->gp_field_pos) && (lptr->geno_len == 4 * sample_ct - 1) && (!vcf_gt_fixed_to_bed(lptr->geno_start, sample_ct, &(g_vcf_bed_records[line_uidx * sample_ct4])))) {
+	  lptr->result = 1;
+	  continue;
+	}
+	lptr->result = vcf_gt_to_bed(lptr->geno_start, sample_ct, lptr->alt_ct, lptr->gq_field_pos, lptr->gp_field_pos, g_vcf_min_gq, g_vcf_min_gp, g_vcf_half_call, g_vcf_biallelic_only, base_bitfields, vcf_alt_cts, &(g_vcf_bed_records[line_uidx * sample_ct4]));
+      }
+    }
+  }
+  THREAD_RETURN;
+}
+
+uint32_t is_bgzf_header(const unsigned char* header) {
+  return (!memcmp(header, "\37\213\10", 3)) && (header[3] & 4) && (header[10] == 6) && (!header[11]) && (!memcmp(&(header[12]), "BC\2\0", 4));
+}
+
+uint32_t vcf_bgzf_inflate(unsigned char* raw_block, uint32_t block_len, char* dest, uint32_t dest_len) {
+  // returns 1 on failure
+  z_stream zs;
+  uint32_t crc;
+  zs.zalloc = NULL;
+  zs.zfree = NULL;
+  zs.opaque = NULL;
+  zs.next_in = &(raw_block[18]);
+  zs.avail_in = block_len - 26;
+  zs.next_out = (Bytef*)dest;
+  zs.avail_out = dest_len;
+  if (inflateInit2(&zs, -15) != Z_OK) {
+    return 1;
+  }
+  if ((inflate(&zs, Z_FINISH) != Z_STREAM_END) || (zs.total_out != dest_len)) {
+    inflateEnd(&zs);
+    return 1;
+  }
+  inflateEnd(&zs);
+  memcpy(&crc, &(raw_block[block_len - 8]), 4);
+  return (crc32(0, (Bytef*)dest, dest_len) != crc);
+}
+
+THREAD_RET_TYPE vcf_bgzf_inflate_thread(void* arg) {
+  uintptr_t tidx = (uintptr_t)arg;
+  uintptr_t* offsets = g_vcf_bgzf_offsets;
+  char** dests = g_vcf_bgzf_dests;
+  uint32_t block_ct = g_vcf_bgzf_block_ct;
+  uint32_t thread_ct = g_vcf_bgzf_thread_ct;
+  uint32_t block_idx;
+  for (block_idx = tidx; block_idx < block_ct; block_idx += thread_ct) {
+    if (vcf_bgzf_inflate(&(g_vcf_bgzf_raw[offsets[block_idx]]), offsets[block_idx + 1] - offsets[block_idx], dests[block_idx], (uintptr_t)(dests[block_idx + 1] - dests[block_idx]))) {
+      g_vcf_bgzf_error = 1;
+    }
+  }
+  THREAD_RETURN;
+}
+
+int32_t bgzf_chunk_cmp(const void* aa, const void* bb) {
+  uint64_t ullaa = *((const uint64_t*)aa);
+  uint64_t ullbb = *((const uint64_t*)bb);
+  return (ullaa > ullbb) - (ullaa < ullbb);
+}
+
+uint32_t bgzf_index_bin_overlaps(uint32_t bin, uint32_t min_shift, uint32_t depth, uint64_t query_beg, uint64_t query_end) {
+  uint64_t level_start = 0;
+  uint64_t level_size = 1;
+  uint64_t bin_beg;
+  uint32_t shift;
+  uint32_t level;
+  for (level = 0; level <= depth; level++) {
+    if (bin < level_start + level_size) {
+      shift = min_shift + 3 * (depth - level);
+      bin_beg = (bin - level_start) << shift;
+      return (bin_beg < query_end) && (bin_beg + (1LLU << shift) > query_beg);
+    }
+    level_start += level_size;
+    level_size <<= 3;
+  }
+  // pseudo-bin holding index metadata
+  return 0;
+}
+
+uint32_t bgzf_index_regions(char* data_fname, uint32_t is_bcf, uintptr_t* contig_include, Chrom_info* chrom_info_ptr, int32_t marker_pos_start, int32_t marker_pos_end, uint64_t** regions_ptr, uintptr_t* region_ct_ptr) {
+  // Looks for a tabix (.tbi) or CSI (.csi) index next to a BGZF-compressed
+  // .vcf or .bcf file.  If one is found and the chromosome filter (or a
+  // --from-bp/--to-bp window) excludes part of the file, the virtual offset
+  // ranges which must be read are stored on the workspace as (start virtual
+  // offset, uncompressed length) pairs, sorted and merged, and 0 is returned.
+  // Otherwise, 1 is returned and the caller reads the entire file.
+  // For .bcf input, contig_include has a bit set for each wanted header
+  // contig; for .vcf input, the sequence names stored in the index are
+  // resolved against chrom_info_ptr->chrom_mask.
+#ifdef _WIN32
+  return 1;
+#else
+  FILE* datafile = NULL;
+  gzFile gz_idx = NULL;
+  unsigned char* idxbuf = wkspace_base;
+  uint64_t* chunks = NULL;
+  char* seq_name = NULL;
+  char* seq_names_end = NULL;
+  uintptr_t idx_len = 0;
+  uintptr_t chunk_ct = 0;
+  uintptr_t region_ct = 0;
+  uint32_t min_shift = 14;
+  uint32_t depth = 5;
+  uint32_t is_csi = is_bcf;
+  uint32_t retval = 1;
+  uint32_t any_excluded = (marker_pos_start != -1);
+  unsigned char* idxptr;
+  unsigned char* idx_end;
+  unsigned char* bins_start;
+  unsigned char* linear_idx;
+  uintptr_t chunk_max;
+  uint64_t query_beg;
+  uint64_t query_end;
+  uint64_t min_off;
+  uint64_t cur_vbeg;
+  uint64_t cur_vend;
+  uint64_t coffset;
+  uint64_t coffset_end;
+  uint64_t ulen;
+  struct stat data_stat;
+  struct stat idx_stat;
+  File_stamp data_stamp;
+  File_stamp idx_stamp;
+  unsigned char bgzf_header[18];
+  char idxname[FNAMESIZE + 4];
+  uint32_t l_aux;
+  uint32_t l_nm;
+  uint32_t n_ref;
+  uint32_t ref_idx;
+  uint32_t n_bin;
+  uint32_t bin_idx;
+  uint32_t bin;
+  uint32_t n_chunk;
+  uint32_t chunk_idx;
+  uint32_t n_intv;
+  uint32_t is_included;
+  uint32_t level;
+  uint32_t uii;
+  int32_t ii;
+  uii = strlen(data_fname);
+  if ((uii + 5 > FNAMESIZE) || stat(data_fname, &data_stat)) {
+    return 1;
+  }
+  memcpy(memcpya(idxname, data_fname, uii), is_csi? ".csi" : ".tbi", 5);
+  if (stat(idxname, &idx_stat)) {
+    if (is_csi) {
+      return 1;
+    }
+    memcpy(&(idxname[uii]), ".csi", 5);
+    is_csi = 1;
+    if (stat(idxname, &idx_stat)) {
+      return 1;
+    }
+  }
+  // An index written in the same instant as the data file can't be trusted
+  // either, since that's what a same-second rewrite of the data file looks
+  // like on filesystems without subsecond timestamps.
+  file_stamp_init(&data_stat, &data_stamp);
+  file_stamp_init(&idx_stat, &idx_stamp);
+  if ((idx_stamp.mtime < data_stamp.mtime) || ((idx_stamp.mtime == data_stamp.mtime) && (idx_stamp.mtime_nsec <= data_stamp.mtime_nsec))) {
+    LOGPRINTFWW("Warning: Ignoring %s, since it is not newer than %s.\n", idxname, data_fname);
+    return 1;
+  }
+  // virtual offsets are meaningless for ordinary gzip files
+  datafile = fopen(data_fname, "rb");
+  if (!datafile) {
+    return 1;
+  }
+  if ((fread(bgzf_header, 1, 18, datafile) < 18) || (!is_bgzf_header(bgzf_header))) {
+    goto bgzf_index_regions_ret_1;
+  }
+  gz_idx = gzopen(idxname, "rb");
+  if (!gz_idx) {
+    goto bgzf_index_regions_ret_1;
+  }
+  // index occupies at most half of the workspace; the chunk list goes after it
+  chunk_max = wkspace_left / 2;
+  while (1) {
+    ii = gzread(gz_idx, &(idxbuf[idx_len]), MINV(chunk_max - idx_len, 0x40000000));
+    if (ii <= 0) {
+      break;
+    }
+    idx_len += (uint32_t)ii;
+    if (idx_len == chunk_max) {
+      break;
+    }
+  }
+  if ((ii < 0) || (!gzeof(gz_idx))) {
+    gzclose(gz_idx);
+    LOGPRINTFWW("Warning: Ignoring %s, since it could not be fully loaded.\n", idxname);
+    goto bgzf_index_regions_ret_1;
+  }
+  gzclose(gz_idx);
+  idxptr = idxbuf;
+  idx_end = &(idxbuf[idx_len]);
+  if (is_csi) {
+    if ((idx_len < 16) || memcmp(idxbuf, "CSI\1", 4)) {
+      goto bgzf_index_regions_malformed;
+    }
+    memcpy(&min_shift, &(idxbuf[4]), 4);
+    memcpy(&depth, &(idxbuf[8]), 4);
+    memcpy(&l_aux, &(idxbuf[12]), 4);
+    idxptr = &(idxbuf[16]);
+    if ((min_shift + 3 * depth > 60) || ((uintptr_t)(idx_end - idxptr) < ((uintptr_t)l_aux) + 4)) {
+      goto bgzf_index_regions_malformed;
+    }
+    if (!is_bcf) {
+      // tabix-style aux data: format, col_seq, col_beg, col_end, meta, skip,
+      // l_nm, names
+      if (l_aux < 28) {
+	goto bgzf_index_regions_malformed;
+      }
+      memcpy(&l_nm, &(idxptr[24]), 4);
+      if (l_nm > l_aux - 28) {
+	goto bgzf_index_regions_malformed;
+      }
+      seq_name = (char*)(&(idxptr[28]));
+    }
+    idxptr = &(idxptr[l_aux]);
+    memcpy(&n_ref, idxptr, 4);
+    idxptr = &(idxptr[4]);
+  } else {
+    if ((idx_len < 36) || memcmp(idxbuf, "TBI\1", 4)) {
+      goto bgzf_index_regions_malformed;
+    }
+    memcpy(&n_ref, &(idxbuf[4]), 4);
+    memcpy(&l_nm, &(idxbuf[32]), 4);
+    if (l_nm > idx_len - 36) {
+      goto bgzf_index_regions_malformed;
+    }
+    seq_name = (char*)(&(idxbuf[36]));
+    idxptr = &(idxbuf[36 + l_nm]);
+  }
+  if (seq_name) {
+    seq_names_end = &(seq_name[l_nm]);
+  }
+  // chunk list starts at the next 16-byte boundary after the loaded index
+  chunks = (uint64_t*)(&(idxbuf[(idx_len + 15) & (~15LLU)]));
+  chunk_max = (wkspace_left - ((idx_len + 15) & (~15LLU))) / (2 * sizeof(int64_t));
+  if (marker_pos_start != -1) {
+    query_beg = marker_pos_start? (marker_pos_start - 1) : 0;
+    query_end = marker_pos_end;
+  } else {
+    query_beg = 0;
+    query_end = 1LLU << (min_shift + 3 * depth);
+  }
+  for (ref_idx = 0; ref_idx < n_ref; ref_idx++) {
+    if (is_bcf) {
+      is_included = IS_SET(contig_include, ref_idx);
+    } else {
+      if (seq_name >= seq_names_end) {
+	goto bgzf_index_regions_malformed;
+      }
+      ii = get_chrom_code(chrom_info_ptr, seq_name);
+      // unrecognized names are resolved later, so keep them
+      is_included = (ii < 0) || is_set(chrom_info_ptr->chrom_mask, ii);
+      seq_name = &(seq_name[strlen(seq_name) + 1]);
+    }
+    if (!is_included) {
+      any_excluded = 1;
+    }
+    if (idx_end - idxptr < 4) {
+      goto bgzf_index_regions_malformed;
+    }
+    memcpy(&n_bin, idxptr, 4);
+    idxptr = &(idxptr[4]);
+    bins_start = idxptr;
+    // first pass: find end of bin list, and (for .csi) lower bound on
+    // virtual offsets of records overlapping the query
+    min_off = 0;
+    for (bin_idx = 0; bin_idx < n_bin; bin_idx++) {
+      if ((uintptr_t)(idx_end - idxptr) < 8 + 8 * is_csi) {
+	goto bgzf_index_regions_malformed;
+      }
+      memcpy(&bin, idxptr, 4);
+      if (is_csi && query_beg && is_included) {
+	// loffset of any bin containing query_beg is a valid lower bound, and
+	// deeper bins give tighter bounds
+	for (level = 0; level <= depth; level++) {
+	  if (bin == ((1LLU << (3 * level)) - 1) / 7 + (query_beg >> (min_shift + 3 * (depth - level)))) {
+	    memcpy(&cur_vbeg, &(idxptr[4]), 8);
+	    if (cur_vbeg > min_off) {
+	      min_off = cur_vbeg;
+	    }
+	    break;
+	  }
+	}
+      }
+      memcpy(&n_chunk, &(idxptr[4 + 8 * is_csi]), 4);
+      idxptr = &(idxptr[8 + 8 * is_csi]);
+      if ((uintptr_t)(idx_end - idxptr) < 16 * ((uintptr_t)n_chunk)) {
+	goto bgzf_index_regions_malformed;
+      }
+      idxptr = &(idxptr[16 * ((uintptr_t)n_chunk)]);
+    }
+    if (!is_csi) {
+      if (idx_end - idxptr < 4) {
+	goto bgzf_index_regions_malformed;
+      }
+      memcpy(&n_intv, idxptr, 4);
+      linear_idx = &(idxptr[4]);
+      if ((uintptr_t)(idx_end - linear_idx) < 8 * ((uintptr_t)n_intv)) {
+	goto bgzf_index_regions_malformed;
+      }
+      idxptr = &(linear_idx[8 * ((uintptr_t)n_intv)]);
+      if (n_intv && query_beg) {
+	uii = query_beg >> 14;
+	if (uii >= n_intv) {
+	  uii = n_intv - 1;
+	}
+	memcpy(&min_off, &(linear_idx[8 * uii]), 8);
+      }
+    }
+    if (!is_included) {
+      continue;
+    }
+    // second pass: collect chunks from overlapping bins
+    for (bin_idx = 0; bin_idx < n_bin; bin_idx++) {
+      memcpy(&bin, bins_start, 4);
+      memcpy(&n_chunk, &(bins_start[4 + 8 * is_csi]), 4);
+      bins_start = &(bins_start[8 + 8 * is_csi]);
+      if (bgzf_index_bin_overlaps(bin, min_shift, depth, query_beg, query_end)) {
+	for (chunk_idx = 0; chunk_idx < n_chunk; chunk_idx++) {
+	  memcpy(&cur_vbeg, &(bins_start[16 * chunk_idx]), 8);
+	  memcpy(&cur_vend, &(bins_start[16 * chunk_idx + 8]), 8);
+	  if (cur_vend <= min_off) {
+	    continue;
+	  }
+	  if (chunk_ct == chunk_max) {
+	    LOGPRINTFWW("Warning: Ignoring %s due to insufficient memory.\n", idxname);
+	    goto bgzf_index_regions_ret_1;
+	  }
+	  chunks[2 * chunk_ct] = MAXV(cur_vbeg, min_off);
+	  chunks[2 * chunk_ct + 1] = cur_vend;
+	  chunk_ct++;
+	}
+      }
+      bins_start = &(bins_start[16 * ((uintptr_t)n_chunk)]);
+    }
+  }
+  if (!any_excluded) {
+    goto bgzf_index_regions_ret_1;
+  }
+  if (chunk_ct) {
+    qsort(chunks, chunk_ct, 2 * sizeof(int64_t), bgzf_chunk_cmp);
+    region_ct = 1;
+    for (chunk_idx = 1; chunk_idx < chunk_ct; chunk_idx++) {
+      if (chunks[2 * chunk_idx] <= chunks[2 * region_ct - 1]) {
+	if (chunks[2 * chunk_idx + 1] > chunks[2 * region_ct - 1]) {
+	  chunks[2 * region_ct - 1] = chunks[2 * chunk_idx + 1];
+	}
+      } else {
+	chunks[2 * region_ct] = chunks[2 * chunk_idx];
+	chunks[2 * region_ct + 1] = chunks[2 * chunk_idx + 1];
+	region_ct++;
+      }
+    }
+    // replace each end virtual offset with the uncompressed length of the
+    // region, so the readers know exactly when to stop
+    for (chunk_idx = 0; chunk_idx < region_ct; chunk_idx++) {
+      cur_vbeg = chunks[2 * chunk_idx];
+      cur_vend = chunks[2 * chunk_idx + 1];
+      coffset = cur_vbeg >> 16;
+      coffset_end = cur_vend >> 16;
+      ulen = cur_vend & 0xffff;
+      while (coffset < coffset_end) {
+	if (fseeko(datafile, coffset, SEEK_SET) || (fread(bgzf_header, 1, 18, datafile) < 18) || (!is_bgzf_header(bgzf_header))) {
+	  goto bgzf_index_regions_malformed;
+	}
+	uii = 1 + (((uint32_t)bgzf_header[16]) | (((uint32_t)bgzf_header[17]) << 8));
+	if ((uii < 26) || fseeko(datafile, coffset + uii - 4, SEEK_SET) || (fread(&l_nm, 1, 4, datafile) < 4)) {
+	  goto bgzf_index_regions_malformed;
+	}
+	ulen += l_nm;
+	coffset += uii;
+      }
+      if ((coffset != coffset_end) || (ulen < (cur_vbeg & 0xffff))) {
+	goto bgzf_index_regions_malformed;
+      }
+      chunks[2 * chunk_idx + 1] = ulen - (cur_vbeg & 0xffff);
+    }
+    memmove(wkspace_base, chunks, region_ct * 2 * sizeof(int64_t));
+  }
+  *regions_ptr = (uint64_t*)wkspace_alloc(region_ct * 2 * sizeof(int64_t));
+  *region_ct_ptr = region_ct;
+  LOGPRINTFWW("%s: %s found; reading %" PRIuPTR " indexed region%s.\n", is_bcf? "--bcf" : "--vcf", idxname, region_ct, (region_ct == 1)? "" : "s");
+  retval = 0;
+  while (0) {
+  bgzf_index_regions_malformed:
+    LOGPRINTFWW("Warning: Ignoring %s, since it appears to be malformed.\n", idxname);
+    break;
+  }
+ bgzf_index_regions_ret_1:
+  fclose_cond(datafile);
+  return retval;
+#endif
+}
+
+int32_t vcf_to_bed(char* vcfname, char* outname, char* outname_end, int32_t missing_pheno, uint64_t misc_flags, char* const_fid, char id_delim, char vcf_idspace_to, double vcf_min_qual, char* vcf_filter_exceptions_flattened, double vcf_min_gq, double vcf_min_gp, uint32_t vcf_half_call, int32_t marker_pos_start, int32_t marker_pos_end, Chrom_info* chrom_info_ptr) {
+  unsigned char* wkspace_mark = wkspace_base;
+  gzFile gz_infile = NULL;
+  FILE* bgzf_infile = NULL;
+  FILE* outfile = NULL;
+  FILE* bimfile = NULL;
+  FILE* skip3file = NULL;
+  char* sorted_fexcepts = NULL;
+  uintptr_t line_idx = 0;
+  uintptr_t fexcept_ct = 0;
+  uintptr_t max_fexcept_len = 5;
+  uintptr_t sample_ct = 0;
+  uintptr_t carry_len = 0;
+  uintptr_t bgzf_pending_len = 0;
+  uint64_t bgzf_skip = 0;
+  uint64_t* bgzf_regions = NULL;
+  uintptr_t bgzf_region_ct = 0;
+  uintptr_t bgzf_region_idx = 0;
+  // uncompressed bytes left in the current indexed region
+  uint64_t region_left = ~0LLU;
+  uint32_t double_id = (misc_flags / MISC_DOUBLE_ID) & 1;
+  uint32_t check_qual = (vcf_min_qual != -1);
+  uint32_t allow_extra_chroms = (misc_flags / MISC_ALLOW_EXTRA_CHROMS) & 1;
+  uint32_t biallelic_only = (misc_flags / MISC_BIALLELIC_ONLY) & 1;
+  uint32_t biallelic_strict = (misc_flags / MISC_BIALLELIC_ONLY_STRICT) & 1;
+  uint32_t skip3_list = (misc_flags / MISC_BIALLELIC_ONLY_LIST) & 1;
+  uint32_t marker_ct = 0;
+  uint32_t marker_skip_ct = 0;
+  uint32_t gq_field_pos = 0;
+  uint32_t gp_field_pos = 0;
+  uint32_t vcf_half_call_explicit_error = (vcf_half_call == VCF_HALF_CALL_ERROR);
+  uint32_t thread_ct = g_thread_ct;
+  uint32_t bgzf_block_max = 0;
+  uint32_t at_eof = 0;
+  uint32_t line_pending = 0;
+  int32_t retval = 0;
+  char missing_geno = *g_missing_geno_ptr;
+  pthread_t threads[MAX_THREADS];
+  unsigned char bgzf_header[18];
+  Vcf_line* lptr;
+  unsigned char* rawptr;
+  char* loadbuf;
+  char* lines_end;
+  char* line_ptr;
+  char* cur_line;
+  char* line_end;
+  char* bufptr;
+  char* bufptr2;
+  char* ref_allele_ptr;
+  char* delimiter_ptr;
+  char* gq_scan_ptr;
+  char* chrom_ptr;
+  char* marker_id;
+  char* pos_str;
+  char* alt_alleles;
+  uintptr_t sample_ctv2;
+  uintptr_t sample_ct4;
+  uintptr_t loadbuf_size;
+  uintptr_t fill_size;
+  uintptr_t fill_end;
+  uintptr_t fill_target;
+  uintptr_t raw_used;
+  uintptr_t line_max;
+  uintptr_t slen;
+  uintptr_t ulii;
+  uintptr_t alt_allele_idx;
+  double dxx;
+  uint32_t block_ct;
+  uint32_t batch_ct;
+  uint32_t line_uidx;
+  uint32_t header_err;
   uint32_t chrom_len;
   uint32_t marker_id_len;
   uint32_t alt_idx;
@@ -8033,7 +10305,6 @@ int32_t vcf_to_bed(char* vcfname, char* outname, char* outname_end, int32_t miss
   uint32_t ref_allele_len;
   uint32_t uii;
   uint32_t ujj;
-  uint32_t ukk;
   int32_t ii;
   char cc;
   if (vcf_half_call_explicit_error) {
@@ -8104,654 +10375,610 @@ int32_t vcf_to_bed(char* vcfname, char* outname, char* outname_end, int32_t miss
   }
   if (memcmp(bufptr, "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO", 38)) {
     logprint("Error: Improperly formatted .vcf header line.\n");
-    goto vcf_to_bed_ret_INVALID_FORMAT;
-  }
-  bufptr = &(bufptr[38]);
-  if (memcmp(bufptr, "\tFORMAT\t", 8) || (((unsigned char)bufptr[8]) <= ' ')) {
-    logprint("Error: No genotype data in .vcf file.\n");
-    goto vcf_to_bed_ret_INVALID_FORMAT;
-  }
-  retval = vcf_sample_line(outname, outname_end, missing_pheno, &(bufptr[8]), const_fid, double_id, id_delim, vcf_idspace_to, 'v', &sample_ct);
-  if (retval) {
-    goto vcf_to_bed_ret_1;
-  }
-  sample_ct4 = (sample_ct + 3) / 4;
-  sample_ctl2 = (sample_ct + BITCT2 - 1) / BITCT2;
-  sample_ctv2 = 2 * ((sample_ct + BITCT - 1) / BITCT);
-  final_mask = (~ZEROLU) >> (2 * ((0x7fffffe0 - sample_ct) % BITCT2));
-  if (wkspace_alloc_ul_checked(&base_bitfields, sample_ctv2 * 10 * sizeof(intptr_t)) ||
-      wkspace_alloc_ui_checked(&vcf_alt_cts, MAX_VCF_ALT * sizeof(int32_t))) {
-    goto vcf_to_bed_ret_NOMEM;
-  }
-  memcpy(outname_end, ".bim", 5);
-  if (fopen_checked(&bimfile, outname, "w")) {
-    goto vcf_to_bed_ret_OPEN_FAIL;
-  }
-  memcpyl3(&(outname_end[2]), "ed");
-  if (fopen_checked(&outfile, outname, "wb")) {
-    goto vcf_to_bed_ret_OPEN_FAIL;
-  }
-  if (fwrite_checked("l\x1b\x01", 3, outfile)) {
-    goto vcf_to_bed_ret_WRITE_FAIL;
-  }
-  loadbuf_size = wkspace_left;
-  if (loadbuf_size > MAXLINEBUFLEN) {
-    loadbuf_size = MAXLINEBUFLEN;
-  } else if (loadbuf_size <= MAXLINELEN) {
-    goto vcf_to_bed_ret_NOMEM;
-  }
-  
-  loadbuf = (char*)wkspace_base;
-  loadbuf[loadbuf_size - 1] = ' ';
-  while (1) {
-    line_idx++;
-    if (!gzgets(gz_infile, loadbuf, loadbuf_size)) {
-      if (!gzeof(gz_infile)) {
-        goto vcf_to_bed_ret_READ_FAIL;
-      }
-      break;
-    }
-    if (!loadbuf[loadbuf_size - 1]) {
-      if (loadbuf_size == MAXLINEBUFLEN) {
-        goto vcf_to_bed_ret_LONG_LINE;
-      }
-      goto vcf_to_bed_ret_NOMEM;
-    }
-    bufptr = skip_initial_spaces(loadbuf);
-    if (is_eoln_kns(*bufptr)) {
-      continue;
-    }
-    // strchr instead of memchr since we explicitly need to catch premature \0
-    // here
-    bufptr2 = strchr(bufptr, '\t');
-    if (!bufptr2) {
-      goto vcf_to_bed_ret_MISSING_TOKENS;
-    }
-    ii = get_chrom_code(chrom_info_ptr, bufptr);
-    if (ii < 0) {
-      if (chrom_error(".vcf file", chrom_info_ptr, bufptr, line_idx, ii, allow_extra_chroms)) {
-	goto vcf_to_bed_ret_INVALID_FORMAT;
-      }
-      retval = resolve_or_add_chrom_name(chrom_info_ptr, bufptr, &ii, line_idx, ".vcf file");
-      if (retval) {
-	putchar('\n');
-        goto vcf_to_bed_ret_1;
-      }
-    }
-    if (!is_set(chrom_info_ptr->chrom_mask, ii)) {
-      marker_skip_ct++;
-      continue;
-    }
-    chrom_ptr = bufptr;
-    chrom_len = (uintptr_t)(bufptr2 - bufptr);
-    pos_str = ++bufptr2;
-    marker_id = strchr(bufptr2, '\t');
-    if (!marker_id) {
-      goto vcf_to_bed_ret_MISSING_TOKENS;
-    }
-    if ((((unsigned char)(*pos_str)) - '0') >= 10) {
-      sprintf(logbuf, "\nError: Invalid variant bp coordinate on line %" PRIuPTR " of .vcf file.\n", line_idx);
-      goto vcf_to_bed_ret_INVALID_FORMAT_2;
-    }
-    ref_allele_ptr = strchr(++marker_id, '\t');
-    if (!ref_allele_ptr) {
-      goto vcf_to_bed_ret_MISSING_TOKENS;
-    }
-    marker_id_len = (uintptr_t)(ref_allele_ptr - marker_id);
-    bufptr = strchr(++ref_allele_ptr, '\t');
-    // now ref_allele_ptr finally points to the ref allele
-    if (!bufptr) {
-      goto vcf_to_bed_ret_MISSING_TOKENS;
-    }
-    ref_allele_len = (uintptr_t)(bufptr - ref_allele_ptr);
-    alt_ct = 1;
-    alt_alleles = ++bufptr;
-    cc = *bufptr;
-    // ',' < '.'
-    while (1) {
-      if ((unsigned char)cc <= ',') {
-	sprintf(logbuf, "\nError: Invalid alternate allele on line %" PRIuPTR  " of .vcf file.\n", line_idx);
-	goto vcf_to_bed_ret_INVALID_FORMAT_2;
-      }
-      bufptr2 = bufptr;
-      do {
-	cc = *(++bufptr);
-      } while ((unsigned char)cc > ',');
-      if (((uintptr_t)(bufptr - bufptr2) == ref_allele_len) && (!memcmp(ref_allele_ptr, bufptr2, ref_allele_len))) {
-	if ((alt_ct != 1) || (cc == ',')) {
-	  sprintf(logbuf, "\nError: ALT allele duplicates REF allele on line %" PRIuPTR " of .vcf file.\n", line_idx);
-	  goto vcf_to_bed_ret_INVALID_FORMAT_2;
-	}
-        *alt_alleles = '.'; // tolerate SHAPEIT output
-      }
-      if (cc != ',') {
-	break;
-      }
-      cc = *(++bufptr);
-      alt_ct++;      
-    }
-    if (cc != '\t') {
-      sprintf(logbuf, "\nError: Malformed ALT field on line %" PRIuPTR " of .vcf file.\n", line_idx);
-      goto vcf_to_bed_ret_INVALID_FORMAT_2;
-    }
-    if (biallelic_strict && (alt_ct > 1)) {
-      goto vcf_to_bed_skip3;
-    }
-    bufptr++;
-    bufptr2 = strchr(bufptr, '\t');
-    if (!bufptr2) {
-      goto vcf_to_bed_ret_MISSING_TOKENS;
-    }
-    if (check_qual) {
-      if (*bufptr == '.') {
-	marker_skip_ct++;
-	continue;
-      }
-      if (scan_double(bufptr, &dxx)) {
-        sprintf(logbuf, "\nError: Invalid QUAL value on line %" PRIuPTR " of .vcf file.\n", line_idx);
-	goto vcf_to_bed_ret_INVALID_FORMAT_2;
-      }
-      if (dxx < vcf_min_qual) {
-        marker_skip_ct++;
-	continue;
-      }
-    }
-    bufptr = &(bufptr2[1]);
-    bufptr2 = strchr(bufptr, '\t');
-    if (!bufptr2) {
-      goto vcf_to_bed_ret_MISSING_TOKENS;
-    }
-    bufptr2++;
-    if (fexcept_ct) {
-      // bugfix: recognize semicolon delimiter
-      bufptr2[-1] = ';';
-    vcf_to_bed_check_filter:
-      delimiter_ptr = (char*)memchr(bufptr, ';', (uintptr_t)(bufptr2 - bufptr));
-      if (bsearch_str(bufptr, (uintptr_t)(delimiter_ptr - bufptr), sorted_fexcepts, max_fexcept_len, fexcept_ct) == -1) {
-	marker_skip_ct++;
-	// if we replace the vcf_to_bed_check_filter goto with a while loop,
-	// can't use "continue" here
-	continue;
-      }
-      bufptr = &(delimiter_ptr[1]);
-      if (bufptr != bufptr2) {
-	goto vcf_to_bed_check_filter;
-      }
-      bufptr2[-1] = '\t';
-    }
-    bufptr = bufptr2;
-    bufptr2 = strchr(bufptr, '\t');
-    if (!bufptr2) {
-      goto vcf_to_bed_ret_MISSING_TOKENS;
-    }
-    bufptr = &(bufptr2[1]);
-    bufptr2 = strchr(bufptr, '\t');
-    if (!bufptr2) {
-      goto vcf_to_bed_ret_MISSING_TOKENS;
+    goto vcf_to_bed_ret_INVALID_FORMAT;
+  }
+  bufptr = &(bufptr[38]);
+  if (memcmp(bufptr, "\tFORMAT\t", 8) || (((unsigned char)bufptr[8]) <= ' ')) {
+    logprint("Error: No genotype data in .vcf file.\n");
+    goto vcf_to_bed_ret_INVALID_FORMAT;
+  }
+  retval = vcf_sample_line(outname, outname_end, missing_pheno, &(bufptr[8]), const_fid, double_id, id_delim, vcf_idspace_to, 'v', &sample_ct);
+  if (retval) {
+    goto vcf_to_bed_ret_1;
+  }
+  sample_ct4 = (sample_ct + 3) / 4;
+  sample_ctv2 = 2 * ((sample_ct + BITCT - 1) / BITCT);
+  if (wkspace_alloc_ul_checked(&g_vcf_base_bitfields, thread_ct * sample_ctv2 * 10 * sizeof(intptr_t)) ||
+      wkspace_alloc_ui_checked(&g_vcf_alt_cts, thread_ct * MAX_VCF_ALT * sizeof(int32_t))) {
+    goto vcf_to_bed_ret_NOMEM;
+  }
+  memcpy(outname_end, ".bim", 5);
+  if (fopen_checked(&bimfile, outname, "w")) {
+    goto vcf_to_bed_ret_OPEN_FAIL;
+  }
+  memcpyl3(&(outname_end[2]), "ed");
+  if (fopen_checked(&outfile, outname, "wb")) {
+    goto vcf_to_bed_ret_OPEN_FAIL;
+  }
+  if (fwrite_checked("l\x1b\x01", 3, outfile)) {
+    goto vcf_to_bed_ret_WRITE_FAIL;
+  }
+
+  // BGZF input: read the compressed blocks directly so they can be inflated
+  // in parallel, skipping the header lines we've already processed.
+  // Anything else (plain text, ordinary gzip) continues through zlib.
+  if (fopen_checked(&bgzf_infile, vcfname, "rb")) {
+    goto vcf_to_bed_ret_OPEN_FAIL;
+  }
+  if ((fread(bgzf_header, 1, 18, bgzf_infile) == 18) && is_bgzf_header(bgzf_header)) {
+    bgzf_skip = (uint64_t)gztell(gz_infile);
+    gzclose(gz_infile);
+    gz_infile = NULL;
+    rewind(bgzf_infile);
+    bgzf_block_max = thread_ct * VCF_BGZF_BLOCKS_PER_THREAD;
+    if (wkspace_alloc_uc_checked(&g_vcf_bgzf_raw, bgzf_block_max * 65536LU) ||
+        wkspace_alloc_ul_checked(&g_vcf_bgzf_offsets, (bgzf_block_max + 1) * sizeof(intptr_t))) {
+      goto vcf_to_bed_ret_NOMEM;
     }
-    if (memcmp(bufptr, "GT", 2)) {
-      marker_skip_ct++;
-      continue;
+    g_vcf_bgzf_dests = (char**)wkspace_alloc((bgzf_block_max + 1) * sizeof(intptr_t));
+    if (!g_vcf_bgzf_dests) {
+      goto vcf_to_bed_ret_NOMEM;
     }
-    bufptr2++;
-    if (vcf_min_gq != -1) {
-      gq_field_pos = 0;
-      bufptr2[-1] = ':';
-      gq_scan_ptr = bufptr;
-      do {
-	gq_scan_ptr = (char*)memchr(gq_scan_ptr, ':', (uintptr_t)(bufptr2 - gq_scan_ptr));
-	if (++gq_scan_ptr == bufptr2) {
-	  gq_field_pos = 0;
-	  break;
-	}
-	gq_field_pos++;
-      } while (memcmp(gq_scan_ptr, "GQ:", 3));
-      bufptr2[-1] = '\t';
+    if (!bgzf_index_regions(vcfname, 0, NULL, chrom_info_ptr, marker_pos_start, marker_pos_end, &bgzf_regions, &bgzf_region_ct)) {
+      // header was already processed, and the first region starts after it
+      bgzf_skip = 0;
+      region_left = 0;
+      // physical line numbers are unknown from here on, so line_idx stays
+      // zero and error messages just name the file
+      line_idx = 0;
     }
-    if (vcf_min_gp != -1) {
-      gp_field_pos = 0;
-      bufptr2[-1] = ':';
-      do {
-	bufptr = (char*)memchr(bufptr, ':', (uintptr_t)(bufptr2 - bufptr));
-	if (++bufptr == bufptr2) {
-	  gp_field_pos = 0;
-	  break;
-	}
-	gp_field_pos++;
-      } while (memcmp(bufptr, "GP:", 3));
-      bufptr2[-1] = '\t';
+  } else {
+    fclose_null(&bgzf_infile);
+  }
+
+  // a quarter of the remaining workspace goes to the .bed records of one
+  // batch of lines, the rest to the line buffer
+  line_max = wkspace_left / (4 * (sizeof(Vcf_line) + sample_ct4 + CACHELINE));
+  if (!line_max) {
+    goto vcf_to_bed_ret_NOMEM;
+  } else if (line_max > VCF_LINE_BATCH_MAX) {
+    line_max = VCF_LINE_BATCH_MAX;
+  }
+  g_vcf_lines = (Vcf_line*)wkspace_alloc(line_max * sizeof(Vcf_line));
+  if ((!g_vcf_lines) || wkspace_alloc_uc_checked(&g_vcf_bed_records, line_max * sample_ct4)) {
+    goto vcf_to_bed_ret_NOMEM;
+  }
+  g_vcf_sample_ct = sample_ct;
+  g_vcf_min_gq = vcf_min_gq;
+  g_vcf_min_gp = vcf_min_gp;
+  g_vcf_half_call = vcf_half_call;
+  g_vcf_biallelic_only = biallelic_only;
+  loadbuf_size = wkspace_left;
+  if (loadbuf_size > MAXLINEBUFLEN) {
+    loadbuf_size = MAXLINEBUFLEN;
+  } else if (loadbuf_size <= MAXLINELEN) {
+    goto vcf_to_bed_ret_NOMEM;
+  }
+  loadbuf = (char*)wkspace_base;
+  // each genotype column takes at least 4 bytes
+  fill_size = thread_ct * sample_ct * 4 * 32;
+  if (fill_size < VCF_FILL_SIZE) {
+    fill_size = VCF_FILL_SIZE;
+  }
+  while (1) {
+    // refill the buffer after any incomplete line left over from the last
+    // pass; one byte is reserved for a final newline
+    fill_end = carry_len;
+    fill_target = carry_len + fill_size;
+    if (fill_target > loadbuf_size - 1) {
+      fill_target = loadbuf_size - 1;
     }
-    bufptr = bufptr2;
-    // okay, finally done with the line header
-    if (alt_ct < 10) {
-      // slightly faster parsing for the usual case
-      fill_ulong_zero(base_bitfields, (alt_ct + 1) * sample_ctv2);
-      if ((!biallelic_only) || (alt_ct == 1)) {
-	for (sample_idx = 0; sample_idx < sample_ct; sample_idx++, bufptr = &(bufptr2[1])) {
-	  bufptr2 = strchr(bufptr, '\t');
-	  if (!bufptr2) {
-	    if (sample_idx != sample_ct - 1) {
-	      goto vcf_to_bed_ret_MISSING_TOKENS;
+    while (1) {
+      ulii = fill_end;
+      if (bgzf_infile) {
+	while (!at_eof) {
+	  block_ct = 0;
+	  raw_used = 0;
+	  bufptr = &(loadbuf[fill_end]);
+	  while (block_ct < bgzf_block_max) {
+	    if (!region_left) {
+	      if (bgzf_region_idx == bgzf_region_ct) {
+		at_eof = 1;
+		break;
+	      }
+	      if (fseeko(bgzf_infile, bgzf_regions[2 * bgzf_region_idx] >> 16, SEEK_SET)) {
+		goto vcf_to_bed_ret_READ_FAIL;
+	      }
+	      bgzf_skip = bgzf_regions[2 * bgzf_region_idx] & 0xffff;
+	      region_left = bgzf_regions[2 * bgzf_region_idx + 1];
+	      bgzf_region_idx++;
+	      continue;
 	    }
-	    bufptr2 = &(bufptr[strlen_se(bufptr)]);
-	  }
-	  uii = (unsigned char)(*bufptr) - '0';
-	  // time to provide proper support for VCF import; that means, among
-	  // other things, providing a useful error message instead of
-	  // segfaulting on an invalid GT field, to help other tool
-	  // developers.
-	  if (uii <= 9) {
-	    // no GQ field with ./. calls, so this check cannot occur earlier
-	    if (gq_field_pos) {
-	      // to test: does splitting this off in an entirely separate loop
-	      // noticeably speed up common case parsing?  I hope not--this is
-	      // a predictable branch--but one can never be too paranoid about
-	      // this sort of performance leak when hundreds of GB are
-	      // involved...
-	      gq_scan_ptr = bufptr;
-	      for (ujj = 0; ujj < gq_field_pos; ujj++) {
-		gq_scan_ptr = (char*)memchr(gq_scan_ptr, ':', (uintptr_t)(bufptr2 - gq_scan_ptr));
-		if (!gq_scan_ptr) {
-		  // non-GT fields are allowed to be missing
-		  goto vcf_to_bed_missing_gq_1;
+	    rawptr = &(g_vcf_bgzf_raw[raw_used]);
+	    if (bgzf_pending_len) {
+	      uii = bgzf_pending_len;
+	      bgzf_pending_len = 0;
+	    } else {
+	      slen = fread(rawptr, 1, 18, bgzf_infile);
+	      if (slen < 18) {
+		if (slen || ferror(bgzf_infile) || bgzf_regions) {
+		  goto vcf_to_bed_ret_READ_FAIL;
 		}
-		gq_scan_ptr++;
+		at_eof = 1;
+		break;
 	      }
-	      if ((!scan_double(gq_scan_ptr, &dxx)) && (dxx < vcf_min_gq)) {
+	      uii = 1 + (rawptr[16] | (((uint32_t)rawptr[17]) << 8));
+	      if ((!is_bgzf_header(rawptr)) || (uii < 26) || (fread(&(rawptr[18]), 1, uii - 18, bgzf_infile) < uii - 18)) {
+		goto vcf_to_bed_ret_READ_FAIL;
+	      }
+	    }
+	    // uncompressed size is stored at the end of each block, so the
+	    // destination of every block is known before it is inflated
+	    memcpy(&ujj, &(rawptr[uii - 4]), 4);
+	    if (ujj > 65536) {
+	      goto vcf_to_bed_ret_READ_FAIL;
+	    }
+	    if (ujj > (uintptr_t)(&(loadbuf[fill_target]) - bufptr)) {
+	      // doesn't fit, keep for next time
+	      if (ujj <= bgzf_skip) {
+		bgzf_skip -= ujj;
 		continue;
 	      }
+	      bgzf_pending_len = uii;
+	      break;
 	    }
-	  vcf_to_bed_missing_gq_1:
-	    cc = bufptr[1];
-	    if ((cc != '/') && (cc != '|')) {
-	      // haploid
-	    vcf_to_bed_haploid_1:
-	      if (gp_field_pos) {
-		if (vcf_gp_invalid(bufptr, bufptr2, vcf_min_gp, gp_field_pos, uii, &ukk)) {
-		  if (ukk) {
-		    goto vcf_to_bed_ret_INVALID_GP;
-		  }
-		  continue;
-		}
+	    if (bgzf_skip || (ujj > region_left)) {
+	      // only part of this block is wanted; inflate it here, after the
+	      // queued blocks (whose destinations must stay contiguous)
+	      if (ujj <= bgzf_skip) {
+		bgzf_skip -= ujj;
+		continue;
 	      }
-	      set_bit_ul(&(base_bitfields[uii * sample_ctv2]), sample_idx * 2 + 1);
-	    } else {
-	      cc = bufptr[3];
-	      if (((cc != '/') && (cc != '|')) || (bufptr[4] == '.')) {
-		// code triploids, etc. as missing
-		// might want to subject handling of 0/0/. to --vcf-half-call
-		// control
-		ujj = ((unsigned char)bufptr[2]) - '0';
-		if (ujj > 9) {
-		  if (ujj != (uint32_t)(((unsigned char)'.') - '0')) {
-		    goto vcf_to_bed_ret_INVALID_GT;
-		  }
-		  if (!vcf_half_call) {
-		    goto vcf_to_bed_ret_HALF_CALL_ERROR;
-		  } else if (vcf_half_call == VCF_HALF_CALL_HAPLOID) {
-		    goto vcf_to_bed_haploid_1;
-		  }
-		} else {
-		  if (gp_field_pos) {
-		    if (vcf_gp_diploid_invalid(bufptr, bufptr2, vcf_min_gp, gp_field_pos, uii, ujj, &ukk)) {
-		      if (ukk) {
-			goto vcf_to_bed_ret_INVALID_GP;
-		      }
-		      continue;
-		    }
-		  }
-		  set_bit_ul(&(base_bitfields[uii * sample_ctv2]), sample_idx * 2);
-		  base_bitfields[ujj * sample_ctv2 + sample_idx / BITCT2] += ONELU << (2 * (sample_idx % BITCT2));
-		}
+	      if (block_ct) {
+		bgzf_pending_len = uii;
+		break;
+	      }
+	      if (vcf_bgzf_inflate(rawptr, uii, bufptr, ujj)) {
+		goto vcf_to_bed_ret_READ_FAIL;
+	      }
+	      ujj -= bgzf_skip;
+	      if (ujj > region_left) {
+		ujj = region_left;
 	      }
+	      memmove(bufptr, &(bufptr[bgzf_skip]), ujj);
+	      bufptr = &(bufptr[ujj]);
+	      region_left -= ujj;
+	      bgzf_skip = 0;
+	      continue;
 	    }
-	  } else if (uii != (uint32_t)(((unsigned char)'.') - '0')) {
-	    goto vcf_to_bed_ret_INVALID_GT;
-	  }
-	}
-	alt_allele_idx = 1;
-	if (alt_ct > 1) {
-	  ulii = popcount2_longs(&(base_bitfields[sample_ctv2]), sample_ctl2);
-	  for (alt_idx = 2; alt_idx <= alt_ct; alt_idx++) {
-	    uljj = popcount2_longs(&(base_bitfields[sample_ctv2 * alt_idx]), sample_ctl2);
-	    if (uljj > ulii) {
-	      ulii = uljj;
-	      alt_allele_idx = alt_idx;
+	    if (!ujj) {
+	      continue;
 	    }
-	  }
-	}
-      } else {
-	// expect early termination in this case
-	alt_allele_idx = 0;
-	for (sample_idx = 0; sample_idx < sample_ct; sample_idx++, bufptr = &(bufptr2[1])) {
-	  bufptr2 = strchr(bufptr, '\t');
-	  if (!bufptr2) {
-	    if (sample_idx != sample_ct - 1) {
-	      goto vcf_to_bed_ret_MISSING_TOKENS;
+	    g_vcf_bgzf_offsets[block_ct] = raw_used;
+	    g_vcf_bgzf_dests[block_ct++] = bufptr;
+	    bufptr = &(bufptr[ujj]);
+	    raw_used += uii;
+	    region_left -= ujj;
+	  }
+	  if (block_ct) {
+	    g_vcf_bgzf_offsets[block_ct] = raw_used;
+	    g_vcf_bgzf_dests[block_ct] = bufptr;
+	    g_vcf_bgzf_block_ct = block_ct;
+	    g_vcf_bgzf_thread_ct = (block_ct < thread_ct)? block_ct : thread_ct;
+	    g_vcf_bgzf_error = 0;
+	    if (spawn_threads(threads, &vcf_bgzf_inflate_thread, g_vcf_bgzf_thread_ct)) {
+	      goto vcf_to_bed_ret_THREAD_CREATE_FAIL;
 	    }
-	    bufptr2 = &(bufptr[strlen_se(bufptr)]);
-	  }
-	  uii = (unsigned char)(*bufptr) - '0';
-	  if (uii && (uii != alt_allele_idx)) {
-	    if (uii == (uint32_t)(((unsigned char)'.') - '0')) {
-	      continue;
-	    } else if (uii > 9) {
-	      goto vcf_to_bed_ret_INVALID_GT;
-	    } else if (alt_allele_idx) {
-	      goto vcf_to_bed_skip3;
+	    vcf_bgzf_inflate_thread((void*)0);
+	    join_threads(threads, g_vcf_bgzf_thread_ct);
+	    if (g_vcf_bgzf_error) {
+	      goto vcf_to_bed_ret_READ_FAIL;
 	    }
-	    alt_allele_idx = uii;
 	  }
-	  if (gq_field_pos) {
-	    gq_scan_ptr = bufptr;
-	    for (ujj = 0; ujj < gq_field_pos; ujj++) {
-	      gq_scan_ptr = (char*)memchr(gq_scan_ptr, ':', (uintptr_t)(bufptr2 - gq_scan_ptr));
-              if (!gq_scan_ptr) {
-                goto vcf_to_bed_missing_gq_2;
-	      }
-	      gq_scan_ptr++;
+	  fill_end = (uintptr_t)(bufptr - loadbuf);
+	  if (bgzf_pending_len) {
+	    if (raw_used) {
+	      memmove(g_vcf_bgzf_raw, &(g_vcf_bgzf_raw[raw_used]), bgzf_pending_len);
 	    }
-	    if ((!scan_double(gq_scan_ptr, &dxx)) && (dxx < vcf_min_gq)) {
-	      continue;
+	    if (!block_ct) {
+	      // out of room
+	      break;
 	    }
 	  }
-	vcf_to_bed_missing_gq_2:
-	  cc = bufptr[1];
-	  if ((cc != '/') && (cc != '|')) {
-	  vcf_to_bed_haploid_2:
-	    if (gp_field_pos) {
-	      if (vcf_gp_invalid(bufptr, bufptr2, vcf_min_gp, gp_field_pos, uii, &ukk)) {
-		if (ukk) {
-		  goto vcf_to_bed_ret_INVALID_GP;
-		}
-	        continue;
-	      }
-	    }
-	    set_bit_ul(&(base_bitfields[uii * sample_ctv2]), sample_idx * 2 + 1);
-	  } else {
-	    cc = bufptr[3];
-	    if (((cc != '/') && (cc != '|')) || (bufptr[4] == '.')) {
-	      ujj = ((unsigned char)bufptr[2]) - '0';
-	      if (ujj && (ujj != alt_allele_idx)) {
-		if (ujj == (uint32_t)(((unsigned char)'.') - '0')) {
-		  if (!vcf_half_call) {
-		    goto vcf_to_bed_ret_HALF_CALL_ERROR;
-		  } else if (vcf_half_call == VCF_HALF_CALL_HAPLOID) {
-		    goto vcf_to_bed_haploid_2;
-		  }
-		  continue;
-		} else if (ujj > 9) {
-		  goto vcf_to_bed_ret_INVALID_GT;
-		} else if (alt_allele_idx) {
-		  goto vcf_to_bed_skip3;
-		}
-		alt_allele_idx = ujj;
-	      }
-	      if (gp_field_pos) {
-		if (vcf_gp_diploid_invalid(bufptr, bufptr2, vcf_min_gp, gp_field_pos, uii, ujj, &ukk)) {
-		  if (ukk) {
-		    goto vcf_to_bed_ret_INVALID_GP;
-		  }
-		  continue;
-		}
-	      }
-	      set_bit_ul(&(base_bitfields[uii * sample_ctv2]), sample_idx * 2);
-	      base_bitfields[ujj * sample_ctv2 + sample_idx / BITCT2] += ONELU << (2 * (sample_idx % BITCT2));
+	}
+      } else {
+	while ((!at_eof) && (fill_end < fill_target)) {
+	  slen = fill_target - fill_end;
+	  if (slen > 0x40000000) {
+	    slen = 0x40000000;
+	  }
+	  ii = gzread(gz_infile, &(loadbuf[fill_end]), slen);
+	  if (ii < 0) {
+	    goto vcf_to_bed_ret_READ_FAIL;
+	  }
+	  fill_end += (uint32_t)ii;
+	  if ((uint32_t)ii < slen) {
+	    if (!gzeof(gz_infile)) {
+	      goto vcf_to_bed_ret_READ_FAIL;
 	    }
+	    at_eof = 1;
 	  }
 	}
-	if (!alt_allele_idx) {
-	  alt_allele_idx = 1;
+      }
+      // the carried-over partial line never contains a newline, so only the
+      // new data needs to be searched
+      lines_end = &(loadbuf[fill_end]);
+      while ((lines_end != &(loadbuf[ulii])) && (lines_end[-1] != '\n')) {
+	lines_end--;
+      }
+      if ((lines_end != &(loadbuf[ulii])) || at_eof) {
+	break;
+      }
+      if (fill_target == loadbuf_size - 1) {
+	if (!bgzf_regions) {
+	  line_idx++;
+	}
+	if (loadbuf_size == MAXLINEBUFLEN) {
+	  goto vcf_to_bed_ret_LONG_LINE;
 	}
+	goto vcf_to_bed_ret_NOMEM;
       }
-      alt_bitfield = &(base_bitfields[alt_allele_idx * sample_ctv2]);
-    } else {
-      // bleah, multi-digit genotype codes
-      // two-pass read: determine most common alt allele, then actually load it
-      fill_ulong_zero(base_bitfields, 2 * sample_ctv2);
-      alt_bitfield = &(base_bitfields[sample_ctv2]);
-      fill_uint_zero(vcf_alt_cts, alt_ct);
-      geno_start = bufptr;
-      for (sample_idx = 0; sample_idx < sample_ct; sample_idx++, bufptr = &(bufptr2[1])) {
-        bufptr2 = strchr(bufptr, '\t');
-        if (!bufptr2) {
-	  if (sample_idx != sample_ct - 1) {
-	    goto vcf_to_bed_ret_MISSING_TOKENS;
-	  }
-          bufptr2 = &(bufptr[strlen_se(bufptr)]);
+      fill_target += fill_size;
+      if (fill_target > loadbuf_size - 1) {
+	fill_target = loadbuf_size - 1;
+      }
+    }
+    if (at_eof) {
+      if (fill_end && (loadbuf[fill_end - 1] != '\n')) {
+	loadbuf[fill_end++] = '\n';
+      }
+      lines_end = &(loadbuf[fill_end]);
+    }
+    line_ptr = loadbuf;
+    while (1) {
+      // main thread: fixed columns of up to line_max lines
+      batch_ct = 0;
+      header_err = 0;
+      while ((line_ptr != lines_end) && (batch_ct < line_max)) {
+	cur_line = line_ptr;
+	if (!line_pending) {
+	  line_end = (char*)memchr(line_ptr, '\n', (uintptr_t)(lines_end - line_ptr));
+	  *line_end = '\0';
+	  if (!bgzf_regions) {
+	    line_idx++;
+	  }
+	}
+	line_pending = 0;
+	line_ptr = &(line_end[1]);
+	bufptr = skip_initial_spaces(cur_line);
+	if (is_eoln_kns(*bufptr)) {
+	  continue;
 	}
-        uii = (unsigned char)(*bufptr) - '0';
-	if (uii <= 9) {
-	  if (gq_field_pos) {
-	    gq_scan_ptr = bufptr;
-	    for (ujj = 0; ujj < gq_field_pos; ujj++) {
-	      gq_scan_ptr = (char*)memchr(gq_scan_ptr, ':', (uintptr_t)(bufptr2 - gq_scan_ptr));
-	      if (!gq_scan_ptr) {
-                goto vcf_to_bed_missing_gq_3;
-	      }
-	      gq_scan_ptr++;
-	    }
-	    if ((!scan_double(gq_scan_ptr, &dxx)) && (dxx < vcf_min_gq)) {
-	      continue;
-	    }
+	// strchr instead of memchr since we explicitly need to catch premature
+	// \0 here
+	bufptr2 = strchr(bufptr, '\t');
+	if (!bufptr2) {
+	  goto vcf_to_bed_line_MISSING_TOKENS;
+	}
+	ii = get_chrom_code(chrom_info_ptr, bufptr);
+	if (ii < 0) {
+	  if (batch_ct) {
+	    // finish the earlier lines first, so their errors (if any) take
+	    // precedence and messages stay in file order
+	    line_ptr = cur_line;
+	    line_pending = 1;
+	    break;
 	  }
-	vcf_to_bed_missing_gq_3:
-	  while (1) {
-	    ujj = ((unsigned char)(*(++bufptr))) - 48;
-	    if (ujj > 9) {
-	      break;
-	    }
-	    uii = uii * 10 + ujj;
+	  if (chrom_error(".vcf file", chrom_info_ptr, bufptr, line_idx, ii, allow_extra_chroms)) {
+	    goto vcf_to_bed_ret_INVALID_FORMAT;
 	  }
-	  // '/' = ascii 47, '|' = ascii 124
-	  if ((ujj != 0xffffffffU) && (ujj != 76)) {
-	    // haploid, count 2x
-	  vcf_to_bed_haploid_3:
-	    if (gp_field_pos) {
-	      if (vcf_gp_invalid(bufptr, bufptr2, vcf_min_gp, gp_field_pos, uii, &ukk)) {
-		if (ukk) {
-		  goto vcf_to_bed_ret_INVALID_GP;
-		}
-		continue;
-	      }
-	    }
-	    if (!uii) {
-	      set_bit_ul(base_bitfields, sample_idx * 2 + 1);
-	    } else {
-	      vcf_alt_cts[uii - 1] += 2;
-	    }
+	  retval = resolve_or_add_chrom_name(chrom_info_ptr, bufptr, &ii, line_idx, ".vcf file");
+	  if (retval) {
+	    putchar('\n');
+	    goto vcf_to_bed_ret_1;
+	  }
+	}
+	if (!is_set(chrom_info_ptr->chrom_mask, ii)) {
+	  marker_skip_ct++;
+	  continue;
+	}
+	chrom_ptr = bufptr;
+	chrom_len = (uintptr_t)(bufptr2 - bufptr);
+	pos_str = ++bufptr2;
+	marker_id = strchr(bufptr2, '\t');
+	if (!marker_id) {
+	  goto vcf_to_bed_line_MISSING_TOKENS;
+	}
+	if ((((unsigned char)(*pos_str)) - '0') >= 10) {
+	  if (line_idx) {
+	    sprintf(logbuf, "\nError: Invalid variant bp coordinate on line %" PRIuPTR " of .vcf file.\n", line_idx);
 	  } else {
-	    ujj = (unsigned char)(*(++bufptr)) - '0';
-	    if (ujj > 9) {
-	      if (ujj == (uint32_t)(((unsigned char)'.') - '0')) {
-		if (!vcf_half_call) {
-		  goto vcf_to_bed_ret_HALF_CALL_ERROR;
-		} else if (vcf_half_call == VCF_HALF_CALL_HAPLOID) {
-		  goto vcf_to_bed_haploid_3;
-		} else {
-		  continue;
-		}
-	      }
-	      goto vcf_to_bed_ret_INVALID_GT;
+	    sprintf(logbuf, "\nError: Invalid variant bp coordinate in .vcf file.\n");
+	  }
+	  goto vcf_to_bed_line_INVALID_FORMAT_2;
+	}
+	ref_allele_ptr = strchr(++marker_id, '\t');
+	if (!ref_allele_ptr) {
+	  goto vcf_to_bed_line_MISSING_TOKENS;
+	}
+	marker_id_len = (uintptr_t)(ref_allele_ptr - marker_id);
+	bufptr = strchr(++ref_allele_ptr, '\t');
+	// now ref_allele_ptr finally points to the ref allele
+	if (!bufptr) {
+	  goto vcf_to_bed_line_MISSING_TOKENS;
+	}
+	ref_allele_len = (uintptr_t)(bufptr - ref_allele_ptr);
+	alt_ct = 1;
+	alt_alleles = ++bufptr;
+	cc = *bufptr;
+	// ',' < '.'
+	while (1) {
+	  if ((unsigned char)cc <= ',') {
+	    if (line_idx) {
+	      sprintf(logbuf, "\nError: Invalid alternate allele on line %" PRIuPTR " of .vcf file.\n", line_idx);
+	    } else {
+	      sprintf(logbuf, "\nError: Invalid alternate allele in .vcf file.\n");
 	    }
-	    while (1) {
-	      ukk = ((unsigned char)(*(++bufptr))) - 48;
-	      if (ukk > 9) {
-		break;
-	      }
-	      ujj = ujj * 10 + ukk;
-	    }
-	    if (((ukk != 0xffffffffU) && (ukk != 76)) || (bufptr[1] == '.')) {
-	      // diploid; triploid+ skipped
-	      if (gp_field_pos) {
-                if (vcf_gp_diploid_invalid(bufptr, bufptr2, vcf_min_gp, gp_field_pos, uii, ujj, &ukk)) {
-		  if (ukk) {
-		    goto vcf_to_bed_ret_INVALID_GP;
-		  }
-		  continue;
-		}
-	      }
-	      if (!uii) {
-		set_bit_ul(base_bitfields, sample_idx * 2);
-	      } else {
-		vcf_alt_cts[uii - 1] += 1;
-	      }
-	      if (!ujj) {
-		base_bitfields[sample_idx / BITCT2] += ONELU << (2 * (sample_idx % BITCT2));
+	    goto vcf_to_bed_line_INVALID_FORMAT_2;
+	  }
+	  bufptr2 = bufptr;
+	  do {
+	    cc = *(++bufptr);
+	  } while ((unsigned char)cc > ',');
+	  if (((uintptr_t)(bufptr - bufptr2) == ref_allele_len) && (!memcmp(ref_allele_ptr, bufptr2, ref_allele_len))) {
+	    if ((alt_ct != 1) || (cc == ',')) {
+	      if (line_idx) {
+		sprintf(logbuf, "\nError: ALT allele duplicates REF allele on line %" PRIuPTR " of .vcf file.\n", line_idx);
 	      } else {
-		vcf_alt_cts[ujj - 1] += 1;
+		sprintf(logbuf, "\nError: ALT allele duplicates REF allele in .vcf file.\n");
 	      }
+	      goto vcf_to_bed_line_INVALID_FORMAT_2;
 	    }
+	    *alt_alleles = '.'; // tolerate SHAPEIT output
 	  }
-	} else if (uii != (uint32_t)(((unsigned char)'.') - '0')) {
-	  goto vcf_to_bed_ret_INVALID_GT;
-	}
-      }
-      alt_allele_idx = 0;
-      uii = vcf_alt_cts[0];
-      for (alt_idx = 1; alt_idx < alt_ct; alt_idx++) {
-	ujj = vcf_alt_cts[alt_idx];
-	if (biallelic_only && ujj && uii) {
-          goto vcf_to_bed_skip3;
-	}
-        if (ujj > uii) {
-	  alt_allele_idx = alt_idx;
-          uii = vcf_alt_cts[alt_idx];
+	  if (cc != ',') {
+	    break;
+	  }
+	  cc = *(++bufptr);
+	  alt_ct++;
 	}
-      }
-      alt_allele_idx++;
-      bufptr = geno_start;
-      for (sample_idx = 0; sample_idx < sample_ct; sample_idx++, bufptr = &(bufptr2[1])) {
-        bufptr2 = strchr(bufptr, '\t');
-        if (!bufptr2) {
-          bufptr2 = &(bufptr[strlen_se(bufptr)]);
+	if (cc != '\t') {
+	  if (line_idx) {
+	    sprintf(logbuf, "\nError: Malformed ALT field on line %" PRIuPTR " of .vcf file.\n", line_idx);
+	  } else {
+	    sprintf(logbuf, "\nError: Malformed ALT field in .vcf file.\n");
+	  }
+	  goto vcf_to_bed_line_INVALID_FORMAT_2;
 	}
-	if (*bufptr == '.') {
-	  // validated on first pass
+	lptr = &(g_vcf_lines[batch_ct]);
+	if (biallelic_strict && (alt_ct > 1)) {
+	  lptr->marker_id = marker_id;
+	  lptr->marker_id_len = marker_id_len;
+	  lptr->geno_start = NULL;
+	  lptr->result = VCF_GT_SKIP3;
+	  batch_ct++;
 	  continue;
 	}
-	if (gq_field_pos) {
-	  gq_scan_ptr = bufptr;
-	  for (ujj = 0; ujj < gq_field_pos; ujj++) {
-	    gq_scan_ptr = (char*)memchr(gq_scan_ptr, ':', (uintptr_t)(bufptr2 - gq_scan_ptr));
-	    gq_scan_ptr++;
+	bufptr++;
+	bufptr2 = strchr(bufptr, '\t');
+	if (!bufptr2) {
+	  goto vcf_to_bed_line_MISSING_TOKENS;
+	}
+	if (check_qual) {
+	  if (*bufptr == '.') {
+	    marker_skip_ct++;
+	    continue;
 	  }
-	  if ((!scan_double(gq_scan_ptr, &dxx)) && (dxx < vcf_min_gq)) {
+	  if (scan_double(bufptr, &dxx)) {
+	    if (line_idx) {
+	      sprintf(logbuf, "\nError: Invalid QUAL value on line %" PRIuPTR " of .vcf file.\n", line_idx);
+	    } else {
+	      sprintf(logbuf, "\nError: Invalid QUAL value in .vcf file.\n");
+	    }
+	    goto vcf_to_bed_line_INVALID_FORMAT_2;
+	  }
+	  if (dxx < vcf_min_qual) {
+	    marker_skip_ct++;
 	    continue;
 	  }
 	}
-        uii = (unsigned char)(*bufptr) - '0';
-	while (1) {
-	  ujj = ((unsigned char)(*(++bufptr))) - 48;
-	  if (ujj > 9) {
-	    break;
+	bufptr = &(bufptr2[1]);
+	bufptr2 = strchr(bufptr, '\t');
+	if (!bufptr2) {
+	  goto vcf_to_bed_line_MISSING_TOKENS;
+	}
+	bufptr2++;
+	if (fexcept_ct) {
+	  // bugfix: recognize semicolon delimiter
+	  bufptr2[-1] = ';';
+	vcf_to_bed_check_filter:
+	  delimiter_ptr = (char*)memchr(bufptr, ';', (uintptr_t)(bufptr2 - bufptr));
+	  if (bsearch_str(bufptr, (uintptr_t)(delimiter_ptr - bufptr), sorted_fexcepts, max_fexcept_len, fexcept_ct) == -1) {
+	    marker_skip_ct++;
+	    // if we replace the vcf_to_bed_check_filter goto with a while loop,
+	    // can't use "continue" here
+	    continue;
 	  }
-          uii = uii * 10 + ujj;
+	  bufptr = &(delimiter_ptr[1]);
+	  if (bufptr != bufptr2) {
+	    goto vcf_to_bed_check_filter;
+	  }
+	  bufptr2[-1] = '\t';
 	}
-	if ((ujj != 0xffffffffU) && (ujj != 76)) {
-	  if (uii == alt_allele_idx) {
-	  vcf_to_bed_haploid_4:
-	    if (vcf_gp_invalid(bufptr, bufptr2, vcf_min_gp, gp_field_pos, uii, &ukk)) {
-	      // no need for ukk check since already validated
-	      continue;
+	bufptr = bufptr2;
+	bufptr2 = strchr(bufptr, '\t');
+	if (!bufptr2) {
+	  goto vcf_to_bed_line_MISSING_TOKENS;
+	}
+	bufptr = &(bufptr2[1]);
+	bufptr2 = strchr(bufptr, '\t');
+	if (!bufptr2) {
+	  goto vcf_to_bed_line_MISSING_TOKENS;
+	}
+	if (memcmp(bufptr, "GT", 2)) {
+	  marker_skip_ct++;
+	  continue;
+	}
+	bufptr2++;
+	if (vcf_min_gq != -1) {
+	  gq_field_pos = 0;
+	  bufptr2[-1] = ':';
+	  gq_scan_ptr = bufptr;
+	  do {
+	    gq_scan_ptr = (char*)memchr(gq_scan_ptr, ':', (uintptr_t)(bufptr2 - gq_scan_ptr));
+	    if (++gq_scan_ptr == bufptr2) {
+	      gq_field_pos = 0;
+	      break;
 	    }
-            set_bit_ul(alt_bitfield, sample_idx * 2 + 1);
-	  }
-	} else if (*(++bufptr) == '.') {
-	  if ((vcf_half_call == VCF_HALF_CALL_HAPLOID) && (uii == alt_allele_idx)) {
-	    goto vcf_to_bed_haploid_4;
-	  }
-	} else {
-          ujj = (unsigned char)(*bufptr) - '0';
-          while (1) {
-            ukk = ((unsigned char)(*(++bufptr))) - 48;
-            if (ukk > 9) {
+	    gq_field_pos++;
+	  } while (memcmp(gq_scan_ptr, "GQ:", 3));
+	  bufptr2[-1] = '\t';
+	}
+	if (vcf_min_gp != -1) {
+	  gp_field_pos = 0;
+	  bufptr2[-1] = ':';
+	  do {
+	    bufptr = (char*)memchr(bufptr, ':', (uintptr_t)(bufptr2 - bufptr));
+	    if (++bufptr == bufptr2) {
+	      gp_field_pos = 0;
 	      break;
 	    }
-            ujj = ujj * 10 + ukk;
-	  }
-          if (((ukk != 0xffffffffU) && (ukk != 76)) || (bufptr[1] == '.')) {
-	    if (vcf_gp_diploid_invalid(bufptr, bufptr2, vcf_min_gp, gp_field_pos, uii, ujj, &ukk)) {
-	      continue;
+	    gp_field_pos++;
+	  } while (memcmp(bufptr, "GP:", 3));
+	  bufptr2[-1] = '\t';
+	}
+	// okay, finally done with the line header
+	lptr->chrom_ptr = chrom_ptr;
+	lptr->pos_str = pos_str;
+	lptr->marker_id = marker_id;
+	lptr->ref_allele_ptr = ref_allele_ptr;
+	lptr->alt_alleles = alt_alleles;
+	lptr->geno_start = bufptr2;
+	lptr->geno_len = (uintptr_t)(line_end - bufptr2);
+	lptr->line_idx = line_idx;
+	lptr->chrom_len = chrom_len;
+	lptr->marker_id_len = marker_id_len;
+	lptr->alt_ct = alt_ct;
+	lptr->gq_field_pos = gq_field_pos;
+	lptr->gp_field_pos = gp_field_pos;
+	batch_ct++;
+	continue;
+      vcf_to_bed_line_MISSING_TOKENS:
+	header_err = VCF_GT_MISSING_TOKENS;
+	break;
+      vcf_to_bed_line_INVALID_FORMAT_2:
+	// message already in logbuf
+	header_err = 1;
+	break;
+      }
+      if (batch_ct) {
+	// worker threads: genotype columns
+	ujj = (batch_ct < thread_ct)? batch_ct : thread_ct;
+	ws_ranges_init(ujj, 0, batch_ct);
+	if (spawn_threads(threads, &vcf_gt_thread, ujj)) {
+	  goto vcf_to_bed_ret_THREAD_CREATE_FAIL;
+	}
+	vcf_gt_thread((void*)0);
+	join_threads(threads, ujj);
+	// main thread again: output, in file order
+	for (line_uidx = 0; line_uidx < batch_ct; line_uidx++) {
+	  lptr = &(g_vcf_lines[line_uidx]);
+	  alt_allele_idx = lptr->result;
+	  if (alt_allele_idx > MAX_VCF_ALT) {
+	    line_idx = lptr->line_idx;
+	    if (alt_allele_idx == VCF_GT_MISSING_TOKENS) {
+	      goto vcf_to_bed_ret_MISSING_TOKENS;
+	    } else if (alt_allele_idx == VCF_GT_INVALID_GT) {
+	      goto vcf_to_bed_ret_INVALID_GT;
+	    } else if (alt_allele_idx == VCF_GT_HALF_CALL_ERROR) {
+	      goto vcf_to_bed_ret_HALF_CALL_ERROR;
 	    }
-	    if (uii == alt_allele_idx) {
-	      set_bit_ul(alt_bitfield, sample_idx * 2);
+	    goto vcf_to_bed_ret_INVALID_GP;
+	  }
+	  if (alt_allele_idx == VCF_GT_SKIP3) {
+	    if (skip3_list) {
+	      if (!skip3file) {
+		memcpy(outname_end, ".skip.3allele", 14);
+		if (fopen_checked(&skip3file, outname, "w")) {
+		  goto vcf_to_bed_ret_OPEN_FAIL;
+		}
+		memcpy(outname_end, ".bed", 5);
+	      }
+	      marker_id = lptr->marker_id;
+	      marker_id[lptr->marker_id_len] = '\0';
+	      if (fputs_checked(marker_id, skip3file)) {
+		goto vcf_to_bed_ret_WRITE_FAIL;
+	      }
+	      putc('\n', skip3file);
 	    }
-	    if (ujj == alt_allele_idx) {
-              alt_bitfield[sample_idx / BITCT2] += ONELU << (2 * (sample_idx % BITCT2));
+	    marker_skip_ct++;
+	    continue;
+	  }
+	  if (fwrite_checked(&(g_vcf_bed_records[line_uidx * sample_ct4]), sample_ct4, outfile)) {
+	    goto vcf_to_bed_ret_WRITE_FAIL;
+	  }
+	  chrom_ptr = lptr->chrom_ptr;
+	  marker_id = lptr->marker_id;
+	  ref_allele_ptr = lptr->ref_allele_ptr;
+	  alt_alleles = lptr->alt_alleles;
+	  alt_ct = lptr->alt_ct;
+	  chrom_ptr[lptr->chrom_len] = '\0';
+	  fputs(chrom_ptr, bimfile);
+	  putc('\t', bimfile);
+	  fwrite(marker_id, 1, lptr->marker_id_len + 1, bimfile);
+	  putc('0', bimfile);
+	  putc('\t', bimfile);
+	  fwrite(lptr->pos_str, 1, marker_id - lptr->pos_str, bimfile);
+
+	  if (*alt_alleles == '.') {
+	    putc(missing_geno, bimfile);
+	  } else {
+	    bufptr = alt_alleles;
+	    for (alt_idx = 1; alt_idx < alt_allele_idx; alt_idx++) {
+	      bufptr = strchr(bufptr, ',');
+	      bufptr++;
 	    }
+	    bufptr2 = strchr(bufptr, (alt_allele_idx == alt_ct)? '\t' : ',');
+	    *bufptr2 = '\0';
+	    fputs(bufptr, bimfile);
+	  }
+	  putc('\t', bimfile);
+	  alt_alleles[-1] = '\n';
+	  *alt_alleles = '\0';
+	  if (((((unsigned char)ref_allele_ptr[0]) & 0xdf) == 'N') && (ref_allele_ptr[1] == '\t')) {
+	    *ref_allele_ptr = missing_geno;
+	  }
+	  if (fputs_checked(ref_allele_ptr, bimfile)) {
+	    goto vcf_to_bed_ret_WRITE_FAIL;
+	  }
+	  marker_ct++;
+	  if (!(marker_ct % 1000)) {
+	    printf("\r--vcf: %uk variants complete.", marker_ct / 1000);
+	    fflush(stdout);
 	  }
 	}
       }
-    }
-    ref_ptr = base_bitfields;
-    alt_ptr = alt_bitfield;
-    for (sample_idx = 0; sample_idx < sample_ctl2; sample_idx++) {
-      // take ref, then:
-      // * if ref + alt is not two, force to 01
-      // * otherwise, if ref is nonzero, add 1 to match PLINK binary encoding
-      ulii = *ref_ptr;
-      uljj = *alt_ptr++;
-      ulkk = (ulii + uljj) & AAAAMASK;
-      uljj = ulii + ((ulii | (ulii >> 1)) & FIVEMASK);
-      ulii = ulkk | (ulkk >> 1); // 11 in nonmissing positions
-      *ref_ptr++ = (uljj & ulii) | (((~ulkk) >> 1) & FIVEMASK);
-    }
-    ref_ptr[-1] &= final_mask;
-    if (fwrite_checked(base_bitfields, sample_ct4, outfile)) {
-      goto vcf_to_bed_ret_WRITE_FAIL;
-    }
-    chrom_ptr[chrom_len] = '\0';
-    fputs(chrom_ptr, bimfile);
-    putc('\t', bimfile);
-    fwrite(marker_id, 1, marker_id_len + 1, bimfile);
-    putc('0', bimfile);
-    putc('\t', bimfile);
-    fwrite(pos_str, 1, marker_id - pos_str, bimfile);
-
-    if (*alt_alleles == '.') {
-      putc(missing_geno, bimfile);
-    } else {
-      bufptr = alt_alleles;
-      for (alt_idx = 1; alt_idx < alt_allele_idx; alt_idx++) {
-	bufptr = strchr(bufptr, ',');
-	bufptr++;
-      }
-      bufptr2 = strchr(bufptr, (alt_allele_idx == alt_ct)? '\t' : ',');
-      *bufptr2 = '\0';
-      fputs(bufptr, bimfile);
-    }
-    putc('\t', bimfile);
-    alt_alleles[-1] = '\n';
-    *alt_alleles = '\0';
-    if (((((unsigned char)ref_allele_ptr[0]) & 0xdf) == 'N') && (ref_allele_ptr[1] == '\t')) {
-      *ref_allele_ptr = missing_geno;
-    }
-    if (fputs_checked(ref_allele_ptr, bimfile)) {
-      goto vcf_to_bed_ret_WRITE_FAIL;
-    }
-    marker_ct++;
-    if (!(marker_ct % 1000)) {
-      printf("\r--vcf: %uk variants complete.", marker_ct / 1000);
-      fflush(stdout);
-    }
-    continue;
-  vcf_to_bed_skip3:
-    if (skip3_list) {
-      if (!marker_skip_ct) {
-	memcpy(outname_end, ".skip.3allele", 14);
-	if (fopen_checked(&skip3file, outname, "w")) {
-	  goto vcf_to_bed_ret_OPEN_FAIL;
+      if (header_err) {
+	if (header_err == VCF_GT_MISSING_TOKENS) {
+	  goto vcf_to_bed_ret_MISSING_TOKENS;
 	}
-	memcpy(outname_end, ".bed", 5);
+	goto vcf_to_bed_ret_INVALID_FORMAT_2;
       }
-      marker_id[marker_id_len] = '\0';
-      if (fputs_checked(marker_id, skip3file)) {
-	goto vcf_to_bed_ret_WRITE_FAIL;
+      if (line_ptr == lines_end) {
+	break;
       }
-      putc('\n', skip3file);
     }
-    marker_skip_ct++;
+    if (at_eof) {
+      break;
+    }
+    carry_len = (uintptr_t)(&(loadbuf[fill_end]) - lines_end);
+    memmove(loadbuf, lines_end, carry_len);
+  }
+  if (bgzf_regions && (!marker_ct)) {
+    // a full read would have imported the filtered-out variants, and then
+    // load_bim() would have excluded all of them
+    logprint("Error: All variants excluded.\n");
+    goto vcf_to_bed_ret_ALL_MARKERS_EXCLUDED;
   }
   if (fclose_null(&bimfile) || fclose_null(&outfile)) {
     goto vcf_to_bed_ret_WRITE_FAIL;
@@ -8783,7 +11010,11 @@ int32_t vcf_to_bed(char* vcfname, char* outname, char* outname_end, int32_t miss
     retval = RET_WRITE_FAIL;
     break;
   vcf_to_bed_ret_HALF_CALL_ERROR:
-    LOGPRINTF("\nError: Line %" PRIuPTR " of .vcf file has a GT half-call.\n", line_idx);
+    if (line_idx) {
+      LOGPRINTF("\nError: Line %" PRIuPTR " of .vcf file has a GT half-call.\n", line_idx);
+    } else {
+      logprint("\nError: .vcf file has a GT half-call.\n");
+    }
     if (!vcf_half_call_explicit_error) {
       logprint("Use --vcf-half-call to specify how these should be processed.\n");
     }
@@ -8791,27 +11022,50 @@ int32_t vcf_to_bed(char* vcfname, char* outname, char* outname_end, int32_t miss
     break;
   vcf_to_bed_ret_INVALID_GP:
     logprint("\n");
-    LOGPRINTF("Error: Line %" PRIuPTR " of .vcf file has an improperly formatted GP field.\n", line_idx);
+    if (line_idx) {
+      LOGPRINTF("Error: Line %" PRIuPTR " of .vcf file has an improperly formatted GP field.\n", line_idx);
+    } else {
+      logprint("Error: .vcf file has an improperly formatted GP field.\n");
+    }
     retval = RET_INVALID_FORMAT;
     break;
   vcf_to_bed_ret_INVALID_GT:
-    LOGPRINTF("\nError: Line %" PRIuPTR " of .vcf file has an invalid GT field.\n", line_idx);
+    if (line_idx) {
+      LOGPRINTF("\nError: Line %" PRIuPTR " of .vcf file has an invalid GT field.\n", line_idx);
+    } else {
+      logprint("\nError: .vcf file has an invalid GT field.\n");
+    }
     retval = RET_INVALID_FORMAT;
     break;
   vcf_to_bed_ret_MISSING_TOKENS:
-    LOGPRINTF("\nError: Line %" PRIuPTR " of .vcf file has fewer tokens than expected.\n", line_idx);
+    if (line_idx) {
+      LOGPRINTF("\nError: Line %" PRIuPTR " of .vcf file has fewer tokens than expected.\n", line_idx);
+    } else {
+      logprint("\nError: .vcf file has a line with fewer tokens than expected.\n");
+    }
     retval = RET_INVALID_FORMAT;
     break;
   vcf_to_bed_ret_LONG_LINE:
-    sprintf(logbuf, "\nError: Line %" PRIuPTR " of .vcf file is pathologically long.\n", line_idx);
+    if (line_idx) {
+      sprintf(logbuf, "\nError: Line %" PRIuPTR " of .vcf file is pathologically long.\n", line_idx);
+    } else {
+      sprintf(logbuf, "\nError: .vcf file has a pathologically long line.\n");
+    }
   vcf_to_bed_ret_INVALID_FORMAT_2:
     logprintb();
   vcf_to_bed_ret_INVALID_FORMAT:
     retval = RET_INVALID_FORMAT;
     break;
+  vcf_to_bed_ret_THREAD_CREATE_FAIL:
+    retval = RET_THREAD_CREATE_FAIL;
+    break;
+  vcf_to_bed_ret_ALL_MARKERS_EXCLUDED:
+    retval = RET_ALL_MARKERS_EXCLUDED;
+    break;
   }
  vcf_to_bed_ret_1:
   gzclose_cond(gz_infile);
+  fclose_cond(bgzf_infile);
   fclose_cond(outfile);
   fclose_cond(bimfile);
   fclose_cond(skip3file);
@@ -8910,7 +11164,7 @@ int32_t read_bcf_typed_string(gzFile gz_infile, char* readbuf, uint32_t maxlen,
   return retval;
 }
 
-int32_t bcf_to_bed(char* bcfname, char* outname, char* outname_end, int32_t missing_pheno, uint64_t misc_flags, char* const_fid, char id_delim, char vcf_idspace_to, double vcf_min_qual, char* vcf_filter_exceptions_flattened, Chrom_info* chrom_info_ptr) {
+int32_t bcf_to_bed(char* bcfname, char* outname, char* outname_end, int32_t missing_pheno, uint64_t misc_flags, char* const_fid, char id_delim, char vcf_idspace_to, double vcf_min_qual, char* vcf_filter_exceptions_flattened, int32_t marker_pos_start, int32_t marker_pos_end, Chrom_info* chrom_info_ptr) {
   unsigned char* wkspace_mark = wkspace_base;
   gzFile gz_infile = NULL;
   FILE* outfile = NULL;
@@ -8972,6 +11226,11 @@ int32_t bcf_to_bed(char* bcfname, char* outname, char* outname_end, int32_t miss
   uintptr_t uljj;
   uintptr_t ulkk;
   uint64_t lastloc;
+  uint64_t* bgzf_regions = NULL;
+  uintptr_t bgzf_region_ct = 0;
+  uintptr_t bgzf_region_idx = 0;
+  // uncompressed stream position where the current indexed region ends
+  uint64_t region_end = 0;
   uint64_t ullii;
   uint64_t ulljj;
   uint32_t sample_ct4;
@@ -9186,6 +11445,7 @@ int32_t bcf_to_bed(char* bcfname, char* outname, char* outname_end, int32_t miss
   }
   wkspace_left += topsize;
   // topsize = 0;
+  bgzf_index_regions(bcfname, 1, contig_bitfield, chrom_info_ptr, marker_pos_start, marker_pos_end, &bgzf_regions, &bgzf_region_ct);
 
   final_mask = (~ZEROLU) >> (2 * ((0x7fffffe0 - sample_ct) % BITCT2));
   if (wkspace_alloc_c_checked(&loadbuf, sample_ct * 12) ||
@@ -9219,6 +11479,36 @@ int32_t bcf_to_bed(char* bcfname, char* outname, char* outname_end, int32_t miss
   }
   memcpyl3(tbuf2, "\t0\t");
   while (1) {
+#ifndef _WIN32
+    if (bgzf_regions && (((uint64_t)gztell(gz_infile)) >= region_end)) {
+      if (bgzf_region_idx == bgzf_region_ct) {
+	break;
+      }
+      // reopen at the compressed offset of the next region, since zlib can
+      // only seek forward by decompressing everything in between
+      gzclose(gz_infile);
+      gz_infile = NULL;
+      ii = open(bcfname, O_RDONLY);
+      if (ii == -1) {
+	goto bcf_to_bed_ret_OPEN_FAIL;
+      }
+      if (lseek(ii, bgzf_regions[2 * bgzf_region_idx] >> 16, SEEK_SET) == -1) {
+	close(ii);
+	goto bcf_to_bed_ret_READ_FAIL;
+      }
+      gz_infile = gzdopen(ii, "rb");
+      if (!gz_infile) {
+	close(ii);
+	goto bcf_to_bed_ret_NOMEM;
+      }
+      if (gzbuffer(gz_infile, 131072) || (gzseek(gz_infile, bgzf_regions[2 * bgzf_region_idx] & 0xffff, SEEK_SET) == -1)) {
+	goto bcf_to_bed_ret_READ_FAIL;
+      }
+      region_end = (bgzf_regions[2 * bgzf_region_idx] & 0xffff) + bgzf_regions[2 * bgzf_region_idx + 1];
+      bgzf_region_idx++;
+      continue;
+    }
+#endif
     lastloc = gztell(gz_infile) + 8;
     if (gzread(gz_infile, bcf_var_header, 32) < 32) {
       break;
@@ -9650,6 +11940,11 @@ int32_t bcf_to_bed(char* bcfname, char* outname, char* outname_end, int32_t miss
     marker_skip_ct++;
   }
   if (!marker_ct) {
+    if (bgzf_regions) {
+      // see vcf_to_bed()
+      logprint("Error: All variants excluded.\n");
+      goto bcf_to_bed_ret_ALL_MARKERS_EXCLUDED;
+    }
     logprint("Error: No variants in .bcf file.\n");
     goto bcf_to_bed_ret_INVALID_FORMAT;
   }
@@ -9698,6 +11993,9 @@ int32_t bcf_to_bed(char* bcfname, char* outname, char* outname_end, int32_t miss
   bcf_to_bed_ret_INVALID_FORMAT:
     retval = RET_INVALID_FORMAT;
     break;
+  bcf_to_bed_ret_ALL_MARKERS_EXCLUDED:
+    retval = RET_ALL_MARKERS_EXCLUDED;
+    break;
   }
  bcf_to_bed_ret_1:
   gzclose_cond(gz_infile);
@@ -11191,6 +13489,8 @@ int32_t recode_allele_load(char* loadbuf, uintptr_t loadbuf_size, char* recode_a
   if (retval) {
     goto recode_allele_load_ret_1;
   }
+  // sorted_ids/id_map were just allocated where the caller's buffer started
+  recode_allele_extra = (char*)wkspace_base;
   loadbuf[loadbuf_size - 1] = ' ';
   while (fgets(loadbuf, loadbuf_size, rafile)) {
     line_idx++;
@@ -11298,7 +13598,8 @@ uint32_t recode_load_to(unsigned char* loadbuf, FILE* bedfile, uintptr_t bed_off
   return 0;
 }
 
-static inline int32_t recode_write_first_cols(FILE* outfile, uintptr_t sample_uidx, char delimiter, char* sample_ids, uintptr_t max_sample_id_len, char* paternal_ids, uintptr_t max_paternal_id_len, char* maternal_ids, uintptr_t max_maternal_id_len, uintptr_t* sex_nm, uintptr_t* sex_male, uintptr_t* pheno_nm, uintptr_t* pheno_c, double* pheno_d, const char* output_missing_pheno) {
+static inline int32_t recode_write_first_cols(FILE* outfile, uintptr_t sample_uidx, char delimiter, char* sample_ids, uintptr_t max_sample_id_len, char* paternal_ids, uintptr_t max_paternal_id_len, char* maternal_ids, uintptr_t max_maternal_id_len, uintptr_t* sex_nm, uintptr_t* sex_male, uintptr_t* pheno_nm, uintptr_t* pheno_c, double* pheno_d, const char* output_missing_pheno, char last_char) {
+  // last_char is normally the delimiter, since genotype columns follow
   char wbuf[16];
   char* cptr = &(sample_ids[sample_uidx * max_sample_id_len]);
   uintptr_t ulii = strlen_se(cptr);
@@ -11320,7 +13621,7 @@ static inline int32_t recode_write_first_cols(FILE* outfile, uintptr_t sample_ui
     cptr = double_g_write(wbuf, pheno_d[sample_uidx]);
     fwrite(wbuf, 1, cptr - wbuf, outfile);
   }
-  if (putc_checked(delimiter, outfile)) {
+  if (putc_checked(last_char, outfile)) {
     return -1;
   }
   return 0;
@@ -11513,7 +13814,7 @@ uint32_t write_ped_lines(FILE* outfile, unsigned char* loadbuf, uintptr_t* marke
   missing4[3] = delimiter;
   for (sample_idx = sample_idx_start; sample_idx < sample_idx_end; sample_uidx++, sample_idx++) {
     next_unset_ul_unsafe_ck(sample_exclude, &sample_uidx);
-    if (recode_write_first_cols(outfile, sample_uidx, delimiter, sample_ids, max_sample_id_len, paternal_ids, max_paternal_id_len, maternal_ids, max_maternal_id_len, sex_nm, sex_male, pheno_nm, pheno_c, pheno_d, output_missing_pheno)) {
+    if (recode_write_first_cols(outfile, sample_uidx, delimiter, sample_ids, max_sample_id_len, paternal_ids, max_paternal_id_len, maternal_ids, max_maternal_id_len, sex_nm, sex_male, pheno_nm, pheno_c, pheno_d, output_missing_pheno, delimiter)) {
       return 1;
     }
     bufptr = &(loadbuf[sample_uidx / 4]);
@@ -11652,6 +13953,299 @@ int32_t flexbputc_checked(unsigned char ucc, uint32_t output_bgz, FILE* outfile,
   }
 }
 
+// --recode A/AD/A-transpose dosage matrix generation.  For 'A' and 'AD', the
+// full variant-major matrix is already in memory; each thread transposes
+// tiles of RECODE_A_TILE_SAMPLES adjacent samples, so every variant row is
+// visited once per tile instead of once per sample.  For 'A-transpose', blocks
+// of collapsed variant rows are rendered in parallel.  Rows are written in
+// order by the main thread either way.
+#define RECODE_A_BLOCK_MAX 1024
+#define RECODE_A_TILE_SAMPLES 64
+#define RECODE_A_TRANSPOSE_CLAIM 8
+
+static unsigned char* g_recode_a_geno;
+static uintptr_t g_recode_a_geno_stride;
+static uint32_t* g_recode_a_sample_uidxs;
+// per-variant 'all counted alleles missing' flags; NULL if none
+static unsigned char* g_recode_a_allele_missing;
+static uintptr_t g_recode_a_marker_ct;
+static uintptr_t g_recode_a_sample_ct;
+static char* g_recode_a_text;
+static uintptr_t* g_recode_a_text_lens;
+// bin4 output; replaces g_recode_a_text when present
+static float* g_recode_a_floats;
+static uintptr_t g_recode_a_row_stride;
+static char* g_recode_a_ad_strs;
+static char g_recode_a_delimiter;
+
+static const float g_recode_a_float_vals[8] = {2.0, NAN, 1.0, 0.0, 0.0, NAN, 0.0, 0.0};
+
+THREAD_RET_TYPE recode_a_thread(void* arg) {
+  uintptr_t tidx = (uintptr_t)arg;
+  unsigned char* allele_missing = g_recode_a_allele_missing;
+  uintptr_t geno_stride = g_recode_a_geno_stride;
+  uintptr_t marker_ct = g_recode_a_marker_ct;
+  uintptr_t row_stride = g_recode_a_row_stride;
+  float* floats = g_recode_a_floats;
+  char* ad_strs = g_recode_a_ad_strs;
+  char delimiter = g_recode_a_delimiter;
+  char* wbufptrs[RECODE_A_TILE_SAMPLES];
+  uint32_t byte_offsets[RECODE_A_TILE_SAMPLES];
+  uint32_t shifts[RECODE_A_TILE_SAMPLES];
+  unsigned char* bufptr;
+  const float* fvals;
+  const char* dosage_chars;
+  char* wbufptr;
+  uintptr_t marker_idx;
+  uint32_t block_idx;
+  uint32_t block_idx_end;
+  uint32_t tile_ct;
+  uint32_t tile_idx;
+  uint32_t sample_uidx;
+  uint32_t cur_missing;
+  uint32_t ucc;
+  while (ws_claim(tidx, RECODE_A_TILE_SAMPLES, &block_idx, &block_idx_end)) {
+    tile_ct = block_idx_end - block_idx;
+    for (tile_idx = 0; tile_idx < tile_ct; tile_idx++) {
+      sample_uidx = g_recode_a_sample_uidxs[block_idx + tile_idx];
+      byte_offsets[tile_idx] = sample_uidx / 4;
+      shifts[tile_idx] = (sample_uidx % 4) * 2;
+      if (!floats) {
+	wbufptrs[tile_idx] = &(g_recode_a_text[(block_idx + tile_idx) * row_stride]);
+      }
+    }
+    bufptr = g_recode_a_geno;
+    for (marker_idx = 0; marker_idx < marker_ct; marker_idx++, bufptr = &(bufptr[geno_stride])) {
+      cur_missing = allele_missing && allele_missing[marker_idx];
+      if (floats) {
+	fvals = &(g_recode_a_float_vals[cur_missing * 4]);
+	for (tile_idx = 0; tile_idx < tile_ct; tile_idx++) {
+	  ucc = (bufptr[byte_offsets[tile_idx]] >> shifts[tile_idx]) & 3;
+	  floats[(block_idx + tile_idx) * marker_ct + marker_idx] = fvals[ucc];
+	}
+      } else if (!ad_strs) {
+	dosage_chars = cur_missing? "0N00" : "2N10";
+	for (tile_idx = 0; tile_idx < tile_ct; tile_idx++) {
+	  ucc = (bufptr[byte_offsets[tile_idx]] >> shifts[tile_idx]) & 3;
+	  wbufptr = wbufptrs[tile_idx];
+	  *wbufptr++ = dosage_chars[ucc];
+	  if (ucc == 1) {
+	    *wbufptr++ = 'A';
+	  }
+	  *wbufptr++ = delimiter;
+	  wbufptrs[tile_idx] = wbufptr;
+	}
+      } else {
+	for (tile_idx = 0; tile_idx < tile_ct; tile_idx++) {
+	  ucc = (bufptr[byte_offsets[tile_idx]] >> shifts[tile_idx]) & 3;
+	  if (ucc != 1) {
+	    wbufptrs[tile_idx] = memcpya(wbufptrs[tile_idx], &(ad_strs[4 * (cur_missing? 3 : ucc)]), 4);
+	  } else {
+	    wbufptrs[tile_idx] = memcpya(wbufptrs[tile_idx], &(ad_strs[16]), 6);
+	  }
+	}
+      }
+    }
+    if (!floats) {
+      for (tile_idx = 0; tile_idx < tile_ct; tile_idx++) {
+	wbufptr = wbufptrs[tile_idx];
+	wbufptr[-1] = '\n';
+	g_recode_a_text_lens[block_idx + tile_idx] = (uintptr_t)(wbufptr - (&(g_recode_a_text[(block_idx + tile_idx) * row_stride])));
+      }
+    }
+  }
+  THREAD_RETURN;
+}
+
+THREAD_RET_TYPE recode_a_transpose_thread(void* arg) {
+  uintptr_t tidx = (uintptr_t)arg;
+  uintptr_t sample_ct = g_recode_a_sample_ct;
+  uintptr_t sample_ctl2 = (sample_ct + (BITCT2 - 1)) / BITCT2;
+  uintptr_t row_stride = g_recode_a_row_stride;
+  unsigned char* allele_missing = g_recode_a_allele_missing;
+  float* floats = g_recode_a_floats;
+  char delimiter = g_recode_a_delimiter;
+  uintptr_t* ulptr;
+  const float* fvals;
+  const char* dosage_chars;
+  char* wbufptr_start;
+  char* wbufptr;
+  float* fptr;
+  uintptr_t cur_word;
+  uintptr_t widx;
+  uint32_t block_idx;
+  uint32_t block_idx_end;
+  uint32_t cur_missing;
+  uint32_t shiftmax;
+  uint32_t shiftval;
+  uint32_t ucc;
+  while (ws_claim(tidx, RECODE_A_TRANSPOSE_CLAIM, &block_idx, &block_idx_end)) {
+    for (; block_idx < block_idx_end; block_idx++) {
+      ulptr = (uintptr_t*)(&(g_recode_a_geno[block_idx * g_recode_a_geno_stride]));
+      cur_missing = allele_missing && allele_missing[block_idx];
+      fvals = &(g_recode_a_float_vals[cur_missing * 4]);
+      dosage_chars = cur_missing? "0N00" : "2N10";
+      fptr = floats? (&(floats[block_idx * sample_ct])) : NULL;
+      wbufptr_start = floats? NULL : (&(g_recode_a_text[block_idx * row_stride]));
+      wbufptr = wbufptr_start;
+      shiftmax = BITCT2;
+      for (widx = 0; widx < sample_ctl2; widx++) {
+	if (widx == sample_ctl2 - 1) {
+	  shiftmax = ((sample_ct - 1) % BITCT2) + 1;
+	}
+	cur_word = ulptr[widx];
+	if (fptr) {
+	  for (shiftval = 0; shiftval < shiftmax; shiftval++) {
+	    *fptr++ = fvals[cur_word & 3];
+	    cur_word >>= 2;
+	  }
+	} else {
+	  for (shiftval = 0; shiftval < shiftmax; shiftval++) {
+	    ucc = cur_word & 3;
+	    *wbufptr++ = delimiter;
+	    *wbufptr++ = dosage_chars[ucc];
+	    if (ucc == 1) {
+	      *wbufptr++ = 'A';
+	    }
+	    cur_word >>= 2;
+	  }
+	}
+      }
+      if (!fptr) {
+	*wbufptr++ = '\n';
+	g_recode_a_text_lens[block_idx] = (uintptr_t)(wbufptr - wbufptr_start);
+      }
+    }
+  }
+  THREAD_RETURN;
+}
+
+// --recode vcf formats blocks of variants in parallel.  The main thread loads
+// and collapses each block, worker threads render one complete line per
+// variant into fixed-stride slots, and the slots are then written (and, for
+// bgz output, handed to the bgzf_mt compressor) in the original order.
+#define RECODE_VCF_BLOCK_MAX 1024
+#define RECODE_VCF_CLAIM 8
+
+// 0 = diploid, 1 = haploid, 2 = X (males haploid)
+#define RECODE_VCF_GT_DIPLOID 0
+#define RECODE_VCF_GT_HAPLOID 1
+#define RECODE_VCF_GT_X 2
+
+static Chrom_info* g_recode_vcf_chrom_info_ptr;
+static uint32_t* g_recode_vcf_marker_pos;
+static char* g_recode_vcf_marker_ids;
+static uintptr_t g_recode_vcf_max_marker_id_len;
+static char** g_recode_vcf_allele_ptrs;
+static uintptr_t* g_recode_vcf_sample_male_include2;
+static uintptr_t g_recode_vcf_sample_ct;
+static uint32_t g_recode_vcf_real_ref_alleles;
+static uintptr_t* g_recode_vcf_geno;
+static uint32_t* g_recode_vcf_marker_uidxs;
+static uint32_t* g_recode_vcf_chrom_idxs;
+static unsigned char* g_recode_vcf_gt_modes;
+static char* g_recode_vcf_text;
+static uintptr_t g_recode_vcf_text_stride;
+static uintptr_t* g_recode_vcf_text_lens;
+static uint32_t g_recode_vcf_invalid_allele_seen[MAX_THREADS];
+
+THREAD_RET_TYPE recode_vcf_thread(void* arg) {
+  uintptr_t tidx = (uintptr_t)arg;
+  Chrom_info* chrom_info_ptr = g_recode_vcf_chrom_info_ptr;
+  char** mk_allele_ptrs = g_recode_vcf_allele_ptrs;
+  const char* missing_geno_ptr = g_missing_geno_ptr;
+  uintptr_t max_marker_id_len = g_recode_vcf_max_marker_id_len;
+  uintptr_t sample_ct = g_recode_vcf_sample_ct;
+  uintptr_t sample_ctv2 = 2 * ((sample_ct + (BITCT - 1)) / BITCT);
+  uintptr_t sample_ctl2 = (sample_ct + (BITCT2 - 1)) / BITCT2;
+  uintptr_t text_stride = g_recode_vcf_text_stride;
+  const char* fixed_cols = g_recode_vcf_real_ref_alleles? "\t.\t.\t.\tGT" : "\t.\t.\tPR\tGT";
+  uint32_t fixed_cols_len = g_recode_vcf_real_ref_alleles? 9 : 10;
+  uint32_t invalid_allele_seen = 0;
+  const char* gt_strs = "\t1/1\t./.\t0/1\t0/0";
+  uintptr_t* ulptr;
+  uintptr_t* ulptr2;
+  char* wbufptr_start;
+  char* wbufptr;
+  char* cptr;
+  uintptr_t marker_uidx;
+  uintptr_t cur_word;
+  uintptr_t ref_word;
+  uintptr_t widx;
+  uint32_t block_idx;
+  uint32_t block_idx_end;
+  uint32_t gt_mode;
+  uint32_t gt_len;
+  uint32_t shiftmax;
+  uint32_t shiftval;
+  while (ws_claim(tidx, RECODE_VCF_CLAIM, &block_idx, &block_idx_end)) {
+    for (; block_idx < block_idx_end; block_idx++) {
+      marker_uidx = g_recode_vcf_marker_uidxs[block_idx];
+      ulptr = &(g_recode_vcf_geno[block_idx * sample_ctv2]);
+      wbufptr_start = &(g_recode_vcf_text[block_idx * text_stride]);
+      *wbufptr_start = '\n';
+      wbufptr = chrom_name_write(&(wbufptr_start[1]), chrom_info_ptr, g_recode_vcf_chrom_idxs[block_idx]);
+      *wbufptr++ = '\t';
+      wbufptr = uint32_writex(wbufptr, g_recode_vcf_marker_pos[marker_uidx], '\t');
+      wbufptr = strcpyax(wbufptr, &(g_recode_vcf_marker_ids[marker_uidx * max_marker_id_len]), '\t');
+      cptr = mk_allele_ptrs[2 * marker_uidx + 1];
+      if (cptr == missing_geno_ptr) {
+	*wbufptr++ = 'N';
+      } else {
+	if ((!invalid_allele_seen) && (!valid_vcf_allele_code(cptr))) {
+	  invalid_allele_seen = 1;
+	}
+	wbufptr = strcpya(wbufptr, cptr);
+      }
+      *wbufptr++ = '\t';
+      cptr = mk_allele_ptrs[2 * marker_uidx];
+      if (cptr != missing_geno_ptr) {
+	if ((!invalid_allele_seen) && (!valid_vcf_allele_code(cptr))) {
+	  invalid_allele_seen = 1;
+	}
+	// if ALT allele is not actually present in immediate dataset, VCF spec
+	// actually requires '.'
+	if (!is_monomorphic_a2(ulptr, sample_ct)) {
+	  wbufptr = strcpya(wbufptr, cptr);
+	} else {
+	  *wbufptr++ = '.';
+	}
+      } else {
+	*wbufptr++ = '.';
+      }
+      wbufptr = memcpya(wbufptr, fixed_cols, fixed_cols_len);
+      gt_mode = g_recode_vcf_gt_modes[block_idx];
+      gt_len = (gt_mode == RECODE_VCF_GT_HAPLOID)? 2 : 4;
+      ulptr2 = g_recode_vcf_sample_male_include2;
+      shiftmax = BITCT2;
+      for (widx = 0; widx < sample_ctl2; widx++) {
+	if (widx == sample_ctl2 - 1) {
+	  shiftmax = ((sample_ct - 1) % BITCT2) + 1;
+	}
+	cur_word = ulptr[widx];
+	if (gt_mode != RECODE_VCF_GT_X) {
+	  for (shiftval = 0; shiftval < shiftmax; shiftval++) {
+	    wbufptr = memcpya(wbufptr, &(gt_strs[(cur_word & 3) * 4]), gt_len);
+	    cur_word >>= 2;
+	  }
+	} else {
+	  ref_word = ulptr2[widx] << 1;
+	  for (shiftval = 0; shiftval < shiftmax; shiftval++) {
+	    wbufptr = memcpya(wbufptr, &(gt_strs[(cur_word & 3) * 4]), 4 - (ref_word & 3));
+	    cur_word >>= 2;
+	    ref_word >>= 2;
+	  }
+	}
+      }
+      g_recode_vcf_text_lens[block_idx] = (uintptr_t)(wbufptr - wbufptr_start);
+    }
+  }
+  if (invalid_allele_seen) {
+    g_recode_vcf_invalid_allele_seen[tidx] = 1;
+  }
+  THREAD_RETURN;
+}
+
 int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, char* outname, char* outname_end, char* recode_allele_name, uintptr_t unfiltered_marker_ct, uintptr_t* marker_exclude, uintptr_t marker_ct, uintptr_t unfiltered_sample_ct, uintptr_t* sample_exclude, uintptr_t sample_ct, char* marker_ids, uintptr_t max_marker_id_len, double* marker_cms, char** marker_allele_ptrs, uintptr_t max_marker_allele_len, uint32_t* marker_pos, uintptr_t* marker_reverse, char* sample_ids, uintptr_t max_sample_id_len, char* paternal_ids, uintptr_t max_paternal_id_len, char* maternal_ids, uintptr_t max_maternal_id_len, uintptr_t* sex_nm, uintptr_t* sex_male, uintptr_t* pheno_nm, uintptr_t* pheno_c, double* pheno_d, char* output_missing_pheno, uint32_t map_is_unsorted, uint64_t misc_flags, uint32_t hh_exists, Chrom_info* chrom_info_ptr) {
   FILE* outfile = NULL;
   FILE* outfile2 = NULL;
@@ -11667,7 +14261,6 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, ch
   char** mk_allele_ptrs = marker_allele_ptrs;
   char** allele_missing = NULL;
   char* recode_allele_extra = NULL;
-  const char* missing_geno_ptr = g_missing_geno_ptr;
   char delim2 = delimiter;
   uintptr_t* sample_include2 = NULL;
   uintptr_t* sample_male_include2 = NULL;
@@ -11681,6 +14274,7 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, ch
   uint32_t recode_012 = recode_modifier & (RECODE_01 | RECODE_12);
   uint32_t set_hh_missing = (misc_flags / MISC_SET_HH_MISSING) & 1;
   uint32_t real_ref_alleles = (misc_flags / MISC_REAL_REF_ALLELES) & 1;
+  uint32_t recode_bin4 = (recode_modifier / RECODE_BIN4) & 1;
   uint32_t xmhh_exists_orig = hh_exists & XMHH_EXISTS;
   uintptr_t header_len = 0;
   uintptr_t max_chrom_size = 0;
@@ -11701,12 +14295,16 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, ch
   uint32_t* fid_map = NULL;
   uint32_t* missing_cts = NULL;
   char* cur_mk_allelesx_buf = NULL;
+  uint32_t* sample_uidxs = NULL;
+  uint32_t* block_marker_uidxs = NULL;
+  uint32_t* block_chrom_idxs = NULL;
+  uint32_t thread_ct = g_thread_ct;
   int32_t retval = 0;
+  pthread_t threads[MAX_THREADS];
   char* writebufl[4];
   char* writebuflp[4];
   char* writebuflps[4];
   char* cur_mk_allelesx[6];
-  char cur_dosage_chars[4];
   uint32_t cmalen[4];
   time_t rawtime;
   struct tm *loctime;
@@ -11725,7 +14323,6 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, ch
   uintptr_t sample_idx;
   unsigned char* loadbuf;
   uintptr_t* ulptr;
-  uintptr_t* ulptr2;
   uintptr_t* ulptr_end;
   unsigned char* bufptr;
   char* wbufptr;
@@ -11749,7 +14346,11 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, ch
   uint32_t shiftval;
   uint32_t shiftmax;
   uint32_t cur_fid;
+  uint32_t block_max;
+  uint32_t block_ct;
+  uint32_t block_idx;
   uint32_t uii;
+  uint32_t ujj;
   int32_t ii;
   if (!hh_exists) {
     set_hh_missing = 0;
@@ -11800,11 +14401,7 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, ch
       }
     }
   }
-  if (recode_modifier & RECODE_VCF) {
-    if (wkspace_alloc_c_checked(&writebuf, sample_ct * 4)) {
-      goto recode_ret_NOMEM;
-    }
-  } else if (recode_modifier & RECODE_OXFORD) {
+  if (recode_modifier & RECODE_OXFORD) {
     if (wkspace_alloc_c_checked(&writebuf, sample_ct * 6) ||
         wkspace_alloc_ui_checked(&missing_cts, sample_ct * sizeof(int32_t))) {
       goto recode_ret_NOMEM;
@@ -12046,9 +14643,6 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, ch
       // format is new to PLINK 1.9, so use tab delimiter unless 'spacex'
       // modifier present
       delimiter = ((recode_modifier & (RECODE_TAB | RECODE_DELIMX)) == RECODE_DELIMX)? ' ' : '\t';
-      if (wkspace_alloc_c_checked(&writebuf, sample_ct * 3 + 1)) {
-        goto recode_ret_NOMEM;
-      }
     } else {
       if (recode_modifier & RECODE_AD) {
 	if (wkspace_alloc_c_checked(&writebuf2, 32)) {
@@ -12119,14 +14713,14 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, ch
 	    ulii *= 2;
 	  }
 	}
-	if (recode_modifier & (RECODE_A | RECODE_AD | RECODE_COMPOUND)) {
+	if (recode_modifier & (RECODE_A | RECODE_AD)) {
+	  // row buffers are allocated after the genotype matrix is loaded
+	} else if (recode_modifier & RECODE_COMPOUND) {
 	  if (wkspace_alloc_c_checked(&writebuf, max_chrom_size * ulii)) {
 	    goto recode_ret_NOMEM;
 	  }
-	  if (recode_modifier & RECODE_COMPOUND) {
-	    memset(writebuf, delimiter, max_chrom_size * 3 - 1);
-	    writebuf[max_chrom_size * 3 - 1] = '\n';
-	  }
+	  memset(writebuf, delimiter, max_chrom_size * 3 - 1);
+	  writebuf[max_chrom_size * 3 - 1] = '\n';
 	} else {
 	  // --recode, --recode HV
 	  if (wkspace_alloc_c_checked(&writebuf, ulii)) {
@@ -12307,88 +14901,119 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, ch
     if (putc_checked('\n', outfile)) {
       goto recode_ret_WRITE_FAIL;
     }
-    LOGPRINTFWW5("--recode A-transpose to %s ... ", outname);
+    if (recode_bin4) {
+      memcpy(outname_end, ".traw.bin", 10);
+      if (fopen_checked(&outfile2, outname, "wb")) {
+	goto recode_ret_OPEN_FAIL;
+      }
+      *outname_end = '\0';
+      LOGPRINTFWW5("--recode A-transpose bin4 to %s.traw + %s.traw.bin ... ", outname, outname);
+    } else {
+      LOGPRINTFWW5("--recode A-transpose to %s ... ", outname);
+    }
     fputs("0%", stdout);
     fflush(stdout);
-    cptr = chrom_name_write(tbuf, chrom_info_ptr, chrom_idx);
-    *cptr++ = delimiter;
+    if (recode_bin4) {
+      ulii = sample_ct * sizeof(float);
+    } else {
+      ulii = CACHEALIGN(sample_ct * 3 + 1);
+    }
+    uljj = ulii + sample_ctv2 * sizeof(intptr_t) + sizeof(intptr_t) + 2 * sizeof(int32_t) + 1;
+    if (wkspace_left < unfiltered_sample_ct4 + 6 * CACHELINE) {
+      goto recode_ret_NOMEM;
+    }
+    uljj = (wkspace_left - unfiltered_sample_ct4 - 6 * CACHELINE) / uljj;
+    if (!uljj) {
+      goto recode_ret_NOMEM;
+    }
+    block_max = (uljj > RECODE_A_BLOCK_MAX)? RECODE_A_BLOCK_MAX : ((uint32_t)uljj);
+    if (recode_bin4) {
+      g_recode_a_floats = (float*)wkspace_alloc(block_max * ulii);
+      g_recode_a_text = NULL;
+    } else {
+      g_recode_a_floats = NULL;
+      g_recode_a_text = (char*)wkspace_alloc(block_max * ulii);
+    }
+    g_recode_a_geno = (unsigned char*)wkspace_alloc(block_max * sample_ctv2 * sizeof(intptr_t));
+    g_recode_a_text_lens = (uintptr_t*)wkspace_alloc(block_max * sizeof(intptr_t));
+    block_marker_uidxs = (uint32_t*)wkspace_alloc(block_max * sizeof(int32_t));
+    block_chrom_idxs = (uint32_t*)wkspace_alloc(block_max * sizeof(int32_t));
+    g_recode_a_allele_missing = (unsigned char*)wkspace_alloc(block_max);
+    loadbuf = wkspace_base;
+    g_recode_a_geno_stride = sample_ctv2 * sizeof(intptr_t);
+    g_recode_a_sample_ct = sample_ct;
+    g_recode_a_row_stride = ulii;
+    g_recode_a_delimiter = delimiter;
     for (pct = 1; pct <= 100; pct++) {
       loop_end = (((uint64_t)pct) * marker_ct) / 100;
-      for (; marker_idx < loop_end; marker_uidx++, marker_idx++) {
-	if (IS_SET(marker_exclude, marker_uidx)) {
-	  marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-	  if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_sample_ct4, SEEK_SET)) {
+      while (marker_idx < loop_end) {
+	block_ct = ((loop_end - marker_idx) > block_max)? block_max : ((uint32_t)(loop_end - marker_idx));
+	for (block_idx = 0; block_idx < block_ct; marker_uidx++, block_idx++) {
+	  if (IS_SET(marker_exclude, marker_uidx)) {
+	    marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
+	    if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_sample_ct4, SEEK_SET)) {
+	      goto recode_ret_READ_FAIL;
+	    }
+	  }
+	  if (marker_uidx >= chrom_end) {
+	    chrom_fo_idx++;
+	    refresh_chrom_info(chrom_info_ptr, marker_uidx, &chrom_end, &chrom_fo_idx, &is_x, &is_y, &is_mt, &is_haploid);
+	    chrom_idx = chrom_info_ptr->chrom_file_order[chrom_fo_idx];
+	  }
+	  ulptr = (uintptr_t*)(&(g_recode_a_geno[block_idx * g_recode_a_geno_stride]));
+	  if (load_and_collapse(bedfile, (uintptr_t*)loadbuf, unfiltered_sample_ct, ulptr, sample_ct, sample_exclude, final_mask, IS_NONNULL_AND_SET(recode_allele_reverse, marker_uidx) ^ IS_SET(marker_reverse, marker_uidx))) {
 	    goto recode_ret_READ_FAIL;
 	  }
-	}
-	if (marker_uidx >= chrom_end) {
-	  chrom_fo_idx++;
-	  refresh_chrom_info(chrom_info_ptr, marker_uidx, &chrom_end, &chrom_fo_idx, &is_x, &is_y, &is_mt, &is_haploid);
-	  chrom_idx = chrom_info_ptr->chrom_file_order[chrom_fo_idx];
-	  cptr = chrom_name_write(tbuf, chrom_info_ptr, chrom_idx);
-	  *cptr++ = delimiter;
-	}
-	wbufptr = strcpyax(cptr, &(marker_ids[marker_uidx * max_marker_id_len]), delimiter);
-	if (!marker_cms) {
-	  *wbufptr++ = '0';
-	} else {
-	  wbufptr = double_g_write(wbufptr, marker_cms[marker_uidx]);
-	}
-	*wbufptr++ = delimiter;
-	wbufptr = uint32_writex(wbufptr, marker_pos[marker_uidx], delimiter);
-        if (fwrite_checked(tbuf, wbufptr - tbuf, outfile)) {
-	  goto recode_ret_WRITE_FAIL;
-	}
-	uii = IS_NONNULL_AND_SET(recode_allele_reverse, marker_uidx);
-	if (allele_missing && allele_missing[marker_uidx]) {
-	  fputs(allele_missing[marker_uidx], outfile);
-	  putc(delimiter, outfile);
-          fputs(mk_allele_ptrs[2 * marker_uidx + uii], outfile);
-	  putc(',', outfile);
-	} else {
-	  fputs(mk_allele_ptrs[2 * marker_uidx + uii], outfile);
-	  putc(delimiter, outfile);
-	}
-	fputs(mk_allele_ptrs[2 * marker_uidx + 1 - uii], outfile);
-	if (load_and_collapse(bedfile, (uintptr_t*)loadbuf, unfiltered_sample_ct, loadbuf_collapsed, sample_ct, sample_exclude, final_mask, uii ^ IS_SET(marker_reverse, marker_uidx))) {
-	  goto recode_ret_READ_FAIL;
-	}
-	if (is_haploid && set_hh_missing) {
-          haploid_fix(hh_exists, sample_include2, sample_male_include2, sample_ct, is_x, is_y, (unsigned char*)loadbuf_collapsed);
-	}
-	ulptr = loadbuf_collapsed;
-	ulptr_end = &(loadbuf_collapsed[sample_ct / BITCT2]);
-	shiftmax = BITCT2;
-	wbufptr = writebuf;
-	if (allele_missing && allele_missing[marker_uidx]) {
-	  // all 0s and NAs
-	  memcpy(cur_dosage_chars, "0N00", 4);
-	} else {
-	  memcpy(cur_dosage_chars, "2N10", 4);
-	}
-	while (1) {
-	  while (ulptr < ulptr_end) {
-	    cur_word = *ulptr++;
-	    for (shiftval = 0; shiftval < shiftmax; shiftval++) {
-	      ulii = cur_word & 3;
-	      *wbufptr++ = delimiter;
-	      *wbufptr++ = cur_dosage_chars[ulii];
-	      if (ulii == 1) {
-		*wbufptr++ = 'A';
-	      }
-	      cur_word >>= 2;
-	    }
+	  if (is_haploid && set_hh_missing) {
+	    haploid_fix(hh_exists, sample_include2, sample_male_include2, sample_ct, is_x, is_y, (unsigned char*)ulptr);
+	  }
+	  block_marker_uidxs[block_idx] = marker_uidx;
+	  block_chrom_idxs[block_idx] = chrom_idx;
+	  g_recode_a_allele_missing[block_idx] = allele_missing && allele_missing[marker_uidx];
+	}
+	ujj = (block_ct < thread_ct * RECODE_A_TRANSPOSE_CLAIM)? ((block_ct + RECODE_A_TRANSPOSE_CLAIM - 1) / RECODE_A_TRANSPOSE_CLAIM) : thread_ct;
+	ws_ranges_init(ujj, 0, block_ct);
+	if (spawn_threads(threads, &recode_a_transpose_thread, ujj)) {
+	  goto recode_ret_THREAD_CREATE_FAIL;
+	}
+	recode_a_transpose_thread((void*)0);
+	join_threads(threads, ujj);
+	for (block_idx = 0; block_idx < block_ct; block_idx++) {
+	  uidx_cur = block_marker_uidxs[block_idx];
+	  wbufptr = chrom_name_write(tbuf, chrom_info_ptr, block_chrom_idxs[block_idx]);
+	  *wbufptr++ = delimiter;
+	  wbufptr = strcpyax(wbufptr, &(marker_ids[uidx_cur * max_marker_id_len]), delimiter);
+	  if (!marker_cms) {
+	    *wbufptr++ = '0';
+	  } else {
+	    wbufptr = double_g_write(wbufptr, marker_cms[uidx_cur]);
+	  }
+	  *wbufptr++ = delimiter;
+	  wbufptr = uint32_writex(wbufptr, marker_pos[uidx_cur], delimiter);
+	  if (fwrite_checked(tbuf, wbufptr - tbuf, outfile)) {
+	    goto recode_ret_WRITE_FAIL;
+	  }
+	  uii = IS_NONNULL_AND_SET(recode_allele_reverse, uidx_cur);
+	  if (allele_missing && allele_missing[uidx_cur]) {
+	    fputs(allele_missing[uidx_cur], outfile);
+	    putc(delimiter, outfile);
+	    fputs(mk_allele_ptrs[2 * uidx_cur + uii], outfile);
+	    putc(',', outfile);
+	  } else {
+	    fputs(mk_allele_ptrs[2 * uidx_cur + uii], outfile);
+	    putc(delimiter, outfile);
 	  }
-	  if (ulptr == loadbuf_collapsed_end) {
-	    break;
+	  fputs(mk_allele_ptrs[2 * uidx_cur + 1 - uii], outfile);
+	  if (recode_bin4) {
+	    putc('\n', outfile);
+	    if (fwrite_checked(&(g_recode_a_floats[block_idx * sample_ct]), ulii, outfile2)) {
+	      goto recode_ret_WRITE_FAIL;
+	    }
+	  } else if (fwrite_checked(&(g_recode_a_text[block_idx * ulii]), g_recode_a_text_lens[block_idx], outfile)) {
+	    goto recode_ret_WRITE_FAIL;
 	  }
-	  ulptr_end++;
-	  shiftmax = sample_ct % BITCT2;
-	}
-	*wbufptr++ = '\n';
-	if (fwrite_checked(writebuf, wbufptr - writebuf, outfile)) {
-	  goto recode_ret_WRITE_FAIL;
 	}
+	marker_idx += block_ct;
       }
       if (pct < 100) {
 	if (pct > 10) {
@@ -12501,133 +15126,92 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, ch
 	}
       }
     }
+    // each variant is rendered into a fixed-stride slot; 32 bytes covers the
+    // delimiters, the position, and the fixed QUAL..FORMAT columns
+    ulii = CACHEALIGN(get_max_chrom_len(chrom_info_ptr) + max_marker_id_len + 2 * max_marker_allele_len + 4 * sample_ct + 32);
+    uljj = ulii + sample_ctv2 * sizeof(intptr_t) + sizeof(intptr_t) + 2 * sizeof(int32_t) + 1;
+    if (wkspace_left < unfiltered_sample_ct4 + 6 * CACHELINE) {
+      goto recode_ret_NOMEM;
+    }
+    uljj = (wkspace_left - unfiltered_sample_ct4 - 6 * CACHELINE) / uljj;
+    if (!uljj) {
+      goto recode_ret_NOMEM;
+    }
+    block_max = (uljj > RECODE_VCF_BLOCK_MAX)? RECODE_VCF_BLOCK_MAX : ((uint32_t)uljj);
+    g_recode_vcf_text = (char*)wkspace_alloc(block_max * ulii);
+    g_recode_vcf_geno = (uintptr_t*)wkspace_alloc(block_max * sample_ctv2 * sizeof(intptr_t));
+    g_recode_vcf_text_lens = (uintptr_t*)wkspace_alloc(block_max * sizeof(intptr_t));
+    g_recode_vcf_marker_uidxs = (uint32_t*)wkspace_alloc(block_max * sizeof(int32_t));
+    g_recode_vcf_chrom_idxs = (uint32_t*)wkspace_alloc(block_max * sizeof(int32_t));
+    g_recode_vcf_gt_modes = (unsigned char*)wkspace_alloc(block_max);
+    loadbuf = wkspace_base;
+    g_recode_vcf_chrom_info_ptr = chrom_info_ptr;
+    g_recode_vcf_marker_pos = marker_pos;
+    g_recode_vcf_marker_ids = marker_ids;
+    g_recode_vcf_max_marker_id_len = max_marker_id_len;
+    g_recode_vcf_allele_ptrs = mk_allele_ptrs;
+    g_recode_vcf_sample_male_include2 = sample_male_include2;
+    g_recode_vcf_sample_ct = sample_ct;
+    g_recode_vcf_real_ref_alleles = real_ref_alleles;
+    g_recode_vcf_text_stride = ulii;
+    fill_uint_zero(g_recode_vcf_invalid_allele_seen, MAX_THREADS);
     LOGPRINTFWW5("--recode vcf%s%s to %s ... ", vcf_not_iid? (vcf_not_fid? "" : "-fid") : "-iid", output_bgz? " bgz" : "", outname);
     fputs("0%", stdout);
     fflush(stdout);
-    tbuf[0] = '\n';
-    if (((!hh_exists) || set_hh_missing) && is_haploid && (!is_x)) {
-      uii = 2;
+    if (hh_exists && (!set_hh_missing)) {
+      uii = RECODE_VCF_GT_DIPLOID;
+    } else if (is_x) {
+      uii = RECODE_VCF_GT_X;
     } else {
-      uii = 4;
+      uii = is_haploid? RECODE_VCF_GT_HAPLOID : RECODE_VCF_GT_DIPLOID;
     }
     for (pct = 1; pct <= 100; pct++) {
       loop_end = (((uint64_t)pct) * marker_ct) / 100;
-      for (; marker_idx < loop_end; marker_uidx++, marker_idx++) {
-	if (IS_SET(marker_exclude, marker_uidx)) {
-          marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-	  if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_sample_ct4, SEEK_SET)) {
-	    goto recode_ret_READ_FAIL;
-	  }
-	}
-	if (marker_uidx >= chrom_end) {
-	  chrom_fo_idx++;
-	  refresh_chrom_info(chrom_info_ptr, marker_uidx, &chrom_end, &chrom_fo_idx, &is_x, &is_y, &is_mt, &is_haploid);
-	  chrom_idx = chrom_info_ptr->chrom_file_order[chrom_fo_idx];
-	  if (((!hh_exists) || set_hh_missing) && is_haploid && (!is_x)) {
-	    uii = 2;
-	  } else {
-	    uii = 4;
+      while (marker_idx < loop_end) {
+	block_ct = ((loop_end - marker_idx) > block_max)? block_max : ((uint32_t)(loop_end - marker_idx));
+	for (block_idx = 0; block_idx < block_ct; marker_uidx++, block_idx++) {
+	  if (IS_SET(marker_exclude, marker_uidx)) {
+	    marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
+	    if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_sample_ct4, SEEK_SET)) {
+	      goto recode_ret_READ_FAIL;
+	    }
 	  }
-	}
-	wbufptr = chrom_name_write(&(tbuf[1]), chrom_info_ptr, chrom_idx);
-	*wbufptr++ = '\t';
-	wbufptr = uint32_writex(wbufptr, marker_pos[marker_uidx], '\t');
-	wbufptr = strcpyax(wbufptr, &(marker_ids[marker_uidx * max_marker_id_len]), '\t');
-	if (flexbwrite_checked(tbuf, wbufptr - tbuf, output_bgz, outfile, bgz_outfile)) {
-	  goto recode_ret_WRITE_FAIL;
-	}
-	cptr = mk_allele_ptrs[2 * marker_uidx + 1];
-	if (cptr == missing_geno_ptr) {
-	  if (flexbputc_checked('N', output_bgz, outfile, bgz_outfile)) {
-	    goto recode_ret_WRITE_FAIL;
+	  if (marker_uidx >= chrom_end) {
+	    chrom_fo_idx++;
+	    refresh_chrom_info(chrom_info_ptr, marker_uidx, &chrom_end, &chrom_fo_idx, &is_x, &is_y, &is_mt, &is_haploid);
+	    chrom_idx = chrom_info_ptr->chrom_file_order[chrom_fo_idx];
+	    if (hh_exists && (!set_hh_missing)) {
+	      uii = RECODE_VCF_GT_DIPLOID;
+	    } else if (is_x) {
+	      uii = RECODE_VCF_GT_X;
+	    } else {
+	      uii = is_haploid? RECODE_VCF_GT_HAPLOID : RECODE_VCF_GT_DIPLOID;
+	    }
 	  }
-	} else {
-          if ((!invalid_allele_code_seen) && (!valid_vcf_allele_code(cptr))) {
-            invalid_allele_code_seen = 1;
+	  ulptr = &(g_recode_vcf_geno[block_idx * sample_ctv2]);
+	  if (load_and_collapse(bedfile, (uintptr_t*)loadbuf, unfiltered_sample_ct, ulptr, sample_ct, sample_exclude, final_mask, IS_SET(marker_reverse, marker_uidx))) {
+	    goto recode_ret_READ_FAIL;
 	  }
-	  if (flexbputs_checked(cptr, output_bgz, outfile, bgz_outfile)) {
-	    goto recode_ret_WRITE_FAIL;
+	  if (is_haploid && set_hh_missing) {
+	    haploid_fix(hh_exists, sample_include2, sample_male_include2, sample_ct, is_x, is_y, (unsigned char*)ulptr);
 	  }
+	  g_recode_vcf_marker_uidxs[block_idx] = marker_uidx;
+	  g_recode_vcf_chrom_idxs[block_idx] = chrom_idx;
+	  g_recode_vcf_gt_modes[block_idx] = uii;
 	}
-	if (flexbputc_checked('\t', output_bgz, outfile, bgz_outfile)) {
-	  goto recode_ret_WRITE_FAIL;
-	}
-
-	if (load_and_collapse(bedfile, (uintptr_t*)loadbuf, unfiltered_sample_ct, loadbuf_collapsed, sample_ct, sample_exclude, final_mask, IS_SET(marker_reverse, marker_uidx))) {
-	  goto recode_ret_READ_FAIL;
-	}
-	if (is_haploid && set_hh_missing) {
-	  haploid_fix(hh_exists, sample_include2, sample_male_include2, sample_ct, is_x, is_y, (unsigned char*)loadbuf_collapsed);
+	marker_idx += block_ct;
+	ujj = (block_ct < thread_ct * RECODE_VCF_CLAIM)? ((block_ct + RECODE_VCF_CLAIM - 1) / RECODE_VCF_CLAIM) : thread_ct;
+	ws_ranges_init(ujj, 0, block_ct);
+	if (spawn_threads(threads, &recode_vcf_thread, ujj)) {
+	  goto recode_ret_THREAD_CREATE_FAIL;
 	}
-
-	cptr = mk_allele_ptrs[2 * marker_uidx];
-	if (cptr != missing_geno_ptr) {
-          if ((!invalid_allele_code_seen) && (!valid_vcf_allele_code(cptr))) {
-	    invalid_allele_code_seen = 1;
-	  }
-	  // if ALT allele is not actually present in immediate dataset, VCF
-	  // spec actually requires '.'
-	  if (!is_monomorphic_a2(loadbuf_collapsed, sample_ct)) {
-	    if (flexbputs_checked(cptr, output_bgz, outfile, bgz_outfile)) {
-	      goto recode_ret_WRITE_FAIL;
-	    }
-	  } else {
-	    if (flexbputc_checked('.', output_bgz, outfile, bgz_outfile)) {
-	      goto recode_ret_WRITE_FAIL;
-	    }
-	  }
-	} else {
-	  if (flexbputc_checked('.', output_bgz, outfile, bgz_outfile)) {
+	recode_vcf_thread((void*)0);
+	join_threads(threads, ujj);
+	for (block_idx = 0; block_idx < block_ct; block_idx++) {
+	  if (flexbwrite_checked(&(g_recode_vcf_text[block_idx * g_recode_vcf_text_stride]), g_recode_vcf_text_lens[block_idx], output_bgz, outfile, bgz_outfile)) {
 	    goto recode_ret_WRITE_FAIL;
 	  }
 	}
-	if (flexbputs_checked(real_ref_alleles? "\t.\t.\t.\tGT" : "\t.\t.\tPR\tGT", output_bgz, outfile, bgz_outfile)) {
-	  goto recode_ret_WRITE_FAIL;
-	}
-	wbufptr = writebuf;
-	ulptr = loadbuf_collapsed;
-	ulptr_end = &(loadbuf_collapsed[sample_ct / BITCT2]);
-	shiftmax = BITCT2;
-	if ((!is_x) || (hh_exists && (!set_hh_missing))) {
-	  while (1) {
-	    while (ulptr < ulptr_end) {
-	      cur_word = *ulptr++;
-	      for (shiftval = 0; shiftval < shiftmax; shiftval++) {
-		ulii = cur_word & 3;
-		wbufptr = memcpya(wbufptr, &(cur_mk_allelesx_buf[ulii * 4]), uii);
-		cur_word >>= 2;
-	      }
-	    }
-	    if (ulptr == loadbuf_collapsed_end) {
-	      break;
-	    }
-	    ulptr_end++;
-	    shiftmax = sample_ct % BITCT2;
-	  }
-	} else {
-	  ulptr2 = sample_male_include2;
-	  while (1) {
-	    while (ulptr < ulptr_end) {
-	      cur_word = *ulptr++;
-	      ref_word = (*ulptr2++) << 1;
-	      for (shiftval = 0; shiftval < shiftmax; shiftval++) {
-		ulii = cur_word & 3;
-		uljj = ref_word & 3;
-		wbufptr = memcpya(wbufptr, &(cur_mk_allelesx_buf[ulii * 4]), 4 - uljj);
-		cur_word >>= 2;
-		ref_word >>= 2;
-	      }
-	    }
-	    if (ulptr == loadbuf_collapsed_end) {
-	      break;
-	    }
-	    ulptr_end++;
-	    shiftmax = sample_ct % BITCT2;
-	  }
-	}
-	if (flexbwrite_checked(writebuf, wbufptr - writebuf, output_bgz, outfile, bgz_outfile)) {
-	  goto recode_ret_WRITE_FAIL;
-	}
       }
       if (pct < 100) {
 	if (pct > 10) {
@@ -12637,6 +15221,9 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, ch
 	fflush(stdout);
       }
     }
+    for (uii = 0; uii < thread_ct; uii++) {
+      invalid_allele_code_seen |= g_recode_vcf_invalid_allele_seen[uii];
+    }
     if (flexbputc_checked('\n', output_bgz, outfile, bgz_outfile)) {
       goto recode_ret_WRITE_FAIL;
     }
@@ -13427,73 +16014,106 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, ch
       goto recode_ret_WRITE_FAIL;
     }
     marker_uidx = 0;
-    LOGPRINTFWW5("--recode A%s to %s ... ", (recode_modifier & RECODE_AD)? "D" : "", outname);
+    if (recode_bin4) {
+      memcpy(outname_end, ".raw.bin", 9);
+      if (fopen_checked(&outfile2, outname, "wb")) {
+	goto recode_ret_OPEN_FAIL;
+      }
+      *outname_end = '\0';
+      LOGPRINTFWW5("--recode A bin4 to %s.raw + %s.raw.bin ... ", outname, outname);
+    } else {
+      LOGPRINTFWW5("--recode A%s to %s ... ", (recode_modifier & RECODE_AD)? "D" : "", outname);
+    }
     if (!recode_allele_reverse) {
       recode_allele_reverse = marker_reverse;
     } else {
       bitfield_xor(recode_allele_reverse, marker_reverse, unfiltered_marker_ctl);
     }
+    g_recode_a_allele_missing = NULL;
+    if (allele_missing) {
+      if (wkspace_alloc_uc_checked(&g_recode_a_allele_missing, marker_ct)) {
+	goto recode_ret_NOMEM;
+      }
+      for (marker_uidx = 0, marker_idx = 0; marker_idx < marker_ct; marker_uidx++, marker_idx++) {
+	next_unset_ul_unsafe_ck(marker_exclude, &marker_uidx);
+	g_recode_a_allele_missing[marker_idx] = (allele_missing[marker_uidx] != NULL);
+      }
+      marker_uidx = 0;
+    }
+    if (wkspace_alloc_ui_checked(&sample_uidxs, sample_ct * sizeof(int32_t))) {
+      goto recode_ret_NOMEM;
+    }
+    for (sample_uidx = 0, sample_idx = 0; sample_idx < sample_ct; sample_uidx++, sample_idx++) {
+      next_unset_ul_unsafe_ck(sample_exclude, &sample_uidx);
+      sample_uidxs[sample_idx] = sample_uidx;
+    }
+    loadbuf = (unsigned char*)wkspace_alloc(marker_ct * unfiltered_sample_ct4);
+    if (!loadbuf) {
+      goto recode_ret_NO_MULTIPASS_YET;
+    }
+    // text rows need at most 3 ('A') or 6 ('AD') bytes per variant
+    if (recode_bin4) {
+      ulii = marker_ct * sizeof(float);
+    } else {
+      ulii = CACHEALIGN(marker_ct * ((recode_modifier & RECODE_AD)? 6 : 3));
+    }
+    uljj = (wkspace_left - 2 * CACHELINE) / (ulii + sizeof(intptr_t));
+    if (!uljj) {
+      goto recode_ret_NOMEM;
+    }
+    block_max = (uljj > RECODE_A_BLOCK_MAX)? RECODE_A_BLOCK_MAX : ((uint32_t)uljj);
+    g_recode_a_text_lens = (uintptr_t*)wkspace_alloc(block_max * sizeof(intptr_t));
+    if (recode_bin4) {
+      g_recode_a_floats = (float*)wkspace_alloc(block_max * ulii);
+      g_recode_a_text = NULL;
+    } else {
+      g_recode_a_floats = NULL;
+      g_recode_a_text = (char*)wkspace_alloc(block_max * ulii);
+    }
     if (recode_load_to(loadbuf, bedfile, bed_offset, unfiltered_marker_ct, 0, marker_ct, marker_exclude, recode_allele_reverse, &marker_uidx, unfiltered_sample_ct)) {
       goto recode_ret_READ_FAIL;
     }
     if (set_hh_missing) {
       haploid_fix_multiple(marker_exclude, 0, marker_ct, chrom_info_ptr, hh_exists, sample_include2, sample_male_include2, unfiltered_sample_ct, unfiltered_sample_ct4, loadbuf);
     }
+    g_recode_a_geno = loadbuf;
+    g_recode_a_geno_stride = unfiltered_sample_ct4;
+    g_recode_a_marker_ct = marker_ct;
+    g_recode_a_row_stride = ulii;
+    g_recode_a_ad_strs = (recode_modifier & RECODE_AD)? writebuf2 : NULL;
+    g_recode_a_delimiter = delimiter;
     fputs("0%", stdout);
-    sample_uidx = 0;
     sample_idx = 0;
     for (pct = 1; pct <= 100; pct++) {
       loop_end = ((uint64_t)pct * sample_ct) / 100;
-      for (; sample_idx < loop_end; sample_uidx++, sample_idx++) {
-	sample_uidx = next_unset_ul_unsafe(sample_exclude, sample_uidx);
-	if (recode_write_first_cols(outfile, sample_uidx, delimiter, sample_ids, max_sample_id_len, paternal_ids, max_paternal_id_len, maternal_ids, max_maternal_id_len, sex_nm, sex_male, pheno_nm, pheno_c, pheno_d, output_missing_pheno)) {
-	  goto recode_ret_WRITE_FAIL;
-	}
-	bufptr = &(loadbuf[sample_uidx / 4]);
-	wbufptr = writebuf;
-	shiftval = (sample_uidx % 4) * 2;
-	marker_uidx = 0;
-	marker_idx = 0;
-	if (recode_modifier & RECODE_A) {
-	  do {
-	    marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-	    ulii = next_set_ul(marker_exclude, marker_uidx, unfiltered_marker_ct);
-	    marker_idx += ulii - marker_uidx;
-	    do {
-	      ucc = ((*bufptr) >> shiftval) & 3;
-	      if (allele_missing && allele_missing[marker_uidx]) {
-		*wbufptr++ = "0N00"[ucc];
-	      } else {
-		*wbufptr++ = "2N10"[ucc];
-	      }
-	      if (ucc == 1) {
-		*wbufptr++ = 'A';
-	      }
-	      *wbufptr++ = delimiter;
-	      bufptr = &(bufptr[unfiltered_sample_ct4]);
-	    } while (++marker_uidx < ulii);
-	  } while (marker_idx < marker_ct);
-	} else {
-	  do {
-	    marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-	    ulii = next_set_ul(marker_exclude, marker_uidx, unfiltered_marker_ct);
-	    marker_idx += ulii - marker_uidx;
-	    do {
-	      ucc = ((*bufptr) >> shiftval) & 3;
-	      if (ucc != 1) {
-		wbufptr = memcpya(wbufptr, &(writebuf2[4 * ((allele_missing && allele_missing[marker_uidx])? 3 : ucc)]), 4);
-	      } else {
-		wbufptr = memcpya(wbufptr, &(writebuf2[16]), 6);
-	      }
-	      bufptr = &(bufptr[unfiltered_sample_ct4]);
-	    } while (++marker_uidx < ulii);
-	  } while (marker_idx < marker_ct);
-	}
-	wbufptr[-1] = '\n';
-	ulii = (uintptr_t)(wbufptr - writebuf);
-	if (fwrite_checked(writebuf, ulii, outfile)) {
-	  goto recode_ret_WRITE_FAIL;
+      while (sample_idx < loop_end) {
+	block_ct = ((loop_end - sample_idx) > block_max)? block_max : ((uint32_t)(loop_end - sample_idx));
+	g_recode_a_sample_uidxs = &(sample_uidxs[sample_idx]);
+	ujj = (block_ct + (RECODE_A_TILE_SAMPLES - 1)) / RECODE_A_TILE_SAMPLES;
+	if (ujj > thread_ct) {
+	  ujj = thread_ct;
+	}
+	ws_ranges_init(ujj, 0, block_ct);
+	if (spawn_threads(threads, &recode_a_thread, ujj)) {
+	  goto recode_ret_THREAD_CREATE_FAIL;
+	}
+	recode_a_thread((void*)0);
+	join_threads(threads, ujj);
+	for (block_idx = 0; block_idx < block_ct; block_idx++) {
+	  if (recode_write_first_cols(outfile, sample_uidxs[sample_idx + block_idx], delimiter, sample_ids, max_sample_id_len, paternal_ids, max_paternal_id_len, maternal_ids, max_maternal_id_len, sex_nm, sex_male, pheno_nm, pheno_c, pheno_d, output_missing_pheno, recode_bin4? '\n' : delimiter)) {
+	    goto recode_ret_WRITE_FAIL;
+	  }
+	  if (recode_bin4) {
+	    if (fwrite_checked(&(g_recode_a_floats[block_idx * marker_ct]), ulii, outfile2)) {
+	      goto recode_ret_WRITE_FAIL;
+	    }
+	  } else {
+	    if (fwrite_checked(&(g_recode_a_text[block_idx * ulii]), g_recode_a_text_lens[block_idx], outfile)) {
+	      goto recode_ret_WRITE_FAIL;
+	    }
+	  }
 	}
+	sample_idx += block_ct;
       }
       if (pct < 100) {
 	if (pct > 10) {
@@ -13932,6 +16552,10 @@ int32_t recode(uint32_t recode_modifier, FILE* bedfile, uintptr_t bed_offset, ch
   recode_ret_INVALID_FORMAT:
     retval = RET_INVALID_FORMAT;
     break;
+  recode_ret_THREAD_CREATE_FAIL:
+    putchar('\n');
+    retval = RET_THREAD_CREATE_FAIL;
+    break;
   recode_ret_NO_MULTIPASS_YET:
     // probably want to implement this later
     logprint("Error: --recode does not yet support multipass recoding of very large files;\ncontact the " PROG_NAME_CAPS " developers if you need this.\nFor now, you can try using a machine with more memory, and/or split the file\ninto smaller pieces and recode them separately.\n");
@@ -14709,19 +17333,92 @@ uint32_t merge_alleles(char** marker_allele_ptrs, uint32_t marker_uidx, uint32_t
   return 0;
 }
 
+int32_t merge_order_same_pos_ids(int64_t* ll_buf, uint32_t* chrom_start, uint32_t chrom_ct, char* marker_ids, uintptr_t max_marker_id_len, char** marker_allele_ptrs, double* marker_cms_tmp) {
+  // ll_buf is sorted by position (high 32 bits), with ties broken by pre-sort
+  // index.  Within each run of same-position variants, reassign the pre-sort
+  // indices in marker ID ASCII order (permuting marker_ids[],
+  // marker_allele_ptrs[], and marker_cms_tmp[] to match), so that ties are
+  // resolved by variant ID.  Only these runs require a string sort.
+  unsigned char* wkspace_mark = wkspace_base;
+  char* run_ids;
+  char** run_allele_ptrs;
+  double* run_cms;
+  uint32_t* run_map;
+  uint32_t* run_slots;
+  uint64_t cur_bp;
+  uint32_t chrom_idx;
+  uint32_t chrom_end;
+  uint32_t run_start;
+  uint32_t run_end;
+  uint32_t run_len;
+  uint32_t run_idx;
+  uint32_t marker_idx;
+  for (chrom_idx = 0; chrom_idx < chrom_ct; chrom_idx++) {
+    chrom_end = chrom_start[chrom_idx + 1];
+    for (run_start = chrom_start[chrom_idx]; run_start < chrom_end; run_start = run_end) {
+      cur_bp = ((uint64_t)ll_buf[run_start]) >> 32;
+      for (run_end = run_start + 1; run_end < chrom_end; run_end++) {
+	if ((((uint64_t)ll_buf[run_end]) >> 32) != cur_bp) {
+	  break;
+	}
+      }
+      run_len = run_end - run_start;
+      if (run_len == 1) {
+	continue;
+      }
+      if (wkspace_alloc_c_checked(&run_ids, run_len * max_marker_id_len) ||
+          wkspace_alloc_ui_checked(&run_map, run_len * sizeof(int32_t)) ||
+          wkspace_alloc_ui_checked(&run_slots, run_len * sizeof(int32_t)) ||
+          wkspace_alloc_d_checked(&run_cms, run_len * sizeof(double))) {
+	return 1;
+      }
+      run_allele_ptrs = (char**)wkspace_alloc(run_len * 2 * sizeof(intptr_t));
+      if (!run_allele_ptrs) {
+	return 1;
+      }
+      for (run_idx = 0; run_idx < run_len; run_idx++) {
+	marker_idx = (uint32_t)ll_buf[run_start + run_idx];
+	run_map[run_idx] = marker_idx;
+	run_slots[run_idx] = marker_idx;
+	strcpy(&(run_ids[run_idx * max_marker_id_len]), &(marker_ids[marker_idx * max_marker_id_len]));
+      }
+      if (qsort_ext(run_ids, run_len, max_marker_id_len, strcmp_deref, (char*)run_map, sizeof(int32_t))) {
+	return 1;
+      }
+      // run_slots[] is already in ascending order
+      for (run_idx = 0; run_idx < run_len; run_idx++) {
+	marker_idx = run_map[run_idx];
+	run_allele_ptrs[run_idx * 2] = marker_allele_ptrs[marker_idx * 2];
+	run_allele_ptrs[run_idx * 2 + 1] = marker_allele_ptrs[marker_idx * 2 + 1];
+	run_cms[run_idx] = marker_cms_tmp[marker_idx];
+      }
+      for (run_idx = 0; run_idx < run_len; run_idx++) {
+	marker_idx = run_slots[run_idx];
+	strcpy(&(marker_ids[marker_idx * max_marker_id_len]), &(run_ids[run_idx * max_marker_id_len]));
+	marker_allele_ptrs[marker_idx * 2] = run_allele_ptrs[run_idx * 2];
+	marker_allele_ptrs[marker_idx * 2 + 1] = run_allele_ptrs[run_idx * 2 + 1];
+	marker_cms_tmp[marker_idx] = run_cms[run_idx];
+      }
+      wkspace_reset(wkspace_mark);
+    }
+  }
+  return 0;
+}
+
 static inline uint32_t merge_post_msort_update_maps(char* marker_ids, uintptr_t max_marker_id_len, uint32_t* marker_map, double* marker_cms, double* marker_cms_tmp, uint32_t* pos_buf, int64_t* ll_buf, uint32_t* chrom_start, uint32_t* chrom_id, uint32_t chrom_ct, uint32_t* dedup_marker_ct_ptr, uint32_t merge_equal_pos, char** marker_allele_ptrs, Chrom_info* chrom_info_ptr) {
   // Input: ll_buf is a sequence of sorted arrays (one per chromosome) with
   // base-pair positions in high 32 bits, and pre-sort indices in low 32 bits.
   // Chromosome boundaries are stored in chrom_start[].
-  // Pre-sort indices refer to marker ID ASCII ordering, which is how lookup
-  // will be performed mid-merge.  There may be duplicate positions, and
+  // Pre-sort indices are in hash table traversal order, except that
+  // same-position runs are in marker ID ASCII order (see
+  // merge_order_same_pos_ids()).  There may be duplicate positions, and
   // markers that don't pass the chromosome filter.
 
   // Result: Duplicates have been collapsed, with chrom_start[] updated.
   // pos_buf contains sorted base-pair positions,
   // post-chromosome-filtering-and-duplicate-removal.
-  // marker_map[n] is the post-filtering position in all other arrays of marker
-  // ID n by ASCII ordering.
+  // marker_map[n] is the post-filtering position in all other arrays of
+  // pre-sort marker n.
   uintptr_t* chrom_mask = chrom_info_ptr->chrom_mask;
   uint32_t read_pos = 0;
   uint32_t write_pos = 0; // may be lower than read_pos due to dups
@@ -14801,6 +17498,138 @@ static inline int32_t merge_first_mode(int32_t mm, uint32_t merge_equal_pos) {
   }
 }
 
+void merge_bed_row(uintptr_t* rbufptr, uint32_t cur_sample_ct, uint32_t* flex_map, unsigned char* wbufptr, uintptr_t* mbufptr, uint32_t merge_mode) {
+  // Merges one variant's (already allele-aligned) genotype row from a binary
+  // fileset into the corresponding output row, for merge modes 1-5.
+  uintptr_t sample_idx;
+  uintptr_t sample_idx_cur_max;
+  uintptr_t cur_word;
+  uintptr_t ulii;
+  unsigned char* wbufptr2;
+  uint32_t ujj;
+  uint32_t ukk;
+  uint32_t umm;
+  uint32_t unn;
+  unsigned char ucc;
+  unsigned char ucc2;
+  switch (merge_mode) {
+  case 1: // difference -> missing
+    sample_idx = 0;
+    do {
+      sample_idx_cur_max = sample_idx + BITCT2;
+      if (sample_idx_cur_max > cur_sample_ct) {
+	sample_idx_cur_max = cur_sample_ct;
+      }
+      cur_word = *rbufptr++;
+      for (; sample_idx < sample_idx_cur_max; sample_idx++) {
+	ucc = cur_word & 3;
+	// bugfix: do NOT set flag, etc. on missing call
+	if (ucc != 1) {
+	  ujj = flex_map[sample_idx];
+	  ukk = ujj / BITCT;
+	  ulii = ONELU << (ujj % BITCT);
+	  wbufptr2 = &(wbufptr[ujj / 4]);
+	  umm = (ujj % 4) * 2;
+	  unn = 3U << umm;
+	  if (mbufptr[ukk] & ulii) {
+	    ucc2 = *wbufptr2;
+	    if ((ucc2 ^ (ucc << umm)) & unn) {
+	      *wbufptr2 = (ucc2 & (~unn)) | (1U << umm);
+	    }
+	  } else {
+	    mbufptr[ukk] |= ulii;
+	    *wbufptr2 = ((*wbufptr2) & (~unn)) | (ucc << umm);
+	  }
+	}
+	cur_word >>= 2;
+      }
+    } while (sample_idx < cur_sample_ct);
+    break;
+  case 2: // only overwrite originally missing
+    sample_idx = 0;
+    do {
+      sample_idx_cur_max = sample_idx + BITCT2;
+      if (sample_idx_cur_max > cur_sample_ct) {
+	sample_idx_cur_max = cur_sample_ct;
+      }
+      cur_word = *rbufptr++;
+      for (; sample_idx < sample_idx_cur_max; sample_idx++) {
+	ujj = flex_map[sample_idx];
+	ukk = (ujj % 4) * 2;
+	wbufptr2 = &(wbufptr[ujj / 4]);
+	ucc2 = *wbufptr2;
+	if (((ucc2 >> ukk) & 3) == 1) {
+	  ucc = cur_word & 3;
+	  *wbufptr2 = (ucc2 & (~(3U << ukk))) | (ucc << ukk);
+	}
+	cur_word >>= 2;
+      }
+    } while (sample_idx < cur_sample_ct);
+    break;
+  case 3: // only overwrite if nonmissing in new file
+    sample_idx = 0;
+    do {
+      sample_idx_cur_max = sample_idx + BITCT2;
+      if (sample_idx_cur_max > cur_sample_ct) {
+	sample_idx_cur_max = cur_sample_ct;
+      }
+      cur_word = *rbufptr++;
+      for (; sample_idx < sample_idx_cur_max; sample_idx++) {
+	ucc = cur_word & 3;
+	if (ucc != 1) {
+	  ujj = flex_map[sample_idx];
+	  ukk = (ujj % 4) * 2;
+	  wbufptr2 = &(wbufptr[ujj / 4]);
+	  *wbufptr2 = ((*wbufptr2) & (~(3U << ukk))) | (ucc << ukk);
+	}
+	cur_word >>= 2;
+      }
+    } while (sample_idx < cur_sample_ct);
+    break;
+  case 4: // never overwrite
+    sample_idx = 0;
+    do {
+      sample_idx_cur_max = sample_idx + BITCT2;
+      if (sample_idx_cur_max > cur_sample_ct) {
+	sample_idx_cur_max = cur_sample_ct;
+      }
+      cur_word = *rbufptr++;
+      for (; sample_idx < sample_idx_cur_max; sample_idx++) {
+	ujj = flex_map[sample_idx];
+	ukk = ujj / BITCT;
+	ulii = ONELU << (ujj % BITCT);
+	if (!(mbufptr[ukk] & ulii)) {
+	  mbufptr[ukk] |= ulii;
+	  wbufptr2 = &(wbufptr[ujj / 4]);
+	  ukk = (ujj % 4) * 2;
+	  ucc = cur_word & 3;
+	  *wbufptr2 = ((*wbufptr2) & (~(3U << ukk))) | (ucc << ukk);
+	}
+	cur_word >>= 2;
+      }
+    } while (sample_idx < cur_sample_ct);
+    break;
+  case 5: // always overwrite
+    sample_idx = 0;
+    do {
+      sample_idx_cur_max = sample_idx + BITCT2;
+      if (sample_idx_cur_max > cur_sample_ct) {
+	sample_idx_cur_max = cur_sample_ct;
+      }
+      cur_word = *rbufptr++;
+      for (; sample_idx < sample_idx_cur_max; sample_idx++) {
+	ucc = cur_word & 3;
+	ujj = flex_map[sample_idx];
+	ukk = (ujj % 4) * 2;
+	wbufptr2 = &(wbufptr[ujj / 4]);
+	*wbufptr2 = ((*wbufptr2) & (~(3U << ukk))) | (ucc << ukk);
+	cur_word >>= 2;
+      }
+    } while (sample_idx < cur_sample_ct);
+    break;
+  }
+}
+
 int32_t merge_diff_print(FILE* outfile, char* idbuf, char* marker_id, char* sample_id, unsigned char newval, unsigned char oldval, char** marker_allele_ptrs) {
   char* bufptr = token_endnn(sample_id);
   uint32_t slen = strlen_se(marker_id);
@@ -14844,7 +17673,82 @@ int32_t merge_diff_print(FILE* outfile, char* idbuf, char* marker_id, char* samp
   return ferror(outfile);
 }
 
-int32_t merge_main(char* bedname, char* bimname, char* famname, char* bim_loadbuf, uint32_t max_bim_linelen, uint32_t tot_sample_ct, uint32_t tot_marker_ct, uint32_t dedup_marker_ct, uint32_t start_marker_idx, uint32_t marker_window_size, char** marker_allele_ptrs, char* marker_ids, uintptr_t max_marker_id_len, char* sample_ids, uintptr_t max_sample_id_len, uint32_t merge_nsort, uint32_t* sample_nsmap, uint32_t* flex_map, uint32_t* marker_map, char* idbuf, unsigned char* readbuf, unsigned char* writebuf, uint32_t merge_mode, uintptr_t* markbuf, FILE* outfile, uint64_t* diff_total_overlap_ptr, uint64_t* diff_not_both_genotyped_ptr, uint64_t* diff_discordant_ptr, uint32_t ped_buflen) {
+int32_t merge_load_sample_map(char* famname, char* idbuf, char* sample_ids, uintptr_t max_sample_id_len, uint32_t tot_sample_ct, uint32_t merge_nsort, uint32_t* sample_nsmap, uint32_t* flex_map, uint32_t* cur_sample_ct_ptr) {
+  // Fills flex_map[] with the merged-fileset index of each sample in a binary
+  // fileset's .fam.
+  FILE* infile = NULL;
+  uint32_t cur_sample_ct = 0;
+  int32_t retval = 0;
+  char* bufptr;
+  char* bufptr2;
+  char* bufptr3;
+  char* bufptr4;
+  uint32_t uii;
+  uint32_t ujj;
+  int32_t ii;
+  if (fopen_checked(&infile, famname, "r")) {
+    goto merge_load_sample_map_ret_OPEN_FAIL;
+  }
+  while (fgets(tbuf, MAXLINELEN, infile)) {
+    bufptr = skip_initial_spaces(tbuf);
+    if (is_eoln_kns(*bufptr)) {
+      continue;
+    }
+    bufptr2 = token_endnn(bufptr);
+    bufptr3 = skip_initial_spaces(bufptr2);
+    bufptr4 = token_endnn(bufptr3); // safe since file was validated
+    uii = (bufptr2 - bufptr);
+    ujj = (bufptr4 - bufptr3);
+    memcpyx(memcpyax(idbuf, bufptr, uii, '\t'), bufptr3, ujj, 0);
+    if (merge_nsort) {
+      ii = bsearch_str_natural(idbuf, sample_ids, max_sample_id_len, tot_sample_ct);
+    } else {
+      ii = bsearch_str(idbuf, uii + ujj + 1, sample_ids, max_sample_id_len, tot_sample_ct);
+      if (sample_nsmap && (ii != -1)) {
+	ii = sample_nsmap[(uint32_t)ii];
+      }
+    }
+    if (ii == -1) {
+      // previously validated, so give read failure error code instead of
+      // invalid format
+      goto merge_load_sample_map_ret_READ_FAIL;
+    }
+    flex_map[cur_sample_ct++] = ii;
+  }
+  if (!feof(infile)) {
+    goto merge_load_sample_map_ret_READ_FAIL;
+  }
+  *cur_sample_ct_ptr = cur_sample_ct;
+  while (0) {
+  merge_load_sample_map_ret_OPEN_FAIL:
+    retval = RET_OPEN_FAIL;
+    break;
+  merge_load_sample_map_ret_READ_FAIL:
+    retval = RET_READ_FAIL;
+    break;
+  }
+  fclose_cond(infile);
+  return retval;
+}
+
+int32_t merge_check_bed_header(FILE* bedfile, char* bedname, unsigned char* readbuf) {
+  if (fread(readbuf, 1, 3, bedfile) < 3) {
+    return RET_READ_FAIL;
+  }
+  if (memcmp(readbuf, "l\x1b\x01", 3)) {
+    if (!memcmp(readbuf, "l\x1b", 3)) {
+      LOGPREPRINTFWW("Error: %s is an sample-major binary file. Convert to variant-major (with e.g. --make-bed) and then reattempt the merge.\n", bedname);
+    } else {
+      LOGPREPRINTFWW("Error: %s is not a PLINK 1 binary file.\n", bedname);
+    }
+    putchar('\n');
+    logprintb();
+    return RET_INVALID_FORMAT;
+  }
+  return 0;
+}
+
+int32_t merge_main(char* bedname, char* bimname, char* famname, char* bim_loadbuf, uint32_t max_bim_linelen, uint32_t tot_sample_ct, uint32_t tot_marker_ct, uint32_t dedup_marker_ct, uint32_t start_marker_idx, uint32_t marker_window_size, char** marker_allele_ptrs, char* marker_ids, uintptr_t max_marker_id_len, uint32_t* marker_id_htable, uint32_t marker_id_htable_size, char* sample_ids, uintptr_t max_sample_id_len, uint32_t merge_nsort, uint32_t* sample_nsmap, uint32_t* flex_map, uint32_t* marker_map, char* idbuf, unsigned char* readbuf, unsigned char* writebuf, uint32_t merge_mode, uintptr_t* markbuf, FILE* outfile, uint64_t* diff_total_overlap_ptr, uint64_t* diff_not_both_genotyped_ptr, uint64_t* diff_discordant_ptr, uint32_t ped_buflen) {
   // flex_map maps samples for binary filesets, and markers for text filesets.
   uint32_t is_binary = famname? 1 : 0;
   FILE* bedfile = NULL;
@@ -14892,7 +17796,6 @@ int32_t merge_main(char* bedname, char* bimname, char* famname, char* bim_loadbu
   uint32_t ujj;
   uint32_t ukk;
   uint32_t umm;
-  uint32_t unn;
   int32_t ii;
   unsigned char ucc;
   unsigned char ucc2;
@@ -14900,39 +17803,10 @@ int32_t merge_main(char* bedname, char* bimname, char* famname, char* bim_loadbu
   unsigned char ucc4;
   char cc;
   if (is_binary) {
-    if (fopen_checked(&infile2, famname, "r")) {
-      goto merge_main_ret_OPEN_FAIL;
-    }
-    while (fgets(tbuf, MAXLINELEN, infile2)) {
-      bufptr = skip_initial_spaces(tbuf);
-      if (is_eoln_kns(*bufptr)) {
-	continue;
-      }
-      bufptr2 = token_endnn(bufptr);
-      bufptr3 = skip_initial_spaces(bufptr2);
-      bufptr4 = token_endnn(bufptr3); // safe since file was validated
-      uii = (bufptr2 - bufptr);
-      ujj = (bufptr4 - bufptr3);
-      memcpyx(memcpyax(idbuf, bufptr, uii, '\t'), bufptr3, ujj, 0);
-      if (merge_nsort) {
-        ii = bsearch_str_natural(idbuf, sample_ids, max_sample_id_len, tot_sample_ct);
-      } else {
-	ii = bsearch_str(idbuf, uii + ujj + 1, sample_ids, max_sample_id_len, tot_sample_ct);
-	if (sample_nsmap && (ii != -1)) {
-	  ii = sample_nsmap[(uint32_t)ii];
-	}
-      }
-      if (ii == -1) {
-	// previously validated, so give read failure error code instead of
-	// invalid format
-	goto merge_main_ret_READ_FAIL;
-      }
-      flex_map[cur_sample_ct++] = ii;
-    }
-    if (!feof(infile2)) {
-      goto merge_main_ret_READ_FAIL;
+    retval = merge_load_sample_map(famname, idbuf, sample_ids, max_sample_id_len, tot_sample_ct, merge_nsort, sample_nsmap, flex_map, &cur_sample_ct);
+    if (retval) {
+      goto merge_main_ret_1;
     }
-    fclose_null(&infile2);
     cur_sample_ct4 = (cur_sample_ct + 3) / 4;
     cur_sample_ctl2 = (cur_sample_ct + (BITCT2 - 1)) / BITCT2;
   } else {
@@ -14950,16 +17824,9 @@ int32_t merge_main(char* bedname, char* bimname, char* famname, char* bim_loadbu
   }
   if (is_binary) {
     if (!start_marker_idx) {
-      if (fread(readbuf, 1, 3, bedfile) < 3) {
-	goto merge_main_ret_READ_FAIL;
-      }
-      if (memcmp(readbuf, "l\x1b\x01", 3)) {
-	if (!memcmp(readbuf, "l\x1b", 3)) {
-	  LOGPREPRINTFWW("Error: %s is an sample-major binary file. Convert to variant-major (with e.g. --make-bed) and then reattempt the merge.\n", bedname);
-	} else {
-	  LOGPREPRINTFWW("Error: %s is not a PLINK 1 binary file.\n", bedname);
-	}
-	goto merge_main_ret_INVALID_FORMAT_2N;
+      retval = merge_check_bed_header(bedfile, bedname, readbuf);
+      if (retval) {
+	goto merge_main_ret_1;
       }
     }
     readbuf_w = (uintptr_t*)readbuf;
@@ -14983,7 +17850,7 @@ int32_t merge_main(char* bedname, char* bimname, char* famname, char* bim_loadbu
       continue;
     }
     bufptr3 = token_endnn(bufptr);
-    ii = bsearch_str(bufptr, (uintptr_t)(bufptr3 - bufptr), marker_ids, max_marker_id_len, tot_marker_ct);
+    ii = (int32_t)id_htable_find(bufptr, (uintptr_t)(bufptr3 - bufptr), marker_id_htable, marker_id_htable_size, marker_ids, max_marker_id_len);
     if (ii == -1) {
       goto merge_main_ret_READ_FAIL;
     }
@@ -15030,119 +17897,8 @@ int32_t merge_main(char* bedname, char* bimname, char* famname, char* bim_loadbu
 	mbufptr = &(markbuf[(marker_out_idx - start_marker_idx) * tot_sample_ctl]);
       }
       switch (merge_mode) {
-      case 1: // difference -> missing
-	sample_idx = 0;
-	do {
-	  sample_idx_cur_max = sample_idx + BITCT2;
-	  if (sample_idx_cur_max > cur_sample_ct) {
-	    sample_idx_cur_max = cur_sample_ct;
-	  }
-	  cur_word = *rbufptr++;
-	  for (; sample_idx < sample_idx_cur_max; sample_idx++) {
-	    ucc = cur_word & 3;
-	    // bugfix: do NOT set flag, etc. on missing call
-	    if (ucc != 1) {
-	      ujj = flex_map[sample_idx];
-	      ukk = ujj / BITCT;
-	      ulii = ONELU << (ujj % BITCT);
-	      wbufptr2 = &(wbufptr[ujj / 4]);
-	      umm = (ujj % 4) * 2;
-	      unn = 3U << umm;
-	      if (mbufptr[ukk] & ulii) {
-		ucc2 = *wbufptr2;
-		if ((ucc2 ^ (ucc << umm)) & unn) {
-		  *wbufptr2 = (ucc2 & (~unn)) | (1U << umm);
-		}
-	      } else {
-		mbufptr[ukk] |= ulii;
-		*wbufptr2 = ((*wbufptr2) & (~unn)) | (ucc << umm);
-	      }
-	    }
-	    cur_word >>= 2;
-	  }
-	} while (sample_idx < cur_sample_ct);
-	break;
-      case 2: // only overwrite originally missing
-	sample_idx = 0;
-	do {
-	  sample_idx_cur_max = sample_idx + BITCT2;
-	  if (sample_idx_cur_max > cur_sample_ct) {
-	    sample_idx_cur_max = cur_sample_ct;
-	  }
-	  cur_word = *rbufptr++;
-	  for (; sample_idx < sample_idx_cur_max; sample_idx++) {
-	    ujj = flex_map[sample_idx];
-	    ukk = (ujj % 4) * 2;
-	    wbufptr2 = &(wbufptr[ujj / 4]);
-	    ucc2 = *wbufptr2;
-	    if (((ucc2 >> ukk) & 3) == 1) {
-	      ucc = cur_word & 3;
-	      *wbufptr2 = (ucc2 & (~(3U << ukk))) | (ucc << ukk);
-	    }
-	    cur_word >>= 2;
-	  }
-	} while (sample_idx < cur_sample_ct);
-	break;
-      case 3: // only overwrite if nonmissing in new file
-	sample_idx = 0;
-	do {
-	  sample_idx_cur_max = sample_idx + BITCT2;
-	  if (sample_idx_cur_max > cur_sample_ct) {
-	    sample_idx_cur_max = cur_sample_ct;
-	  }
-	  cur_word = *rbufptr++;
-	  for (; sample_idx < sample_idx_cur_max; sample_idx++) {
-	    ucc = cur_word & 3;
-	    if (ucc != 1) {
-	      ujj = flex_map[sample_idx];
-	      ukk = (ujj % 4) * 2;
-	      wbufptr2 = &(wbufptr[ujj / 4]);
-	      *wbufptr2 = ((*wbufptr2) & (~(3U << ukk))) | (ucc << ukk);
-	    }
-	    cur_word >>= 2;
-	  }
-	} while (sample_idx < cur_sample_ct);
-	break;
-      case 4: // never overwrite
-	sample_idx = 0;
-	do {
-	  sample_idx_cur_max = sample_idx + BITCT2;
-	  if (sample_idx_cur_max > cur_sample_ct) {
-	    sample_idx_cur_max = cur_sample_ct;
-	  }
-	  cur_word = *rbufptr++;
-	  for (; sample_idx < sample_idx_cur_max; sample_idx++) {
-	    ujj = flex_map[sample_idx];
-	    ukk = ujj / BITCT;
-	    ulii = ONELU << (ujj % BITCT);
-	    if (!(mbufptr[ukk] & ulii)) {
-	      mbufptr[ukk] |= ulii;
-	      wbufptr2 = &(wbufptr[ujj / 4]);
-	      ukk = (ujj % 4) * 2;
-	      ucc = cur_word & 3;
-	      *wbufptr2 = ((*wbufptr2) & (~(3U << ukk))) | (ucc << ukk);
-	    }
-	    cur_word >>= 2;
-	  }
-	} while (sample_idx < cur_sample_ct);
-	break;
-      case 5: // always overwrite
-	sample_idx = 0;
-	do {
-	  sample_idx_cur_max = sample_idx + BITCT2;
-	  if (sample_idx_cur_max > cur_sample_ct) {
-	    sample_idx_cur_max = cur_sample_ct;
-	  }
-	  cur_word = *rbufptr++;
-	  for (; sample_idx < sample_idx_cur_max; sample_idx++) {
-	    ucc = cur_word & 3;
-	    ujj = flex_map[sample_idx];
-	    ukk = (ujj % 4) * 2;
-	    wbufptr2 = &(wbufptr[ujj / 4]);
-	    *wbufptr2 = ((*wbufptr2) & (~(3U << ukk))) | (ucc << ukk);
-	    cur_word >>= 2;
-	  }
-	} while (sample_idx < cur_sample_ct);
+      default:
+	merge_bed_row(rbufptr, cur_sample_ct, flex_map, wbufptr, mbufptr, merge_mode);
 	break;
       case 6: // report all mismatches
 	sample_idx = 0;
@@ -15474,11 +18230,165 @@ int32_t merge_main(char* bedname, char* bimname, char* famname, char* bim_loadbu
     retval = RET_INVALID_FORMAT;
     break;
   }
+ merge_main_ret_1:
   fclose_cond(bedfile);
   fclose_cond(infile2);
   return retval;
 }
 
+// Multi-pass all-binary merges are instead performed as a single streaming
+// pass when every input is in merged (chromosome, position) order: each
+// fileset gets a cursor into its .bim/.bed, and output blocks are aligned to
+// same-position groups so each cursor only ever moves forward.  Each cursor
+// holds two open files, so this is limited to a reasonable fileset count.
+#define MERGE_STREAM_MAX_FILESETS 256
+
+typedef struct {
+  FILE* bimfile;
+  FILE* bedfile;
+  uint32_t* sample_map;
+  uint32_t sample_ct;
+  uint32_t cm_col;
+  // .bim index of the pending variant
+  uint32_t marker_in_idx;
+  // .bed row the file pointer is currently at
+  uint32_t bed_row;
+  // output index of the pending variant, 0xffffffffU once exhausted
+  uint32_t marker_out_idx;
+  uint32_t is_reversed;
+} Merge_cursor;
+
+int32_t merge_cursor_advance(Merge_cursor* mcp, char* bim_loadbuf, uint32_t max_bim_linelen, char** marker_allele_ptrs, char* marker_ids, uintptr_t max_marker_id_len, uint32_t* marker_id_htable, uint32_t marker_id_htable_size, uint32_t* marker_map) {
+  // Moves the cursor to the next variant which is present in the output.
+  char* bufptr;
+  char* bufptr2;
+  char* bufptr3;
+  uint32_t alen1;
+  uint32_t alen2;
+  uint32_t marker_uidx;
+  while (fgets(bim_loadbuf, max_bim_linelen, mcp->bimfile)) {
+    bufptr = skip_initial_spaces(bim_loadbuf);
+    if (is_eoln_or_comment(*bufptr)) {
+      continue;
+    }
+    mcp->marker_in_idx += 1;
+    bufptr = next_token(bufptr);
+    bufptr2 = next_token_mult(bufptr, 1 + mcp->cm_col);
+    if (!bufptr2) {
+      return RET_READ_FAIL;
+    }
+    if (*bufptr2 == '-') {
+      continue;
+    }
+    bufptr3 = token_endnn(bufptr);
+    marker_uidx = id_htable_find(bufptr, (uintptr_t)(bufptr3 - bufptr), marker_id_htable, marker_id_htable_size, marker_ids, max_marker_id_len);
+    if (marker_uidx == 0xffffffffU) {
+      return RET_READ_FAIL;
+    }
+    if (marker_map[marker_uidx] == 0xffffffffU) {
+      continue;
+    }
+    bufptr2 = next_token(bufptr2);
+    bufptr3 = next_token(bufptr2);
+    if (no_more_tokens_kns(bufptr3)) {
+      return RET_READ_FAIL;
+    }
+    alen1 = strlen_se(bufptr2);
+    bufptr2[alen1] = '\0';
+    alen2 = strlen_se(bufptr3);
+    bufptr3[alen2] = '\0';
+    mcp->marker_out_idx = marker_map[marker_uidx];
+    mcp->is_reversed = (((*bufptr2 != '0') || (alen1 != 1)) && (!strcmp(bufptr2, marker_allele_ptrs[marker_uidx * 2 + 1]))) || (((*bufptr3 != '0') || (alen2 != 1)) && (!strcmp(bufptr3, marker_allele_ptrs[marker_uidx * 2])));
+    return 0;
+  }
+  if (!feof(mcp->bimfile)) {
+    return RET_READ_FAIL;
+  }
+  mcp->marker_out_idx = 0xffffffffU;
+  return 0;
+}
+
+int32_t merge_cursor_open(Merge_cursor* mcp, char* bedname, char* bimname, char* famname, char* bim_loadbuf, uint32_t max_bim_linelen, char** marker_allele_ptrs, char* marker_ids, uintptr_t max_marker_id_len, uint32_t* marker_id_htable, uint32_t marker_id_htable_size, uint32_t* marker_map, char* sample_ids, uintptr_t max_sample_id_len, uint32_t tot_sample_ct, uint32_t merge_nsort, uint32_t* sample_nsmap, uint32_t* flex_map, char* idbuf, unsigned char* readbuf) {
+  uintptr_t line_idx;
+  int32_t retval = merge_load_sample_map(famname, idbuf, sample_ids, max_sample_id_len, tot_sample_ct, merge_nsort, sample_nsmap, flex_map, &(mcp->sample_ct));
+  if (retval) {
+    return retval;
+  }
+  if (wkspace_alloc_ui_checked(&(mcp->sample_map), mcp->sample_ct * sizeof(int32_t))) {
+    return RET_NOMEM;
+  }
+  memcpy(mcp->sample_map, flex_map, mcp->sample_ct * sizeof(int32_t));
+  if (fopen_checked(&(mcp->bimfile), bimname, "r")) {
+    return RET_OPEN_FAIL;
+  }
+  if (check_cm_col(mcp->bimfile, bim_loadbuf, 1, max_bim_linelen, &(mcp->cm_col), &line_idx)) {
+    return RET_READ_FAIL;
+  }
+  rewind(mcp->bimfile);
+  if (fopen_checked(&(mcp->bedfile), bedname, "rb")) {
+    return RET_OPEN_FAIL;
+  }
+  retval = merge_check_bed_header(mcp->bedfile, bedname, readbuf);
+  if (retval) {
+    return retval;
+  }
+  mcp->bed_row = 0;
+  mcp->marker_in_idx = 0xffffffffU; // overflow to zero on first increment
+  return merge_cursor_advance(mcp, bim_loadbuf, max_bim_linelen, marker_allele_ptrs, marker_ids, max_marker_id_len, marker_id_htable, marker_id_htable_size, marker_map);
+}
+
+int32_t merge_stream_block(Merge_cursor* cursors, uintptr_t merge_ct, uint32_t block_start, uint32_t block_end, char* bim_loadbuf, uint32_t max_bim_linelen, uint32_t tot_sample_ct, char** marker_allele_ptrs, char* marker_ids, uintptr_t max_marker_id_len, uint32_t* marker_id_htable, uint32_t marker_id_htable_size, uint32_t* marker_map, unsigned char* readbuf, unsigned char* writebuf, uintptr_t* markbuf, uint32_t merge_mode, uint32_t first_merge_mode, uint32_t* is_unsorted_ptr) {
+  // Merges output variants [block_start, block_end) from every fileset, in
+  // fileset order.  If some fileset turns out not to be in merged order,
+  // *is_unsorted_ptr is set and the caller must fall back to the multipass
+  // merge.
+  uintptr_t tot_sample_ct4 = (tot_sample_ct + 3) / 4;
+  uintptr_t tot_sample_ctl = (tot_sample_ct + (BITCT - 1)) / BITCT;
+  uintptr_t* readbuf_w = (uintptr_t*)readbuf;
+  Merge_cursor* mcp;
+  uintptr_t* mbufptr;
+  uintptr_t mlpos;
+  uintptr_t cur_sample_ct4;
+  uint32_t cur_merge_mode;
+  uint32_t marker_out_idx;
+  int32_t retval;
+  for (mlpos = 0; mlpos < merge_ct; mlpos++) {
+    mcp = &(cursors[mlpos]);
+    cur_merge_mode = mlpos? merge_mode : first_merge_mode;
+    cur_sample_ct4 = (mcp->sample_ct + 3) / 4;
+    readbuf_w[(mcp->sample_ct + (BITCT2 - 1)) / BITCT2 - 1] = 0;
+    mbufptr = NULL;
+    while (mcp->marker_out_idx < block_end) {
+      marker_out_idx = mcp->marker_out_idx;
+      if (marker_out_idx < block_start) {
+	*is_unsorted_ptr = 1;
+	return 0;
+      }
+      if (mcp->marker_in_idx != mcp->bed_row) {
+	if (fseeko(mcp->bedfile, 3 + ((uint64_t)mcp->marker_in_idx) * cur_sample_ct4, SEEK_SET)) {
+	  return RET_READ_FAIL;
+	}
+      }
+      if (load_raw(mcp->bedfile, readbuf_w, cur_sample_ct4)) {
+	return RET_READ_FAIL;
+      }
+      mcp->bed_row = mcp->marker_in_idx + 1;
+      if (mcp->is_reversed) {
+	reverse_loadbuf(readbuf, mcp->sample_ct);
+      }
+      if (merge_must_track_write(cur_merge_mode)) {
+	mbufptr = &(markbuf[(marker_out_idx - block_start) * tot_sample_ctl]);
+      }
+      merge_bed_row(readbuf_w, mcp->sample_ct, mcp->sample_map, &(writebuf[(marker_out_idx - block_start) * tot_sample_ct4]), mbufptr, cur_merge_mode);
+      retval = merge_cursor_advance(mcp, bim_loadbuf, max_bim_linelen, marker_allele_ptrs, marker_ids, max_marker_id_len, marker_id_htable, marker_id_htable_size, marker_map);
+      if (retval) {
+	return retval;
+      }
+    }
+  }
+  return 0;
+}
+
 int32_t merge_datasets(char* bedname, char* bimname, char* famname, char* outname, char* outname_end, char* mergename1, char* mergename2, char* mergename3, char* sample_sort_fname, uint64_t calculation_type, uint32_t merge_type, uint32_t sample_sort, uint64_t misc_flags, Chrom_info* chrom_info_ptr) {
   FILE* mergelistfile = NULL;
   FILE* outfile = NULL;
@@ -15516,11 +18426,20 @@ int32_t merge_datasets(char* bedname, char* bimname, char* famname, char* outnam
   uint32_t* map_reverse = NULL;
   uintptr_t* reversed = NULL;
   char* bim_loadbuf = NULL;
-  // N.B. marker_allele_ptrs are ordered by marker_id instead of position
+  // N.B. marker_allele_ptrs are in pre-sort (hash table) order instead of
+  // position order
   char** marker_allele_ptrs = NULL;
+  uint32_t* marker_id_htable = NULL;
+  uint32_t marker_id_htable_size = 0;
   uintptr_t* pcptr;
+  uintptr_t* ulptr;
+  Merge_cursor* cursors = NULL;
+  uint32_t is_unsorted = 0;
   uintptr_t markers_per_pass;
   uint32_t pass_ct;
+  uint32_t pass_idx;
+  uint32_t block_start;
+  uint32_t pct;
   uintptr_t topsize;
   char* sample_ids;
   char* sample_fids;
@@ -16001,38 +18920,14 @@ int32_t merge_datasets(char* bedname, char* bimname, char* famname, char* outnam
       wkspace_alloc_ll_checked(&ll_buf, tot_marker_ct * sizeof(int64_t))) {
     goto merge_datasets_ret_NOMEM2;
   }
-  for (uii = 0; uii < tot_marker_ct; uii++) {
-    pos_buf[uii] = uii;
-  }
-  ulii = 0;
-  for (uii = 0; uii < HASHSIZE; uii++) {
-    if (htable2[uii]) {
-      ll_ptr2 = htable2[uii];
-      do {
-	strcpy(&(marker_ids[ulii * max_marker_id_len]), ll_ptr2->idstr);
-        ulii++;
-	ll_ptr2 = ll_ptr2->next;
-      } while (ll_ptr2);
-    }
-  }
-  // todo: reimplement this in a manner that never performs a variant ID sort.
-  // chrom/pos-based sort is of course still needed, but that involves cheaper
-  // int64 comparisons.
-  if (qsort_ext(marker_ids, tot_marker_ct, max_marker_id_len, strcmp_deref, (char*)pos_buf, sizeof(int32_t))) {
-    goto merge_datasets_ret_NOMEM2;
-  }
-  // pos_buf[n] contains the position of lexicographic marker #n in the hash
-  // table.  invert this map, then traverse the hash table.
-  for (uii = 0; uii < tot_marker_ct; uii++) {
-    marker_map[pos_buf[uii]] = uii;
-  }
-  wkspace_left += topsize; // deallocate second hash table
-  ulii = 0;
+  // variant indices are assigned in hash table traversal order; mid-merge
+  // lookup is by ID hash, so no variant ID sort is needed
+  ujj = 0;
   for (uii = 0; uii < HASHSIZE; uii++) {
     if (htable2[uii]) {
       ll_ptr2 = htable2[uii];
       do {
-	ujj = marker_map[ulii++];
+	strcpy(&(marker_ids[ujj * max_marker_id_len]), ll_ptr2->idstr);
 	llxx = ll_ptr2->pos;
 	pos_buf[ujj] = (uint32_t)llxx;
 	bufptr = ll_ptr2->allele[0];
@@ -16049,11 +18944,16 @@ int32_t merge_datasets(char* bedname, char* bimname, char* famname, char* outnam
 	}
 	marker_cms_tmp[ujj] = ll_ptr2->cm;
 	ll_buf[ujj] = (((uint64_t)llxx) & 0xffffffff00000000LL) | ujj;
+	ujj++;
 	ll_ptr2 = ll_ptr2->next;
       } while (ll_ptr2);
     }
   }
+  wkspace_left += topsize; // deallocate second hash table
   sort_marker_chrom_pos(ll_buf, tot_marker_ct, pos_buf, chrom_start, chrom_id, NULL, &chrom_ct);
+  if (merge_order_same_pos_ids(ll_buf, chrom_start, chrom_ct, marker_ids, max_marker_id_len, marker_allele_ptrs, marker_cms_tmp)) {
+    goto merge_datasets_ret_NOMEM;
+  }
   // bugfix: when chromosomes are filtered out, flag the corresponding markers
   // in marker_map[]
   fill_uint_one(marker_map, tot_marker_ct);
@@ -16065,6 +18965,21 @@ int32_t merge_datasets(char* bedname, char* bimname, char* famname, char* outnam
     goto merge_datasets_ret_INVALID_FORMAT;
   }
   wkspace_reset((char*)marker_cms_tmp);
+  ulii = (tot_marker_ct + (BITCT - 1)) / BITCT;
+  marker_id_htable_size = get_id_htable_size(tot_marker_ct);
+  if (wkspace_alloc_ui_checked(&marker_id_htable, marker_id_htable_size * sizeof(int32_t))) {
+    goto merge_datasets_ret_NOMEM;
+  }
+  ulptr = (uintptr_t*)wkspace_alloc(ulii * sizeof(intptr_t));
+  if (!ulptr) {
+    goto merge_datasets_ret_NOMEM;
+  }
+  fill_ulong_zero(ulptr, ulii);
+  retval = populate_id_htable(tot_marker_ct, ulptr, tot_marker_ct, marker_ids, max_marker_id_len, 0, marker_id_htable, marker_id_htable_size);
+  if (retval) {
+    goto merge_datasets_ret_1;
+  }
+  wkspace_reset((unsigned char*)ulptr);
 
   tot_sample_ct4 = (tot_sample_ct + 3) / 4;
 
@@ -16089,6 +19004,34 @@ int32_t merge_datasets(char* bedname, char* bimname, char* famname, char* outnam
   if (wkspace_alloc_uc_checked(&readbuf, ulii)) {
     goto merge_datasets_ret_NOMEM;
   }
+  if ((merge_mode < 6) && (merge_ct <= MERGE_STREAM_MAX_FILESETS)) {
+    if (merge_must_track_write(merge_mode)) {
+      ulii = 3 * sizeof(intptr_t) * ((tot_sample_ct + (BITCT - 1)) / BITCT);
+    } else {
+      ulii = tot_sample_ct4;
+    }
+    if (wkspace_left / ulii < dedup_marker_ct) {
+      // multiple passes would be needed, so stream instead if possible
+      for (mlpos = 0; mlpos < merge_ct; mlpos++) {
+	if (!mergelist_fam[mlpos]) {
+	  break;
+	}
+      }
+      if (mlpos == merge_ct) {
+	cursors = (Merge_cursor*)wkspace_alloc(merge_ct * sizeof(Merge_cursor));
+	if (!cursors) {
+	  goto merge_datasets_ret_NOMEM;
+	}
+	memset(cursors, 0, merge_ct * sizeof(Merge_cursor));
+	for (mlpos = 0; mlpos < merge_ct; mlpos++) {
+	  retval = merge_cursor_open(&(cursors[mlpos]), mergelist_bed[mlpos], mergelist_bim[mlpos], mergelist_fam[mlpos], bim_loadbuf, max_bim_linelen, marker_allele_ptrs, marker_ids, max_marker_id_len, marker_id_htable, marker_id_htable_size, marker_map, sample_ids, max_sample_id_len, tot_sample_ct, merge_nsort, sample_nsmap, flex_map, idbuf, readbuf);
+	  if (retval) {
+	    goto merge_datasets_ret_1;
+	  }
+	}
+      }
+    }
+  }
   if (merge_must_track_write(merge_mode)) {
     ulii = (tot_sample_ct + (BITCT - 1)) / BITCT;
     markers_per_pass = wkspace_left / (3 * sizeof(intptr_t) * ulii);
@@ -16117,7 +19060,9 @@ int32_t merge_datasets(char* bedname, char* bimname, char* famname, char* outnam
     if (fwrite_checked("l\x1b\x01", 3, outfile)) {
       goto merge_datasets_ret_WRITE_FAIL;
     }
-    if (pass_ct == 1) {
+    if (cursors) {
+      sprintf(logbuf, "Performing streaming merge (%" PRIuPTR " filesets, %u %s, %u variant%s).\n", merge_ct, tot_sample_ct, species_str(tot_sample_ct), dedup_marker_ct, (dedup_marker_ct == 1)? "" : "s");
+    } else if (pass_ct == 1) {
       sprintf(logbuf, "Performing single-pass merge (%u %s, %u variant%s).\n", tot_sample_ct, species_str(tot_sample_ct), dedup_marker_ct, (dedup_marker_ct == 1)? "" : "s");
     } else {
       sprintf(logbuf, "Performing %u-pass merge (%u %s, %" PRIuPTR "/%u variant%s per pass).\n", pass_ct, tot_sample_ct, species_str(tot_sample_ct), markers_per_pass, dedup_marker_ct, (dedup_marker_ct == 1)? "" : "s");
@@ -16133,12 +19078,30 @@ int32_t merge_datasets(char* bedname, char* bimname, char* famname, char* outnam
     LOGPREPRINTFWW("Performing %u-pass diff (mode %u), writing results to %s .\n", pass_ct, merge_mode, outname);
   }
   logprintb();
-  for (uii = 0; uii < pass_ct; uii++) {
-    if (uii + 1 == pass_ct) {
-      ujj = dedup_marker_ct - markers_per_pass * uii;
-    } else {
+  if (cursors) {
+    fputs("0%", stdout);
+    fflush(stdout);
+  }
+  pct = 0;
+  pass_idx = 0;
+  block_start = 0;
+  while (block_start < dedup_marker_ct) {
+    ujj = dedup_marker_ct - block_start;
+    if (ujj > markers_per_pass) {
       ujj = markers_per_pass;
     }
+    if (cursors && (block_start + ujj < dedup_marker_ct)) {
+      // don't split a same-position group across blocks
+      ukk = block_start + ujj;
+      while ((ukk > block_start) && (pos_buf[ukk] == pos_buf[ukk - 1])) {
+	ukk--;
+      }
+      if (ukk == block_start) {
+	is_unsorted = 1;
+	goto merge_datasets_stream_fallback;
+      }
+      ujj = ukk - block_start;
+    }
     if (tot_sample_ct % 4) {
       umm = tot_sample_ct / 4;
       ubufptr = writebuf;
@@ -16154,13 +19117,42 @@ int32_t merge_datasets(char* bedname, char* bimname, char* famname, char* outnam
     if (merge_must_track_write(merge_mode)) {
       fill_ulong_zero(markbuf, ujj * ulii);
     }
-    for (mlpos = 0; mlpos < merge_ct; mlpos++) {
-      retval = merge_main(mergelist_bed[mlpos], mergelist_bim[mlpos], mergelist_fam[mlpos], bim_loadbuf, max_bim_linelen, tot_sample_ct, tot_marker_ct, dedup_marker_ct, uii * markers_per_pass, ujj, marker_allele_ptrs, marker_ids, max_marker_id_len, sample_ids, max_sample_id_len, merge_nsort, sample_nsmap, flex_map, marker_map, idbuf, readbuf, writebuf, mlpos? merge_mode : merge_first_mode(merge_mode, merge_equal_pos), markbuf, outfile, &diff_total_overlap, &diff_not_both_genotyped, &diff_discordant, ped_buflen);
+    if (cursors) {
+      retval = merge_stream_block(cursors, merge_ct, block_start, block_start + ujj, bim_loadbuf, max_bim_linelen, tot_sample_ct, marker_allele_ptrs, marker_ids, max_marker_id_len, marker_id_htable, marker_id_htable_size, marker_map, readbuf, writebuf, markbuf, merge_mode, merge_first_mode(merge_mode, merge_equal_pos), &is_unsorted);
+      if (retval) {
+	goto merge_datasets_ret_1;
+      }
+      if (is_unsorted) {
+      merge_datasets_stream_fallback:
+	// restart from scratch with the regular multipass merge
+	for (mlpos = 0; mlpos < merge_ct; mlpos++) {
+	  fclose_cond(cursors[mlpos].bimfile);
+	  fclose_cond(cursors[mlpos].bedfile);
+	}
+	cursors = NULL;
+	if (pct >= 10) {
+	  putchar('\b');
+	}
+	fputs("\b\b", stdout);
+	if (fseeko(outfile, 3, SEEK_SET)) {
+	  goto merge_datasets_ret_WRITE_FAIL;
+	}
+	if (reversed) {
+	  fill_ulong_zero(reversed, (tot_marker_ct + (BITCT - 1)) / BITCT);
+	}
+	LOGPRINTF("Note: Inputs are not all in merged variant order, so streaming is not\npossible.  Performing %u-pass merge instead.\n", pass_ct);
+	pass_idx = 0;
+	block_start = 0;
+	continue;
+      }
+    }
+    for (mlpos = 0; (!cursors) && (mlpos < merge_ct); mlpos++) {
+      retval = merge_main(mergelist_bed[mlpos], mergelist_bim[mlpos], mergelist_fam[mlpos], bim_loadbuf, max_bim_linelen, tot_sample_ct, tot_marker_ct, dedup_marker_ct, block_start, ujj, marker_allele_ptrs, marker_ids, max_marker_id_len, marker_id_htable, marker_id_htable_size, sample_ids, max_sample_id_len, merge_nsort, sample_nsmap, flex_map, marker_map, idbuf, readbuf, writebuf, mlpos? merge_mode : merge_first_mode(merge_mode, merge_equal_pos), markbuf, outfile, &diff_total_overlap, &diff_not_both_genotyped, &diff_discordant, ped_buflen);
       if (retval) {
 	goto merge_datasets_ret_1;
       }
       if (mlpos != merge_ct - 1) {
-        printf("\rPass %u: fileset #%" PRIuPTR " complete.", uii + 1, mlpos + 1);
+        printf("\rPass %u: fileset #%" PRIuPTR " complete.", pass_idx + 1, mlpos + 1);
 	fflush(stdout);
       }
     }
@@ -16170,7 +19162,7 @@ int32_t merge_datasets(char* bedname, char* bimname, char* famname, char* outnam
 	  uljj = ((uintptr_t)ukk) * tot_sample_ct4;
 	  umm = popcount_chars(pcptr, uljj, uljj + tot_sample_ct4);
 	  if (umm < tot_sample_ct) {
-	    ulkk = (uii * markers_per_pass) + ukk;
+	    ulkk = block_start + ukk;
 	    reversed[ulkk / BITCT] |= (ONELU << (ulkk % BITCT));
 	    reverse_loadbuf(&(writebuf[uljj]), tot_sample_ct);
 	  }
@@ -16180,10 +19172,37 @@ int32_t merge_datasets(char* bedname, char* bimname, char* famname, char* outnam
         goto merge_datasets_ret_WRITE_FAIL;
       }
     }
+    block_start += ujj;
+    pass_idx++;
+    if (cursors) {
+      ukk = (((uint64_t)block_start) * 100) / dedup_marker_ct;
+      if ((ukk > pct) && (ukk < 100)) {
+	if (pct >= 10) {
+	  putchar('\b');
+	}
+	printf("\b\b%u%%", ukk);
+	fflush(stdout);
+	pct = ukk;
+      }
+      continue;
+    }
     fputs("\r                                              \r", stdout);
-    if (uii + 1 != pass_ct) {
-      LOGPRINTF("Pass %u complete.\n", uii + 1);
+    if (pass_idx != pass_ct) {
+      LOGPRINTF("Pass %u complete.\n", pass_idx);
+    }
+  }
+  if (cursors) {
+    if (pct >= 10) {
+      putchar('\b');
+    }
+    fputs("\b\b", stdout);
+    // cursors lives above flex_map, so it must be released before the
+    // wkspace_reset() below
+    for (mlpos = 0; mlpos < merge_ct; mlpos++) {
+      fclose_cond(cursors[mlpos].bimfile);
+      fclose_cond(cursors[mlpos].bedfile);
     }
+    cursors = NULL;
   }
   if (fclose_null(&outfile)) {
     goto merge_datasets_ret_WRITE_FAIL;
@@ -16259,6 +19278,12 @@ int32_t merge_datasets(char* bedname, char* bimname, char* famname, char* outnam
     break;
   }
  merge_datasets_ret_1:
+  if (cursors) {
+    for (mlpos = 0; mlpos < merge_ct; mlpos++) {
+      fclose_cond(cursors[mlpos].bimfile);
+      fclose_cond(cursors[mlpos].bedfile);
+    }
+  }
   if (marker_allele_ptrs) {
     for (uii = 0; uii < tot_marker_ct * 2; uii++) {
       bufptr = marker_allele_ptrs[uii];
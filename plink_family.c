@@ -2240,6 +2240,7 @@ int32_t tdt(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, char* outna
   }
   fputs("--tdt: 0%", stdout);
   fflush(stdout);
+  time_trace_push("tdt_chroms", marker_ct);
   for (chrom_fo_idx = 0; chrom_fo_idx < chrom_info_ptr->chrom_ct; chrom_fo_idx++) {
     chrom_idx = chrom_info_ptr->chrom_file_order[chrom_fo_idx];
     is_x = ((int32_t)chrom_idx == chrom_info_ptr->x_code);
@@ -2484,6 +2485,7 @@ int32_t tdt(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset, char* outna
       }
     }
   }
+  time_trace_pop();
   putchar('\r');
   LOGPRINTF("--tdt: Report written to %s .\n", outname);
   if (mtest_adjust) {
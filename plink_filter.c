@@ -1542,13 +1542,16 @@ void filter_samples_bitfields(uintptr_t unfiltered_sample_ct, uintptr_t* sample_
   *sample_exclude_ct_ptr = popcount_longs(sample_exclude, unfiltered_sample_ctl);
 }
 
-int32_t mind_filter(FILE* bedfile, uintptr_t bed_offset, char* outname, char* outname_end, double mind_thresh, uintptr_t unfiltered_marker_ct, uintptr_t* marker_exclude, uintptr_t marker_exclude_ct, uintptr_t unfiltered_sample_ct, uintptr_t* sample_exclude, uintptr_t* sample_exclude_ct_ptr, char* sample_ids, uintptr_t max_sample_id_len, uintptr_t* sex_male, Chrom_info* chrom_info_ptr, Oblig_missing_info* om_ip) {
+int32_t mind_filter(FILE* bedfile, uintptr_t bed_offset, FILE* smajfile, char* outname, char* outname_end, double mind_thresh, uintptr_t unfiltered_marker_ct, uintptr_t* marker_exclude, uintptr_t marker_exclude_ct, uintptr_t unfiltered_sample_ct, uintptr_t* sample_exclude, uintptr_t* sample_exclude_ct_ptr, char* sample_ids, uintptr_t max_sample_id_len, uintptr_t* sex_male, Chrom_info* chrom_info_ptr, Oblig_missing_info* om_ip) {
   unsigned char* wkspace_mark = wkspace_base;
   FILE* outfile = NULL;
   uint32_t marker_ct = unfiltered_marker_ct - marker_exclude_ct;
   uintptr_t unfiltered_sample_ct4 = (unfiltered_sample_ct + 3) / 4;
   uintptr_t unfiltered_sample_ct2l = (unfiltered_sample_ct + (BITCT2 - 1)) / BITCT2;
   uintptr_t unfiltered_sample_ctl = (unfiltered_sample_ct + (BITCT - 1)) / BITCT;
+  uintptr_t unfiltered_marker_ct4 = (unfiltered_marker_ct + 3) / 4;
+  uintptr_t unfiltered_marker_ctl = (unfiltered_marker_ct + (BITCT - 1)) / BITCT;
+  uintptr_t unfiltered_marker_ctl2 = (unfiltered_marker_ct + (BITCT2 - 1)) / BITCT2;
   uintptr_t final_mask = get_final_mask(unfiltered_sample_ct);
   uintptr_t marker_idx = 0;
   uintptr_t y_start = 0;
@@ -1572,6 +1575,10 @@ int32_t mind_filter(FILE* bedfile, uintptr_t bed_offset, char* outname, char* ou
   uint32_t* missing_cts;
   uint32_t* cluster_ref_cts;
   uint32_t* sample_lookup;
+  uintptr_t* marker_include2;
+  uintptr_t* nony_include2;
+  uintptr_t* nony_exclude;
+  uintptr_t* smaj_rowbuf;
   uintptr_t marker_uidx;
   uint32_t cluster_ct;
   uint32_t cur_marker_ct;
@@ -1579,6 +1586,7 @@ int32_t mind_filter(FILE* bedfile, uintptr_t bed_offset, char* outname, char* ou
   uint32_t uii;
   uint32_t ujj;
   uintptr_t ulii;
+  uintptr_t uljj;
 
   if (y_present) {
     y_start = chrom_info_ptr->chrom_start[(uint32_t)y_code];
@@ -1596,6 +1604,52 @@ int32_t mind_filter(FILE* bedfile, uintptr_t bed_offset, char* outname, char* ou
   }
   loadbuf[unfiltered_sample_ct2l - 1] = 0;
   fill_uint_zero(missing_cts, unfiltered_sample_ct);
+  if (smajfile) {
+    // one row per sample; females and unknown-sex samples use a variant mask
+    // with chrY cleared, matching sample_male_include2 below
+    if (wkspace_alloc_ul_checked(&marker_include2, unfiltered_marker_ctl2 * sizeof(intptr_t)) ||
+        wkspace_alloc_ul_checked(&smaj_rowbuf, unfiltered_marker_ctl2 * sizeof(intptr_t))) {
+      goto mind_filter_ret_NOMEM;
+    }
+    exclude_to_vec_include(unfiltered_marker_ct, marker_include2, marker_exclude);
+    nony_include2 = marker_include2;
+    if (y_present && (y_end > y_start)) {
+      if (wkspace_alloc_ul_checked(&nony_include2, unfiltered_marker_ctl2 * sizeof(intptr_t)) ||
+          wkspace_alloc_ul_checked(&nony_exclude, unfiltered_marker_ctl * sizeof(intptr_t))) {
+	goto mind_filter_ret_NOMEM;
+      }
+      memcpy(nony_exclude, marker_exclude, unfiltered_marker_ctl * sizeof(intptr_t));
+      fill_bits(nony_exclude, y_start, y_end - y_start);
+      exclude_to_vec_include(unfiltered_marker_ct, nony_include2, nony_exclude);
+    }
+    smaj_rowbuf[unfiltered_marker_ctl2 - 1] = 0;
+    sample_uidx = next_unset_unsafe(sample_exclude, 0);
+    if (fseeko(smajfile, 3 + ((uint64_t)sample_uidx) * unfiltered_marker_ct4, SEEK_SET)) {
+      goto mind_filter_ret_READ_FAIL;
+    }
+    for (; sample_idx < sample_ct; sample_idx++, sample_uidx++) {
+      if (IS_SET(sample_exclude, sample_uidx)) {
+	sample_uidx = next_unset_unsafe(sample_exclude, sample_uidx);
+	if (fseeko(smajfile, 3 + ((uint64_t)sample_uidx) * unfiltered_marker_ct4, SEEK_SET)) {
+	  goto mind_filter_ret_READ_FAIL;
+	}
+      }
+      if (load_raw(smajfile, smaj_rowbuf, unfiltered_marker_ct4)) {
+	goto mind_filter_ret_READ_FAIL;
+      }
+      lptr = smaj_rowbuf;
+      mptr = is_set(sex_male, sample_uidx)? marker_include2 : nony_include2;
+      uii = 0;
+      for (ulii = 0; ulii < unfiltered_marker_ctl2; ulii++) {
+	uljj = *lptr++;
+	uii += popcount2_long(uljj & (~(uljj >> 1)) & (*mptr++));
+      }
+      missing_cts[sample_uidx] = uii;
+    }
+    sample_uidx = 0;
+    sample_idx = 0;
+    goto mind_filter_missing_cts_done;
+  }
   if (fseeko(bedfile, bed_offset, SEEK_SET)) {
     goto mind_filter_ret_READ_FAIL;
   }
@@ -1635,6 +1689,7 @@ int32_t mind_filter(FILE* bedfile, uintptr_t bed_offset, char* outname, char* ou
       }
     }
   }
+ mind_filter_missing_cts_done:
   fill_ulong_zero(newly_excluded, unfiltered_sample_ctl);
   if (!om_ip->entry_ct) {
     mind_int_thresh[0] = (int32_t)(mind_thresh * ((int32_t)nony_marker_ct) * (1 + SMALL_EPSILON));
@@ -2177,6 +2232,249 @@ static inline void haploid_single_marker_freqs(uintptr_t unfiltered_sample_ct, u
   *hethap_incr_ptr = hethap_incr;
 }
 
+// calc_freqs_and_hwe() multithreading.  The main thread tags each variant in
+// the current block with its chromosome class and obligatory-missing count;
+// the workers then fill the per-variant output arrays directly, and leave
+// everything order-dependent (.hh output, the genotyping rate sum, and the
+// shared bitfields) to a sequential pass over the block.
+#define CFH_DIPLOID 0
+#define CFH_HAPLOID 1
+#define CFH_X 2
+#define CFH_Y 3
+
+#define CFH_AC_EXCL 1
+#define CFH_RATE_UNDEF 2
+
+#define CFH_BLOCK_SIZE 1024
+
+static unsigned char* g_cfh_geno;
+static uintptr_t* g_cfh_loadbufs;
+static uint32_t* g_cfh_marker_uidxs;
+static unsigned char* g_cfh_chrom_classes;
+static uint32_t* g_cfh_oblig_missing;
+static double* g_cfh_geno_rates;
+static uint32_t* g_cfh_hethap_cts;
+static unsigned char* g_cfh_flags;
+static uint32_t g_cfh_block_size;
+static uint32_t g_cfh_thread_ct;
+static uintptr_t g_cfh_unfiltered_sample_ct;
+static uintptr_t* g_cfh_sample_include2;
+static uintptr_t* g_cfh_founder_include2;
+static uintptr_t* g_cfh_founder_ctrl_include2;
+static uintptr_t* g_cfh_founder_case_include2;
+static uintptr_t* g_cfh_sample_nonmale_include2;
+static uintptr_t* g_cfh_founder_nonmale_include2;
+static uintptr_t* g_cfh_founder_ctrl_nonmale_include2;
+static uintptr_t* g_cfh_founder_case_nonmale_include2;
+static uintptr_t* g_cfh_sample_male_include2;
+static uintptr_t* g_cfh_founder_male_include2;
+static uint32_t g_cfh_sample_ct;
+static uint32_t g_cfh_sample_f_ct;
+static uint32_t g_cfh_sample_f_ctrl_ct;
+static uint32_t g_cfh_sample_f_case_ct;
+static uint32_t g_cfh_sample_nonmale_ct;
+static uint32_t g_cfh_sample_f_nonmale_ct;
+static uint32_t g_cfh_sample_f_ctl_nonmale_ct;
+static uint32_t g_cfh_sample_f_case_nonmale_ct;
+static uint32_t g_cfh_sample_male_ct;
+static uint32_t g_cfh_sample_f_male_ct;
+static double g_cfh_sample_ct_recip;
+static double g_cfh_male_ct_recip;
+static uint32_t g_cfh_hwe_needed;
+static uint32_t g_cfh_hardy_needed;
+static uint32_t g_cfh_ac_needed;
+static uint32_t g_cfh_min_ac;
+static uint32_t g_cfh_max_ac;
+static int32_t g_cfh_maf_succ;
+static double* g_cfh_set_allele_freqs;
+static int32_t* g_cfh_hwe_lls;
+static int32_t* g_cfh_hwe_lhs;
+static int32_t* g_cfh_hwe_hhs;
+static int32_t* g_cfh_hwe_ll_cases;
+static int32_t* g_cfh_hwe_lh_cases;
+static int32_t* g_cfh_hwe_hh_cases;
+static int32_t* g_cfh_hwe_ll_allfs;
+static int32_t* g_cfh_hwe_lh_allfs;
+static int32_t* g_cfh_hwe_hh_allfs;
+static int32_t* g_cfh_hwe_hapl_allfs;
+static int32_t* g_cfh_hwe_haph_allfs;
+
+THREAD_RET_TYPE calc_freqs_and_hwe_thread(void* arg) {
+  uintptr_t tidx = (uintptr_t)arg;
+  uintptr_t unfiltered_sample_ct = g_cfh_unfiltered_sample_ct;
+  uintptr_t unfiltered_sample_ct4 = (unfiltered_sample_ct + 3) / 4;
+  uintptr_t unfiltered_sample_ctv2 = 2 * ((unfiltered_sample_ct + BITCT - 1) / BITCT);
+  uintptr_t* loadbuf = &(g_cfh_loadbufs[tidx * unfiltered_sample_ctv2]);
+  uint32_t sample_ct = g_cfh_sample_ct;
+  uint32_t hwe_needed = g_cfh_hwe_needed;
+  uint32_t hardy_needed = g_cfh_hardy_needed;
+  int32_t maf_succ = g_cfh_maf_succ;
+  uint32_t ll_hwe = 0;
+  uint32_t lh_hwe = 0;
+  uint32_t hh_hwe = 0;
+  uint32_t ll_case_hwe = 0;
+  uint32_t lh_case_hwe = 0;
+  uint32_t hh_case_hwe = 0;
+  uint32_t ll_ct = 0;
+  uint32_t lh_ct = 0;
+  uint32_t hh_ct = 0;
+  uint32_t ll_ctf = 0;
+  uint32_t lh_ctf = 0;
+  uint32_t hh_ctf = 0;
+  uint32_t ukk = 0;
+  uint32_t hethap_incr = 0;
+  uint32_t block_idx;
+  uint32_t block_end;
+  uint32_t marker_uidx;
+  uint32_t chrom_class;
+  uint32_t cur_oblig_missing;
+  uint32_t is_last_block;
+  uint32_t uii;
+  uint32_t ujj;
+  double cur_genotyping_rate;
+  unsigned char cur_flags;
+  while (1) {
+    is_last_block = g_is_last_thread_block;
+    block_idx = (((uint64_t)tidx) * g_cfh_block_size) / g_cfh_thread_ct;
+    block_end = (((uint64_t)tidx + 1) * g_cfh_block_size) / g_cfh_thread_ct;
+    for (; block_idx < block_end; block_idx++) {
+      memcpy(loadbuf, &(g_cfh_geno[block_idx * unfiltered_sample_ct4]), unfiltered_sample_ct4);
+      marker_uidx = g_cfh_marker_uidxs[block_idx];
+      chrom_class = g_cfh_chrom_classes[block_idx];
+      cur_oblig_missing = g_cfh_oblig_missing[block_idx];
+      cur_flags = 0;
+      if (chrom_class == CFH_DIPLOID) {
+	single_marker_freqs_and_hwe(unfiltered_sample_ctv2, loadbuf, g_cfh_sample_include2, g_cfh_founder_include2, g_cfh_founder_ctrl_include2, g_cfh_founder_case_include2, sample_ct, &ll_ct, &lh_ct, &hh_ct, g_cfh_sample_f_ct, &ll_ctf, &lh_ctf, &hh_ctf, hwe_needed, g_cfh_sample_f_ctrl_ct, &ll_hwe, &lh_hwe, &hh_hwe, hardy_needed, g_cfh_sample_f_case_ct, &ll_case_hwe, &lh_case_hwe, &hh_case_hwe);
+	g_cfh_hwe_ll_allfs[marker_uidx] = ll_ctf;
+	g_cfh_hwe_lh_allfs[marker_uidx] = lh_ctf;
+	g_cfh_hwe_hh_allfs[marker_uidx] = hh_ctf;
+	uii = ll_ct + lh_ct + hh_ct;
+	if (!cur_oblig_missing) {
+	  cur_genotyping_rate = ((int32_t)uii) * g_cfh_sample_ct_recip;
+	} else {
+	  if (sample_ct - cur_oblig_missing) {
+	    cur_genotyping_rate = ((int32_t)uii) / ((double)((int32_t)(sample_ct - cur_oblig_missing)));
+	  } else {
+	    cur_genotyping_rate = 0;
+	    cur_flags |= CFH_RATE_UNDEF;
+	  }
+	}
+	if (g_cfh_ac_needed) {
+	  if (ll_ctf < hh_ctf) {
+	    uii = 2 * ll_ctf + lh_ctf;
+	  } else {
+	    uii = 2 * hh_ctf + lh_ctf;
+	  }
+	  if ((uii < g_cfh_min_ac) || (uii > g_cfh_max_ac)) {
+	    cur_flags |= CFH_AC_EXCL;
+	  }
+	}
+	uii = 2 * (ll_ctf + lh_ctf + hh_ctf + maf_succ);
+	if (!uii) {
+	  // avoid 0/0 division
+	  g_cfh_set_allele_freqs[marker_uidx] = 0.5;
+	} else {
+	  g_cfh_set_allele_freqs[marker_uidx] = ((double)(2 * hh_ctf + lh_ctf + maf_succ)) / ((double)uii);
+	}
+	if (hwe_needed) {
+	  g_cfh_hwe_lls[marker_uidx] = ll_hwe;
+	  g_cfh_hwe_lhs[marker_uidx] = lh_hwe;
+	  g_cfh_hwe_hhs[marker_uidx] = hh_hwe;
+	  if (hardy_needed) {
+	    g_cfh_hwe_ll_cases[marker_uidx] = ll_case_hwe;
+	    g_cfh_hwe_lh_cases[marker_uidx] = lh_case_hwe;
+	    g_cfh_hwe_hh_cases[marker_uidx] = hh_case_hwe;
+	  }
+	}
+	hethap_incr = 0;
+      } else {
+	uii = 0;
+	ujj = 0;
+	if (chrom_class != CFH_HAPLOID) {
+	  if (chrom_class == CFH_X) {
+	    single_marker_freqs_and_hwe(unfiltered_sample_ctv2, loadbuf, g_cfh_sample_nonmale_include2, g_cfh_founder_nonmale_include2, g_cfh_founder_ctrl_nonmale_include2, g_cfh_founder_case_nonmale_include2, g_cfh_sample_nonmale_ct, &ll_ct, &lh_ct, &hh_ct, g_cfh_sample_f_nonmale_ct, &ll_ctf, &lh_ctf, &hh_ctf, hwe_needed, g_cfh_sample_f_ctl_nonmale_ct, &ll_hwe, &lh_hwe, &hh_hwe, hardy_needed, g_cfh_sample_f_case_nonmale_ct, &ll_case_hwe, &lh_case_hwe, &hh_case_hwe);
+	    g_cfh_hwe_ll_allfs[marker_uidx] = ll_ctf;
+	    g_cfh_hwe_lh_allfs[marker_uidx] = lh_ctf;
+	    g_cfh_hwe_hh_allfs[marker_uidx] = hh_ctf;
+	    uii = 2 * (ll_ctf + lh_ctf + hh_ctf);
+	    ujj = 2 * hh_ctf + lh_ctf;
+	    ukk = ll_ct + lh_ct + hh_ct;
+	    if (hwe_needed) {
+	      g_cfh_hwe_lls[marker_uidx] = ll_hwe;
+	      g_cfh_hwe_lhs[marker_uidx] = lh_hwe;
+	      g_cfh_hwe_hhs[marker_uidx] = hh_hwe;
+	      if (hardy_needed) {
+		g_cfh_hwe_ll_cases[marker_uidx] = ll_case_hwe;
+		g_cfh_hwe_lh_cases[marker_uidx] = lh_case_hwe;
+		g_cfh_hwe_hh_cases[marker_uidx] = hh_case_hwe;
+	      }
+	    }
+	  }
+	  haploid_single_marker_freqs(unfiltered_sample_ct, unfiltered_sample_ctv2, loadbuf, g_cfh_sample_male_include2, g_cfh_founder_male_include2, g_cfh_sample_male_ct, &ll_ct, &hh_ct, g_cfh_sample_f_male_ct, &ll_ctf, &hh_ctf, &hethap_incr);
+	  if (((chrom_class == CFH_X) || g_cfh_sample_male_ct) && (sample_ct - cur_oblig_missing)) {
+	    if (chrom_class == CFH_X) {
+	      if (!cur_oblig_missing) {
+		cur_genotyping_rate = ((int32_t)(ll_ct + hh_ct + ukk)) * g_cfh_sample_ct_recip;
+	      } else {
+		cur_genotyping_rate = ((int32_t)(ll_ct + hh_ct + ukk)) / ((double)((int32_t)(sample_ct - cur_oblig_missing)));
+	      }
+	    } else {
+	      if (!cur_oblig_missing) {
+		cur_genotyping_rate = ((int32_t)(ll_ct + hh_ct)) * g_cfh_male_ct_recip;
+	      } else {
+		cur_genotyping_rate = ((int32_t)(ll_ct + hh_ct)) / ((double)((int32_t)(g_cfh_sample_male_ct - cur_oblig_missing)));
+	      }
+	    }
+	  } else {
+	    cur_genotyping_rate = 0;
+	    cur_flags |= CFH_RATE_UNDEF;
+	  }
+	} else {
+	  haploid_single_marker_freqs(unfiltered_sample_ct, unfiltered_sample_ctv2, loadbuf, g_cfh_sample_include2, g_cfh_founder_include2, sample_ct, &ll_ct, &hh_ct, g_cfh_sample_f_ct, &ll_ctf, &hh_ctf, &hethap_incr);
+	  if (!cur_oblig_missing) {
+	    cur_genotyping_rate = ((int32_t)(ll_ct + hh_ct)) * g_cfh_sample_ct_recip;
+	  } else {
+	    if (sample_ct - cur_oblig_missing) {
+	      cur_genotyping_rate = ((int32_t)(ll_ct + hh_ct)) / ((double)((int32_t)(sample_ct - cur_oblig_missing)));
+	    } else {
+	      cur_genotyping_rate = 0;
+	      cur_flags |= CFH_RATE_UNDEF;
+	    }
+	  }
+	}
+	g_cfh_hwe_hapl_allfs[marker_uidx] = ll_ctf;
+	g_cfh_hwe_haph_allfs[marker_uidx] = hh_ctf;
+	uii += ll_ctf + hh_ctf;
+	ujj += hh_ctf;
+	if (g_cfh_ac_needed) {
+	  if (ujj <= uii / 2) {
+	    ukk = ujj;
+	  } else {
+	    ukk = uii - ujj;
+	  }
+	  if ((ukk < g_cfh_min_ac) || (ukk > g_cfh_max_ac)) {
+	    cur_flags |= CFH_AC_EXCL;
+	  }
+	}
+	uii += 2 * maf_succ;
+	ujj += maf_succ;
+	if (!uii) {
+	  g_cfh_set_allele_freqs[marker_uidx] = 0.5;
+	} else {
+	  g_cfh_set_allele_freqs[marker_uidx] = ((double)ujj) / ((double)uii);
+	}
+      }
+      g_cfh_geno_rates[block_idx] = cur_genotyping_rate;
+      g_cfh_hethap_cts[block_idx] = hethap_incr;
+      g_cfh_flags[block_idx] = cur_flags;
+    }
+    if ((!tidx) || is_last_block) {
+      THREAD_RETURN;
+    }
+    THREAD_BLOCK_FINISH(tidx);
+  }
+}
+
 int32_t calc_freqs_and_hwe(FILE* bedfile, char* outname, char* outname_end, uintptr_t unfiltered_marker_ct, uintptr_t* marker_exclude, uintptr_t marker_ct, char* marker_ids, uintptr_t max_marker_id_len, uintptr_t unfiltered_sample_ct, uintptr_t* sample_exclude, uintptr_t sample_exclude_ct, char* sample_ids, uintptr_t max_sample_id_len, uintptr_t* founder_info, int32_t nonfounders, int32_t maf_succ, double* set_allele_freqs, uintptr_t bed_offset, uint32_t hwe_needed, uint32_t hwe_all, uint32_t hardy_needed, uint32_t min_ac, uint32_t max_ac, double geno_thresh, uintptr_t* pheno_nm, uintptr_t* pheno_c, int32_t** hwe_lls_ptr, int32_t** hwe_lhs_ptr, int32_t** hwe_hhs_ptr, int32_t** hwe_ll_cases_ptr, int32_t** hwe_lh_cases_ptr, int32_t** hwe_hh_cases_ptr, int32_t** hwe_ll_allfs_ptr, int32_t** hwe_lh_allfs_ptr, int32_t** hwe_hh_allfs_ptr, int32_t** hwe_hapl_allfs_ptr, int32_t** hwe_haph_allfs_ptr, uintptr_t** geno_excl_bitfield_ptr, uintptr_t** ac_excl_bitfield_ptr, uint32_t* sample_male_ct_ptr, uint32_t* sample_f_ct_ptr, uint32_t* sample_f_male_ct_ptr, uintptr_t* topsize_ptr, Chrom_info* chrom_info_ptr, Oblig_missing_info* om_ip, uintptr_t* sex_nm, uintptr_t* sex_male, uint32_t is_split_chrom, uint32_t* hh_exists_ptr) {
   FILE* hhfile = NULL;
   uintptr_t unfiltered_sample_ct4 = (unfiltered_sample_ct + 3) / 4;
@@ -2196,12 +2494,6 @@ int32_t calc_freqs_and_hwe(FILE* bedfile, char* outname, char* outname_end, uint
   uintptr_t sample_f_ctrl_ct = sample_ct;
   uintptr_t sample_f_case_ct = sample_ct;
   unsigned char* wkspace_mark = wkspace_base;
-  uint32_t ll_hwe = 0;
-  uint32_t lh_hwe = 0;
-  uint32_t hh_hwe = 0;
-  uint32_t ll_case_hwe = 0;
-  uint32_t lh_case_hwe = 0;
-  uint32_t hh_case_hwe = 0;
   uint32_t cur_chrom_idx = 0;
   uint32_t nonmissing_nonmale_y = 0;
   int32_t ii = chrom_info_ptr->chrom_file_order[0];
@@ -2209,13 +2501,6 @@ int32_t calc_freqs_and_hwe(FILE* bedfile, char* outname, char* outname_end, uint
   uint32_t next_chrom_start = chrom_info_ptr->chrom_file_order_marker_idx[1];
   uint32_t is_x = (ii == chrom_info_ptr->x_code);
   uint32_t is_y = (ii == chrom_info_ptr->y_code);
-  uint32_t ll_ct = 0;
-  uint32_t lh_ct = 0;
-  uint32_t hh_ct = 0;
-  uint32_t ll_ctf = 0;
-  uint32_t lh_ctf = 0;
-  uint32_t hh_ctf = 0;
-  uint32_t ukk = 0;
   uint32_t cur_oblig_missing = 0;
   uint32_t om_cluster_ct = 0;
   uint32_t* om_cluster_sizes = NULL;
@@ -2245,6 +2530,17 @@ int32_t calc_freqs_and_hwe(FILE* bedfile, char* outname, char* outname_end, uint
   uint64_t hethap_ct = 0;
   uint64_t cur_om_entry = 0;
   double male_ct_recip = 0;
+  pthread_t threads[MAX_THREADS];
+  Bed_prefetch bed_prefetch;
+  unsigned char* geno_buf0;
+  unsigned char* geno_buf1;
+  uintptr_t* lptr;
+  uintptr_t block_marker_uidx;
+  uint32_t thread_ct;
+  uint32_t block_max_size;
+  uint32_t block_size;
+  uint32_t block_idx;
+  uint32_t is_last_block;
   uint32_t* om_sample_lookup;
   int32_t* hwe_hapl_allfs;
   int32_t* hwe_haph_allfs;
@@ -2254,7 +2550,6 @@ int32_t calc_freqs_and_hwe(FILE* bedfile, char* outname, char* outname_end, uint
   uintptr_t* founder_ctrl_include2;
   uintptr_t* tmp_sample_excl_mask;
   uintptr_t* tmp_sample_excl_mask2;
-  uintptr_t loop_end;
   uintptr_t marker_uidx;
   uintptr_t marker_idx;
   uintptr_t sample_uidx;
@@ -2262,13 +2557,13 @@ int32_t calc_freqs_and_hwe(FILE* bedfile, char* outname, char* outname_end, uint
   uintptr_t ulii;
   uint32_t sample_male_ct;
   uint32_t sample_f_male_ct;
-  uint32_t hethap_incr;
   uint32_t nonmales_needed;
   uint32_t males_needed;
   uint32_t uii;
   uint32_t ujj;
-  double maf;
+  uint32_t ukk;
   double cur_genotyping_rate;
+  bed_prefetch.thread_active = 0;
   if (!hwe_needed) {
     *hwe_lls_ptr = (int32_t*)wkspace_base;
   } else {
@@ -2468,9 +2763,87 @@ int32_t calc_freqs_and_hwe(FILE* bedfile, char* outname, char* outname_end, uint
 
   *sample_f_ct_ptr = sample_f_ct;
   *sample_f_male_ct_ptr = sample_f_male_ct;
-  if (fseeko(bedfile, bed_offset, SEEK_SET)) {
-    goto calc_freqs_and_hwe_ret_READ_FAIL;
+  if (!marker_ct) {
+    goto calc_freqs_and_hwe_ret_1;
+  }
+  thread_ct = g_thread_ct;
+  if (thread_ct > marker_ct) {
+    thread_ct = marker_ct;
+  }
+  if (wkspace_alloc_ul_checked(&g_cfh_loadbufs, thread_ct * unfiltered_sample_ctv2 * sizeof(intptr_t))) {
+    goto calc_freqs_and_hwe_ret_NOMEM;
+  }
+  for (uii = 0; uii < thread_ct; uii++) {
+    g_cfh_loadbufs[(uii + 1) * unfiltered_sample_ctv2 - 2] = 0;
+    g_cfh_loadbufs[(uii + 1) * unfiltered_sample_ctv2 - 1] = 0;
+  }
+  // two genotype buffers, plus the per-variant scratch arrays (each padded to
+  // a cache line)
+  block_max_size = CFH_BLOCK_SIZE;
+  if (block_max_size > marker_ct) {
+    block_max_size = marker_ct;
+  }
+  ulii = 2 * unfiltered_sample_ct4 + 3 * sizeof(int32_t) + sizeof(double) + 2;
+  if (wkspace_left < 8 * CACHELINE + ulii) {
+    goto calc_freqs_and_hwe_ret_NOMEM;
+  }
+  ulii = (wkspace_left - 8 * CACHELINE) / ulii;
+  if (block_max_size > ulii) {
+    block_max_size = ulii;
+  }
+  if (wkspace_alloc_uc_checked(&geno_buf0, block_max_size * unfiltered_sample_ct4) ||
+      wkspace_alloc_uc_checked(&geno_buf1, block_max_size * unfiltered_sample_ct4) ||
+      wkspace_alloc_ui_checked(&g_cfh_marker_uidxs, block_max_size * sizeof(int32_t)) ||
+      wkspace_alloc_uc_checked(&g_cfh_chrom_classes, block_max_size) ||
+      wkspace_alloc_ui_checked(&g_cfh_oblig_missing, block_max_size * sizeof(int32_t)) ||
+      wkspace_alloc_d_checked(&g_cfh_geno_rates, block_max_size * sizeof(double)) ||
+      wkspace_alloc_ui_checked(&g_cfh_hethap_cts, block_max_size * sizeof(int32_t)) ||
+      wkspace_alloc_uc_checked(&g_cfh_flags, block_max_size)) {
+    goto calc_freqs_and_hwe_ret_NOMEM;
   }
+  loadbuf = g_cfh_loadbufs;
+  g_cfh_thread_ct = thread_ct;
+  g_cfh_unfiltered_sample_ct = unfiltered_sample_ct;
+  g_cfh_sample_include2 = sample_include2;
+  g_cfh_founder_include2 = founder_include2;
+  g_cfh_founder_ctrl_include2 = founder_ctrl_include2;
+  g_cfh_founder_case_include2 = founder_case_include2;
+  g_cfh_sample_nonmale_include2 = sample_nonmale_include2;
+  g_cfh_founder_nonmale_include2 = founder_nonmale_include2;
+  g_cfh_founder_ctrl_nonmale_include2 = founder_ctrl_nonmale_include2;
+  g_cfh_founder_case_nonmale_include2 = founder_case_nonmale_include2;
+  g_cfh_sample_male_include2 = sample_male_include2;
+  g_cfh_founder_male_include2 = founder_male_include2;
+  g_cfh_sample_ct = sample_ct;
+  g_cfh_sample_f_ct = sample_f_ct;
+  g_cfh_sample_f_ctrl_ct = sample_f_ctrl_ct;
+  g_cfh_sample_f_case_ct = sample_f_case_ct;
+  g_cfh_sample_nonmale_ct = sample_nonmale_ct;
+  g_cfh_sample_f_nonmale_ct = sample_f_nonmale_ct;
+  g_cfh_sample_f_ctl_nonmale_ct = sample_f_ctl_nonmale_ct;
+  g_cfh_sample_f_case_nonmale_ct = sample_f_case_nonmale_ct;
+  g_cfh_sample_male_ct = sample_male_ct;
+  g_cfh_sample_f_male_ct = sample_f_male_ct;
+  g_cfh_sample_ct_recip = sample_ct_recip;
+  g_cfh_male_ct_recip = male_ct_recip;
+  g_cfh_hwe_needed = hwe_needed;
+  g_cfh_hardy_needed = hardy_needed;
+  g_cfh_ac_needed = (ac_excl_bitfield != NULL);
+  g_cfh_min_ac = min_ac;
+  g_cfh_max_ac = max_ac;
+  g_cfh_maf_succ = maf_succ;
+  g_cfh_set_allele_freqs = set_allele_freqs;
+  g_cfh_hwe_lls = hwe_lls;
+  g_cfh_hwe_lhs = hwe_lhs;
+  g_cfh_hwe_hhs = hwe_hhs;
+  g_cfh_hwe_ll_cases = hwe_ll_cases;
+  g_cfh_hwe_lh_cases = hwe_lh_cases;
+  g_cfh_hwe_hh_cases = hwe_hh_cases;
+  g_cfh_hwe_ll_allfs = hwe_ll_allfs;
+  g_cfh_hwe_lh_allfs = hwe_lh_allfs;
+  g_cfh_hwe_hh_allfs = hwe_hh_allfs;
+  g_cfh_hwe_hapl_allfs = hwe_hapl_allfs;
+  g_cfh_hwe_haph_allfs = hwe_haph_allfs;
   marker_uidx = 0;
   marker_idx = 0;
   logprint("Calculating allele frequencies...");
@@ -2483,219 +2856,126 @@ int32_t calc_freqs_and_hwe(FILE* bedfile, char* outname, char* outname_end, uint
     is_y = 0;
     next_chrom_start = unfiltered_marker_ct;
   }
-  for (; pct <= 100; pct++) {
-    loop_end = ((uint64_t)pct * marker_ct) / 100LU;
-    for (; marker_idx < loop_end; marker_uidx++, marker_idx++) {
-      if (IS_SET(marker_exclude, marker_uidx)) {
-	marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
-	if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_sample_ct4, SEEK_SET)) {
-	  goto calc_freqs_and_hwe_ret_READ_FAIL;
-	}
-      }
-      if (load_raw(bedfile, loadbuf, unfiltered_sample_ct4)) {
-	goto calc_freqs_and_hwe_ret_READ_FAIL;
-      }
-      if (marker_uidx >= next_chrom_start) {
+  pct = 0;
+  if (fseeko(bedfile, bed_offset, SEEK_SET)) {
+    goto calc_freqs_and_hwe_ret_READ_FAIL;
+  }
+  time_trace_push("freqs_hwe_blocks", marker_ct);
+  bed_prefetch_init(&bed_prefetch, bedfile, bed_offset, marker_exclude, marker_uidx, marker_idx, marker_ct, block_max_size, unfiltered_sample_ct4, geno_buf0, geno_buf1);
+  do {
+    block_marker_uidx = marker_uidx;
+    retval = bed_prefetch_next(&bed_prefetch, &g_cfh_geno, &marker_uidx, &marker_idx, &block_size);
+    if (retval) {
+      goto calc_freqs_and_hwe_ret_1;
+    }
+    is_last_block = (marker_idx == marker_ct);
+    // marker_uidx now points past the block; walk it again to tag variants
+    for (block_idx = 0; block_idx < block_size; block_marker_uidx++, block_idx++) {
+      next_unset_ul_unsafe_ck(marker_exclude, &block_marker_uidx);
+      g_cfh_marker_uidxs[block_idx] = block_marker_uidx;
+      if (block_marker_uidx >= next_chrom_start) {
 	do {
 	  next_chrom_start = chrom_info_ptr->chrom_file_order_marker_idx[(++cur_chrom_idx) + 1];
-	} while (marker_uidx >= next_chrom_start);
+	} while (block_marker_uidx >= next_chrom_start);
 	ii = chrom_info_ptr->chrom_file_order[cur_chrom_idx];
 	is_haploid = is_set(chrom_info_ptr->haploid_mask, ii);
 	is_x = (ii == chrom_info_ptr->x_code);
 	is_y = (ii == chrom_info_ptr->y_code);
       }
+      if (!is_haploid) {
+	g_cfh_chrom_classes[block_idx] = CFH_DIPLOID;
+      } else if (is_x) {
+	g_cfh_chrom_classes[block_idx] = CFH_X;
+      } else if (is_y) {
+	g_cfh_chrom_classes[block_idx] = CFH_Y;
+      } else {
+	g_cfh_chrom_classes[block_idx] = CFH_HAPLOID;
+      }
       if (om_entry_ptr) {
         cur_oblig_missing = 0;
-	while ((cur_om_entry >> 32) < marker_uidx) {
+	while ((cur_om_entry >> 32) < block_marker_uidx) {
 	  cur_om_entry = *(++om_entry_ptr);
 	}
-        while ((cur_om_entry >> 32) == marker_uidx) {
+        while ((cur_om_entry >> 32) == block_marker_uidx) {
           cur_oblig_missing += om_cluster_sizes[(uint32_t)cur_om_entry];
           cur_om_entry = *(++om_entry_ptr);
 	}
       }
-      if (!is_haploid) {
-	single_marker_freqs_and_hwe(unfiltered_sample_ctv2, loadbuf, sample_include2, founder_include2, founder_ctrl_include2, founder_case_include2, sample_ct, &ll_ct, &lh_ct, &hh_ct, sample_f_ct, &ll_ctf, &lh_ctf, &hh_ctf, hwe_needed, sample_f_ctrl_ct, &ll_hwe, &lh_hwe, &hh_hwe, hardy_needed, sample_f_case_ct, &ll_case_hwe, &lh_case_hwe, &hh_case_hwe);
-	hwe_ll_allfs[marker_uidx] = ll_ctf;
-	hwe_lh_allfs[marker_uidx] = lh_ctf;
-	hwe_hh_allfs[marker_uidx] = hh_ctf;
-	uii = ll_ct + lh_ct + hh_ct;
-	if (!cur_oblig_missing) {
-	  cur_genotyping_rate = ((int32_t)uii) * sample_ct_recip;
-	} else {
-	  if (sample_ct - cur_oblig_missing) {
-	    cur_genotyping_rate = ((int32_t)uii) / ((double)((int32_t)(sample_ct - cur_oblig_missing)));
-	  } else {
-	    cur_genotyping_rate = 0;
-	    nonmissing_rate_tot_max -= 1;
-	  }
+      g_cfh_oblig_missing[block_idx] = cur_oblig_missing;
+    }
+    g_cfh_block_size = block_size;
+    if (spawn_threads2(threads, &calc_freqs_and_hwe_thread, thread_ct, is_last_block)) {
+      goto calc_freqs_and_hwe_ret_THREAD_CREATE_FAIL;
+    }
+    ulii = 0;
+    calc_freqs_and_hwe_thread((void*)ulii);
+    join_threads2(threads, thread_ct, is_last_block);
+    for (block_idx = 0; block_idx < block_size; block_idx++) {
+      block_marker_uidx = g_cfh_marker_uidxs[block_idx];
+      uii = g_cfh_chrom_classes[block_idx];
+      ujj = g_cfh_hethap_cts[block_idx];
+      if (((uii == CFH_Y) && (!nonmissing_nonmale_y)) || ujj) {
+	memcpy(loadbuf, &(g_cfh_geno[block_idx * unfiltered_sample_ct4]), unfiltered_sample_ct4);
+	if ((uii == CFH_Y) && (!nonmissing_nonmale_y)) {
+	  nonmissing_nonmale_y = nonmissing_present_diff(unfiltered_sample_ctv2, loadbuf, sample_include2, sample_male_include2);
 	}
-	if (ac_excl_bitfield) {
-	  if (ll_ctf < hh_ctf) {
-	    uii = 2 * ll_ctf + lh_ctf;
-	  } else {
-	    uii = 2 * hh_ctf + lh_ctf;
-	  }
-	  if ((uii < min_ac) || (uii > max_ac)) {
-	    set_bit(ac_excl_bitfield, marker_uidx);
+      }
+      if (ujj) {
+	if (!hhfile) {
+	  memcpy(outname_end, ".hh", 4);
+	  if (fopen_checked(&hhfile, outname, "w")) {
+	    goto calc_freqs_and_hwe_ret_OPEN_FAIL;
 	  }
 	}
-	uii = 2 * (ll_ctf + lh_ctf + hh_ctf + maf_succ);
-	if (!uii) {
-	  // avoid 0/0 division
-	  set_allele_freqs[marker_uidx] = 0.5;
+	if (uii == CFH_X) {
+	  *hh_exists_ptr |= XMHH_EXISTS;
+	} else if (uii == CFH_Y) {
+	  *hh_exists_ptr |= Y_FIX_NEEDED;
 	} else {
-	  set_allele_freqs[marker_uidx] = ((double)(2 * hh_ctf + lh_ctf + maf_succ)) / ((double)uii);
+	  *hh_exists_ptr |= NXMHH_EXISTS;
 	}
-	if (hwe_needed) {
-	  hwe_lls[marker_uidx] = ll_hwe;
-	  hwe_lhs[marker_uidx] = lh_hwe;
-	  hwe_hhs[marker_uidx] = hh_hwe;
-	  if (hardy_needed) {
-	    hwe_ll_cases[marker_uidx] = ll_case_hwe;
-	    hwe_lh_cases[marker_uidx] = lh_case_hwe;
-	    hwe_hh_cases[marker_uidx] = hh_case_hwe;
+	lptr = (uii == CFH_HAPLOID)? sample_include2 : sample_male_include2;
+	for (sample_uidx = 0; sample_uidx < unfiltered_sample_ctv2; sample_uidx++) {
+	  ulii = loadbuf[sample_uidx];
+	  ulii = (ulii >> 1) & (~ulii) & lptr[sample_uidx];
+	  while (ulii) {
+	    ukk = sample_uidx * BITCT2 + CTZLU(ulii) / 2;
+	    fputs(&(sample_ids[ukk * max_sample_id_len]), hhfile);
+	    putc('\t', hhfile);
+	    fputs(&(marker_ids[block_marker_uidx * max_marker_id_len]), hhfile);
+	    putc('\n', hhfile);
+	    ulii &= ulii - ONELU;
 	  }
 	}
-      } else {
-	uii = 0;
-	ujj = 0;
-	if (is_x || is_y) {
-	  if (is_x) {
-	    single_marker_freqs_and_hwe(unfiltered_sample_ctv2, loadbuf, sample_nonmale_include2, founder_nonmale_include2, founder_ctrl_nonmale_include2, founder_case_nonmale_include2, sample_nonmale_ct, &ll_ct, &lh_ct, &hh_ct, sample_f_nonmale_ct, &ll_ctf, &lh_ctf, &hh_ctf, hwe_needed, sample_f_ctl_nonmale_ct, &ll_hwe, &lh_hwe, &hh_hwe, hardy_needed, sample_f_case_nonmale_ct, &ll_case_hwe, &lh_case_hwe, &hh_case_hwe);
-	    hwe_ll_allfs[marker_uidx] = ll_ctf;
-	    hwe_lh_allfs[marker_uidx] = lh_ctf;
-	    hwe_hh_allfs[marker_uidx] = hh_ctf;
-	    uii = 2 * (ll_ctf + lh_ctf + hh_ctf);
-	    ujj = 2 * hh_ctf + lh_ctf;
-	    ukk = ll_ct + lh_ct + hh_ct;
-	    if (hwe_needed) {
-	      hwe_lls[marker_uidx] = ll_hwe;
-	      hwe_lhs[marker_uidx] = lh_hwe;
-	      hwe_hhs[marker_uidx] = hh_hwe;
-	      if (hardy_needed) {
-		hwe_ll_cases[marker_uidx] = ll_case_hwe;
-		hwe_lh_cases[marker_uidx] = lh_case_hwe;
-		hwe_hh_cases[marker_uidx] = hh_case_hwe;
-	      }
-	    }
-	  } else if (!nonmissing_nonmale_y) {
-	    nonmissing_nonmale_y = nonmissing_present_diff(unfiltered_sample_ctv2, loadbuf, sample_include2, sample_male_include2);
-	  }
-	  haploid_single_marker_freqs(unfiltered_sample_ct, unfiltered_sample_ctv2, loadbuf, sample_male_include2, founder_male_include2, sample_male_ct, &ll_ct, &hh_ct, sample_f_male_ct, &ll_ctf, &hh_ctf, &hethap_incr);
-	  if ((is_x || sample_male_ct) && (sample_ct - cur_oblig_missing)) {
-	    if (is_x) {
-	      if (!cur_oblig_missing) {
-		cur_genotyping_rate = ((int32_t)(ll_ct + hh_ct + ukk)) * sample_ct_recip;
-	      } else {
-		cur_genotyping_rate = ((int32_t)(ll_ct + hh_ct + ukk)) / ((double)((int32_t)(sample_ct - cur_oblig_missing)));
-	      }
-	    } else {
-	      if (!cur_oblig_missing) {
-		cur_genotyping_rate = ((int32_t)(ll_ct + hh_ct)) * male_ct_recip;
-	      } else {
-		cur_genotyping_rate = ((int32_t)(ll_ct + hh_ct)) / ((double)((int32_t)(sample_male_ct - cur_oblig_missing)));
-	      }
-	    }
-	  } else {
-	    cur_genotyping_rate = 0;
-	    nonmissing_rate_tot_max -= 1;
-	  }
-	} else {
-	  haploid_single_marker_freqs(unfiltered_sample_ct, unfiltered_sample_ctv2, loadbuf, sample_include2, founder_include2, sample_ct, &ll_ct, &hh_ct, sample_f_ct, &ll_ctf, &hh_ctf, &hethap_incr);
-	  if (!cur_oblig_missing) {
-	    cur_genotyping_rate = ((int32_t)(ll_ct + hh_ct)) * sample_ct_recip;
-	  } else {
-	    if (sample_ct - cur_oblig_missing) {
-	      cur_genotyping_rate = ((int32_t)(ll_ct + hh_ct)) / ((double)((int32_t)(sample_ct - cur_oblig_missing)));
-	    } else {
-	      cur_genotyping_rate = 0;
-	      nonmissing_rate_tot_max -= 1;
-	    }
-	  }
-	}
-	if (hethap_incr) {
-	  if (!hhfile) {
-	    memcpy(outname_end, ".hh", 4);
-	    if (fopen_checked(&hhfile, outname, "w")) {
-	      goto calc_freqs_and_hwe_ret_OPEN_FAIL;
-	    }
-	  }
-	  if (is_x) {
-	    *hh_exists_ptr |= XMHH_EXISTS;
-	  } else if (is_y) {
-	    *hh_exists_ptr |= Y_FIX_NEEDED;
-	  } else {
-	    *hh_exists_ptr |= NXMHH_EXISTS;
-	  }
-	  if (is_x || is_y) {
-	    for (sample_uidx = 0; sample_uidx < unfiltered_sample_ctv2; sample_uidx++) {
-	      ulii = loadbuf[sample_uidx];
-	      ulii = (ulii >> 1) & (~ulii) & sample_male_include2[sample_uidx];
-	      while (ulii) {
-		ukk = sample_uidx * BITCT2 + CTZLU(ulii) / 2;
-		fputs(&(sample_ids[ukk * max_sample_id_len]), hhfile);
-		putc('\t', hhfile);
-		fputs(&(marker_ids[marker_uidx * max_marker_id_len]), hhfile);
-		putc('\n', hhfile);
-		ulii &= ulii - ONELU;
-	      }
-	    }
-	  } else {
-	    for (sample_uidx = 0; sample_uidx < unfiltered_sample_ctv2; sample_uidx++) {
-	      ulii = loadbuf[sample_uidx];
-	      ulii = (ulii >> 1) & (~ulii) & sample_include2[sample_uidx];
-	      while (ulii) {
-		ukk = sample_uidx * BITCT2 + CTZLU(ulii) / 2;
-		fputs(&(sample_ids[ukk * max_sample_id_len]), hhfile);
-		putc('\t', hhfile);
-		fputs(&(marker_ids[marker_uidx * max_marker_id_len]), hhfile);
-		putc('\n', hhfile);
-		ulii &= ulii - ONELU;
-	      }
-	    }
-	  }
-	  if (ferror(hhfile)) {
-	    goto calc_freqs_and_hwe_ret_WRITE_FAIL;
-	  }
-	  hethap_ct += hethap_incr;
+	if (ferror(hhfile)) {
+	  goto calc_freqs_and_hwe_ret_WRITE_FAIL;
 	}
-	hwe_hapl_allfs[marker_uidx] = ll_ctf;
-	hwe_haph_allfs[marker_uidx] = hh_ctf;
-	uii += ll_ctf + hh_ctf;
-	ujj += hh_ctf;
-	if (ac_excl_bitfield) {
-	  if (ujj <= uii / 2) {
-	    ukk = ujj;
-	  } else {
-	    ukk = uii - ujj;
-	  }
-	  if ((ukk < min_ac) || (ukk > max_ac)) {
-	    set_bit(ac_excl_bitfield, marker_uidx);
-	  }
-	}
-	uii += 2 * maf_succ;
-	ujj += maf_succ;
-	if (!uii) {
-	  maf = 0.5;
-	} else {
-	  maf = ((double)ujj) / ((double)uii);
-	}
-	set_allele_freqs[marker_uidx] = maf;
+	hethap_ct += ujj;
+      }
+      if (g_cfh_flags[block_idx] & CFH_RATE_UNDEF) {
+	nonmissing_rate_tot_max -= 1;
       }
+      if (g_cfh_flags[block_idx] & CFH_AC_EXCL) {
+	set_bit(ac_excl_bitfield, block_marker_uidx);
+      }
+      cur_genotyping_rate = g_cfh_geno_rates[block_idx];
       nonmissing_rate_tot += cur_genotyping_rate;
       if (geno_excl_bitfield && (cur_genotyping_rate < geno_thresh)) {
-	SET_BIT(geno_excl_bitfield, marker_uidx);
+	SET_BIT(geno_excl_bitfield, block_marker_uidx);
       }
     }
-    if (pct < 100) {
-      if (pct > 10) {
+    uii = (((uint64_t)marker_idx) * 100) / marker_ct;
+    if ((uii > pct) && (uii < 100)) {
+      if (pct >= 10) {
 	putchar('\b');
       }
-      printf("\b\b%u%%", pct);
+      printf("\b\b%u%%", uii);
       fflush(stdout);
+      pct = uii;
     }
-  }
+  } while (!is_last_block);
+  bed_prefetch_cleanup(&bed_prefetch);
+  time_trace_pop();
   fputs("\b\b\b\b", stdout);
   logprint(" done.\n");
   if (hethap_ct) {
@@ -2722,7 +3002,12 @@ int32_t calc_freqs_and_hwe(FILE* bedfile, char* outname, char* outname_end, uint
   calc_freqs_and_hwe_ret_WRITE_FAIL:
     retval = RET_WRITE_FAIL;
     break;
+  calc_freqs_and_hwe_ret_THREAD_CREATE_FAIL:
+    retval = RET_THREAD_CREATE_FAIL;
+    break;
   }
+ calc_freqs_and_hwe_ret_1:
+  bed_prefetch_cleanup(&bed_prefetch);
   wkspace_reset(wkspace_mark);
   fclose_cond(hhfile);
   return retval;
@@ -2892,12 +2892,11 @@ THREAD_RET_TYPE glm_linear_adapt_thread(void* arg) {
   // unlike the other permutation loops, g_perms_done is not preincremented
   // here
   uint32_t pidx_offset = g_perms_done;
-  uintptr_t marker_blocks = g_block_diff / CACHELINE_INT32;
-  uint32_t marker_bidx = CACHELINE_INT32 * ((((uint64_t)tidx) * marker_blocks) / g_assoc_thread_ct);
-  uint32_t marker_bceil = CACHELINE_INT32 * ((((uint64_t)(tidx + 1)) * marker_blocks) / g_assoc_thread_ct);
+  uint32_t marker_bidx = 0;
+  uint32_t marker_bceil = 0;
   uint32_t first_adapt_check = g_first_adapt_check;
   uintptr_t* loadbuf = g_loadbuf;
-  uint32_t* adapt_m_table = &(g_adapt_m_table[marker_bidx]);
+  uint32_t* adapt_m_table = g_adapt_m_table;
   double* perm_pmajor = g_perm_pmajor;
   unsigned char* __restrict__ perm_adapt_stop = g_perm_adapt_stop;
   uint32_t* __restrict__ perm_attempt_ct = g_perm_attempt_ct;
@@ -2973,11 +2972,8 @@ THREAD_RET_TYPE glm_linear_adapt_thread(void* arg) {
   } else {
     param_ctx_m1 = cur_param_ct - 1;
   }
-  if (tidx + 1 == g_assoc_thread_ct) {
-    marker_bceil = g_block_diff;
-  }
-  for (; marker_bidx < marker_bceil; marker_bidx++) {
-    marker_idx = *adapt_m_table++;
+  for (; (marker_bidx < marker_bceil) || ws_claim(tidx, 1, &marker_bidx, &marker_bceil); marker_bidx++) {
+    marker_idx = adapt_m_table[marker_bidx];
     if (perm_adapt_stop[marker_idx]) {
       continue;
     }
@@ -3076,12 +3072,11 @@ THREAD_RET_TYPE glm_logistic_adapt_thread(void* arg) {
   uintptr_t sample_valid_ctv2 = 2 * ((sample_valid_ct + (BITCT - 1)) / BITCT);
   uintptr_t perm_vec_ct = g_perm_vec_ct;
   uint32_t pidx_offset = g_perms_done;
-  uintptr_t marker_blocks = g_block_diff / CACHELINE_INT32;
-  uint32_t marker_bidx = CACHELINE_INT32 * ((((uint64_t)tidx) * marker_blocks) / g_assoc_thread_ct);
-  uint32_t marker_bceil = CACHELINE_INT32 * ((((uint64_t)(tidx + 1)) * marker_blocks) / g_assoc_thread_ct);
+  uint32_t marker_bidx = 0;
+  uint32_t marker_bceil = 0;
   uint32_t first_adapt_check = g_first_adapt_check;
   uintptr_t* loadbuf = g_loadbuf;
-  uint32_t* adapt_m_table = &(g_adapt_m_table[marker_bidx]);
+  uint32_t* adapt_m_table = g_adapt_m_table;
   uintptr_t* perm_vecs = g_perm_vecs;
   unsigned char* __restrict__ perm_adapt_stop = g_perm_adapt_stop;
   uint32_t* __restrict__ perm_attempt_ct = g_perm_attempt_ct;
@@ -3148,11 +3143,8 @@ THREAD_RET_TYPE glm_logistic_adapt_thread(void* arg) {
   } else {
     param_ctx_m1 = cur_param_ct - 1;
   }
-  if (tidx + 1 == g_assoc_thread_ct) {
-    marker_bceil = g_block_diff;
-  }
-  for (; marker_bidx < marker_bceil; marker_bidx++) {
-    marker_idx = *adapt_m_table++;
+  for (; (marker_bidx < marker_bceil) || ws_claim(tidx, 1, &marker_bidx, &marker_bceil); marker_bidx++) {
+    marker_idx = adapt_m_table[marker_bidx];
     if (perm_adapt_stop[marker_idx]) {
       continue;
     }
@@ -3225,11 +3217,10 @@ THREAD_RET_TYPE glm_linear_maxt_thread(void* arg) {
   uintptr_t sample_valid_ctv2 = 2 * ((sample_valid_ct + (BITCT - 1)) / BITCT);
   uintptr_t perm_vec_ct = g_perm_vec_ct;
   uint32_t pidx_offset = g_perms_done;
-  uintptr_t marker_blocks = g_block_diff / CACHELINE_INT32;
-  uint32_t marker_bidx = CACHELINE_INT32 * ((((uint64_t)tidx) * marker_blocks) / g_assoc_thread_ct);
-  uint32_t marker_bceil = CACHELINE_INT32 * ((((uint64_t)(tidx + 1)) * marker_blocks) / g_assoc_thread_ct);
+  uint32_t marker_bidx = 0;
+  uint32_t marker_bceil = 0;
   uintptr_t* loadbuf = g_loadbuf;
-  uint32_t* adapt_m_table = &(g_adapt_m_table[marker_bidx]);
+  uint32_t* adapt_m_table = g_adapt_m_table;
   double* perm_pmajor = g_perm_pmajor;
   uintptr_t perm_vec_ctcl8m = CACHEALIGN32_DBL(perm_vec_ct);
   double* __restrict__ results = &(g_maxt_thread_results[perm_vec_ctcl8m * tidx]);
@@ -3299,12 +3290,9 @@ THREAD_RET_TYPE glm_linear_maxt_thread(void* arg) {
   } else {
     param_ctx_m1 = cur_param_ct - 1;
   }
-  if (tidx + 1 == g_assoc_thread_ct) {
-    marker_bceil = g_block_diff;
-  }
   memcpy(results, &(g_maxt_extreme_stat[pidx_offset]), perm_vec_ct * sizeof(double));
-  for (; marker_bidx < marker_bceil; marker_bidx++) {
-    marker_idx = *adapt_m_table++;
+  for (; (marker_bidx < marker_bceil) || ws_claim(tidx, 1, &marker_bidx, &marker_bceil); marker_bidx++) {
+    marker_idx = adapt_m_table[marker_bidx];
     if (perm_adapt_stop[marker_idx]) {
       if (g_mperm_save_all && (perm_batch_max != perm_vec_ct)) {
 	msa_ptr = &(g_mperm_save_all[marker_idx * perm_vec_ct]);
@@ -3400,11 +3388,10 @@ THREAD_RET_TYPE glm_logistic_maxt_thread(void* arg) {
   uintptr_t sample_valid_ctv2 = 2 * ((sample_valid_ct + (BITCT - 1)) / BITCT);
   uintptr_t perm_vec_ct = g_perm_vec_ct;
   uint32_t pidx_offset = g_perms_done;
-  uintptr_t marker_blocks = g_block_diff / CACHELINE_INT32;
-  uint32_t marker_bidx = CACHELINE_INT32 * ((((uint64_t)tidx) * marker_blocks) / g_assoc_thread_ct);
-  uint32_t marker_bceil = CACHELINE_INT32 * ((((uint64_t)(tidx + 1)) * marker_blocks) / g_assoc_thread_ct);
+  uint32_t marker_bidx = 0;
+  uint32_t marker_bceil = 0;
   uintptr_t* loadbuf = g_loadbuf;
-  uint32_t* adapt_m_table = &(g_adapt_m_table[marker_bidx]);
+  uint32_t* adapt_m_table = g_adapt_m_table;
   uintptr_t* perm_vecs = g_perm_vecs;
   uintptr_t perm_vec_ctcl8m = CACHEALIGN32_DBL(perm_vec_ct);
   double* __restrict__ results = &(g_maxt_thread_results[perm_vec_ctcl8m * tidx]);
@@ -3465,12 +3452,9 @@ THREAD_RET_TYPE glm_logistic_maxt_thread(void* arg) {
   } else {
     param_ctx_m1 = cur_param_ct - 1;
   }
-  if (tidx + 1 == g_assoc_thread_ct) {
-    marker_bceil = g_block_diff;
-  }
   memcpy(results, &(g_maxt_extreme_stat[pidx_offset]), perm_vec_ct * sizeof(double));
-  for (; marker_bidx < marker_bceil; marker_bidx++) {
-    marker_idx = *adapt_m_table++;
+  for (; (marker_bidx < marker_bceil) || ws_claim(tidx, 1, &marker_bidx, &marker_bceil); marker_bidx++) {
+    marker_idx = adapt_m_table[marker_bidx];
     if (perm_adapt_stop[marker_idx]) {
       if (g_mperm_save_all && (perm_batch_max != perm_vec_ct)) {
 	msa_ptr = &(g_mperm_save_all[marker_idx * perm_vec_ct]);
@@ -4665,6 +4649,12 @@ int32_t glm_linear_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset
   uint32_t uii;
   uint32_t ujj;
   uint32_t ukk;
+  unsigned char* bed_prefetch_buf0;
+  unsigned char* bed_prefetch_buf1;
+  unsigned char* bed_row;
+  uint32_t use_prefetch;
+  Bed_prefetch bed_prefetch;
+  bed_prefetch.thread_active = 0;
   numbuf[0] = ' ';
   if ((chrom_info_ptr->mt_code != -1) && is_set(chrom_info_ptr->chrom_mask, chrom_info_ptr->mt_code)) {
     hh_or_mt_exists |= NXMHH_EXISTS;
@@ -5191,6 +5181,16 @@ int32_t glm_linear_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset
   if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_sample_ct4, SEEK_SET)) {
     goto glm_linear_assoc_ret_READ_FAIL;
   }
+  // as in model_assoc(), only later adaptive permutation passes need the
+  // synchronous loader
+  use_prefetch = 0;
+  if ((!perm_adapt_nst) || (!perm_pass_idx)) {
+    uii = bed_prefetch_row_alloc(unfiltered_sample_ct4, &bed_prefetch_buf0, &bed_prefetch_buf1);
+    if (uii) {
+      bed_prefetch_init(&bed_prefetch, bedfile, bed_offset, marker_exclude, marker_uidx, 0, marker_ct, uii, unfiltered_sample_ct4, bed_prefetch_buf0, bed_prefetch_buf1);
+      use_prefetch = 1;
+    }
+  }
   if (!perm_pass_idx) {
     fputs("0%", stdout);
     fflush(stdout);
@@ -5198,6 +5198,7 @@ int32_t glm_linear_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset
   marker_idx = 0;
   marker_idx2 = 0;
   chrom_end = 0;
+  time_trace_push("glm_linear_blocks", marker_unstopped_ct);
   do {
     if (marker_uidx >= chrom_end) {
       // exploit overflow
@@ -5277,7 +5278,7 @@ int32_t glm_linear_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset
 	  next_unset_unsafe_ck(marker_exclude, &marker_uidx);
 	  marker_idx2++;
 	} while ((marker_uidx < chrom_end) && g_perm_adapt_stop[marker_idx2]);
-	if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_sample_ct4, SEEK_SET)) {
+	if ((!use_prefetch) && fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_sample_ct4, SEEK_SET)) {
 	  goto glm_linear_assoc_ret_READ_FAIL;
 	}
 	if (marker_uidx >= chrom_end) {
@@ -5285,7 +5286,12 @@ int32_t glm_linear_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset
 	}
       }
       loadbuf_ptr = &(g_loadbuf[block_size * sample_valid_ctv2]);
-      if (load_and_collapse_incl(bedfile, loadbuf_raw, unfiltered_sample_ct, loadbuf_ptr, sample_valid_ct, load_mask, final_mask, IS_SET(marker_reverse, marker_uidx))) {
+      if (use_prefetch) {
+	if (bed_prefetch_row(&bed_prefetch, marker_uidx, &bed_row)) {
+	  goto glm_linear_assoc_ret_READ_FAIL;
+	}
+	copy_and_collapse_incl(bed_row, loadbuf_raw, unfiltered_sample_ct, loadbuf_ptr, sample_valid_ct, load_mask, final_mask, IS_SET(marker_reverse, marker_uidx));
+      } else if (load_and_collapse_incl(bedfile, loadbuf_raw, unfiltered_sample_ct, loadbuf_ptr, sample_valid_ct, load_mask, final_mask, IS_SET(marker_reverse, marker_uidx))) {
 	goto glm_linear_assoc_ret_READ_FAIL;
       }
       if (g_min_ploidy_1 && hh_or_mt_exists) {
@@ -5299,7 +5305,7 @@ int32_t glm_linear_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset
       marker_uidx++;
       if (IS_SET(marker_exclude, marker_uidx)) {
 	marker_uidx = next_unset_unsafe(marker_exclude, marker_uidx);
-	if (fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_sample_ct4, SEEK_SET)) {
+	if ((!use_prefetch) && fseeko(bedfile, bed_offset + ((uint64_t)marker_uidx) * unfiltered_sample_ct4, SEEK_SET)) {
 	  goto glm_linear_assoc_ret_READ_FAIL;
 	}
       }
@@ -5499,8 +5505,9 @@ int32_t glm_linear_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset
       }
     }
     if (do_perms_nst) {
-      // split loaded markers evenly between threads.  each thread does the
-      // following for every marker in its set:
+      // loaded markers are handed out through ws_claim(), since regression
+      // cost varies a lot between markers (convergence failures, adaptive
+      // stopping).  each thread does the following for every marker it claims:
       // 1. fill design matrix and make transposed copy, do this more
       //    efficiently if g_nm_cts[] indicates there are no missing genotypes
       // 2. 'standard-beta' adjustment if necessary (these first two steps
@@ -5514,6 +5521,7 @@ int32_t glm_linear_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset
 	g_assoc_thread_ct = 1;
       }
       ulii = 0;
+      ws_ranges_init(g_assoc_thread_ct, 0, g_block_diff);
       if (perm_adapt_nst) {
 	if (spawn_threads(threads, &glm_linear_adapt_thread, g_assoc_thread_ct)) {
 	  goto glm_linear_assoc_ret_THREAD_CREATE_FAIL;
@@ -5552,6 +5560,11 @@ int32_t glm_linear_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset
       }
     }
   } while (marker_idx < marker_unstopped_ct);
+  time_trace_pop();
+  if (use_prefetch) {
+    bed_prefetch_cleanup(&bed_prefetch);
+    wkspace_reset(bed_prefetch_buf0);
+  }
   // if more permutations, reevaluate marker_unstopped_ct, etc.
   if (!perm_pass_idx) {
     if (pct >= 10) {
@@ -5779,6 +5792,7 @@ int32_t glm_linear_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offset
     break;
   }
  glm_linear_assoc_ret_1:
+  bed_prefetch_cleanup(&bed_prefetch);
   wkspace_reset(wkspace_mark);
   fclose_cond(outfile);
   fclose_cond(outfile_msa);
@@ -6686,6 +6700,7 @@ int32_t glm_logistic_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offs
   marker_idx = 0;
   marker_idx2 = 0;
   chrom_end = 0;
+  time_trace_push("glm_logistic_blocks", marker_unstopped_ct);
   do {
     if (marker_uidx >= chrom_end) {
       // exploit overflow
@@ -6927,8 +6942,9 @@ int32_t glm_logistic_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offs
       }
     }
     if (do_perms_nst) {
-      // split loaded markers evenly between threads.  each thread does the
-      // following for every marker in its set:
+      // loaded markers are handed out through ws_claim(), since regression
+      // cost varies a lot between markers (convergence failures, adaptive
+      // stopping).  each thread does the following for every marker it claims:
       // 1. fill design matrix and make transposed copy, do this more
       //    efficiently if g_nm_cts[] indicates there are no missing genotypes
       // 2. logistic regression on permutations, handle adaptive logic,
@@ -6940,6 +6956,7 @@ int32_t glm_logistic_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offs
 	g_assoc_thread_ct = 1;
       }
       ulii = 0;
+      ws_ranges_init(g_assoc_thread_ct, 0, g_block_diff);
       if (perm_adapt_nst) {
 	if (spawn_threads(threads, &glm_logistic_adapt_thread, g_assoc_thread_ct)) {
 	  goto glm_logistic_assoc_ret_THREAD_CREATE_FAIL;
@@ -6978,6 +6995,7 @@ int32_t glm_logistic_assoc(pthread_t* threads, FILE* bedfile, uintptr_t bed_offs
       }
     }
   } while (marker_idx < marker_unstopped_ct);
+  time_trace_pop();
   // if more permutations, reevaluate marker_unstopped_ct, etc.
   if (!perm_pass_idx) {
     if (pct >= 10) {
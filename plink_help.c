@@ -309,7 +309,9 @@ int32_t disp_help(uint32_t param_ct, char** argv) {
 	       );
     help_print("vcf\tbcf", &help_ctrl, 1,
 "  --vcf [filename] : Specify full name of .vcf or .vcf.gz file.\n"
-"  --bcf [filename] : Specify full name of BCF2 file.\n\n"
+"  --bcf [filename] : Specify full name of BCF2 file.\n"
+"    If a BGZF-compressed input file has a tabix (.tbi) or CSI (.csi) index next\n"
+"    to it, --chr and --from-bp/--to-bp filters only read the indexed regions.\n\n"
 	       );
     help_print("data\tgen\tbgen\tsample", &help_ctrl, 1,
 "  --data {prefix}  : Specify Oxford .gen + .sample prefix (default '" PROG_NAME_STR "').\n"
@@ -382,7 +384,7 @@ int32_t disp_help(uint32_t param_ct, char** argv) {
 "  --recode <01 | 12> <23 | A{-transpose} | AD | beagle{-nomap} | bimbam{-1chr}\n"
 "           | compound-genotypes | fastphase{-1chr} | HV{-1chr} | lgen{-ref} |\n"
 "           list | oxford | rlist | structure | transpose | vcf | vcf-fid |\n"
-"           vcf-iid> <tab | tabx | spacex | bgz> <include-alt>\n"
+"           vcf-iid> <tab | tabx | spacex | bgz> <include-alt> <bin4>\n"
 "    Create a new text fileset with all filters applied.  By default, the\n"
 "    fileset consists of a .ped and a .map file, readable with --file.\n"
 "    * The '12' modifier causes A1 (usually minor) alleles to be coded as '1'\n"
@@ -396,6 +398,10 @@ int32_t disp_help(uint32_t param_ct, char** argv) {
 "      'include-alt' modifier.\n"
 "    * The 'A-transpose' modifier causes a variant-major additive component file\n"
 "      to be generated.\n"
+"    * With 'A' or 'A-transpose', the 'bin4' modifier causes the additive\n"
+"      component matrix to be written to {output prefix}.raw.bin or .traw.bin\n"
+"      in single-precision binary (missing calls = NaN), in the same row order\n"
+"      as the text file, which then only contains the ID/variant columns.\n"
 "    * The 'beagle' modifier causes unphased per-autosome .dat and .map files,\n"
 "      readable by early BEAGLE versions, to be generated, while 'beagle-nomap'\n"
 "      generates a single .beagle.dat file.\n"
@@ -602,10 +608,10 @@ int32_t disp_help(uint32_t param_ct, char** argv) {
 "    .prune.in/.prune.out file to apply the list to another computation.\n\n"
 		);
     help_print("r\tr2\tmatrix\tinter-chr\tD\tdprime\twith-freqs\tld", &help_ctrl, 1,
-"  --r <square | square0 | triangle | inter-chr> <gz | bin | bin4> <spaces>\n"
-"      <in-phase> <dprime> <with-freqs> <yes-really>\n"
-"  --r2 <square | square0 | triangle | inter-chr> <gz | bin | bin4> <spaces>\n"
-"       <in-phase> <dprime> <with-freqs> <yes-really>\n"
+"  --r <square | square0 | triangle | inter-chr> <gz | bin | bin4 | bin-sparse>\n"
+"      <spaces> <in-phase> <dprime> <with-freqs> <yes-really>\n"
+"  --r2 <square | square0 | triangle | inter-chr> <gz | bin | bin4 | bin-sparse>\n"
+"       <spaces> <in-phase> <dprime> <with-freqs> <yes-really>\n"
 "    LD statistic reports.  --r yields raw inter-variant correlations, while\n"
 "    --r2 reports their squares.  You can request results for all pairs in\n"
 "    matrix format (if you specify 'bin' or one of the shape modifiers), all\n"
@@ -615,6 +621,11 @@ int32_t disp_help(uint32_t param_ct, char** argv) {
 "    * 'bin' causes the output matrix to be written in double-precision binary\n"
 "      format, while 'bin4' specifics single-precision binary.  The matrix is\n"
 "      square if no shape is explicitly specified.\n"
+"    * 'bin-sparse' writes table-format results to {output prefix}.ld.sparse\n"
+"      instead: a header, a fixed-width per-variant offset table, and then one\n"
+"      (partner index, single-precision r/r^2) record per reported pair, so\n"
+"      any variant's partners can be located without a scan.  Variant indices\n"
+"      are 0-based positions in the filtered variant list.\n"
 "    * By default, text matrices are tab-delimited; 'spaces' switches this.\n"
 "    * 'in-phase' adds a column with in-phase allele pairs to table-formatted\n"
 "      reports.  (This cannot be used with very long allele codes.)\n"
@@ -2087,9 +2098,40 @@ int32_t disp_help(uint32_t param_ct, char** argv) {
 "  --memory [val]     : Set size, in MB, of initial workspace malloc attempt.\n"
 "                       (Practically mandatory when using GNU parallel.)\n"
 	       );
+#ifndef _WIN32
+    help_print("bim-cache", &help_ctrl, 0,
+"  --bim-cache        : Save a binary copy of the parsed .bim file (as\n"
+"                       {.bim filename}.cache), and load that instead of the\n"
+"                       text file on later runs as long as the .bim is\n"
+"                       unchanged.\n"
+	       );
+    help_print("id-index\textract\texclude\tupdate-name", &help_ctrl, 0,
+"  --id-index         : Save the variant ID hash table used by --extract,\n"
+"                       --exclude, --update-name, etc. as {.bim filename}.idx,\n"
+"                       and memory-map it on later runs instead of rebuilding\n"
+"                       it, as long as the .bim is unchanged.\n"
+	       );
+    help_print("mmap-bed", &help_ctrl, 0,
+"  --mmap-bed         : Memory-map the .bed file instead of reading it with\n"
+"                       ordinary file I/O.  Usually faster on large filesets\n"
+"                       which are read several times.\n"
+	       );
+#endif
+    help_print("sample-major-cache\tmind\thet\tcheck-sex\timpute-sex", &help_ctrl, 0,
+"  --sample-major-cache : Keep a transposed copy of the .bed as {.bed}.smaj,\n"
+"                         and use it for --mind, --het, and --check-sex/\n"
+"                         --impute-sex.  The copy is rewritten whenever the\n"
+"                         .bed's size or timestamps change.\n"
+	       );
     help_print("threads\tthread-num\tnum_threads", &help_ctrl, 0,
 "  --threads [val]    : Set maximum number of concurrent threads.\n"
 	       );
+    help_print("time-trace", &help_ctrl, 0,
+"  --time-trace <tsv> : Write wall-clock time, CPU time, bytes read, and time\n"
+"                       spent waiting on .bed reads for each major phase\n"
+"                       (and for the block loops within it) to\n"
+"                       {output prefix}.trace.json (or .trace.tsv).\n"
+	       );
     help_print("d\tsnps", &help_ctrl, 0,
 "  --d [char]         : Change variant/covariate range delimiter (normally '-').\n"
 	       );
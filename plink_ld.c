@@ -7,9 +7,6 @@
 #include "plink_stats.h"
 #include "pigz.h"
 
-#define MULTIPLEX_LD 1920
-#define MULTIPLEX_2LD (MULTIPLEX_LD * 2)
-
 void ld_epi_init(Ld_info* ldip, Epi_info* epi_ip, Clump_info* clump_ip) {
   ldip->modifier = 0;
   ldip->prune_window_size = 0;
@@ -244,7 +241,180 @@ static inline void ld_dot_prod_batch(__m128i* vec1, __m128i* vec2, __m128i* mask
   return_vals[4] += ((acc22.u8[0] + acc22.u8[1]) * 0x1000100010001LLU) >> 48;
 }
 
+#ifdef SIMD_DISPATCH
+// Wider versions of ld_dot_prod_batch() and ld_dot_prod_nm_batch(), operating
+// on word_ct words at once.  Their accumulators cannot overflow, so the work
+// does not need to be split into MULTIPLEX_LD-sized batches.  See
+// ld_dot_prod_batch() for the math.
+TARGET_AVX2 static void ld_dot_prod_avx2(uintptr_t* vec1, uintptr_t* vec2, uintptr_t* mask1, uintptr_t* mask2, int32_t* return_vals, uintptr_t word_ct) {
+  const __m256i m1 = _mm256_set1_epi64x(FIVEMASK);
+  uintptr_t* vec1_end = &(vec1[word_ct]);
+  uintptr_t* vec1_4x_end = &(vec1[word_ct & (~(3 * ONELU))]);
+  __m256i acc = _mm256_setzero_si256();
+  __m256i acc1 = _mm256_setzero_si256();
+  __m256i acc2 = _mm256_setzero_si256();
+  __m256i acc11 = _mm256_setzero_si256();
+  __m256i acc22 = _mm256_setzero_si256();
+  __m256i loader1;
+  __m256i loader2;
+  __m256i sum1;
+  __m256i sum2;
+  __m256i sum12;
+  uintptr_t ulii;
+  uintptr_t uljj;
+  uintptr_t ulkk;
+  uintptr_t ulmm;
+  uintptr_t ulnn;
+  while (vec1 < vec1_4x_end) {
+    loader1 = _mm256_loadu_si256((__m256i*)vec1);
+    loader2 = _mm256_loadu_si256((__m256i*)vec2);
+    sum1 = _mm256_and_si256(_mm256_loadu_si256((__m256i*)mask2), loader1);
+    sum2 = _mm256_and_si256(_mm256_loadu_si256((__m256i*)mask1), loader2);
+    sum12 = _mm256_and_si256(_mm256_or_si256(loader1, loader2), m1);
+    sum12 = _mm256_or_si256(sum12, _mm256_andnot_si256(_mm256_add_epi64(m1, sum12), _mm256_xor_si256(loader1, loader2)));
+    acc = _mm256_add_epi64(acc, popcount2_epi64_avx2(sum12));
+    acc1 = _mm256_add_epi64(acc1, popcount2_epi64_avx2(sum1));
+    acc2 = _mm256_add_epi64(acc2, popcount2_epi64_avx2(sum2));
+    acc11 = _mm256_add_epi64(acc11, popcount_epi64_avx2(_mm256_and_si256(sum1, m1)));
+    acc22 = _mm256_add_epi64(acc22, popcount_epi64_avx2(_mm256_and_si256(sum2, m1)));
+    vec1 = &(vec1[4]);
+    vec2 = &(vec2[4]);
+    mask1 = &(mask1[4]);
+    mask2 = &(mask2[4]);
+  }
+  return_vals[0] -= hsum_epi64_avx2(acc);
+  return_vals[1] += hsum_epi64_avx2(acc1);
+  return_vals[2] += hsum_epi64_avx2(acc2);
+  return_vals[3] += hsum_epi64_avx2(acc11);
+  return_vals[4] += hsum_epi64_avx2(acc22);
+  while (vec1 < vec1_end) {
+    ulii = *vec1++;
+    uljj = *vec2++;
+    ulkk = (*mask2++) & ulii;
+    ulmm = (*mask1++) & uljj;
+    ulnn = (ulii | uljj) & FIVEMASK;
+    ulnn |= (~(FIVEMASK + ulnn)) & (ulii ^ uljj);
+    return_vals[0] -= popcount2_long_hw(ulnn);
+    return_vals[1] += popcount2_long_hw(ulkk);
+    return_vals[2] += popcount2_long_hw(ulmm);
+    return_vals[3] += popcount_long_hw(ulkk & FIVEMASK);
+    return_vals[4] += popcount_long_hw(ulmm & FIVEMASK);
+  }
+}
+
+TARGET_AVX512 static void ld_dot_prod_avx512(uintptr_t* vec1, uintptr_t* vec2, uintptr_t* mask1, uintptr_t* mask2, int32_t* return_vals, uintptr_t word_ct) {
+  const __m512i m1 = _mm512_set1_epi64(FIVEMASK);
+  __m512i acc = _mm512_setzero_si512();
+  __m512i acc1 = _mm512_setzero_si512();
+  __m512i acc2 = _mm512_setzero_si512();
+  __m512i acc11 = _mm512_setzero_si512();
+  __m512i acc22 = _mm512_setzero_si512();
+  __m512i loader1;
+  __m512i loader2;
+  __m512i sum1;
+  __m512i sum2;
+  __m512i sum12;
+  __mmask8 load_mask = 0xff;
+  while (word_ct) {
+    if (word_ct < 8) {
+      load_mask = (__mmask8)((1U << word_ct) - 1);
+      word_ct = 8;
+    }
+    loader1 = _mm512_maskz_loadu_epi64(load_mask, vec1);
+    loader2 = _mm512_maskz_loadu_epi64(load_mask, vec2);
+    sum1 = _mm512_and_si512(_mm512_maskz_loadu_epi64(load_mask, mask2), loader1);
+    sum2 = _mm512_and_si512(_mm512_maskz_loadu_epi64(load_mask, mask1), loader2);
+    sum12 = _mm512_and_si512(_mm512_or_si512(loader1, loader2), m1);
+    sum12 = _mm512_or_si512(sum12, andnot_avx512(_mm512_add_epi64(m1, sum12), _mm512_xor_si512(loader1, loader2)));
+    acc = _mm512_add_epi64(acc, popcount2_epi64_avx512(sum12));
+    acc1 = _mm512_add_epi64(acc1, popcount2_epi64_avx512(sum1));
+    acc2 = _mm512_add_epi64(acc2, popcount2_epi64_avx512(sum2));
+    acc11 = _mm512_add_epi64(acc11, _mm512_popcnt_epi64(_mm512_and_si512(sum1, m1)));
+    acc22 = _mm512_add_epi64(acc22, _mm512_popcnt_epi64(_mm512_and_si512(sum2, m1)));
+    vec1 = &(vec1[8]);
+    vec2 = &(vec2[8]);
+    mask1 = &(mask1[8]);
+    mask2 = &(mask2[8]);
+    word_ct -= 8;
+  }
+  return_vals[0] -= hsum_epi64_avx512(acc);
+  return_vals[1] += hsum_epi64_avx512(acc1);
+  return_vals[2] += hsum_epi64_avx512(acc2);
+  return_vals[3] += hsum_epi64_avx512(acc11);
+  return_vals[4] += hsum_epi64_avx512(acc22);
+}
+
+TARGET_AVX2 static int32_t ld_dot_prod_nm_avx2(uintptr_t* vec1, uintptr_t* vec2, uintptr_t word_ct) {
+  const __m256i m1 = _mm256_set1_epi64x(FIVEMASK);
+  uintptr_t* vec1_end = &(vec1[word_ct]);
+  uintptr_t* vec1_4x_end = &(vec1[word_ct & (~(3 * ONELU))]);
+  __m256i acc = _mm256_setzero_si256();
+  __m256i loader1;
+  __m256i loader2;
+  __m256i sum12;
+  uintptr_t ulii;
+  uintptr_t uljj;
+  uintptr_t ulkk;
+  int32_t result;
+  while (vec1 < vec1_4x_end) {
+    loader1 = _mm256_loadu_si256((__m256i*)vec1);
+    loader2 = _mm256_loadu_si256((__m256i*)vec2);
+    sum12 = _mm256_and_si256(_mm256_or_si256(loader1, loader2), m1);
+    sum12 = _mm256_or_si256(sum12, _mm256_andnot_si256(_mm256_add_epi64(m1, sum12), _mm256_xor_si256(loader1, loader2)));
+    acc = _mm256_add_epi64(acc, popcount2_epi64_avx2(sum12));
+    vec1 = &(vec1[4]);
+    vec2 = &(vec2[4]);
+  }
+  result = (int32_t)hsum_epi64_avx2(acc);
+  while (vec1 < vec1_end) {
+    ulii = *vec1++;
+    uljj = *vec2++;
+    ulkk = (ulii | uljj) & FIVEMASK;
+    ulkk |= (~(FIVEMASK + ulkk)) & (ulii ^ uljj);
+    result += popcount2_long_hw(ulkk);
+  }
+  return result;
+}
+
+TARGET_AVX512 static int32_t ld_dot_prod_nm_avx512(uintptr_t* vec1, uintptr_t* vec2, uintptr_t word_ct) {
+  const __m512i m1 = _mm512_set1_epi64(FIVEMASK);
+  __m512i acc = _mm512_setzero_si512();
+  __m512i loader1;
+  __m512i loader2;
+  __m512i sum12;
+  __mmask8 load_mask = 0xff;
+  while (word_ct) {
+    if (word_ct < 8) {
+      load_mask = (__mmask8)((1U << word_ct) - 1);
+      word_ct = 8;
+    }
+    loader1 = _mm512_maskz_loadu_epi64(load_mask, vec1);
+    loader2 = _mm512_maskz_loadu_epi64(load_mask, vec2);
+    sum12 = _mm512_and_si512(_mm512_or_si512(loader1, loader2), m1);
+    sum12 = _mm512_or_si512(sum12, andnot_avx512(_mm512_add_epi64(m1, sum12), _mm512_xor_si512(loader1, loader2)));
+    acc = _mm512_add_epi64(acc, popcount2_epi64_avx512(sum12));
+    vec1 = &(vec1[8]);
+    vec2 = &(vec2[8]);
+    word_ct -= 8;
+  }
+  return (int32_t)hsum_epi64_avx512(acc);
+}
+#endif
+
 void ld_dot_prod(uintptr_t* vec1, uintptr_t* vec2, uintptr_t* mask1, uintptr_t* mask2, int32_t* return_vals, uint32_t batch_ct_m1, uint32_t last_batch_size) {
+#ifdef SIMD_DISPATCH
+  if (g_simd_level) {
+    // each full batch covers MULTIPLEX_LD / BITCT2 words, and each
+    // ld_dot_prod_batch() iteration covers 6
+    uintptr_t word_ct = ((uintptr_t)batch_ct_m1) * (MULTIPLEX_LD / BITCT2) + last_batch_size * 6;
+    if (g_simd_level == SIMD_LEVEL_AVX512) {
+      ld_dot_prod_avx512(vec1, vec2, mask1, mask2, return_vals, word_ct);
+    } else {
+      ld_dot_prod_avx2(vec1, vec2, mask1, mask2, return_vals, word_ct);
+    }
+    return;
+  }
+#endif
   while (batch_ct_m1--) {
     ld_dot_prod_batch((__m128i*)vec1, (__m128i*)vec2, (__m128i*)mask1, (__m128i*)mask2, return_vals, MULTIPLEX_LD / 192);
     vec1 = &(vec1[MULTIPLEX_LD / BITCT2]);
@@ -302,6 +472,15 @@ static inline int32_t ld_dot_prod_nm_batch(__m128i* vec1, __m128i* vec2, uint32_
 int32_t ld_dot_prod_nm(uintptr_t* vec1, uintptr_t* vec2, uint32_t founder_ct, uint32_t batch_ct_m1, uint32_t last_batch_size) {
   // accelerated implementation for no-missing-loci case
   int32_t result = (int32_t)founder_ct;
+#ifdef SIMD_DISPATCH
+  if (g_simd_level) {
+    uintptr_t word_ct = ((uintptr_t)batch_ct_m1) * (MULTIPLEX_LD / BITCT2) + last_batch_size * 6;
+    if (g_simd_level == SIMD_LEVEL_AVX512) {
+      return result - ld_dot_prod_nm_avx512(vec1, vec2, word_ct);
+    }
+    return result - ld_dot_prod_nm_avx2(vec1, vec2, word_ct);
+  }
+#endif
   while (batch_ct_m1--) {
     result -= ld_dot_prod_nm_batch((__m128i*)vec1, (__m128i*)vec2, MULTIPLEX_LD / 192);
     vec1 = &(vec1[MULTIPLEX_LD / BITCT2]);
@@ -720,17 +899,138 @@ int32_t ld_prune_write(char* outname, char* outname_end, uintptr_t* marker_exclu
   return retval;
 }
 
-int32_t ld_prune(Ld_info* ldip, FILE* bedfile, uintptr_t bed_offset, uintptr_t marker_ct, uintptr_t unfiltered_marker_ct, uintptr_t* marker_exclude, uintptr_t* marker_reverse, char* marker_ids, uintptr_t max_marker_id_len, Chrom_info* chrom_info_ptr, double* set_allele_freqs, uint32_t* marker_pos, uintptr_t unfiltered_sample_ct, uintptr_t* founder_info, uintptr_t* sex_male, char* outname, char* outname_end, uint32_t hh_exists) {
-  // Results are slightly different from PLINK 1.07 when missing data is
-  // present, but that's due to a minor bug in 1.07 (sample per-marker
-  // variances don't exclude the missing markers).
+// --indep[-pairwise] is parallelized across chromosomes.  Each worker claims
+// whole chromosomes and has its own window buffers, .bed file handle, and
+// copy of pruned_arr (merged after the threads are joined), so results do not
+// depend on the thread count.
+//
+// Genotype/mask rows and --indep correlation matrix entries live in fixed
+// buffer slots, and window_slots[] maps window positions to slots.  When the
+// window advances, only the per-position scalars are compacted; surviving
+// variants keep their slots and new variants are loaded into the freed ones.
+// Together with start_arr[] (which records how far each variant has already
+// been compared), this means only pairs involving new variants are evaluated.
+typedef struct {
+  FILE* bedfile;
+  uintptr_t* pruned_arr;
+  uintptr_t* loadbuf;
+  uint32_t* live_indices;
+  uint32_t* start_arr;
+  uint32_t* window_slots;
+  uintptr_t* geno;
+  uintptr_t* geno_masks;
+  uintptr_t* geno_mmasks;
+  uint32_t* missing_cts;
+  double* sums;
+  double* variance_recips; // entries are actually n^2 / variance
+  uintptr_t* nonmale_geno;
+  uintptr_t* nonmale_masks;
+  double* cov_matrix;
+  double* new_cov_matrix;
+  uint32_t* idx_remap;
+  MATRIX_INVERT_BUF1_TYPE* irow;
+  double* work;
+} Ld_prune_buf;
+
+static Ld_info* g_ld_prune_ldip;
+static Ld_prune_buf* g_ld_prune_bufs;
+static Chrom_info* g_ld_prune_chrom_info_ptr;
+static uintptr_t* g_ld_prune_marker_exclude;
+static uintptr_t* g_ld_prune_marker_reverse;
+static uintptr_t* g_ld_prune_founder_info;
+static uintptr_t* g_ld_prune_founder_include2;
+static uintptr_t* g_ld_prune_founder_male_include2;
+static double* g_ld_prune_set_allele_freqs;
+static uint32_t* g_ld_prune_marker_pos;
+// first unfiltered index of each chromosome, and per-chromosome prune counts
+static uint32_t* g_ld_prune_chrom_starts;
+static uintptr_t* g_ld_prune_exclude_cts;
+static uintptr_t g_ld_prune_bed_offset;
+static uintptr_t g_ld_prune_unfiltered_marker_ct;
+static uintptr_t g_ld_prune_unfiltered_sample_ct;
+static uintptr_t g_ld_prune_founder_ct;
+static uintptr_t g_ld_prune_window_max;
+static double g_ld_prune_thresh;
+static uint32_t g_ld_prune_nonmale_founder_ct;
+static uint32_t g_ld_prune_hh_exists;
+static uint32_t g_ld_prune_show_pct;
+static volatile int32_t g_ld_prune_retval;
+
+int32_t ld_prune_alloc_buf(Ld_prune_buf* bufp, uintptr_t window_max, uintptr_t unfiltered_sample_ctl2, uintptr_t founder_ct_192_long, uintptr_t founder_ctv, uint32_t founder_trail_ct, uint32_t weighted_x, uint32_t pairwise) {
+  uintptr_t ulii = window_max;
+  bufp->nonmale_geno = NULL;
+  bufp->nonmale_masks = NULL;
+  bufp->cov_matrix = NULL;
+  bufp->new_cov_matrix = NULL;
+  bufp->idx_remap = NULL;
+  bufp->irow = NULL;
+  bufp->work = NULL;
+  if (wkspace_alloc_ui_checked(&(bufp->live_indices), ulii * sizeof(int32_t)) ||
+      wkspace_alloc_ui_checked(&(bufp->start_arr), ulii * sizeof(int32_t)) ||
+      wkspace_alloc_ui_checked(&(bufp->window_slots), ulii * sizeof(int32_t)) ||
+      wkspace_alloc_ul_checked(&(bufp->loadbuf), unfiltered_sample_ctl2 * sizeof(intptr_t)) ||
+      wkspace_alloc_ul_checked(&(bufp->geno), ulii * founder_ct_192_long * sizeof(intptr_t)) ||
+      wkspace_alloc_ul_checked(&(bufp->geno_masks), ulii * founder_ct_192_long * sizeof(intptr_t)) ||
+      wkspace_alloc_ul_checked(&(bufp->geno_mmasks), ulii * founder_ctv * sizeof(intptr_t)) ||
+      wkspace_alloc_ui_checked(&(bufp->missing_cts), ulii * sizeof(int32_t)) ||
+      wkspace_alloc_d_checked(&(bufp->sums), ulii * sizeof(double)) ||
+      wkspace_alloc_d_checked(&(bufp->variance_recips), ulii * sizeof(double))) {
+    return 1;
+  }
+  if (weighted_x) {
+    if (wkspace_alloc_ul_checked(&(bufp->nonmale_geno), ulii * founder_ct_192_long * sizeof(intptr_t)) ||
+        wkspace_alloc_ul_checked(&(bufp->nonmale_masks), ulii * founder_ct_192_long * sizeof(intptr_t))) {
+      return 1;
+    }
+  }
+  for (ulii = 1; ulii <= window_max; ulii++) {
+    fill_ulong_zero(&(bufp->geno[ulii * founder_ct_192_long - founder_trail_ct - 2]), founder_trail_ct + 2);
+    fill_ulong_zero(&(bufp->geno_masks[ulii * founder_ct_192_long - founder_trail_ct - 2]), founder_trail_ct + 2);
+    if (weighted_x) {
+      fill_ulong_zero(&(bufp->nonmale_geno[ulii * founder_ct_192_long - founder_trail_ct - 2]), founder_trail_ct + 2);
+      fill_ulong_zero(&(bufp->nonmale_masks[ulii * founder_ct_192_long - founder_trail_ct - 2]), founder_trail_ct + 2);
+    }
+  }
+  if (!pairwise) {
+    if (wkspace_alloc_d_checked(&(bufp->cov_matrix), window_max * window_max * sizeof(double)) ||
+        wkspace_alloc_d_checked(&(bufp->new_cov_matrix), window_max * window_max * sizeof(double)) ||
+        wkspace_alloc_ui_checked(&(bufp->idx_remap), window_max * sizeof(int32_t))) {
+      return 1;
+    }
+    bufp->irow = (MATRIX_INVERT_BUF1_TYPE*)wkspace_alloc(window_max * 2 * sizeof(MATRIX_INVERT_BUF1_TYPE));
+    if (!bufp->irow) {
+      return 1;
+    }
+    if (window_max < 4) {
+      ulii = 4;
+    } else {
+      ulii = window_max;
+    }
+    if (wkspace_alloc_d_checked(&(bufp->work), ulii * window_max * sizeof(double))) {
+      return 1;
+    }
+  }
+  return 0;
+}
 
-  // for future consideration: chromosome-based multithread/parallel?
-  unsigned char* wkspace_mark = wkspace_base;
-  uintptr_t unfiltered_marker_ctl = (unfiltered_marker_ct + (BITCT - 1)) / BITCT;
+int32_t ld_prune_chrom(Ld_prune_buf* bufp, uint32_t window_unfiltered_start, uintptr_t* cur_exclude_ct_ptr, uint32_t show_pct) {
+  // Prunes the chromosome starting at window_unfiltered_start.
+  Ld_info* ldip = g_ld_prune_ldip;
+  Chrom_info* chrom_info_ptr = g_ld_prune_chrom_info_ptr;
+  FILE* bedfile = bufp->bedfile;
+  uintptr_t* pruned_arr = bufp->pruned_arr;
+  uintptr_t* marker_exclude = g_ld_prune_marker_exclude;
+  uintptr_t* marker_reverse = g_ld_prune_marker_reverse;
+  uintptr_t* founder_info = g_ld_prune_founder_info;
+  uintptr_t* founder_include2 = g_ld_prune_founder_include2;
+  uintptr_t* founder_male_include2 = g_ld_prune_founder_male_include2;
+  double* set_allele_freqs = g_ld_prune_set_allele_freqs;
+  uint32_t* marker_pos = g_ld_prune_marker_pos;
+  uintptr_t bed_offset = g_ld_prune_bed_offset;
+  uintptr_t unfiltered_marker_ct = g_ld_prune_unfiltered_marker_ct;
+  uintptr_t unfiltered_sample_ct = g_ld_prune_unfiltered_sample_ct;
   uintptr_t unfiltered_sample_ct4 = (unfiltered_sample_ct + 3) / 4;
-  uintptr_t unfiltered_sample_ctl2 = 2 * ((unfiltered_sample_ct + (BITCT - 1)) / BITCT);
-  uintptr_t founder_ct = popcount_longs(founder_info, unfiltered_sample_ctl2 / 2);
+  uintptr_t founder_ct = g_ld_prune_founder_ct;
   uintptr_t founder_ctl = (founder_ct + BITCT - 1) / BITCT;
 #ifdef __LP64__
   uintptr_t founder_ctv = 2 * ((founder_ct + 127) / 128);
@@ -747,7 +1047,6 @@ int32_t ld_prune(Ld_info* ldip, FILE* bedfile, uintptr_t bed_offset, uintptr_t m
   uintptr_t founder_ct_192_long = founder_ct_mld_m1 * (MULTIPLEX_LD / BITCT2) + founder_ct_mld_rem * (192 / BITCT2);
   uintptr_t final_mask = get_final_mask(founder_ct);
   uint32_t weighted_founder_ct = founder_ct;
-  uint32_t founder_trail_ct = founder_ct_192_long - founder_ctl * 2;
   uint32_t pairwise = (ldip->modifier / LD_PRUNE_PAIRWISE) & 1;
   uint32_t ignore_x = (ldip->modifier / LD_IGNORE_X) & 1;
   uint32_t weighted_x = (ldip->modifier / LD_WEIGHTED_X) & 1;
@@ -755,30 +1054,31 @@ int32_t ld_prune(Ld_info* ldip, FILE* bedfile, uintptr_t bed_offset, uintptr_t m
   uint32_t ld_window_size = ldip->prune_window_size;
   uint32_t ld_window_incr = ldip->prune_window_incr;
   double ld_last_param = ldip->prune_last_param;
-  uint32_t nonmale_founder_ct = 0;
-  uintptr_t window_max = 1;
-  uintptr_t* geno = NULL;
-  uintptr_t* founder_include2 = NULL;
-  uintptr_t* founder_male_include2 = NULL;
-  uintptr_t* nonmale_geno = NULL;
-  uintptr_t* nonmale_masks = NULL;
-  double* cov_matrix = NULL;
-  double* new_cov_matrix = NULL;
-  MATRIX_INVERT_BUF1_TYPE* irow = NULL;
-  double* work = NULL;
-  uint32_t* idx_remap = NULL;
-  uint32_t tot_exclude_ct = 0;
+  double prune_ld_thresh = g_ld_prune_thresh;
+  uint32_t nonmale_founder_ct = g_ld_prune_nonmale_founder_ct;
+  uint32_t hh_exists = g_ld_prune_hh_exists;
+  uintptr_t window_max = g_ld_prune_window_max;
+  uintptr_t* loadbuf = bufp->loadbuf;
+  uint32_t* live_indices = bufp->live_indices;
+  uint32_t* start_arr = bufp->start_arr;
+  uint32_t* window_slots = bufp->window_slots;
+  uintptr_t* geno = bufp->geno;
+  uintptr_t* geno_masks = bufp->geno_masks;
+  uintptr_t* geno_mmasks = bufp->geno_mmasks;
+  uint32_t* missing_cts = bufp->missing_cts;
+  double* sums = bufp->sums;
+  double* variance_recips = bufp->variance_recips;
+  uintptr_t* nonmale_geno = bufp->nonmale_geno;
+  uintptr_t* nonmale_masks = bufp->nonmale_masks;
+  double* cov_matrix = bufp->cov_matrix;
+  double* new_cov_matrix = bufp->new_cov_matrix;
+  uint32_t* idx_remap = bufp->idx_remap;
+  MATRIX_INVERT_BUF1_TYPE* irow = bufp->irow;
+  double* work = bufp->work;
   uint32_t at_least_one_prune = 0;
-  uint32_t chrom_code_end = chrom_info_ptr->max_code + 1 + chrom_info_ptr->name_ct;
   int32_t retval = 0;
-  uintptr_t* geno_masks;
-  uintptr_t* geno_mmasks;
-  uintptr_t* pruned_arr;
-  uint32_t* live_indices;
-  uint32_t* start_arr;
   uint32_t pct;
   uint32_t pct_thresh;
-  uint32_t window_unfiltered_start;
   uint32_t window_unfiltered_end;
   uint32_t cur_window_size;
   uint32_t old_window_size;
@@ -791,10 +1091,6 @@ int32_t ld_prune(Ld_info* ldip, FILE* bedfile, uintptr_t bed_offset, uintptr_t m
   uint32_t is_haploid;
   uint32_t is_x;
   uint32_t is_y;
-  uintptr_t* loadbuf;
-  double* sums;
-  double* variance_recips; // entries are actually n^2 / variance
-  uint32_t* missing_cts;
   uint32_t fixed_missing_ct;
   uintptr_t ulii;
   double dxx;
@@ -816,6 +1112,420 @@ int32_t ld_prune(Ld_info* ldip, FILE* bedfile, uintptr_t bed_offset, uintptr_t m
   uint32_t bsearch_min;
   uint32_t bsearch_max;
   uint32_t bsearch_cur;
+  uint32_t fixed_slot;
+  uint32_t var_slot;
+  for (uii = 0; uii < window_max; uii++) {
+    window_slots[uii] = uii;
+  }
+  prev_end = 0;
+  ld_prune_start_chrom(window_is_kb, &cur_chrom, &chrom_end, window_unfiltered_start, live_indices, start_arr, &window_unfiltered_end, ld_window_size, &cur_window_size, unfiltered_marker_ct, pruned_arr, chrom_info_ptr, marker_pos, &is_haploid, &is_x, &is_y);
+  if (weighted_x) {
+    if (is_x) {
+      weighted_founder_ct = 2 * founder_ct;
+    } else {
+      weighted_founder_ct = founder_ct;
+    }
+  }
+  old_window_size = 0;
+  cur_exclude_ct = 0;
+  if (cur_window_size > 1) {
+    for (ulii = 0; ulii < (uintptr_t)cur_window_size; ulii++) {
+      uii = live_indices[ulii];
+      if (fseeko(bedfile, bed_offset + (uii * ((uint64_t)unfiltered_sample_ct4)), SEEK_SET)) {
+	goto ld_prune_chrom_ret_READ_FAIL;
+      }
+      if (load_and_collapse_incl(bedfile, loadbuf, unfiltered_sample_ct, &(geno[ulii * founder_ct_192_long]), founder_ct, founder_info, final_mask, IS_SET(marker_reverse, uii))) {
+	goto ld_prune_chrom_ret_READ_FAIL;
+      }
+      if (is_haploid && hh_exists) {
+	haploid_fix(hh_exists, founder_include2, founder_male_include2, founder_ct, is_x, is_y, (unsigned char*)(&(geno[ulii * founder_ct_192_long])));
+      }
+      if (!ld_process_load(&(geno[ulii * founder_ct_192_long]), &(geno_masks[ulii * founder_ct_192_long]), &(geno_mmasks[ulii * founder_ctv]), &(missing_cts[ulii]), &(sums[ulii]), &(variance_recips[ulii]), founder_ct, is_x && (!ignore_x), weighted_x, nonmale_founder_ct, founder_male_include2, nonmale_geno, nonmale_masks, ulii * founder_ct_192_long)) {
+	SET_BIT(pruned_arr, uii);
+	cur_exclude_ct++;
+      }
+    }
+  }
+  pct = 1;
+  pct_thresh = window_unfiltered_start + ((uint64_t)pct * (chrom_end - chrom_info_ptr->chrom_start[cur_chrom])) / 100;
+  while ((window_unfiltered_start < chrom_end) || (cur_window_size > 1)) {
+    if (cur_window_size > 1) {
+      do {
+	at_least_one_prune = 0;
+	for (uii = 0; uii < cur_window_size - 1; uii++) {
+	  if (IS_SET(pruned_arr, live_indices[uii])) {
+	    continue;
+	  }
+	  fixed_missing_ct = missing_cts[uii];
+	  fixed_non_missing_ct = weighted_founder_ct - fixed_missing_ct;
+	  fixed_slot = window_slots[uii];
+	  geno_fixed_vec_ptr = &(geno[fixed_slot * founder_ct_192_long]);
+	  mask_fixed_vec_ptr = &(geno_masks[fixed_slot * founder_ct_192_long]);
+	  ujj = uii + 1;
+	  while (live_indices[ujj] < start_arr[uii]) {
+	    if (++ujj == cur_window_size) {
+	      break;
+	    }
+	  }
+	  for (; ujj < cur_window_size; ujj++) {
+	    if (IS_SET(pruned_arr, live_indices[ujj])) {
+	      continue;
+	    }
+	    var_slot = window_slots[ujj];
+	    geno_var_vec_ptr = &(geno[var_slot * founder_ct_192_long]);
+	    if ((!fixed_missing_ct) && (!missing_cts[ujj]) && ((!is_x) || (!weighted_x))) {
+	      cov12 = (double)(ld_dot_prod_nm(geno_fixed_vec_ptr, geno_var_vec_ptr, weighted_founder_ct, founder_ct_mld_m1, founder_ct_mld_rem) * ((int64_t)founder_ct)) - sums[uii] * sums[ujj];
+	      dxx = variance_recips[uii] * variance_recips[ujj];
+	    } else {
+	      mask_var_vec_ptr = &(geno_masks[var_slot * founder_ct_192_long]);
+	      dp_result[0] = weighted_founder_ct;
+	      // reversed from what I initially thought because I'm passing
+	      // the ujj-associated buffers before the uii-associated ones.
+	      dp_result[1] = -((int32_t)fixed_non_missing_ct);
+	      dp_result[2] = missing_cts[ujj] - weighted_founder_ct;
+	      dp_result[3] = dp_result[1];
+	      dp_result[4] = dp_result[2];
+	      ld_dot_prod(geno_var_vec_ptr, geno_fixed_vec_ptr, mask_var_vec_ptr, mask_fixed_vec_ptr, dp_result, founder_ct_mld_m1, founder_ct_mld_rem);
+	      if (is_x && weighted_x) {
+		non_missing_ct = (popcount_longs_intersect(&(nonmale_masks[fixed_slot * founder_ct_192_long]), &(nonmale_masks[var_slot * founder_ct_192_long]), 2 * founder_ctl) + popcount_longs_intersect(mask_fixed_vec_ptr, mask_var_vec_ptr, 2 * founder_ctl)) / 2;
+		ld_dot_prod(&(nonmale_geno[var_slot * founder_ct_192_long]), &(nonmale_geno[fixed_slot * founder_ct_192_long]), &(nonmale_masks[var_slot * founder_ct_192_long]), &(nonmale_masks[fixed_slot * founder_ct_192_long]), dp_result, founder_ct_mld_m1, founder_ct_mld_rem);
+	      } else {
+		non_missing_ct = fixed_non_missing_ct - missing_cts[ujj];
+		if (fixed_missing_ct && missing_cts[ujj]) {
+		  non_missing_ct += popcount_longs_intersect(&(geno_mmasks[fixed_slot * founder_ctv]), &(geno_mmasks[var_slot * founder_ctv]), founder_ctl);
+		}
+	      }
+	      non_missing_ctd = (double)((int32_t)non_missing_ct);
+	      dxx = dp_result[1];
+	      dyy = dp_result[2];
+	      cov12 = dp_result[0] * non_missing_ctd - dxx * dyy;
+	      dxx = 1.0 / ((dp_result[3] * non_missing_ctd + dxx * dxx) * (dp_result[4] * non_missing_ctd + dyy * dyy));
+	    }
+	    if (!pairwise) {
+	      dxx = cov12 * sqrt(dxx);
+	      if (dxx != dxx) {
+		// force prune if 0/0 for now
+		dxx = 1.0;
+	      }
+	      cov_matrix[fixed_slot * window_max + var_slot] = dxx;
+	    } else {
+	      dxx = cov12 * cov12 * dxx;
+	    }
+	    if (dxx > prune_ld_thresh) {
+	      at_least_one_prune = 1;
+	      cur_exclude_ct++;
+	      // remove marker with lower MAF
+	      if (get_maf(set_allele_freqs[live_indices[uii]]) < get_maf(set_allele_freqs[live_indices[ujj]])) {
+		SET_BIT(pruned_arr, live_indices[uii]);
+	      } else {
+		SET_BIT(pruned_arr, live_indices[ujj]);
+		ujj++;
+		while (ujj < cur_window_size) {
+		  if (!IS_SET(pruned_arr, live_indices[ujj])) {
+		    break;
+		  }
+		  ujj++;
+		}
+		if (ujj < cur_window_size) {
+		  start_arr[uii] = live_indices[ujj];
+		}
+	      }
+	      break;
+	    }
+	  }
+	  if (ujj == cur_window_size) {
+	    start_arr[uii] = window_unfiltered_end;
+	  }
+	}
+      } while (at_least_one_prune);
+      if (!pairwise) {
+	window_rem = 0;
+	for (uii = 0; uii < old_window_size; uii++) {
+	  if (IS_SET(pruned_arr, live_indices[uii])) {
+	    continue;
+	  }
+	  idx_remap[window_rem++] = uii;
+	}
+	old_window_rem = window_rem;
+	for (; uii < cur_window_size; uii++) {
+	  if (IS_SET(pruned_arr, live_indices[uii])) {
+	    continue;
+	  }
+	  idx_remap[window_rem++] = uii;
+	}
+	while (window_rem > 1) {
+	  new_cov_matrix[0] = 1.0;
+	  for (uii = 1; uii < window_rem; uii++) {
+	    ukk = window_slots[idx_remap[uii]];
+	    for (ujj = 0; ujj < uii; ujj++) {
+	      dxx = cov_matrix[window_slots[idx_remap[ujj]] * window_max + ukk];
+	      new_cov_matrix[ujj * window_rem + uii] = dxx;
+	      new_cov_matrix[uii * window_rem + ujj] = dxx;
+	    }
+	    new_cov_matrix[uii * (window_rem + 1)] = 1.0;
+	  }
+	  window_rem_li = window_rem;
+	  ii = invert_matrix_checked(window_rem_li, new_cov_matrix, irow, work);
+	  while (ii) {
+#ifdef NOLAPACK
+	    if (ii == -1) {
+	      goto ld_prune_chrom_ret_NOMEM;
+	    }
+#endif
+	    // 1. binary search for minimum number of bottom right rows/
+	    //    columns that must be trimmed to get a nonsingular matrix
+	    bsearch_max = window_rem - 1;
+	    if (old_window_rem > bsearch_max) {
+	      // Normally we can assume that only loci not in the previous
+	      // window need to be considered here.  But, thanks to numeric
+	      // instability, we might still need to properly handle an
+	      // apparently-singular old submatrix?
+	      old_window_size = 0;
+	      old_window_rem = 0;
+	    }
+	    bsearch_min = old_window_rem;
+	    while (bsearch_min < bsearch_max) {
+	      bsearch_cur = (bsearch_min + bsearch_max) / 2;
+	      new_cov_matrix[0] = 1.0;
+	      for (uii = 1; uii < bsearch_cur; uii++) {
+		ukk = window_slots[idx_remap[uii]];
+		for (ujj = 0; ujj < uii; ujj++) {
+		  dxx = cov_matrix[window_slots[idx_remap[ujj]] * window_max + ukk];
+		  new_cov_matrix[ujj * bsearch_cur + uii] = dxx;
+		  new_cov_matrix[uii * bsearch_cur + ujj] = dxx;
+		}
+		new_cov_matrix[uii * (bsearch_cur + 1)] = 1.0;
+	      }
+	      if (bsearch_cur) {
+		window_rem_li = bsearch_cur;
+		ii = invert_matrix_checked(window_rem_li, new_cov_matrix, irow, work);
+		if (!ii) {
+		  bsearch_min = bsearch_cur + 1;
+		} else {
+		  bsearch_max = bsearch_cur;
+		}
+	      } else {
+		bsearch_min = 1;
+	      }
+	    }
+
+	    // 2. the last trimmed row/column must be part of some linear
+	    //    combination.  prune *just* that, and retry.
+	    ujj = bsearch_min;
+	    // bug reported by Kaustubh was a violation of this:
+	    // assert(!IS_SET(pruned_arr, live_indices[idx_remap[ujj]]));
+	    SET_BIT(pruned_arr, live_indices[idx_remap[ujj]]);
+	    cur_exclude_ct++;
+	    window_rem--;
+	    for (uii = ujj; uii < window_rem; uii++) {
+	      idx_remap[uii] = idx_remap[uii + 1];
+	    }
+	    new_cov_matrix[0] = 1.0;
+	    for (uii = 1; uii < window_rem; uii++) {
+	      ukk = window_slots[idx_remap[uii]];
+	      for (ujj = 0; ujj < uii; ujj++) {
+		dxx = cov_matrix[window_slots[idx_remap[ujj]] * window_max + ukk];
+		new_cov_matrix[ujj * window_rem + uii] = dxx;
+		new_cov_matrix[uii * window_rem + ujj] = dxx;
+	      }
+	      new_cov_matrix[uii * (window_rem + 1)] = 1.0;
+	    }
+	    window_rem_li = window_rem;
+	    ii = invert_matrix_checked(window_rem_li, new_cov_matrix, irow, work);
+	  }
+	  dxx = new_cov_matrix[0];
+	  ujj = 0;
+	  for (uii = 1; uii < window_rem; uii++) {
+	    if (new_cov_matrix[uii * (window_rem + 1)] > dxx) {
+	      dxx = new_cov_matrix[uii * (window_rem + 1)];
+	      ujj = uii;
+	    }
+	  }
+	  if (dxx > ld_last_param) {
+	    SET_BIT(pruned_arr, live_indices[idx_remap[ujj]]);
+	    cur_exclude_ct++;
+	    window_rem--;
+	    if (idx_remap[ujj] < (uint32_t)old_window_size) {
+	      old_window_rem--;
+	    }
+	    for (uii = ujj; uii < window_rem; uii++) {
+	      idx_remap[uii] = idx_remap[uii + 1];
+	    }
+	  } else {
+	    // break out
+	    window_rem = 1;
+	  }
+	}
+      }
+    }
+    for (uii = 0; uii < ld_window_incr; uii++) {
+      while (IS_SET(marker_exclude, window_unfiltered_start)) {
+	if (window_unfiltered_start == chrom_end) {
+	  break;
+	}
+	window_unfiltered_start++;
+      }
+      if (window_unfiltered_start == chrom_end) {
+	break;
+      }
+      window_unfiltered_start++;
+    }
+    if (window_unfiltered_start == chrom_end) {
+      break;
+    }
+    if (show_pct && (window_unfiltered_start >= pct_thresh)) {
+      pct = ((window_unfiltered_start - chrom_info_ptr->chrom_start[cur_chrom]) * 100LLU) / (chrom_end - chrom_info_ptr->chrom_start[cur_chrom]);
+      printf("\r%u%%", pct++);
+      fflush(stdout);
+      pct_thresh = chrom_info_ptr->chrom_start[cur_chrom] + (((uint64_t)pct * (chrom_end - chrom_info_ptr->chrom_start[cur_chrom])) / 100);
+    }
+    ujj = 0;
+    // compact the window.  Genotype rows and correlations stay in their
+    // slots; window_slots[] entries are swapped rather than overwritten, so it
+    // remains a permutation and the freed slots end up past the last live
+    // position.
+    while (live_indices[ujj] < window_unfiltered_start) {
+      ujj++;
+      if (ujj == cur_window_size) {
+	break;
+      }
+    }
+    for (uii = 0; ujj < cur_window_size; ujj++) {
+      if (IS_SET(pruned_arr, live_indices[ujj])) {
+	continue;
+      }
+      ukk = window_slots[uii];
+      window_slots[uii] = window_slots[ujj];
+      window_slots[ujj] = ukk;
+      live_indices[uii] = live_indices[ujj];
+      start_arr[uii] = start_arr[ujj];
+      missing_cts[uii] = missing_cts[ujj];
+      sums[uii] = sums[ujj];
+      variance_recips[uii] = variance_recips[ujj];
+      uii++;
+    }
+
+    prev_end = uii;
+    cur_window_size = uii;
+    if (window_is_kb) {
+      ujj = 0;
+      while ((window_unfiltered_end + ujj < chrom_end) && (marker_pos[window_unfiltered_end + ujj] <= marker_pos[window_unfiltered_start] + (1000 * ld_window_size))) {
+	ujj++;
+      }
+    } else {
+      ujj = ld_window_incr;
+    }
+    old_window_size = cur_window_size;
+    for (uii = 0; uii < ujj; window_unfiltered_end++, uii++) {
+      next_unset_ck(marker_exclude, &window_unfiltered_end, chrom_end);
+      if (window_unfiltered_end == chrom_end) {
+	break;
+      }
+      live_indices[cur_window_size] = window_unfiltered_end;
+      if (cur_window_size > prev_end) {
+	start_arr[cur_window_size - 1] = window_unfiltered_end;
+      }
+      if (fseeko(bedfile, bed_offset + (window_unfiltered_end * ((uint64_t)unfiltered_sample_ct4)), SEEK_SET)) {
+	goto ld_prune_chrom_ret_READ_FAIL;
+      }
+      var_slot = window_slots[cur_window_size];
+      if (load_and_collapse_incl(bedfile, loadbuf, unfiltered_sample_ct, &(geno[var_slot * founder_ct_192_long]), founder_ct, founder_info, final_mask, IS_SET(marker_reverse, window_unfiltered_end))) {
+	goto ld_prune_chrom_ret_READ_FAIL;
+      }
+      if (is_haploid && hh_exists) {
+	haploid_fix(hh_exists, founder_include2, founder_male_include2, founder_ct, is_x, is_y, (unsigned char*)(&(geno[var_slot * founder_ct_192_long])));
+      }
+      if (!ld_process_load(&(geno[var_slot * founder_ct_192_long]), &(geno_masks[var_slot * founder_ct_192_long]), &(geno_mmasks[var_slot * founder_ctv]), &(missing_cts[cur_window_size]), &(sums[cur_window_size]), &(variance_recips[cur_window_size]), founder_ct, is_x && (!ignore_x), weighted_x, nonmale_founder_ct, founder_male_include2, nonmale_geno, nonmale_masks, var_slot * founder_ct_192_long)) {
+	SET_BIT(pruned_arr, window_unfiltered_end);
+	cur_exclude_ct++;
+      }
+      cur_window_size++;
+    }
+    if (cur_window_size > prev_end) {
+      start_arr[cur_window_size] = window_unfiltered_end;
+    }
+  }
+  *cur_exclude_ct_ptr = cur_exclude_ct;
+  while (0) {
+#ifdef NOLAPACK
+  ld_prune_chrom_ret_NOMEM:
+    retval = RET_NOMEM;
+    break;
+#endif
+  ld_prune_chrom_ret_READ_FAIL:
+    retval = RET_READ_FAIL;
+    break;
+  }
+  return retval;
+}
+
+THREAD_RET_TYPE ld_prune_thread(void* arg) {
+  uintptr_t tidx = (uintptr_t)arg;
+  uint32_t chrom_idx;
+  uint32_t chrom_idx_end;
+  int32_t retval;
+  while (ws_claim(tidx, 1, &chrom_idx, &chrom_idx_end)) {
+    if (g_ld_prune_retval) {
+      break;
+    }
+    retval = ld_prune_chrom(&(g_ld_prune_bufs[tidx]), g_ld_prune_chrom_starts[chrom_idx], &(g_ld_prune_exclude_cts[chrom_idx]), g_ld_prune_show_pct);
+    if (retval) {
+      g_ld_prune_retval = retval;
+      break;
+    }
+  }
+  THREAD_RETURN;
+}
+
+int32_t ld_prune(Ld_info* ldip, FILE* bedfile, char* bedname, uintptr_t bed_offset, uintptr_t marker_ct, uintptr_t unfiltered_marker_ct, uintptr_t* marker_exclude, uintptr_t* marker_reverse, char* marker_ids, uintptr_t max_marker_id_len, Chrom_info* chrom_info_ptr, double* set_allele_freqs, uint32_t* marker_pos, uintptr_t unfiltered_sample_ct, uintptr_t* founder_info, uintptr_t* sex_male, char* outname, char* outname_end, uint32_t hh_exists) {
+  // Results are slightly different from PLINK 1.07 when missing data is
+  // present, but that's due to a minor bug in 1.07 (sample per-marker
+  // variances don't exclude the missing markers).
+  unsigned char* wkspace_mark = wkspace_base;
+  uintptr_t unfiltered_marker_ctl = (unfiltered_marker_ct + (BITCT - 1)) / BITCT;
+  uintptr_t unfiltered_sample_ctl2 = 2 * ((unfiltered_sample_ct + (BITCT - 1)) / BITCT);
+  uintptr_t founder_ct = popcount_longs(founder_info, unfiltered_sample_ctl2 / 2);
+  uintptr_t founder_ctl = (founder_ct + BITCT - 1) / BITCT;
+#ifdef __LP64__
+  uintptr_t founder_ctv = 2 * ((founder_ct + 127) / 128);
+#else
+  uintptr_t founder_ctv = founder_ctl;
+#endif
+  uintptr_t founder_ct_mld = (founder_ct + MULTIPLEX_LD - 1) / MULTIPLEX_LD;
+  uint32_t founder_ct_mld_m1 = ((uint32_t)founder_ct_mld) - 1;
+#ifdef __LP64__
+  uint32_t founder_ct_mld_rem = (MULTIPLEX_LD / 192) - (founder_ct_mld * MULTIPLEX_LD - founder_ct) / 192;
+#else
+  uint32_t founder_ct_mld_rem = (MULTIPLEX_LD / 48) - (founder_ct_mld * MULTIPLEX_LD - founder_ct) / 48;
+#endif
+  uintptr_t founder_ct_192_long = founder_ct_mld_m1 * (MULTIPLEX_LD / BITCT2) + founder_ct_mld_rem * (192 / BITCT2);
+  uint32_t founder_trail_ct = founder_ct_192_long - founder_ctl * 2;
+  uint32_t pairwise = (ldip->modifier / LD_PRUNE_PAIRWISE) & 1;
+  uint32_t weighted_x = (ldip->modifier / LD_WEIGHTED_X) & 1;
+  uint32_t window_is_kb = (ldip->modifier / LD_PRUNE_KB_WINDOW) & 1;
+  uint32_t ld_window_size = ldip->prune_window_size;
+  double ld_last_param = ldip->prune_last_param;
+  uint32_t nonmale_founder_ct = 0;
+  uintptr_t window_max = 1;
+  uintptr_t* founder_include2 = NULL;
+  uintptr_t* founder_male_include2 = NULL;
+  Ld_prune_buf* bufs = NULL;
+  uint32_t thread_ct = 1;
+  uint32_t tot_exclude_ct = 0;
+  uint32_t chrom_code_end = chrom_info_ptr->max_code + 1 + chrom_info_ptr->name_ct;
+  int32_t retval = 0;
+  pthread_t threads[MAX_THREADS];
+  unsigned char* buf_start;
+  uintptr_t* pruned_arr;
+  uint32_t* chrom_starts;
+  uintptr_t* exclude_cts;
+  uintptr_t buf_size;
+  uint32_t window_unfiltered_start;
+  uint32_t chrom_ct;
+  uint32_t chrom_idx;
+  uint32_t tidx;
+  uint32_t uii;
+  uintptr_t ulii;
   double prune_ld_thresh;
   if (founder_ct < 2) {
     LOGPRINTF("Warning: Skipping --indep%s since there are less than two founders.\n(--make-founders may come in handy here.)\n", pairwise? "-pairwise" : "");
@@ -853,9 +1563,9 @@ int32_t ld_prune(Ld_info* ldip, FILE* bedfile, uintptr_t bed_offset, uintptr_t m
 
   if (window_is_kb) {
     // determine maximum number of markers that may need to be loaded at once
-    for (cur_chrom = 1; cur_chrom < chrom_code_end; cur_chrom++) {
-      if (chrom_exists(chrom_info_ptr, cur_chrom)) {
-	window_max = chrom_window_max(marker_pos, marker_exclude, chrom_info_ptr, cur_chrom, 0x7fffffff, ld_window_size * 1000, window_max);
+    for (uii = 1; uii < chrom_code_end; uii++) {
+      if (chrom_exists(chrom_info_ptr, uii)) {
+	window_max = chrom_window_max(marker_pos, marker_exclude, chrom_info_ptr, uii, 0x7fffffff, ld_window_size * 1000, window_max);
       }
     }
   }
@@ -874,405 +1584,108 @@ int32_t ld_prune(Ld_info* ldip, FILE* bedfile, uintptr_t bed_offset, uintptr_t m
     prune_ld_thresh = 0.999999;
   }
 
-  window_unfiltered_start = ld_prune_next_valid_chrom_start(marker_exclude, 0, chrom_info_ptr, chrom_code_end, unfiltered_marker_ct);
-
   if (wkspace_alloc_ul_checked(&pruned_arr, unfiltered_marker_ctl * sizeof(intptr_t))) {
     goto ld_prune_ret_NOMEM;
   }
 
   memcpy(pruned_arr, marker_exclude, unfiltered_marker_ctl * sizeof(intptr_t));
 
+  if (wkspace_alloc_ui_checked(&chrom_starts, chrom_code_end * sizeof(int32_t))) {
+    goto ld_prune_ret_NOMEM;
+  }
+  // chromosomes are enumerated in file order
+  chrom_ct = 0;
+  window_unfiltered_start = ld_prune_next_valid_chrom_start(marker_exclude, 0, chrom_info_ptr, chrom_code_end, unfiltered_marker_ct);
+  while (window_unfiltered_start < unfiltered_marker_ct) {
+    chrom_starts[chrom_ct++] = window_unfiltered_start;
+    uii = get_marker_chrom(chrom_info_ptr, window_unfiltered_start);
+    window_unfiltered_start = ld_prune_next_valid_chrom_start(marker_exclude, chrom_info_ptr->chrom_end[uii], chrom_info_ptr, chrom_code_end, unfiltered_marker_ct);
+  }
+  if (wkspace_alloc_ul_checked(&exclude_cts, chrom_ct * sizeof(intptr_t))) {
+    goto ld_prune_ret_NOMEM;
+  }
+  bufs = (Ld_prune_buf*)wkspace_alloc(g_thread_ct * sizeof(Ld_prune_buf));
+  if (!bufs) {
+    goto ld_prune_ret_NOMEM;
+  }
+
   if (!window_is_kb) {
     window_max = ld_window_size;
   }
-  ulii = window_max;
-  if (wkspace_alloc_ui_checked(&live_indices, ulii * sizeof(int32_t)) ||
-      wkspace_alloc_ui_checked(&start_arr, ulii * sizeof(int32_t)) ||
-      wkspace_alloc_ul_checked(&loadbuf, unfiltered_sample_ctl2 * sizeof(intptr_t)) ||
-      wkspace_alloc_ul_checked(&geno, ulii * founder_ct_192_long * sizeof(intptr_t)) ||
-      wkspace_alloc_ul_checked(&geno_masks, ulii * founder_ct_192_long * sizeof(intptr_t)) ||
-      wkspace_alloc_ul_checked(&geno_mmasks, ulii * founder_ctv * sizeof(intptr_t)) ||
-      wkspace_alloc_ui_checked(&missing_cts, ulii * sizeof(int32_t)) ||
-      wkspace_alloc_d_checked(&sums, ulii * sizeof(double)) ||
-      wkspace_alloc_d_checked(&variance_recips, ulii * sizeof(double))) {
+  buf_start = wkspace_base;
+  if (ld_prune_alloc_buf(&(bufs[0]), window_max, unfiltered_sample_ctl2, founder_ct_192_long, founder_ctv, founder_trail_ct, weighted_x, pairwise)) {
     goto ld_prune_ret_NOMEM;
   }
-  if (weighted_x) {
-    if (wkspace_alloc_ul_checked(&nonmale_geno, ulii * founder_ct_192_long * sizeof(intptr_t)) ||
-        wkspace_alloc_ul_checked(&nonmale_masks, ulii * founder_ct_192_long * sizeof(intptr_t))) {
-      goto ld_prune_ret_NOMEM;
-    }
+  bufs[0].bedfile = bedfile;
+  bufs[0].pruned_arr = pruned_arr;
+  // additional workers, as far as memory and the chromosome count permit
+  buf_size = ((uintptr_t)(wkspace_base - buf_start)) + CACHEALIGN(unfiltered_marker_ctl * sizeof(intptr_t));
+  thread_ct = g_thread_ct;
+  if (thread_ct > chrom_ct) {
+    thread_ct = chrom_ct;
   }
-  for (ulii = 1; ulii <= window_max; ulii++) {
-    fill_ulong_zero(&(geno[ulii * founder_ct_192_long - founder_trail_ct - 2]), founder_trail_ct + 2);
-    fill_ulong_zero(&(geno_masks[ulii * founder_ct_192_long - founder_trail_ct - 2]), founder_trail_ct + 2);
-    if (weighted_x) {
-      fill_ulong_zero(&(nonmale_geno[ulii * founder_ct_192_long - founder_trail_ct - 2]), founder_trail_ct + 2);
-      fill_ulong_zero(&(nonmale_masks[ulii * founder_ct_192_long - founder_trail_ct - 2]), founder_trail_ct + 2);
-    }
+  if (thread_ct > 1 + wkspace_left / buf_size) {
+    thread_ct = 1 + wkspace_left / buf_size;
   }
-  if (!pairwise) {
-    if (wkspace_alloc_d_checked(&cov_matrix, window_max * window_max * sizeof(double)) ||
-        wkspace_alloc_d_checked(&new_cov_matrix, window_max * window_max * sizeof(double)) ||
-        wkspace_alloc_ui_checked(&idx_remap, window_max * sizeof(int32_t))) {
-      goto ld_prune_ret_NOMEM;
-    }
-
-    irow = (MATRIX_INVERT_BUF1_TYPE*)wkspace_alloc(window_max * 2 * sizeof(MATRIX_INVERT_BUF1_TYPE));
-    if (!irow) {
-      goto ld_prune_ret_NOMEM;
-    }
-
-    if (window_max < 4) {
-      ulii = 4;
-    } else {
-      ulii = window_max;
-    }
-    if (wkspace_alloc_d_checked(&work, ulii * window_max * sizeof(double))) {
+  for (tidx = 1; tidx < thread_ct; tidx++) {
+    bufs[tidx].bedfile = NULL;
+  }
+  for (tidx = 1; tidx < thread_ct; tidx++) {
+    if (ld_prune_alloc_buf(&(bufs[tidx]), window_max, unfiltered_sample_ctl2, founder_ct_192_long, founder_ctv, founder_trail_ct, weighted_x, pairwise) ||
+        wkspace_alloc_ul_checked(&(bufs[tidx].pruned_arr), unfiltered_marker_ctl * sizeof(intptr_t))) {
       goto ld_prune_ret_NOMEM;
     }
+    memcpy(bufs[tidx].pruned_arr, marker_exclude, unfiltered_marker_ctl * sizeof(intptr_t));
+    if (fopen_checked(&(bufs[tidx].bedfile), bedname, "rb")) {
+      goto ld_prune_ret_OPEN_FAIL;
+    }
+  }
+
+  g_ld_prune_ldip = ldip;
+  g_ld_prune_bufs = bufs;
+  g_ld_prune_chrom_info_ptr = chrom_info_ptr;
+  g_ld_prune_marker_exclude = marker_exclude;
+  g_ld_prune_marker_reverse = marker_reverse;
+  g_ld_prune_founder_info = founder_info;
+  g_ld_prune_founder_include2 = founder_include2;
+  g_ld_prune_founder_male_include2 = founder_male_include2;
+  g_ld_prune_set_allele_freqs = set_allele_freqs;
+  g_ld_prune_marker_pos = marker_pos;
+  g_ld_prune_chrom_starts = chrom_starts;
+  g_ld_prune_exclude_cts = exclude_cts;
+  g_ld_prune_bed_offset = bed_offset;
+  g_ld_prune_unfiltered_marker_ct = unfiltered_marker_ct;
+  g_ld_prune_unfiltered_sample_ct = unfiltered_sample_ct;
+  g_ld_prune_founder_ct = founder_ct;
+  g_ld_prune_window_max = window_max;
+  g_ld_prune_thresh = prune_ld_thresh;
+  g_ld_prune_nonmale_founder_ct = nonmale_founder_ct;
+  g_ld_prune_hh_exists = hh_exists;
+  // per-chromosome progress is only meaningful with a single worker
+  g_ld_prune_show_pct = (thread_ct == 1);
+  g_ld_prune_retval = 0;
+  time_trace_push("ld_prune_chroms", marker_ct);
+  ws_ranges_init(thread_ct, 0, chrom_ct);
+  if (spawn_threads(threads, &ld_prune_thread, thread_ct)) {
+    goto ld_prune_ret_THREAD_CREATE_FAIL;
+  }
+  ld_prune_thread((void*)0);
+  join_threads(threads, thread_ct);
+  time_trace_pop();
+  putchar('\r');
+  retval = g_ld_prune_retval;
+  if (retval) {
+    goto ld_prune_ret_1;
+  }
+  for (tidx = 1; tidx < thread_ct; tidx++) {
+    bitfield_or(pruned_arr, bufs[tidx].pruned_arr, unfiltered_marker_ctl);
+  }
+  for (chrom_idx = 0; chrom_idx < chrom_ct; chrom_idx++) {
+    uii = get_marker_chrom(chrom_info_ptr, chrom_starts[chrom_idx]);
+    ulii = exclude_cts[chrom_idx];
+    LOGPRINTF("Pruned %" PRIuPTR " variant%s from chromosome %u, leaving %" PRIuPTR ".\n", ulii, (ulii == 1)? "" : "s", uii, chrom_info_ptr->chrom_end[uii] - chrom_info_ptr->chrom_start[uii] - popcount_bit_idx(marker_exclude, chrom_info_ptr->chrom_start[uii], chrom_info_ptr->chrom_end[uii]) - ulii);
+    tot_exclude_ct += ulii;
   }
-  do {
-    prev_end = 0;
-    ld_prune_start_chrom(window_is_kb, &cur_chrom, &chrom_end, window_unfiltered_start, live_indices, start_arr, &window_unfiltered_end, ld_window_size, &cur_window_size, unfiltered_marker_ct, pruned_arr, chrom_info_ptr, marker_pos, &is_haploid, &is_x, &is_y);
-    if (weighted_x) {
-      if (is_x) {
-	weighted_founder_ct = 2 * founder_ct;
-      } else {
-	weighted_founder_ct = founder_ct;
-      }
-    }
-    old_window_size = 0;
-    cur_exclude_ct = 0;
-    if (cur_window_size > 1) {
-      for (ulii = 0; ulii < (uintptr_t)cur_window_size; ulii++) {
-	uii = live_indices[ulii];
-	if (fseeko(bedfile, bed_offset + (uii * ((uint64_t)unfiltered_sample_ct4)), SEEK_SET)) {
-	  goto ld_prune_ret_READ_FAIL;
-	}
-	if (load_and_collapse_incl(bedfile, loadbuf, unfiltered_sample_ct, &(geno[ulii * founder_ct_192_long]), founder_ct, founder_info, final_mask, IS_SET(marker_reverse, uii))) {
-	  goto ld_prune_ret_READ_FAIL;
-	}
-	if (is_haploid && hh_exists) {
-	  haploid_fix(hh_exists, founder_include2, founder_male_include2, founder_ct, is_x, is_y, (unsigned char*)(&(geno[ulii * founder_ct_192_long])));
-	}
-        if (!ld_process_load(&(geno[ulii * founder_ct_192_long]), &(geno_masks[ulii * founder_ct_192_long]), &(geno_mmasks[ulii * founder_ctv]), &(missing_cts[ulii]), &(sums[ulii]), &(variance_recips[ulii]), founder_ct, is_x && (!ignore_x), weighted_x, nonmale_founder_ct, founder_male_include2, nonmale_geno, nonmale_masks, ulii * founder_ct_192_long)) {
-	  SET_BIT(pruned_arr, uii);
-          cur_exclude_ct++;
-	}
-      }
-    }
-    pct = 1;
-    pct_thresh = window_unfiltered_start + ((uint64_t)pct * (chrom_end - chrom_info_ptr->chrom_start[cur_chrom])) / 100;
-    while ((window_unfiltered_start < chrom_end) || (cur_window_size > 1)) {
-      if (cur_window_size > 1) {
-	do {
-	  at_least_one_prune = 0;
-	  for (uii = 0; uii < cur_window_size - 1; uii++) {
-	    if (IS_SET(pruned_arr, live_indices[uii])) {
-	      continue;
-	    }
-            fixed_missing_ct = missing_cts[uii];
-	    fixed_non_missing_ct = weighted_founder_ct - fixed_missing_ct;
-	    geno_fixed_vec_ptr = &(geno[uii * founder_ct_192_long]);
-	    mask_fixed_vec_ptr = &(geno_masks[uii * founder_ct_192_long]);
-	    ujj = uii + 1;
-	    while (live_indices[ujj] < start_arr[uii]) {
-	      if (++ujj == cur_window_size) {
-		break;
-	      }
-	    }
-	    for (; ujj < cur_window_size; ujj++) {
-	      if (IS_SET(pruned_arr, live_indices[ujj])) {
-		continue;
-	      }
-	      geno_var_vec_ptr = &(geno[ujj * founder_ct_192_long]);
-	      if ((!fixed_missing_ct) && (!missing_cts[ujj]) && ((!is_x) || (!weighted_x))) {
-		cov12 = (double)(ld_dot_prod_nm(geno_fixed_vec_ptr, geno_var_vec_ptr, weighted_founder_ct, founder_ct_mld_m1, founder_ct_mld_rem) * ((int64_t)founder_ct)) - sums[uii] * sums[ujj];
-		dxx = variance_recips[uii] * variance_recips[ujj];
-	      } else {
-		mask_var_vec_ptr = &(geno_masks[ujj * founder_ct_192_long]);
-		dp_result[0] = weighted_founder_ct;
-		// reversed from what I initially thought because I'm passing
-		// the ujj-associated buffers before the uii-associated ones.
-		dp_result[1] = -((int32_t)fixed_non_missing_ct);
-		dp_result[2] = missing_cts[ujj] - weighted_founder_ct;
-		dp_result[3] = dp_result[1];
-		dp_result[4] = dp_result[2];
-		ld_dot_prod(geno_var_vec_ptr, geno_fixed_vec_ptr, mask_var_vec_ptr, mask_fixed_vec_ptr, dp_result, founder_ct_mld_m1, founder_ct_mld_rem);
-		if (is_x && weighted_x) {
-		  non_missing_ct = (popcount_longs_intersect(&(nonmale_masks[uii * founder_ct_192_long]), &(nonmale_masks[ujj * founder_ct_192_long]), 2 * founder_ctl) + popcount_longs_intersect(mask_fixed_vec_ptr, mask_var_vec_ptr, 2 * founder_ctl)) / 2;
-		  ld_dot_prod(&(nonmale_geno[ujj * founder_ct_192_long]), &(nonmale_geno[uii * founder_ct_192_long]), &(nonmale_masks[ujj * founder_ct_192_long]), &(nonmale_masks[uii * founder_ct_192_long]), dp_result, founder_ct_mld_m1, founder_ct_mld_rem);
-		} else {
-		  non_missing_ct = fixed_non_missing_ct - missing_cts[ujj];
-		  if (fixed_missing_ct && missing_cts[ujj]) {
-		    non_missing_ct += popcount_longs_intersect(&(geno_mmasks[uii * founder_ctv]), &(geno_mmasks[ujj * founder_ctv]), founder_ctl);
-		  }
-		}
-		non_missing_ctd = (double)((int32_t)non_missing_ct);
-		dxx = dp_result[1];
-		dyy = dp_result[2];
-		cov12 = dp_result[0] * non_missing_ctd - dxx * dyy;
-		dxx = 1.0 / ((dp_result[3] * non_missing_ctd + dxx * dxx) * (dp_result[4] * non_missing_ctd + dyy * dyy));
-	      }
-	      if (!pairwise) {
-		dxx = cov12 * sqrt(dxx);
-		if (dxx != dxx) {
-		  // force prune if 0/0 for now
-		  dxx = 1.0;
-		}
-		cov_matrix[uii * window_max + ujj] = dxx;
-	      } else {
-		dxx = cov12 * cov12 * dxx;
-	      }
-	      if (dxx > prune_ld_thresh) {
-		at_least_one_prune = 1;
-		cur_exclude_ct++;
-		// remove marker with lower MAF
-		if (get_maf(set_allele_freqs[live_indices[uii]]) < get_maf(set_allele_freqs[live_indices[ujj]])) {
-		  SET_BIT(pruned_arr, live_indices[uii]);
-		} else {
-		  SET_BIT(pruned_arr, live_indices[ujj]);
-		  ujj++;
-		  while (ujj < cur_window_size) {
-		    if (!IS_SET(pruned_arr, live_indices[ujj])) {
-		      break;
-		    }
-		    ujj++;
-		  }
-		  if (ujj < cur_window_size) {
-		    start_arr[uii] = live_indices[ujj];
-		  }
-		}
-		break;
-	      }
-	    }
-	    if (ujj == cur_window_size) {
-	      start_arr[uii] = window_unfiltered_end;
-	    }
-	  }
-	} while (at_least_one_prune);
-	if (!pairwise) {
-	  window_rem = 0;
-	  for (uii = 0; uii < old_window_size; uii++) {
-	    if (IS_SET(pruned_arr, live_indices[uii])) {
-	      continue;
-	    }
-            idx_remap[window_rem++] = uii;
-	  }
-	  old_window_rem = window_rem;
-	  for (; uii < cur_window_size; uii++) {
-	    if (IS_SET(pruned_arr, live_indices[uii])) {
-	      continue;
-	    }
-            idx_remap[window_rem++] = uii;
-	  }
-	  while (window_rem > 1) {
-	    new_cov_matrix[0] = 1.0;
-	    for (uii = 1; uii < window_rem; uii++) {
-	      ukk = idx_remap[uii];
-	      for (ujj = 0; ujj < uii; ujj++) {
-		dxx = cov_matrix[idx_remap[ujj] * window_max + ukk];
-		new_cov_matrix[ujj * window_rem + uii] = dxx;
-		new_cov_matrix[uii * window_rem + ujj] = dxx;
-	      }
-	      new_cov_matrix[uii * (window_rem + 1)] = 1.0;
-	    }
-	    window_rem_li = window_rem;
-	    ii = invert_matrix_checked(window_rem_li, new_cov_matrix, irow, work);
-	    while (ii) {
-#ifdef NOLAPACK
-	      if (ii == -1) {
-		goto ld_prune_ret_NOMEM;
-	      }
-#endif
-	      // 1. binary search for minimum number of bottom right rows/
-	      //    columns that must be trimmed to get a nonsingular matrix
-	      bsearch_max = window_rem - 1;
-	      if (old_window_rem > bsearch_max) {
-		// Normally we can assume that only loci not in the previous
-		// window need to be considered here.  But, thanks to numeric
-		// instability, we might still need to properly handle an
-		// apparently-singular old submatrix?
-		old_window_size = 0;
-		old_window_rem = 0;
-	      }
-	      bsearch_min = old_window_rem;
-	      while (bsearch_min < bsearch_max) {
-	        bsearch_cur = (bsearch_min + bsearch_max) / 2;
-                new_cov_matrix[0] = 1.0;
-		for (uii = 1; uii < bsearch_cur; uii++) {
-		  ukk = idx_remap[uii];
-		  for (ujj = 0; ujj < uii; ujj++) {
-		    dxx = cov_matrix[idx_remap[ujj] * window_max + ukk];
-		    new_cov_matrix[ujj * bsearch_cur + uii] = dxx;
-		    new_cov_matrix[uii * bsearch_cur + ujj] = dxx;
-		  }
-		  new_cov_matrix[uii * (bsearch_cur + 1)] = 1.0;
-		}
-		if (bsearch_cur) {
-		  window_rem_li = bsearch_cur;
-		  ii = invert_matrix_checked(window_rem_li, new_cov_matrix, irow, work);
-		  if (!ii) {
-		    bsearch_min = bsearch_cur + 1;
-		  } else {
-		    bsearch_max = bsearch_cur;
-		  }
-		} else {
-		  bsearch_min = 1;
-		}
-	      }
-
-	      // 2. the last trimmed row/column must be part of some linear
-	      //    combination.  prune *just* that, and retry.
-	      ujj = bsearch_min;
-	      // bug reported by Kaustubh was a violation of this:
-	      // assert(!IS_SET(pruned_arr, live_indices[idx_remap[ujj]]));
-              SET_BIT(pruned_arr, live_indices[idx_remap[ujj]]);
-	      cur_exclude_ct++;
-	      window_rem--;
-	      for (uii = ujj; uii < window_rem; uii++) {
-		idx_remap[uii] = idx_remap[uii + 1];
-	      }
-	      new_cov_matrix[0] = 1.0;
-	      for (uii = 1; uii < window_rem; uii++) {
-		ukk = idx_remap[uii];
-		for (ujj = 0; ujj < uii; ujj++) {
-		  dxx = cov_matrix[idx_remap[ujj] * window_max + ukk];
-		  new_cov_matrix[ujj * window_rem + uii] = dxx;
-		  new_cov_matrix[uii * window_rem + ujj] = dxx;
-		}
-		new_cov_matrix[uii * (window_rem + 1)] = 1.0;
-	      }
-              window_rem_li = window_rem;
-	      ii = invert_matrix_checked(window_rem_li, new_cov_matrix, irow, work);
-	    }
-	    dxx = new_cov_matrix[0];
-	    ujj = 0;
-	    for (uii = 1; uii < window_rem; uii++) {
-              if (new_cov_matrix[uii * (window_rem + 1)] > dxx) {
-		dxx = new_cov_matrix[uii * (window_rem + 1)];
-		ujj = uii;
-	      }
-	    }
-	    if (dxx > ld_last_param) {
-	      SET_BIT(pruned_arr, live_indices[idx_remap[ujj]]);
-	      cur_exclude_ct++;
-	      window_rem--;
-	      if (idx_remap[ujj] < (uint32_t)old_window_size) {
-                old_window_rem--;
-	      }
-	      for (uii = ujj; uii < window_rem; uii++) {
-                idx_remap[uii] = idx_remap[uii + 1];
-	      }
-	    } else {
-	      // break out
-	      window_rem = 1;
-	    }
-	  }
-	}
-      }
-      for (uii = 0; uii < ld_window_incr; uii++) {
-	while (IS_SET(marker_exclude, window_unfiltered_start)) {
-	  if (window_unfiltered_start == chrom_end) {
-	    break;
-	  }
-	  window_unfiltered_start++;
-	}
-	if (window_unfiltered_start == chrom_end) {
-	  break;
-	}
-	window_unfiltered_start++;
-      }
-      if (window_unfiltered_start == chrom_end) {
-	break;
-      }
-      if (window_unfiltered_start >= pct_thresh) {
-	pct = ((window_unfiltered_start - chrom_info_ptr->chrom_start[cur_chrom]) * 100LLU) / (chrom_end - chrom_info_ptr->chrom_start[cur_chrom]);
-	printf("\r%u%%", pct++);
-	fflush(stdout);
-	pct_thresh = chrom_info_ptr->chrom_start[cur_chrom] + (((uint64_t)pct * (chrom_end - chrom_info_ptr->chrom_start[cur_chrom])) / 100);
-      }
-      ujj = 0;
-      // copy back previously loaded/computed results
-      while (live_indices[ujj] < window_unfiltered_start) {
-	ujj++;
-	if (ujj == cur_window_size) {
-	  break;
-	}
-      }
-      for (uii = 0; ujj < cur_window_size; ujj++) {
-	if (IS_SET(pruned_arr, live_indices[ujj])) {
-	  continue;
-	}
-	memcpy(&(geno[uii * founder_ct_192_long]), &(geno[ujj * founder_ct_192_long]), founder_ct_192_long * sizeof(intptr_t));
-	memcpy(&(geno_masks[uii * founder_ct_192_long]), &(geno_masks[ujj * founder_ct_192_long]), founder_ct_192_long * sizeof(intptr_t));
-	if (is_x && weighted_x) {
-	  memcpy(&(nonmale_geno[uii * founder_ct_192_long]), &(nonmale_geno[ujj * founder_ct_192_long]), founder_ct_192_long * sizeof(intptr_t));
-	  memcpy(&(nonmale_masks[uii * founder_ct_192_long]), &(nonmale_masks[ujj * founder_ct_192_long]), founder_ct_192_long * sizeof(intptr_t));
-	}
-	memcpy(&(geno_mmasks[uii * founder_ctv]), &(geno_mmasks[ujj * founder_ctv]), founder_ctl * sizeof(intptr_t));
-	live_indices[uii] = live_indices[ujj];
-	start_arr[uii] = start_arr[ujj];
-	missing_cts[uii] = missing_cts[ujj];
-	sums[uii] = sums[ujj];
-        variance_recips[uii] = variance_recips[ujj];
-	if (!pairwise) {
-	  for (ukk = 0; ukk < uii; ukk++) {
-	    cov_matrix[ukk * window_max + uii] = cov_matrix[idx_remap[ukk] * window_max + ujj];
-	  }
-	  idx_remap[uii] = ujj;
-	}
-	uii++;
-      }
-
-      prev_end = uii;
-      cur_window_size = uii;
-      if (window_is_kb) {
-	ujj = 0;
-	while ((window_unfiltered_end + ujj < chrom_end) && (marker_pos[window_unfiltered_end + ujj] <= marker_pos[window_unfiltered_start] + (1000 * ld_window_size))) {
-	  ujj++;
-	}
-      } else {
-	ujj = ld_window_incr;
-      }
-      old_window_size = cur_window_size;
-      for (uii = 0; uii < ujj; window_unfiltered_end++, uii++) {
-	next_unset_ck(marker_exclude, &window_unfiltered_end, chrom_end);
-	if (window_unfiltered_end == chrom_end) {
-	  break;
-	}
-	live_indices[cur_window_size] = window_unfiltered_end;
-	if (cur_window_size > prev_end) {
-	  start_arr[cur_window_size - 1] = window_unfiltered_end;
-	}
-	if (fseeko(bedfile, bed_offset + (window_unfiltered_end * ((uint64_t)unfiltered_sample_ct4)), SEEK_SET)) {
-	  goto ld_prune_ret_READ_FAIL;
-	}
-	if (load_and_collapse_incl(bedfile, loadbuf, unfiltered_sample_ct, &(geno[cur_window_size * founder_ct_192_long]), founder_ct, founder_info, final_mask, IS_SET(marker_reverse, window_unfiltered_end))) {
-	  goto ld_prune_ret_READ_FAIL;
-	}
-	if (is_haploid && hh_exists) {
-	  haploid_fix(hh_exists, founder_include2, founder_male_include2, founder_ct, is_x, is_y, (unsigned char*)(&(geno[cur_window_size * founder_ct_192_long])));
-	}
-	if (!ld_process_load(&(geno[cur_window_size * founder_ct_192_long]), &(geno_masks[cur_window_size * founder_ct_192_long]), &(geno_mmasks[cur_window_size * founder_ctv]), &(missing_cts[cur_window_size]), &(sums[cur_window_size]), &(variance_recips[cur_window_size]), founder_ct, is_x && (!ignore_x), weighted_x, nonmale_founder_ct, founder_male_include2, nonmale_geno, nonmale_masks, cur_window_size * founder_ct_192_long)) {
-	  SET_BIT(pruned_arr, window_unfiltered_end);
-	  cur_exclude_ct++;
-	}
-	cur_window_size++;
-      }
-      if (cur_window_size > prev_end) {
-	start_arr[cur_window_size] = window_unfiltered_end;
-      }
-    }
-    uii = get_marker_chrom(chrom_info_ptr, window_unfiltered_start - 1);
-    putchar('\r');
-    LOGPRINTF("Pruned %" PRIuPTR " variant%s from chromosome %u, leaving %" PRIuPTR ".\n", cur_exclude_ct, (cur_exclude_ct == 1)? "" : "s", uii, chrom_info_ptr->chrom_end[uii] - chrom_info_ptr->chrom_start[uii] - popcount_bit_idx(marker_exclude, chrom_info_ptr->chrom_start[uii], chrom_info_ptr->chrom_end[uii]) - cur_exclude_ct);
-    tot_exclude_ct += cur_exclude_ct;
-
-    // advance chromosomes as necessary
-    window_unfiltered_start = ld_prune_next_valid_chrom_start(pruned_arr, window_unfiltered_start, chrom_info_ptr, chrom_code_end, unfiltered_marker_ct);
-  } while (window_unfiltered_start < unfiltered_marker_ct);
 
   LOGPRINTF("Pruning complete.  %u of %" PRIuPTR " variants removed.\n", tot_exclude_ct, marker_ct);
   retval = ld_prune_write(outname, outname_end, marker_exclude, pruned_arr, marker_ids, max_marker_id_len, chrom_info_ptr, chrom_code_end);
@@ -1284,8 +1697,8 @@ int32_t ld_prune(Ld_info* ldip, FILE* bedfile, uintptr_t bed_offset, uintptr_t m
   ld_prune_ret_NOMEM:
     retval = RET_NOMEM;
     break;
-  ld_prune_ret_READ_FAIL:
-    retval = RET_READ_FAIL;
+  ld_prune_ret_OPEN_FAIL:
+    retval = RET_OPEN_FAIL;
     break;
   ld_prune_ret_INVALID_FORMAT:
     retval = RET_INVALID_FORMAT;
@@ -1295,8 +1708,16 @@ int32_t ld_prune(Ld_info* ldip, FILE* bedfile, uintptr_t bed_offset, uintptr_t m
     retval = RET_INVALID_CMDLINE;
     break;
 #endif
+  ld_prune_ret_THREAD_CREATE_FAIL:
+    retval = RET_THREAD_CREATE_FAIL;
+    break;
   }
  ld_prune_ret_1:
+  if (bufs) {
+    for (tidx = 1; tidx < thread_ct; tidx++) {
+      fclose_cond(bufs[tidx].bedfile);
+    }
+  }
   wkspace_reset(wkspace_mark);
   return retval;
 }
@@ -1877,6 +2298,13 @@ int32_t flipscan(Ld_info* ldip, FILE* bedfile, uintptr_t bed_offset, uintptr_t m
   return retval;
 }
 
+// ld_block_thread() evaluates each (idx1 block x idx2 block) in square tiles
+// of variant pairs.  The tile side length is chosen so that the genotype and
+// mask rows of both tile edges fit in LD_TILE_BYTES and stay cached while all
+// of the tile's dot products are computed, and threads claim whole tiles
+// instead of striding through full rows.
+#define LD_TILE_BYTES 131072
+
 // LD multithread globals
 static uintptr_t* g_ld_geno1;
 static uintptr_t* g_ld_geno2;
@@ -1900,6 +2328,7 @@ static uint32_t g_ld_founder_ct_mld_m1;
 static uint32_t g_ld_founder_ct_mld_rem;
 static uint32_t g_ld_is_r2;
 static uint32_t g_ld_thread_ct;
+static uint32_t g_ld_tile_size;
 
 // with '--r2 dprime', males should be downweighted by a factor of 2 when
 // considering two X chromosome variants, and by a factor of sqrt(2) when doing
@@ -1935,9 +2364,9 @@ static uint32_t g_ld_modifier;
 
 THREAD_RET_TYPE ld_block_thread(void* arg) {
   uintptr_t tidx = (uintptr_t)arg;
-  uint32_t thread_ct = g_ld_thread_ct;
-  uintptr_t block_idx1_start = (tidx * g_ld_idx1_block_size) / thread_ct;
-  uintptr_t block_idx1_end = ((tidx + 1) * g_ld_idx1_block_size) / thread_ct;
+  uintptr_t idx1_block_size = g_ld_idx1_block_size;
+  uintptr_t tile_size = g_ld_tile_size;
+  uintptr_t row_tile_ct = (idx1_block_size + tile_size - 1) / tile_size;
   uintptr_t marker_idx2_maxw = g_ld_marker_ctm8;
   uintptr_t founder_ct = g_ld_founder_ct;
   uintptr_t founder_ctwd = founder_ct / BITCT2;
@@ -1968,8 +2397,14 @@ THREAD_RET_TYPE ld_block_thread(void* arg) {
   uintptr_t idx2_block_size;
   uintptr_t idx2_block_start;
   uintptr_t block_idx1;
+  uintptr_t block_idx1_end;
   uintptr_t block_idx2;
   uintptr_t cur_block_idx2_end;
+  uintptr_t tile_idx2_start;
+  uintptr_t tile_idx2_end;
+  uintptr_t ulii;
+  uint32_t tile_idx;
+  uint32_t tile_idx_end;
   double non_missing_ctd;
   double cov12;
   double dxx;
@@ -1987,76 +2422,95 @@ THREAD_RET_TYPE ld_block_thread(void* arg) {
     geno2 = g_ld_geno2;
     geno_masks2 = g_ld_geno_masks2;
     missing_cts2 = g_ld_missing_cts2;
-    for (block_idx1 = block_idx1_start; block_idx1 < block_idx1_end; block_idx1++) {
-      fixed_non_missing_ct = ld_interval1[block_idx1 * 2]; // temporary redefine
-      block_idx2 = fixed_non_missing_ct;
-      cur_block_idx2_end = ld_interval1[block_idx1 * 2 + 1];
-      if (block_idx2 < idx2_block_start) {
-	if (cur_block_idx2_end <= idx2_block_start) {
-	  continue;
+    while (ws_claim(tidx, 1, &tile_idx, &tile_idx_end)) {
+      // consecutive tiles share an idx2 edge
+      ulii = tile_idx / row_tile_ct;
+      tile_idx2_start = ulii * tile_size;
+      tile_idx2_end = tile_idx2_start + tile_size;
+      if (tile_idx2_end > idx2_block_size) {
+	tile_idx2_end = idx2_block_size;
+      }
+      block_idx1 = (tile_idx - ulii * row_tile_ct) * tile_size;
+      block_idx1_end = block_idx1 + tile_size;
+      if (block_idx1_end > idx1_block_size) {
+	block_idx1_end = idx1_block_size;
+      }
+      for (; block_idx1 < block_idx1_end; block_idx1++) {
+	fixed_non_missing_ct = ld_interval1[block_idx1 * 2]; // temporary redefine
+	block_idx2 = fixed_non_missing_ct;
+	cur_block_idx2_end = ld_interval1[block_idx1 * 2 + 1];
+	if (block_idx2 < idx2_block_start) {
+	  if (cur_block_idx2_end <= idx2_block_start) {
+	    continue;
+	  }
+	  block_idx2 = 0;
+	} else {
+	  block_idx2 -= idx2_block_start;
 	}
-	block_idx2 = 0;
-      } else {
-	block_idx2 -= idx2_block_start;
-	if (block_idx2 >= idx2_block_size) {
+	if (block_idx2 < tile_idx2_start) {
+	  block_idx2 = tile_idx2_start;
+	} else if (block_idx2 >= tile_idx2_end) {
 	  // nondecreasing, so we can safely exit
 	  break;
 	}
-      }
-      cur_block_idx2_end -= idx2_block_start;
-      if (cur_block_idx2_end > idx2_block_size) {
-	cur_block_idx2_end = idx2_block_size;
-      }
-      if (results) {
-	rptr = &(results[block_idx1 * marker_idx2_maxw + block_idx2 + idx2_block_start - fixed_non_missing_ct]);
-      } else {
-	rptr_f = &(results_f[block_idx1 * marker_idx2_maxw + block_idx2 + idx2_block_start - fixed_non_missing_ct]);
-      }
-      fixed_missing_ct = missing_cts1[block_idx1];
-      fixed_non_missing_ct = founder_ct - fixed_missing_ct;
-      geno_fixed_vec_ptr = &(geno1[block_idx1 * founder_ct_192_long]);
-      mask_fixed_vec_ptr = &(geno_masks1[block_idx1 * founder_ct_192_long]);
-      for (; block_idx2 < cur_block_idx2_end; block_idx2++) {
-	geno_var_vec_ptr = &(geno2[block_idx2 * founder_ct_192_long]);
-	mask_var_vec_ptr = &(geno_masks2[block_idx2 * founder_ct_192_long]);
-	non_missing_ct = fixed_non_missing_ct - missing_cts2[block_idx2];
-	if (fixed_missing_ct && missing_cts2[block_idx2]) {
-	  non_missing_ct += ld_missing_ct_intersect(mask_var_vec_ptr, mask_fixed_vec_ptr, founder_ctwd12, founder_ctwd12_rem, lshift_last);
-	}
-	dp_result[0] = founder_ct;
-	dp_result[1] = -fixed_non_missing_ct;
-	dp_result[2] = missing_cts2[block_idx2] - founder_ct;
-	dp_result[3] = dp_result[1];
-	dp_result[4] = dp_result[2];
-	ld_dot_prod(geno_var_vec_ptr, geno_fixed_vec_ptr, mask_var_vec_ptr, mask_fixed_vec_ptr, dp_result, founder_ct_mld_m1, founder_ct_mld_rem);
+	cur_block_idx2_end -= idx2_block_start;
+	if (cur_block_idx2_end > tile_idx2_end) {
+	  cur_block_idx2_end = tile_idx2_end;
+	}
+	if (block_idx2 >= cur_block_idx2_end) {
+	  continue;
+	}
 	if (results) {
-	  non_missing_ctd = (double)((int32_t)non_missing_ct);
-	  dxx = dp_result[1];
-	  dyy = dp_result[2];
-	  cov12 = dp_result[0] * non_missing_ctd - dxx * dyy;
-	  dxx = (dp_result[3] * non_missing_ctd + dxx * dxx) * (dp_result[4] * non_missing_ctd + dyy * dyy);
-	  if (!is_r2) {
-	    dxx = cov12 / sqrt(dxx);
-	  } else if (!keep_sign) {
-	    dxx = (cov12 * cov12) / dxx;
-	  } else {
-	    dxx = (fabs(cov12) * cov12) / dxx;
-	  }
-	  *rptr++ = dxx;
+	  rptr = &(results[block_idx1 * marker_idx2_maxw + block_idx2 + idx2_block_start - fixed_non_missing_ct]);
 	} else {
-	  non_missing_ctf = (float)((int32_t)non_missing_ct);
-	  fxx = dp_result[1];
-	  fyy = dp_result[2];
-	  cov12_f = dp_result[0] * non_missing_ctf - fxx * fyy;
-	  fxx = (dp_result[3] * non_missing_ctf + fxx * fxx) * (dp_result[4] * non_missing_ctf + fyy * fyy);
-	  if (!is_r2) {
-	    fxx = cov12_f / sqrt(fxx);
-	  } else if (!keep_sign) {
-	    fxx = (cov12_f * cov12_f) / fxx;
+	  rptr_f = &(results_f[block_idx1 * marker_idx2_maxw + block_idx2 + idx2_block_start - fixed_non_missing_ct]);
+	}
+	fixed_missing_ct = missing_cts1[block_idx1];
+	fixed_non_missing_ct = founder_ct - fixed_missing_ct;
+	geno_fixed_vec_ptr = &(geno1[block_idx1 * founder_ct_192_long]);
+	mask_fixed_vec_ptr = &(geno_masks1[block_idx1 * founder_ct_192_long]);
+	for (; block_idx2 < cur_block_idx2_end; block_idx2++) {
+	  geno_var_vec_ptr = &(geno2[block_idx2 * founder_ct_192_long]);
+	  mask_var_vec_ptr = &(geno_masks2[block_idx2 * founder_ct_192_long]);
+	  non_missing_ct = fixed_non_missing_ct - missing_cts2[block_idx2];
+	  if (fixed_missing_ct && missing_cts2[block_idx2]) {
+	    non_missing_ct += ld_missing_ct_intersect(mask_var_vec_ptr, mask_fixed_vec_ptr, founder_ctwd12, founder_ctwd12_rem, lshift_last);
+	  }
+	  dp_result[0] = founder_ct;
+	  dp_result[1] = -fixed_non_missing_ct;
+	  dp_result[2] = missing_cts2[block_idx2] - founder_ct;
+	  dp_result[3] = dp_result[1];
+	  dp_result[4] = dp_result[2];
+	  ld_dot_prod(geno_var_vec_ptr, geno_fixed_vec_ptr, mask_var_vec_ptr, mask_fixed_vec_ptr, dp_result, founder_ct_mld_m1, founder_ct_mld_rem);
+	  if (results) {
+	    non_missing_ctd = (double)((int32_t)non_missing_ct);
+	    dxx = dp_result[1];
+	    dyy = dp_result[2];
+	    cov12 = dp_result[0] * non_missing_ctd - dxx * dyy;
+	    dxx = (dp_result[3] * non_missing_ctd + dxx * dxx) * (dp_result[4] * non_missing_ctd + dyy * dyy);
+	    if (!is_r2) {
+	      dxx = cov12 / sqrt(dxx);
+	    } else if (!keep_sign) {
+	      dxx = (cov12 * cov12) / dxx;
+	    } else {
+	      dxx = (fabs(cov12) * cov12) / dxx;
+	    }
+	    *rptr++ = dxx;
 	  } else {
-	    fxx = (fabs(cov12_f) * cov12_f) / fxx;
+	    non_missing_ctf = (float)((int32_t)non_missing_ct);
+	    fxx = dp_result[1];
+	    fyy = dp_result[2];
+	    cov12_f = dp_result[0] * non_missing_ctf - fxx * fyy;
+	    fxx = (dp_result[3] * non_missing_ctf + fxx * fxx) * (dp_result[4] * non_missing_ctf + fyy * fyy);
+	    if (!is_r2) {
+	      fxx = cov12_f / sqrt(fxx);
+	    } else if (!keep_sign) {
+	      fxx = (cov12_f * cov12_f) / fxx;
+	    } else {
+	      fxx = (fabs(cov12_f) * cov12_f) / fxx;
+	    }
+	    *rptr_f++ = fxx;
 	  }
-	  *rptr_f++ = fxx;
 	}
       }
     }
@@ -2172,6 +2626,12 @@ int32_t ld_report_matrix(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uintp
   uint32_t chrom_idx;
   uint32_t chrom_end;
   uint32_t is_last_block;
+  unsigned char* bed_prefetch_buf0;
+  unsigned char* bed_prefetch_buf1;
+  unsigned char* bed_row;
+  uint32_t prefetch_block_size;
+  Bed_prefetch bed_prefetch;
+  bed_prefetch.thread_active = 0;
 
   if (wkspace_alloc_uc_checked(&overflow_buf, 262144)) {
     goto ld_report_matrix_ret_NOMEM;
@@ -2238,7 +2698,7 @@ int32_t ld_report_matrix(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uintp
     }
   }
 
-  // claim the other half with idx2 buffer
+  // claim the rest with idx2 buffer
   ulii -= marker_ctm8 * (8 - 4 * output_single_prec) + 2 * sizeof(int32_t);
   if (!output_single_prec) {
     idx2_block_size = (wkspace_left / ulii) & (~(7 * ONELU));
@@ -2265,6 +2725,9 @@ int32_t ld_report_matrix(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uintp
       idx2_block_size -= 16;
     }
   }
+  // the idx2 sweeps read the .bed in order, so they're prefetched with
+  // whatever's left over; this never shrinks the idx2 block
+  prefetch_block_size = bed_prefetch_row_alloc(unfiltered_sample_ct4, &bed_prefetch_buf0, &bed_prefetch_buf1);
   uljj = founder_trail_ct + 2;
   for (ulii = 1; ulii <= idx1_block_size; ulii++) {
     fill_ulong_zero(&(g_ld_geno1[ulii * founder_ct_192_long - uljj]), uljj);
@@ -2314,6 +2777,7 @@ int32_t ld_report_matrix(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uintp
   wordwrap(logbuf, 16); // strlen("99% [processing]")
   logprintb();
   fputs("0%", stdout);
+  time_trace_push("ld_matrix_blocks", marker_idx1_end - marker_idx1);
   do {
     fputs(" [processing]", stdout);
     fflush(stdout);
@@ -2372,6 +2836,9 @@ int32_t ld_report_matrix(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uintp
     if (fseeko(bedfile, bed_offset + (marker_uidx2 * ((uint64_t)unfiltered_sample_ct4)), SEEK_SET)) {
       goto ld_report_matrix_ret_READ_FAIL;
     }
+    if (prefetch_block_size) {
+      bed_prefetch_init(&bed_prefetch, bedfile, bed_offset, marker_exclude, marker_uidx2, 0, marker_idx2_end, prefetch_block_size, unfiltered_sample_ct4, bed_prefetch_buf0, bed_prefetch_buf1);
+    }
     cur_idx2_block_size = idx2_block_size;
     do {
       if (cur_idx2_block_size > marker_idx2_end - marker_idx2) {
@@ -2380,7 +2847,7 @@ int32_t ld_report_matrix(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uintp
       for (block_idx2 = 0; block_idx2 < cur_idx2_block_size; marker_uidx2++, block_idx2++) {
 	if (IS_SET(marker_exclude, marker_uidx2)) {
           marker_uidx2 = next_unset_ul_unsafe(marker_exclude, marker_uidx2);
-	  if (fseeko(bedfile, bed_offset + (marker_uidx2 * ((uint64_t)unfiltered_sample_ct4)), SEEK_SET)) {
+	  if ((!prefetch_block_size) && fseeko(bedfile, bed_offset + (marker_uidx2 * ((uint64_t)unfiltered_sample_ct4)), SEEK_SET)) {
 	    goto ld_report_matrix_ret_READ_FAIL;
 	  }
 	}
@@ -2391,7 +2858,12 @@ int32_t ld_report_matrix(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uintp
 	  is_x = (((int32_t)chrom_idx) == chrom_info_ptr->x_code);
 	  is_y = (((int32_t)chrom_idx) == chrom_info_ptr->y_code);
 	}
-	if (load_and_collapse_incl(bedfile, loadbuf, unfiltered_sample_ct, &(g_ld_geno2[block_idx2 * founder_ct_192_long]), founder_ct, founder_info, final_mask, IS_SET(marker_reverse, marker_uidx2))) {
+	if (prefetch_block_size) {
+	  if (bed_prefetch_row(&bed_prefetch, marker_uidx2, &bed_row)) {
+	    goto ld_report_matrix_ret_READ_FAIL;
+	  }
+	  copy_and_collapse_incl(bed_row, loadbuf, unfiltered_sample_ct, &(g_ld_geno2[block_idx2 * founder_ct_192_long]), founder_ct, founder_info, final_mask, IS_SET(marker_reverse, marker_uidx2));
+	} else if (load_and_collapse_incl(bedfile, loadbuf, unfiltered_sample_ct, &(g_ld_geno2[block_idx2 * founder_ct_192_long]), founder_ct, founder_info, final_mask, IS_SET(marker_reverse, marker_uidx2))) {
 	  goto ld_report_matrix_ret_READ_FAIL;
 	}
 	if (is_haploid && hh_exists) {
@@ -2403,12 +2875,15 @@ int32_t ld_report_matrix(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uintp
       g_ld_idx2_block_start = marker_idx2;
       marker_idx2 += cur_idx2_block_size;
       is_last_block = (marker_idx2 >= marker_idx2_end);
+      ulii = g_ld_tile_size;
+      ws_ranges_init(thread_ct, 0, ((idx1_block_size + ulii - 1) / ulii) * ((cur_idx2_block_size + ulii - 1) / ulii));
       if (spawn_threads2(threads, &ld_block_thread, thread_ct, is_last_block)) {
 	goto ld_report_matrix_ret_THREAD_CREATE_FAIL;
       }
       ld_block_thread((void*)0);
       join_threads2(threads, thread_ct, is_last_block);
     } while (!is_last_block);
+    bed_prefetch_cleanup(&bed_prefetch);
     fputs("\b\b\b\b\b\b\b\b\b\b\bwriting]   \b\b\b", stdout);
     fflush(stdout);
     if (is_binary) {
@@ -2505,6 +2980,7 @@ int32_t ld_report_matrix(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uintp
       }
     }
   } while (marker_idx1 < marker_idx1_end);
+  time_trace_pop();
   fputs("\b\b", stdout);
   logprint("done.\n");
   if (is_binary) {
@@ -2532,6 +3008,7 @@ int32_t ld_report_matrix(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uintp
     retval = RET_THREAD_CREATE_FAIL;
     break;
   }
+  bed_prefetch_cleanup(&bed_prefetch);
   fclose_cond(outfile);
   // trust parent to free memory
   return retval;
@@ -2707,6 +3184,108 @@ uint32_t ld_regular_emitn(uint32_t overflow_ct, unsigned char* readbuf) {
   return (uintptr_t)(((unsigned char*)sptr_cur) - readbuf);
 }
 
+// --r/--r2 bin-sparse file layout (native byte order):
+//   header (LD_SPARSE_HEADER_SIZE bytes): "PLDSPRS" + format version byte;
+//     uint32 flags (bit 0 set for r^2); uint32 anchor count; uint64 total pair
+//     record count
+//   anchor table, LD_SPARSE_ANCHOR_SIZE bytes per anchor: uint64 index of the
+//     anchor's first pair record, uint32 anchor variant index, uint32 pair
+//     record count
+//   pair records, LD_SPARSE_PAIR_SIZE bytes each: uint32 partner variant
+//     index, float r or r^2
+// Variant indices are 0-based positions in the filtered variant list.  Anchors
+// are in increasing index order, as are each anchor's partners, so entry i of
+// the anchor table (and the pair records it points to) can be located
+// directly.
+#define LD_SPARSE_HEADER_SIZE 24
+#define LD_SPARSE_ANCHOR_SIZE 16
+#define LD_SPARSE_PAIR_SIZE 8
+
+static uint64_t g_ld_sparse_pair_ct;
+static uintptr_t g_ld_sparse_anchor_uidx;
+static uintptr_t g_ld_sparse_anchor_idx;
+
+static inline void ld_sparse_anchor_set(unsigned char* anchor_ptr, uint64_t first_pair_idx, uint32_t anchor_idx, uint32_t pair_ct) {
+  memcpy(anchor_ptr, &first_pair_idx, sizeof(int64_t));
+  memcpy(&(anchor_ptr[8]), &anchor_idx, sizeof(int32_t));
+  memcpy(&(anchor_ptr[12]), &pair_ct, sizeof(int32_t));
+}
+
+int32_t ld_regular_write_sparse(FILE* outfile, unsigned char* writebuf, unsigned char* anchor_buf, uintptr_t anchor_table_idx, uintptr_t marker_uidx1, uintptr_t marker_idx2_base) {
+  // Binary counterpart of ld_regular_emitn().  Pair records are appended at
+  // the current end of outfile; this idx1 block's anchor table entries are
+  // then patched into place.
+  unsigned char* writebuf_end = &(writebuf[PIGZ_BLOCK_SIZE]);
+  unsigned char* wptr = writebuf;
+  uintptr_t* marker_exclude_idx1 = g_ld_marker_exclude_idx1;
+  uintptr_t* marker_exclude = g_ld_marker_exclude;
+  uint32_t* ld_interval1 = g_ld_interval1;
+  double* results = g_ld_results;
+  uintptr_t block_size1 = g_ld_idx1_block_size;
+  uintptr_t marker_idx2_maxw = g_ld_marker_ctm8;
+  uintptr_t anchor_uidx = g_ld_sparse_anchor_uidx;
+  uintptr_t anchor_idx = g_ld_sparse_anchor_idx;
+  uint64_t pair_ct = g_ld_sparse_pair_ct;
+  double window_r2 = g_ld_window_r2;
+  uint32_t is_r2 = g_ld_is_r2;
+  uintptr_t block_idx1;
+  uintptr_t block_idx2;
+  uintptr_t block_end2;
+  uint64_t first_pair_idx;
+  double* dptr;
+  double dxx;
+  float fxx;
+  uint32_t uii;
+  for (block_idx1 = 0; block_idx1 < block_size1; block_idx1++, marker_uidx1++) {
+    next_unset_ul_unsafe_ck(marker_exclude_idx1, &marker_uidx1);
+    // filtered index of this anchor, tracked incrementally
+    anchor_idx += marker_uidx1 - anchor_uidx - popcount_bit_idx(marker_exclude, anchor_uidx, marker_uidx1);
+    anchor_uidx = marker_uidx1;
+    first_pair_idx = pair_ct;
+    block_idx2 = ld_interval1[2 * block_idx1];
+    block_end2 = ld_interval1[2 * block_idx1 + 1];
+    dptr = &(results[block_idx1 * marker_idx2_maxw]);
+    for (; block_idx2 < block_end2; block_idx2++) {
+      dxx = *dptr++;
+      if (is_r2) {
+	dxx = fabs(dxx);
+	if (dxx < window_r2) {
+	  continue;
+	}
+      }
+      uii = marker_idx2_base + block_idx2;
+      fxx = (float)dxx;
+      memcpy(wptr, &uii, sizeof(int32_t));
+      memcpy(&(wptr[4]), &fxx, sizeof(float));
+      wptr = &(wptr[LD_SPARSE_PAIR_SIZE]);
+      pair_ct++;
+      if (wptr == writebuf_end) {
+	if (fwrite_checked(writebuf, PIGZ_BLOCK_SIZE, outfile)) {
+	  return RET_WRITE_FAIL;
+	}
+	wptr = writebuf;
+      }
+    }
+    ld_sparse_anchor_set(&(anchor_buf[block_idx1 * LD_SPARSE_ANCHOR_SIZE]), first_pair_idx, anchor_idx, (uint32_t)(pair_ct - first_pair_idx));
+  }
+  if (fwrite_checkedz(writebuf, (uintptr_t)(wptr - writebuf), outfile)) {
+    return RET_WRITE_FAIL;
+  }
+  if (fseeko(outfile, LD_SPARSE_HEADER_SIZE + ((uint64_t)anchor_table_idx) * LD_SPARSE_ANCHOR_SIZE, SEEK_SET)) {
+    return RET_WRITE_FAIL;
+  }
+  if (fwrite_checked(anchor_buf, block_size1 * LD_SPARSE_ANCHOR_SIZE, outfile)) {
+    return RET_WRITE_FAIL;
+  }
+  if (fseeko(outfile, 0, SEEK_END)) {
+    return RET_WRITE_FAIL;
+  }
+  g_ld_sparse_anchor_uidx = anchor_uidx;
+  g_ld_sparse_anchor_idx = anchor_idx;
+  g_ld_sparse_pair_ct = pair_ct;
+  return 0;
+}
+
 // The following three functions are built around a data representation
 // introduced by Xiang Yan et al.'s BOOST software (the original bitwise
 // representation I came up with was less efficient); see
@@ -5538,11 +6117,14 @@ int32_t ld_report_dprime(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uintp
 
 int32_t ld_report_regular(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uintptr_t bed_offset, uintptr_t unfiltered_marker_ct, uintptr_t* marker_reverse, uintptr_t unfiltered_sample_ct, uintptr_t* founder_info, uint32_t parallel_idx, uint32_t parallel_tot, uintptr_t* sex_male, uintptr_t* founder_include2, uintptr_t* founder_male_include2, uintptr_t* loadbuf, char* outname, uint32_t hh_exists) {
   FILE* infile = NULL;
+  FILE* outfile = NULL;
+  unsigned char* sparse_anchor_buf = NULL;
   uintptr_t* marker_exclude = g_ld_marker_exclude;
   char* marker_ids = g_ld_marker_ids;
   uintptr_t max_marker_id_len = g_ld_max_marker_id_len;
   uint32_t ld_modifier = ldip->modifier;
   uint32_t output_gz = ld_modifier & LD_REPORT_GZ;
+  uint32_t output_sparse = ld_modifier & LD_REPORT_SPARSE;
   uint32_t ignore_x = (ld_modifier & LD_IGNORE_X) & 1;
   uint32_t is_inter_chr = ld_modifier & LD_INTER_CHR;
   uint32_t snp_list_file = ld_modifier & LD_SNP_LIST_FILE;
@@ -5614,6 +6196,12 @@ int32_t ld_report_regular(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uint
   uint32_t is_last_block;
   uint32_t uii;
   int32_t ii;
+  unsigned char* bed_prefetch_buf0;
+  unsigned char* bed_prefetch_buf1;
+  unsigned char* bed_row;
+  uint32_t prefetch_block_size;
+  Bed_prefetch bed_prefetch;
+  bed_prefetch.thread_active = 0;
   if (wkspace_alloc_uc_checked(&overflow_buf, 262144)) {
     goto ld_report_regular_ret_NOMEM;
   }
@@ -5759,6 +6347,21 @@ int32_t ld_report_regular(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uint
   if (wkspace_alloc_d_checked(&g_ld_results, marker_idx2_maxw * idx1_block_size * sizeof(double))) {
     goto ld_report_regular_ret_NOMEM;
   }
+  if (output_sparse) {
+    if (wkspace_alloc_uc_checked(&sparse_anchor_buf, idx1_block_size * LD_SPARSE_ANCHOR_SIZE)) {
+      goto ld_report_regular_ret_NOMEM;
+    }
+    if (fopen_checked(&outfile, outname, "wb")) {
+      goto ld_report_regular_ret_OPEN_FAIL;
+    }
+    // anchor table is filled in one idx1 block at a time
+    if (fseeko(outfile, LD_SPARSE_HEADER_SIZE + ((uint64_t)job_size) * LD_SPARSE_ANCHOR_SIZE, SEEK_SET)) {
+      goto ld_report_regular_ret_WRITE_FAIL;
+    }
+    g_ld_sparse_pair_ct = 0;
+    g_ld_sparse_anchor_uidx = 0;
+    g_ld_sparse_anchor_idx = 0;
+  }
 
   ulii -= 2 * sizeof(int32_t) + marker_idx2_maxw * sizeof(double);
   idx2_block_size = (wkspace_left / ulii) & (~(7 * ONELU));
@@ -5778,6 +6381,8 @@ int32_t ld_report_regular(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uint
     wkspace_reset(wkspace_mark2);
     idx2_block_size -= 8;
   }
+  // see ld_report_matrix()
+  prefetch_block_size = bed_prefetch_row_alloc(unfiltered_sample_ct4, &bed_prefetch_buf0, &bed_prefetch_buf1);
   uljj = founder_trail_ct + 2;
   for (ulii = 1; ulii <= idx1_block_size; ulii++) {
     fill_ulong_zero(&(g_ld_geno1[ulii * founder_ct_192_long - uljj]), uljj);
@@ -5791,10 +6396,11 @@ int32_t ld_report_regular(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uint
   if (marker_idx1) {
     marker_uidx1 = jump_forward_unset_unsafe(marker_exclude_idx1, marker_uidx1 + 1, marker_idx1);
   }
-  sprintf(logbuf, "--r%s%s%s%s to %s ... ", g_ld_is_r2? "2" : "", is_inter_chr? " inter-chr" : "", g_ld_marker_allele_ptrs? " in-phase" : "", g_ld_set_allele_freqs? " with-freqs" : "", outname);
+  sprintf(logbuf, "--r%s%s%s%s%s to %s ... ", g_ld_is_r2? "2" : "", is_inter_chr? " inter-chr" : "", g_ld_marker_allele_ptrs? " in-phase" : "", g_ld_set_allele_freqs? " with-freqs" : "", output_sparse? " bin-sparse" : "", outname);
   wordwrap(logbuf, 16); // strlen("99% [processing]")
   logprintb();
   fputs("0%", stdout);
+  time_trace_push("ld_regular_blocks", marker_idx1_end - marker_idx1);
   while (1) {
     fputs(" [processing]", stdout);
     fflush(stdout);
@@ -5822,6 +6428,14 @@ int32_t ld_report_regular(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uint
     } else {
       marker_idx2_base = marker_uidx1 + 1 - popcount_bit_idx(marker_exclude, 0, marker_uidx1);
       if (marker_idx2_base == marker_ct) {
+	if (output_sparse) {
+	  // final variant; no partners
+	  ld_sparse_anchor_set(sparse_anchor_buf, g_ld_sparse_pair_ct, marker_ct - 1, 0);
+	  if (fseeko(outfile, LD_SPARSE_HEADER_SIZE + ((uint64_t)(marker_idx1 - marker_idx1_start)) * LD_SPARSE_ANCHOR_SIZE, SEEK_SET) ||
+	      fwrite_checked(sparse_anchor_buf, LD_SPARSE_ANCHOR_SIZE, outfile)) {
+	    goto ld_report_regular_ret_WRITE_FAIL;
+	  }
+	}
 	goto ld_report_regular_done;
       }
       marker_idx2 = marker_idx2_base - 1;
@@ -5939,6 +6553,9 @@ int32_t ld_report_regular(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uint
     }
     g_ld_marker_ctm8 = marker_idx2_maxw;
     marker_idx2 = marker_idx2_base;
+    if (prefetch_block_size) {
+      bed_prefetch_init(&bed_prefetch, bedfile, bed_offset, marker_exclude, marker_uidx2, marker_idx2, marker_idx2_end, prefetch_block_size, unfiltered_sample_ct4, bed_prefetch_buf0, bed_prefetch_buf1);
+    }
     chrom_end2 = 0;
     do {
       if (cur_idx2_block_size > marker_idx2_end - marker_idx2) {
@@ -5949,7 +6566,7 @@ int32_t ld_report_regular(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uint
 	// todo: when set has big holes in the middle, do not load everything
 	if (IS_SET(marker_exclude, marker_uidx2)) {
           marker_uidx2 = next_unset_ul_unsafe(marker_exclude, marker_uidx2);
-          if (fseeko(bedfile, bed_offset + (marker_uidx2 * ((uint64_t)unfiltered_sample_ct4)), SEEK_SET)) {
+          if ((!prefetch_block_size) && fseeko(bedfile, bed_offset + (marker_uidx2 * ((uint64_t)unfiltered_sample_ct4)), SEEK_SET)) {
 	    goto ld_report_regular_ret_READ_FAIL;
 	  }
 	}
@@ -5961,7 +6578,12 @@ int32_t ld_report_regular(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uint
 	  is_x = (((int32_t)chrom_idx2) == chrom_info_ptr->x_code);
 	  is_y = (((int32_t)chrom_idx2) == chrom_info_ptr->y_code);
 	}
-	if (load_and_collapse_incl(bedfile, loadbuf, unfiltered_sample_ct, &(g_ld_geno2[block_idx2 * founder_ct_192_long]), founder_ct, founder_info, final_mask, IS_SET(marker_reverse, marker_uidx2))) {
+	if (prefetch_block_size) {
+	  if (bed_prefetch_row(&bed_prefetch, marker_uidx2, &bed_row)) {
+	    goto ld_report_regular_ret_READ_FAIL;
+	  }
+	  copy_and_collapse_incl(bed_row, loadbuf, unfiltered_sample_ct, &(g_ld_geno2[block_idx2 * founder_ct_192_long]), founder_ct, founder_info, final_mask, IS_SET(marker_reverse, marker_uidx2));
+	} else if (load_and_collapse_incl(bedfile, loadbuf, unfiltered_sample_ct, &(g_ld_geno2[block_idx2 * founder_ct_192_long]), founder_ct, founder_info, final_mask, IS_SET(marker_reverse, marker_uidx2))) {
 	  goto ld_report_regular_ret_READ_FAIL;
 	}
 	if (is_haploid && hh_exists) {
@@ -5974,12 +6596,15 @@ int32_t ld_report_regular(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uint
       g_ld_idx2_block_start = marker_idx2 - marker_idx2_base;
       marker_idx2 += cur_idx2_block_size;
       is_last_block = (marker_idx2 >= marker_idx2_end);
+      ulii = g_ld_tile_size;
+      ws_ranges_init(thread_ct, 0, ((idx1_block_size + ulii - 1) / ulii) * ((cur_idx2_block_size + ulii - 1) / ulii));
       if (spawn_threads2(threads, &ld_block_thread, thread_ct, is_last_block)) {
 	goto ld_report_regular_ret_THREAD_CREATE_FAIL;
       }
       ld_block_thread((void*)0);
       join_threads2(threads, thread_ct, is_last_block);
     } while (!is_last_block);
+    bed_prefetch_cleanup(&bed_prefetch);
 
     fputs("\b\b\b\b\b\b\b\b\b\b\bwriting]   \b\b\b", stdout);
     fflush(stdout);
@@ -5988,7 +6613,12 @@ int32_t ld_report_regular(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uint
     g_ld_uidx2_start = marker_uidx2_base;
     g_ld_idx2_block_start = 0;
     g_ld_block_idx2 = 0;
-    if (output_gz) {
+    if (output_sparse) {
+      retval = ld_regular_write_sparse(outfile, overflow_buf, sparse_anchor_buf, marker_idx1 - marker_idx1_start, marker_uidx1, marker_idx2_base);
+      if (retval) {
+	goto ld_report_regular_ret_1;
+      }
+    } else if (output_gz) {
       parallel_compress(outname, overflow_buf, not_first_write, ld_regular_emitn);
     } else {
       write_uncompressed(outname, overflow_buf, not_first_write, ld_regular_emitn);
@@ -6014,6 +6644,22 @@ int32_t ld_report_regular(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uint
     }
     marker_uidx1 = jump_forward_unset_unsafe(marker_exclude_idx1, marker_uidx1 + 1, idx1_block_size);
   }
+  time_trace_pop();
+  if (output_sparse) {
+    memcpy(tbuf, "PLDSPRS\1", 8);
+    uii = g_ld_is_r2? 1 : 0;
+    memcpy(&(tbuf[8]), &uii, sizeof(int32_t));
+    uii = job_size;
+    memcpy(&(tbuf[12]), &uii, sizeof(int32_t));
+    memcpy(&(tbuf[16]), &g_ld_sparse_pair_ct, sizeof(int64_t));
+    if (fseeko(outfile, 0, SEEK_SET) ||
+        fwrite_checked(tbuf, LD_SPARSE_HEADER_SIZE, outfile)) {
+      goto ld_report_regular_ret_WRITE_FAIL;
+    }
+    if (fclose_null(&outfile)) {
+      goto ld_report_regular_ret_WRITE_FAIL;
+    }
+  }
   fputs("\b\b", stdout);
   logprint("done.\n");
   while (0) {
@@ -6026,6 +6672,9 @@ int32_t ld_report_regular(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uint
   ld_report_regular_ret_READ_FAIL:
     retval = RET_READ_FAIL;
     break;
+  ld_report_regular_ret_WRITE_FAIL:
+    retval = RET_WRITE_FAIL;
+    break;
   ld_report_regular_ret_EMPTY_SET1:
     logprint("Error: No valid variants specified by --ld-snp/--ld-snps/--ld-snp-list.\n");
   ld_report_regular_ret_INVALID_CMDLINE:
@@ -6039,7 +6688,9 @@ int32_t ld_report_regular(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uint
     break;
   }
  ld_report_regular_ret_1:
+  bed_prefetch_cleanup(&bed_prefetch);
   fclose_cond(infile);
+  fclose_cond(outfile);
   // trust parent to free memory
   return retval;
 }
@@ -6074,6 +6725,11 @@ int32_t ld_report(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uintptr_t be
   g_ld_marker_ct = marker_ct;
   g_ld_chrom_info_ptr = chrom_info_ptr;
   g_ld_thread_ct = g_thread_ct;
+  // 2 buffers (genotype + missing mask) per variant, 2 tile edges
+  g_ld_tile_size = LD_TILE_BYTES / (founder_ct_192_long * 4 * sizeof(intptr_t));
+  if (!g_ld_tile_size) {
+    g_ld_tile_size = 1;
+  }
   g_ld_set_allele_freqs = (ld_modifier & LD_WITH_FREQS)? set_allele_freqs : NULL;
   if (founder_ct < 2) {
     LOGPRINTF("Warning: Skipping --r%s since there are less than two founders.\n(--make-founders may come in handy here.)\n", g_ld_is_r2? "2" : "");
@@ -6098,6 +6754,8 @@ int32_t ld_report(pthread_t* threads, Ld_info* ldip, FILE* bedfile, uintptr_t be
   // matrix case, dump a list of expelled site IDs)
   if (is_binary) {
     bufptr = memcpya(bufptr, ".bin", 4);
+  } else if (ld_modifier & LD_REPORT_SPARSE) {
+    bufptr = memcpya(bufptr, ".sparse", 7);
   }
   if (parallel_tot > 1) {
     *bufptr++ = '.';
@@ -12459,6 +13117,150 @@ void update_clump_histo(double pval, uintptr_t* histo) {
   }
 }
 
+// Index variants are processed in batches of up to thread_ct *
+// CLUMP_BATCH_PER_THREAD.
+#define CLUMP_BATCH_PER_THREAD 16
+
+uint32_t clump_window_bounds(uintptr_t* marker_exclude, uint32_t* marker_pos, Chrom_info* chrom_info_ptr, uint32_t ivar_uidx, uint32_t bp_radius, uint32_t* clump_uidx_first_ptr, uint32_t* clump_uidx_last_ptr) {
+  // returns chromosome file-order index; window bounds are inclusive
+  uint32_t cur_bp = marker_pos[ivar_uidx];
+  uint32_t chrom_fo_idx = get_marker_chrom_fo_idx(chrom_info_ptr, ivar_uidx);
+  uint32_t chrom_start = chrom_info_ptr->chrom_file_order_marker_idx[chrom_fo_idx];
+  uint32_t clump_uidx_first;
+  uint32_t clump_uidx_last;
+  if (cur_bp < bp_radius) {
+    clump_uidx_first = chrom_start;
+  } else {
+    clump_uidx_first = chrom_start + uint32arr_greater_than(&(marker_pos[chrom_start]), ivar_uidx + 1 - chrom_start, cur_bp - bp_radius);
+  }
+  next_unset_unsafe_ck(marker_exclude, &clump_uidx_first);
+  clump_uidx_last = ivar_uidx + uint32arr_greater_than(&(marker_pos[ivar_uidx]), chrom_info_ptr->chrom_file_order_marker_idx[chrom_fo_idx + 1] - ivar_uidx, cur_bp + bp_radius + 1);
+  prev_unset_unsafe_ck(marker_exclude, &clump_uidx_last);
+  *clump_uidx_first_ptr = clump_uidx_first;
+  *clump_uidx_last_ptr = clump_uidx_last;
+  return chrom_fo_idx;
+}
+
+double clump_r2(uintptr_t* geno, uintptr_t* index_data, uint32_t* index_tots, uintptr_t founder_ctl2, uintptr_t founder_ctv2, uint32_t is_x) {
+  // Signed r^2 between a clump candidate and the index variant whose masked
+  // genotype vectors are in index_data.  NAN is returned when the EM phasing
+  // step fails; it never passes the r^2 threshold.
+  uint32_t counts[18];
+  double freq1x;
+  double freq2x;
+  double freqx1;
+  double freqx2;
+  double freq11;
+  double freq11_expected;
+  double cur_r2;
+  double dxx;
+  vec_3freq(founder_ctl2, geno, index_data, &(counts[0]), &(counts[1]), &(counts[2]));
+  counts[0] = index_tots[0] - counts[0] - counts[1] - counts[2];
+  vec_3freq(founder_ctl2, geno, &(index_data[founder_ctv2]), &(counts[3]), &(counts[4]), &(counts[5]));
+  counts[3] = index_tots[1] - counts[3] - counts[4] - counts[5];
+  vec_3freq(founder_ctl2, geno, &(index_data[2 * founder_ctv2]), &(counts[6]), &(counts[7]), &(counts[8]));
+  counts[6] = index_tots[2] - counts[6] - counts[7] - counts[8];
+  if (is_x) {
+    vec_3freq(founder_ctl2, geno, &(index_data[3 * founder_ctv2]), &(counts[9]), &(counts[10]), &(counts[11]));
+    counts[9] = index_tots[3] - counts[9] - counts[11];
+    vec_3freq(founder_ctl2, geno, &(index_data[4 * founder_ctv2]), &(counts[15]), &(counts[16]), &(counts[17]));
+    counts[15] = index_tots[4] - counts[15] - counts[17];
+  }
+  if (em_phase_hethet_nobase(counts, is_x, is_x, &freq1x, &freq2x, &freqx1, &freqx2, &freq11)) {
+    return NAN;
+  }
+  freq11_expected = freqx1 * freq1x;
+  dxx = freq11 - freq11_expected;
+  cur_r2 = fabs(dxx);
+  // if r^2 threshold is 0, let everything else through but exclude the
+  // apparent zeroes.  Zeroes *are* included if r2_thresh is negative,
+  // though (only nans are rejected then).
+  if (cur_r2 >= SMALL_EPSILON) {
+    return cur_r2 * dxx / (freq11_expected * freq2x * freqx2);
+  }
+  return 0;
+}
+
+// --clump multithread globals
+static uintptr_t* g_clump_geno_cache;
+static uint32_t* g_clump_cache_slots;
+static uintptr_t* g_clump_index_bufs;
+static double* g_clump_r2s;
+static uintptr_t* g_clump_r2_starts;
+static uint32_t* g_clump_batch_sps;
+static uint32_t* g_clump_pval_map;
+static uint32_t* g_clump_nsig_arr;
+static Clump_entry** g_clump_entries;
+static uintptr_t* g_clump_marker_exclude;
+static uint32_t* g_clump_marker_pos;
+static uint32_t* g_clump_marker_idx_to_uidx;
+static Chrom_info* g_clump_chrom_info_ptr;
+static uintptr_t* g_clump_founder_include2;
+static uintptr_t* g_clump_founder_male_include2;
+static uintptr_t g_clump_founder_ct;
+static uint32_t g_clump_bp_radius;
+
+THREAD_RET_TYPE clump_r2_thread(void* arg) {
+  // Computes r^2 between each batch index variant and every clump candidate
+  // in its window, in window order, regardless of whether the candidate has
+  // already been clumped; clump_reports() decides which values to use.
+  uintptr_t tidx = (uintptr_t)arg;
+  uintptr_t founder_ct = g_clump_founder_ct;
+  uintptr_t founder_ctl2 = (founder_ct + (BITCT2 - 1)) / BITCT2;
+  uintptr_t founder_ctv2 = 2 * ((founder_ct + (BITCT - 1)) / BITCT);
+  uintptr_t* index_data = &(g_clump_index_bufs[tidx * 5 * founder_ctv2]);
+  uintptr_t* geno_cache = g_clump_geno_cache;
+  uint32_t* cache_slots = g_clump_cache_slots;
+  uintptr_t* marker_exclude = g_clump_marker_exclude;
+  uintptr_t* founder_include2 = g_clump_founder_include2;
+  uintptr_t* founder_male_include2 = g_clump_founder_male_include2;
+  Clump_entry** clump_entries = g_clump_entries;
+  uint32_t* nsig_arr = g_clump_nsig_arr;
+  Chrom_info* chrom_info_ptr = g_clump_chrom_info_ptr;
+  uint32_t index_tots[5];
+  uintptr_t* index_geno;
+  double* r2_ptr;
+  uint32_t batch_idx;
+  uint32_t batch_end;
+  uint32_t ivar_idx;
+  uint32_t ivar_uidx;
+  uint32_t clump_uidx_first;
+  uint32_t clump_uidx_last;
+  uint32_t marker_uidx;
+  uint32_t marker_idx;
+  uint32_t clump_chrom_idx;
+  uint32_t is_x;
+  while (ws_claim(tidx, 1, &batch_idx, &batch_end)) {
+    ivar_idx = g_clump_pval_map[g_clump_batch_sps[batch_idx]];
+    ivar_uidx = g_clump_marker_idx_to_uidx[ivar_idx];
+    clump_chrom_idx = chrom_info_ptr->chrom_file_order[clump_window_bounds(marker_exclude, g_clump_marker_pos, chrom_info_ptr, ivar_uidx, g_clump_bp_radius, &clump_uidx_first, &clump_uidx_last)];
+    is_x = (clump_chrom_idx == (uint32_t)chrom_info_ptr->x_code);
+    index_geno = &(geno_cache[cache_slots[ivar_idx] * founder_ctv2]);
+    vec_datamask(founder_ct, 0, index_geno, founder_include2, index_data);
+    index_tots[0] = popcount2_longs(index_data, founder_ctl2);
+    vec_datamask(founder_ct, 2, index_geno, founder_include2, &(index_data[founder_ctv2]));
+    index_tots[1] = popcount2_longs(&(index_data[founder_ctv2]), founder_ctl2);
+    vec_datamask(founder_ct, 3, index_geno, founder_include2, &(index_data[2 * founder_ctv2]));
+    index_tots[2] = popcount2_longs(&(index_data[2 * founder_ctv2]), founder_ctl2);
+    if (is_x) {
+      vec_datamask(founder_ct, 0, index_geno, founder_male_include2, &(index_data[3 * founder_ctv2]));
+      index_tots[3] = popcount2_longs(&(index_data[3 * founder_ctv2]), founder_ctl2);
+      vec_datamask(founder_ct, 3, index_geno, founder_male_include2, &(index_data[4 * founder_ctv2]));
+      index_tots[4] = popcount2_longs(&(index_data[4 * founder_ctv2]), founder_ctl2);
+    }
+    r2_ptr = &(g_clump_r2s[g_clump_r2_starts[batch_idx]]);
+    marker_idx = ivar_idx + popcount_bit_idx(marker_exclude, clump_uidx_first, ivar_uidx) + clump_uidx_first - ivar_uidx;
+    for (marker_uidx = clump_uidx_first; marker_uidx <= clump_uidx_last; marker_uidx++, marker_idx++) {
+      next_unset_unsafe_ck(marker_exclude, &marker_uidx);
+      if ((marker_idx == ivar_idx) || ((!clump_entries[marker_idx]) && (!nsig_arr[marker_idx]))) {
+	continue;
+      }
+      *r2_ptr++ = clump_r2(&(geno_cache[cache_slots[marker_idx] * founder_ctv2]), index_data, index_tots, founder_ctl2, founder_ctv2, is_x);
+    }
+  }
+  THREAD_RETURN;
+}
+
 int32_t clump_reports(FILE* bedfile, uintptr_t bed_offset, char* outname, char* outname_end, uintptr_t unfiltered_marker_ct, uintptr_t* marker_exclude, uintptr_t marker_ct, char* marker_ids, uintptr_t max_marker_id_len, uint32_t plink_maxsnp, uint32_t* marker_pos, char** marker_allele_ptrs, uintptr_t* marker_reverse, Chrom_info* chrom_info_ptr, uintptr_t unfiltered_sample_ct, uintptr_t* founder_info, Clump_info* clump_ip, uintptr_t* sex_male, uint32_t hh_exists) {
   unsigned char* wkspace_mark = wkspace_base;
   FILE* infile = NULL;
@@ -12470,7 +13272,6 @@ int32_t clump_reports(FILE* bedfile, uintptr_t bed_offset, char* outname, char*
   uintptr_t unfiltered_sample_ctl = (unfiltered_sample_ct + (BITCT - 1)) / BITCT;
   uintptr_t unfiltered_sample_ctl2 = (unfiltered_sample_ct + (BITCT2 - 1)) / BITCT2;
   uintptr_t founder_ct = popcount_longs(founder_info, unfiltered_sample_ctl);
-  uintptr_t founder_ctl2 = (founder_ct + (BITCT2 - 1)) / BITCT2;
   uintptr_t founder_ctv2 = 2 * ((founder_ct + (BITCT - 1)) / BITCT);
   uintptr_t final_mask = get_final_mask(founder_ct);
   uintptr_t topsize = 0;
@@ -12518,8 +13319,7 @@ int32_t clump_reports(FILE* bedfile, uintptr_t bed_offset, char* outname, char*
   uint32_t max_missing_id_len = 0;
   int32_t retval = 0;
   uintptr_t histo[5]; // NSIG, S05, S01, S001, S0001
-  uint32_t index_tots[5];
-  uint32_t counts[18];
+  pthread_t threads[MAX_THREADS];
   Clump_entry** clump_entries;
   Clump_entry* clump_entry_ptr;
   Clump_entry* best_entry_ptr;
@@ -12529,9 +13329,9 @@ int32_t clump_reports(FILE* bedfile, uintptr_t bed_offset, char* outname, char*
   uintptr_t* col_bitfield;
   uintptr_t* cur_bitfield;
   uintptr_t* loadbuf_raw;
-  uintptr_t* index_data;
-  uintptr_t* window_data;
+  uintptr_t* geno_cache;
   uintptr_t* window_data_ptr;
+  uintptr_t* r2_starts;
   char* sorted_missing_variant_ids;
   char* sorted_header_dict;
   char* loadbuft; // t is for text
@@ -12549,27 +13349,30 @@ int32_t clump_reports(FILE* bedfile, uintptr_t bed_offset, char* outname, char*
   uint32_t* pval_map;
   uint32_t* marker_uidx_to_idx;
   uint32_t* marker_idx_to_uidx;
+  uint32_t* cache_slots;
+  uint32_t* cache_idxs;
+  uint32_t* batch_sps;
   double* sorted_pvals;
+  double* r2s;
+  double* r2_ptr;
   Clump_missing_id* cm_ptr;
   uintptr_t header_dict_ct;
   uintptr_t extra_annot_space;
   uintptr_t loadbuft_size;
   uintptr_t marker_idx;
   uintptr_t last_marker_idx;
-  uintptr_t max_window_size; // universal bound
   uintptr_t cur_window_size;
+  uintptr_t cc_max;
+  uintptr_t cache_max;
+  uintptr_t cache_ct;
+  uintptr_t r2_max;
+  uintptr_t r2_ct;
   uintptr_t line_idx;
   uintptr_t ulii;
   uintptr_t uljj;
   uintptr_t ulkk;
   uintptr_t ulmm;
   double pval;
-  double freq1x;
-  double freq2x;
-  double freqx1;
-  double freqx2;
-  double freq11;
-  double freq11_expected;
   double cur_r2;
   double max_r2;
   double dxx;
@@ -12579,6 +13382,13 @@ int32_t clump_reports(FILE* bedfile, uintptr_t bed_offset, char* outname, char*
   uint32_t cur_read_ct;
   uint32_t index_ct;
   uint32_t sp_idx;
+  uint32_t sp_next;
+  uint32_t thread_ct;
+  uint32_t cur_thread_ct;
+  uint32_t batch_max;
+  uint32_t batch_ct;
+  uint32_t batch_idx;
+  uint32_t bed_next_uidx;
   uint32_t file_idx;
   uint32_t ivar_idx;
   uint32_t ivar_uidx;
@@ -12602,9 +13412,6 @@ int32_t clump_reports(FILE* bedfile, uintptr_t bed_offset, char* outname, char*
   uint32_t ukk;
   uint32_t umm;
   int32_t ii;
-  // suppress warning
-  index_tots[3] = 0;
-  index_tots[4] = 0;
 
   if (annot_flattened && (!clump_verbose) && (!clump_best)) {
     logprint("Error: --clump-annotate must be used with --clump-verbose or --clump-best.\n");
@@ -13000,15 +13807,22 @@ int32_t clump_reports(FILE* bedfile, uintptr_t bed_offset, char* outname, char*
   if (qsort_ext((char*)sorted_pvals, index_ct, sizeof(double), double_cmp_deref, (char*)pval_map, sizeof(int32_t))) {
     goto clump_reports_ret_NOMEM2;
   }
+  thread_ct = g_thread_ct;
+  batch_max = thread_ct * CLUMP_BATCH_PER_THREAD;
   if (wkspace_alloc_ui_checked(&marker_idx_to_uidx, marker_ct * sizeof(int32_t)) ||
       wkspace_alloc_ul_checked(&loadbuf_raw, unfiltered_sample_ctl2 * sizeof(intptr_t)) ||
-      wkspace_alloc_ul_checked(&index_data, 5 * founder_ctv2 * sizeof(intptr_t))) {
+      wkspace_alloc_ul_checked(&g_clump_index_bufs, thread_ct * 5 * founder_ctv2 * sizeof(intptr_t)) ||
+      wkspace_alloc_ui_checked(&cache_slots, marker_ct * sizeof(int32_t)) ||
+      wkspace_alloc_ui_checked(&batch_sps, batch_max * sizeof(int32_t)) ||
+      wkspace_alloc_ul_checked(&r2_starts, batch_max * sizeof(intptr_t))) {
     goto clump_reports_ret_NOMEM2;
   }
-  for (uii = 1; uii <= 5; uii++) {
-    index_data[uii * founder_ctv2 - 2] = 0;
-    index_data[uii * founder_ctv2 - 1] = 0;
+  for (uii = 1; uii <= 5 * thread_ct; uii++) {
+    g_clump_index_bufs[uii * founder_ctv2 - 2] = 0;
+    g_clump_index_bufs[uii * founder_ctv2 - 1] = 0;
   }
+  // 0xffffffffU = genotypes not resident
+  fill_uint_one(cache_slots, marker_ct);
   if (alloc_collapsed_haploid_filters(unfiltered_sample_ct, founder_ct, Y_FIX_NEEDED, 1, founder_info, sex_male, &founder_include2, &founder_male_include2)) {
     goto clump_reports_ret_NOMEM2; 
  }
@@ -13017,12 +13831,31 @@ int32_t clump_reports(FILE* bedfile, uintptr_t bed_offset, char* outname, char*
       goto clump_reports_ret_NOMEM2;
     }
   }
-  window_data = (uintptr_t*)wkspace_base;
-  max_window_size = wkspace_left / (founder_ctv2 * sizeof(intptr_t) + sizeof(Cur_clump_info));
-  if (!max_window_size) {
+  // Remaining workspace: 1/4 for the current clump's member list, 1/8 for
+  // batch r^2 values, and the rest for resident genotypes.  Genotypes stay
+  // resident until the cache fills up, so in the common case each variant is
+  // read from the .bed at most once.
+  cc_max = (wkspace_left / 4) / sizeof(Cur_clump_info);
+  r2_max = (wkspace_left / 8) / sizeof(double);
+  if (wkspace_alloc_c_checked((char**)(&cur_clump_base), cc_max * sizeof(Cur_clump_info)) ||
+      wkspace_alloc_d_checked(&r2s, r2_max * sizeof(double))) {
+    goto clump_reports_ret_NOMEM2;
+  }
+  cur_clump_ceil = &(cur_clump_base[cc_max]);
+  if (wkspace_left <= 2 * CACHELINE) {
+    goto clump_reports_ret_NOMEM2;
+  }
+  cache_max = (wkspace_left - 2 * CACHELINE) / (founder_ctv2 * sizeof(intptr_t) + sizeof(int32_t));
+  if (!cache_max) {
+    goto clump_reports_ret_NOMEM2;
+  }
+  if (cache_max > marker_ct) {
+    cache_max = marker_ct;
+  }
+  if (wkspace_alloc_ui_checked(&cache_idxs, cache_max * sizeof(int32_t)) ||
+      wkspace_alloc_ul_checked(&geno_cache, cache_max * founder_ctv2 * sizeof(intptr_t))) {
     goto clump_reports_ret_NOMEM2;
   }
-  cur_clump_ceil = (Cur_clump_info*)(&(wkspace_base[wkspace_left]));
   fill_idx_to_uidx(marker_exclude, unfiltered_marker_ct, marker_ct, marker_idx_to_uidx);
   loadbuf_raw[unfiltered_sample_ctl2 - 1] = 0;
   wkspace_left += topsize;
@@ -13084,87 +13917,129 @@ int32_t clump_reports(FILE* bedfile, uintptr_t bed_offset, char* outname, char*
       goto clump_reports_ret_WRITE_FAIL;
     }
   }
+  g_clump_geno_cache = geno_cache;
+  g_clump_cache_slots = cache_slots;
+  g_clump_r2s = r2s;
+  g_clump_r2_starts = r2_starts;
+  g_clump_batch_sps = batch_sps;
+  g_clump_pval_map = pval_map;
+  g_clump_nsig_arr = nsig_arr;
+  g_clump_entries = clump_entries;
+  g_clump_marker_exclude = marker_exclude;
+  g_clump_marker_pos = marker_pos;
+  g_clump_marker_idx_to_uidx = marker_idx_to_uidx;
+  g_clump_chrom_info_ptr = chrom_info_ptr;
+  g_clump_founder_include2 = founder_include2;
+  g_clump_founder_male_include2 = founder_male_include2;
+  g_clump_founder_ct = founder_ct;
+  g_clump_bp_radius = bp_radius;
+  cache_ct = 0;
+  batch_ct = 0;
+  batch_idx = 0;
+  bed_next_uidx = 0xffffffffU;
+  time_trace_push("clump_index_variants", index_ct);
   for (sp_idx = 0; sp_idx < index_ct; sp_idx++) {
     ivar_idx = pval_map[sp_idx];
     if ((!clump_best) && is_set(cur_bitfield, ivar_idx)) {
       continue;
     }
-    ivar_uidx = marker_idx_to_uidx[ivar_idx];
-    cur_bp = marker_pos[ivar_uidx];
-    uii = get_marker_chrom_fo_idx(chrom_info_ptr, ivar_uidx);
-    clump_chrom_idx = chrom_info_ptr->chrom_file_order[uii];
-    ujj = chrom_info_ptr->chrom_file_order_marker_idx[uii];
-    if (cur_bp < bp_radius) {
-      clump_uidx_first = ujj;
-    } else {
-      clump_uidx_first = ujj + uint32arr_greater_than(&(marker_pos[ujj]), ivar_uidx + 1 - ujj, cur_bp - bp_radius);
-    }
-    next_unset_unsafe_ck(marker_exclude, &clump_uidx_first);
-    clump_uidx_last = ivar_uidx + uint32arr_greater_than(&(marker_pos[ivar_uidx]), chrom_info_ptr->chrom_file_order_marker_idx[uii + 1] - ivar_uidx, cur_bp + bp_radius + 1);
-    prev_unset_unsafe_ck(marker_exclude, &clump_uidx_last);
-    marker_uidx = clump_uidx_first;
-    marker_idx = ivar_idx + popcount_bit_idx(marker_exclude, clump_uidx_first, ivar_uidx) + clump_uidx_first - ivar_uidx;
-    // Don't want to seek backwards in the file any more than necessary, so
-    // 1. load all clump-inclusion candidates before index variant
-    // 2. load index variant, compute pairwise r^2s
-    // 3. load one clump-inclusion at a time after index variant, compute r^2
-    // 4. write main result
-    cur_window_size = 0;
-    is_haploid = is_set(haploid_mask, clump_chrom_idx);
-    is_x = (clump_chrom_idx == (uint32_t)chrom_info_ptr->x_code);
-    is_y = (clump_chrom_idx == (uint32_t)chrom_info_ptr->y_code);
-    window_data_ptr = window_data;
-    for (; marker_idx < ivar_idx; marker_uidx++, marker_idx++) {
-      next_unset_unsafe_ck(marker_exclude, &marker_uidx);
-      if (((!allow_overlap) && is_set(cur_bitfield, marker_idx)) || ((!clump_entries[marker_idx]) && (!nsig_arr[marker_idx]))) {
-	continue;
-      }
-      if (++cur_window_size == max_window_size) {
-	goto clump_reports_ret_NOMEM;
-      }
-      if (fseeko(bedfile, bed_offset + marker_uidx * ((uint64_t)unfiltered_sample_ct4), SEEK_SET)) {
-	goto clump_reports_ret_READ_FAIL;
+    // Every index variant which isn't skipped here was also not skipped when
+    // its batch was formed (cur_bitfield only gains bits), so it has
+    // precomputed r^2 values.
+    while ((batch_idx < batch_ct) && (batch_sps[batch_idx] < sp_idx)) {
+      batch_idx++;
+    }
+    if (batch_idx == batch_ct) {
+      // Form the next batch, making the windows' genotypes resident, and then
+      // compute all index-candidate r^2 values in the batch in parallel.  A
+      // batch member may still end up clumped by an earlier member; that
+      // just wastes a bit of computation.
+      batch_ct = 0;
+      r2_ct = 0;
+      for (sp_next = sp_idx; (batch_ct < batch_max) && (sp_next < index_ct); sp_next++) {
+	ivar_idx = pval_map[sp_next];
+	if ((!clump_best) && is_set(cur_bitfield, ivar_idx)) {
+	  continue;
+	}
+	ivar_uidx = marker_idx_to_uidx[ivar_idx];
+	uii = clump_window_bounds(marker_exclude, marker_pos, chrom_info_ptr, ivar_uidx, bp_radius, &clump_uidx_first, &clump_uidx_last);
+	ulii = 0; // window variants that need r^2 values, including index
+	uljj = 0; // window variants not yet resident
+	marker_idx = ivar_idx + popcount_bit_idx(marker_exclude, clump_uidx_first, ivar_uidx) + clump_uidx_first - ivar_uidx;
+	for (marker_uidx = clump_uidx_first; marker_uidx <= clump_uidx_last; marker_uidx++, marker_idx++) {
+	  next_unset_unsafe_ck(marker_exclude, &marker_uidx);
+	  if ((!clump_entries[marker_idx]) && (!nsig_arr[marker_idx])) {
+	    continue;
+	  }
+	  ulii++;
+	  if (cache_slots[marker_idx] == 0xffffffffU) {
+	    uljj++;
+	  }
+	}
+	ulii--;
+	if ((r2_ct + ulii > r2_max) || (cache_ct + uljj > cache_max)) {
+	  if (batch_ct) {
+	    break;
+	  }
+	  if ((ulii > r2_max) || (ulii >= cache_max)) {
+	    goto clump_reports_ret_NOMEM;
+	  }
+	  // evict everything
+	  for (ulkk = 0; ulkk < cache_ct; ulkk++) {
+	    cache_slots[cache_idxs[ulkk]] = 0xffffffffU;
+	  }
+	  cache_ct = 0;
+	}
+	clump_chrom_idx = chrom_info_ptr->chrom_file_order[uii];
+	is_haploid = is_set(haploid_mask, clump_chrom_idx);
+	is_x = (clump_chrom_idx == (uint32_t)chrom_info_ptr->x_code);
+	is_y = (clump_chrom_idx == (uint32_t)chrom_info_ptr->y_code);
+	marker_idx = ivar_idx + popcount_bit_idx(marker_exclude, clump_uidx_first, ivar_uidx) + clump_uidx_first - ivar_uidx;
+	for (marker_uidx = clump_uidx_first; marker_uidx <= clump_uidx_last; marker_uidx++, marker_idx++) {
+	  next_unset_unsafe_ck(marker_exclude, &marker_uidx);
+	  if (((!clump_entries[marker_idx]) && (!nsig_arr[marker_idx])) || (cache_slots[marker_idx] != 0xffffffffU)) {
+	    continue;
+	  }
+	  if (marker_uidx != bed_next_uidx) {
+	    if (fseeko(bedfile, bed_offset + marker_uidx * ((uint64_t)unfiltered_sample_ct4), SEEK_SET)) {
+	      goto clump_reports_ret_READ_FAIL;
+	    }
+	  }
+	  window_data_ptr = &(geno_cache[cache_ct * founder_ctv2]);
+	  window_data_ptr[founder_ctv2 - 2] = 0;
+	  window_data_ptr[founder_ctv2 - 1] = 0;
+	  if (load_and_collapse_incl(bedfile, loadbuf_raw, unfiltered_sample_ct, window_data_ptr, founder_ct, founder_info, final_mask, is_set(marker_reverse, marker_uidx))) {
+	    goto clump_reports_ret_READ_FAIL;
+	  }
+	  if (is_haploid) {
+	    haploid_fix(hh_exists, founder_include2, founder_male_include2, founder_ct, is_x, is_y, (unsigned char*)window_data_ptr);
+	  }
+	  cache_slots[marker_idx] = cache_ct;
+	  cache_idxs[cache_ct++] = marker_idx;
+	  bed_next_uidx = marker_uidx + 1;
+	}
+	batch_sps[batch_ct] = sp_next;
+	r2_starts[batch_ct++] = r2_ct;
+	r2_ct += ulii;
       }
-      window_data_ptr[founder_ctv2 - 2] = 0;
-      window_data_ptr[founder_ctv2 - 1] = 0;
-      if (load_and_collapse_incl(bedfile, loadbuf_raw, unfiltered_sample_ct, window_data_ptr, founder_ct, founder_info, final_mask, is_set(marker_reverse, marker_uidx))) {
-	goto clump_reports_ret_READ_FAIL;
+      cur_thread_ct = thread_ct;
+      if (cur_thread_ct > batch_ct) {
+	cur_thread_ct = batch_ct;
       }
-      if (is_haploid) {
-	haploid_fix(hh_exists, founder_include2, founder_male_include2, founder_ct, is_x, is_y, (unsigned char*)window_data_ptr);
+      ws_ranges_init(cur_thread_ct, 0, batch_ct);
+      if (spawn_threads(threads, &clump_r2_thread, cur_thread_ct)) {
+	goto clump_reports_ret_THREAD_CREATE_FAIL;
       }
-      window_data_ptr = &(window_data_ptr[founder_ctv2]);
-    }
-    if (fseeko(bedfile, bed_offset + marker_uidx * ((uint64_t)unfiltered_sample_ct4), SEEK_SET)) {
-      goto clump_reports_ret_READ_FAIL;
-    }
-    window_data_ptr[founder_ctv2 - 2] = 0;
-    window_data_ptr[founder_ctv2 - 1] = 0;
-    if (load_and_collapse_incl(bedfile, loadbuf_raw, unfiltered_sample_ct, window_data_ptr, founder_ct, founder_info, final_mask, is_set(marker_reverse, marker_uidx))) {
-      goto clump_reports_ret_READ_FAIL;
-    }
-    if (is_haploid) {
-      haploid_fix(hh_exists, founder_include2, founder_male_include2, founder_ct, is_x, is_y, (unsigned char*)window_data_ptr);
-    }
-    vec_datamask(founder_ct, 0, window_data_ptr, founder_include2, index_data);
-    index_tots[0] = popcount2_longs(index_data, founder_ctl2);
-    vec_datamask(founder_ct, 2, window_data_ptr, founder_include2, &(index_data[founder_ctv2]));
-    index_tots[1] = popcount2_longs(&(index_data[founder_ctv2]), founder_ctl2);
-    vec_datamask(founder_ct, 3, window_data_ptr, founder_include2, &(index_data[2 * founder_ctv2]));
-    index_tots[2] = popcount2_longs(&(index_data[2 * founder_ctv2]), founder_ctl2);
-    if (is_x) {
-      vec_datamask(founder_ct, 0, window_data_ptr, founder_male_include2, &(index_data[3 * founder_ctv2]));
-      index_tots[3] = popcount2_longs(&(index_data[3 * founder_ctv2]), founder_ctl2);
-      vec_datamask(founder_ct, 3, window_data_ptr, founder_male_include2, &(index_data[4 * founder_ctv2]));
-      index_tots[4] = popcount2_longs(&(index_data[4 * founder_ctv2]), founder_ctl2);
-    }
-    if (!cur_window_size) {
-      cur_clump_base = (Cur_clump_info*)(&(window_data[founder_ctv2]));
-    } else {
-      cur_clump_base = (Cur_clump_info*)window_data_ptr;
+      clump_r2_thread((void*)0);
+      join_threads(threads, cur_thread_ct);
+      batch_idx = 0;
+      ivar_idx = pval_map[sp_idx];
     }
+    r2_ptr = &(r2s[r2_starts[batch_idx++]]);
+    ivar_uidx = marker_idx_to_uidx[ivar_idx];
+    cur_bp = marker_pos[ivar_uidx];
+    clump_chrom_idx = chrom_info_ptr->chrom_file_order[clump_window_bounds(marker_exclude, marker_pos, chrom_info_ptr, ivar_uidx, bp_radius, &clump_uidx_first, &clump_uidx_last)];
     cc_ptr = cur_clump_base;
-    window_data_ptr = window_data;
     marker_uidx = clump_uidx_first;
     marker_idx = ivar_idx + popcount_bit_idx(marker_exclude, clump_uidx_first, ivar_uidx) + clump_uidx_first - ivar_uidx;
     max_r2 = -1;
@@ -13172,61 +14047,39 @@ int32_t clump_reports(FILE* bedfile, uintptr_t bed_offset, char* outname, char*
     fill_ulong_zero(histo, 5);
     best_entry_ptr = NULL;
     for (; marker_idx < ivar_idx; marker_uidx++, marker_idx++) {
-      marker_uidx = next_unset_unsafe(marker_exclude, marker_uidx);
+      next_unset_unsafe_ck(marker_exclude, &marker_uidx);
       clump_entry_ptr = clump_entries[marker_idx];
-      if (((!allow_overlap) && is_set(cur_bitfield, marker_idx)) || ((!clump_entry_ptr) && (!nsig_arr[marker_idx]))) {
+      if ((!clump_entry_ptr) && (!nsig_arr[marker_idx])) {
 	continue;
       }
-      vec_3freq(founder_ctl2, window_data_ptr, index_data, &(counts[0]), &(counts[1]), &(counts[2]));
-      counts[0] = index_tots[0] - counts[0] - counts[1] - counts[2];
-      vec_3freq(founder_ctl2, window_data_ptr, &(index_data[founder_ctv2]), &(counts[3]), &(counts[4]), &(counts[5]));
-      counts[3] = index_tots[1] - counts[3] - counts[4] - counts[5];
-      vec_3freq(founder_ctl2, window_data_ptr, &(index_data[2 * founder_ctv2]), &(counts[6]), &(counts[7]), &(counts[8]));
-      counts[6] = index_tots[2] - counts[6] - counts[7] - counts[8];
-      if (is_x) {
-        vec_3freq(founder_ctl2, window_data_ptr, &(index_data[3 * founder_ctv2]), &(counts[9]), &(counts[10]), &(counts[11]));
-        counts[9] = index_tots[3] - counts[9] - counts[11];
-        vec_3freq(founder_ctl2, window_data_ptr, &(index_data[4 * founder_ctv2]), &(counts[15]), &(counts[16]), &(counts[17]));
-        counts[15] = index_tots[4] - counts[15] - counts[17];
-      }
-      if (!em_phase_hethet_nobase(counts, is_x, is_x, &freq1x, &freq2x, &freqx1, &freqx2, &freq11)) {
-	freq11_expected = freqx1 * freq1x;
-	dxx = freq11 - freq11_expected;
-	cur_r2 = fabs(dxx);
-        // if r^2 threshold is 0, let everything else through but exclude the
-        // apparent zeroes.  Zeroes *are* included if r2_thresh is negative,
-	// though (only nans are rejected then).
-        if (cur_r2 >= SMALL_EPSILON) {
-	  cur_r2 = cur_r2 * dxx / (freq11_expected * freq2x * freqx2);
-	} else {
-	  cur_r2 = 0;
-	}
-	if (fabs(cur_r2) > r2_thresh) {
-	  while (clump_entry_ptr) {
-	    dxx = clump_entry_ptr->pval;
-	    update_clump_histo(dxx, histo);
-	    if (dxx < p2_thresh) {
-	      if (cc_ptr >= cur_clump_ceil) {
-		goto clump_reports_ret_NOMEM;
-	      }
-	      cc_ptr->r2 = cur_r2;
-	      cc_ptr->marker_idx = marker_idx;
-	      uii = clump_entry_ptr->fidx;
-	      cc_ptr->fidx = uii;
-	      if ((uii == best_fidx_match) && (fabs(cur_r2) > max_r2)) {
-		max_r2 = cur_r2;
-		max_r2_uidx = marker_uidx;
-		best_entry_ptr = clump_entry_ptr;
-	      }
-	      cc_ptr++;
+      cur_r2 = *r2_ptr++;
+      if ((!allow_overlap) && is_set(cur_bitfield, marker_idx)) {
+	continue;
+      }
+      if (fabs(cur_r2) > r2_thresh) {
+	while (clump_entry_ptr) {
+	  dxx = clump_entry_ptr->pval;
+	  update_clump_histo(dxx, histo);
+	  if (dxx < p2_thresh) {
+	    if (cc_ptr >= cur_clump_ceil) {
+	      goto clump_reports_ret_NOMEM;
 	    }
-	    clump_entry_ptr = clump_entry_ptr->next;
+	    cc_ptr->r2 = cur_r2;
+	    cc_ptr->marker_idx = marker_idx;
+	    uii = clump_entry_ptr->fidx;
+	    cc_ptr->fidx = uii;
+	    if ((uii == best_fidx_match) && (fabs(cur_r2) > max_r2)) {
+	      max_r2 = cur_r2;
+	      max_r2_uidx = marker_uidx;
+	      best_entry_ptr = clump_entry_ptr;
+	    }
+	    cc_ptr++;
 	  }
-	  histo[0] += nsig_arr[marker_idx];
-	  set_bit(cur_bitfield, marker_idx);
+	  clump_entry_ptr = clump_entry_ptr->next;
 	}
+	histo[0] += nsig_arr[marker_idx];
+	set_bit(cur_bitfield, marker_idx);
       }
-      window_data_ptr = &(window_data_ptr[founder_ctv2]);
     }
     pval = sorted_pvals[sp_idx];
     clump_entry_ptr = clump_entries[ivar_idx];
@@ -13293,65 +14146,36 @@ int32_t clump_reports(FILE* bedfile, uintptr_t bed_offset, char* outname, char*
       next_unset_unsafe_ck(marker_exclude, &marker_uidx);
       marker_idx++;
       clump_entry_ptr = clump_entries[marker_idx];
-      if (((!allow_overlap) && is_set(cur_bitfield, marker_idx)) || ((!clump_entry_ptr) && (!nsig_arr[marker_idx]))) {
+      if ((!clump_entry_ptr) && (!nsig_arr[marker_idx])) {
 	continue;
       }
-      if (fseeko(bedfile, bed_offset + marker_uidx * ((uint64_t)unfiltered_sample_ct4), SEEK_SET)) {
-	goto clump_reports_ret_READ_FAIL;
-      }
-      window_data[founder_ctv2 - 2] = 0;
-      window_data[founder_ctv2 - 1] = 0;
-      if (load_and_collapse_incl(bedfile, loadbuf_raw, unfiltered_sample_ct, window_data, founder_ct, founder_info, final_mask, is_set(marker_reverse, marker_uidx))) {
-	goto clump_reports_ret_READ_FAIL;
+      cur_r2 = *r2_ptr++;
+      if ((!allow_overlap) && is_set(cur_bitfield, marker_idx)) {
+	continue;
       }
-      if (is_haploid) {
-        haploid_fix(hh_exists, founder_include2, founder_male_include2, founder_ct, is_x, is_y, (unsigned char*)window_data);
-      }
-      vec_3freq(founder_ctl2, window_data, index_data, &(counts[0]), &(counts[1]), &(counts[2]));
-      counts[0] = index_tots[0] - counts[0] - counts[1] - counts[2];
-      vec_3freq(founder_ctl2, window_data, &(index_data[founder_ctv2]), &(counts[3]), &(counts[4]), &(counts[5]));
-      counts[3] = index_tots[1] - counts[3] - counts[4] - counts[5];
-      vec_3freq(founder_ctl2, window_data, &(index_data[2 * founder_ctv2]), &(counts[6]), &(counts[7]), &(counts[8]));
-      counts[6] = index_tots[2] - counts[6] - counts[7] - counts[8];
-      if (is_x) {
-        vec_3freq(founder_ctl2, window_data, &(index_data[3 * founder_ctv2]), &(counts[9]), &(counts[10]), &(counts[11]));
-        counts[9] = index_tots[3] - counts[9] - counts[11];
-        vec_3freq(founder_ctl2, window_data, &(index_data[4 * founder_ctv2]), &(counts[15]), &(counts[16]), &(counts[17]));
-        counts[15] = index_tots[4] - counts[15] - counts[17];
-      }
-      if (!em_phase_hethet_nobase(counts, is_x, is_x, &freq1x, &freq2x, &freqx1, &freqx2, &freq11)) {
-        freq11_expected = freqx1 * freq1x;
-	dxx = freq11 - freq11_expected;
-	cur_r2 = fabs(dxx);
-	if (cur_r2 >= SMALL_EPSILON) {
-	  cur_r2 = cur_r2 * dxx / (freq11_expected * freq2x * freqx2);
-	} else {
-	  cur_r2 = 0;
-	}
-	if (fabs(cur_r2) > r2_thresh) {
-	  while (clump_entry_ptr) {
-	    dxx = clump_entry_ptr->pval;
-            update_clump_histo(dxx, histo);
-	    if (dxx < p2_thresh) {
-	      if (cc_ptr >= cur_clump_ceil) {
-		goto clump_reports_ret_NOMEM;
-	      }
-	      cc_ptr->r2 = cur_r2;
-	      cc_ptr->marker_idx = marker_idx;
-	      uii = clump_entry_ptr->fidx;
-	      cc_ptr->fidx = uii;
-	      if ((uii == best_fidx_match) && (fabs(cur_r2) > max_r2)) {
-		max_r2 = cur_r2;
-		max_r2_uidx = marker_uidx;
-		best_entry_ptr = clump_entry_ptr;
-	      }
-	      cc_ptr++;
+      if (fabs(cur_r2) > r2_thresh) {
+	while (clump_entry_ptr) {
+	  dxx = clump_entry_ptr->pval;
+	  update_clump_histo(dxx, histo);
+	  if (dxx < p2_thresh) {
+	    if (cc_ptr >= cur_clump_ceil) {
+	      goto clump_reports_ret_NOMEM;
 	    }
-	    clump_entry_ptr = clump_entry_ptr->next;
+	    cc_ptr->r2 = cur_r2;
+	    cc_ptr->marker_idx = marker_idx;
+	    uii = clump_entry_ptr->fidx;
+	    cc_ptr->fidx = uii;
+	    if ((uii == best_fidx_match) && (fabs(cur_r2) > max_r2)) {
+	      max_r2 = cur_r2;
+	      max_r2_uidx = marker_uidx;
+	      best_entry_ptr = clump_entry_ptr;
+	    }
+	    cc_ptr++;
 	  }
-	  histo[0] += nsig_arr[marker_idx];
-	  set_bit(cur_bitfield, marker_idx);
+	  clump_entry_ptr = clump_entry_ptr->next;
 	}
+	histo[0] += nsig_arr[marker_idx];
+	set_bit(cur_bitfield, marker_idx);
       }
     }
     cur_window_size = (uintptr_t)(cc_ptr - cur_clump_base);
@@ -13744,6 +14568,7 @@ int32_t clump_reports(FILE* bedfile, uintptr_t bed_offset, char* outname, char*
       }
     }
   }
+  time_trace_pop();
   putc('\n', outfile);
   if (missing_variant_ct) {
     // 1. sort by ID (could switch this to hash table-based too)
@@ -13855,6 +14680,9 @@ int32_t clump_reports(FILE* bedfile, uintptr_t bed_offset, char* outname, char*
   clump_reports_ret_INVALID_CMDLINE:
     retval = RET_INVALID_CMDLINE;
     break;
+  clump_reports_ret_THREAD_CREATE_FAIL:
+    retval = RET_THREAD_CREATE_FAIL;
+    break;
   clump_reports_ret_DUPLICATE_HEADER_COL:
     *bufptr2 = '\0';
     LOGPREPRINTFWW("Error: Duplicate column header '%s' in %s.\n", bufptr, fname_ptr);
@@ -2765,7 +2765,130 @@ int32_t write_freqs(char* outname, char* outname_end, uint32_t plink_maxsnp, uin
   return retval;
 }
 
-int32_t sexcheck(FILE* bedfile, uintptr_t bed_offset, char* outname, char* outname_end, uintptr_t unfiltered_marker_ct, uintptr_t* marker_exclude, uintptr_t unfiltered_sample_ct, uintptr_t* sample_exclude, uintptr_t sample_ct, char* sample_ids, uint32_t plink_maxfid, uint32_t plink_maxiid, uintptr_t max_sample_id_len, uintptr_t* sex_nm, uintptr_t* sex_male, uint64_t misc_flags, double check_sex_fthresh, double check_sex_mthresh, uint32_t max_f_yobs, uint32_t min_m_yobs, Chrom_info* chrom_info_ptr, double* set_allele_freqs, uint32_t* gender_unk_ct_ptr) {
+int32_t sample_major_f_counts(FILE* smajfile, uintptr_t unfiltered_marker_ct, uintptr_t* var_exclude, uintptr_t* sample_exclude, uintptr_t sample_ct, double* set_allele_freqs, uintptr_t* miss2_include2, uint32_t* het_cts, uint32_t* missing_cts, double* nei_offsets, uint32_t* miss2_cts, double* nei_sum_ptr, uintptr_t* variant_ct_ptr) {
+  // Sample-major (--sample-major-cache) version of the F coefficient loops in
+  // sexcheck() and het_report().  var_exclude marks the variants to skip on
+  // entry; monomorphic and all-missing variants are added to it.  Every
+  // per-sample sum is still accumulated in variant order, so results are
+  // bit-identical to the variant-major loops.  All-missing variants can only
+  // be identified after a full pass, so when any turn up, they're excluded
+  // and the pass is repeated (this is rare in practice).
+  // If miss2_cts is non-NULL, missing calls among the variants in
+  // miss2_include2 are also counted (used for --check-sex ycount).
+  unsigned char* wkspace_mark = wkspace_base;
+  uintptr_t unfiltered_marker_ct4 = (unfiltered_marker_ct + 3) / 4;
+  uintptr_t unfiltered_marker_ctl2 = (unfiltered_marker_ct + (BITCT2 - 1)) / BITCT2;
+  uintptr_t variant_ct = 0;
+  double nei_sum = 0.0;
+  int32_t retval = 0;
+  uintptr_t* rowbuf;
+  uintptr_t* include2;
+  uintptr_t* nm_seen;
+  double* nei_vals;
+  double dpp;
+  uintptr_t marker_uidx;
+  uintptr_t sample_uidx;
+  uintptr_t sample_idx;
+  uintptr_t widx;
+  uintptr_t cur_word;
+  uintptr_t miss_word;
+  uintptr_t ulii;
+  uint32_t all_missing_found;
+  if (wkspace_alloc_ul_checked(&rowbuf, unfiltered_marker_ctl2 * sizeof(intptr_t)) ||
+      wkspace_alloc_ul_checked(&include2, unfiltered_marker_ctl2 * sizeof(intptr_t)) ||
+      wkspace_alloc_ul_checked(&nm_seen, unfiltered_marker_ctl2 * sizeof(intptr_t)) ||
+      wkspace_alloc_d_checked(&nei_vals, unfiltered_marker_ct * sizeof(double))) {
+    goto sample_major_f_counts_ret_NOMEM;
+  }
+  rowbuf[unfiltered_marker_ctl2 - 1] = 0;
+  for (marker_uidx = 0; marker_uidx < unfiltered_marker_ct; marker_uidx++) {
+    marker_uidx = next_unset_ul(var_exclude, marker_uidx, unfiltered_marker_ct);
+    if (marker_uidx == unfiltered_marker_ct) {
+      break;
+    }
+    dpp = set_allele_freqs[marker_uidx];
+    if ((dpp < 1e-8) || (dpp > (1 - 1e-8))) {
+      SET_BIT(var_exclude, marker_uidx);
+    } else {
+      nei_vals[marker_uidx] = 1.0 - 2 * dpp * (1 - dpp);
+    }
+  }
+  do {
+    exclude_to_vec_include(unfiltered_marker_ct, include2, var_exclude);
+    fill_ulong_zero(nm_seen, unfiltered_marker_ctl2);
+    fill_uint_zero(het_cts, sample_ct);
+    fill_uint_zero(missing_cts, sample_ct);
+    fill_double_zero(nei_offsets, sample_ct);
+    if (miss2_cts) {
+      fill_uint_zero(miss2_cts, sample_ct);
+    }
+    sample_uidx = next_unset_ul_unsafe(sample_exclude, 0);
+    if (fseeko(smajfile, 3 + ((uint64_t)sample_uidx) * unfiltered_marker_ct4, SEEK_SET)) {
+      goto sample_major_f_counts_ret_READ_FAIL;
+    }
+    for (sample_idx = 0; sample_idx < sample_ct; sample_idx++, sample_uidx++) {
+      if (IS_SET(sample_exclude, sample_uidx)) {
+	sample_uidx = next_unset_ul_unsafe(sample_exclude, sample_uidx);
+	if (fseeko(smajfile, 3 + ((uint64_t)sample_uidx) * unfiltered_marker_ct4, SEEK_SET)) {
+	  goto sample_major_f_counts_ret_READ_FAIL;
+	}
+      }
+      if (load_raw(smajfile, rowbuf, unfiltered_marker_ct4)) {
+	goto sample_major_f_counts_ret_READ_FAIL;
+      }
+      for (widx = 0; widx < unfiltered_marker_ctl2; widx++) {
+	cur_word = rowbuf[widx];
+	miss_word = cur_word & (~(cur_word >> 1)) & FIVEMASK;
+	if (miss2_cts) {
+	  miss2_cts[sample_idx] += popcount2_long(miss_word & miss2_include2[widx]);
+	}
+	ulii = include2[widx];
+	if (!ulii) {
+	  continue;
+	}
+	het_cts[sample_idx] += popcount2_long((cur_word >> 1) & (~cur_word) & ulii);
+	miss_word &= ulii;
+	nm_seen[widx] |= ulii & (~miss_word);
+	while (miss_word) {
+	  missing_cts[sample_idx] += 1;
+	  nei_offsets[sample_idx] += nei_vals[widx * BITCT2 + CTZLU(miss_word) / 2];
+	  miss_word &= miss_word - 1;
+	}
+      }
+    }
+    all_missing_found = 0;
+    for (widx = 0; widx < unfiltered_marker_ctl2; widx++) {
+      ulii = include2[widx] & (~nm_seen[widx]);
+      while (ulii) {
+	SET_BIT(var_exclude, widx * BITCT2 + CTZLU(ulii) / 2);
+	all_missing_found = 1;
+	ulii &= ulii - 1;
+      }
+    }
+  } while (all_missing_found);
+  for (widx = 0; widx < unfiltered_marker_ctl2; widx++) {
+    ulii = include2[widx];
+    while (ulii) {
+      nei_sum += nei_vals[widx * BITCT2 + CTZLU(ulii) / 2];
+      variant_ct++;
+      ulii &= ulii - 1;
+    }
+  }
+  *nei_sum_ptr = nei_sum;
+  *variant_ct_ptr = variant_ct;
+  while (0) {
+  sample_major_f_counts_ret_NOMEM:
+    retval = RET_NOMEM;
+    break;
+  sample_major_f_counts_ret_READ_FAIL:
+    retval = RET_READ_FAIL;
+    break;
+  }
+  wkspace_reset(wkspace_mark);
+  return retval;
+}
+
+int32_t sexcheck(FILE* bedfile, uintptr_t bed_offset, FILE* smajfile, char* outname, char* outname_end, uintptr_t unfiltered_marker_ct, uintptr_t* marker_exclude, uintptr_t unfiltered_sample_ct, uintptr_t* sample_exclude, uintptr_t sample_ct, char* sample_ids, uint32_t plink_maxfid, uint32_t plink_maxiid, uintptr_t max_sample_id_len, uintptr_t* sex_nm, uintptr_t* sex_male, uint64_t misc_flags, double check_sex_fthresh, double check_sex_mthresh, uint32_t max_f_yobs, uint32_t min_m_yobs, Chrom_info* chrom_info_ptr, double* set_allele_freqs, uint32_t* gender_unk_ct_ptr) {
   unsigned char* wkspace_mark = wkspace_base;
   FILE* outfile = NULL;
   uint32_t* het_cts = NULL;
@@ -2820,6 +2943,9 @@ int32_t sexcheck(FILE* bedfile, uintptr_t bed_offset, char* outname, char* outna
   uintptr_t ulii;
   uint32_t orig_sex_code;
   uint32_t imputed_sex_code;
+  uintptr_t unfiltered_marker_ctl;
+  uintptr_t* smaj_exclude;
+  uintptr_t* smaj_y_include2;
   if (wkspace_alloc_ul_checked(&loadbuf_raw, unfiltered_sample_ctl2 * sizeof(intptr_t)) ||
       wkspace_alloc_ul_checked(&loadbuf, sample_ctl2 * sizeof(intptr_t))) {
     goto sexcheck_ret_NOMEM;
@@ -2832,6 +2958,64 @@ int32_t sexcheck(FILE* bedfile, uintptr_t bed_offset, char* outname, char* outna
     }
     fill_uint_zero(ymiss_cts, sample_ct);
   }
+  if (smajfile) {
+    // --sample-major-cache: X and Y counts are collected in a single pass over
+    // each sample's row
+    unfiltered_marker_ctl = (unfiltered_marker_ct + (BITCT - 1)) / BITCT;
+    smaj_y_include2 = NULL;
+    if (wkspace_alloc_ul_checked(&smaj_exclude, unfiltered_marker_ctl * sizeof(intptr_t)) ||
+        wkspace_alloc_ui_checked(&het_cts, sample_ct * sizeof(int32_t)) ||
+        wkspace_alloc_ui_checked(&missing_cts, sample_ct * sizeof(int32_t)) ||
+        wkspace_alloc_d_checked(&nei_offsets, sample_ct * sizeof(double))) {
+      goto sexcheck_ret_NOMEM;
+    }
+    if (check_y) {
+      if ((y_code != -1) && is_set(chrom_info_ptr->chrom_mask, (uint32_t)y_code)) {
+	marker_uidx = chrom_info_ptr->chrom_start[(uint32_t)y_code];
+	marker_uidx_end = chrom_info_ptr->chrom_end[(uint32_t)y_code];
+	ytotal = marker_uidx_end - marker_uidx - popcount_bit_idx(marker_exclude, marker_uidx, marker_uidx_end);
+      }
+      if (ytotal) {
+	if (wkspace_alloc_ul_checked(&smaj_y_include2, 2 * unfiltered_marker_ctl * sizeof(intptr_t))) {
+	  goto sexcheck_ret_NOMEM;
+	}
+	memcpy(smaj_exclude, marker_exclude, unfiltered_marker_ctl * sizeof(intptr_t));
+	fill_bits(smaj_exclude, 0, marker_uidx);
+	if (marker_uidx_end < unfiltered_marker_ct) {
+	  fill_bits(smaj_exclude, marker_uidx_end, unfiltered_marker_ct - marker_uidx_end);
+	}
+	exclude_to_vec_include(unfiltered_marker_ct, smaj_y_include2, smaj_exclude);
+      } else if (yonly) {
+	logprint("Error: --check-sex/--impute-sex y-only requires Y chromosome data.\n");
+	goto sexcheck_ret_INVALID_CMDLINE;
+      }
+    }
+    if (!yonly) {
+      if ((x_code == -1) || (!is_set(chrom_info_ptr->chrom_mask, (uint32_t)x_code))) {
+	goto sexcheck_ret_NO_X_VAR;
+      }
+      marker_uidx = chrom_info_ptr->chrom_start[(uint32_t)x_code];
+      marker_uidx_end = chrom_info_ptr->chrom_end[(uint32_t)x_code];
+      memcpy(smaj_exclude, marker_exclude, unfiltered_marker_ctl * sizeof(intptr_t));
+      fill_bits(smaj_exclude, 0, marker_uidx);
+      if (marker_uidx_end < unfiltered_marker_ct) {
+	fill_bits(smaj_exclude, marker_uidx_end, unfiltered_marker_ct - marker_uidx_end);
+      }
+    } else {
+      fill_all_bits(smaj_exclude, unfiltered_marker_ct);
+    }
+    retval = sample_major_f_counts(smajfile, unfiltered_marker_ct, smaj_exclude, sample_exclude, sample_ct, set_allele_freqs, smaj_y_include2, het_cts, missing_cts, nei_offsets, smaj_y_include2? ymiss_cts : NULL, &nei_sum, &x_variant_ct);
+    if (retval) {
+      goto sexcheck_ret_1;
+    }
+    if ((!yonly) && (!x_variant_ct)) {
+      goto sexcheck_ret_NO_X_VAR;
+    }
+    if (check_y && (!ytotal) && (!yonly)) {
+      LOGPRINTF("Warning: No Y chromosome data for --%s-sex ycount.\n", do_impute? "impute" : "check");
+    }
+    goto sexcheck_counts_done;
+  }
   if (!yonly) {
     if ((x_code == -1) || (!is_set(chrom_info_ptr->chrom_mask, (uint32_t)x_code))) {
       goto sexcheck_ret_NO_X_VAR;
@@ -2941,6 +3125,7 @@ int32_t sexcheck(FILE* bedfile, uintptr_t bed_offset, char* outname, char* outna
       LOGPRINTF("Warning: No Y chromosome data for --%s-sex ycount.\n", do_impute? "impute" : "check");
     }
   }
+ sexcheck_counts_done:
   memcpy(outname_end, ".sexcheck", 10);
   if (fopen_checked(&outfile, outname, "w")) {
     goto sexcheck_ret_OPEN_FAIL;
@@ -3067,6 +3252,7 @@ int32_t sexcheck(FILE* bedfile, uintptr_t bed_offset, char* outname, char* outna
     retval = RET_INVALID_CMDLINE;
     break;
   }
+ sexcheck_ret_1:
   wkspace_reset(wkspace_mark);
   fclose_cond(outfile);
   return retval;
@@ -3477,7 +3663,7 @@ int32_t list_duplicate_vars(char* outname, char* outname_end, uint32_t dupvar_mo
   return retval;
 }
 
-int32_t het_report(FILE* bedfile, uintptr_t bed_offset, char* outname, char* outname_end, uint32_t output_gz, uintptr_t unfiltered_marker_ct, uintptr_t* marker_exclude, uintptr_t marker_ct, uintptr_t unfiltered_sample_ct, uintptr_t* sample_exclude, uintptr_t sample_ct, char* sample_ids, uint32_t plink_maxfid, uint32_t plink_maxiid, uintptr_t max_sample_id_len, uintptr_t* founder_info, Chrom_info* chrom_info_ptr, double* set_allele_freqs) {
+int32_t het_report(FILE* bedfile, uintptr_t bed_offset, FILE* smajfile, char* outname, char* outname_end, uint32_t output_gz, uintptr_t unfiltered_marker_ct, uintptr_t* marker_exclude, uintptr_t marker_ct, uintptr_t unfiltered_sample_ct, uintptr_t* sample_exclude, uintptr_t sample_ct, char* sample_ids, uint32_t plink_maxfid, uint32_t plink_maxiid, uintptr_t max_sample_id_len, uintptr_t* founder_info, Chrom_info* chrom_info_ptr, double* set_allele_freqs) {
   // Same F coefficient computation as sexcheck().
   unsigned char* wkspace_mark = wkspace_base;
   uintptr_t* loadbuf_f = NULL;
@@ -3494,6 +3680,7 @@ int32_t het_report(FILE* bedfile, uintptr_t bed_offset, char* outname, char* out
   double nei_sum = 0.0;
   uint32_t chrom_fo_idx = 0xffffffffU; // deliberate overflow
   uint32_t chrom_end = 0;
+  uint32_t chrom_idx;
   int32_t retval = 0;
   Pigz_state ps;
   uintptr_t* loadbuf_raw;
@@ -3520,6 +3707,7 @@ int32_t het_report(FILE* bedfile, uintptr_t bed_offset, char* outname, char* out
   uintptr_t cur_word;
   uintptr_t ulii;
   uint32_t obs_ct;
+  uintptr_t* smaj_exclude;
   pzwrite_init_null(&ps);
   if (is_set(chrom_info_ptr->haploid_mask, 0)) {
     logprint("Error: --het cannot be used on haploid genomes.\n");
@@ -3562,6 +3750,32 @@ int32_t het_report(FILE* bedfile, uintptr_t bed_offset, char* outname, char* out
       loadbuf_f = loadbuf;
     }
   }
+  if (smajfile && (!loadbuf_f)) {
+    // --sample-major-cache; small-sample mode still needs per-variant founder
+    // counts, so it's left to the loop below
+    if (wkspace_alloc_ul_checked(&smaj_exclude, ((unfiltered_marker_ct + (BITCT - 1)) / BITCT) * sizeof(intptr_t))) {
+      goto het_report_ret_NOMEM;
+    }
+    memcpy(smaj_exclude, marker_exclude, ((unfiltered_marker_ct + (BITCT - 1)) / BITCT) * sizeof(intptr_t));
+    // same variant set as the .bed loop below: haploid chromosomes, X, Y and
+    // MT are skipped
+    for (chrom_fo_idx = 0; chrom_fo_idx < chrom_info_ptr->chrom_ct; chrom_fo_idx++) {
+      chrom_idx = chrom_info_ptr->chrom_file_order[chrom_fo_idx];
+      if (is_set(chrom_info_ptr->haploid_mask, chrom_idx) || (((int32_t)chrom_idx) == chrom_info_ptr->x_code) || (((int32_t)chrom_idx) == chrom_info_ptr->y_code) || (((int32_t)chrom_idx) == chrom_info_ptr->mt_code)) {
+	marker_uidx = chrom_info_ptr->chrom_file_order_marker_idx[chrom_fo_idx];
+	ulii = chrom_info_ptr->chrom_file_order_marker_idx[chrom_fo_idx + 1];
+	if (ulii > marker_uidx) {
+	  fill_bits(smaj_exclude, marker_uidx, ulii - marker_uidx);
+	}
+      }
+    }
+    retval = sample_major_f_counts(smajfile, unfiltered_marker_ct, smaj_exclude, sample_exclude, sample_ct, set_allele_freqs, NULL, het_cts, missing_cts, nei_offsets, NULL, &nei_sum, &ulii);
+    if (retval) {
+      goto het_report_ret_1;
+    }
+    monomorphic_ct = marker_ct - ulii;
+    goto het_report_counts_done;
+  }
   for (marker_idx = 0; marker_idx < marker_ct; marker_uidx++, marker_idx++) {
     if (IS_SET(marker_exclude, marker_uidx)) {
       marker_uidx = next_unset_ul_unsafe(marker_exclude, marker_uidx);
@@ -3571,9 +3785,12 @@ int32_t het_report(FILE* bedfile, uintptr_t bed_offset, char* outname, char* out
     }
     if (marker_uidx >= chrom_end) {
       do {
+	// must skip exactly the variants count_non_autosomal_markers() removed
+	// from marker_ct (and the cache path above masks out)
 	do {
 	  chrom_fo_idx++;
-	} while (is_set(chrom_info_ptr->haploid_mask, chrom_info_ptr->chrom_file_order[chrom_fo_idx]));
+	  chrom_idx = chrom_info_ptr->chrom_file_order[chrom_fo_idx];
+	} while (is_set(chrom_info_ptr->haploid_mask, chrom_idx) || (((int32_t)chrom_idx) == chrom_info_ptr->x_code) || (((int32_t)chrom_idx) == chrom_info_ptr->y_code) || (((int32_t)chrom_idx) == chrom_info_ptr->mt_code));
 	chrom_end = chrom_info_ptr->chrom_file_order_marker_idx[chrom_fo_idx + 1];
 	marker_uidx = next_unset(marker_exclude, chrom_info_ptr->chrom_file_order_marker_idx[chrom_fo_idx], chrom_end);
       } while (marker_uidx >= chrom_end);
@@ -3638,6 +3855,7 @@ int32_t het_report(FILE* bedfile, uintptr_t bed_offset, char* outname, char* out
     }
     nei_sum += cur_nei;
   }
+ het_report_counts_done:
   marker_ct -= monomorphic_ct;
   if (!marker_ct) {
     goto het_report_ret_INVALID_CMDLINE;
@@ -3698,6 +3916,7 @@ int32_t het_report(FILE* bedfile, uintptr_t bed_offset, char* outname, char* out
     retval = RET_INVALID_CMDLINE;
     break;
   }
+ het_report_ret_1:
   wkspace_reset(wkspace_mark);
   flex_pzwrite_close_cond(&ps, pzwritep);
   return retval;
@@ -1,5 +1,8 @@
 #! /usr/bin/env python
 
+import array
+import json
+import struct
 import subprocess
 import sys
 
@@ -62,6 +65,62 @@ def main():
             sys.exit(1)
     print '--hwe/--recode vcf/--vcf test passed.'
 
+    # indexed region reads need tabix (from htslib) to build the index
+    if subprocess.call('which tabix > /dev/null 2>&1', shell=True) == 0:
+        for bfn in bfile_names_qt:
+            retval = subprocess.call('cp ' + bfn + '.bed test2.bed; cp ' + bfn + '.fam test2.fam', shell=True)
+            retval = subprocess.call("awk '{ $1 = (NR <= 500)? 1 : ((NR <= 900)? 2 : 3); print }' " + bfn + '.bim > test2.bim', shell=True)
+            if not retval == 0:
+                print 'Unexpected error in --recode vcf bgz/--vcf/--chr index test.'
+                sys.exit(1)
+            retval = subprocess.call('plink2 --bfile test2 --silent --recode vcf bgz --out test2; tabix -f -p vcf test2.vcf.gz', shell=True)
+            if not retval == 0:
+                print 'Unexpected error in --recode vcf bgz/--vcf/--chr index test.'
+                sys.exit(1)
+            retval = subprocess.call('plink2 --vcf test2.vcf.gz --silent --chr 2 --make-bed --out test2.chr2', shell=True)
+            if not retval == 0:
+                print 'Unexpected error in --recode vcf bgz/--vcf/--chr index test.'
+                sys.exit(1)
+            retval = subprocess.call('mv test2.vcf.gz.tbi test2.tbi.bak; plink2 --vcf test2.vcf.gz --silent --chr 2 --make-bed --out test1.chr2', shell=True)
+            if not retval == 0:
+                print 'Unexpected error in --recode vcf bgz/--vcf/--chr index test.'
+                sys.exit(1)
+            for ext in ['bed', 'bim', 'fam']:
+                retval = subprocess.call('diff -q test1.chr2.' + ext + ' test2.chr2.' + ext, shell=True)
+                if not retval == 0:
+                    print '--recode vcf bgz/--vcf/--chr index test failed.'
+                    sys.exit(1)
+            # a --from-bp/--to-bp window with no variants must fail the same
+            # way with and without the index
+            retval = subprocess.call('plink2 --vcf test2.vcf.gz --silent --chr 2 --from-bp 100000 --to-bp 300000 --make-bed --out test1.chr2', shell=True)
+            retval2 = subprocess.call('cp test2.tbi.bak test2.vcf.gz.tbi; plink2 --vcf test2.vcf.gz --silent --chr 2 --from-bp 100000 --to-bp 300000 --make-bed --out test2.chr2', shell=True)
+            subprocess.call('rm -f test2.vcf.gz.tbi', shell=True)
+            if (not retval == 13) or (not retval2 == 13):
+                print '--recode vcf bgz/--vcf/--chr index test failed.'
+                sys.exit(1)
+            # rewrite the .vcf.gz with a different chromosome layout, and give
+            # the old index the same timestamp; it must be ignored
+            retval = subprocess.call("awk '{ $1 = (NR <= 300)? 1 : ((NR <= 700)? 2 : 3); print }' " + bfn + '.bim > test2.bim', shell=True)
+            if not retval == 0:
+                print 'Unexpected error in --recode vcf bgz/--vcf/--chr index test.'
+                sys.exit(1)
+            retval = subprocess.call('plink2 --bfile test2 --silent --recode vcf bgz --out test2; plink2 --vcf test2.vcf.gz --silent --chr 2 --make-bed --out test1.chr2', shell=True)
+            if not retval == 0:
+                print 'Unexpected error in --recode vcf bgz/--vcf/--chr index test.'
+                sys.exit(1)
+            retval = subprocess.call('mv test2.tbi.bak test2.vcf.gz.tbi; touch -r test2.vcf.gz test2.vcf.gz.tbi; plink2 --vcf test2.vcf.gz --silent --chr 2 --make-bed --out test2.chr2', shell=True)
+            if not retval == 0:
+                print 'Unexpected error in --recode vcf bgz/--vcf/--chr index test.'
+                sys.exit(1)
+            for ext in ['bed', 'bim', 'fam']:
+                retval = subprocess.call('diff -q test1.chr2.' + ext + ' test2.chr2.' + ext, shell=True)
+                if not retval == 0:
+                    print '--recode vcf bgz/--vcf/--chr index test failed.'
+                    sys.exit(1)
+        print '--recode vcf bgz/--vcf/--chr index test passed.'
+    else:
+        print 'tabix not found; skipping --recode vcf bgz/--vcf/--chr index test.'
+
     for bfn in bfile_names:
         retval = subprocess.call('plink1 --bfile ' + bfn + ' --silent --nonfounders --max-maf 0.4999 --recode --transpose --out test1', shell=True)
         if not retval == 0:
@@ -98,6 +157,40 @@ def main():
             sys.exit(1)
     print '--missing/--recode transpose/--tfile test passed.'
 
+    for bfn in bfile_names:
+        for recode_mod, ext in [('A', 'raw'), ('A-transpose', 'traw')]:
+            retval = subprocess.call('plink2 --bfile ' + bfn + ' --silent --recode ' + recode_mod + ' --out test1', shell=True)
+            if not retval == 0:
+                print 'Unexpected error in --recode A/A-transpose bin4 test.'
+                sys.exit(1)
+            retval = subprocess.call('plink2 --bfile ' + bfn + ' --silent --recode ' + recode_mod + ' bin4 --out test2', shell=True)
+            if not retval == 0:
+                print 'Unexpected error in --recode A/A-transpose bin4 test.'
+                sys.exit(1)
+            # the text file keeps the header line and the first six columns;
+            # the rest must match the single-precision matrix, with NA <-> NaN
+            text_rows = [line.split() for line in open('test1.' + ext).read().splitlines()]
+            id_rows = [line.split() for line in open('test2.' + ext).read().splitlines()]
+            bin_vals = array.array('f')
+            bin_vals.fromstring(open('test2.' + ext + '.bin', 'rb').read())
+            val_ct = len(text_rows[0]) - 6
+            is_ok = (id_rows[0] == text_rows[0]) and (len(id_rows) == len(text_rows)) and (len(bin_vals) == val_ct * (len(text_rows) - 1))
+            row_idx = 1
+            while is_ok and (row_idx < len(text_rows)):
+                is_ok = (id_rows[row_idx] == text_rows[row_idx][:6])
+                for val_idx in range(val_ct):
+                    cur_val = bin_vals[(row_idx - 1) * val_ct + val_idx]
+                    cur_token = text_rows[row_idx][6 + val_idx]
+                    if cur_token == 'NA':
+                        is_ok = is_ok and (cur_val != cur_val)
+                    else:
+                        is_ok = is_ok and (cur_val == float(cur_token))
+                row_idx += 1
+            if not is_ok:
+                print '--recode A/A-transpose bin4 test failed.'
+                sys.exit(1)
+    print '--recode A/A-transpose bin4 test passed.'
+
     retval = subprocess.call('plink1 --bfile ' + bfile_names_cc[0] + ' --silent --bmerge ' + bfile_names_cc[1] + '.bed ' + bfile_names_cc[1] + '.bim ' + bfile_names_cc[1] + '.fam --max-maf 0.4999 --make-bed --out test1', shell=True)
     if not retval == 0:
         print 'Unexpected error in --bmerge/--make-bed test.'
@@ -120,6 +213,23 @@ def main():
         sys.exit(1)
     print '--bmerge/--make-bed test passed.'
 
+    # --memory 64 forces the streaming merge; the result must match the
+    # in-memory merge
+    retval = subprocess.call('plink2 --bfile merge1 --silent --merge-list merge_stream_list.txt --make-bed --out test1', shell=True)
+    if not retval == 0:
+        print 'Unexpected error in --merge-list/--memory test.'
+        sys.exit(1)
+    retval = subprocess.call('plink2 --bfile merge1 --silent --merge-list merge_stream_list.txt --memory 64 --make-bed --out test2', shell=True)
+    if not retval == 0:
+        print 'Unexpected error in --merge-list/--memory test.'
+        sys.exit(1)
+    for ext in ['bed', 'bim', 'fam']:
+        retval = subprocess.call('diff -q test1.' + ext + ' test2.' + ext, shell=True)
+        if not retval == 0:
+            print '--merge-list/--memory test failed.'
+            sys.exit(1)
+    print '--merge-list/--memory test passed.'
+
     subprocess.call('rm test2.bim', shell=True)
     retval = subprocess.call('plink2 --bfile ' + bfile_names_cc[0] + ' --silent --bmerge ' + bfile_names_cc[1] + ' --max-maf 0.4999 --make-just-bim --out test2', shell=True)
     if not retval == 0:
@@ -390,6 +500,107 @@ def main():
             sys.exit(1)
     print '--data/--het/--recode oxford test passed.'
 
+    for bfn in bfile_names_cc:
+        # spread the variants across chromosomes 1, 2, X, Y, MT, and 22, since
+        # --het must skip the same non-autosomal variants with and without the
+        # cache, including ones that precede an autosome
+        retval = subprocess.call('cp ' + bfn + '.bed test2.bed; cp ' + bfn + '.fam test2.fam', shell=True)
+        retval = subprocess.call("awk '{ $1 = (NR <= 300)? 1 : ((NR <= 500)? 2 : ((NR <= 700)? 23 : ((NR <= 800)? 24 : ((NR <= 1000)? 26 : 22)))); print }' " + bfn + '.bim > test2.bim', shell=True)
+        if not retval == 0:
+            print 'Unexpected error in --het/--sample-major-cache test.'
+            sys.exit(1)
+        retval = subprocess.call('plink2 --bfile test2 --silent --het --out test1', shell=True)
+        if not retval == 0:
+            print 'Unexpected error in --het/--sample-major-cache test.'
+            sys.exit(1)
+        retval = subprocess.call('rm -f test2.bed.smaj', shell=True)
+        retval = subprocess.call('plink2 --bfile test2 --silent --het --sample-major-cache --out test2', shell=True)
+        if not retval == 0:
+            print 'Unexpected error in --het/--sample-major-cache test.'
+            sys.exit(1)
+        retval = subprocess.call('diff -q test1.het test2.het', shell=True)
+        if not retval == 0:
+            print '--het/--sample-major-cache test failed.'
+            sys.exit(1)
+    print '--het/--sample-major-cache test passed.'
+
+    for bfn in bfile_names_cc:
+        retval = subprocess.call('cp ' + bfn + '.bed test2.bed; cp ' + bfn + '.bim test2.bim; cp ' + bfn + '.fam test2.fam; rm -f test2.bim.cache', shell=True)
+        retval = subprocess.call('plink2 --bfile test2 --silent --freq --out test1', shell=True)
+        if not retval == 0:
+            print 'Unexpected error in --bim-cache test.'
+            sys.exit(1)
+        # first run writes the cache, second run loads from it
+        for run_idx in range(2):
+            retval = subprocess.call('plink2 --bfile test2 --silent --bim-cache --freq --out test2', shell=True)
+            if not retval == 0:
+                print 'Unexpected error in --bim-cache test.'
+                sys.exit(1)
+            retval = subprocess.call('diff -q test1.frq test2.frq', shell=True)
+            if not retval == 0:
+                print '--bim-cache test failed.'
+                sys.exit(1)
+        # a same-size rewrite with the old mtime restored must not be served
+        # from the stale cache
+        retval = subprocess.call("cp -p test2.bim test2.bim.orig; awk 'BEGIN { OFS = \"\\t\" } { if ($2 == \"snp5\") $2 = \"snpX\"; print }' test2.bim.orig > test2.bim; touch -r test2.bim.orig test2.bim", shell=True)
+        if not retval == 0:
+            print 'Unexpected error in --bim-cache test.'
+            sys.exit(1)
+        retval = subprocess.call('plink2 --bfile test2 --silent --freq --out test1', shell=True)
+        if not retval == 0:
+            print 'Unexpected error in --bim-cache test.'
+            sys.exit(1)
+        retval = subprocess.call('plink2 --bfile test2 --silent --bim-cache --freq --out test2', shell=True)
+        if not retval == 0:
+            print 'Unexpected error in --bim-cache test.'
+            sys.exit(1)
+        retval = subprocess.call('diff -q test1.frq test2.frq', shell=True)
+        if not retval == 0:
+            print '--bim-cache test failed.'
+            sys.exit(1)
+    print '--bim-cache test passed.'
+
+    for bfn in bfile_names_cc:
+        retval = subprocess.call('cp ' + bfn + '.bed test2.bed; cp ' + bfn + '.bim test2.bim; cp ' + bfn + '.fam test2.fam; rm -f test2.bim.idx', shell=True)
+        retval = subprocess.call("awk 'NR % 3 == 0 {print $2}' test2.bim > test2.extract", shell=True)
+        if not retval == 0:
+            print 'Unexpected error in --extract/--exclude/--id-index test.'
+            sys.exit(1)
+        for filter_flag in ['--extract', '--exclude']:
+            retval = subprocess.call('plink2 --bfile test2 --silent ' + filter_flag + ' test2.extract --freq --out test1', shell=True)
+            if not retval == 0:
+                print 'Unexpected error in --extract/--exclude/--id-index test.'
+                sys.exit(1)
+            # first pass may write the index, second pass maps it
+            for run_idx in range(2):
+                retval = subprocess.call('plink2 --bfile test2 --silent --id-index ' + filter_flag + ' test2.extract --freq --out test2', shell=True)
+                if not retval == 0:
+                    print 'Unexpected error in --extract/--exclude/--id-index test.'
+                    sys.exit(1)
+                retval = subprocess.call('diff -q test1.frq test2.frq', shell=True)
+                if not retval == 0:
+                    print '--extract/--exclude/--id-index test failed.'
+                    sys.exit(1)
+        # rename an extracted variant in place, keeping size and mtime; the
+        # stale index must not be used
+        retval = subprocess.call("cp -p test2.bim test2.bim.orig; awk 'BEGIN { OFS = \"\\t\" } { if ($2 == \"snp5\") $2 = \"snpX\"; print }' test2.bim.orig > test2.bim; touch -r test2.bim.orig test2.bim; awk 'NR % 3 == 0 {print $2}' test2.bim > test2.extract", shell=True)
+        if not retval == 0:
+            print 'Unexpected error in --extract/--exclude/--id-index test.'
+            sys.exit(1)
+        retval = subprocess.call('plink2 --bfile test2 --silent --extract test2.extract --freq --out test1', shell=True)
+        if not retval == 0:
+            print 'Unexpected error in --extract/--exclude/--id-index test.'
+            sys.exit(1)
+        retval = subprocess.call('plink2 --bfile test2 --silent --id-index --extract test2.extract --freq --out test2', shell=True)
+        if not retval == 0:
+            print 'Unexpected error in --extract/--exclude/--id-index test.'
+            sys.exit(1)
+        retval = subprocess.call('diff -q test1.frq test2.frq', shell=True)
+        if not retval == 0:
+            print '--extract/--exclude/--id-index test failed.'
+            sys.exit(1)
+    print '--extract/--exclude/--id-index test passed.'
+
     for bfn in bfile_names_cc:
         retval = subprocess.call('rm test1.bim.tmp', shell=True)
         retval = subprocess.call('cat ' + bfn + ".bim | sed 's/^1/23/' > test1.bim.tmp", shell=True)
@@ -457,6 +668,47 @@ def main():
             sys.exit(1)
     print '--r2 test passed.'
 
+    for bfn in bfile_names:
+        retval = subprocess.call('plink2 --bfile ' + bfn + ' --silent --r2 --ld-window-r2 0 --out test1', shell=True)
+        if not retval == 0:
+            print 'Unexpected error in --r2 bin-sparse test.'
+            sys.exit(1)
+        retval = subprocess.call('plink2 --bfile ' + bfn + ' --silent --r2 bin-sparse --ld-window-r2 0 --out test2', shell=True)
+        if not retval == 0:
+            print 'Unexpected error in --r2 bin-sparse test.'
+            sys.exit(1)
+        # no variant filters, so .bim line order is the sparse variant index
+        marker_idxs = {}
+        for line in open(bfn + '.bim'):
+            marker_idxs[line.split()[1]] = len(marker_idxs)
+        text_pairs = {}
+        for line in open('test1.ld').read().splitlines()[1:]:
+            fields = line.split()
+            text_pairs[(marker_idxs[fields[2]], marker_idxs[fields[5]])] = float(fields[6])
+        sparse_buf = open('test2.ld.sparse', 'rb').read()
+        (magic, flags, anchor_ct, pair_ct) = struct.unpack('=8sIIQ', sparse_buf[:24])
+        is_ok = (magic == 'PLDSPRS\1') and (flags == 1) and (len(sparse_buf) == 24 + 16 * anchor_ct + 8 * pair_ct)
+        sparse_pairs = {}
+        anchor_idx = 0
+        while is_ok and (anchor_idx < anchor_ct):
+            (first_pair_idx, marker_idx1, anchor_pair_ct) = struct.unpack('=QII', sparse_buf[24 + 16 * anchor_idx:40 + 16 * anchor_idx])
+            for pair_idx in range(first_pair_idx, first_pair_idx + anchor_pair_ct):
+                pair_offset = 24 + 16 * anchor_ct + 8 * pair_idx
+                (marker_idx2, r2) = struct.unpack('=If', sparse_buf[pair_offset:pair_offset + 8])
+                sparse_pairs[(marker_idx1, marker_idx2)] = r2
+            anchor_idx += 1
+        # the text report rounds r^2, the binary one stores a float
+        is_ok = is_ok and (sorted(text_pairs.keys()) == sorted(sparse_pairs.keys()))
+        if is_ok:
+            for pair in text_pairs:
+                if abs(text_pairs[pair] - sparse_pairs[pair]) > 1e-5 + 1e-4 * text_pairs[pair]:
+                    is_ok = False
+                    break
+        if not is_ok:
+            print '--r2 bin-sparse test failed.'
+            sys.exit(1)
+    print '--r2 bin-sparse test passed.'
+
     for bfn in bfile_names:
         retval = subprocess.call('plink2 --bfile ' + bfn + ' --silent --make-set set.txt --write-set --out test1', shell=True)
         if not retval == 0:
@@ -569,6 +821,50 @@ def main():
             sys.exit(1)
     print 'QT --assoc test passed.'
 
+    for bfn in bfile_names_cc:
+        retval = subprocess.call('plink2 --bfile ' + bfn + ' --silent --freq --assoc --make-bed --out test1', shell=True)
+        if not retval == 0:
+            print 'Unexpected error in --mmap-bed test.'
+            sys.exit(1)
+        retval = subprocess.call('plink2 --bfile ' + bfn + ' --silent --mmap-bed --freq --assoc --make-bed --out test2', shell=True)
+        if not retval == 0:
+            print 'Unexpected error in --mmap-bed test.'
+            sys.exit(1)
+        for ext in ['frq', 'assoc', 'bed', 'bim', 'fam']:
+            retval = subprocess.call('diff -q test1.' + ext + ' test2.' + ext, shell=True)
+            if not retval == 0:
+                print '--mmap-bed test failed.'
+                sys.exit(1)
+    print '--mmap-bed test passed.'
+
+    for bfn in bfile_names_cc:
+        retval = subprocess.call('plink2 --bfile ' + bfn + ' --silent --freq --assoc --out test1', shell=True)
+        if not retval == 0:
+            print 'Unexpected error in --time-trace test.'
+            sys.exit(1)
+        for trace_mod in ['', ' tsv']:
+            retval = subprocess.call('rm -f test2.trace.json test2.trace.tsv; plink2 --bfile ' + bfn + ' --silent --freq --assoc --time-trace' + trace_mod + ' --out test2', shell=True)
+            if not retval == 0:
+                print 'Unexpected error in --time-trace test.'
+                sys.exit(1)
+            for ext in ['frq', 'assoc']:
+                retval = subprocess.call('diff -q test1.' + ext + ' test2.' + ext, shell=True)
+                if not retval == 0:
+                    print '--time-trace test failed.'
+                    sys.exit(1)
+            # the trace itself must parse, and must include the whole-run phase
+            try:
+                if trace_mod:
+                    phase_names = [line.split('\t')[0] for line in open('test2.trace.tsv').read().splitlines()[1:]]
+                else:
+                    phase_names = [phase['phase'] for phase in json.load(open('test2.trace.json'))['phases']]
+            except (IOError, ValueError, KeyError):
+                phase_names = []
+            if not 'total' in phase_names:
+                print '--time-trace test failed.'
+                sys.exit(1)
+    print '--time-trace test passed.'
+
     for bfn in bfile_names_cc:
         retval = subprocess.call('plink1 --bfile ' + bfn + ' --silent --max-maf 0.4999 --model --out test1', shell=True)
         if not retval == 0: